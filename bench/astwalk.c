@@ -0,0 +1,576 @@
+#include <string.h>
+
+#include "astwalk.h"
+#include "../include/vm.h"
+#include "../include/utils.h"
+#include "../include/typecheck.h"
+
+int64_t astwalk_expr(AstWalker *w, Expr *e);
+uint8_t *astwalk_addr(AstWalker *w, Expr *e);
+void astwalk_stmt(AstWalker *w, Stmt *s);
+
+AstWalker astwalk_create(ModuleMap *mods, BcModule *bc, SpanInterner *si) {
+    uint32_t num_funcs = ir_module_num_funcs(bc->ir);
+
+    AstWalker w = {
+        .ir = bc->ir,
+        .bc = bc,
+        .si = si,
+        .funcs = (FuncDeclStmt **) calloc(num_funcs + 1, sizeof(FuncDeclStmt *)),
+        .func_tys = (Func **) calloc(num_funcs + 1, sizeof(Func *)),
+        .strings = map_create(),
+        .string_data = ptrvec_create(),
+        .vars = vec_create(sizeof(AstWalkVar)),
+        .stack = (uint8_t *) malloc(ASTWALK_STACK_SIZE),
+        .sp = 0,
+        .depth = 0,
+        .returning = false,
+        .ret = 0,
+        .failed = false
+    };
+
+    // the function types know their IR index once lowering is done
+    int32_t i = 0;
+    while (i < mod_num_mods(mods)) {
+        Module *mod = mod_get_mod(mods, i);
+        int32_t j = 0;
+
+        while (j < mod_num_functions(mod)) {
+            FuncDeclStmt *f_s = mod_get_function_at(mod, j);
+            Ty *ty = mod_s_lookup(mod, ident_len(&f_s->decl.name, si), f_s->decl.name.ident);
+
+            if (!f_s->decl.is_extern && f_s->block != NULL && ty != NULL && ty_is_func(ty) && ty_as_func(ty)->ir_idx >= 0) {
+                w.funcs[ty_as_func(ty)->ir_idx] = f_s;
+                w.func_tys[ty_as_func(ty)->ir_idx] = ty_as_func(ty);
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    w.error[0] = '\0';
+
+    return w;
+}
+
+void astwalk_free(AstWalker *w) {
+    int64_t i = 0;
+
+    while (i < w->string_data.len) {
+        free(ptrvec_get(&w->string_data, i));
+        i++;
+    }
+
+    map_free(&w->strings);
+    ptrvec_free(&w->string_data);
+    vec_free(&w->vars);
+    free((void *) w->funcs);
+    free((void *) w->func_tys);
+    free((void *) w->stack);
+}
+
+void astwalk_fail(AstWalker *w, const char *error) {
+    if (!w->failed) {
+        snprintf(w->error, sizeof(w->error), "%s", error);
+    }
+
+    w->failed = true;
+    w->returning = true;
+}
+
+uint32_t astwalk_size(AstWalker *w, Ty *ty) {
+    if (ty_is_i32(ty)) {
+        return 4;
+    }
+
+    if (ty_is_struct(ty)) {
+        return ir_type_size(w->ir, ty_as_struct(ty)->ir_ty);
+    }
+
+    return 8;
+}
+
+// structs are handled by address, like in the IR
+int64_t astwalk_load(Ty *ty, uint8_t *addr) {
+    if (ty_is_i32(ty)) {
+        return *(int32_t *) addr;
+    }
+
+    if (ty_is_struct(ty)) {
+        return (int64_t) (intptr_t) addr;
+    }
+
+    return *(int64_t *) addr;
+}
+
+void astwalk_store(AstWalker *w, Ty *ty, uint8_t *addr, int64_t v) {
+    if (ty_is_i32(ty)) {
+        *(int32_t *) addr = (int32_t) v;
+    } else if (ty_is_struct(ty)) {
+        memcpy(addr, (void *) (intptr_t) v, astwalk_size(w, ty));
+    } else {
+        *(int64_t *) addr = v;
+    }
+}
+
+uint8_t *astwalk_alloc(AstWalker *w, uint32_t size) {
+    uint32_t sp = (w->sp + 7) & ~7u;
+
+    if (sp + size > ASTWALK_STACK_SIZE) {
+        astwalk_fail(w, "stack overflow");
+        return w->stack;
+    }
+
+    w->sp = sp + size;
+
+    return w->stack + sp;
+}
+
+void astwalk_push_var(AstWalker *w, Ident *ident, uint8_t *addr) {
+    AstWalkVar var = {
+        .name = ident->ident,
+        .len = ident_len(ident, w->si),
+        .addr = addr
+    };
+
+    vec_push(&w->vars, &var);
+}
+
+uint8_t *astwalk_lookup(AstWalker *w, Ident *ident) {
+    int32_t len = ident_len(ident, w->si);
+    int64_t i = w->vars.len - 1;
+
+    while (i >= 0) {
+        AstWalkVar *var = (AstWalkVar *) vec_get_ptr(&w->vars, i);
+
+        if (var->len == len && strncmp(var->name, ident->ident, len) == 0) {
+            return var->addr;
+        }
+
+        i--;
+    }
+
+    return NULL;
+}
+
+// escapes are decoded once per literal and the result is kept, so the pointer is stable
+const char *astwalk_string(AstWalker *w, StringExpr *s_e) {
+    int32_t len = span_get(w->si, s_e->e.span).len;
+    Key key = map_create_key(len, s_e->ptr);
+    char *data = (char *) map_get(&w->strings, key);
+
+    if (data != NULL) {
+        return data;
+    }
+
+    data = (char *) malloc(len + 1);
+    int32_t n = 0;
+    int32_t i = 0;
+
+    while (i < len) {
+        char c = s_e->ptr[i++];
+
+        if (c == '\\' && i < len) {
+            c = s_e->ptr[i++];
+
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                default: break;
+            }
+        }
+
+        data[n++] = c;
+    }
+
+    data[n] = '\0';
+    map_insert(&w->strings, key, data);
+    ptrvec_push_ptr(&w->string_data, data);
+
+    return data;
+}
+
+int64_t astwalk_int(Expr *e) {
+    if (ast_is_char_expr(e)) {
+        return (unsigned char) ast_as_char_expr(e)->ptr[0];
+    }
+
+    return (int32_t) ast_as_int_expr(e)->value;
+}
+
+int64_t astwalk_func_addr(AstWalker *w, Func *f_ty) {
+    BcExtern *e = &w->bc->externs[f_ty->ir_idx];
+
+    if (e->name != NULL) {
+        return (int64_t) (intptr_t) e->fn;
+    }
+
+    return (int64_t) (intptr_t) &w->bc->funcs[f_ty->ir_idx];
+}
+
+// i32 arithmetic wraps like the generated code does, pointers compare unsigned
+int64_t astwalk_binary(AstWalker *w, BinaryExpr *b_e) {
+    if (b_e->ty == BINARY_LOG_AND) {
+        return astwalk_expr(w, b_e->left) != 0 && astwalk_expr(w, b_e->right) != 0;
+    }
+
+    if (b_e->ty == BINARY_LOG_OR) {
+        return astwalk_expr(w, b_e->left) != 0 || astwalk_expr(w, b_e->right) != 0;
+    }
+
+    int64_t l = astwalk_expr(w, b_e->left);
+    int64_t r = astwalk_expr(w, b_e->right);
+
+    // pointer arithmetic moves by whole pointees
+    if (ty_is_ptr(b_e->left->ty) && (b_e->ty == BINARY_ADD || b_e->ty == BINARY_SUB)) {
+        Ptr *p_ty = ty_as_ptr(b_e->left->ty);
+        int64_t offset = (int64_t) (int32_t) r * (p_ty->count == 1 ? astwalk_size(w, p_ty->inner) : 8);
+
+        r = offset;
+    }
+
+    if (!ty_is_i32(b_e->left->ty)) {
+        switch (b_e->ty) {
+            case BINARY_ST: return (uint64_t) l < (uint64_t) r;
+            case BINARY_SE: return (uint64_t) l <= (uint64_t) r;
+            case BINARY_GT: return (uint64_t) l > (uint64_t) r;
+            case BINARY_GE: return (uint64_t) l >= (uint64_t) r;
+            case BINARY_EQ: return l == r;
+            case BINARY_NE: return l != r;
+            case BINARY_ADD: return (int64_t) ((uint64_t) l + (uint64_t) r);
+            case BINARY_SUB: return (int64_t) ((uint64_t) l - (uint64_t) r);
+            default: break;
+        }
+
+        astwalk_fail(w, "unsupported pointer arithmetic");
+        return 0;
+    }
+
+    int32_t a = (int32_t) l;
+    int32_t b = (int32_t) r;
+
+    switch (b_e->ty) {
+        case BINARY_ST: return a < b;
+        case BINARY_SE: return a <= b;
+        case BINARY_GT: return a > b;
+        case BINARY_GE: return a >= b;
+        case BINARY_EQ: return a == b;
+        case BINARY_NE: return a != b;
+        case BINARY_ADD: return (int32_t) ((uint32_t) a + (uint32_t) b);
+        case BINARY_SUB: return (int32_t) ((uint32_t) a - (uint32_t) b);
+        case BINARY_MUL: return (int32_t) ((uint32_t) a * (uint32_t) b);
+        default: break;
+    }
+
+    if (b == 0) {
+        astwalk_fail(w, "division by zero");
+        return 0;
+    }
+
+    if (b == -1) {
+        return b_e->ty == BINARY_DIV ? (int32_t) (0u - (uint32_t) a) : 0;
+    }
+
+    return b_e->ty == BINARY_DIV ? a / b : a % b;
+}
+
+int64_t astwalk_init(AstWalker *w, InitExpr *i_e) {
+    Struct *s = ty_as_struct(i_e->e.ty);
+    uint8_t *dst = astwalk_alloc(w, astwalk_size(w, i_e->e.ty));
+    int32_t i = 0;
+
+    memset(dst, 0, astwalk_size(w, i_e->e.ty));
+
+    while (i < ast_num_inits(&i_e->inits)) {
+        Init *init = (Init *) vec_get_ptr(&i_e->inits.inits, i);
+        int32_t idx = ty_field_index(s, w->si, &init->ident);
+        IrField *field = ir_type_field(w->ir, s->ir_ty, idx);
+
+        astwalk_store(w, ty_field_at(s, idx)->ty, dst + field->offset, astwalk_expr(w, init->expr));
+
+        i++;
+    }
+
+    return (int64_t) (intptr_t) dst;
+}
+
+// the arguments are evaluated in the caller's frame, a struct result is copied back into it before the
+// callee's memory is released
+int64_t astwalk_call_expr(AstWalker *w, CallExpr *c_e) {
+    Func *f_ty = ty_as_func(c_e->ident->ty);
+    int32_t num_args = ast_num_args(&c_e->args);
+    int64_t *args = (int64_t *) malloc((num_args + 1) * sizeof(int64_t));
+    uint8_t *result_mem = ty_is_struct(f_ty->ret) ? astwalk_alloc(w, astwalk_size(w, f_ty->ret)) : NULL;
+    int64_t result = 0;
+    int32_t i = 0;
+
+    while (i < num_args) {
+        args[i] = astwalk_expr(w, ast_get_arg_at(&c_e->args, i));
+        i++;
+    }
+
+    if (!w->failed) {
+        astwalk_call(w, f_ty->ir_idx, args, num_args, &result);
+    }
+
+    free((void *) args);
+
+    if (result_mem != NULL && !w->failed) {
+        memcpy(result_mem, (void *) (intptr_t) result, astwalk_size(w, f_ty->ret));
+        result = (int64_t) (intptr_t) result_mem;
+    }
+
+    return result;
+}
+
+uint8_t *astwalk_addr(AstWalker *w, Expr *e) {
+    if (ast_is_ident_expr(e)) {
+        uint8_t *addr = astwalk_lookup(w, &ast_as_ident_expr(e)->ident);
+
+        if (addr == NULL) {
+            astwalk_fail(w, "globals are not supported");
+            return w->stack;
+        }
+
+        return addr;
+    }
+
+    if (ast_is_access_expr(e)) {
+        AccessExpr *a_e = ast_as_access_expr(e);
+
+        if (ty_is_mod(a_e->left->ty)) {
+            astwalk_fail(w, "globals are not supported");
+            return w->stack;
+        }
+
+        Struct *s = typecheck_accessed_struct(a_e->left->ty);
+        uint8_t *base = (uint8_t *) (intptr_t) astwalk_expr(w, a_e->left);
+        int32_t idx = ty_field_index(s, w->si, &ast_as_ident_expr(a_e->right)->ident);
+
+        return base + ir_type_field(w->ir, s->ir_ty, idx)->offset;
+    }
+
+    if (ast_is_unary_expr(e) && ast_as_unary_expr(e)->ty == UNARY_DEREF) {
+        return (uint8_t *) (intptr_t) astwalk_expr(w, ast_as_unary_expr(e)->right);
+    }
+
+    return (uint8_t *) (intptr_t) astwalk_expr(w, e);
+}
+
+int64_t astwalk_expr(AstWalker *w, Expr *e) {
+    if (w->failed) {
+        return 0;
+    }
+
+    switch (e->tag) {
+        case EXPR_INT:
+        case EXPR_CHAR: {
+            return astwalk_int(e);
+        }
+
+        case EXPR_STRING: {
+            return (int64_t) (intptr_t) astwalk_string(w, ast_as_string_expr(e));
+        }
+
+        case EXPR_IDENT: {
+            if (ty_is_func(e->ty) && astwalk_lookup(w, &ast_as_ident_expr(e)->ident) == NULL) {
+                return astwalk_func_addr(w, ty_as_func(e->ty));
+            }
+
+            return astwalk_load(e->ty, astwalk_addr(w, e));
+        }
+
+        case EXPR_ACCESS: {
+            if (ty_is_func(e->ty)) {
+                return astwalk_func_addr(w, ty_as_func(e->ty));
+            }
+
+            return astwalk_load(e->ty, astwalk_addr(w, e));
+        }
+
+        case EXPR_CALL: {
+            return astwalk_call_expr(w, ast_as_call_expr(e));
+        }
+
+        case EXPR_INIT: {
+            return astwalk_init(w, ast_as_init_expr(e));
+        }
+
+        case EXPR_BINARY: {
+            return astwalk_binary(w, ast_as_binary_expr(e));
+        }
+
+        case EXPR_UNARY: {
+            UnaryExpr *u_e = ast_as_unary_expr(e);
+
+            switch (u_e->ty) {
+                case UNARY_REF: return (int64_t) (intptr_t) astwalk_addr(w, u_e->right);
+                case UNARY_DEREF: return astwalk_load(e->ty, (uint8_t *) (intptr_t) astwalk_expr(w, u_e->right));
+                case UNARY_NEG_BOOL: return astwalk_expr(w, u_e->right) == 0;
+                case UNARY_NEG_NUM: return (int32_t) (0u - (uint32_t) astwalk_expr(w, u_e->right));
+            }
+
+            return 0;
+        }
+
+        case EXPR_ASSIGN: {
+            AssignExpr *a_e = ast_as_assign_expr(e);
+            int64_t v = astwalk_expr(w, a_e->right);
+            uint8_t *dst = astwalk_addr(w, a_e->left);
+
+            if (!w->failed) {
+                astwalk_store(w, a_e->left->ty, dst, v);
+            }
+
+            return ty_is_struct(a_e->left->ty) ? (int64_t) (intptr_t) dst : v;
+        }
+
+        case EXPR_AS: {
+            AsExpr *a_e = ast_as_as_expr(e);
+            int64_t v = astwalk_expr(w, a_e->expr);
+
+            return ty_is_i32(a_e->e.ty) ? (int32_t) v : v;
+        }
+
+        case EXPR_NEW: {
+            Expr *inner = ast_as_new_expr(e)->expr;
+            int64_t v = astwalk_expr(w, inner);
+            uint8_t *p = (uint8_t *) malloc(astwalk_size(w, inner->ty));
+
+            astwalk_store(w, inner->ty, p, v);
+
+            return (int64_t) (intptr_t) p;
+        }
+    }
+
+    return 0;
+}
+
+// a block releases its variables and the memory of its temporaries when it ends
+void astwalk_block(AstWalker *w, BlockStmt *b) {
+    int64_t num_vars = w->vars.len;
+    uint32_t sp = w->sp;
+    int64_t i = 0;
+
+    while (i < b->stmts.len && !w->returning) {
+        astwalk_stmt(w, (Stmt *) ptrvec_get(&b->stmts, i));
+        i++;
+    }
+
+    w->vars.len = num_vars;
+    w->sp = sp;
+}
+
+void astwalk_stmt(AstWalker *w, Stmt *s) {
+    switch (s->tag) {
+        case STMT_EXPR: {
+            astwalk_expr(w, ast_as_expr_stmt(s)->expr);
+            break;
+        }
+
+        case STMT_LET: {
+            LetStmt *l_s = ast_as_let_stmt(s);
+            Ty *ty = l_s->value->ty;
+            int64_t v = astwalk_expr(w, l_s->value);
+            uint8_t *addr = astwalk_alloc(w, astwalk_size(w, ty));
+
+            astwalk_store(w, ty, addr, v);
+            astwalk_push_var(w, &l_s->ident, addr);
+            break;
+        }
+
+        case STMT_BLOCK: {
+            astwalk_block(w, ast_as_block_stmt(s));
+            break;
+        }
+
+        case STMT_IF: {
+            IfStmt *i_s = ast_as_if_stmt(s);
+
+            if (astwalk_expr(w, i_s->condition) != 0) {
+                astwalk_block(w, i_s->block);
+            } else if (i_s->else_stmt != NULL) {
+                astwalk_stmt(w, i_s->else_stmt);
+            }
+
+            break;
+        }
+
+        case STMT_WHILE: {
+            WhileStmt *w_s = ast_as_while_stmt(s);
+
+            while (!w->returning && astwalk_expr(w, w_s->cond) != 0) {
+                astwalk_block(w, w_s->block);
+            }
+
+            break;
+        }
+
+        case STMT_DELETE: {
+            free((void *) (intptr_t) astwalk_expr(w, ast_as_delete_stmt(s)->expr));
+            break;
+        }
+
+        case STMT_RETURN: {
+            Expr *e = ast_as_return_stmt(s)->expr;
+
+            w->ret = e != NULL ? astwalk_expr(w, e) : 0;
+            w->returning = true;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+bool astwalk_call(AstWalker *w, uint32_t idx, const int64_t *args, uint32_t num_args, int64_t *result) {
+    FuncDeclStmt *f_s = w->funcs[idx];
+
+    if (f_s == NULL) {
+        BcExtern *e = &w->bc->externs[idx];
+
+        if (e->name == NULL || !vm_call_extern(e, args, num_args, result)) {
+            astwalk_fail(w, "call to a missing extern function");
+        }
+
+        return !w->failed;
+    }
+
+    if (++w->depth > ASTWALK_MAX_DEPTH) {
+        astwalk_fail(w, "too much recursion");
+        return false;
+    }
+
+    Func *f_ty = w->func_tys[idx];
+    int64_t num_vars = w->vars.len;
+    uint32_t sp = w->sp;
+    uint32_t i = 0;
+
+    // parameters are the first variables of the frame, structs are copied in by value
+    while (i < num_args && i < (uint32_t) f_ty->params.types.len) {
+        Param *p = (Param *) vec_get_ptr(&f_s->decl.params.params, i);
+        Ty *ty = ty_type_at(&f_ty->params, i);
+        uint8_t *addr = astwalk_alloc(w, astwalk_size(w, ty));
+
+        astwalk_store(w, ty, addr, args[i]);
+        astwalk_push_var(w, &p->name, addr);
+
+        i++;
+    }
+
+    w->ret = 0;
+    astwalk_block(w, f_s->block);
+
+    *result = w->ret;
+    w->returning = w->failed;
+    w->vars.len = num_vars;
+    w->sp = sp;
+    w->depth--;
+
+    return !w->failed;
+}
@@ -0,0 +1,54 @@
+#ifndef SYNTHIUMC_ASTWALK_H
+#define SYNTHIUMC_ASTWALK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../include/ty.h"
+#include "../include/ast.h"
+#include "../include/map.h"
+#include "../include/mod.h"
+#include "../include/vec.h"
+#include "../include/ptrvec.h"
+#include "../include/bytecode.h"
+
+#define ASTWALK_STACK_SIZE (8 << 20)
+#define ASTWALK_MAX_DEPTH 100000
+
+// a local lives in the walker's stack memory, variables are found by name from the innermost one outwards
+typedef struct AstWalkVar {
+    const char *name;
+    int32_t len;
+    uint8_t *addr;
+} AstWalkVar;
+
+// the simplest interpreter there is, for comparing the vm against: it evaluates the typed AST recursively
+// and keeps every local in memory. it runs after lowering, which fills in the struct layouts and function
+// indices it uses, and calls externs through the vm's trampolines. globals are not supported
+typedef struct AstWalker {
+    IrModule *ir;
+    BcModule *bc;
+    SpanInterner *si;
+    FuncDeclStmt **funcs;
+    Func **func_tys;
+    Map strings;
+    Ptrvec string_data;
+    Vec vars;
+    uint8_t *stack;
+    uint32_t sp;
+    int32_t depth;
+    bool returning;
+    int64_t ret;
+    bool failed;
+    char error[128];
+} AstWalker;
+
+AstWalker astwalk_create(ModuleMap *mods, BcModule *bc, SpanInterner *si);
+void astwalk_free(AstWalker *w);
+
+// runs the function with the given IR index, returns false when it stopped with a runtime error
+bool astwalk_call(AstWalker *w, uint32_t idx, const int64_t *args, uint32_t num_args, int64_t *result);
+
+#endif
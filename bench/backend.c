@@ -0,0 +1,315 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "gen.h"
+#include "bench.h"
+#include "../include/timer.h"
+
+#define BACKEND_MAX_SIZES 16
+#define BACKEND_MAX_RUNS 32
+#define BACKEND_NUM_LEVELS 3
+
+// everything that runs after type checking differs between the optimization levels
+static const char *const backend_phases[] = { "lower", "optimize", "codegen" };
+#define BACKEND_NUM_PHASES ((int32_t) (sizeof(backend_phases) / sizeof(backend_phases[0])))
+
+typedef struct BackendOptions {
+    const char *compiler;
+    const char *dir;
+    const char *json_file;
+    int32_t num_sizes;
+    int64_t sizes[BACKEND_MAX_SIZES];
+    int32_t num_runs;
+    GenConfig gen;
+} BackendOptions;
+
+typedef struct BackendResult {
+    int32_t num_runs;
+    double seconds[BACKEND_MAX_RUNS];
+    double backend[BACKEND_MAX_RUNS];
+    double codegen[BACKEND_MAX_RUNS];
+    int64_t bytes;
+    int32_t exit_code;
+} BackendResult;
+
+// reads one number from the json time report, phases are looked up by name and stats by key
+int64_t backend_read_report(const char *path, const char *phase, const char *key) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        return -1;
+    }
+
+    char name[64];
+    char field[64];
+    snprintf(name, sizeof(name), "{\"name\": \"%s\",", phase != NULL ? phase : "");
+    snprintf(field, sizeof(field), "\"%s\": ", key);
+
+    char line[4096];
+    int64_t value = -1;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        const char *start = phase != NULL ? strstr(line, name) : strstr(line, "\"stats\"");
+        const char *p = start != NULL ? strstr(start, field) : NULL;
+
+        if (p != NULL) {
+            value = strtoll(p + strlen(field), NULL, 10);
+            break;
+        }
+    }
+
+    fclose(in);
+
+    return value;
+}
+
+bool backend_run_compiler(BackendOptions *opts, GenProject *p, int32_t level, const char *report, const char *object, double *seconds, int32_t *exit_code) {
+    const char **argv = (const char **) malloc((p->num_files + 8) * sizeof(const char *));
+    char *report_arg = (char *) malloc(strlen(report) + 32);
+    char level_arg[8];
+    int32_t argc = 0;
+
+    sprintf(report_arg, "--time-report-file=%s", report);
+    sprintf(level_arg, "-O%d", level);
+
+    argv[argc++] = opts->compiler;
+    argv[argc++] = level_arg;
+    argv[argc++] = "-o";
+    argv[argc++] = object;
+    argv[argc++] = "--time-report=json";
+    argv[argc++] = report_arg;
+
+    int32_t i = 0;
+    while (i < p->num_files) {
+        argv[argc++] = p->files[i];
+        i++;
+    }
+
+    argv[argc] = NULL;
+
+    fflush(stdout);
+
+    uint64_t start = timer_now_ns();
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        execv(opts->compiler, (char *const *) argv);
+        _exit(127);
+    }
+
+    int status = 0;
+    bool ok = pid > 0 && waitpid(pid, &status, 0) == pid;
+    uint64_t end = timer_now_ns();
+
+    free((void *) report_arg);
+    free((void *) argv);
+
+    if (!ok) {
+        printf("[error] could not run '%s': %s\n", opts->compiler, strerror(errno));
+        return false;
+    }
+
+    *seconds = (end - start) / 1e9;
+    *exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    return true;
+}
+
+bool backend_run_level(BackendOptions *opts, GenProject *p, const char *dir, int32_t level, BackendResult *r) {
+    char report[4096 + 16];
+    char object[4096 + 16];
+
+    snprintf(report, sizeof(report), "%s/report.json", dir);
+    snprintf(object, sizeof(object), "%s/out.o", dir);
+
+    r->num_runs = 0;
+    r->exit_code = 0;
+
+    while (r->num_runs < opts->num_runs) {
+        if (!backend_run_compiler(opts, p, level, report, object, &r->seconds[r->num_runs], &r->exit_code)) {
+            return false;
+        }
+
+        int64_t backend_ns = 0;
+        int32_t i = 0;
+
+        while (i < BACKEND_NUM_PHASES) {
+            int64_t ns = backend_read_report(report, backend_phases[i], "wall_ns");
+            backend_ns += ns > 0 ? ns : 0;
+            i++;
+        }
+
+        r->backend[r->num_runs] = backend_ns / 1e9;
+        r->codegen[r->num_runs] = backend_read_report(report, "codegen", "wall_ns") / 1e9;
+        r->num_runs++;
+    }
+
+    r->bytes = backend_read_report(report, NULL, "codegen bytes");
+
+    return true;
+}
+
+bool backend_parse_sizes(BackendOptions *opts, const char *list) {
+    opts->num_sizes = 0;
+
+    while (*list != '\0' && opts->num_sizes < BACKEND_MAX_SIZES) {
+        char *end = NULL;
+        int64_t size = strtoll(list, &end, 10);
+
+        if (end == list || size <= 0) {
+            return false;
+        }
+
+        if (*end == 'k' || *end == 'K') {
+            size *= 1000;
+            end++;
+        } else if (*end == 'm' || *end == 'M') {
+            size *= 1000000;
+            end++;
+        }
+
+        opts->sizes[opts->num_sizes++] = size;
+        list = *end == ',' ? end + 1 : end;
+    }
+
+    return opts->num_sizes > 0;
+}
+
+bool backend_parse_options(BackendOptions *opts, int32_t argc, const char **argv) {
+    int32_t i = 0;
+
+    while (i < argc) {
+        const char *arg = argv[i];
+
+        if (strncmp(arg, "--compiler=", 11) == 0) {
+            opts->compiler = arg + 11;
+        } else if (strncmp(arg, "--dir=", 6) == 0) {
+            opts->dir = arg + 6;
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            opts->json_file = arg + 7;
+        } else if (strncmp(arg, "--runs=", 7) == 0) {
+            opts->num_runs = atoi(arg + 7);
+
+            if (opts->num_runs < 1 || opts->num_runs > BACKEND_MAX_RUNS) {
+                printf("[error] --runs must be between 1 and %d\n", BACKEND_MAX_RUNS);
+                return false;
+            }
+        } else if (strncmp(arg, "--sizes=", 8) == 0) {
+            if (!backend_parse_sizes(opts, arg + 8)) {
+                printf("[error] invalid size list '%s'\n", arg + 8);
+                return false;
+            }
+        } else if (!gen_parse_option(&opts->gen, arg)) {
+            printf("[error] unknown option '%s'\n", arg);
+            printf("usage: synthium-backend [--compiler=path] [--dir=path] [--sizes=10k,100k,1m] [--runs=N] [--json=file]\n    %s\n", gen_usage());
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BackendOptions opts = {
+        .compiler = "./synthiumc",
+        .dir = "bench/projects",
+        .json_file = NULL,
+        .num_sizes = 2,
+        .sizes = { 10000, 100000 },
+        .num_runs = 3,
+        .gen = gen_default_config()
+    };
+
+    if (!backend_parse_options(&opts, argc - 1, (const char **) argv + 1)) {
+        return -1;
+    }
+
+    if (mkdir(opts.dir, 0755) != 0 && errno != EEXIST) {
+        printf("[error] could not create '%s': %s\n", opts.dir, strerror(errno));
+        return -1;
+    }
+
+    // the compiler resolves relative input paths against its own directory
+    char abs_dir[PATH_MAX];
+    if (realpath(opts.dir, abs_dir) != NULL) {
+        opts.dir = abs_dir;
+    }
+
+    FILE *json = NULL;
+    if (opts.json_file != NULL && (json = fopen(opts.json_file, "w")) == NULL) {
+        printf("[error] could not open '%s'\n", opts.json_file);
+        return -1;
+    }
+
+    // the backend column covers lowering and code generation, the speedup compares it to -O0
+    printf("%12s %5s %10s %12s %12s %14s %9s\n", "lines", "level", "seconds", "backend ms", "codegen ms", "text bytes", "vs -O0");
+
+    int32_t i = 0;
+    while (i < opts.num_sizes) {
+        char dir[4096];
+        snprintf(dir, sizeof(dir), "%s/%ld", opts.dir, (long) opts.sizes[i]);
+
+        GenConfig cfg = opts.gen;
+        cfg.target_lines = opts.sizes[i];
+
+        GenProject p = { 0, NULL, 0, 0 };
+        if (!gen_project(&cfg, dir, &p)) {
+            return -1;
+        }
+
+        double base_backend = 0;
+        int32_t level = 0;
+
+        while (level < BACKEND_NUM_LEVELS) {
+            BackendResult r;
+
+            if (!backend_run_level(&opts, &p, dir, level, &r)) {
+                gen_free_project(&p);
+                return -1;
+            }
+
+            double seconds = bench_median(r.seconds, r.num_runs);
+            double backend = bench_median(r.backend, r.num_runs);
+            double codegen = bench_median(r.codegen, r.num_runs);
+
+            if (level == 0) {
+                base_backend = backend;
+            }
+
+            printf("%12ld %5s %10.3f %12.1f %12.1f %14ld %8.2fx%s\n",
+                (long) p.lines, level == 0 ? "-O0" : (level == 1 ? "-O1" : "-O2"), seconds, backend * 1e3, codegen * 1e3,
+                (long) r.bytes, backend / base_backend, r.exit_code != 0 ? "  (compile errors)" : "");
+            fflush(stdout);
+
+            if (json != NULL) {
+                fprintf(json, "{\"lines\": %ld, \"level\": %d, \"text_bytes\": %ld, \"exit_code\": %d, \"runs\": [",
+                    (long) p.lines, level, (long) r.bytes, r.exit_code);
+
+                int32_t j = 0;
+                while (j < r.num_runs) {
+                    fprintf(json, "%s{\"seconds\": %.6f, \"backend\": %.6f, \"codegen\": %.6f}", j > 0 ? ", " : "", r.seconds[j], r.backend[j], r.codegen[j]);
+                    j++;
+                }
+
+                fprintf(json, "]}\n");
+            }
+
+            level++;
+        }
+
+        gen_free_project(&p);
+        i++;
+    }
+
+    if (json != NULL) {
+        fclose(json);
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+
+#include "bench.h"
+#include "../include/alloc.h"
+#include "../include/timer.h"
+
+static const int64_t bench_sizes[] = { 16, 1024, 65536, 1048576 };
+static const int32_t bench_num_sizes = sizeof(bench_sizes) / sizeof(int64_t);
+
+// small sizes are repeated until a sample covers enough operations to be above the clock resolution
+BenchResult bench_run_case(BenchCase *c, int64_t size, int32_t num_samples) {
+    BenchResult r = {
+        .name = c->name,
+        .size = size,
+        .num_samples = num_samples,
+        .allocs_per_op = 0,
+        .bytes_per_op = 0
+    };
+
+    int64_t total_ops = 0;
+    AllocStats total_allocs = { 0, 0 };
+    int32_t i = 0;
+
+    while (i < num_samples) {
+        uint64_t ns = 0;
+        int64_t ops = 0;
+
+        while (ops < BENCH_MIN_OPS_PER_SAMPLE) {
+            void *state = c->setup(size);
+
+            AllocStats before = alloc_stats();
+            alloc_set_counting(true);
+            uint64_t start = timer_now_ns();
+
+            int64_t done = c->run(state, size);
+
+            uint64_t end = timer_now_ns();
+            alloc_set_counting(false);
+            AllocStats allocs = alloc_stats_diff(alloc_stats(), before);
+
+            c->teardown(state);
+
+            ns += end - start;
+            ops += done > 0 ? done : 1;
+            total_allocs.count += allocs.count;
+            total_allocs.bytes += allocs.bytes;
+        }
+
+        r.ns_per_op[i] = (double) ns / (double) ops;
+        total_ops += ops;
+
+        i++;
+    }
+
+    r.allocs_per_op = (double) total_allocs.count / (double) total_ops;
+    r.bytes_per_op = (double) total_allocs.bytes / (double) total_ops;
+
+    return r;
+}
+
+void bench_print_row(FILE *out, BenchResult *r) {
+    double median = bench_median(r->ns_per_op, r->num_samples);
+    double spread = median > 0 ? 100 * bench_stddev(r->ns_per_op, r->num_samples) / median : 0;
+
+    fprintf(out, "%-24s %9ld %12.2f %7.1f%% %12.3f %12.1f\n", r->name, (long) r->size, median, spread, r->allocs_per_op, r->bytes_per_op);
+}
+
+// one object per line, read back by bench-compare
+void bench_print_json(FILE *out, BenchResult *r) {
+    fprintf(out, "{\"name\": \"%s\", \"size\": %ld, \"allocs_per_op\": %.6f, \"bytes_per_op\": %.6f, \"ns_per_op\": [",
+        r->name, (long) r->size, r->allocs_per_op, r->bytes_per_op);
+
+    int32_t i = 0;
+    while (i < r->num_samples) {
+        fprintf(out, "%s%.4f", i > 0 ? ", " : "", r->ns_per_op[i]);
+        i++;
+    }
+
+    fprintf(out, "]}\n");
+}
+
+bool bench_parse_options(BenchOptions *opts, int32_t argc, const char **argv) {
+    int32_t i = 0;
+
+    while (i < argc) {
+        const char *arg = argv[i];
+
+        if (strncmp(arg, "--samples=", 10) == 0) {
+            opts->num_samples = atoi(arg + 10);
+
+            if (opts->num_samples < 2 || opts->num_samples > BENCH_MAX_SAMPLES) {
+                printf("[error] --samples must be between 2 and %d\n", BENCH_MAX_SAMPLES);
+                return false;
+            }
+        } else if (strncmp(arg, "--filter=", 9) == 0) {
+            opts->filter = arg + 9;
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            opts->json_file = arg + 7;
+        } else if (strcmp(arg, "--quick") == 0) {
+            opts->quick = true;
+        } else {
+            printf("[error] unknown option '%s'\n", arg);
+            printf("usage: synthium-bench [--samples=N] [--filter=substr] [--json=file] [--quick]\n");
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opts = {
+        .num_samples = 10,
+        .filter = NULL,
+        .json_file = NULL,
+        .quick = false
+    };
+
+    if (!bench_parse_options(&opts, argc - 1, (const char **) argv + 1)) {
+        return -1;
+    }
+
+    if (!alloc_hooks_available()) {
+        fprintf(stderr, "[warning] allocation counting is not available in this build, allocs/op will be 0\n");
+    }
+
+    FILE *json = NULL;
+    if (opts.json_file != NULL && (json = fopen(opts.json_file, "w")) == NULL) {
+        printf("[error] could not open '%s'\n", opts.json_file);
+        return -1;
+    }
+
+    printf("%-24s %9s %12s %8s %12s %12s\n", "benchmark", "size", "ns/op", "+-", "allocs/op", "bytes/op");
+
+    int32_t i = 0;
+    while (i < bench_num_cases) {
+        BenchCase *c = &bench_cases[i];
+
+        if (opts.filter != NULL && strstr(c->name, opts.filter) == NULL) {
+            i++;
+            continue;
+        }
+
+        int32_t j = 0;
+        while (j < bench_num_sizes) {
+            int64_t size = bench_sizes[j];
+
+            if (size > c->max_size || (opts.quick && size > 1024)) {
+                break;
+            }
+
+            BenchResult r = bench_run_case(c, size, opts.num_samples);
+            bench_print_row(stdout, &r);
+            fflush(stdout);
+
+            if (json != NULL) {
+                bench_print_json(json, &r);
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    if (json != NULL) {
+        fclose(json);
+    }
+
+    return 0;
+}
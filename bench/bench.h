@@ -0,0 +1,50 @@
+#ifndef SYNTHIUMC_BENCH_H
+#define SYNTHIUMC_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BENCH_MAX_SAMPLES 100
+#define BENCH_MIN_OPS_PER_SAMPLE 65536
+
+// setup and teardown run outside of the timed region, run returns the number of operations it performed
+typedef struct BenchCase {
+    const char *name;
+    int64_t max_size;
+    void *(*setup)(int64_t size);
+    int64_t (*run)(void *state, int64_t size);
+    void (*teardown)(void *state);
+} BenchCase;
+
+typedef struct BenchResult {
+    const char *name;
+    int64_t size;
+    int32_t num_samples;
+    double ns_per_op[BENCH_MAX_SAMPLES];
+    double allocs_per_op;
+    double bytes_per_op;
+} BenchResult;
+
+typedef struct BenchOptions {
+    int32_t num_samples;
+    const char *filter;
+    const char *json_file;
+    bool quick;
+} BenchOptions;
+
+extern BenchCase bench_cases[];
+extern int32_t bench_num_cases;
+
+// keeps the optimizer from deleting the work of a benchmark
+void bench_consume(uint64_t value);
+uint64_t bench_rand(uint64_t *state);
+BenchResult bench_run_case(BenchCase *c, int64_t size, int32_t num_samples);
+double bench_median(double *values, int32_t len);
+double bench_mean(double *values, int32_t len);
+double bench_stddev(double *values, int32_t len);
+void bench_print_row(FILE *out, BenchResult *r);
+void bench_print_json(FILE *out, BenchResult *r);
+
+#endif
@@ -0,0 +1,72 @@
+#include <math.h>
+#include <string.h>
+
+#include "bench.h"
+
+static volatile uint64_t bench_sink = 0;
+
+void bench_consume(uint64_t value) {
+    bench_sink += value;
+}
+
+// xorshift64, so every run works on the same inputs
+uint64_t bench_rand(uint64_t *state) {
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    *state = x;
+
+    return x;
+}
+
+int bench_cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+double bench_median(double *values, int32_t len) {
+    double sorted[BENCH_MAX_SAMPLES];
+
+    memcpy(sorted, values, len * sizeof(double));
+    qsort(sorted, len, sizeof(double), bench_cmp_double);
+
+    if (len % 2 == 0) {
+        return (sorted[len / 2 - 1] + sorted[len / 2]) / 2;
+    }
+
+    return sorted[len / 2];
+}
+
+double bench_mean(double *values, int32_t len) {
+    double sum = 0;
+    int32_t i = 0;
+
+    while (i < len) {
+        sum += values[i];
+        i++;
+    }
+
+    return sum / len;
+}
+
+double bench_stddev(double *values, int32_t len) {
+    if (len < 2) {
+        return 0;
+    }
+
+    double mean = bench_mean(values, len);
+    double sum = 0;
+    int32_t i = 0;
+
+    while (i < len) {
+        sum += (values[i] - mean) * (values[i] - mean);
+        i++;
+    }
+
+    return sqrt(sum / (len - 1));
+}
@@ -0,0 +1,244 @@
+#include <math.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define COMPARE_MAX_RESULTS 1024
+#define COMPARE_LINE_LEN 8192
+
+typedef struct CompareSet {
+    int32_t len;
+    BenchResult results[COMPARE_MAX_RESULTS];
+} CompareSet;
+
+// continued fraction for the regularized incomplete beta function
+double compare_beta_cf(double a, double b, double x) {
+    double c = 1;
+    double d = 1 - (a + b) * x / (a + 1);
+    d = fabs(d) < 1e-30 ? 1e-30 : d;
+    d = 1 / d;
+    double h = d;
+    int32_t m = 1;
+
+    while (m <= 200) {
+        double m2 = 2 * m;
+        double aa = m * (b - m) * x / ((a + m2 - 1) * (a + m2));
+
+        d = 1 + aa * d;
+        d = fabs(d) < 1e-30 ? 1e-30 : d;
+        c = 1 + aa / c;
+        c = fabs(c) < 1e-30 ? 1e-30 : c;
+        d = 1 / d;
+        h *= d * c;
+
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1));
+
+        d = 1 + aa * d;
+        d = fabs(d) < 1e-30 ? 1e-30 : d;
+        c = 1 + aa / c;
+        c = fabs(c) < 1e-30 ? 1e-30 : c;
+        d = 1 / d;
+
+        double delta = d * c;
+        h *= delta;
+
+        if (fabs(delta - 1) < 1e-12) {
+            break;
+        }
+
+        m++;
+    }
+
+    return h;
+}
+
+double compare_incomplete_beta(double a, double b, double x) {
+    if (x <= 0) {
+        return 0;
+    }
+
+    if (x >= 1) {
+        return 1;
+    }
+
+    double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x));
+
+    if (x < (a + 1) / (a + b + 2)) {
+        return front * compare_beta_cf(a, b, x) / a;
+    }
+
+    return 1 - front * compare_beta_cf(b, a, 1 - x) / b;
+}
+
+// two sided p-value of Student's t distribution
+double compare_t_pvalue(double t, double df) {
+    return compare_incomplete_beta(df / 2, 0.5, df / (df + t * t));
+}
+
+// Welch's t-test, does not assume that both runs have the same variance
+double compare_welch(BenchResult *a, BenchResult *b, double *t_out) {
+    double ma = bench_mean(a->ns_per_op, a->num_samples);
+    double mb = bench_mean(b->ns_per_op, b->num_samples);
+    double sa = bench_stddev(a->ns_per_op, a->num_samples);
+    double sb = bench_stddev(b->ns_per_op, b->num_samples);
+    double va = sa * sa / a->num_samples;
+    double vb = sb * sb / b->num_samples;
+
+    if (va + vb == 0) {
+        *t_out = 0;
+        return ma == mb ? 1 : 0;
+    }
+
+    double t = (mb - ma) / sqrt(va + vb);
+    double df = (va + vb) * (va + vb) / (va * va / (a->num_samples - 1) + vb * vb / (b->num_samples - 1));
+
+    *t_out = t;
+
+    return compare_t_pvalue(t, df);
+}
+
+double compare_read_number(const char *line, const char *field) {
+    const char *p = strstr(line, field);
+    if (p == NULL) {
+        return 0;
+    }
+
+    return strtod(p + strlen(field), NULL);
+}
+
+bool compare_parse_line(const char *line, BenchResult *r) {
+    const char *name = strstr(line, "\"name\": \"");
+    const char *samples = strstr(line, "\"ns_per_op\": [");
+
+    if (name == NULL || samples == NULL) {
+        return false;
+    }
+
+    name += strlen("\"name\": \"");
+    const char *name_end = strchr(name, '"');
+    if (name_end == NULL) {
+        return false;
+    }
+
+    r->name = strndup(name, name_end - name);
+    r->size = (int64_t) compare_read_number(line, "\"size\": ");
+    r->allocs_per_op = compare_read_number(line, "\"allocs_per_op\": ");
+    r->bytes_per_op = compare_read_number(line, "\"bytes_per_op\": ");
+    r->num_samples = 0;
+
+    const char *p = samples + strlen("\"ns_per_op\": [");
+    while (*p != ']' && *p != '\0' && r->num_samples < BENCH_MAX_SAMPLES) {
+        char *end = NULL;
+        double value = strtod(p, &end);
+
+        if (end == p) {
+            break;
+        }
+
+        r->ns_per_op[r->num_samples++] = value;
+        p = end;
+
+        while (*p == ',' || *p == ' ') {
+            p++;
+        }
+    }
+
+    return r->num_samples > 0;
+}
+
+bool compare_read_file(const char *path, CompareSet *set) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        printf("[error] could not open '%s'\n", path);
+        return false;
+    }
+
+    char line[COMPARE_LINE_LEN];
+    set->len = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL && set->len < COMPARE_MAX_RESULTS) {
+        if (compare_parse_line(line, &set->results[set->len])) {
+            set->len++;
+        }
+    }
+
+    fclose(in);
+
+    return true;
+}
+
+BenchResult *compare_find(CompareSet *set, BenchResult *r) {
+    int32_t i = 0;
+    while (i < set->len) {
+        BenchResult *other = &set->results[i];
+
+        if (other->size == r->size && strcmp(other->name, r->name) == 0) {
+            return other;
+        }
+
+        i++;
+    }
+
+    return NULL;
+}
+
+void compare_free(CompareSet *set) {
+    int32_t i = 0;
+    while (i < set->len) {
+        free((void *) set->results[i].name);
+        i++;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: bench-compare <base.json> <new.json> [alpha]\n");
+        return -1;
+    }
+
+    double alpha = argc > 3 ? strtod(argv[3], NULL) : 0.05;
+    static CompareSet base;
+    static CompareSet next;
+
+    if (!compare_read_file(argv[1], &base) || !compare_read_file(argv[2], &next)) {
+        return -1;
+    }
+
+    int32_t regressions = 0;
+
+    printf("%-24s %9s %12s %12s %9s %9s %11s  %s\n", "benchmark", "size", "base ns/op", "new ns/op", "delta", "p", "allocs/op", "verdict");
+
+    int32_t i = 0;
+    while (i < next.len) {
+        BenchResult *n = &next.results[i];
+        BenchResult *b = compare_find(&base, n);
+
+        if (b == NULL) {
+            printf("%-24s %9ld %12s %12.2f %9s %9s %11.3f  new\n", n->name, (long) n->size, "-", bench_mean(n->ns_per_op, n->num_samples), "-", "-", n->allocs_per_op);
+            i++;
+            continue;
+        }
+
+        double t = 0;
+        double p = compare_welch(b, n, &t);
+        double mb = bench_mean(b->ns_per_op, b->num_samples);
+        double mn = bench_mean(n->ns_per_op, n->num_samples);
+        double delta = mb > 0 ? 100 * (mn - mb) / mb : 0;
+        const char *verdict = "same";
+
+        if (p < alpha) {
+            verdict = t > 0 ? "slower" : "faster";
+            regressions += t > 0;
+        }
+
+        printf("%-24s %9ld %12.2f %12.2f %+8.1f%% %9.4f %+11.3f  %s\n",
+            n->name, (long) n->size, mb, mn, delta, p, n->allocs_per_op - b->allocs_per_op, verdict);
+
+        i++;
+    }
+
+    compare_free(&base);
+    compare_free(&next);
+
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,375 @@
+#include <string.h>
+
+#include "bench.h"
+#include "../include/map.h"
+#include "../include/vec.h"
+#include "../include/span.h"
+#include "../include/utils.h"
+#include "../include/ptrvec.h"
+
+#define KEY_SLOT 24
+
+typedef struct ContainerState {
+    Vec vec;
+    Ptrvec ptrvec;
+    Map map;
+    SpanInterner si;
+    int64_t *indices;
+    char *keys;
+    int32_t *key_lens;
+    Span *spans;
+} ContainerState;
+
+// identifier-like keys, the same shape as the names the type checker puts in its maps
+void containers_make_keys(ContainerState *s, int64_t size, const char *prefix) {
+    s->keys = (char *) malloc(size * KEY_SLOT);
+    s->key_lens = (int32_t *) malloc(size * sizeof(int32_t));
+
+    int64_t i = 0;
+    while (i < size) {
+        s->key_lens[i] = snprintf(s->keys + i * KEY_SLOT, KEY_SLOT, "%s_%ld", prefix, (long) i);
+        i++;
+    }
+}
+
+Key containers_key(ContainerState *s, int64_t i) {
+    return map_create_key(s->key_lens[i], s->keys + i * KEY_SLOT);
+}
+
+void containers_make_indices(ContainerState *s, int64_t size) {
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    s->indices = (int64_t *) malloc(size * sizeof(int64_t));
+
+    int64_t i = 0;
+    while (i < size) {
+        s->indices[i] = (int64_t) (bench_rand(&seed) % (uint64_t) size);
+        i++;
+    }
+}
+
+void *containers_setup_empty(int64_t size) {
+    (void) size;
+    return calloc(1, sizeof(ContainerState));
+}
+
+void *containers_setup_vec(int64_t size) {
+    ContainerState *s = (ContainerState *) calloc(1, sizeof(ContainerState));
+    s->vec = vec_with_cap(sizeof(int64_t), size);
+
+    int64_t i = 0;
+    while (i < size) {
+        vec_push(&s->vec, (void *) &i);
+        i++;
+    }
+
+    containers_make_indices(s, size);
+
+    return (void *) s;
+}
+
+void *containers_setup_ptrvec(int64_t size) {
+    ContainerState *s = (ContainerState *) calloc(1, sizeof(ContainerState));
+    s->ptrvec = ptrvec_with_cap(size);
+
+    int64_t i = 0;
+    while (i < size) {
+        ptrvec_push_ptr(&s->ptrvec, (void *) (intptr_t) (i + 1));
+        i++;
+    }
+
+    containers_make_indices(s, size);
+
+    return (void *) s;
+}
+
+void *containers_setup_keys(int64_t size) {
+    ContainerState *s = (ContainerState *) calloc(1, sizeof(ContainerState));
+    containers_make_keys(s, size, "ident");
+
+    return (void *) s;
+}
+
+void *containers_setup_map(int64_t size) {
+    ContainerState *s = (ContainerState *) containers_setup_keys(size);
+    s->map = map_create();
+
+    int64_t i = 0;
+    while (i < size) {
+        map_insert(&s->map, containers_key(s, i), (void *) (intptr_t) (i + 1));
+        i++;
+    }
+
+    containers_make_indices(s, size);
+
+    return (void *) s;
+}
+
+void *containers_setup_spans(int64_t size) {
+    ContainerState *s = (ContainerState *) calloc(1, sizeof(ContainerState));
+    s->si = span_create_interner();
+    s->spans = (Span *) malloc(size * sizeof(Span));
+
+    // every other span is too long to be stored inline and goes through the interner
+    int64_t i = 0;
+    while (i < size) {
+        uint32_t len = (i % 2) == 0 ? 8 : MAX_LEN + 8;
+        s->spans[i] = span_create(&s->si, i * 16, i * 16 + len, 0);
+        i++;
+    }
+
+    containers_make_indices(s, size);
+
+    return (void *) s;
+}
+
+void containers_teardown(void *state) {
+    ContainerState *s = (ContainerState *) state;
+
+    if (s->vec.elements != NULL) {
+        vec_free(&s->vec);
+    }
+
+    if (s->ptrvec.elements != NULL) {
+        ptrvec_free(&s->ptrvec);
+    }
+
+    map_free(&s->map);
+
+    if (s->si.spans.elements != NULL) {
+        span_free_interner(&s->si);
+    }
+
+    free((void *) s->indices);
+    free((void *) s->keys);
+    free((void *) s->key_lens);
+    free((void *) s->spans);
+    free(state);
+}
+
+int64_t bench_vec_push(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    s->vec = vec_create(sizeof(int64_t));
+
+    int64_t i = 0;
+    while (i < size) {
+        vec_push(&s->vec, (void *) &i);
+        i++;
+    }
+
+    return size;
+}
+
+int64_t bench_vec_push_presized(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    s->vec = vec_with_cap(sizeof(int64_t), size);
+
+    int64_t i = 0;
+    while (i < size) {
+        vec_push(&s->vec, (void *) &i);
+        i++;
+    }
+
+    return size;
+}
+
+int64_t bench_vec_get_random(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        int64_t value = 0;
+        vec_get(&s->vec, s->indices[i], (void *) &value);
+        sum += value;
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_vec_iterate(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        sum += *(int64_t *) vec_get_ptr(&s->vec, i);
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_ptrvec_push(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    s->ptrvec = ptrvec_create();
+
+    int64_t i = 0;
+    while (i < size) {
+        ptrvec_push_ptr(&s->ptrvec, (void *) (intptr_t) (i + 1));
+        i++;
+    }
+
+    return size;
+}
+
+int64_t bench_ptrvec_get_random(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        sum += (uint64_t) (intptr_t) ptrvec_get(&s->ptrvec, s->indices[i]);
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_ptrvec_pop(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    while (!ptrvec_is_empty(&s->ptrvec)) {
+        sum += (uint64_t) (intptr_t) ptrvec_pop(&s->ptrvec);
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+// starts from an empty map, so every doubling of the table is part of the measurement
+int64_t bench_map_insert(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    s->map = map_create();
+
+    int64_t i = 0;
+    while (i < size) {
+        map_insert(&s->map, containers_key(s, i), (void *) (intptr_t) (i + 1));
+        i++;
+    }
+
+    return size;
+}
+
+int64_t bench_map_insert_presized(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    s->map = map_with_cap(next_pow_of_2(size * 2));
+
+    int64_t i = 0;
+    while (i < size) {
+        map_insert(&s->map, containers_key(s, i), (void *) (intptr_t) (i + 1));
+        i++;
+    }
+
+    return size;
+}
+
+int64_t bench_map_get_hit(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        sum += (uint64_t) (intptr_t) map_get(&s->map, containers_key(s, s->indices[i]));
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_map_get_miss(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    char key[KEY_SLOT];
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        int32_t len = snprintf(key, KEY_SLOT, "missing_%ld", (long) s->indices[i]);
+        sum += (uint64_t) (intptr_t) map_get(&s->map, map_create_key(len, key));
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_span_create(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    s->si = span_create_interner();
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        uint32_t len = (i % 2) == 0 ? 8 : MAX_LEN + 8;
+        Span span = span_create(&s->si, i * 16, i * 16 + len, 0);
+        sum += span.ctx_or_idx;
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_span_get(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        sum += span_get(&s->si, s->spans[s->indices[i]]).len;
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+int64_t bench_fmt_str(void *state, int64_t size) {
+    ContainerState *s = (ContainerState *) state;
+    uint64_t sum = 0;
+
+    int64_t i = 0;
+    while (i < size) {
+        const char *str = fmt_str("%s/%s", "stdlib", s->keys + (i % size) * KEY_SLOT);
+        sum += (uint64_t) str[0];
+        free((void *) str);
+        i++;
+    }
+
+    bench_consume(sum);
+
+    return size;
+}
+
+BenchCase bench_cases[] = {
+    { "vec_push", 1048576, containers_setup_empty, bench_vec_push, containers_teardown },
+    { "vec_push_presized", 1048576, containers_setup_empty, bench_vec_push_presized, containers_teardown },
+    { "vec_get_random", 1048576, containers_setup_vec, bench_vec_get_random, containers_teardown },
+    { "vec_iterate", 1048576, containers_setup_vec, bench_vec_iterate, containers_teardown },
+    { "ptrvec_push", 1048576, containers_setup_empty, bench_ptrvec_push, containers_teardown },
+    { "ptrvec_get_random", 1048576, containers_setup_ptrvec, bench_ptrvec_get_random, containers_teardown },
+    // popping is linear in the length, larger sizes take minutes
+    { "ptrvec_pop", 1024, containers_setup_ptrvec, bench_ptrvec_pop, containers_teardown },
+    { "map_insert", 1048576, containers_setup_keys, bench_map_insert, containers_teardown },
+    { "map_insert_presized", 1048576, containers_setup_keys, bench_map_insert_presized, containers_teardown },
+    { "map_get_hit", 1048576, containers_setup_map, bench_map_get_hit, containers_teardown },
+    { "map_get_miss", 1048576, containers_setup_map, bench_map_get_miss, containers_teardown },
+    { "span_create", 65536, containers_setup_empty, bench_span_create, containers_teardown },
+    { "span_get", 65536, containers_setup_spans, bench_span_get, containers_teardown },
+    { "fmt_str", 65536, containers_setup_keys, bench_fmt_str, containers_teardown }
+};
+
+int32_t bench_num_cases = sizeof(bench_cases) / sizeof(BenchCase);
@@ -0,0 +1,292 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "gen.h"
+#include "bench.h"
+#include "../include/timer.h"
+
+#define E2E_MAX_SIZES 16
+#define E2E_MAX_RUNS 32
+
+typedef struct E2EOptions {
+    const char *compiler;
+    const char *dir;
+    const char *json_file;
+    int32_t num_sizes;
+    int64_t sizes[E2E_MAX_SIZES];
+    int32_t num_runs;
+    GenConfig gen;
+} E2EOptions;
+
+typedef struct E2EResult {
+    int64_t lines;
+    int64_t bytes;
+    int64_t tokens;
+    int32_t files;
+    int32_t num_runs;
+    double seconds[E2E_MAX_RUNS];
+    int64_t peak_rss_kb;
+    int32_t exit_code;
+} E2EResult;
+
+int64_t e2e_read_stat(const char *path, const char *name) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        return -1;
+    }
+
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\": ", name);
+
+    char line[4096];
+    int64_t value = -1;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        const char *stats = strstr(line, "\"stats\"");
+        const char *p = stats != NULL ? strstr(stats, key) : NULL;
+
+        if (p != NULL) {
+            value = strtoll(p + strlen(key), NULL, 10);
+            break;
+        }
+    }
+
+    fclose(in);
+
+    return value;
+}
+
+// the compiler runs as a child process, so its peak RSS is not mixed up with the generator's
+bool e2e_run_compiler(E2EOptions *opts, GenProject *p, const char *report, double *seconds, int64_t *rss_kb, int32_t *exit_code) {
+    const char **argv = (const char **) malloc((p->num_files + 4) * sizeof(const char *));
+    char *report_arg = (char *) malloc(strlen(report) + 32);
+    int32_t argc = 0;
+
+    sprintf(report_arg, "--time-report-file=%s", report);
+
+    argv[argc++] = opts->compiler;
+    argv[argc++] = "--time-report=json";
+    argv[argc++] = report_arg;
+
+    int32_t i = 0;
+    while (i < p->num_files) {
+        argv[argc++] = p->files[i];
+        i++;
+    }
+
+    argv[argc] = NULL;
+
+    fflush(stdout);
+
+    uint64_t start = timer_now_ns();
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        execv(opts->compiler, (char *const *) argv);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    bool ok = pid > 0 && wait4(pid, &status, 0, &usage) == pid;
+    uint64_t end = timer_now_ns();
+
+    free((void *) report_arg);
+    free((void *) argv);
+
+    if (!ok) {
+        printf("[error] could not run '%s': %s\n", opts->compiler, strerror(errno));
+        return false;
+    }
+
+    *seconds = (end - start) / 1e9;
+    *rss_kb = usage.ru_maxrss;
+    *exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    return true;
+}
+
+bool e2e_run_size(E2EOptions *opts, int64_t lines, E2EResult *r) {
+    char dir[4096];
+    char report[4096 + 16];
+
+    snprintf(dir, sizeof(dir), "%s/%ld", opts->dir, (long) lines);
+    snprintf(report, sizeof(report), "%s/report.json", dir);
+
+    GenConfig cfg = opts->gen;
+    cfg.target_lines = lines;
+
+    GenProject p = { 0, NULL, 0, 0 };
+    if (!gen_project(&cfg, dir, &p)) {
+        return false;
+    }
+
+    r->lines = p.lines;
+    r->bytes = p.bytes;
+    r->files = p.num_files;
+    r->num_runs = 0;
+    r->peak_rss_kb = 0;
+    r->exit_code = 0;
+
+    while (r->num_runs < opts->num_runs) {
+        int64_t rss_kb = 0;
+
+        if (!e2e_run_compiler(opts, &p, report, &r->seconds[r->num_runs], &rss_kb, &r->exit_code)) {
+            gen_free_project(&p);
+            return false;
+        }
+
+        if (rss_kb > r->peak_rss_kb) {
+            r->peak_rss_kb = rss_kb;
+        }
+
+        r->num_runs++;
+    }
+
+    r->tokens = e2e_read_stat(report, "tokens");
+
+    gen_free_project(&p);
+
+    return true;
+}
+
+bool e2e_parse_sizes(E2EOptions *opts, const char *list) {
+    opts->num_sizes = 0;
+
+    while (*list != '\0' && opts->num_sizes < E2E_MAX_SIZES) {
+        char *end = NULL;
+        int64_t size = strtoll(list, &end, 10);
+
+        if (end == list || size <= 0) {
+            return false;
+        }
+
+        if (*end == 'k' || *end == 'K') {
+            size *= 1000;
+            end++;
+        } else if (*end == 'm' || *end == 'M') {
+            size *= 1000000;
+            end++;
+        }
+
+        opts->sizes[opts->num_sizes++] = size;
+        list = *end == ',' ? end + 1 : end;
+    }
+
+    return opts->num_sizes > 0;
+}
+
+bool e2e_parse_options(E2EOptions *opts, int32_t argc, const char **argv) {
+    int32_t i = 0;
+
+    while (i < argc) {
+        const char *arg = argv[i];
+
+        if (strncmp(arg, "--compiler=", 11) == 0) {
+            opts->compiler = arg + 11;
+        } else if (strncmp(arg, "--dir=", 6) == 0) {
+            opts->dir = arg + 6;
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            opts->json_file = arg + 7;
+        } else if (strncmp(arg, "--runs=", 7) == 0) {
+            opts->num_runs = atoi(arg + 7);
+
+            if (opts->num_runs < 1 || opts->num_runs > E2E_MAX_RUNS) {
+                printf("[error] --runs must be between 1 and %d\n", E2E_MAX_RUNS);
+                return false;
+            }
+        } else if (strncmp(arg, "--sizes=", 8) == 0) {
+            if (!e2e_parse_sizes(opts, arg + 8)) {
+                printf("[error] invalid size list '%s'\n", arg + 8);
+                return false;
+            }
+        } else if (!gen_parse_option(&opts->gen, arg)) {
+            printf("[error] unknown option '%s'\n", arg);
+            printf("usage: synthium-e2e [--compiler=path] [--dir=path] [--sizes=1k,100k,10m] [--runs=N] [--json=file]\n    %s\n", gen_usage());
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    E2EOptions opts = {
+        .compiler = "./synthiumc",
+        .dir = "bench/projects",
+        .json_file = NULL,
+        .num_sizes = 3,
+        .sizes = { 1000, 100000, 10000000 },
+        .num_runs = 3,
+        .gen = gen_default_config()
+    };
+
+    if (!e2e_parse_options(&opts, argc - 1, (const char **) argv + 1)) {
+        return -1;
+    }
+
+    if (mkdir(opts.dir, 0755) != 0 && errno != EEXIST) {
+        printf("[error] could not create '%s': %s\n", opts.dir, strerror(errno));
+        return -1;
+    }
+
+    FILE *json = NULL;
+    if (opts.json_file != NULL && (json = fopen(opts.json_file, "w")) == NULL) {
+        printf("[error] could not open '%s'\n", opts.json_file);
+        return -1;
+    }
+
+    printf("%12s %7s %12s %10s %14s %14s %12s %9s\n", "lines", "files", "tokens", "seconds", "lines/sec", "tokens/sec", "peak rss kb", "scaling");
+
+    double base_ns_per_line = 0;
+    int32_t i = 0;
+
+    while (i < opts.num_sizes) {
+        E2EResult r;
+
+        if (!e2e_run_size(&opts, opts.sizes[i], &r)) {
+            return -1;
+        }
+
+        double seconds = bench_median(r.seconds, r.num_runs);
+        double ns_per_line = seconds * 1e9 / r.lines;
+
+        // time per line relative to the smallest project, 1.00 means linear scaling
+        if (i == 0) {
+            base_ns_per_line = ns_per_line;
+        }
+
+        printf("%12ld %7d %12ld %10.3f %14.0f %14.0f %12ld %9.2f%s\n",
+            (long) r.lines, r.files, (long) r.tokens, seconds, r.lines / seconds, r.tokens / seconds,
+            (long) r.peak_rss_kb, ns_per_line / base_ns_per_line, r.exit_code != 0 ? "  (compile errors)" : "");
+        fflush(stdout);
+
+        if (json != NULL) {
+            fprintf(json, "{\"lines\": %ld, \"files\": %d, \"bytes\": %ld, \"tokens\": %ld, \"peak_rss_kb\": %ld, \"exit_code\": %d, \"seconds\": [",
+                (long) r.lines, r.files, (long) r.bytes, (long) r.tokens, (long) r.peak_rss_kb, r.exit_code);
+
+            int32_t j = 0;
+            while (j < r.num_runs) {
+                fprintf(json, "%s%.6f", j > 0 ? ", " : "", r.seconds[j]);
+                j++;
+            }
+
+            fprintf(json, "]}\n");
+        }
+
+        i++;
+    }
+
+    if (json != NULL) {
+        fclose(json);
+    }
+
+    return 0;
+}
@@ -0,0 +1,498 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "gen.h"
+#include "bench.h"
+
+#define GEN_MAX_IMPORTS 64
+
+static const char *gen_words[] = {
+    "compute", "the", "offset", "of", "each", "field", "before", "layout", "is", "known",
+    "cache", "result", "so", "later", "lookups", "stay", "cheap", "walk", "all", "nodes"
+};
+
+static const char *gen_binary_ops[] = { "+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=", "&&", "||" };
+
+static const int32_t gen_num_words = sizeof(gen_words) / sizeof(char *);
+static const int32_t gen_num_binary_ops = sizeof(gen_binary_ops) / sizeof(char *);
+
+GenConfig gen_default_config() {
+    GenConfig cfg = {
+        .seed = 1,
+        .target_lines = 0,
+        .num_modules = 8,
+        .fanout = 3,
+        .num_structs = 6,
+        .num_fields = 4,
+        .nesting = 3,
+        .num_functions = 24,
+        .num_stmts = 6,
+        .expr_depth = 3,
+        .comment_pct = 15,
+        .long_literal_pct = 5
+    };
+
+    return cfg;
+}
+
+bool gen_parse_int(const char *arg, const char *name, int64_t *dest) {
+    size_t len = strlen(name);
+
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+
+    *dest = strtoll(arg + len + 1, NULL, 10);
+
+    return true;
+}
+
+bool gen_parse_option(GenConfig *cfg, const char *arg) {
+    int64_t v = 0;
+
+    if (gen_parse_int(arg, "--seed", &v)) cfg->seed = (uint64_t) v != 0 ? (uint64_t) v : 1;
+    else if (gen_parse_int(arg, "--lines", &v)) cfg->target_lines = v;
+    else if (gen_parse_int(arg, "--modules", &v)) cfg->num_modules = (int32_t) v;
+    else if (gen_parse_int(arg, "--fanout", &v)) cfg->fanout = (int32_t) v;
+    else if (gen_parse_int(arg, "--structs", &v)) cfg->num_structs = (int32_t) v;
+    else if (gen_parse_int(arg, "--fields", &v)) cfg->num_fields = (int32_t) v;
+    else if (gen_parse_int(arg, "--nesting", &v)) cfg->nesting = (int32_t) v;
+    else if (gen_parse_int(arg, "--functions", &v)) cfg->num_functions = (int32_t) v;
+    else if (gen_parse_int(arg, "--stmts", &v)) cfg->num_stmts = (int32_t) v;
+    else if (gen_parse_int(arg, "--expr-depth", &v)) cfg->expr_depth = (int32_t) v;
+    else if (gen_parse_int(arg, "--comments", &v)) cfg->comment_pct = (int32_t) v;
+    else if (gen_parse_int(arg, "--long-literals", &v)) cfg->long_literal_pct = (int32_t) v;
+    else return false;
+
+    if (cfg->fanout > GEN_MAX_IMPORTS) {
+        cfg->fanout = GEN_MAX_IMPORTS;
+    }
+
+    return true;
+}
+
+const char *gen_usage() {
+    return "[--seed=N] [--lines=N] [--modules=N] [--fanout=N] [--structs=N] [--fields=N] [--nesting=N]\n"
+        "    [--functions=N] [--stmts=N] [--expr-depth=N] [--comments=PCT] [--long-literals=PCT]";
+}
+
+int32_t gen_rand(GenWriter *w, int32_t bound) {
+    if (bound <= 0) {
+        return 0;
+    }
+
+    return (int32_t) (bench_rand(&w->rng) % (uint64_t) bound);
+}
+
+bool gen_chance(GenWriter *w, int32_t pct) {
+    return gen_rand(w, 100) < pct;
+}
+
+void gen_write(GenWriter *w, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int32_t n = vfprintf(w->out, fmt, args);
+    va_end(args);
+
+    if (n > 0) {
+        w->bytes += n;
+    }
+}
+
+void gen_newline(GenWriter *w) {
+    fputc('\n', w->out);
+    w->bytes++;
+    w->lines++;
+}
+
+void gen_indent(GenWriter *w, int32_t indent) {
+    int32_t i = 0;
+    while (i < indent) {
+        gen_write(w, "    ");
+        i++;
+    }
+}
+
+void gen_comment(GenWriter *w, GenConfig *cfg, int32_t indent) {
+    if (!gen_chance(w, cfg->comment_pct)) {
+        return;
+    }
+
+    gen_indent(w, indent);
+    gen_write(w, "//");
+
+    int32_t words = 3 + gen_rand(w, 8);
+    int32_t i = 0;
+
+    while (i < words) {
+        gen_write(w, " %s", gen_words[gen_rand(w, gen_num_words)]);
+        i++;
+    }
+
+    gen_newline(w);
+}
+
+void gen_string(GenWriter *w, GenConfig *cfg) {
+    int32_t words = gen_chance(w, cfg->long_literal_pct) ? 40 + gen_rand(w, 80) : 1 + gen_rand(w, 4);
+    int32_t i = 0;
+
+    gen_write(w, "\"");
+
+    while (i < words) {
+        gen_write(w, "%s%s", i > 0 ? " " : "", gen_words[gen_rand(w, gen_num_words)]);
+        i++;
+    }
+
+    gen_write(w, "\"");
+}
+
+// locals are v0 .. v(num_locals - 1), functions can only call the ones defined before them
+void gen_expr(GenWriter *w, GenConfig *cfg, int32_t depth, int32_t num_locals, int32_t fn_idx) {
+    int32_t choice = depth <= 0 ? gen_rand(w, 3) : gen_rand(w, 10);
+
+    switch (choice) {
+        case 0: {
+            gen_write(w, "%d", gen_rand(w, 1000));
+            break;
+        }
+
+        case 1:
+        case 2: {
+            if (num_locals > 0 && gen_chance(w, 60)) {
+                gen_write(w, "v%d", gen_rand(w, num_locals));
+            } else {
+                gen_write(w, "%s", gen_chance(w, 50) ? "a" : "b");
+            }
+
+            break;
+        }
+
+        case 3: {
+            gen_write(w, "(");
+            gen_expr(w, cfg, depth - 1, num_locals, fn_idx);
+            gen_write(w, ")");
+            break;
+        }
+
+        case 4: {
+            if (fn_idx > 0) {
+                gen_write(w, "f%d(", gen_rand(w, fn_idx));
+                gen_expr(w, cfg, depth - 1, num_locals, fn_idx);
+                gen_write(w, ", ");
+                gen_expr(w, cfg, depth - 1, num_locals, fn_idx);
+                gen_write(w, ")");
+                break;
+            }
+
+            gen_write(w, "-(");
+            gen_expr(w, cfg, depth - 1, num_locals, fn_idx);
+            gen_write(w, ")");
+            break;
+        }
+
+        default: {
+            gen_expr(w, cfg, depth - 1, num_locals, fn_idx);
+            gen_write(w, " %s ", gen_binary_ops[gen_rand(w, gen_num_binary_ops)]);
+            gen_expr(w, cfg, depth - 1, num_locals, fn_idx);
+            break;
+        }
+    }
+}
+
+void gen_struct(GenWriter *w, GenConfig *cfg, int32_t idx, int32_t *imports, int32_t num_imports) {
+    int32_t level = cfg->nesting > 0 ? idx % (cfg->nesting + 1) : 0;
+
+    gen_comment(w, cfg, 0);
+    gen_write(w, "type S%d struct {", idx);
+    gen_newline(w);
+
+    int32_t i = 0;
+    while (i < cfg->num_fields) {
+        gen_indent(w, 1);
+        gen_write(w, "x%d: ", i);
+
+        // every struct of level n embeds one of level n - 1, so struct k nests k % (nesting + 1) deep
+        if (i == 0 && level > 0) {
+            if (num_imports > 0 && gen_chance(w, 50)) {
+                gen_write(w, "mod%d.S%d", imports[gen_rand(w, num_imports)], level - 1);
+            } else {
+                gen_write(w, "S%d", idx - 1);
+            }
+        } else if (i == 1) {
+            gen_write(w, "*S%d", idx);
+        } else {
+            gen_write(w, "i32");
+        }
+
+        gen_write(w, "%s", i + 1 < cfg->num_fields ? "," : "");
+        gen_newline(w);
+
+        i++;
+    }
+
+    gen_write(w, "}");
+    gen_newline(w);
+    gen_newline(w);
+}
+
+// the index of an i32 field of struct idx, or -1 when all of its fields are structs or pointers
+int32_t gen_int_field(GenConfig *cfg, int32_t idx) {
+    int32_t level = cfg->nesting > 0 ? idx % (cfg->nesting + 1) : 0;
+
+    if (cfg->num_fields > 2) {
+        return cfg->num_fields - 1;
+    }
+
+    return cfg->num_fields > 0 && level == 0 ? 0 : -1;
+}
+
+void gen_stmt(GenWriter *w, GenConfig *cfg, int32_t indent, int32_t *num_locals, int32_t fn_idx, int32_t *imports, int32_t num_imports) {
+    gen_comment(w, cfg, indent);
+    gen_indent(w, indent);
+
+    int32_t choice = gen_rand(w, 10);
+
+    if (*num_locals == 0 || choice < 3) {
+        gen_write(w, "let v%d = ", (*num_locals)++);
+        gen_expr(w, cfg, cfg->expr_depth, *num_locals - 1, fn_idx);
+        gen_write(w, ";");
+        gen_newline(w);
+        return;
+    }
+
+    int32_t local = gen_rand(w, *num_locals);
+
+    switch (choice) {
+        case 3: {
+            gen_write(w, "if ");
+            gen_expr(w, cfg, 1, *num_locals, fn_idx);
+            gen_write(w, " {");
+            gen_newline(w);
+
+            gen_indent(w, indent + 1);
+            gen_write(w, "v%d = ", local);
+            gen_expr(w, cfg, cfg->expr_depth, *num_locals, fn_idx);
+            gen_write(w, ";");
+            gen_newline(w);
+
+            gen_indent(w, indent);
+            gen_write(w, "} else {");
+            gen_newline(w);
+
+            gen_indent(w, indent + 1);
+            gen_write(w, "v%d = v%d + 1;", local, local);
+            gen_newline(w);
+
+            gen_indent(w, indent);
+            gen_write(w, "}");
+            gen_newline(w);
+            break;
+        }
+
+        case 4: {
+            gen_write(w, "while v%d < %d {", local, gen_rand(w, 100));
+            gen_newline(w);
+
+            gen_indent(w, indent + 1);
+            gen_write(w, "v%d = v%d + ", local, local);
+            gen_expr(w, cfg, 1, *num_locals, fn_idx);
+            gen_write(w, ";");
+            gen_newline(w);
+
+            gen_indent(w, indent);
+            gen_write(w, "}");
+            gen_newline(w);
+            break;
+        }
+
+        case 5: {
+            gen_write(w, "puts(");
+            gen_string(w, cfg);
+            gen_write(w, ");");
+            gen_newline(w);
+            break;
+        }
+
+        case 6: {
+            if (num_imports > 0) {
+                gen_write(w, "let v%d = mod%d.f%d(a, v%d);", (*num_locals)++, imports[gen_rand(w, num_imports)], gen_rand(w, cfg->num_functions), local);
+                gen_newline(w);
+                break;
+            }
+
+            gen_write(w, "v%d = v%d * 2;", local, local);
+            gen_newline(w);
+            break;
+        }
+
+        case 7: {
+            int32_t s = cfg->num_structs > 0 ? gen_rand(w, cfg->num_structs) : 0;
+            int32_t field = cfg->num_structs > 0 ? gen_int_field(cfg, s) : -1;
+
+            // the pointer is never stored in a local, so it is never picked as one of the i32 locals
+            if (field >= 0) {
+                gen_write(w, "delete new S%d { x%d: v%d };", s, field, local);
+                gen_newline(w);
+                break;
+            }
+
+            gen_write(w, "v%d = v%d - 1;", local, local);
+            gen_newline(w);
+            break;
+        }
+
+        default: {
+            gen_write(w, "v%d = ", local);
+            gen_expr(w, cfg, cfg->expr_depth, *num_locals, fn_idx);
+            gen_write(w, ";");
+            gen_newline(w);
+            break;
+        }
+    }
+}
+
+void gen_function(GenWriter *w, GenConfig *cfg, int32_t idx, int32_t *imports, int32_t num_imports) {
+    gen_comment(w, cfg, 0);
+    gen_write(w, "fn f%d(a: i32, b: i32): i32 {", idx);
+    gen_newline(w);
+
+    int32_t num_locals = 0;
+    int32_t i = 0;
+
+    while (i < cfg->num_stmts) {
+        gen_stmt(w, cfg, 1, &num_locals, idx, imports, num_imports);
+        i++;
+    }
+
+    gen_indent(w, 1);
+    gen_write(w, "return ");
+    gen_expr(w, cfg, cfg->expr_depth, num_locals, idx);
+    gen_write(w, ";");
+    gen_newline(w);
+
+    gen_write(w, "}");
+    gen_newline(w);
+    gen_newline(w);
+}
+
+// modules only import modules with a lower index, so the import graph never has a cycle
+int32_t gen_pick_imports(GenWriter *w, GenConfig *cfg, int32_t mod_idx, int32_t *imports) {
+    int32_t wanted = cfg->fanout < mod_idx ? cfg->fanout : mod_idx;
+    int32_t num = 0;
+
+    while (num < wanted) {
+        int32_t candidate = gen_rand(w, mod_idx);
+        bool seen = false;
+        int32_t i = 0;
+
+        while (i < num) {
+            seen |= imports[i] == candidate;
+            i++;
+        }
+
+        if (!seen) {
+            imports[num++] = candidate;
+        }
+    }
+
+    return num;
+}
+
+void gen_module(GenWriter *w, GenConfig *cfg, int32_t mod_idx) {
+    int32_t imports[GEN_MAX_IMPORTS];
+    int32_t num_imports = gen_pick_imports(w, cfg, mod_idx, imports);
+    int32_t i = 0;
+
+    gen_write(w, "// generated module %d, seed %lu", mod_idx, (unsigned long) cfg->seed);
+    gen_newline(w);
+
+    while (i < num_imports) {
+        gen_write(w, "import \"mod%d\";", imports[i]);
+        gen_newline(w);
+        i++;
+    }
+
+    gen_newline(w);
+    gen_write(w, "extern fn puts(s: string): i32;");
+    gen_newline(w);
+    gen_newline(w);
+
+    gen_write(w, "let limit = %d;", gen_rand(w, 10000));
+    gen_newline(w);
+    gen_write(w, "let banner = ");
+    gen_string(w, cfg);
+    gen_write(w, ";");
+    gen_newline(w);
+    gen_newline(w);
+
+    i = 0;
+    while (i < cfg->num_structs) {
+        gen_struct(w, cfg, i, imports, num_imports);
+        i++;
+    }
+
+    i = 0;
+    while (i < cfg->num_functions) {
+        gen_function(w, cfg, i, imports, num_imports);
+        i++;
+    }
+}
+
+bool gen_project(GenConfig *cfg, const char *dir, GenProject *dest) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        printf("[error] could not create '%s': %s\n", dir, strerror(errno));
+        return false;
+    }
+
+    GenWriter w = {
+        .out = NULL,
+        .rng = cfg->seed * 0x9e3779b97f4a7c15ull + 1,
+        .lines = 0,
+        .bytes = 0
+    };
+
+    int32_t cap = 16;
+    dest->files = (char **) malloc(cap * sizeof(char *));
+    dest->num_files = 0;
+
+    while (cfg->target_lines > 0 ? w.lines < cfg->target_lines : dest->num_files < cfg->num_modules) {
+        if (dest->num_files >= cap) {
+            cap *= 2;
+            dest->files = (char **) realloc(dest->files, cap * sizeof(char *));
+        }
+
+        char *path = (char *) malloc(strlen(dir) + 32);
+        sprintf(path, "%s/mod%d.syn", dir, dest->num_files);
+
+        if ((w.out = fopen(path, "w")) == NULL) {
+            printf("[error] could not write '%s': %s\n", path, strerror(errno));
+            free((void *) path);
+            gen_free_project(dest);
+            return false;
+        }
+
+        gen_module(&w, cfg, dest->num_files);
+        fclose(w.out);
+
+        dest->files[dest->num_files++] = path;
+    }
+
+    dest->lines = w.lines;
+    dest->bytes = w.bytes;
+
+    return true;
+}
+
+void gen_free_project(GenProject *p) {
+    int32_t i = 0;
+    while (i < p->num_files) {
+        free((void *) p->files[i]);
+        i++;
+    }
+
+    free((void *) p->files);
+    p->files = NULL;
+    p->num_files = 0;
+}
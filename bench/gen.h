@@ -0,0 +1,45 @@
+#ifndef SYNTHIUMC_GEN_H
+#define SYNTHIUMC_GEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct GenConfig {
+    uint64_t seed;
+    // when set, modules are added until the project has at least this many lines and num_modules is ignored
+    int64_t target_lines;
+    int32_t num_modules;
+    int32_t fanout;
+    int32_t num_structs;
+    int32_t num_fields;
+    int32_t nesting;
+    int32_t num_functions;
+    int32_t num_stmts;
+    int32_t expr_depth;
+    int32_t comment_pct;
+    int32_t long_literal_pct;
+} GenConfig;
+
+typedef struct GenProject {
+    int32_t num_files;
+    char **files;
+    int64_t lines;
+    int64_t bytes;
+} GenProject;
+
+typedef struct GenWriter {
+    FILE *out;
+    uint64_t rng;
+    int64_t lines;
+    int64_t bytes;
+} GenWriter;
+
+GenConfig gen_default_config();
+bool gen_parse_option(GenConfig *cfg, const char *arg);
+const char *gen_usage();
+bool gen_project(GenConfig *cfg, const char *dir, GenProject *dest);
+void gen_free_project(GenProject *p);
+
+#endif
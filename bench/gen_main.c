@@ -0,0 +1,36 @@
+#include <string.h>
+
+#include "gen.h"
+
+int main(int argc, char **argv) {
+    GenConfig cfg = gen_default_config();
+    const char *dir = NULL;
+    int32_t i = 1;
+
+    while (i < argc) {
+        if (strncmp(argv[i], "--", 2) != 0 && dir == NULL) {
+            dir = argv[i];
+        } else if (!gen_parse_option(&cfg, argv[i])) {
+            printf("[error] unknown option '%s'\n", argv[i]);
+            dir = NULL;
+            break;
+        }
+
+        i++;
+    }
+
+    if (dir == NULL) {
+        printf("usage: synthium-gen <dir> %s\n", gen_usage());
+        return -1;
+    }
+
+    GenProject p = { 0, NULL, 0, 0 };
+    if (!gen_project(&cfg, dir, &p)) {
+        return -1;
+    }
+
+    printf("%d modules, %ld lines, %ld bytes\n", p.num_files, (long) p.lines, (long) p.bytes);
+    gen_free_project(&p);
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "bench.h"
+#include "astwalk.h"
+#include "../include/vm.h"
+#include "../include/escape.h"
+#include "../include/gvn.h"
+#include "../include/mod.h"
+#include "../include/loop.h"
+#include "../include/path.h"
+#include "../include/sccp.h"
+#include "../include/sroa.h"
+#include "../include/pass.h"
+#include "../include/lower.h"
+#include "../include/inliner.h"
+#include "../include/timer.h"
+#include "../include/reader.h"
+#include "../include/parser.h"
+#include "../include/typecheck.h"
+
+#define VMBENCH_MAX_PROGRAMS 32
+#define VMBENCH_MAX_RUNS 32
+
+static const char *const vmbench_default_programs[] = {
+    "bench/programs/fib.syn",
+    "bench/programs/loops.syn",
+    "bench/programs/fields.syn",
+    "bench/programs/arraysum.syn",
+    "bench/programs/matrix.syn"
+};
+#define VMBENCH_NUM_DEFAULT_PROGRAMS ((int32_t) (sizeof(vmbench_default_programs) / sizeof(vmbench_default_programs[0])))
+
+typedef struct VmBenchOptions {
+    const char *json_file;
+    int32_t num_runs;
+    int32_t opt_level;
+    int32_t num_programs;
+    const char *programs[VMBENCH_MAX_PROGRAMS];
+} VmBenchOptions;
+
+// the front end of one program, kept alive while the interpreters and the jit run it
+typedef struct VmBenchProgram {
+    SpanInterner si;
+    FileMap fm;
+    ModuleMap mm;
+    TypeChecker tc;
+    IrModule ir;
+} VmBenchProgram;
+
+typedef struct VmBenchResult {
+    double walker[VMBENCH_MAX_RUNS];
+    double vm[VMBENCH_MAX_RUNS];
+    double jit[VMBENCH_MAX_RUNS];
+    int64_t walker_result;
+    int64_t vm_result;
+    int64_t jit_result;
+    int64_t num_insts;
+    bool ok;
+} VmBenchResult;
+
+// the same steps as the compiler up to lowering and its optimisations, errors are only counted
+bool vmbench_compile(VmBenchProgram *p, Path *compiler_path, const char *file, int32_t opt_level) {
+    p->si = span_create_interner();
+    p->fm = reader_create();
+    p->ir = ir_module_create();
+
+    if (reader_add_std_lib(&p->fm, compiler_path).err_code != 0 || reader_add_all(&p->fm, compiler_path, 1, &file).err_code != 0) {
+        printf("[error] could not read '%s'\n", file);
+        p->mm = mod_map_with_cap(1);
+        p->tc = typecheck_create(&p->si, &p->mm);
+        return false;
+    }
+
+    int32_t num_errs = 0;
+    p->mm = mod_map_with_cap(reader_num_files(&p->fm));
+
+    int32_t i = 0;
+    while (i < reader_num_files(&p->fm)) {
+        Parser parser = parser_create(reader_get_by_idx(&p->fm, i), &p->si, i);
+        mod_add_mod(&p->mm, parser_parse(&parser));
+        num_errs += parser_num_errs(&parser);
+        parser_free_p(&parser);
+
+        i++;
+    }
+
+    p->tc = typecheck_create(&p->si, &p->mm);
+    typecheck_check(&p->tc);
+    num_errs += typecheck_num_errs(&p->tc);
+
+    if (num_errs > 0) {
+        printf("[error] '%s' has %d errors, compile it with synthiumc to see them\n", file, num_errs);
+        return false;
+    }
+
+    Lowerer lowerer = lower_create(&p->ir, &p->mm, &p->si);
+    lower_all(&lowerer);
+    lower_free(&lowerer);
+
+    if (opt_level >= 1) {
+        InlineParams inline_params = inliner_params(opt_level, -1);
+        LoopParams loop_params = {
+            .opt_level = opt_level,
+            .vectorize = false
+        };
+        Pool *pool = pool_create(1);
+        PassManager pm = pass_manager_create(&p->ir, pool);
+
+        pass_manager_add(&pm, inliner_pass(&inline_params));
+        pass_manager_add(&pm, escape_pass());
+        pass_manager_add(&pm, sroa_pass());
+        pass_manager_add(&pm, sccp_pass());
+        pass_manager_add(&pm, gvn_pass());
+        pass_manager_add(&pm, loop_pass(&loop_params));
+
+        if (opt_level >= 2) {
+            pass_manager_add(&pm, gvn_pass());
+        }
+
+        pass_manager_run(&pm);
+        pass_manager_free(&pm);
+        pool_free(pool);
+    }
+
+    return true;
+}
+
+void vmbench_free_program(VmBenchProgram *p) {
+    ir_module_free(&p->ir);
+    typecheck_free_tc(&p->tc);
+    reader_free_fm(&p->fm);
+    mod_free_map(&p->mm);
+    span_free_interner(&p->si);
+}
+
+// a fresh vm per run, so the jit compiles the program again every time and its compile time is measured
+bool vmbench_run_vm(BcModule *bc, BcFunc *main_func, int64_t *args, bool jit, double *time, int64_t *result, const char *file) {
+    Vm vm = vm_create(bc, jit);
+    uint64_t start = timer_now_ns();
+    bool ok = vm_call(&vm, main_func, args, 2, result);
+    *time = (timer_now_ns() - start) / 1e9;
+
+    if (!ok) {
+        printf("[error] the %s stopped in '%s' running '%s': %s\n", jit ? "jit" : "vm", vm.error_func, file, vm.error);
+    }
+
+    vm_free(&vm);
+
+    return ok;
+}
+
+bool vmbench_run(VmBenchOptions *opts, VmBenchProgram *p, const char *file, VmBenchResult *r) {
+    BcModule bc = bc_compile(&p->ir);
+    BcFunc *main_func = bc_lookup(&bc, "main");
+    IrFunc *main_ir = ir_func_lookup(&p->ir, "main", 4);
+    const char *argv[2] = { file, NULL };
+    int64_t args[2] = { 1, (int64_t) (intptr_t) argv };
+
+    r->ok = false;
+    r->num_insts = bc.num_insts;
+
+    if (main_func == NULL || main_ir == NULL) {
+        printf("[error] '%s' has no main function\n", file);
+        bc_free(&bc);
+        return false;
+    }
+
+    int32_t i = 0;
+    while (i < opts->num_runs) {
+        AstWalker w = astwalk_create(&p->mm, &bc, &p->si);
+        uint64_t start = timer_now_ns();
+        bool ok = astwalk_call(&w, main_ir->idx, args, 2, &r->walker_result);
+        r->walker[i] = (timer_now_ns() - start) / 1e9;
+
+        if (!ok) {
+            printf("[error] the AST walker stopped in '%s': %s\n", file, w.error);
+        }
+
+        astwalk_free(&w);
+
+        bool vm_ok = vmbench_run_vm(&bc, main_func, args, false, &r->vm[i], &r->vm_result, file);
+        bool jit_ok = vmbench_run_vm(&bc, main_func, args, true, &r->jit[i], &r->jit_result, file);
+
+        if (!ok || !vm_ok || !jit_ok) {
+            bc_free(&bc);
+            return false;
+        }
+
+        i++;
+    }
+
+    r->ok = (int32_t) r->walker_result == (int32_t) r->vm_result && (int32_t) r->vm_result == (int32_t) r->jit_result;
+    bc_free(&bc);
+
+    return true;
+}
+
+bool vmbench_parse_options(VmBenchOptions *opts, int32_t argc, const char **argv) {
+    int32_t i = 0;
+
+    while (i < argc) {
+        const char *arg = argv[i];
+
+        if (strncmp(arg, "--json=", 7) == 0) {
+            opts->json_file = arg + 7;
+        } else if (strncmp(arg, "--runs=", 7) == 0) {
+            opts->num_runs = atoi(arg + 7);
+
+            if (opts->num_runs < 1 || opts->num_runs > VMBENCH_MAX_RUNS) {
+                printf("[error] --runs must be between 1 and %d\n", VMBENCH_MAX_RUNS);
+                return false;
+            }
+        } else if (strcmp(arg, "-O0") == 0 || strcmp(arg, "-O1") == 0 || strcmp(arg, "-O2") == 0) {
+            opts->opt_level = arg[2] - '0';
+        } else if (arg[0] != '-' && opts->num_programs < VMBENCH_MAX_PROGRAMS) {
+            opts->programs[opts->num_programs++] = arg;
+        } else {
+            printf("[error] unknown option '%s'\n", arg);
+            printf("usage: synthium-vm [--runs=N] [-O0|-O1|-O2] [--json=file] [program.syn...]\n");
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    VmBenchOptions opts = {
+        .json_file = NULL,
+        .num_runs = 5,
+        .opt_level = 0,
+        .num_programs = 0
+    };
+
+    if (!vmbench_parse_options(&opts, argc - 1, (const char **) argv + 1)) {
+        return -1;
+    }
+
+    if (opts.num_programs == 0) {
+        while (opts.num_programs < VMBENCH_NUM_DEFAULT_PROGRAMS) {
+            opts.programs[opts.num_programs] = vmbench_default_programs[opts.num_programs];
+            opts.num_programs++;
+        }
+    }
+
+    // the standard library is found relative to the compiler, which lives next to the bench directory
+    Path rel_compiler_path = path_empty();
+    path_from_str("synthiumc", &rel_compiler_path);
+
+    PathBuf abs_compiler_path = path_buf_from(path_empty());
+    if (path_canonicalize(&rel_compiler_path, &abs_compiler_path) != 0) {
+        printf("[error] run synthium-vm from the directory synthiumc was built in\n");
+        return -1;
+    }
+
+    Path compiler_path = path_parent(&abs_compiler_path.inner);
+
+    FILE *json = NULL;
+    if (opts.json_file != NULL && (json = fopen(opts.json_file, "w")) == NULL) {
+        printf("[error] could not open '%s'\n", opts.json_file);
+        return -1;
+    }
+
+    printf("%-28s %12s %12s %9s %12s %9s %14s %12s\n", "program", "ast walk ms", "vm ms", "speedup", "jit ms", "speedup",
+        "bytecode insts", "result");
+
+    int32_t num_failed = 0;
+    int32_t i = 0;
+
+    while (i < opts.num_programs) {
+        char file[PATH_MAX];
+
+        if (realpath(opts.programs[i], file) == NULL) {
+            printf("[error] could not open '%s': %s\n", opts.programs[i], strerror(errno));
+            num_failed++;
+            i++;
+            continue;
+        }
+
+        VmBenchProgram p;
+        VmBenchResult r;
+
+        if (!vmbench_compile(&p, &compiler_path, file, opts.opt_level) || !vmbench_run(&opts, &p, file, &r)) {
+            vmbench_free_program(&p);
+            num_failed++;
+            i++;
+            continue;
+        }
+
+        double walker = bench_median(r.walker, opts.num_runs);
+        double vm = bench_median(r.vm, opts.num_runs);
+        double jit = bench_median(r.jit, opts.num_runs);
+
+        printf("%-28s %12.2f %12.2f %8.2fx %12.2f %8.2fx %14ld %12ld%s\n", opts.programs[i], walker * 1e3, vm * 1e3,
+            walker / vm, jit * 1e3, vm / jit, (long) r.num_insts, (long) r.vm_result, r.ok ? "" : "  (mismatch)");
+        fflush(stdout);
+
+        if (json != NULL) {
+            fprintf(json, "{\"program\": \"%s\", \"opt_level\": %d, \"ok\": %s, \"runs\": [", opts.programs[i], opts.opt_level,
+                r.ok ? "true" : "false");
+
+            int32_t j = 0;
+            while (j < opts.num_runs) {
+                fprintf(json, "%s{\"walker\": %.6f, \"vm\": %.6f, \"jit\": %.6f}", j > 0 ? ", " : "", r.walker[j],
+                    r.vm[j], r.jit[j]);
+                j++;
+            }
+
+            fprintf(json, "]}\n");
+        }
+
+        num_failed += !r.ok;
+        vmbench_free_program(&p);
+
+        i++;
+    }
+
+    if (json != NULL) {
+        fclose(json);
+    }
+
+    path_free(&abs_compiler_path);
+
+    return num_failed > 0 ? 1 : 0;
+}
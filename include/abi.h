@@ -0,0 +1,42 @@
+#ifndef SYNTHIUMC_ABI_H
+#define SYNTHIUMC_ABI_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buf.h"
+#include "elf.h"
+#include "x64.h"
+
+// System V AMD64: integer arguments in six registers, the rest on the stack, rsp 16 byte aligned at every call
+#define ABI_NUM_ARG_REGS 6
+#define ABI_NUM_CALLEE_SAVED 5
+#define ABI_STACK_ALIGN 16
+
+extern const X64Reg abi_arg_regs[ABI_NUM_ARG_REGS];
+extern const X64Reg abi_callee_saved[ABI_NUM_CALLEE_SAVED];
+
+// rbp based frame, the saved registers are pushed right below rbp and the locals follow them
+typedef struct AbiFrame {
+    uint32_t saved_mask;
+    int32_t saved_bytes;
+    int32_t used;
+    int32_t size;
+} AbiFrame;
+
+bool abi_is_callee_saved(X64Reg reg);
+int32_t abi_param_offset(uint32_t idx);
+AbiFrame abi_frame_create(uint32_t saved_mask);
+int32_t abi_frame_alloc(AbiFrame *fr, uint32_t size, uint32_t align);
+void abi_frame_finish(AbiFrame *fr);
+void abi_emit_prologue(Buf *b, AbiFrame *fr);
+void abi_emit_leave(Buf *b, AbiFrame *fr);
+void abi_emit_epilogue(Buf *b, AbiFrame *fr);
+int32_t abi_stack_args_size(uint32_t num_args);
+void abi_emit_call(Buf *b, ElfWriter *elf, ElfSectionId sec, uint32_t sym, bool varargs);
+void abi_emit_tail_call(Buf *b, ElfWriter *elf, ElfSectionId sec, AbiFrame *fr, uint32_t sym);
+void abi_emit_call_cleanup(Buf *b, int32_t stack_bytes);
+
+#endif
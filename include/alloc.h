@@ -0,0 +1,27 @@
+#ifndef SYNTHIUMC_ALLOC_H
+#define SYNTHIUMC_ALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// the counting malloc hooks need glibc's __libc_* entry points and clash with the sanitizer runtimes
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(SYNTHIUM_NO_ALLOC_HOOKS)
+#define ALLOC_HOOKS_AVAILABLE 1
+#else
+#define ALLOC_HOOKS_AVAILABLE 0
+#endif
+
+typedef struct AllocStats {
+    uint64_t count;
+    uint64_t bytes;
+} AllocStats;
+
+bool alloc_hooks_available();
+void alloc_set_counting(bool enabled);
+bool alloc_is_counting();
+AllocStats alloc_stats();
+AllocStats alloc_stats_diff(AllocStats end, AllocStats start);
+
+#endif
@@ -94,9 +94,11 @@ typedef struct DeleteStmt {
     Expr *expr;
 } DeleteStmt;
 
+// `become f(...)` returns what the call returns like `return` does, but the call has to be a tail call
 typedef struct ReturnStmt {
     Stmt s;
     Expr *expr;
+    bool become;
 } ReturnStmt;
 
 typedef struct BlockStmt {
@@ -193,9 +195,11 @@ typedef struct IdentExpr {
     Ident ident;
 } IdentExpr;
 
+// the parser reads the digits once, literals past 64 bits are reported and keep the value 0
 typedef struct IntExpr {
     Expr e;
     const char *ptr;
+    int64_t value;
 } IntExpr;
 
 typedef struct StringExpr {
@@ -230,6 +234,7 @@ bool ast_is_delete_stmt(Stmt *s);
 DeleteStmt *ast_as_delete_stmt(Stmt *s);
 
 Stmt *ast_new_return_stmt(Expr *e);
+Stmt *ast_new_become_stmt(Expr *e);
 bool ast_is_return_stmt(Stmt *s);
 ReturnStmt *ast_as_return_stmt(Stmt *s);
 
@@ -293,7 +298,7 @@ Expr *ast_new_ident_expr(struct Token ident);
 bool ast_is_ident_expr(Expr *e);
 IdentExpr *ast_as_ident_expr(Expr *e);
 
-Expr *ast_new_int_expr(Span span, const char *ptr);
+Expr *ast_new_int_expr(Span span, const char *ptr, int64_t value);
 bool ast_is_int_expr(Expr *e);
 IntExpr *ast_as_int_expr(Expr *e);
 
@@ -0,0 +1,31 @@
+#ifndef SYNTHIUMC_BUF_H
+#define SYNTHIUMC_BUF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// growable byte buffer for machine code, object file sections and emitted source text, values are written little endian
+typedef struct Buf {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t cap;
+} Buf;
+
+Buf buf_create();
+void buf_free(Buf *b);
+void buf_reserve(Buf *b, uint32_t extra);
+void buf_push(Buf *b, const void *data, uint32_t len);
+void buf_push_u8(Buf *b, uint8_t v);
+void buf_push_u16(Buf *b, uint16_t v);
+void buf_push_u32(Buf *b, uint32_t v);
+void buf_push_u64(Buf *b, uint64_t v);
+void buf_push_str(Buf *b, const char *s);
+void buf_push_int(Buf *b, int64_t v);
+void buf_push_zeros(Buf *b, uint32_t len);
+void buf_align(Buf *b, uint32_t align);
+void buf_write_u32(Buf *b, uint32_t offset, uint32_t v);
+uint32_t buf_read_u32(Buf *b, uint32_t offset);
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef SYNTHIUMC_BYTECODE_H
+#define SYNTHIUMC_BYTECODE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "ptrvec.h"
+
+// the most arguments an extern function can be called with through the trampoline table
+#define BC_MAX_EXTERN_ARGS 12
+
+// the result register is a, operands are in b and c and the right operand of _I ops is imm. loads and
+// stores take a byte offset in c, branches their targets in b and c. _32 ops work on i32, i8 and i1
+// values, which are kept sign extended from 32 bits, the 64 bit ops on i64 and pointers, unsigned compares
+// are for pointers. LOOP is a JMP backwards, so the vm can count how often loops go around. the vm keeps a
+// label table in the same order, so the list is shared
+#define BC_OPS(X) \
+    X(NOP) \
+    X(CONST) \
+    X(MOV) \
+    X(ALLOCA) \
+    X(ADD_32) X(SUB_32) X(MUL_32) X(DIV_32) X(MOD_32) X(AND_32) X(OR_32) X(XOR_32) X(SHL_32) X(SHR_32) \
+    X(ADD_64) X(SUB_64) X(MUL_64) X(DIV_64) X(MOD_64) X(AND_64) X(OR_64) X(XOR_64) X(SHL_64) X(SHR_64) \
+    X(ADD_32_I) X(SUB_32_I) X(MUL_32_I) X(AND_32_I) X(OR_32_I) X(XOR_32_I) X(SHL_32_I) X(SHR_32_I) \
+    X(ADD_64_I) X(SUB_64_I) X(MUL_64_I) X(AND_64_I) X(OR_64_I) X(XOR_64_I) X(SHL_64_I) X(SHR_64_I) \
+    X(NEG_32) X(NEG_64) X(NOT_32) X(NOT_64) \
+    X(EQ) X(NE) X(LT) X(LE) X(GT) X(GE) X(LT_U) X(LE_U) X(GT_U) X(GE_U) \
+    X(EQ_I) X(NE_I) X(LT_I) X(LE_I) X(GT_I) X(GE_I) \
+    X(SEXT_32) X(ZEXT_32) X(TRUNC_8) X(TRUNC_1) \
+    X(SELECT) \
+    X(LOAD_8) X(LOAD_32) X(LOAD_64) \
+    X(STORE_8) X(STORE_32) X(STORE_64) \
+    X(STORE_8_I) X(STORE_32_I) X(STORE_64_I) \
+    X(MEMCPY) \
+    X(NEW) \
+    X(DELETE) \
+    X(CALL) \
+    X(TAIL_CALL) \
+    X(CALL_EXTERN) \
+    X(JMP) \
+    X(LOOP) \
+    X(BR) \
+    X(BR_EQ) X(BR_NE) X(BR_LT) X(BR_LE) X(BR_GT) X(BR_GE) X(BR_LT_U) X(BR_LE_U) X(BR_GT_U) X(BR_GE_U) \
+    X(BR_EQ_I) X(BR_NE_I) X(BR_LT_I) X(BR_LE_I) X(BR_GT_I) X(BR_GE_I) \
+    X(RET) \
+    X(RET_VOID) \
+    X(UNREACHABLE)
+
+#define BC_ENUM(name) BC_##name,
+
+typedef enum {
+    BC_OPS(BC_ENUM)
+    BC_NUM_OPS
+} BcOp;
+
+#undef BC_ENUM
+
+// 32 bytes. handler is filled in by the vm with the address of the op's label, so dispatch is a single
+// indirect jump, branch targets are instruction indices
+typedef struct BcInst {
+    const void *handler;
+    uint16_t op;
+    uint16_t pad;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    int64_t imm;
+} BcInst;
+
+// registers 0 to num_params - 1 hold the arguments, the num_consts registers after them are copied from
+// consts on every call. frame_size is the bytes the function's allocas need. the jit counts calls and loop
+// iterations here and, once the function is compiled, keeps its code and the native offset of every instruction
+typedef struct BcFunc {
+    const char *name;
+    BcInst *code;
+    uint32_t num_code;
+    uint32_t num_regs;
+    uint32_t num_params;
+    uint32_t num_consts;
+    int64_t *consts;
+    uint32_t *args;
+    uint32_t frame_size;
+    IrTypeId ret;
+
+    uint32_t calls;
+    uint32_t loops;
+    const uint8_t *native;
+    uint32_t *native_offsets;
+} BcFunc;
+
+// fn is looked up in the running process when the module is compiled and is NULL when it is missing
+typedef struct BcExtern {
+    const char *name;
+    void *fn;
+    uint32_t num_params;
+    bool is_varargs;
+    IrTypeId ret;
+} BcExtern;
+
+// functions and externs keep the index they have in the IR and the globals live in the blocks of data, one
+// per compilation. strings point into the IR module, so it has to outlive the bytecode
+typedef struct BcModule {
+    IrModule *ir;
+    BcFunc *funcs;
+    BcExtern *externs;
+    uint32_t num_funcs;
+    Ptrvec data;
+    uint8_t **globals;
+    uint32_t num_globals;
+
+    int64_t num_insts;
+    int64_t num_fused;
+} BcModule;
+
+// how a value is available to its users. constants, strings, globals and function addresses are IMM when
+// every user can take them as an immediate and CONST when they need a register from the constant pool,
+// compares that only feed a branch and offsets that only feed loads and stores are FOLDED into their user
+#define BC_VALUE_NONE 0
+#define BC_VALUE_REG 1
+#define BC_VALUE_IMM 2
+#define BC_VALUE_CONST 3
+#define BC_VALUE_FOLDED 4
+
+typedef struct BcFixup {
+    uint32_t at;
+    bool is_else;
+    IrBlockId target;
+} BcFixup;
+
+typedef struct BcCopy {
+    uint32_t dst;
+    uint32_t src;
+    bool is_imm;
+    int64_t imm;
+} BcCopy;
+
+// the per function buffers are reused, like the code generator's
+typedef struct BcCompiler {
+    BcModule *m;
+    IrFunc *f;
+    Vec code;
+    Vec args;
+    Vec consts;
+    Vec fixups;
+    Vec copies;
+    uint8_t *kinds;
+    uint32_t *regs;
+    uint32_t *uses;
+    uint32_t cap_insts;
+    uint32_t *block_starts;
+    uint32_t cap_blocks;
+    uint32_t num_regs;
+    uint32_t tmp;
+    uint32_t frame_size;
+} BcCompiler;
+
+BcModule bc_compile(IrModule *ir);
+void bc_extend(BcModule *m);
+void bc_free(BcModule *m);
+BcFunc *bc_lookup(BcModule *m, const char *name);
+const char *bc_op2str(BcOp op);
+void bc_dump_func(FILE *out, BcFunc *f);
+void bc_dump_module(FILE *out, BcModule *m);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef SYNTHIUMC_CEMIT_H
+#define SYNTHIUMC_CEMIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ty.h"
+#include "ast.h"
+#include "buf.h"
+#include "map.h"
+#include "mod.h"
+#include "vec.h"
+#include "span.h"
+#include "ident.h"
+
+#define CEMIT_FUNC 1
+#define CEMIT_STRUCT 2
+#define CEMIT_GLOBAL 4
+#define CEMIT_EXTERN 8
+#define CEMIT_KEEPS_NAME 16
+#define CEMIT_STRING 32
+
+// one entry per top level function, struct and global. stamp is the translation unit that last declared
+// the symbol, so every unit declares exactly the symbols it uses
+typedef struct CEmitSym {
+    Ident name;
+    Ty *ty;
+    int32_t mod;
+    uint32_t flags;
+    int32_t stamp;
+} CEmitSym;
+
+// locals get a number appended, which keeps shadowed names and C keywords apart
+typedef struct CEmitName {
+    const char *name;
+    int32_t len;
+    uint32_t id;
+} CEmitName;
+
+// a translation unit is written into three buffers that are concatenated at the end: struct definitions
+// in dependency order, then prototypes and globals, then the function bodies
+typedef struct CEmitter {
+    ModuleMap *mods;
+    SpanInterner *si;
+    const char **prefixes;
+    Map *symbols;
+    Vec syms;
+    Vec externs;
+    bool has_malloc;
+    bool has_free;
+
+    Module *mod;
+    int32_t stamp;
+    Buf types;
+    Buf decls;
+    Buf body;
+    Vec names;
+    uint32_t num_locals;
+    int32_t depth;
+    // the function being written, a `become` calling it jumps back to the top of its body
+    Func *func;
+    bool uses_new;
+    bool uses_delete;
+    bool uses_musttail;
+
+    int64_t num_bytes;
+    int64_t num_files;
+} CEmitter;
+
+CEmitter cemit_create(ModuleMap *mods, SpanInterner *si);
+void cemit_free(CEmitter *c);
+
+// writes one <prefix>.c file per module into dir, returns false when a file could not be written
+bool cemit_all(CEmitter *c, const char *dir);
+void cemit_module(CEmitter *c, Module *mod, Buf *out);
+
+#endif
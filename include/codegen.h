@@ -0,0 +1,181 @@
+#ifndef SYNTHIUMC_CODEGEN_H
+#define SYNTHIUMC_CODEGEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "abi.h"
+#include "buf.h"
+#include "elf.h"
+#include "vec.h"
+#include "x64.h"
+#include "irc.h"
+#include "pool.h"
+#include "place.h"
+#include "regalloc.h"
+
+// xmm0 to xmm13 hold vector values, xmm14 and xmm15 are scratch
+#define CG_NUM_VEC_REGS 14
+#define CG_VEC_SCRATCH0 ((X64Reg) 14)
+#define CG_VEC_SCRATCH1 ((X64Reg) 15)
+#define CG_NO_VEC_REG 0xff
+
+// .text and .text.unlikely
+#define CG_NUM_TEXT_SECS 2
+
+typedef enum {
+    CG_REG,
+    CG_MEM,
+    CG_VALUE
+} CgOperandKind;
+
+// a register, an rbp relative stack slot or a value that is rematerialized in place
+typedef struct CgOperand {
+    uint8_t kind;
+    uint8_t reg;
+    int32_t offset;
+    IrValue value;
+} CgOperand;
+
+typedef struct CgMove {
+    CgOperand dst;
+    CgOperand src;
+    bool done;
+} CgMove;
+
+// a jump into the other text section than its own is left to the linker
+typedef struct CgFixup {
+    uint32_t at;
+    IrBlockId target;
+    uint8_t sec;
+} CgFixup;
+
+// the moves of an edge that a conditional branch takes, emitted after the function's blocks
+typedef struct CgStub {
+    IrBlockId from;
+    IrBlockId to;
+    uint32_t offset;
+    uint8_t sec;
+} CgStub;
+
+// the code of one function in the sections of the worker that generated it, indexed by section - ELF_SEC_TEXT.
+// sec is the section it starts in, and a split function has its hot part in .text and its cold part in
+// .text.unlikely
+typedef struct CgChunk {
+    uint32_t worker;
+    uint8_t sec;
+    bool split;
+    uint32_t start[CG_NUM_TEXT_SECS];
+    uint32_t end[CG_NUM_TEXT_SECS];
+    uint32_t first_reloc[CG_NUM_TEXT_SECS];
+    uint32_t last_reloc[CG_NUM_TEXT_SECS];
+} CgChunk;
+
+// the per function buffers are reused, like the register allocator's. functions are generated by a Codegen per
+// worker of the pool, each into sections of its own, and copied into the object file in the order they are laid
+// out once all of them are done, so the file is the same however many threads made it
+typedef struct Codegen {
+    IrModule *m;
+    ElfWriter *elf;
+    // the section code goes to, .text or .text.unlikely for the cold blocks
+    Buf *text;
+    ElfSectionId sec;
+    RegAlloc ra;
+    Irc irc;
+    Place place;
+    int32_t opt_level;
+    // whether blocks and functions are placed, from -O2 on or with a profile
+    bool uses_place;
+
+    Pool *pool;
+    struct Codegen *workers;
+    // the functions in the order they are laid out, the order the workers take them in and where each one's code is
+    uint32_t *func_order;
+    uint64_t *tasks;
+    CgChunk *chunks;
+    // what a worker is generating and how many relocations of each section it had made before it
+    CgChunk *chunk;
+    uint32_t num_relocs[CG_NUM_TEXT_SECS];
+
+    IrFunc *f;
+    AbiFrame frame;
+    int32_t slot_base;
+    IrBlockId next_block;
+    int32_t *frame_offsets;
+    uint32_t cap_insts;
+    uint32_t *block_offsets;
+    uint8_t *block_secs;
+    uint32_t cap_blocks;
+    Vec fixups;
+    Vec moves;
+    Vec stubs;
+    int32_t pos;
+    uint32_t next_split;
+    uint32_t next_stub;
+    // where the hot part of a split function ends and its cold part starts, PLACE_NONE when it is not split
+    uint32_t hot_end;
+    uint32_t cold_start;
+    int64_t num_spills;
+    int64_t num_reloads;
+
+    // the xmm register of every vector value, the last position it is used at in its block, the registers that
+    // are free in the current block and whether a block works on 32 byte vectors. blocks passing vectors to each
+    // other form a group, and the registers held across blocks are only unique within their group
+    uint8_t *vec_regs;
+    int32_t *vec_last;
+    uint32_t cap_vec;
+    uint8_t *vec_wide;
+    uint32_t *vec_group;
+    uint32_t *vec_group_regs;
+    uint32_t cap_vec_blocks;
+    uint32_t vec_free;
+    uint32_t vec_pinned;
+    bool has_vec;
+
+    uint32_t *func_syms;
+    uint32_t *global_syms;
+    uint32_t *string_offsets;
+    uint32_t malloc_sym;
+    uint32_t free_sym;
+    // the word caching what the CPU supports and the function filling it in, emitted once a function asks
+    uint32_t cpu_features_sym;
+    uint32_t cpu_init_sym;
+    bool uses_cpu_features;
+
+    int64_t num_funcs;
+    int64_t num_insts;
+    int64_t num_split_edges;
+    int64_t num_split_funcs;
+    int64_t total_spills;
+    int64_t total_reloads;
+    int64_t total_split;
+    int64_t total_spilled;
+    int64_t num_spilling_funcs;
+    int64_t max_spills;
+    int64_t num_irc_fallbacks;
+} Codegen;
+
+Codegen codegen_create(IrModule *m, ElfWriter *elf, int32_t opt_level, Pool *pool);
+void codegen_free(Codegen *c);
+void codegen_module(Codegen *c);
+void codegen_func(Codegen *c, IrFunc *f);
+
+// shared with the -O0 generator
+void codegen_reserve(Codegen *c, IrFunc *f);
+void codegen_set_section(Codegen *c, ElfSectionId sec);
+void codegen_finish_func(Codegen *c, uint32_t start);
+int32_t codegen_reg_size(IrTypeId ty);
+int32_t codegen_mem_size(IrTypeId ty);
+bool codegen_is_imm(IrFunc *f, IrValue v);
+int32_t codegen_frame_offset(Codegen *c, IrValue v);
+void codegen_remat(Codegen *c, X64Reg dst, IrValue v);
+void codegen_jump(Codegen *c, bool is_cond, X64Cond cc, IrBlockId target);
+X64AluOp codegen_alu_op(IrOp op);
+X64Cond codegen_cond(IrOp op, bool is_unsigned);
+void codegen_copy_bytes(Codegen *c, X64Reg dst_base, int32_t dst_disp, X64Reg src_base, int32_t src_disp, int32_t size);
+void codegen_convert(Codegen *c, IrInst *inst, IrTypeId from, X64Reg d, X64Reg s);
+
+#endif
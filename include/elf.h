@@ -0,0 +1,92 @@
+#ifndef SYNTHIUMC_ELF_H
+#define SYNTHIUMC_ELF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buf.h"
+#include "map.h"
+#include "vec.h"
+#include "ptrvec.h"
+
+#define ELF_STB_LOCAL 0
+#define ELF_STB_GLOBAL 1
+
+#define ELF_STT_NOTYPE 0
+#define ELF_STT_OBJECT 1
+#define ELF_STT_FUNC 2
+#define ELF_STT_SECTION 3
+
+#define ELF_R_X86_64_64 1
+#define ELF_R_X86_64_PC32 2
+#define ELF_R_X86_64_PLT32 4
+#define ELF_R_X86_64_GOTPCREL 9
+
+// the section header table is fixed, so section indices are known before anything is written
+typedef enum {
+    ELF_SEC_NULL,
+    ELF_SEC_TEXT,
+    ELF_SEC_TEXT_UNLIKELY,
+    ELF_SEC_RODATA,
+    ELF_SEC_DATA,
+    ELF_SEC_BSS,
+    ELF_SEC_RELA_TEXT,
+    ELF_SEC_RELA_TEXT_UNLIKELY,
+    ELF_SEC_RELA_DATA,
+    ELF_SEC_SYMTAB,
+    ELF_SEC_STRTAB,
+    ELF_SEC_SHSTRTAB,
+    ELF_SEC_NOTE_STACK,
+    ELF_NUM_SECTIONS
+} ElfSectionId;
+
+typedef struct ElfSymbol {
+    uint32_t name;
+    uint8_t bind;
+    uint8_t type;
+    uint16_t section;
+    uint64_t value;
+    uint64_t size;
+} ElfSymbol;
+
+typedef struct ElfReloc {
+    uint64_t offset;
+    uint32_t sym;
+    uint32_t type;
+    int64_t addend;
+} ElfReloc;
+
+// symbols are kept in creation order and sorted locals first when the file is written,
+// relocations refer to the creation order index
+typedef struct ElfWriter {
+    Buf text;
+    // the blocks that rarely run, away from the hot code so it packs into fewer cache lines and pages
+    Buf text_unlikely;
+    Buf rodata;
+    Buf data;
+    uint64_t bss_size;
+    Buf strtab;
+    Vec symbols;
+    Vec text_relocs;
+    Vec text_unlikely_relocs;
+    Vec data_relocs;
+    Map by_name;
+    Ptrvec names;
+    uint32_t section_syms[ELF_NUM_SECTIONS];
+} ElfWriter;
+
+ElfWriter elf_create();
+void elf_free(ElfWriter *w);
+Buf *elf_section(ElfWriter *w, ElfSectionId sec);
+// the relocations of a section's code, those of .data for every section that has no code
+Vec *elf_section_relocs(ElfWriter *w, ElfSectionId sec);
+uint32_t elf_section_symbol(ElfWriter *w, ElfSectionId sec);
+uint32_t elf_symbol(ElfWriter *w, const char *name, int32_t len, uint8_t bind, uint8_t type);
+void elf_define_symbol(ElfWriter *w, uint32_t sym, ElfSectionId sec, uint64_t value, uint64_t size);
+uint64_t elf_reserve_bss(ElfWriter *w, uint64_t size, uint32_t align);
+void elf_add_reloc(ElfWriter *w, ElfSectionId sec, uint64_t offset, uint32_t type, uint32_t sym, int64_t addend);
+bool elf_write(ElfWriter *w, const char *path);
+
+#endif
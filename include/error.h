@@ -18,7 +18,8 @@ typedef enum {
     ERROR_UNKNOWN_SYMBOL,
     ERROR_CHAR_LIT_LEN,
     ERROR_COULD_NOT_PARSE_STMT,
-    ERROR_INVALID_TYPE_IDENT
+    ERROR_INVALID_TYPE_IDENT,
+    ERROR_INT_LIT_OVERFLOW
 } ErrorCode;
 
 const char *error_err2str(ErrorCode err_code, ...);
@@ -0,0 +1,61 @@
+#ifndef SYNTHIUMC_ESCAPE_H
+#define SYNTHIUMC_ESCAPE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+
+// a promoted allocation lives in the frame of every call, so recursive functions must not grow it by much
+#define ESCAPE_MAX_SIZE 256
+#define ESCAPE_MAX_FRAME 1024
+
+// escape analysis of `new`: an allocation whose address is only loaded from, stored to, offset, copied, handed
+// to parameters that do not escape and deleted never outlives the call that made it, so it becomes a stack slot
+// and its deletes go away. a parameter escapes when its callee returns it, stores it, deletes it, passes it on to
+// a parameter that escapes or to an extern function, or does anything else with it. every parameter starts out
+// not escaping, and once one of a function's parameters escapes its callers go back onto a worklist, which
+// settles recursive calls
+typedef struct Escape {
+    IrModule *m;
+    IrFunc *f;
+
+    // per function, where its parameters start in param_escapes
+    uint32_t *param_off;
+    bool *param_escapes;
+
+    // the functions calling every function, in one array like the users, and the functions left to summarize
+    uint32_t *caller_off;
+    uint32_t *callers;
+    bool *queued;
+    Vec funcs;
+
+    // the users of every value in one array, counted first and then filled back to front
+    uint32_t *use_off;
+    IrValue *users;
+    uint32_t cap_insts;
+    uint32_t cap_users;
+
+    Vec work;
+    Vec deletes;
+    uint32_t frame_size;
+
+    int64_t num_news;
+    int64_t num_promoted;
+    int64_t num_deletes;
+} Escape;
+
+Escape escape_create(IrModule *m);
+void escape_free(Escape *e);
+
+// what every function does with its parameters, needed before any function is changed
+void escape_summarize(Escape *e);
+void escape_func(Escape *e, IrFunc *f);
+void escape_module(IrModule *m);
+Pass escape_pass();
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SYNTHIUMC_FASTGEN_H
+#define SYNTHIUMC_FASTGEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "codegen.h"
+
+// -O0: one linear pass over the instructions gives every value its own 8 byte frame slot, then the
+// blocks are emitted in the order they were created. operands are loaded into rax, rcx and rdx right
+// before they are used and results are stored right after, so no liveness or register allocation is needed.
+// a phi gets a second slot that its predecessors write, it is copied into the phi's own slot at the
+// top of its block, which keeps swaps correct without splitting critical edges
+void fastgen_func(Codegen *c, IrFunc *f);
+
+#endif
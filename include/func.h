@@ -17,8 +17,16 @@ typedef struct ParamList {
     Vec params;
 } ParamList;
 
+// `inline fn` and `noinline fn` override the inliner's cost model for every call of the function
+typedef enum {
+    FUNC_INLINE_AUTO,
+    FUNC_INLINE_ALWAYS,
+    FUNC_INLINE_NEVER
+} FuncInlineHint;
+
 typedef struct FuncDef {
     bool is_extern;
+    FuncInlineHint inline_hint;
     Ident name;
     Type ret_ty;
     ParamList params;
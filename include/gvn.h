@@ -0,0 +1,73 @@
+#ifndef SYNTHIUMC_GVN_H
+#define SYNTHIUMC_GVN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+
+// an expression as the table sees it, operands are already replaced by their value numbers. loads keep the
+// generation of the memory they read in ops[1] and ops[2], so a store in between makes them a new expression
+typedef struct GvnEntry {
+    uint64_t hash;
+    IrValue v;
+    uint8_t op;
+    IrTypeId ty;
+    int64_t imm;
+    IrValue ops[3];
+} GvnEntry;
+
+// a memory generation to put back when the walk leaves the block that changed it
+typedef struct GvnUndo {
+    IrValue cls;
+    uint32_t old;
+} GvnUndo;
+
+typedef struct GvnFrame {
+    IrBlockId b;
+    uint32_t next_child;
+    uint32_t num_inserted;
+    uint32_t num_undo;
+    uint32_t join_gen;
+} GvnFrame;
+
+// dominator scoped value numbering (Briggs, Cooper and Simpson): the dominator tree is walked in preorder and an
+// expression is replaced by an equal one from a dominating block. the table uses open addressing and is emptied in
+// the reverse order it was filled when the walk leaves a block, so no entry ever needs a tombstone.
+// memory is split into the stack slots whose address never leaves loads, stores and offsets, one class each,
+// and everything else. stores and copies bump the generation of the class they write, calls the generation of
+// everything else, and blocks with more than one predecessor start a fresh generation for all of memory
+typedef struct Gvn {
+    IrFunc *f;
+
+    IrValue *vn;
+    uint32_t *gen;
+    bool *escaped;
+    uint32_t cap_insts;
+
+    GvnEntry *table;
+    uint32_t cap_table;
+
+    Vec inserted;
+    Vec undo;
+    Vec frames;
+
+    uint32_t join_gen;
+    uint32_t next_gen;
+
+    int64_t num_removed;
+    int64_t num_loads;
+} Gvn;
+
+Gvn gvn_create();
+void gvn_free(Gvn *g);
+
+// replaces every value computed again in a block its first computation dominates and removes it
+void gvn_func(Gvn *g, IrFunc *f);
+Pass gvn_pass();
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef SYNTHIUMC_INLINER_H
+#define SYNTHIUMC_INLINER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+
+// loops deeper than this do not make a call any more worth inlining
+#define INLINER_MAX_LOOP_DEPTH 3
+
+// a call is inlined when the callee's size, less the bonuses of the call site, is at most the threshold.
+// the size counts one per instruction, constants, parameters and copies are free and calls cost their arguments
+typedef struct InlineParams {
+    int32_t threshold;
+    // what the call itself costs: the call, moving its arguments and the result, saving registers around it
+    int32_t call_bonus;
+    // per constant argument, since constant propagation can fold the uses of it in the inlined body
+    int32_t const_arg_bonus;
+    // per loop around the call site
+    int32_t loop_bonus;
+    // no function grows past this size by inlining, except through `inline fn`
+    int32_t max_size;
+} InlineParams;
+
+// a return of the inlined body, which now jumps to the rest of the caller's block
+typedef struct InlineRet {
+    IrBlockId block;
+    IrValue value;
+} InlineRet;
+
+typedef struct InlineFrame {
+    uint32_t func;
+    uint32_t next_edge;
+} InlineFrame;
+
+// bottom-up inlining over the call graph: its strongly connected components come out of Tarjan's algorithm
+// callees first, so every callee already has its own calls inlined when it is inlined itself. calls within a
+// component are recursive and never inlined, so inlining always terminates. all modules are lowered into one
+// IR module, so calls across modules are inlined like any other
+typedef struct Inliner {
+    IrModule *m;
+    InlineParams params;
+
+    // the direct callees of function i are callees[callee_off[i]] up to callees[callee_off[i + 1]]
+    uint32_t *callee_off;
+    uint32_t *callees;
+    uint32_t num_funcs;
+
+    uint32_t *index;
+    uint32_t *low;
+    uint32_t *scc;
+    bool *on_stack;
+    bool *inlinable;
+    int32_t *size;
+    Vec stack;
+    Vec frames;
+    Vec members;
+    uint32_t next_index;
+
+    // per caller and callee, only ever grown
+    int32_t *block_depth;
+    uint32_t *loop_mark;
+    uint32_t cap_blocks;
+    IrValue *value_map;
+    uint32_t cap_values;
+    IrBlockId *block_map;
+    uint32_t cap_callee_blocks;
+    Vec sites;
+    Vec work;
+    Vec rets;
+
+    int64_t num_sites;
+    int64_t num_inlined;
+} Inliner;
+
+// the defaults of an optimisation level, a threshold of -1 keeps the level's own
+InlineParams inliner_params(int32_t opt_level, int32_t threshold);
+
+Inliner inliner_create(IrModule *m, InlineParams params);
+void inliner_free(Inliner *in);
+
+// replaces every call the cost model accepts by a copy of the callee's body
+void inliner_module(IrModule *m, InlineParams params);
+Pass inliner_pass(InlineParams *params);
+
+#endif
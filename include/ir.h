@@ -0,0 +1,385 @@
+#ifndef SYNTHIUMC_IR_H
+#define SYNTHIUMC_IR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "map.h"
+#include "vec.h"
+#include "span.h"
+#include "ptrvec.h"
+
+// value 0 and the blocks past the end never exist, so zeroed operands read as "no value"
+#define IR_NO_VALUE 0
+#define IR_NO_BLOCK UINT32_MAX
+#define IR_MAX_INLINE_OPS 3
+#define IR_ARENA_CHUNK 65536
+#define IR_ARENA_MIN_CHUNK 512
+
+typedef uint32_t IrValue;
+typedef uint32_t IrBlockId;
+typedef uint32_t IrTypeId;
+
+typedef enum {
+    IR_TY_VOID,
+    IR_TY_I1,
+    IR_TY_I8,
+    IR_TY_I32,
+    IR_TY_I64,
+    IR_TY_PTR,
+    IR_TY_V4I32,
+    IR_TY_V8I32,
+    IR_TY_STRUCT
+} IrTypeKind;
+
+// the primitive types are interned first, so their ids are fixed
+enum {
+    IR_TYPE_VOID,
+    IR_TYPE_I1,
+    IR_TYPE_I8,
+    IR_TYPE_I32,
+    IR_TYPE_I64,
+    IR_TYPE_PTR,
+    // vectors of i32 lanes, only the vectoriser makes them and only the native backend takes them
+    IR_TYPE_V4I32,
+    IR_TYPE_V8I32,
+    IR_NUM_PRIMITIVE_TYPES
+};
+
+typedef enum {
+    IR_NOP,
+
+    // leaves, imm holds the constant, parameter, string, global or function index
+    IR_CONST,
+    IR_PARAM,
+    IR_STR,
+    IR_GLOBAL,
+    IR_FUNC_ADDR,
+
+    // integer arithmetic, both operands have the result type
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_SHL,
+    IR_SHR,
+    IR_NEG,
+    IR_NOT,
+
+    // comparisons produce an i1
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+
+    IR_SEXT,
+    IR_ZEXT,
+    IR_TRUNC,
+    IR_PTR_TO_INT,
+    IR_INT_TO_PTR,
+    IR_SELECT,
+    IR_COPY,
+    IR_PHI,
+
+    // memory, imm is the size for alloca, new and memcpy and the byte offset for offset. alloca keeps its
+    // alignment and memcpy the struct it copies above the size
+    IR_ALLOCA,
+    IR_LOAD,
+    IR_STORE,
+    IR_OFFSET,
+    IR_MEMCPY,
+    IR_NEW,
+    IR_DELETE,
+    IR_CALL,
+
+    // vectors: splat fills every lane with a scalar, extract reads lane imm. add, sub, mul, and, or, xor, the
+    // comparisons, select, load and store also work lane by lane on vector types, where a comparison gives a
+    // vector with every lane all ones or zero and select takes such a vector as its condition
+    IR_SPLAT,
+    IR_EXTRACT,
+    // an i1 telling whether the CPU running the code has feature imm
+    IR_CPU_FEATURE,
+
+    // terminators, block targets are stored as operands
+    IR_BR,
+    IR_CBR,
+    IR_RET,
+    IR_UNREACHABLE,
+
+    IR_NUM_OPS
+} IrOp;
+
+// the features IR_CPU_FEATURE asks about
+#define IR_CPU_AVX2 1
+
+#define IR_FLAG_EXTRA_OPS 1
+// a call the native backend makes as a jump once the caller's frame is torn down, its return follows it
+#define IR_FLAG_TAIL 2
+// a call of a `become`, which has to end up as a tail call or a loop
+#define IR_FLAG_MUST_TAIL 4
+
+// 32 bytes, instructions live in one array per function and are referenced by index,
+// operand lists longer than three (calls and phis) live in the function's extra_ops array
+typedef struct IrInst {
+    uint8_t op;
+    uint8_t flags;
+    uint16_t num_ops;
+    IrTypeId ty;
+    IrBlockId block;
+    union {
+        IrValue ops[IR_MAX_INLINE_OPS];
+        struct {
+            uint32_t start;
+            uint32_t cap;
+        } extra;
+    } u;
+    int64_t imm;
+} IrInst;
+
+typedef struct IrBlock {
+    uint32_t *insts;
+    uint32_t num_insts;
+    uint32_t cap_insts;
+    IrBlockId *preds;
+    uint32_t num_preds;
+    uint32_t cap_preds;
+    IrBlockId *succs;
+    uint32_t num_succs;
+    uint32_t cap_succs;
+    IrBlockId idom;
+    int64_t freq;
+} IrBlock;
+
+typedef struct IrArenaChunk {
+    struct IrArenaChunk *next;
+    size_t used;
+    size_t cap;
+    char data[];
+} IrArenaChunk;
+
+typedef struct IrArena {
+    IrArenaChunk *head;
+    size_t total;
+} IrArena;
+
+typedef struct IrField {
+    IrTypeId ty;
+    uint32_t offset;
+} IrField;
+
+typedef struct IrType {
+    IrTypeKind kind;
+    uint32_t size;
+    uint32_t align;
+    uint32_t first_field;
+    uint32_t num_fields;
+    const char *name;
+} IrType;
+
+typedef struct IrTypeTable {
+    Vec types;
+    Vec fields;
+    Map by_name;
+} IrTypeTable;
+
+typedef struct IrString {
+    const char *data;
+    int32_t len;
+} IrString;
+
+typedef enum {
+    IR_INIT_NONE,
+    IR_INIT_INT,
+    IR_INIT_STRING
+} IrInitKind;
+
+typedef struct IrGlobal {
+    const char *name;
+    IrTypeId ty;
+    IrInitKind init_kind;
+    int64_t init;
+} IrGlobal;
+
+// the call of a `become` and where it is in the source, the tail call pass reports the ones it can not change there
+typedef struct IrBecome {
+    IrValue call;
+    Span span;
+} IrBecome;
+
+#define IR_FUNC_EXTERN 1
+#define IR_FUNC_VARARGS 2
+#define IR_FUNC_INLINE 4
+#define IR_FUNC_NOINLINE 8
+#define IR_FUNC_EXPORTED 16
+// the freq of every block is a count read from a profile, a block that never ran has 0
+#define IR_FUNC_PROFILED 32
+
+// analyses cached on a function, with a bit in analyses while they are up to date. they only depend on the
+// CFG, a pass that changes it drops them or has the pass manager drop them for it
+#define IR_ANALYSIS_DOMINATORS 1
+#define IR_ANALYSIS_ALL 1
+
+typedef struct IrFunc {
+    const char *name;
+    uint32_t idx;
+    uint32_t flags;
+    IrTypeId ret;
+    uint32_t num_params;
+    IrTypeId *params;
+    IrInst *insts;
+    uint32_t num_insts;
+    uint32_t cap_insts;
+    IrValue *extra_ops;
+    uint32_t num_extra_ops;
+    uint32_t cap_extra_ops;
+    IrBlock *blocks;
+    uint32_t num_blocks;
+    uint32_t cap_blocks;
+    IrArena arena;
+    // the path of the module defining it and its name hashed, profiles find functions by it
+    uint64_t name_hash;
+    // the dominator tree as ir_dominator_tree leaves it, besides the idom of every block, and its preorder: a block
+    // dominates the ones numbered from its dom_pre to its dom_last. unreachable blocks are numbered UINT32_MAX
+    uint32_t analyses;
+    uint32_t *dom_child_off;
+    IrBlockId *dom_children;
+    uint32_t *dom_pre;
+    uint32_t *dom_last;
+    uint32_t cap_dom;
+    IrBecome *becomes;
+    uint32_t num_becomes;
+    uint32_t cap_becomes;
+} IrFunc;
+
+typedef struct IrModule {
+    IrTypeTable types;
+    Ptrvec funcs;
+    Vec globals;
+    Vec strings;
+    Map func_by_name;
+} IrModule;
+
+typedef struct IrBuilder {
+    IrModule *mod;
+    IrFunc *func;
+    IrBlockId block;
+} IrBuilder;
+
+void *ir_arena_alloc(IrArena *a, size_t size);
+void ir_arena_free(IrArena *a);
+
+IrTypeTable ir_types_create();
+void ir_types_free(IrTypeTable *t);
+IrType *ir_type_get(IrModule *m, IrTypeId id);
+IrTypeId ir_type_struct_declare(IrModule *m, const char *name, int32_t name_len);
+void ir_type_struct_define(IrModule *m, IrTypeId id, IrTypeId *fields, uint32_t num_fields);
+IrTypeId ir_type_struct_lookup(IrModule *m, const char *name, int32_t name_len);
+IrField *ir_type_field(IrModule *m, IrTypeId id, uint32_t idx);
+uint32_t ir_type_size(IrModule *m, IrTypeId id);
+uint32_t ir_type_align(IrModule *m, IrTypeId id);
+bool ir_type_is_int(IrTypeId id);
+bool ir_type_is_scalar(IrModule *m, IrTypeId id);
+bool ir_type_is_vector(IrTypeId id);
+uint32_t ir_type_lanes(IrTypeId id);
+const char *ir_type_name(IrModule *m, IrTypeId id);
+
+IrModule ir_module_create();
+void ir_module_free(IrModule *m);
+IrFunc *ir_func_create(IrModule *m, const char *name, int32_t name_len, IrTypeId ret, IrTypeId *params, uint32_t num_params, uint32_t flags);
+IrFunc *ir_func_lookup(IrModule *m, const char *name, int32_t name_len);
+IrFunc *ir_module_func(IrModule *m, uint32_t idx);
+uint32_t ir_module_num_funcs(IrModule *m);
+void ir_func_free(IrFunc *f);
+void ir_func_add_become(IrFunc *f, IrValue call, Span span);
+// the span of the `become` that made the call, an empty span for other calls
+Span ir_func_become_span(IrFunc *f, IrValue call);
+uint32_t ir_module_add_string(IrModule *m, const char *data, int32_t len);
+uint32_t ir_module_add_global(IrModule *m, const char *name, int32_t name_len, IrTypeId ty, IrInitKind init_kind, int64_t init);
+IrGlobal *ir_module_global(IrModule *m, uint32_t idx);
+IrString *ir_module_string(IrModule *m, uint32_t idx);
+
+IrBlockId ir_block_create(IrFunc *f);
+IrBlock *ir_block(IrFunc *f, IrBlockId id);
+IrInst *ir_inst(IrFunc *f, IrValue v);
+IrValue ir_inst_create(IrFunc *f, IrOp op, IrTypeId ty, uint32_t num_ops);
+void ir_block_append(IrFunc *f, IrBlockId b, IrValue v);
+void ir_block_insert(IrFunc *f, IrBlockId b, uint32_t pos, IrValue v);
+void ir_block_compact(IrFunc *f, IrBlockId b);
+IrValue ir_block_terminator(IrFunc *f, IrBlockId b);
+IrValue ir_block_tail_call(IrFunc *f, IrBlockId b);
+void ir_add_edge(IrFunc *f, IrBlockId from, IrBlockId to);
+void ir_remove_edge(IrFunc *f, IrBlockId from, IrBlockId to);
+void ir_remove_incoming(IrFunc *f, IrBlockId from, IrBlockId to);
+int32_t ir_pred_index(IrFunc *f, IrBlockId b, IrBlockId pred);
+
+IrValue *ir_inst_ops(IrFunc *f, IrInst *inst);
+uint32_t ir_inst_num_values(IrInst *inst);
+void ir_inst_set_num_ops(IrFunc *f, IrInst *inst, uint32_t num_ops);
+void ir_inst_remove(IrFunc *f, IrValue v);
+void ir_replace_all_uses(IrFunc *f, IrValue old, IrValue replacement);
+void ir_replace_uses(IrFunc *f, IrValue *map, uint32_t num_mapped);
+IrValue ir_ptr_base(IrFunc *f, IrValue ptr);
+void ir_find_escaping_slots(IrFunc *f, bool *escaped);
+bool ir_op_is_terminator(IrOp op);
+bool ir_op_has_side_effects(IrOp op);
+bool ir_op_is_binary(IrOp op);
+bool ir_op_is_compare(IrOp op);
+const char *ir_op2str(IrOp op);
+
+void ir_compute_dominators(IrFunc *f);
+// computes the dominators when they are not cached, and answers from the dominator tree's numbering
+bool ir_dominates(IrFunc *f, IrBlockId a, IrBlockId b);
+void ir_dominator_tree(IrFunc *f, uint32_t *child_off, IrBlockId *children);
+// the idom of every block and the dominator tree in dom_child_off and dom_children, computed when they are not cached
+void ir_func_dominators(IrFunc *f);
+void ir_func_invalidate(IrFunc *f, uint32_t analyses);
+uint32_t *ir_reverse_postorder(IrFunc *f, uint32_t *count);
+IrBlockId ir_split_edge(IrFunc *f, IrBlockId b, uint32_t i);
+uint32_t ir_split_critical_edges(IrFunc *f);
+
+IrBuilder ir_builder_create(IrModule *m, IrFunc *f);
+void ir_builder_set_block(IrBuilder *b, IrBlockId block);
+bool ir_builder_is_terminated(IrBuilder *b);
+IrValue ir_build_const(IrBuilder *b, IrTypeId ty, int64_t value);
+IrValue ir_build_param(IrBuilder *b, uint32_t idx);
+IrValue ir_build_str(IrBuilder *b, uint32_t str_idx);
+IrValue ir_build_global(IrBuilder *b, uint32_t global_idx);
+IrValue ir_build_func_addr(IrBuilder *b, uint32_t func_idx);
+IrValue ir_build_binary(IrBuilder *b, IrOp op, IrValue lhs, IrValue rhs);
+IrValue ir_build_unary(IrBuilder *b, IrOp op, IrValue value);
+IrValue ir_build_cmp(IrBuilder *b, IrOp op, IrValue lhs, IrValue rhs);
+IrValue ir_build_cast(IrBuilder *b, IrOp op, IrTypeId ty, IrValue value);
+IrValue ir_build_select(IrBuilder *b, IrValue cond, IrValue a, IrValue c);
+IrValue ir_build_copy(IrBuilder *b, IrValue value);
+IrValue ir_build_phi(IrBuilder *b, IrTypeId ty, uint32_t num_ops);
+IrValue ir_build_phi_in(IrFunc *f, IrBlockId block, IrTypeId ty, uint32_t num_ops);
+IrValue ir_build_alloca(IrBuilder *b, uint32_t size, uint32_t align);
+IrValue ir_build_load(IrBuilder *b, IrTypeId ty, IrValue ptr);
+IrValue ir_build_store(IrBuilder *b, IrValue ptr, IrValue value);
+IrValue ir_build_offset(IrBuilder *b, IrValue ptr, int64_t offset);
+IrValue ir_build_memcpy(IrBuilder *b, IrValue dst, IrValue src, IrTypeId ty);
+IrValue ir_build_new(IrBuilder *b, uint32_t size);
+IrValue ir_build_delete(IrBuilder *b, IrValue ptr);
+IrValue ir_build_call(IrBuilder *b, uint32_t func_idx, IrValue *args, uint32_t num_args);
+IrValue ir_build_br(IrBuilder *b, IrBlockId target);
+IrValue ir_build_cbr(IrBuilder *b, IrValue cond, IrBlockId then_block, IrBlockId else_block);
+IrValue ir_build_ret(IrBuilder *b, IrValue value);
+IrValue ir_build_unreachable(IrBuilder *b);
+IrValue ir_build_splat(IrBuilder *b, IrTypeId ty, IrValue value);
+IrValue ir_build_extract(IrBuilder *b, IrValue vector, uint32_t lane);
+IrValue ir_build_cpu_feature(IrBuilder *b, int64_t feature);
+
+void ir_dump_func(FILE *out, IrModule *m, IrFunc *f);
+void ir_dump_module(FILE *out, IrModule *m);
+int32_t ir_verify_func(IrModule *m, IrFunc *f, Ptrvec *errors);
+int32_t ir_verify_module(IrModule *m, Ptrvec *errors);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef SYNTHIUMC_IRC_H
+#define SYNTHIUMC_IRC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vec.h"
+#include "regalloc.h"
+
+// where a node is, following the worklists of iterated register coalescing
+#define IRC_INITIAL 0
+#define IRC_SIMPLIFY 1
+#define IRC_FREEZE 2
+#define IRC_SPILL 3
+#define IRC_SPILLED 4
+#define IRC_COALESCED 5
+#define IRC_COLORED 6
+#define IRC_SELECT 7
+
+#define IRC_MOVE_WORKLIST 0
+#define IRC_MOVE_ACTIVE 1
+#define IRC_MOVE_COALESCED 2
+#define IRC_MOVE_CONSTRAINED 3
+#define IRC_MOVE_FROZEN 4
+
+// above these the graph takes more time and memory than it saves, the function goes to linear scan instead
+#define IRC_MAX_NODES (1u << 18)
+#define IRC_MAX_EDGES (1u << 21)
+
+// a copy between two nodes, from a phi to its operand or a copy instruction to its source
+typedef struct IrcMove {
+    uint32_t a;
+    uint32_t b;
+    uint8_t state;
+} IrcMove;
+
+// an entry of a node's adjacency or move list
+typedef struct IrcLink {
+    uint32_t to;
+    int32_t next;
+} IrcLink;
+
+// a node on the spill worklist with the cost and degree it had when it was pushed
+typedef struct IrcSpill {
+    uint32_t n;
+    uint32_t degree;
+    int64_t cost;
+} IrcSpill;
+
+// every interval of the register allocator is a node, two nodes interfere when one is defined where the other
+// is live. nodes that live across a call can only take the callee saved registers, so they have fewer colours.
+// the worklists are stacks whose entries are skipped when the node or move has left that list since, the spill
+// worklist is a heap ordered by cost per neighbour
+typedef struct Irc {
+    RegAlloc *ra;
+    uint32_t num_nodes;
+
+    uint32_t *node_of;
+    uint32_t cap_values;
+
+    IrValue *values;
+    uint8_t *state;
+    uint32_t *degree;
+    uint32_t *colors;
+    uint32_t *alias;
+    uint32_t *members;
+    uint32_t *last_member;
+    int32_t *adj;
+    int32_t *node_moves;
+    int64_t *cost;
+    int32_t *color;
+    uint32_t *mark;
+    uint32_t *live;
+    uint32_t *live_at;
+    uint32_t num_live;
+    uint32_t cap_nodes;
+    uint32_t stamp;
+
+    IrcLink *links;
+    uint32_t num_links;
+    uint32_t cap_links;
+    uint64_t *edges;
+    uint32_t num_edges;
+    uint32_t cap_edges;
+    IrcMove *moves;
+    uint32_t num_moves;
+    uint32_t cap_moves;
+
+    Vec simplify;
+    Vec freeze;
+    Vec spill;
+    Vec select;
+    Vec work_moves;
+
+    int64_t num_coalesced;
+} Irc;
+
+Irc irc_create();
+void irc_free(Irc *g);
+
+// colours the intervals regalloc_prepare built, spilled values live on the stack for their whole life.
+// returns false without touching ra when the function is too big for the graph
+bool irc_run(Irc *g, RegAlloc *ra);
+bool irc_interferes(Irc *g, uint32_t u, uint32_t v);
+
+#endif
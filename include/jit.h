@@ -0,0 +1,51 @@
+#ifndef SYNTHIUMC_JIT_H
+#define SYNTHIUMC_JIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buf.h"
+#include "vec.h"
+#include "bytecode.h"
+
+// a function is compiled once it has been called this many times or its loops went around this often
+#define JIT_HOT_CALLS 100
+#define JIT_HOT_LOOPS 1000
+
+struct Vm;
+
+// compiled code keeps the vm's register window in rbx, the alloca memory in r12 and the vm in r13, so it
+// reads and writes the same registers the interpreter does. at is where to start, the function's first
+// instruction or a loop header the interpreter is leaving. the result is only valid when the vm has no error
+typedef int64_t (*JitEntry)(struct Vm *vm, int64_t *regs, uint8_t *mem, const uint8_t *at);
+
+// a branch to an instruction or one of the stubs after the code, patched once the function is emitted
+typedef struct JitFixup {
+    uint32_t at;
+    uint32_t target;
+} JitFixup;
+
+typedef struct JitRegion {
+    void *ptr;
+    size_t size;
+} JitRegion;
+
+// every function gets its own mapping, which is writable while the code is copied in and executable after
+typedef struct Jit {
+    BcModule *m;
+    Buf code;
+    Vec fixups;
+    Vec regions;
+    int64_t num_funcs;
+    int64_t num_bytes;
+} Jit;
+
+Jit jit_create(BcModule *m);
+void jit_free(Jit *jit);
+
+// compiles the function with the given index, returns false when it can not be mapped executable
+bool jit_compile(Jit *jit, uint32_t idx);
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "span.h"
 #include "utils.h"
+#include "timer.h"
 #include "source.h"
 
 typedef enum {
@@ -24,10 +25,13 @@ typedef enum {
     TOKEN_NEW,
     TOKEN_DELETE,
     TOKEN_RETURN,
+    TOKEN_BECOME,
     TOKEN_TYPE,
     TOKEN_STRUCT,
     TOKEN_AS,
     TOKEN_EXTERN,
+    TOKEN_INLINE,
+    TOKEN_NOINLINE,
     TOKEN_SEMI,
     TOKEN_COMMA,
     TOKEN_COLON,
@@ -69,6 +73,7 @@ typedef struct Lexer {
     bool has_peek;
     int32_t ctx;
     int32_t source_len;
+    int64_t num_tokens;
     Token peek;
     SourceFile source;
     const char *start;
@@ -0,0 +1,104 @@
+#ifndef SYNTHIUMC_LOOP_H
+#define SYNTHIUMC_LOOP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+
+#define LOOP_NONE UINT32_MAX
+#define LOOP_UNROLL_FACTOR 4
+// an unrolled loop may not grow past this many instructions
+#define LOOP_UNROLL_MAX_SIZE 160
+
+typedef struct Loop {
+    IrBlockId header;
+    // the only block entering the loop, which only jumps to the header, IR_NO_BLOCK if there is none
+    IrBlockId preheader;
+    // the only block jumping back to the header, IR_NO_BLOCK if there are several
+    IrBlockId latch;
+    uint32_t parent;
+    uint32_t depth;
+    uint32_t num_blocks;
+    bool is_innermost;
+
+    // the header leaves the loop once iv < bound (or <=) fails, iv starts at init and grows by step. only
+    // i32 counters that count up by a constant are recognised, iv is IR_NO_VALUE for every other loop
+    IrValue iv;
+    IrValue init;
+    IrValue bound;
+    int64_t step;
+    uint8_t cmp;
+    // how often the body runs, -1 unless init and bound are constants
+    int64_t trip_count;
+} Loop;
+
+// the natural loops of a function nested into a forest: every block belongs to the innermost loop around it
+// and every loop comes before the loops around it, so walking the loops in order visits inner loops first
+typedef struct LoopForest {
+    Vec loops;
+    uint32_t *block_loop;
+    uint32_t num_blocks;
+    uint32_t cap_blocks;
+    uint32_t *rpo;
+    uint32_t num_rpo;
+    Vec work;
+} LoopForest;
+
+LoopForest loop_forest_create();
+void loop_forest_free(LoopForest *lf);
+void loop_forest_build(LoopForest *lf, IrFunc *f);
+void loop_find_ivs(LoopForest *lf, IrFunc *f);
+Loop *loop_get(LoopForest *lf, uint32_t idx);
+bool loop_contains(LoopForest *lf, uint32_t idx, IrBlockId b);
+bool loop_is_invariant(LoopForest *lf, IrFunc *f, uint32_t idx, IrValue v);
+
+struct Vectorizer;
+
+// loop invariant code motion, strength reduction of induction variable multiplications and, from -O2 on,
+// vectorisation and unrolling of innermost counting loops with the original loop left in place for the
+// remaining iterations
+typedef struct LoopOpt {
+    IrFunc *f;
+    int32_t opt_level;
+    LoopForest forest;
+    // NULL unless the module goes to the native backend, the only one taking vectors
+    struct Vectorizer *vectorizer;
+
+    bool *escaped;
+    uint32_t *written;
+    uint32_t cap_slots;
+    IrValue *value_map;
+    uint32_t cap_values;
+    uint32_t num_mapped;
+    IrBlockId *block_map;
+    uint32_t cap_blocks;
+    Vec blocks;
+    Vec muls;
+    Vec phis;
+    uint32_t stamp;
+
+    int64_t num_loops;
+    int64_t num_preheaders;
+    int64_t num_trip_counts;
+    int64_t num_hoisted;
+    int64_t num_reduced;
+    int64_t num_unrolled;
+} LoopOpt;
+
+LoopOpt loop_opt_create(int32_t opt_level);
+void loop_opt_free(LoopOpt *lo);
+void loop_opt_func(LoopOpt *lo, IrFunc *f);
+// vectorize is only set when the module goes to the native backend
+typedef struct LoopParams {
+    int32_t opt_level;
+    bool vectorize;
+} LoopParams;
+
+Pass loop_pass(LoopParams *params);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef SYNTHIUMC_LOWER_H
+#define SYNTHIUMC_LOWER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "ty.h"
+#include "ast.h"
+#include "map.h"
+#include "mod.h"
+#include "vec.h"
+#include "span.h"
+#include "ident.h"
+#include "ptrvec.h"
+
+#define LOWER_NO_VAR UINT32_MAX
+
+// addr is the stack slot of structs and of variables whose address is taken, the rest are SSA values
+typedef struct LowerVar {
+    IrTypeId ty;
+    IrValue addr;
+} LowerVar;
+
+// prev is the binding of the same name that this one shadows, restored when the scope ends
+typedef struct LowerName {
+    const char *name;
+    int32_t len;
+    uint32_t var;
+    int32_t prev;
+} LowerName;
+
+// open addressing map from an identifier to an index, names stay in the table for the whole function
+typedef struct LowerScope {
+    const char **keys;
+    int32_t *lens;
+    int32_t *values;
+    uint32_t len;
+    uint32_t cap;
+} LowerScope;
+
+// an incomplete phi waits in the list of its block until the block is sealed
+typedef struct LowerPhi {
+    uint32_t var;
+    IrValue phi;
+    int32_t next;
+} LowerPhi;
+
+typedef struct LowerUser {
+    IrValue user;
+    int32_t next;
+} LowerUser;
+
+// open addressing map from (block, variable) to the current definition
+typedef struct LowerDefs {
+    uint64_t *keys;
+    IrValue *values;
+    uint32_t len;
+    uint32_t cap;
+} LowerDefs;
+
+// the per function buffers are reused for every function, so lowering stays linear in the size of the program
+typedef struct Lowerer {
+    IrModule *ir;
+    ModuleMap *mods;
+    SpanInterner *si;
+    const char **prefixes;
+    int32_t num_prefixes;
+    Map *globals;
+    Map strings;
+
+    Module *mod;
+    IrFunc *func;
+    IrBuilder b;
+    IrValue sret;
+    IrValue undef[IR_NUM_PRIMITIVE_TYPES];
+    Vec vars;
+    Vec names;
+    LowerScope scope;
+    LowerScope address_taken;
+    LowerDefs defs;
+
+    bool *sealed;
+    int32_t *pending_head;
+    uint32_t cap_blocks;
+    Vec pending;
+
+    IrValue *forward;
+    int32_t *user_head;
+    uint32_t cap_insts;
+    Vec users;
+
+    int64_t num_phis;
+} Lowerer;
+
+Lowerer lower_create(IrModule *ir, ModuleMap *mods, SpanInterner *si);
+void lower_free(Lowerer *l);
+void lower_all(Lowerer *l);
+void lower_continue_mod(Lowerer *l, Module *mod, int32_t file_idx);
+int64_t lower_func_bodies(Lowerer *l, Module *mod);
+const char **lower_symbol_prefixes(ModuleMap *mods);
+
+void lower_declare_structs(Lowerer *l, Module *mod);
+void lower_declare_funcs(Lowerer *l, Module *mod);
+void lower_declare_globals(Lowerer *l, Module *mod);
+IrTypeId lower_struct_ty(Lowerer *l, Struct *s);
+IrTypeId lower_ty(Lowerer *l, Ty *t);
+IrTypeId lower_value_ty(Lowerer *l, Ty *t);
+Func *lower_func_ty(Lowerer *l, Module *mod, FuncDef *def);
+void lower_func(Lowerer *l, FuncDeclStmt *f_s);
+
+int32_t lower_scope_get(LowerScope *s, const char *key, int32_t len);
+void lower_scope_set(LowerScope *s, const char *key, int32_t len, int32_t value);
+void lower_scope_clear(LowerScope *s);
+void lower_scope_free(LowerScope *s);
+
+IrBlockId lower_new_block(Lowerer *l);
+void lower_seal(Lowerer *l, IrBlockId block);
+void lower_write_var(Lowerer *l, uint32_t var, IrBlockId block, IrValue v);
+IrValue lower_read_var(Lowerer *l, uint32_t var, IrBlockId block);
+IrValue lower_find(Lowerer *l, IrValue v);
+
+void lower_stmt(Lowerer *l, Stmt *s);
+void lower_block(Lowerer *l, BlockStmt *b);
+void lower_cond(Lowerer *l, Expr *e, IrBlockId then_block, IrBlockId else_block);
+IrValue lower_expr(Lowerer *l, Expr *e);
+IrValue lower_addr(Lowerer *l, Expr *e);
+void lower_init_into(Lowerer *l, InitExpr *i_e, IrValue dst);
+IrValue lower_call_into(Lowerer *l, CallExpr *c_e, IrValue dst);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SYNTHIUMC_OPTIONS_H
+#define SYNTHIUMC_OPTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    REPORT_NONE,
+    REPORT_TABLE,
+    REPORT_JSON
+} ReportFormat;
+
+typedef enum {
+    EMIT_NONE,
+    EMIT_IR,
+    EMIT_OBJ,
+    EMIT_C,
+    EMIT_BYTECODE
+} EmitKind;
+
+typedef struct Options {
+    ReportFormat time_report;
+    const char *time_report_file;
+    const char *time_trace_file;
+    EmitKind emit;
+    const char *output_file;
+    int32_t opt_level;
+    int32_t inline_threshold;
+    // the threads optimisation runs on, 0 for one per cpu
+    int32_t jobs;
+    const char *profile_generate;
+    const char *profile_use;
+    bool verify_ir;
+    bool run;
+    bool jit;
+    bool repl;
+    int32_t num_files;
+    const char **files;
+    int32_t num_run_args;
+    const char **run_args;
+} Options;
+
+Options options_empty();
+bool options_parse(Options *opts, int32_t argc, const char **argv);
+void options_free(Options *opts);
+
+#endif
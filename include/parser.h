@@ -54,6 +54,7 @@ Stmt *parser_statement(Parser *p);
 bool parser_parse_statement(Parser *p, Stmt **dest);
 Stmt *parser_parse_delete_stmt(Parser *p);
 Stmt *parser_parse_return_stmt(Parser *p);
+Stmt *parser_parse_become_stmt(Parser *p);
 Stmt *parser_parse_import_stmt(Parser *p);
 Stmt *parser_parse_let_stmt(Parser *p);
 Stmt *parser_parse_type_stmt(Parser *p);
@@ -72,6 +73,7 @@ Expr *parser_expression(Parser *p, bool no_struct);
 Expr *parser_parse_expression(Parser *p, Precedence precedence, bool no_struct);
 bool parser_next_higher_precedence(Parser *p, Precedence precedence, bool no_struct);
 Expr *parser_prefix(Parser *p, bool no_struct);
+int64_t parser_parse_int(Parser *p, Token *token);
 Expr *parser_infix(Parser *p, Token *token, Expr *left, bool no_struct);
 
 int32_t parser_sync(Parser *p);
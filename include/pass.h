@@ -0,0 +1,72 @@
+#ifndef SYNTHIUMC_PASS_H
+#define SYNTHIUMC_PASS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pool.h"
+
+typedef enum {
+    PASS_MODULE,
+    PASS_FUNC
+} PassKind;
+
+// a module pass runs once over all functions. a function pass runs on one function at a time, on as many threads
+// as the pool has, so it gets a state per worker from create, may only change the function it is given and read
+// what it needs of the others. finish adds a state's statistics to the time report and frees it. preserves has
+// the IR_ANALYSIS_ bits that stay valid in the functions the pass changed
+typedef struct Pass {
+    const char *name;
+    PassKind kind;
+    uint32_t preserves;
+    void *params;
+
+    void (*run_module)(IrModule *m, void *params);
+
+    void *(*create)(IrModule *m, void *params);
+    // returns whether it changed f
+    bool (*run_func)(void *state, IrFunc *f);
+    void (*finish)(void *state);
+} Pass;
+
+// what one worker of a function pass uses, the fingerprints are only taken for the time report
+typedef struct PassWorker {
+    void *state;
+    uint64_t *before;
+    uint64_t *after;
+    uint32_t cap_insts;
+    int64_t num_funcs;
+    int64_t num_insts;
+} PassWorker;
+
+// runs passes in order and keeps the analyses cached on every function (see IR_ANALYSIS_DOMINATORS) until a pass
+// that changed the function does not preserve them. under --time-report every pass gets a row with its wall time,
+// the functions it changed and the instructions it added, removed or rewrote in them, found by comparing a hash
+// of every instruction from before the pass with one from after it
+typedef struct PassManager {
+    IrModule *m;
+    Pool *pool;
+    Vec passes;
+
+    PassWorker *workers;
+    // the functions a function pass runs on, the largest first so no worker is left with a big one at the end
+    uint64_t *order;
+    uint32_t num_order;
+    const Pass *pass;
+} PassManager;
+
+PassManager pass_manager_create(IrModule *m, Pool *pool);
+void pass_manager_free(PassManager *pm);
+void pass_manager_add(PassManager *pm, Pass pass);
+void pass_manager_run(PassManager *pm);
+
+// a hash of every instruction in a block of f, of the block, what it computes and from what. the others get 0
+void pass_fingerprint(IrFunc *f, uint64_t *hashes);
+// how many instructions differ between two fingerprints of the same function
+int64_t pass_count_changed(uint64_t *before, uint32_t num_before, uint64_t *after, uint32_t num_after);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef SYNTHIUMC_PLACE_H
+#define SYNTHIUMC_PLACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+
+#define PLACE_NONE UINT32_MAX
+// a cluster of functions that call each other stops growing at this many instructions, a few pages of code
+#define PLACE_MAX_CLUSTER_INSTS 4096
+
+// a control flow edge or a call graph edge, seq keeps the sort stable
+typedef struct PlaceEdge {
+    uint32_t from;
+    uint32_t to;
+    int64_t weight;
+    uint32_t seq;
+} PlaceEdge;
+
+// a cluster of functions laid out together, named after its first function
+typedef struct PlaceCluster {
+    int64_t hotness;
+    uint32_t head;
+} PlaceCluster;
+
+// code placement: which blocks are cold and the order the rest is laid out in, and the order functions are
+// emitted in. a profiled function's hot blocks are chained along their most frequent edges (Pettis and Hansen,
+// "Profile Guided Code Positioning"), the blocks that never ran are cold and a function that was never entered
+// is cold as a whole. without a profile the blocks stay in reverse postorder, and the cold ones are those that
+// only lead to an error return, a call that does not return or unreachable code, or that only those lead to
+typedef struct Place {
+    IrModule *m;
+
+    // per function
+    bool *no_return;
+    uint32_t *cluster;
+    uint32_t *func_next;
+    uint32_t *func_tail;
+    int64_t *cluster_insts;
+    int64_t *cluster_hotness;
+
+    // per block, chains are named after their first block
+    bool *cold;
+    int32_t *rpo_idx;
+    IrBlockId *chain;
+    IrBlockId *next;
+    IrBlockId *tail;
+    uint32_t cap_blocks;
+
+    Vec edges;
+    Vec heads;
+
+    int64_t num_no_return;
+    int64_t num_blocks;
+    int64_t num_cold_blocks;
+    int64_t num_cold_funcs;
+    int64_t num_chained;
+    int64_t num_clustered;
+} Place;
+
+Place place_create(IrModule *m);
+void place_free(Place *p);
+// a Place for placing blocks on another thread, its statistics are added back by the caller
+Place place_fork(Place *p);
+// whether f never runs under its profile, so all of it goes with the cold code
+bool place_func_is_cold(IrFunc *f);
+// reorders the reverse postorder of f into its layout: the hot blocks with the entry first, then the cold ones.
+// returns the number of hot blocks, 0 when the whole function is cold
+uint32_t place_blocks(Place *p, IrFunc *f, uint32_t *order, uint32_t num_order);
+// the defined functions in the order they are emitted: the hot ones clustered with their callers along the call
+// graph's heaviest edges, the cold ones last. returns how many there are
+uint32_t place_funcs(Place *p, uint32_t *order);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SYNTHIUMC_POOL_H
+#define SYNTHIUMC_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// runs the task with index i on the worker with the given index, 0 is the thread that called pool_run. a task
+// keeps whatever it needs per worker in an array indexed by it
+typedef void (*PoolTask)(void *ctx, uint32_t worker, uint32_t i);
+
+struct Pool;
+
+// the tasks a worker still has are idx + k * num_workers for k from the low to the high half of range. both halves
+// are packed into one word so the owner and the thieves can take from either end with one compare and swap
+typedef struct PoolWorker {
+    struct Pool *pool;
+    uint32_t idx;
+    pthread_t thread;
+    _Atomic uint64_t range;
+} PoolWorker;
+
+#define POOL_RANGE(lo, hi) ((uint64_t) (lo) | ((uint64_t) (hi) << 32))
+
+// a thread pool: the workers sleep until pool_run hands them a batch of tasks. every worker owns every
+// num_workers-th task of it and runs them from the front, then steals from the back of the others' until none are
+// left, so neighbouring tasks do not bounce one counter between cpus. the thread calling pool_run works on the
+// batch too and returns once all of it is done
+typedef struct Pool {
+    uint32_t num_workers;
+    PoolWorker *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t batch;
+    uint32_t num_busy;
+    bool stop;
+
+    PoolTask task;
+    void *ctx;
+    uint32_t num_tasks;
+} Pool;
+
+// the number of cpus online, 1 when that can not be found out
+uint32_t pool_num_cpus();
+// num_workers counts the calling thread, a pool of one runs every batch on it without starting any threads
+Pool *pool_create(uint32_t num_workers);
+void pool_free(Pool *p);
+void pool_run(Pool *p, uint32_t num_tasks, PoolTask task, void *ctx);
+
+#endif
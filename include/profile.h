@@ -0,0 +1,52 @@
+#ifndef SYNTHIUMC_PROFILE_H
+#define SYNTHIUMC_PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+
+// "SYNPROF1" read as a little endian word
+#define PROFILE_MAGIC 0x31464f52504e5953ull
+#define PROFILE_HASH_SEED 0xcbf29ce484222325ull
+
+// the counts of one function: how often it was entered, then one count per edge, taking the blocks in order
+// and the successors of each in order
+typedef struct ProfileFunc {
+    uint64_t hash;
+    uint32_t num_counts;
+    uint64_t *counts;
+} ProfileFunc;
+
+// a profile is the counter words the instrumented program wrote at exit, as they were in its memory: the magic
+// and the number of functions, then per function its hash, its number of counters and the counters
+typedef struct Profile {
+    uint64_t *words;
+    uint64_t num_words;
+    ProfileFunc *funcs;
+    uint32_t num_funcs;
+
+    int64_t num_matched;
+    int64_t num_stale;
+} Profile;
+
+// instrumentation and its use both run right after lowering, so the CFG a function is hashed with is the same
+// in the build that counts and the build that reads the counts
+uint64_t profile_hash(uint64_t h, const void *data, size_t len);
+uint64_t profile_func_hash(IrFunc *f);
+uint32_t profile_num_counters(IrFunc *f);
+
+// counts every edge of every function into one global and has main write it to path before it returns
+void profile_instrument_module(IrModule *m, const char *path);
+
+Profile profile_create();
+void profile_free(Profile *p);
+// false with errno set when the file can not be read or is not a profile
+bool profile_read(Profile *p, const char *path);
+// sets the freq of the blocks of every function the profile has counts for, and marks it IR_FUNC_PROFILED
+void profile_apply_module(IrModule *m, Profile *p);
+
+#endif
@@ -29,5 +29,7 @@ void reader_free_fm(FileMap *fm);
 FileAddResult reader_add_std_lib(FileMap *fm, Path *bin_path);
 FileAddResult reader_add_all(FileMap *fm, Path *bin_path, int32_t len, const char **file_names);
 int32_t reader_add_file(FileMap *fm, Path *bin_path, const char *name);
+int32_t reader_add_source(FileMap *fm, const char *name, const char *code);
+int32_t reader_load_file(FileMap *fm, Path *bin_path, const char *name);
 
 #endif
@@ -0,0 +1,134 @@
+#ifndef SYNTHIUMC_REGALLOC_H
+#define SYNTHIUMC_REGALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "x64.h"
+
+typedef enum {
+    LOC_NONE,
+    LOC_REG,
+    LOC_STACK
+} LocKind;
+
+// values without a location (constants, addresses of strings, globals, functions and stack slots)
+// are rematerialized at every use, spilled values live in their own frame slot
+typedef struct Loc {
+    uint8_t kind;
+    uint8_t reg;
+    int32_t slot;
+} Loc;
+
+#define RA_NUM_REGS 10
+#define RA_FIRST_CALLEE_SAVED 5
+#define RA_MAX_LOOP_DEPTH 4
+// with a profile the entry block weighs this much and no block more than the maximum
+#define RA_PROFILE_ENTRY_WEIGHT 10
+#define RA_MAX_PROFILE_WEIGHT ((int64_t) 1 << 40)
+
+// rax, rcx, rdx and r11 are left to the instruction selector as scratch registers, the caller saved
+// registers come first so values that do not live across a call leave the callee saved ones alone
+extern const X64Reg regalloc_regs[RA_NUM_REGS];
+
+typedef struct RaInterval {
+    IrValue v;
+    int32_t start;
+    int32_t end;
+    bool crosses_call;
+} RaInterval;
+
+// a value's location from start on, until the next segment of the same value begins
+typedef struct RaSegment {
+    int32_t start;
+    int32_t next;
+    Loc loc;
+} RaSegment;
+
+// a segment that does not start at the definition of its value, the code generator moves the value there
+typedef struct RaSplit {
+    int32_t pos;
+    IrValue v;
+} RaSplit;
+
+// positions number the instructions in layout order in steps of two, a value that is live out of a block
+// ends one past the block's terminator, so a phi copy at the end of the block can not take its register.
+// the odd positions in between are where split values move. every use is weighted by the loop depth of its
+// block, which is what spilling a value costs
+typedef struct RegAlloc {
+    IrFunc *f;
+    uint32_t *order;
+    uint32_t num_order;
+    // the blocks from here on in the order are cold and out of line, a jump from them back to a hot block is no loop
+    uint32_t first_cold;
+
+    int32_t *pos;
+    int32_t *start;
+    int32_t *end;
+    uint32_t *num_uses;
+    uint32_t *global_idx;
+    IrValue *global_vals;
+    bool *fused;
+    Loc *locs;
+    uint32_t *use_off;
+    int32_t *first_seg;
+    int32_t *last_seg;
+    int32_t *cur_seg;
+    int32_t *spill_slot;
+    uint32_t cap_insts;
+
+    int32_t *block_start;
+    int32_t *block_end;
+    int32_t *block_idx;
+    int32_t *block_depth;
+    uint64_t *live_in;
+    uint64_t *live_out;
+    uint64_t *kill;
+    uint32_t cap_blocks;
+    uint64_t cap_words;
+
+    int32_t *use_pos;
+    int64_t *use_sum;
+    uint32_t cap_uses;
+
+    int32_t *calls;
+    uint32_t num_calls;
+    uint32_t cap_calls;
+    RaInterval *intervals;
+    uint32_t num_intervals;
+    uint32_t cap_intervals;
+    uint32_t *unhandled;
+    uint32_t num_unhandled;
+
+    RaSegment *segments;
+    uint32_t num_segments;
+    uint32_t cap_segments;
+    RaSplit *splits;
+    uint32_t num_splits;
+    uint32_t cap_splits;
+
+    uint32_t num_globals;
+    int32_t num_slots;
+    uint32_t used_regs;
+    int64_t num_spilled;
+    int64_t num_split;
+} RegAlloc;
+
+RegAlloc regalloc_create();
+void regalloc_free(RegAlloc *ra);
+void regalloc_prepare(RegAlloc *ra, IrFunc *f, uint32_t *order, uint32_t num_order);
+void regalloc_allocate(RegAlloc *ra);
+void regalloc_run(RegAlloc *ra, IrFunc *f, uint32_t *order, uint32_t num_order);
+bool regalloc_is_frame_addr(IrFunc *f, IrValue v);
+bool regalloc_is_remat(IrFunc *f, IrValue v);
+bool regalloc_is_call(IrOp op);
+Loc *regalloc_loc_at(RegAlloc *ra, IrValue v, int32_t pos);
+void regalloc_spill(RegAlloc *ra, IrValue v);
+int32_t regalloc_hint(RegAlloc *ra, IrValue v);
+int64_t regalloc_use_cost(RegAlloc *ra, IrValue v, int32_t from, int32_t to);
+int64_t regalloc_block_weight(RegAlloc *ra, IrBlockId b);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SYNTHIUMC_REPL_H
+#define SYNTHIUMC_REPL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vm.h"
+#include "mod.h"
+#include "path.h"
+#include "lower.h"
+#include "reader.h"
+#include "typecheck.h"
+
+// a binding a declaring input replaced, put back when the input does not type check
+typedef struct ReplBinding {
+    Ident *ident;
+    Ty *ty;
+} ReplBinding;
+
+// every input is parsed into its own module that shares the type and the symbols of the repl's module, so the
+// checker's context, the lowerer, the bytecode and the vm all live as long as the session
+typedef struct Repl {
+    SpanInterner si;
+    FileMap fm;
+    ModuleMap mm;
+    TypeChecker tc;
+    IrModule ir;
+    Lowerer lowerer;
+    BcModule bc;
+    Vm vm;
+    Module *mod;
+    Ptrvec lines;
+    Vec bindings;
+    Path *compiler_path;
+    const char *path;
+    int32_t first_input;
+    int32_t num_inputs;
+    bool jit;
+} Repl;
+
+// reads inputs from stdin until it ends or `:quit`. files are loaded, like the compiler's inputs, before the first
+// prompt, returns non zero when they have errors
+int32_t repl_run(Path *compiler_path, int32_t num_files, const char **files, bool jit);
+
+#endif
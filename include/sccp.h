@@ -0,0 +1,57 @@
+#ifndef SYNTHIUMC_SCCP_H
+#define SYNTHIUMC_SCCP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+
+// a value is unknown until an executable definition reaches it, then one constant, then anything
+typedef enum {
+    SCCP_TOP,
+    SCCP_CONST,
+    SCCP_BOTTOM
+} SccpState;
+
+// sparse conditional constant propagation (Wegman and Zadeck): values are only evaluated in blocks some
+// executable edge reaches and only revisited when an operand changes, which happens at most twice per value,
+// so a function takes time linear in its instructions, uses and edges. the buffers only grow and are shared
+// by all functions of a module
+typedef struct Sccp {
+    IrFunc *f;
+
+    uint8_t *state;
+    int64_t *value;
+    uint32_t *use_off;
+    uint32_t cap_insts;
+    IrValue *users;
+    uint32_t cap_users;
+
+    bool *reachable;
+    uint32_t *edge_off;
+    uint32_t cap_blocks;
+    bool *edge_live;
+    uint32_t cap_edges;
+
+    Vec block_work;
+    Vec value_work;
+    Vec phis;
+
+    int64_t num_folded;
+    int64_t num_branches;
+    int64_t num_dead_blocks;
+} Sccp;
+
+Sccp sccp_create();
+void sccp_free(Sccp *s);
+
+// folds the values that are constant on every executable path into constants, turns branches on them into
+// jumps and leaves the blocks no executable edge reaches with nothing but an unreachable
+void sccp_func(Sccp *s, IrFunc *f);
+Pass sccp_pass();
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SYNTHIUMC_SROA_H
+#define SYNTHIUMC_SROA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+
+#define SROA_NO_FIELD UINT32_MAX
+// a slot with more scalars than this stays in memory
+#define SROA_MAX_FIELDS 32
+
+// one scalar of a slot: every load and store at offset with type ty
+typedef struct SroaField {
+    IrValue slot;
+    uint32_t offset;
+    IrTypeId ty;
+    // accesses[first..end) are this field's
+    uint32_t first;
+    uint32_t end;
+    bool is_loaded;
+    // the value the walk has reached, and the constant reads before any store get
+    IrValue cur;
+    IrValue undef;
+} SroaField;
+
+typedef struct SroaAccess {
+    IrValue slot;
+    uint32_t offset;
+    IrTypeId ty;
+    IrValue v;
+} SroaAccess;
+
+typedef struct SroaUndo {
+    uint32_t field;
+    IrValue old;
+} SroaUndo;
+
+typedef struct SroaFrame {
+    IrBlockId b;
+    uint32_t next_child;
+    uint32_t num_undo;
+} SroaFrame;
+
+// scalar replacement of aggregates: a stack slot whose address never escapes and that is only loaded and stored
+// at fixed offsets, with one type per offset and none overlapping, becomes one SSA value per offset. struct
+// copies from or into such a slot are split into a load and a store per scalar of the struct first. phis go on
+// the iterated dominance frontier of the blocks storing a field that is loaded (Cytron et al.), one walk over the
+// dominator tree renames the loads, and the phis nothing reads are removed afterwards
+typedef struct Sroa {
+    IrModule *m;
+    IrFunc *f;
+
+    // per value
+    bool *escaped;
+    bool *replaced;
+    uint32_t *field;
+    IrValue *repl;
+    uint32_t cap_insts;
+
+    // per block, the dominance frontiers come from Cooper, Harvey and Kennedy
+    uint32_t *df_off;
+    uint32_t *has_phi;
+    uint32_t *queued;
+    bool *visited;
+    uint32_t cap_blocks;
+    IrBlockId *df;
+    uint32_t cap_df;
+    Vec df_edges;
+
+    Vec leaves;
+    Vec values;
+    Vec accesses;
+    Vec fields;
+    Vec phis;
+    Vec work;
+    Vec undo;
+    Vec frames;
+    uint32_t stamp;
+
+    int64_t num_copies;
+    int64_t num_slots;
+    int64_t num_fields;
+    int64_t num_phis;
+} Sroa;
+
+Sroa sroa_create(IrModule *m);
+void sroa_free(Sroa *s);
+void sroa_func(Sroa *s, IrFunc *f);
+Pass sroa_pass();
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SYNTHIUMC_TAILCALL_H
+#define SYNTHIUMC_TAILCALL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "pass.h"
+#include "span.h"
+
+// the native backend passes this many arguments in registers, the stack arguments of a sibling call taking more
+// would have to go where the caller's caller put the caller's
+#define TAILCALL_MAX_ARGS 6
+
+// a `become` that can not be a tail call, span is its call
+typedef struct TailCallError {
+    const char *text;
+    Span span;
+} TailCallError;
+
+// tail calls: a call whose result is returned right away needs nothing of its caller's frame anymore. a function
+// calling itself that way jumps back to the start of its body instead, with phis for its parameters, and a call
+// of any other function is marked IR_FLAG_TAIL, so the native backend tears the frame down and jumps to it. an
+// argument pointing into the frame keeps a call from being a tail call, and so does a stack slot of the caller
+// that escapes, unless the call is a `become`, which promises that the frame is not needed. at -O0 only the
+// calls of a `become` are changed. one that can not be is an error, found by tailcall_check_module on the IR as
+// lowered
+typedef struct TailCall {
+    IrModule *m;
+    IrFunc *f;
+    bool all;
+    Vec *errors;
+
+    // per value, mark is the query that last walked it
+    bool *escaped;
+    uint32_t *mark;
+    uint32_t cap_insts;
+    uint32_t query;
+
+    Vec work;
+    Vec self;
+
+    int64_t num_self;
+    int64_t num_sibling;
+    int64_t num_become;
+} TailCall;
+
+TailCall tailcall_create(IrModule *m, bool all, Vec *errors);
+void tailcall_free(TailCall *t);
+
+// the call b ends in when b returns its result, straight away or through a block doing nothing else
+IrValue tailcall_find(TailCall *t, IrBlockId b);
+void tailcall_func(TailCall *t, IrFunc *f);
+// reports the `become` calls of f that can not be tail calls and changes nothing
+void tailcall_check_func(TailCall *t, IrFunc *f);
+// checks the `become` calls as lowered, before the inliner or any other pass changed them, so one is accepted or
+// rejected the same at every level and under --emit=c. returns the number of errors added
+int32_t tailcall_check_module(IrModule *m, Vec *errors);
+// returns the number of `become` calls that could not be tail calls, errors gets a TailCallError for each
+int32_t tailcall_module(IrModule *m, int32_t opt_level, Vec *errors);
+
+typedef struct TailCallParams {
+    int32_t opt_level;
+    Vec *errors;
+} TailCallParams;
+
+Pass tailcall_pass(TailCallParams *params);
+
+#endif
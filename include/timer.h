@@ -0,0 +1,104 @@
+#ifndef SYNTHIUMC_TIMER_H
+#define SYNTHIUMC_TIMER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vec.h"
+#include "alloc.h"
+
+#define TIMER_NUM_COUNTERS 4
+
+typedef enum {
+    PHASE_STDLIB_LOAD,
+    PHASE_FILE_LOAD,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_MOD_SORT,
+    PHASE_TYPECHECK,
+    PHASE_LOWER,
+    PHASE_OPTIMIZE,
+    PHASE_CODEGEN,
+    PHASE_EMIT_C,
+    PHASE_BYTECODE,
+    PHASE_RUN,
+    PHASE_DIAGNOSTICS,
+    PHASE_TEARDOWN,
+    PHASE_COUNT
+} Phase;
+
+typedef enum {
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CYCLES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_LLC_MISSES
+} Counter;
+
+typedef struct PhaseSnapshot {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    AllocStats allocs;
+    uint64_t counters[TIMER_NUM_COUNTERS];
+} PhaseSnapshot;
+
+typedef struct PhaseTimes {
+    int32_t runs;
+    bool nested;
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    int64_t peak_rss_kb;
+    uint64_t counters[TIMER_NUM_COUNTERS];
+    PhaseSnapshot start;
+} PhaseTimes;
+
+typedef struct Stat {
+    const char *name;
+    int64_t value;
+} Stat;
+
+// the runs of one optimisation pass, summed up. funcs is the number of functions a run changed and insts the
+// number of instructions it added, removed or rewrote in them
+typedef struct PassTimes {
+    const char *name;
+    int32_t runs;
+    uint64_t wall_ns;
+    int64_t funcs;
+    int64_t insts;
+} PassTimes;
+
+typedef struct TimeReport {
+    bool has_counters;
+    int32_t counter_fds[TIMER_NUM_COUNTERS];
+    PhaseTimes phases[PHASE_COUNT];
+    Vec passes;
+    Vec stats;
+} TimeReport;
+
+// checked by the nested lexer timing hook, so that it costs a single branch when the report is off
+extern bool timer_enabled;
+extern uint64_t timer_lex_ns;
+
+void timer_init(bool enabled);
+bool timer_open_counters(TimeReport *tr);
+void timer_close_counters(TimeReport *tr);
+uint64_t timer_now_ns();
+uint64_t timer_cpu_ns();
+int64_t timer_peak_rss_kb();
+const char *timer_phase2str(Phase phase);
+const char *timer_counter2str(Counter counter);
+PhaseSnapshot timer_snapshot(TimeReport *tr);
+void timer_phase_begin(Phase phase);
+void timer_phase_end(Phase phase);
+void timer_phase_add_nested(Phase phase, Phase parent, uint64_t wall_ns);
+void timer_pass_add(const char *name, uint64_t wall_ns, int64_t funcs, int64_t insts);
+void timer_stat_add(const char *name, int64_t value);
+int64_t timer_stat_get(const char *name);
+void timer_print_table(FILE *out);
+void timer_print_json(FILE *out);
+void timer_free();
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SYNTHIUMC_TIMETRACE_H
+#define SYNTHIUMC_TIMETRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vec.h"
+
+// both macros cost a single predictable branch when tracing is off
+#define TIMETRACE_BEGIN(name, mod_len, mod, sym_len, sym) \
+    (__builtin_expect(timetrace_enabled, 0) ? timetrace_begin((name), (mod_len), (mod), (sym_len), (sym)) : -1)
+
+#define TIMETRACE_END(id)                        \
+    do {                                         \
+        if (__builtin_expect((id) >= 0, 0)) {    \
+            timetrace_end(id);                   \
+        }                                        \
+    } while (0)
+
+typedef struct TimeTraceEvent {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int32_t mod_offset;
+    int32_t mod_len;
+    int32_t sym_offset;
+    int32_t sym_len;
+} TimeTraceEvent;
+
+typedef struct TimeTraceThread {
+    int32_t tid;
+    const char *name;
+    Vec events;
+    Vec strings;
+    struct TimeTraceThread *next;
+} TimeTraceThread;
+
+extern bool timetrace_enabled;
+
+void timetrace_init(const char *path);
+int32_t timetrace_begin(const char *name, int32_t mod_len, const char *mod, int32_t sym_len, const char *sym);
+void timetrace_end(int32_t id);
+void timetrace_set_thread_name(const char *name);
+bool timetrace_write();
+void timetrace_free();
+
+#endif
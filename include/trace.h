@@ -0,0 +1,73 @@
+#ifndef SYNTHIUMC_TRACE_H
+#define SYNTHIUMC_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_WARN 2
+#define TRACE_LEVEL_INFO 3
+#define TRACE_LEVEL_DEBUG 4
+
+// trace points above this level are removed at compile time (-DTRACE_MAX_LEVEL=0 removes all of them)
+#ifndef TRACE_MAX_LEVEL
+#define TRACE_MAX_LEVEL TRACE_LEVEL_DEBUG
+#endif
+
+#define TRACE_BUFFER_SIZE 65536
+#define TRACE_MAX_RECORD 1024
+
+typedef enum {
+    TRACE_CAT_TYPECHECK = 1 << 0,
+    TRACE_CAT_LAYOUT = 1 << 1,
+    TRACE_CAT_PARSE = 1 << 2,
+    TRACE_CAT_MOD = 1 << 3,
+    TRACE_CAT_AST = 1 << 4,
+    TRACE_CAT_REGALLOC = 1 << 5,
+    TRACE_CAT_INLINE = 1 << 6,
+    TRACE_CAT_LOOP = 1 << 7,
+    TRACE_CAT_PLACE = 1 << 8,
+    TRACE_CAT_ALL = (1 << 9) - 1
+} TraceCategory;
+
+typedef struct TraceBuffer {
+    char data[TRACE_BUFFER_SIZE];
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+// one category mask per level, so an enabled check is a single load and test
+extern uint32_t trace_level_masks[TRACE_LEVEL_DEBUG + 1];
+
+#define TRACE(cat, lvl, ...)                                                                        \
+    do {                                                                                            \
+        if ((lvl) <= TRACE_MAX_LEVEL && __builtin_expect((trace_level_masks[(lvl)] & (cat)) != 0, 0)) { \
+            trace_emit((cat), (lvl), __VA_ARGS__);                                                  \
+        }                                                                                           \
+    } while (0)
+
+#define TRACE_ERROR(cat, ...) TRACE((cat), TRACE_LEVEL_ERROR, __VA_ARGS__)
+#define TRACE_WARN(cat, ...) TRACE((cat), TRACE_LEVEL_WARN, __VA_ARGS__)
+#define TRACE_INFO(cat, ...) TRACE((cat), TRACE_LEVEL_INFO, __VA_ARGS__)
+#define TRACE_DEBUG(cat, ...) TRACE((cat), TRACE_LEVEL_DEBUG, __VA_ARGS__)
+
+#define TRACE_IS_ENABLED(cat, lvl) ((lvl) <= TRACE_MAX_LEVEL && (trace_level_masks[(lvl)] & (cat)) != 0)
+
+void trace_init();
+bool trace_parse_spec(const char *spec);
+void trace_enable(uint32_t categories, int32_t level);
+void trace_disable_all();
+bool trace_set_output(const char *path);
+const char *trace_cat2str(uint32_t cat);
+const char *trace_level2str(int32_t level);
+void trace_emit(uint32_t cat, int32_t level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void trace_vemit(uint32_t cat, int32_t level, const char *fmt, va_list args);
+void trace_flush();
+void trace_shutdown();
+
+#endif
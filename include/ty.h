@@ -45,28 +45,35 @@ typedef struct String {
 typedef struct StructField {
     Ident name;
     Ty *ty;
+    int32_t offset;
 } StructField;
 
+// ir_ty is the id of the lowered type, 0 until the struct is lowered
 typedef struct Struct {
     Ty t;
     Ident name;
     Vec fields;
+    uint32_t ir_ty;
 } Struct;
 
 typedef struct TypeList {
     Ptrvec types;
 } TypeList;
 
+// ir_idx is the index of the lowered function, -1 until the function is declared in the IR
 typedef struct Func {
     Ty t;
     Ty *ret;
     TypeList params;
     Ident name;
+    bool is_varargs;
+    int32_t ir_idx;
 } Func;
 
 typedef struct Mod {
     Ty t;
     Scope scope;
+    int32_t idx;
 } Mod;
 
 Ty *ty_new_i32();
@@ -89,6 +96,7 @@ Struct *ty_as_struct(Ty *t);
 void ty_push_field(Struct *t, Ident name, Ty *ty);
 StructField *ty_field_at(Struct *t, int32_t i);
 int32_t ty_num_fields(Struct *t);
+int32_t ty_field_index(Struct *t, SpanInterner *si, Ident *name);
 
 Ty *ty_new_func(Ty *ret, Ptrvec params, Ident name);
 bool ty_is_func(Ty *t);
@@ -102,6 +110,8 @@ Ty *ty_new_placeholder_type(TyTypes kind, int32_t size);
 Ty ty_create_type(TyTypes ty);
 bool ty_is_initialized(Ty *t);
 bool ty_is_scoped(Ty *t);
+bool ty_eq(Ty *a, Ty *b);
+bool ty_is_scalar(Ty *t);
 
 TypeList ty_new_empty_list();
 TypeList ty_create_type_list(Ptrvec types);
@@ -43,8 +43,10 @@ typedef struct TypeError {
     Span span;
 } TypeError;
 
+// func is the function whose body is being checked, NULL at the top level of a module
 typedef struct Ctx {
     Module *mod;
+    Func *func;
     Map imports;
     ScopeStack scopes;
 } Ctx;
@@ -54,10 +56,14 @@ typedef struct TypeChecker {
     ModuleMap *mods;
     int32_t *sorted_mods;
     Ptrvec temp_types;
+    Ty *i32_ty;
+    Ty *string_ty;
     Ctx ctx;
     Scope globals;
     Vec errors;
     Vec requests;
+    // the C emitter has the calls of a `become` checked on the IR when there are any
+    int32_t num_become;
 } TypeChecker;
 
 WaitingRequest typecheck_create_waiting_request(WaitingType kind, Ty *to_fill, Module *to_fill_mod, Ty *waiting_for_ty, Module *waiting_for_mod, int32_t field_idx);
@@ -87,17 +93,39 @@ TypeError *typecheck_get_err(TypeChecker *tc, int32_t i);
 void typecheck_add_import_alias(TypeChecker *tc, Ident *ident, Module *mod);
 int32_t *typecheck_sorted_mods(ModuleMap *mods, SpanInterner *si);
 Mod *typecheck_make_mod_type(TypeChecker *tc, Module *mod, SpanInterner *si);
+void typecheck_declare_structs(TypeChecker *tc, Mod *mod_ty, Module *mod, SpanInterner *si);
 Ty *typecheck_lookup_ident(TypeChecker *tc, Ident *ident);
 Ty *typecheck_lookup_ident_mod(TypeChecker *tc, Ident *ident, Module **out_mod);
 void typecheck_check(TypeChecker *tc);
 Mod *typecheck_check_mod(TypeChecker *tc, Module *mod);
+void typecheck_continue_mod(TypeChecker *tc, Module *mod);
+void typecheck_check_stmts(TypeChecker *tc, Module *mod);
 Ty *typecheck_push_tmp_ty(TypeChecker *tc, Ty *ty);
 void typecheck_bind(TypeChecker *tc, Ident *ident, Ty *ty);
+void typecheck_bind_global(TypeChecker *tc, Ident *ident, Ty *ty);
+bool typecheck_names_type(TypeChecker *tc, Ident *ident, Ty *ty);
+Ty *typecheck_resolve_type(TypeChecker *tc, Type *t);
+Ty *typecheck_ref_ty(TypeChecker *tc, Ty *inner);
+Ty *typecheck_deref_ty(TypeChecker *tc, Ty *ptr);
+Struct *typecheck_accessed_struct(Ty *ty);
+bool typecheck_is_lvalue(Expr *e);
+bool typecheck_is_constant(Expr *e);
 void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s_ty);
 void typecheck_update_waiting(TypeChecker *tc, Module *mod, Ty *resolved_ty, Ident *ident);
 Ident *typecheck_get_import_alias(TypeChecker *tc, ImportStmt *imp);
 Stmt *typecheck_check_stmt(TypeChecker *tc, Stmt *s);
+bool typecheck_check_become(TypeChecker *tc, Expr *expr);
+bool typecheck_check_func_decl(TypeChecker *tc, FuncDeclStmt *f_s);
+void typecheck_check_func_body(TypeChecker *tc, FuncDeclStmt *f_s);
+bool typecheck_check_block(TypeChecker *tc, BlockStmt *b);
+bool typecheck_check_cond(TypeChecker *tc, Expr *e);
 Expr *typecheck_check_expr(TypeChecker *tc, Expr *e);
+Expr *typecheck_check_access_expr(TypeChecker *tc, AccessExpr *a_e);
+Expr *typecheck_check_call_expr(TypeChecker *tc, CallExpr *c_e);
+Expr *typecheck_check_init_expr(TypeChecker *tc, InitExpr *i_e);
+Expr *typecheck_check_binary_expr(TypeChecker *tc, BinaryExpr *b_e);
+bool typecheck_check_int_lit(TypeChecker *tc, Expr *e, bool negated);
+Expr *typecheck_check_unary_expr(TypeChecker *tc, UnaryExpr *u_e);
 void typecheck_free_tc(TypeChecker *tc);
 
 #endif
@@ -0,0 +1,96 @@
+#ifndef SYNTHIUMC_VECTORIZE_H
+#define SYNTHIUMC_VECTORIZE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ir.h"
+#include "vec.h"
+#include "loop.h"
+
+// below this many iterations the checks in front of the vector loop cost more than they save
+#define VECTORIZE_MIN_COUNT 8
+// codegen keeps two of the sixteen xmm registers for scratch, every vector a loop holds at once needs one of the rest
+#define VECTORIZE_MAX_VECTORS 14
+
+typedef enum {
+    VEC_ROLE_NONE,
+    // the counter, its increment and the header's test, which the vector loop replaces with its own
+    VEC_ROLE_IV,
+    // the index arithmetic of `p + i`, which becomes a pointer moving by a whole vector per iteration
+    VEC_ROLE_ADDR,
+    // computed once per lane
+    VEC_ROLE_LANE
+} VecRole;
+
+typedef enum {
+    VEC_RED_SUM,
+    VEC_RED_MINMAX
+} VecRedKind;
+
+// a header phi carried from one iteration to the next that the lanes can compute apart and combine at the end
+typedef struct VecReduction {
+    IrValue phi;
+    IrValue next;
+    VecRedKind kind;
+} VecReduction;
+
+// the accesses through one `p + i`: base is the invariant address of element 0 as an i64
+typedef struct VecStream {
+    IrValue base;
+    bool is_loaded;
+    bool is_stored;
+    // some access runs on every iteration, so a load in a branch may run on all of them too
+    bool is_unconditional;
+    IrValue start;
+    IrValue ptr;
+} VecStream;
+
+// a phi joining the arms of an if in the body, which becomes a select on the if's condition
+typedef struct VecSelect {
+    IrValue phi;
+    IrValue cond;
+    IrValue then_value;
+    IrValue else_value;
+} VecSelect;
+
+// vectorises innermost counting loops by one over i32 elements. the loop is left in place and entered after a
+// vector loop that runs as many whole vectors as fit, behind checks that the loop runs long enough and that
+// no store overlaps another access of a different pointer. the vector loop is made in 8 lanes for AVX2 and in
+// 4 for SSE2, and which one runs is decided by the CPU at run time
+typedef struct Vectorizer {
+    IrModule *m;
+    IrFunc *f;
+    LoopForest *forest;
+    uint32_t loop;
+
+    // per value, only ever grown
+    uint8_t *role;
+    uint32_t *stream;
+    uint32_t *uses;
+    int32_t *last_use;
+    IrValue *vmap;
+    IrValue *splat;
+    uint32_t cap_values;
+
+    Vec body;
+    Vec blocks;
+    Vec streams;
+    Vec reductions;
+    Vec selects;
+    Vec arm_loads;
+    const char *reason;
+
+    int64_t num_loops;
+    int64_t num_vectorised;
+} Vectorizer;
+
+Vectorizer vectorize_create(IrModule *m);
+void vectorize_free(Vectorizer *vz);
+
+// tries every innermost loop of f and returns whether any was vectorised
+bool vectorize_func(Vectorizer *vz, LoopForest *lf, IrFunc *f);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SYNTHIUMC_VM_H
+#define SYNTHIUMC_VM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "jit.h"
+#include "bytecode.h"
+
+#define VM_NUM_REGS (1 << 20)
+#define VM_STACK_SIZE (8 << 20)
+#define VM_MAX_FRAMES (1 << 18)
+
+// compiled code and the calls between it run on the c stack, past this many nested entries calls stay in the
+// interpreter, whose frames are on the heap
+#define VM_MAX_NATIVE_DEPTH (1 << 13)
+
+// calls fn with the first n words of args, one per number of arguments for plain and variadic functions.
+// every synthium value is passed in an integer register, so these cover all signatures up to BC_MAX_EXTERN_ARGS
+typedef int64_t (*VmTrampoline)(void *fn, const int64_t *args);
+
+typedef struct VmFrame {
+    BcFunc *f;
+    const BcInst *ret;
+    int64_t *regs;
+    uint8_t *mem;
+} VmFrame;
+
+// registers and alloca memory are two stacks that every call pushes a window onto, the frames remember
+// where the caller continues. depth is the number of frames in use when the interpreter is entered again
+// from compiled code. error is set when a call stops with a runtime error, func is where it happened
+typedef struct Vm {
+    BcModule *m;
+    Jit *jit;
+    int64_t *regs;
+    int64_t *regs_end;
+    uint8_t *stack;
+    uint8_t *stack_end;
+    VmFrame *frames;
+    uint32_t max_frames;
+    uint32_t depth;
+    uint32_t native_depth;
+    const char *error_func;
+    char error[128];
+} Vm;
+
+// with jit set, functions that get hot are compiled to machine code
+Vm vm_create(BcModule *m, bool jit);
+void vm_free(Vm *vm);
+void vm_thread(BcModule *m);
+VmTrampoline vm_trampoline(uint32_t num_args, bool is_varargs);
+bool vm_call_extern(BcExtern *e, const int64_t *args, uint32_t num_args, int64_t *result);
+
+// runs f to completion, returns false when it stopped with a runtime error
+bool vm_call(Vm *vm, BcFunc *f, const int64_t *args, uint32_t num_args, int64_t *result);
+
+// called from compiled code, caller is the index of the calling function and ip the call instruction
+bool vm_jit_call(Vm *vm, uint32_t caller, const BcInst *ip, int64_t *regs, uint8_t *mem);
+bool vm_jit_call_extern(Vm *vm, uint32_t caller, const BcInst *ip, int64_t *regs);
+void vm_jit_fail(Vm *vm, uint32_t caller, const char *error);
+
+#endif
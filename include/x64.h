@@ -0,0 +1,144 @@
+#ifndef SYNTHIUMC_X64_H
+#define SYNTHIUMC_X64_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buf.h"
+
+#define X64_MAX_INST_LEN 16
+
+// register numbers are the hardware encodings, bit 3 goes into the REX prefix
+typedef enum {
+    X64_RAX,
+    X64_RCX,
+    X64_RDX,
+    X64_RBX,
+    X64_RSP,
+    X64_RBP,
+    X64_RSI,
+    X64_RDI,
+    X64_R8,
+    X64_R9,
+    X64_R10,
+    X64_R11,
+    X64_R12,
+    X64_R13,
+    X64_R14,
+    X64_R15,
+    X64_NUM_REGS
+} X64Reg;
+
+// condition codes as encoded in jcc, setcc and cmovcc
+typedef enum {
+    X64_CC_O,
+    X64_CC_NO,
+    X64_CC_B,
+    X64_CC_AE,
+    X64_CC_E,
+    X64_CC_NE,
+    X64_CC_BE,
+    X64_CC_A,
+    X64_CC_S,
+    X64_CC_NS,
+    X64_CC_P,
+    X64_CC_NP,
+    X64_CC_L,
+    X64_CC_GE,
+    X64_CC_LE,
+    X64_CC_G
+} X64Cond;
+
+// the /digit of the 0x81 group, the register forms are op * 8 + 1 and op * 8 + 3
+typedef enum {
+    X64_ADD,
+    X64_OR,
+    X64_ADC,
+    X64_SBB,
+    X64_AND,
+    X64_SUB,
+    X64_XOR,
+    X64_CMP
+} X64AluOp;
+
+// the /digit of the 0xf7 and 0xd3 groups
+#define X64_EXT_NOT 2
+#define X64_EXT_NEG 3
+#define X64_EXT_IDIV 7
+#define X64_EXT_SHL 4
+#define X64_EXT_SHR 5
+#define X64_EXT_SAR 7
+
+// the packed integer instructions, 66 0f xx with the map in the high byte, 0f38 ones have 0x200 set. xmm and
+// ymm registers are numbered like the general purpose ones and take the X64Reg of the same number
+typedef enum {
+    X64_PUNPCKLDQ = 0x62,
+    X64_PCMPGTD = 0x66,
+    X64_PCMPEQD = 0x76,
+    X64_PAND = 0xdb,
+    X64_PANDN = 0xdf,
+    X64_POR = 0xeb,
+    X64_PXOR = 0xef,
+    X64_PMULUDQ = 0xf4,
+    X64_PSUBD = 0xfa,
+    X64_PADDD = 0xfe,
+    X64_PMULLD = 0x240
+} X64VecOp;
+
+X64Cond x64_cond_negate(X64Cond cc);
+const char *x64_reg2str(X64Reg reg);
+
+// operand sizes are in bytes, 1, 2, 4 or 8, 32 bit writes clear the upper half of the register
+void x64_mov_rr(Buf *b, int32_t size, X64Reg dst, X64Reg src);
+void x64_mov_ri(Buf *b, int32_t size, X64Reg dst, int64_t imm);
+void x64_load(Buf *b, int32_t size, X64Reg dst, X64Reg base, int32_t disp);
+void x64_store(Buf *b, int32_t size, X64Reg base, int32_t disp, X64Reg src);
+void x64_store_imm(Buf *b, int32_t size, X64Reg base, int32_t disp, int32_t imm);
+void x64_lea(Buf *b, X64Reg dst, X64Reg base, int32_t disp);
+uint32_t x64_lea_rip(Buf *b, X64Reg dst);
+uint32_t x64_load_rip(Buf *b, X64Reg dst);
+void x64_alu_rr(Buf *b, X64AluOp op, int32_t size, X64Reg dst, X64Reg src);
+void x64_alu_ri(Buf *b, X64AluOp op, int32_t size, X64Reg dst, int32_t imm);
+void x64_alu_rm(Buf *b, X64AluOp op, int32_t size, X64Reg dst, X64Reg base, int32_t disp);
+void x64_imul_rr(Buf *b, int32_t size, X64Reg dst, X64Reg src);
+void x64_imul_rri(Buf *b, int32_t size, X64Reg dst, X64Reg src, int32_t imm);
+void x64_sign_extend_ax(Buf *b, int32_t size);
+void x64_unary(Buf *b, int32_t ext, int32_t size, X64Reg reg);
+void x64_shift_cl(Buf *b, int32_t ext, int32_t size, X64Reg reg);
+void x64_shift_ri(Buf *b, int32_t ext, int32_t size, X64Reg reg, uint8_t imm);
+void x64_setcc(Buf *b, X64Cond cc, X64Reg reg);
+void x64_movzx8(Buf *b, X64Reg dst, X64Reg src);
+void x64_movsxd(Buf *b, X64Reg dst, X64Reg src);
+void x64_cmov(Buf *b, X64Cond cc, int32_t size, X64Reg dst, X64Reg src);
+void x64_test_rr(Buf *b, int32_t size, X64Reg a, X64Reg c);
+void x64_push(Buf *b, X64Reg reg);
+void x64_pop(Buf *b, X64Reg reg);
+void x64_push_imm(Buf *b, int32_t imm);
+void x64_push_mem(Buf *b, X64Reg base, int32_t disp);
+uint32_t x64_jmp(Buf *b);
+uint32_t x64_jcc(Buf *b, X64Cond cc);
+uint32_t x64_call(Buf *b);
+void x64_call_r(Buf *b, X64Reg reg);
+void x64_jmp_r(Buf *b, X64Reg reg);
+void x64_ret(Buf *b);
+void x64_ud2(Buf *b);
+void x64_patch_rel32(Buf *b, uint32_t at, uint32_t target);
+
+// vector operations are 16 bytes wide in SSE2 form, where dst has to be a, or 32 bytes wide in AVX2 form
+void x64_vec_rr(Buf *b, X64VecOp op, int32_t width, X64Reg dst, X64Reg a, X64Reg c);
+void x64_vec_mov(Buf *b, int32_t width, X64Reg dst, X64Reg src);
+void x64_vec_load(Buf *b, int32_t width, X64Reg dst, X64Reg base, int32_t disp);
+void x64_vec_store(Buf *b, int32_t width, X64Reg base, int32_t disp, X64Reg src);
+// the lane moves work on the low 16 bytes, VEX encoded when the code around them uses 32 byte vectors
+void x64_pshufd(Buf *b, bool vex, X64Reg dst, X64Reg src, uint8_t order);
+void x64_movd_to_vec(Buf *b, bool vex, X64Reg dst, X64Reg src);
+void x64_movd_from_vec(Buf *b, bool vex, X64Reg dst, X64Reg src);
+void x64_vpbroadcastd(Buf *b, X64Reg dst, X64Reg src);
+void x64_vextracti128(Buf *b, X64Reg dst, X64Reg src, uint8_t half);
+void x64_vzeroupper(Buf *b);
+void x64_cpuid(Buf *b);
+void x64_xgetbv(Buf *b);
+
+#endif
@@ -0,0 +1,125 @@
+#include "../include/abi.h"
+
+const X64Reg abi_arg_regs[ABI_NUM_ARG_REGS] = { X64_RDI, X64_RSI, X64_RDX, X64_RCX, X64_R8, X64_R9 };
+const X64Reg abi_callee_saved[ABI_NUM_CALLEE_SAVED] = { X64_RBX, X64_R12, X64_R13, X64_R14, X64_R15 };
+
+bool abi_is_callee_saved(X64Reg reg) {
+    return reg == X64_RBX || reg >= X64_R12;
+}
+
+// rbp relative address of a parameter passed on the stack, above the return address and the saved rbp
+int32_t abi_param_offset(uint32_t idx) {
+    return 16 + 8 * (int32_t) (idx - ABI_NUM_ARG_REGS);
+}
+
+AbiFrame abi_frame_create(uint32_t saved_mask) {
+    AbiFrame fr = {
+        .saved_mask = saved_mask,
+        .saved_bytes = 0,
+        .used = 0,
+        .size = 0
+    };
+
+    int32_t i = 0;
+    while (i < ABI_NUM_CALLEE_SAVED) {
+        if (saved_mask & (1u << abi_callee_saved[i])) {
+            fr.saved_bytes += 8;
+        }
+
+        i++;
+    }
+
+    fr.used = fr.saved_bytes;
+
+    return fr;
+}
+
+// rbp is 16 byte aligned after the prologue, so an offset that is a multiple of align gives an aligned slot
+int32_t abi_frame_alloc(AbiFrame *fr, uint32_t size, uint32_t align) {
+    align = align == 0 ? 1 : align;
+    fr->used = (fr->used + size + align - 1) / align * align;
+
+    return -fr->used;
+}
+
+void abi_frame_finish(AbiFrame *fr) {
+    int32_t total = (fr->used + ABI_STACK_ALIGN - 1) / ABI_STACK_ALIGN * ABI_STACK_ALIGN;
+    fr->size = total - fr->saved_bytes;
+}
+
+void abi_emit_prologue(Buf *b, AbiFrame *fr) {
+    x64_push(b, X64_RBP);
+    x64_mov_rr(b, 8, X64_RBP, X64_RSP);
+
+    int32_t i = 0;
+    while (i < ABI_NUM_CALLEE_SAVED) {
+        if (fr->saved_mask & (1u << abi_callee_saved[i])) {
+            x64_push(b, abi_callee_saved[i]);
+        }
+
+        i++;
+    }
+
+    if (fr->size > 0) {
+        x64_alu_ri(b, X64_SUB, 8, X64_RSP, fr->size);
+    }
+}
+
+// rsp points at the return address again afterwards, as it did on entry
+void abi_emit_leave(Buf *b, AbiFrame *fr) {
+    if (fr->saved_bytes > 0) {
+        x64_lea(b, X64_RSP, X64_RBP, -fr->saved_bytes);
+
+        int32_t i = ABI_NUM_CALLEE_SAVED - 1;
+        while (i >= 0) {
+            if (fr->saved_mask & (1u << abi_callee_saved[i])) {
+                x64_pop(b, abi_callee_saved[i]);
+            }
+
+            i--;
+        }
+    } else {
+        x64_mov_rr(b, 8, X64_RSP, X64_RBP);
+    }
+
+    x64_pop(b, X64_RBP);
+}
+
+void abi_emit_epilogue(Buf *b, AbiFrame *fr) {
+    abi_emit_leave(b, fr);
+    x64_ret(b);
+}
+
+// stack arguments are pushed last to first, an odd count gets one slot of padding first
+int32_t abi_stack_args_size(uint32_t num_args) {
+    if (num_args <= ABI_NUM_ARG_REGS) {
+        return 0;
+    }
+
+    uint32_t n = num_args - ABI_NUM_ARG_REGS;
+    return (int32_t) ((n + (n & 1)) * 8);
+}
+
+// al holds the number of vector registers used by a variadic call, which is always zero here
+void abi_emit_call(Buf *b, ElfWriter *elf, ElfSectionId sec, uint32_t sym, bool varargs) {
+    if (varargs) {
+        x64_mov_ri(b, 4, X64_RAX, 0);
+    }
+
+    uint32_t at = x64_call(b);
+    elf_add_reloc(elf, sec, at, ELF_R_X86_64_PLT32, sym, -4);
+}
+
+// the arguments are in their registers before the frame goes, the callee returns to the caller's caller
+void abi_emit_tail_call(Buf *b, ElfWriter *elf, ElfSectionId sec, AbiFrame *fr, uint32_t sym) {
+    abi_emit_leave(b, fr);
+
+    uint32_t at = x64_jmp(b);
+    elf_add_reloc(elf, sec, at, ELF_R_X86_64_PLT32, sym, -4);
+}
+
+void abi_emit_call_cleanup(Buf *b, int32_t stack_bytes) {
+    if (stack_bytes > 0) {
+        x64_alu_ri(b, X64_ADD, 8, X64_RSP, stack_bytes);
+    }
+}
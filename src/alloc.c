@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <stdatomic.h>
+
+#include "../include/alloc.h"
+
+static atomic_bool alloc_counting = false;
+static atomic_uint_fast64_t alloc_count = 0;
+static atomic_uint_fast64_t alloc_bytes = 0;
+
+bool alloc_hooks_available() {
+    return ALLOC_HOOKS_AVAILABLE;
+}
+
+void alloc_set_counting(bool enabled) {
+    atomic_store_explicit(&alloc_counting, enabled, memory_order_relaxed);
+}
+
+bool alloc_is_counting() {
+    return atomic_load_explicit(&alloc_counting, memory_order_relaxed);
+}
+
+AllocStats alloc_stats() {
+    AllocStats stats = {
+        .count = atomic_load_explicit(&alloc_count, memory_order_relaxed),
+        .bytes = atomic_load_explicit(&alloc_bytes, memory_order_relaxed)
+    };
+
+    return stats;
+}
+
+AllocStats alloc_stats_diff(AllocStats end, AllocStats start) {
+    AllocStats stats = {
+        .count = end.count - start.count,
+        .bytes = end.bytes - start.bytes
+    };
+
+    return stats;
+}
+
+static inline void alloc_record(size_t size) {
+    if (__builtin_expect(atomic_load_explicit(&alloc_counting, memory_order_relaxed), 0)) {
+        atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+    }
+}
+
+#if ALLOC_HOOKS_AVAILABLE
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+// these replace every libc entry point that allocates for the whole process, including allocations made inside
+// libc. all of them hand back glibc's own blocks unchanged, without a header, so any of them can be freed by free
+// and libc's malloc_usable_size stays right for them
+void *malloc(size_t size) {
+    alloc_record(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+    alloc_record(num * size);
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_record(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+void *reallocarray(void *ptr, size_t num, size_t size) {
+    if (size != 0 && num > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return realloc(ptr, num * size);
+}
+
+void *memalign(size_t align, size_t size) {
+    alloc_record(size);
+    return __libc_memalign(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+    alloc_record(size);
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void **out, size_t align, size_t size) {
+    if (align < sizeof(void *) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+
+    alloc_record(size);
+
+    void *ptr = __libc_memalign(align, size);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+
+    *out = ptr;
+
+    return 0;
+}
+
+void *valloc(size_t size) {
+    alloc_record(size);
+    return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size) {
+    alloc_record(size);
+    return __libc_pvalloc(size);
+}
+
+#endif
@@ -56,12 +56,20 @@ Stmt *ast_new_return_stmt(Expr *e) {
     ReturnStmt *return_stmt = (ReturnStmt *) malloc(sizeof(ReturnStmt));
     return_stmt->s = create_stmt_tag(STMT_RETURN);
     return_stmt->expr = e;
+    return_stmt->become = false;
 
     Stmt *stmt = (Stmt *) return_stmt;
 
     return stmt;
 }
 
+Stmt *ast_new_become_stmt(Expr *e) {
+    Stmt *stmt = ast_new_return_stmt(e);
+    ast_as_return_stmt(stmt)->become = true;
+
+    return stmt;
+}
+
 bool ast_is_return_stmt(Stmt *s) {
     return s->tag == STMT_RETURN;
 }
@@ -248,7 +256,7 @@ void ast_stmt_free(Stmt *s) {
         ast_expr_free(ast_as_let_stmt(s)->value);
     } else if (ast_is_delete_stmt(s)) {
         ast_expr_free(ast_as_delete_stmt(s)->expr);
-    } else if (ast_as_return_stmt(s)) {
+    } else if (ast_is_return_stmt(s)) {
         ast_expr_free(ast_as_return_stmt(s)->expr);
     } else if (ast_is_func_decl_stmt(s)) {
         FuncDeclStmt *func_decl_stmt = ast_as_func_decl_stmt(s);
@@ -453,10 +461,11 @@ IdentExpr *ast_as_ident_expr(Expr *e) {
 // Identifier Expression >
 
 // < Integer Expression
-Expr *ast_new_int_expr(Span span, const char *ptr) {
+Expr *ast_new_int_expr(Span span, const char *ptr, int64_t value) {
     IntExpr *int_expr = (IntExpr *) malloc(sizeof(IntExpr));
     int_expr->e = create_expr_tag(EXPR_INT, span);
     int_expr->ptr = ptr;
+    int_expr->value = value;
 
     Expr *expr = (Expr *) int_expr;
 
@@ -572,7 +581,7 @@ void ast_expr_free(Expr *e) {
         AccessExpr *access_expr = ast_as_access_expr(e);
         ast_expr_free(access_expr->left);
         ast_expr_free(access_expr->right);
-    } else if (ast_is_access_expr(e)) {
+    } else if (ast_is_call_expr(e)) {
         CallExpr *call_expr = ast_as_call_expr(e);
         ast_expr_free((Expr *) call_expr->ident);
         ast_free_al(&call_expr->args);
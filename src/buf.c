@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "../include/buf.h"
+
+Buf buf_create() {
+    Buf b = {
+        .data = NULL,
+        .len = 0,
+        .cap = 0
+    };
+
+    return b;
+}
+
+void buf_free(Buf *b) {
+    free((void *) b->data);
+
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+void buf_reserve(Buf *b, uint32_t extra) {
+    if (b->len + extra <= b->cap) {
+        return;
+    }
+
+    uint32_t cap = b->cap == 0 ? 256 : b->cap;
+    while (b->len + extra > cap) {
+        cap *= 2;
+    }
+
+    b->data = (uint8_t *) realloc((void *) b->data, cap);
+    b->cap = cap;
+}
+
+void buf_push(Buf *b, const void *data, uint32_t len) {
+    // an empty buffer has no storage to copy into, and the data of an empty push may be null
+    if (len == 0) {
+        return;
+    }
+
+    buf_reserve(b, len);
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+void buf_push_u8(Buf *b, uint8_t v) {
+    buf_reserve(b, 1);
+    b->data[b->len++] = v;
+}
+
+void buf_push_u16(Buf *b, uint16_t v) {
+    buf_reserve(b, 2);
+    b->data[b->len++] = v & 0xff;
+    b->data[b->len++] = v >> 8;
+}
+
+void buf_push_u32(Buf *b, uint32_t v) {
+    buf_reserve(b, 4);
+    buf_write_u32(b, b->len, v);
+    b->len += 4;
+}
+
+void buf_push_u64(Buf *b, uint64_t v) {
+    buf_push_u32(b, (uint32_t) v);
+    buf_push_u32(b, (uint32_t) (v >> 32));
+}
+
+void buf_push_str(Buf *b, const char *s) {
+    buf_push(b, s, strlen(s));
+}
+
+// decimal text, written back to front into a small scratch array
+void buf_push_int(Buf *b, int64_t v) {
+    char digits[24];
+    int32_t i = sizeof(digits);
+    uint64_t u = v < 0 ? -(uint64_t) v : (uint64_t) v;
+
+    do {
+        digits[--i] = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+
+    if (v < 0) {
+        digits[--i] = '-';
+    }
+
+    buf_push(b, digits + i, sizeof(digits) - i);
+}
+
+void buf_push_zeros(Buf *b, uint32_t len) {
+    buf_reserve(b, len);
+    memset(b->data + b->len, 0, len);
+    b->len += len;
+}
+
+void buf_align(Buf *b, uint32_t align) {
+    if (align > 1 && b->len % align != 0) {
+        buf_push_zeros(b, align - b->len % align);
+    }
+}
+
+void buf_write_u32(Buf *b, uint32_t offset, uint32_t v) {
+    b->data[offset] = v & 0xff;
+    b->data[offset + 1] = (v >> 8) & 0xff;
+    b->data[offset + 2] = (v >> 16) & 0xff;
+    b->data[offset + 3] = v >> 24;
+}
+
+uint32_t buf_read_u32(Buf *b, uint32_t offset) {
+    return (uint32_t) b->data[offset] | (uint32_t) b->data[offset + 1] << 8 | (uint32_t) b->data[offset + 2] << 16 | (uint32_t) b->data[offset + 3] << 24;
+}
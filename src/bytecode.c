@@ -0,0 +1,1059 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dlfcn.h>
+#include <string.h>
+
+#include "../include/bytecode.h"
+
+#define BC_NAME(name) #name,
+
+static char const *const bc_op_names[] = {
+    BC_OPS(BC_NAME)
+};
+
+#undef BC_NAME
+
+const char *bc_op2str(BcOp op) {
+    if (op >= BC_NUM_OPS) {
+        return "unknown";
+    }
+
+    return bc_op_names[op];
+}
+
+bool bc_is_wide(IrTypeId ty) {
+    return ty == IR_TYPE_I64 || ty == IR_TYPE_PTR;
+}
+
+bool bc_is_leaf(IrOp op) {
+    return op == IR_CONST || op == IR_STR || op == IR_GLOBAL || op == IR_FUNC_ADDR;
+}
+
+// narrow constants are sign extended from 32 bits like every other narrow value
+int64_t bc_leaf_value(BcModule *m, IrInst *inst) {
+    switch (inst->op) {
+        case IR_CONST:
+            return bc_is_wide(inst->ty) ? inst->imm : (int64_t) (int32_t) inst->imm;
+        case IR_STR:
+            return (int64_t) (intptr_t) ir_module_string(m->ir, (uint32_t) inst->imm)->data;
+        case IR_GLOBAL:
+            return (int64_t) (intptr_t) m->globals[inst->imm];
+        default:
+            if (m->externs[inst->imm].name != NULL) {
+                return (int64_t) (intptr_t) m->externs[inst->imm].fn;
+            }
+
+            return (int64_t) (intptr_t) &m->funcs[inst->imm];
+    }
+}
+
+// whether operand idx of user can be encoded as an immediate, division has no immediate form and pointers
+// are only compared for equality with one
+bool bc_takes_imm(IrFunc *f, IrInst *user, uint32_t idx) {
+    IrOp op = (IrOp) user->op;
+
+    if (op == IR_PHI) {
+        return true;
+    }
+
+    if (idx != 1) {
+        return false;
+    }
+
+    if (ir_op_is_binary(op)) {
+        return op != IR_DIV && op != IR_MOD;
+    }
+
+    if (ir_op_is_compare(op)) {
+        return op == IR_EQ || op == IR_NE || f->insts[user->u.ops[0]].ty != IR_TYPE_PTR;
+    }
+
+    return op == IR_STORE;
+}
+
+bool bc_is_imm(BcCompiler *c, IrInst *user, uint32_t idx) {
+    IrValue v = ir_inst_ops(c->f, user)[idx];
+    return bc_is_leaf((IrOp) c->f->insts[v].op) && bc_takes_imm(c->f, user, idx);
+}
+
+bool bc_is_dead(BcCompiler *c, IrValue v) {
+    return c->uses[v] == 0 && !ir_op_has_side_effects((IrOp) c->f->insts[v].op);
+}
+
+BcOp bc_binary_op(IrOp op, bool wide, bool imm) {
+    int32_t k = op - IR_ADD;
+
+    if (!imm) {
+        return (BcOp) ((wide ? BC_ADD_64 : BC_ADD_32) + k);
+    }
+
+    // there are no immediate forms of div and mod
+    k = k > 4 ? k - 2 : k;
+
+    return (BcOp) ((wide ? BC_ADD_64_I : BC_ADD_32_I) + k);
+}
+
+// the plain compares and the fused branches are laid out alike: six signed, four unsigned, six immediate
+BcOp bc_compare_op(IrOp op, bool is_unsigned, bool imm, bool branch) {
+    int32_t k = op - IR_EQ;
+    int32_t base = branch ? BC_BR_EQ : BC_EQ;
+
+    if (imm) {
+        return (BcOp) (base + 10 + k);
+    }
+
+    if (is_unsigned && k >= 2) {
+        return (BcOp) (base + 4 + k);
+    }
+
+    return (BcOp) (base + k);
+}
+
+BcOp bc_load_op(IrTypeId ty) {
+    switch (ty) {
+        case IR_TYPE_I1:
+        case IR_TYPE_I8:
+            return BC_LOAD_8;
+        case IR_TYPE_I32:
+            return BC_LOAD_32;
+        default:
+            return BC_LOAD_64;
+    }
+}
+
+BcCompiler bc_compiler_create(BcModule *m) {
+    BcCompiler c;
+    memset((void *) &c, 0, sizeof(BcCompiler));
+
+    c.m = m;
+    c.code = vec_create(sizeof(BcInst));
+    c.args = vec_create(sizeof(uint32_t));
+    c.consts = vec_create(sizeof(int64_t));
+    c.fixups = vec_create(sizeof(BcFixup));
+    c.copies = vec_create(sizeof(BcCopy));
+
+    return c;
+}
+
+void bc_compiler_free(BcCompiler *c) {
+    vec_free(&c->code);
+    vec_free(&c->args);
+    vec_free(&c->consts);
+    vec_free(&c->fixups);
+    vec_free(&c->copies);
+    free((void *) c->kinds);
+    free((void *) c->regs);
+    free((void *) c->uses);
+    free((void *) c->block_starts);
+}
+
+void bc_reserve(BcCompiler *c, IrFunc *f) {
+    if (f->num_insts > c->cap_insts) {
+        c->cap_insts = f->num_insts * 2;
+        c->kinds = (uint8_t *) realloc((void *) c->kinds, c->cap_insts * sizeof(uint8_t));
+        c->regs = (uint32_t *) realloc((void *) c->regs, c->cap_insts * sizeof(uint32_t));
+        c->uses = (uint32_t *) realloc((void *) c->uses, c->cap_insts * sizeof(uint32_t));
+    }
+
+    if (f->num_blocks > c->cap_blocks) {
+        c->cap_blocks = f->num_blocks * 2;
+        c->block_starts = (uint32_t *) realloc((void *) c->block_starts, c->cap_blocks * sizeof(uint32_t));
+    }
+
+    memset((void *) c->kinds, 0, f->num_insts * sizeof(uint8_t));
+    memset((void *) c->uses, 0, f->num_insts * sizeof(uint32_t));
+}
+
+uint32_t bc_emit(BcCompiler *c, BcOp op, uint32_t a, uint32_t b, uint32_t c_, int64_t imm) {
+    BcInst inst = {
+        .handler = NULL,
+        .op = (uint16_t) op,
+        .pad = 0,
+        .a = a,
+        .b = b,
+        .c = c_,
+        .imm = imm
+    };
+
+    vec_push(&c->code, (void *) &inst);
+
+    return (uint32_t) c->code.len - 1;
+}
+
+BcInst *bc_inst_at(BcCompiler *c, uint32_t at) {
+    return (BcInst *) vec_get_ptr(&c->code, at);
+}
+
+void bc_fixup(BcCompiler *c, uint32_t at, bool is_else, IrBlockId target) {
+    BcFixup fixup = {
+        .at = at,
+        .is_else = is_else,
+        .target = target
+    };
+
+    vec_push(&c->fixups, (void *) &fixup);
+}
+
+// counts uses and decides which values get a register, which are encoded as immediates and which are
+// folded into their only kind of user
+void bc_classify(BcCompiler *c) {
+    IrFunc *f = c->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                IrInst *op = &f->insts[ops[j]];
+                c->uses[ops[j]]++;
+
+                if (bc_is_leaf((IrOp) op->op) && !bc_takes_imm(f, inst, j)) {
+                    c->kinds[ops[j]] = BC_VALUE_CONST;
+                } else if (op->op == IR_OFFSET) {
+                    bool folds = j == 0 && (inst->op == IR_LOAD || inst->op == IR_STORE || inst->op == IR_OFFSET);
+                    c->kinds[ops[j]] = folds && c->kinds[ops[j]] != BC_VALUE_REG ? BC_VALUE_FOLDED : BC_VALUE_REG;
+                }
+
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+
+            if (bc_is_leaf((IrOp) inst->op)) {
+                c->kinds[v] = c->kinds[v] == BC_VALUE_CONST ? BC_VALUE_CONST : BC_VALUE_IMM;
+            } else if (inst->op == IR_OFFSET && c->kinds[v] == BC_VALUE_FOLDED) {
+                // offsets are encoded in 32 bits
+                int64_t offset = inst->imm;
+                IrValue base = inst->u.ops[0];
+
+                while (f->insts[base].op == IR_OFFSET && offset >= INT32_MIN && offset <= INT32_MAX) {
+                    offset += f->insts[base].imm;
+                    base = f->insts[base].u.ops[0];
+                }
+
+                c->kinds[v] = offset >= INT32_MIN && offset <= INT32_MAX ? BC_VALUE_FOLDED : BC_VALUE_REG;
+            } else if (inst->op == IR_CBR) {
+                // a compare that only decides this branch becomes part of it
+                IrValue cond = inst->u.ops[0];
+                IrInst *cmp = &f->insts[cond];
+
+                if (ir_op_is_compare((IrOp) cmp->op) && cmp->block == b && c->uses[cond] == 1) {
+                    c->kinds[cond] = BC_VALUE_FOLDED;
+                }
+            } else if (c->kinds[v] == BC_VALUE_NONE && inst->ty != IR_TYPE_VOID) {
+                c->kinds[v] = BC_VALUE_REG;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+}
+
+// a value whose only use is a phi in the block its own block jumps to can be computed straight into the
+// phi's register, as long as nothing later in the block still reads the phi's old value. returns the phi
+IrValue bc_phi_target(BcCompiler *c, IrValue v) {
+    IrFunc *f = c->f;
+    IrInst *inst = &f->insts[v];
+
+    if (c->uses[v] != 1 || inst->op == IR_PHI || inst->op == IR_ALLOCA || inst->op == IR_PARAM) {
+        return IR_NO_VALUE;
+    }
+
+    IrBlock *block = &f->blocks[inst->block];
+    IrInst *term = &f->insts[ir_block_terminator(f, inst->block)];
+
+    if (term->op != IR_BR) {
+        return IR_NO_VALUE;
+    }
+
+    IrBlockId succ = term->u.ops[0];
+    IrBlock *target = &f->blocks[succ];
+    int32_t k = ir_pred_index(f, succ, inst->block);
+    IrValue phi = IR_NO_VALUE;
+    uint32_t i = 0;
+
+    while (i < target->num_insts && f->insts[target->insts[i]].op == IR_PHI) {
+        if (ir_inst_ops(f, &f->insts[target->insts[i]])[k] == v) {
+            phi = target->insts[i];
+        }
+
+        i++;
+    }
+
+    if (phi == IR_NO_VALUE || bc_is_dead(c, phi)) {
+        return IR_NO_VALUE;
+    }
+
+    // the other copies of the edge read the phi's old value too
+    i = 0;
+    while (i < target->num_insts && f->insts[target->insts[i]].op == IR_PHI) {
+        if (ir_inst_ops(f, &f->insts[target->insts[i]])[k] == phi) {
+            return IR_NO_VALUE;
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < block->num_insts && block->insts[i] != v) {
+        i++;
+    }
+
+    i++;
+    while (i < block->num_insts) {
+        IrInst *later = &f->insts[block->insts[i]];
+        IrValue *ops = ir_inst_ops(f, later);
+        uint32_t n = ir_inst_num_values(later);
+        uint32_t j = 0;
+
+        while (j < n) {
+            if (ops[j] == phi) {
+                return IR_NO_VALUE;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    return phi;
+}
+
+// parameters take the first registers, the constant pool the ones after them, one scratch register at
+// the end breaks cycles in phi copies
+void bc_assign_regs(BcCompiler *c) {
+    IrFunc *f = c->f;
+    IrBlockId b = 0;
+
+    c->num_regs = f->num_params;
+    c->consts.len = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+
+            if (c->kinds[v] == BC_VALUE_CONST) {
+                int64_t value = bc_leaf_value(c->m, &f->insts[v]);
+
+                c->regs[v] = c->num_regs++;
+                vec_push(&c->consts, (void *) &value);
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+
+            if (inst->op == IR_PARAM) {
+                c->regs[v] = (uint32_t) inst->imm;
+            } else if (c->kinds[v] == BC_VALUE_REG && !bc_is_dead(c, v) && bc_phi_target(c, v) == IR_NO_VALUE) {
+                c->regs[v] = c->num_regs++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    // phis have their registers now, so the values that feed them can share them
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrValue phi = c->kinds[v] == BC_VALUE_REG ? bc_phi_target(c, v) : IR_NO_VALUE;
+
+            if (phi != IR_NO_VALUE) {
+                c->regs[v] = c->regs[phi];
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    c->tmp = c->num_regs++;
+}
+
+// allocas live at fixed offsets from the frame's memory, their addresses are set up on entry
+void bc_emit_allocas(BcCompiler *c) {
+    IrFunc *f = c->f;
+    IrBlockId b = 0;
+
+    c->frame_size = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+
+            if (inst->op == IR_ALLOCA && !bc_is_dead(c, v)) {
+                uint32_t size = (uint32_t) inst->imm;
+                uint32_t align = (uint32_t) (inst->imm >> 32);
+
+                align = align == 0 ? 1 : align;
+                c->frame_size = (c->frame_size + align - 1) / align * align;
+                bc_emit(c, BC_ALLOCA, c->regs[v], 0, 0, c->frame_size);
+                c->frame_size += size;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    c->frame_size = (c->frame_size + 15) / 16 * 16;
+}
+
+// walks through folded offsets to the register they are based on
+uint32_t bc_address(BcCompiler *c, IrValue ptr, int32_t *offset) {
+    IrFunc *f = c->f;
+    int64_t total = 0;
+
+    while (c->kinds[ptr] == BC_VALUE_FOLDED) {
+        total += f->insts[ptr].imm;
+        ptr = f->insts[ptr].u.ops[0];
+    }
+
+    *offset = (int32_t) total;
+
+    return c->regs[ptr];
+}
+
+void bc_add_copy(BcCompiler *c, uint32_t dst, IrValue src) {
+    IrInst *inst = &c->f->insts[src];
+    BcCopy copy = {
+        .dst = dst,
+        .src = 0,
+        .is_imm = bc_is_leaf((IrOp) inst->op),
+        .imm = 0
+    };
+
+    if (copy.is_imm) {
+        copy.imm = bc_leaf_value(c->m, inst);
+    } else if (c->regs[src] == dst) {
+        return;
+    } else {
+        copy.src = c->regs[src];
+    }
+
+    vec_push(&c->copies, (void *) &copy);
+}
+
+// collects the copies into the phis of to along the edge from from, returns whether there are any
+bool bc_edge_copies(BcCompiler *c, IrBlockId from, IrBlockId to) {
+    IrFunc *f = c->f;
+    IrBlock *block = &f->blocks[to];
+    int32_t k = -1;
+    uint32_t i = 0;
+
+    c->copies.len = 0;
+
+    while (i < block->num_insts && f->insts[block->insts[i]].op == IR_PHI) {
+        IrValue phi = block->insts[i];
+
+        if (!bc_is_dead(c, phi)) {
+            k = k < 0 ? ir_pred_index(f, to, from) : k;
+            bc_add_copy(c, c->regs[phi], ir_inst_ops(f, &f->insts[phi])[k]);
+        }
+
+        i++;
+    }
+
+    return c->copies.len > 0;
+}
+
+bool bc_copy_is_read(BcCompiler *c, uint32_t reg) {
+    int64_t i = 0;
+
+    while (i < c->copies.len) {
+        BcCopy *copy = (BcCopy *) vec_get_ptr(&c->copies, i);
+
+        if (!copy->is_imm && copy->src == reg) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// the phi copies of an edge happen at once, so a copy is only emitted when no other copy still reads its
+// destination. when every copy left is part of a cycle, one destination is moved to the scratch register
+void bc_emit_copies(BcCompiler *c) {
+    while (c->copies.len > 0) {
+        bool progress = false;
+        int64_t i = 0;
+
+        while (i < c->copies.len) {
+            BcCopy *copy = (BcCopy *) vec_get_ptr(&c->copies, i);
+            BcCopy done = *copy;
+
+            if (bc_copy_is_read(c, done.dst)) {
+                i++;
+                continue;
+            }
+
+            if (done.is_imm) {
+                bc_emit(c, BC_CONST, done.dst, 0, 0, done.imm);
+            } else {
+                bc_emit(c, BC_MOV, done.dst, done.src, 0, 0);
+            }
+
+            *copy = *(BcCopy *) vec_get_ptr(&c->copies, c->copies.len - 1);
+            c->copies.len--;
+            progress = true;
+        }
+
+        if (!progress) {
+            uint32_t parked = ((BcCopy *) vec_get_ptr(&c->copies, 0))->dst;
+            int64_t j = 0;
+
+            bc_emit(c, BC_MOV, c->tmp, parked, 0, 0);
+
+            while (j < c->copies.len) {
+                BcCopy *copy = (BcCopy *) vec_get_ptr(&c->copies, j);
+
+                if (!copy->is_imm && copy->src == parked) {
+                    copy->src = c->tmp;
+                }
+
+                j++;
+            }
+        }
+    }
+}
+
+// points the then or else side of a branch at its block, or at a stub that does the edge's phi copies
+// first. the stubs are emitted right after the branch
+void bc_branch_target(BcCompiler *c, uint32_t at, bool is_else, IrBlockId from, IrBlockId to) {
+    if (!bc_edge_copies(c, from, to)) {
+        bc_fixup(c, at, is_else, to);
+        return;
+    }
+
+    uint32_t stub = (uint32_t) c->code.len;
+
+    bc_emit_copies(c);
+    bc_fixup(c, bc_emit(c, BC_JMP, 0, 0, 0, 0), false, to);
+
+    if (is_else) {
+        bc_inst_at(c, at)->c = stub;
+    } else {
+        bc_inst_at(c, at)->b = stub;
+    }
+}
+
+void bc_emit_branch(BcCompiler *c, IrBlockId b, IrInst *inst) {
+    IrFunc *f = c->f;
+    IrValue cond = inst->u.ops[0];
+    IrBlockId then_block = inst->u.ops[1];
+    IrBlockId else_block = inst->u.ops[2];
+    uint32_t at;
+
+    if (c->kinds[cond] == BC_VALUE_FOLDED) {
+        IrInst *cmp = &f->insts[cond];
+        bool is_unsigned = f->insts[cmp->u.ops[0]].ty == IR_TYPE_PTR;
+        bool imm = bc_is_imm(c, cmp, 1);
+        int64_t rhs = imm ? bc_leaf_value(c->m, &f->insts[cmp->u.ops[1]]) : c->regs[cmp->u.ops[1]];
+
+        at = bc_emit(c, bc_compare_op((IrOp) cmp->op, is_unsigned, imm, true), c->regs[cmp->u.ops[0]], 0, 0, rhs);
+        c->m->num_fused++;
+    } else {
+        at = bc_emit(c, BC_BR, c->regs[cond], 0, 0, 0);
+    }
+
+    bc_branch_target(c, at, false, b, then_block);
+
+    if (else_block == then_block) {
+        BcInst *br = bc_inst_at(c, at);
+        br->c = br->b;
+
+        // the then side may still be waiting for its block's start
+        if (c->fixups.len > 0 && ((BcFixup *) vec_get_ptr(&c->fixups, c->fixups.len - 1))->at == at) {
+            bc_fixup(c, at, true, else_block);
+        }
+    } else {
+        bc_branch_target(c, at, true, b, else_block);
+    }
+}
+
+void bc_emit_call(BcCompiler *c, IrValue v, IrInst *inst) {
+    IrValue *ops = ir_inst_ops(c->f, inst);
+    uint32_t start = (uint32_t) c->args.len;
+    uint32_t i = 0;
+
+    while (i < inst->num_ops) {
+        vec_push(&c->args, (void *) &c->regs[ops[i]]);
+        i++;
+    }
+
+    bool is_extern = c->m->externs[inst->imm].name != NULL;
+    uint32_t dst = inst->ty != IR_TYPE_VOID ? c->regs[v] : 0;
+
+    BcOp op = is_extern ? BC_CALL_EXTERN : BC_CALL;
+
+    // the interpreter reuses the caller's frame for a tail call, the return after it is kept for compiled code
+    if (!is_extern && (inst->flags & IR_FLAG_TAIL) != 0 && inst->ty == c->f->ret) {
+        op = BC_TAIL_CALL;
+    }
+
+    bc_emit(c, op, dst, start, (uint32_t) inst->imm, inst->num_ops);
+}
+
+void bc_emit_convert(BcCompiler *c, IrValue v, IrInst *inst) {
+    IrTypeId from = c->f->insts[inst->u.ops[0]].ty;
+    uint32_t dst = c->regs[v];
+    uint32_t src = c->regs[inst->u.ops[0]];
+    BcOp op = BC_MOV;
+
+    switch (inst->op) {
+        case IR_ZEXT:
+            op = bc_is_wide(inst->ty) && !bc_is_wide(from) ? BC_ZEXT_32 : BC_MOV;
+            break;
+        case IR_TRUNC:
+            op = inst->ty == IR_TYPE_I1 ? BC_TRUNC_1 : (inst->ty == IR_TYPE_I8 ? BC_TRUNC_8 : BC_SEXT_32);
+            break;
+        case IR_PTR_TO_INT:
+            op = bc_is_wide(inst->ty) ? BC_MOV : BC_SEXT_32;
+            break;
+        default:
+            // narrow values are already sign extended, so widening them and turning them into pointers is a copy
+            break;
+    }
+
+    bc_emit(c, op, dst, src, 0, 0);
+}
+
+void bc_emit_inst(BcCompiler *c, IrBlockId b, IrValue v) {
+    IrFunc *f = c->f;
+    IrInst *inst = &f->insts[v];
+    IrOp op = (IrOp) inst->op;
+
+    if (bc_is_dead(c, v) || c->kinds[v] == BC_VALUE_FOLDED) {
+        return;
+    }
+
+    if (ir_op_is_binary(op)) {
+        bool imm = bc_is_imm(c, inst, 1);
+        BcOp bc_op = bc_binary_op(op, bc_is_wide(inst->ty), imm);
+
+        if (imm) {
+            bc_emit(c, bc_op, c->regs[v], c->regs[inst->u.ops[0]], 0, bc_leaf_value(c->m, &f->insts[inst->u.ops[1]]));
+            c->m->num_fused++;
+        } else {
+            bc_emit(c, bc_op, c->regs[v], c->regs[inst->u.ops[0]], c->regs[inst->u.ops[1]], 0);
+        }
+
+        return;
+    }
+
+    if (ir_op_is_compare(op)) {
+        bool imm = bc_is_imm(c, inst, 1);
+        BcOp bc_op = bc_compare_op(op, f->insts[inst->u.ops[0]].ty == IR_TYPE_PTR, imm, false);
+
+        if (imm) {
+            bc_emit(c, bc_op, c->regs[v], c->regs[inst->u.ops[0]], 0, bc_leaf_value(c->m, &f->insts[inst->u.ops[1]]));
+            c->m->num_fused++;
+        } else {
+            bc_emit(c, bc_op, c->regs[v], c->regs[inst->u.ops[0]], c->regs[inst->u.ops[1]], 0);
+        }
+
+        return;
+    }
+
+    switch (op) {
+        case IR_NEG:
+        case IR_NOT: {
+            bool wide = bc_is_wide(inst->ty);
+            BcOp bc_op = op == IR_NEG ? (wide ? BC_NEG_64 : BC_NEG_32) : (wide ? BC_NOT_64 : BC_NOT_32);
+
+            bc_emit(c, bc_op, c->regs[v], c->regs[inst->u.ops[0]], 0, 0);
+            break;
+        }
+        case IR_SEXT:
+        case IR_ZEXT:
+        case IR_TRUNC:
+        case IR_PTR_TO_INT:
+        case IR_INT_TO_PTR:
+            bc_emit_convert(c, v, inst);
+            break;
+        case IR_SELECT:
+            bc_emit(c, BC_SELECT, c->regs[v], c->regs[inst->u.ops[0]], c->regs[inst->u.ops[1]], c->regs[inst->u.ops[2]]);
+            break;
+        case IR_COPY:
+            bc_emit(c, BC_MOV, c->regs[v], c->regs[inst->u.ops[0]], 0, 0);
+            break;
+        case IR_LOAD: {
+            int32_t offset = 0;
+            uint32_t base = bc_address(c, inst->u.ops[0], &offset);
+
+            c->m->num_fused += c->kinds[inst->u.ops[0]] == BC_VALUE_FOLDED;
+            bc_emit(c, bc_load_op(inst->ty), c->regs[v], base, (uint32_t) offset, 0);
+            break;
+        }
+        case IR_STORE: {
+            int32_t offset = 0;
+            uint32_t base = bc_address(c, inst->u.ops[0], &offset);
+            IrValue value = inst->u.ops[1];
+            int32_t k = bc_load_op(f->insts[value].ty) - BC_LOAD_8;
+
+            c->m->num_fused += c->kinds[inst->u.ops[0]] == BC_VALUE_FOLDED;
+
+            if (bc_is_imm(c, inst, 1)) {
+                bc_emit(c, (BcOp) (BC_STORE_8_I + k), base, 0, (uint32_t) offset, bc_leaf_value(c->m, &f->insts[value]));
+                c->m->num_fused++;
+            } else {
+                bc_emit(c, (BcOp) (BC_STORE_8 + k), base, c->regs[value], (uint32_t) offset, 0);
+            }
+            break;
+        }
+        case IR_OFFSET: {
+            int32_t offset = 0;
+            uint32_t base = bc_address(c, inst->u.ops[0], &offset);
+
+            bc_emit(c, BC_ADD_64_I, c->regs[v], base, 0, offset + inst->imm);
+            break;
+        }
+        case IR_MEMCPY:
+            bc_emit(c, BC_MEMCPY, c->regs[inst->u.ops[0]], c->regs[inst->u.ops[1]], 0, (uint32_t) inst->imm);
+            break;
+        case IR_NEW:
+            bc_emit(c, BC_NEW, c->regs[v], 0, 0, inst->imm);
+            break;
+        case IR_DELETE:
+            bc_emit(c, BC_DELETE, 0, c->regs[inst->u.ops[0]], 0, 0);
+            break;
+        case IR_CALL:
+            bc_emit_call(c, v, inst);
+            break;
+        case IR_BR:
+            if (bc_edge_copies(c, b, inst->u.ops[0])) {
+                bc_emit_copies(c);
+            }
+
+            if (inst->u.ops[0] != b + 1) {
+                bc_fixup(c, bc_emit(c, BC_JMP, 0, 0, 0, 0), false, inst->u.ops[0]);
+            }
+            break;
+        case IR_CBR:
+            bc_emit_branch(c, b, inst);
+            break;
+        case IR_RET:
+            if (inst->num_ops > 0) {
+                bc_emit(c, BC_RET, 0, c->regs[inst->u.ops[0]], 0, 0);
+            } else {
+                bc_emit(c, BC_RET_VOID, 0, 0, 0, 0);
+            }
+            break;
+        case IR_UNREACHABLE:
+            bc_emit(c, BC_UNREACHABLE, 0, 0, 0, 0);
+            break;
+        default:
+            // parameters, constants and allocas were set up on entry, phis are written by their predecessors
+            break;
+    }
+}
+
+void *bc_copy_vec(Vec *v) {
+    void *copy = malloc(v->len * v->elem_size + 1);
+
+    // an empty vector may have no elements yet
+    if (v->len > 0) {
+        memcpy(copy, v->elements, v->len * v->elem_size);
+    }
+
+    return copy;
+}
+
+void bc_compile_func(BcCompiler *c, IrFunc *f, BcFunc *out) {
+    c->f = f;
+    c->code.len = 0;
+    c->args.len = 0;
+    c->fixups.len = 0;
+
+    bc_reserve(c, f);
+    bc_classify(c);
+    bc_assign_regs(c);
+    bc_emit_allocas(c);
+
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        c->block_starts[b] = (uint32_t) c->code.len;
+
+        while (i < block->num_insts) {
+            bc_emit_inst(c, b, block->insts[i]);
+            i++;
+        }
+
+        b++;
+    }
+
+    int64_t k = 0;
+    while (k < c->fixups.len) {
+        BcFixup *fixup = (BcFixup *) vec_get_ptr(&c->fixups, k);
+        BcInst *inst = bc_inst_at(c, fixup->at);
+
+        if (fixup->is_else) {
+            inst->c = c->block_starts[fixup->target];
+        } else {
+            inst->b = c->block_starts[fixup->target];
+        }
+
+        // back edges of loops only come from unconditional branches, the conditional ones are forward
+        if (inst->op == BC_JMP && inst->b <= fixup->at) {
+            inst->op = BC_LOOP;
+        }
+
+        k++;
+    }
+
+    out->name = f->name;
+    out->code = (BcInst *) bc_copy_vec(&c->code);
+    out->num_code = (uint32_t) c->code.len;
+    out->num_regs = c->num_regs;
+    out->num_params = f->num_params;
+    out->num_consts = (uint32_t) c->consts.len;
+    out->consts = (int64_t *) bc_copy_vec(&c->consts);
+    out->args = (uint32_t *) bc_copy_vec(&c->args);
+    out->frame_size = c->frame_size;
+
+    c->m->num_insts += c->code.len;
+}
+
+// only the globals added since the last call are laid out, into a block of their own
+void bc_layout_globals(BcModule *m) {
+    IrModule *ir = m->ir;
+    uint32_t first = m->num_globals;
+    uint32_t num_globals = (uint32_t) ir->globals.len;
+    uint32_t *offsets = (uint32_t *) malloc((num_globals - first + 1) * sizeof(uint32_t));
+    uint32_t size = 0;
+    uint32_t i = first;
+
+    while (i < num_globals) {
+        IrGlobal *g = ir_module_global(ir, i);
+        uint32_t align = ir_type_align(ir, g->ty);
+
+        align = align == 0 ? 1 : align;
+        size = (size + align - 1) / align * align;
+        offsets[i - first] = size;
+        size += ir_type_size(ir, g->ty);
+
+        i++;
+    }
+
+    uint8_t *data = (uint8_t *) calloc(size + 1, 1);
+    ptrvec_push_ptr(&m->data, (void *) data);
+
+    m->globals = (uint8_t **) realloc((void *) m->globals, (num_globals + 1) * sizeof(uint8_t *));
+    m->num_globals = num_globals;
+
+    i = first;
+    while (i < num_globals) {
+        IrGlobal *g = ir_module_global(ir, i);
+        uint8_t *p = data + offsets[i - first];
+
+        m->globals[i] = p;
+
+        if (g->init_kind == IR_INIT_STRING) {
+            const char *s = ir_module_string(ir, (uint32_t) g->init)->data;
+            memcpy(p, &s, sizeof(s));
+        } else if (g->init_kind == IR_INIT_INT && ir_type_size(ir, g->ty) == 8) {
+            memcpy(p, &g->init, 8);
+        } else if (g->init_kind == IR_INIT_INT) {
+            int32_t v = (int32_t) g->init;
+            memcpy(p, &v, 4);
+        }
+
+        i++;
+    }
+
+    free((void *) offsets);
+}
+
+// extern functions are looked up in the running process, so the image only works in the process that built it
+BcModule bc_compile(IrModule *ir) {
+    BcModule m;
+    memset((void *) &m, 0, sizeof(BcModule));
+
+    m.ir = ir;
+    m.data = ptrvec_create();
+
+    bc_extend(&m);
+
+    return m;
+}
+
+// compiles the functions and globals the IR gained since the module was last compiled, which is how the repl
+// adds every input. the arrays may move, so pointers into them do not survive this
+void bc_extend(BcModule *m) {
+    IrModule *ir = m->ir;
+    uint32_t first = m->num_funcs;
+    uint32_t num_funcs = ir_module_num_funcs(ir);
+
+    m->funcs = (BcFunc *) realloc((void *) m->funcs, (num_funcs + 1) * sizeof(BcFunc));
+    m->externs = (BcExtern *) realloc((void *) m->externs, (num_funcs + 1) * sizeof(BcExtern));
+    memset((void *) (m->funcs + first), 0, (num_funcs - first + 1) * sizeof(BcFunc));
+    memset((void *) (m->externs + first), 0, (num_funcs - first + 1) * sizeof(BcExtern));
+    m->num_funcs = num_funcs;
+
+    bc_layout_globals(m);
+
+    uint32_t i = first;
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(ir, i);
+
+        m->funcs[i].name = f->name;
+        m->funcs[i].ret = f->ret;
+
+        if (f->flags & IR_FUNC_EXTERN) {
+            BcExtern *e = &m->externs[i];
+
+            e->name = f->name;
+            e->fn = dlsym(RTLD_DEFAULT, f->name);
+            e->num_params = f->num_params;
+            e->is_varargs = (f->flags & IR_FUNC_VARARGS) != 0;
+            e->ret = f->ret;
+        }
+
+        i++;
+    }
+
+    BcCompiler c = bc_compiler_create(m);
+
+    i = first;
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(ir, i);
+
+        if (!(f->flags & IR_FUNC_EXTERN)) {
+            bc_compile_func(&c, f, &m->funcs[i]);
+        }
+
+        i++;
+    }
+
+    bc_compiler_free(&c);
+}
+
+void bc_free(BcModule *m) {
+    uint32_t i = 0;
+
+    while (i < m->num_funcs) {
+        free((void *) m->funcs[i].code);
+        free((void *) m->funcs[i].consts);
+        free((void *) m->funcs[i].args);
+        i++;
+    }
+
+    int64_t j = 0;
+    while (j < m->data.len) {
+        free(ptrvec_get(&m->data, j));
+        j++;
+    }
+
+    free((void *) m->funcs);
+    free((void *) m->externs);
+    free((void *) m->globals);
+    ptrvec_free(&m->data);
+}
+
+BcFunc *bc_lookup(BcModule *m, const char *name) {
+    IrFunc *f = ir_func_lookup(m->ir, name, (int32_t) strlen(name));
+
+    if (f == NULL || (f->flags & IR_FUNC_EXTERN)) {
+        return NULL;
+    }
+
+    return &m->funcs[f->idx];
+}
+
+void bc_dump_func(FILE *out, BcFunc *f) {
+    fprintf(out, "func %s: %u params, %u regs, %u bytes of frame\n", f->name, f->num_params, f->num_regs, f->frame_size);
+
+    uint32_t i = 0;
+    while (i < f->num_consts) {
+        fprintf(out, "    r%u = %ld\n", f->num_params + i, (long) f->consts[i]);
+        i++;
+    }
+
+    i = 0;
+    while (i < f->num_code) {
+        BcInst *inst = &f->code[i];
+        const char *name = bc_op2str((BcOp) inst->op);
+        char lower[32];
+        int32_t j = 0;
+
+        while (name[j] != '\0' && j < 31) {
+            lower[j] = (char) tolower((unsigned char) name[j]);
+            j++;
+        }
+
+        lower[j] = '\0';
+        fprintf(out, "%6u  %-12s %u, %u, %u, %ld\n", i, lower, inst->a, inst->b, inst->c, (long) inst->imm);
+
+        i++;
+    }
+
+    fprintf(out, "\n");
+}
+
+void bc_dump_module(FILE *out, BcModule *m) {
+    uint32_t i = 0;
+
+    while (i < m->num_funcs) {
+        if (m->funcs[i].code != NULL) {
+            bc_dump_func(out, &m->funcs[i]);
+        }
+
+        i++;
+    }
+}
@@ -0,0 +1,1216 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../include/cemit.h"
+#include "../include/lower.h"
+#include "../include/timer.h"
+#include "../include/utils.h"
+#include "../include/timetrace.h"
+#include "../include/typecheck.h"
+
+// i32 arithmetic wraps in Synthium, so the operators that can overflow go through unsigned helpers
+static char const *const cemit_prelude =
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "\n"
+    "static inline int32_t synthium_add(int32_t a, int32_t b) { return (int32_t) ((uint32_t) a + (uint32_t) b); }\n"
+    "static inline int32_t synthium_sub(int32_t a, int32_t b) { return (int32_t) ((uint32_t) a - (uint32_t) b); }\n"
+    "static inline int32_t synthium_mul(int32_t a, int32_t b) { return (int32_t) ((uint32_t) a * (uint32_t) b); }\n"
+    "static inline int32_t synthium_neg(int32_t a) { return (int32_t) (0u - (uint32_t) a); }\n";
+
+static char const *const cemit_new_helper =
+    "\nstatic void *synthium_new(size_t size, const void *value) {\n"
+    "    unsigned char *p = (unsigned char *) malloc(size);\n"
+    "    size_t i = 0;\n"
+    "\n"
+    "    while (i < size) {\n"
+    "        p[i] = ((const unsigned char *) value)[i];\n"
+    "        i++;\n"
+    "    }\n"
+    "\n"
+    "    return p;\n"
+    "}\n";
+
+// a `become` of another function has to reuse the frame, which only clang's musttail promises
+static char const *const cemit_musttail_check =
+    "\n#if defined(__has_attribute)\n"
+    "#if __has_attribute(musttail)\n"
+    "#define SYNTHIUM_MUSTTAIL __attribute__((musttail))\n"
+    "#endif\n"
+    "#endif\n"
+    "\n"
+    "#ifndef SYNTHIUM_MUSTTAIL\n"
+    "#error \"'become' of another function needs a C compiler with __attribute__((musttail))\"\n"
+    "#endif\n";
+
+static char const *const cemit_keywords[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+    "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return",
+    "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+    "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic",
+    "_Imaginary", "_Noreturn", "_Static_assert", "_Thread_local"
+};
+
+#define CEMIT_NUM_KEYWORDS ((int32_t) (sizeof(cemit_keywords) / sizeof(cemit_keywords[0])))
+
+void cemit_declare_symbols(CEmitter *c);
+
+CEmitter cemit_create(ModuleMap *mods, SpanInterner *si) {
+    int32_t num_mods = mod_num_mods(mods);
+
+    CEmitter c = {
+        .mods = mods,
+        .si = si,
+        .prefixes = lower_symbol_prefixes(mods),
+        .symbols = (Map *) calloc(num_mods + 1, sizeof(Map)),
+        .syms = vec_create(sizeof(CEmitSym)),
+        .externs = vec_create(sizeof(uint32_t)),
+        .has_malloc = false,
+        .has_free = false,
+        .mod = NULL,
+        .stamp = 0,
+        .types = buf_create(),
+        .decls = buf_create(),
+        .body = buf_create(),
+        .names = vec_create(sizeof(CEmitName)),
+        .num_locals = 0,
+        .depth = 0,
+        .func = NULL,
+        .uses_new = false,
+        .uses_delete = false,
+        .uses_musttail = false,
+        .num_bytes = 0,
+        .num_files = 0
+    };
+
+    cemit_declare_symbols(&c);
+
+    return c;
+}
+
+void cemit_free(CEmitter *c) {
+    int32_t i = 0;
+    while (i < mod_num_mods(c->mods)) {
+        free((void *) c->prefixes[i]);
+        map_free(&c->symbols[i]);
+        i++;
+    }
+
+    free((void *) c->prefixes);
+    free((void *) c->symbols);
+    vec_free(&c->syms);
+    vec_free(&c->externs);
+    buf_free(&c->types);
+    buf_free(&c->decls);
+    buf_free(&c->body);
+    vec_free(&c->names);
+}
+
+uint32_t cemit_add_sym(CEmitter *c, Module *mod, Ident *name, Ty *ty, uint32_t flags) {
+    CEmitSym sym = {
+        .name = *name,
+        .ty = ty,
+        .mod = mod->idx,
+        .flags = flags,
+        .stamp = 0
+    };
+
+    uint32_t idx = c->syms.len;
+    vec_push(&c->syms, (void *) &sym);
+    map_insert(&c->symbols[mod->idx], map_key_from_ident(c->si, name), int2ptr(idx + 1));
+
+    return idx;
+}
+
+bool cemit_ident_is(CEmitter *c, Ident *ident, const char *s) {
+    int32_t len = ident_len(ident, c->si);
+    return len == (int32_t) strlen(s) && strncmp(ident->ident, s, len) == 0;
+}
+
+// names follow the lowering: externs and the first main keep theirs, everything else gets the module prefix.
+// externs are shared between modules, only the first declaration of a name is kept
+void cemit_declare_symbols(CEmitter *c) {
+    Map extern_names = map_create();
+    bool has_main = false;
+    int32_t i = 0;
+
+    while (i < mod_num_mods(c->mods)) {
+        Module *mod = mod_get_mod(c->mods, i);
+        c->symbols[i] = map_create();
+        int32_t j = 0;
+
+        while (j < mod_num_structs(mod)) {
+            StructDecl *decl = &mod_get_struct_at(mod, j)->decl;
+            Ty *ty = mod_s_lookup(mod, ident_len(&decl->name, c->si), decl->name.ident);
+
+            if (ty != NULL && ty_is_struct(ty)) {
+                cemit_add_sym(c, mod, &decl->name, ty, CEMIT_STRUCT);
+            }
+
+            j++;
+        }
+
+        j = 0;
+        while (j < mod_num_functions(mod)) {
+            FuncDef *def = &mod_get_function_at(mod, j)->decl;
+            Ty *ty = mod_s_lookup(mod, ident_len(&def->name, c->si), def->name.ident);
+
+            if (ty == NULL || !ty_is_func(ty) || ty_as_func(ty)->name.ident != def->name.ident) {
+                j++;
+                continue;
+            }
+
+            bool is_main = cemit_ident_is(c, &def->name, "main") && (def->is_extern || !has_main);
+            uint32_t flags = CEMIT_FUNC | (def->is_extern ? CEMIT_EXTERN : 0) | (def->is_extern || is_main ? CEMIT_KEEPS_NAME : 0);
+            uint32_t idx = cemit_add_sym(c, mod, &def->name, ty, flags);
+            Key key = map_key_from_ident(c->si, &def->name);
+
+            has_main = has_main || is_main;
+
+            if (def->is_extern && map_get(&extern_names, key) == NULL) {
+                map_insert(&extern_names, key, int2ptr(idx + 1));
+                vec_push(&c->externs, (void *) &idx);
+
+                c->has_malloc = c->has_malloc || cemit_ident_is(c, &def->name, "malloc");
+                c->has_free = c->has_free || cemit_ident_is(c, &def->name, "free");
+            }
+
+            j++;
+        }
+
+        j = 0;
+        while (j < mod_num_stmts(mod)) {
+            Stmt *s = mod_get_stmt_at(mod, j);
+
+            if (s != NULL && ast_is_let_stmt(s)) {
+                LetStmt *l_s = ast_as_let_stmt(s);
+                uint32_t flags = CEMIT_GLOBAL | (ast_is_string_expr(l_s->value) ? CEMIT_STRING : 0);
+
+                cemit_add_sym(c, mod, &l_s->ident, NULL, flags);
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    map_free(&extern_names);
+}
+
+CEmitSym *cemit_lookup(CEmitter *c, int32_t mod_idx, Ident *name) {
+    void *idx = map_get(&c->symbols[mod_idx], map_key_from_ident(c->si, name));
+    return idx == NULL ? NULL : (CEmitSym *) vec_get_ptr(&c->syms, ptr2int(idx) - 1);
+}
+
+// the module of a struct or function is found through the file its name was parsed from
+CEmitSym *cemit_lookup_decl(CEmitter *c, Ident *name) {
+    return cemit_lookup(c, span_get(c->si, name->ident_span).ctx, name);
+}
+
+void cemit_ident(CEmitter *c, Buf *out, Ident *ident) {
+    buf_push(out, ident->ident, ident_len(ident, c->si));
+}
+
+// field names are kept, except the ones that are C keywords
+void cemit_field(CEmitter *c, Buf *out, Ident *ident) {
+    int32_t len = ident_len(ident, c->si);
+    int32_t i = 0;
+
+    buf_push(out, ident->ident, len);
+
+    while (i < CEMIT_NUM_KEYWORDS) {
+        if ((int32_t) strlen(cemit_keywords[i]) == len && strncmp(cemit_keywords[i], ident->ident, len) == 0) {
+            buf_push_u8(out, '_');
+            return;
+        }
+
+        i++;
+    }
+}
+
+void cemit_sym_name(CEmitter *c, Buf *out, CEmitSym *sym) {
+    if (!(sym->flags & CEMIT_KEEPS_NAME)) {
+        buf_push_str(out, c->prefixes[sym->mod]);
+        buf_push(out, "__", 2);
+    }
+
+    cemit_ident(c, out, &sym->name);
+}
+
+// declarations are written as "type name", pointer types already end in a star
+void cemit_space(Buf *out) {
+    if (out->len == 0 || out->data[out->len - 1] != '*') {
+        buf_push_u8(out, ' ');
+    }
+}
+
+void cemit_indent(CEmitter *c) {
+    int32_t i = 0;
+
+    while (i < c->depth) {
+        buf_push(&c->body, "    ", 4);
+        i++;
+    }
+}
+
+void cemit_require(CEmitter *c, CEmitSym *sym);
+
+// functions are only ever stored as addresses, they never reach a C declaration as anything but void *
+void cemit_type(CEmitter *c, Buf *out, Ty *t) {
+    int32_t count = 0;
+
+    if (ty_is_ptr(t)) {
+        count = ty_as_ptr(t)->count;
+        t = ty_as_ptr(t)->inner;
+    }
+
+    if (ty_is_i32(t)) {
+        buf_push_str(out, "int32_t");
+    } else if (ty_is_string(t)) {
+        buf_push_str(out, "char *");
+    } else if (ty_is_struct(t)) {
+        CEmitSym *sym = cemit_lookup_decl(c, &ty_as_struct(t)->name);
+        cemit_require(c, sym);
+
+        buf_push_str(out, "struct ");
+        cemit_sym_name(c, out, sym);
+    } else {
+        buf_push_str(out, "void *");
+    }
+
+    if (count > 0) {
+        cemit_space(out);
+    }
+
+    while (count > 0) {
+        buf_push_u8(out, '*');
+        count--;
+    }
+}
+
+// the layout the type checker computed is asserted, so the C compiler rejects the unit if its layout differs
+void cemit_define_struct(CEmitter *c, CEmitSym *sym) {
+    Struct *s = ty_as_struct(sym->ty);
+    Buf *out = &c->types;
+    int32_t i = 0;
+
+    // structs used by value have to be complete first, pointers to structs that are still being
+    // defined declare the tag at file scope
+    while (i < ty_num_fields(s)) {
+        Ty *ty = ty_field_at(s, i)->ty;
+        Ty *inner = ty_is_ptr(ty) ? ty_as_ptr(ty)->inner : ty;
+
+        if (ty_is_struct(inner)) {
+            cemit_require(c, cemit_lookup_decl(c, &ty_as_struct(inner)->name));
+        }
+
+        i++;
+    }
+
+    buf_push_str(out, "struct ");
+    cemit_sym_name(c, out, sym);
+    buf_push_str(out, " {\n");
+
+    i = 0;
+    while (i < ty_num_fields(s)) {
+        StructField *f = ty_field_at(s, i);
+
+        buf_push_str(out, "    ");
+        cemit_type(c, out, f->ty);
+        cemit_space(out);
+        cemit_field(c, out, &f->name);
+        buf_push_str(out, ";\n");
+
+        i++;
+    }
+
+    buf_push_str(out, "};\n\n_Static_assert(sizeof(struct ");
+    cemit_sym_name(c, out, sym);
+    buf_push_str(out, ") == ");
+    buf_push_int(out, s->t.width);
+    buf_push_str(out, ", \"width of ");
+    cemit_ident(c, out, &sym->name);
+    buf_push_str(out, "\");\n_Static_assert(_Alignof(struct ");
+    cemit_sym_name(c, out, sym);
+    buf_push_str(out, ") == ");
+    buf_push_int(out, s->t.align);
+    buf_push_str(out, ", \"alignment of ");
+    cemit_ident(c, out, &sym->name);
+    buf_push_str(out, "\");\n\n");
+}
+
+CEmitName *cemit_lookup_local(CEmitter *c, Ident *ident) {
+    int32_t len = ident_len(ident, c->si);
+    int64_t i = c->names.len - 1;
+
+    while (i >= 0) {
+        CEmitName *name = (CEmitName *) vec_get_ptr(&c->names, i);
+
+        if (name->len == len && name->name[0] == ident->ident[0] && strncmp(name->name, ident->ident, len) == 0) {
+            return name;
+        }
+
+        i--;
+    }
+
+    return NULL;
+}
+
+void cemit_local(Buf *out, CEmitName *name) {
+    buf_push(out, name->name, name->len);
+    buf_push_u8(out, '_');
+    buf_push_int(out, name->id);
+}
+
+// the name is declared before its initializer is written but bound after it, so the initializer still
+// sees the shadowed name
+CEmitName cemit_new_local(CEmitter *c, Buf *out, Ident *ident) {
+    CEmitName name = {
+        .name = ident->ident,
+        .len = ident_len(ident, c->si),
+        .id = c->num_locals++
+    };
+
+    cemit_local(out, &name);
+
+    return name;
+}
+
+// params is NULL for prototypes, otherwise the parameters are named and bound as locals
+void cemit_signature(CEmitter *c, Buf *out, CEmitSym *sym, ParamList *params) {
+    Func *f = ty_as_func(sym->ty);
+    int32_t num_params = f->params.types.len;
+    int32_t i = 0;
+
+    cemit_type(c, out, f->ret);
+    cemit_space(out);
+    cemit_sym_name(c, out, sym);
+    buf_push_u8(out, '(');
+
+    while (i < num_params) {
+        if (i > 0) {
+            buf_push(out, ", ", 2);
+        }
+
+        Ty *ty = ty_type_at(&f->params, i);
+
+        // libc takes its strings as const char *, so declaring externs the same way matches the builtins
+        if ((sym->flags & CEMIT_EXTERN) && ty_is_string(ty)) {
+            buf_push_str(out, "const char *");
+        } else {
+            cemit_type(c, out, ty);
+        }
+
+        if (params != NULL) {
+            Param *p = (Param *) vec_get_ptr(&params->params, i);
+
+            cemit_space(out);
+            CEmitName name = cemit_new_local(c, out, &p->name);
+            vec_push(&c->names, (void *) &name);
+        }
+
+        i++;
+    }
+
+    if (f->is_varargs && num_params > 0) {
+        buf_push_str(out, ", ...");
+    } else if (num_params == 0 && !f->is_varargs) {
+        buf_push_str(out, "void");
+    }
+
+    buf_push_u8(out, ')');
+}
+
+// symbols of other modules are declared the first time a unit mentions them, externs are declared up front
+void cemit_require(CEmitter *c, CEmitSym *sym) {
+    if (sym->stamp == c->stamp) {
+        return;
+    }
+
+    sym->stamp = c->stamp;
+
+    if (sym->flags & CEMIT_EXTERN) {
+        return;
+    }
+
+    if (sym->flags & CEMIT_STRUCT) {
+        cemit_define_struct(c, sym);
+    } else if (sym->flags & CEMIT_FUNC) {
+        cemit_signature(c, &c->decls, sym, NULL);
+        buf_push_str(&c->decls, ";\n");
+    } else {
+        buf_push_str(&c->decls, sym->flags & CEMIT_STRING ? "extern char *" : "extern int32_t ");
+        cemit_sym_name(c, &c->decls, sym);
+        buf_push_str(&c->decls, ";\n");
+    }
+}
+
+int64_t cemit_parse_int(Expr *e) {
+    if (ast_is_unary_expr(e)) {
+        return -cemit_parse_int(ast_as_unary_expr(e)->right);
+    }
+
+    if (ast_is_char_expr(e)) {
+        return (unsigned char) ast_as_char_expr(e)->ptr[0];
+    }
+
+    // the literal of the smallest i32 wraps around, its negation brings it back
+    return (int32_t) ast_as_int_expr(e)->value;
+}
+
+void cemit_int(Buf *out, int32_t v) {
+    // the smallest i32 has no literal of type int
+    if (v == INT32_MIN) {
+        buf_push_str(out, "(-2147483647 - 1)");
+        return;
+    }
+
+    buf_push_int(out, v);
+}
+
+// escapes are decoded like the lowering does it and written back the C way. octal escapes always
+// have three digits so they cannot run into a following digit, and '?' is escaped so no trigraph forms
+void cemit_string(CEmitter *c, Buf *out, StringExpr *s_e) {
+    int32_t len = span_get(c->si, s_e->e.span).len;
+    int32_t i = 0;
+
+    buf_push_u8(out, '"');
+
+    while (i < len) {
+        unsigned char ch = s_e->ptr[i++];
+
+        if (ch == '\\' && i < len) {
+            ch = s_e->ptr[i++];
+
+            switch (ch) {
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case 'r': ch = '\r'; break;
+                case '0': ch = '\0'; break;
+                default: break;
+            }
+        }
+
+        if (ch == '"' || ch == '\\' || ch == '?') {
+            buf_push_u8(out, '\\');
+            buf_push_u8(out, ch);
+        } else if (ch == '\n') {
+            buf_push(out, "\\n", 2);
+        } else if (ch == '\t') {
+            buf_push(out, "\\t", 2);
+        } else if (ch >= 0x20 && ch < 0x7f) {
+            buf_push_u8(out, ch);
+        } else {
+            buf_push_u8(out, '\\');
+            buf_push_u8(out, '0' + (ch >> 6));
+            buf_push_u8(out, '0' + ((ch >> 3) & 7));
+            buf_push_u8(out, '0' + (ch & 7));
+        }
+    }
+
+    buf_push_u8(out, '"');
+}
+
+CEmitSym *cemit_func_sym(CEmitter *c, Func *f) {
+    CEmitSym *sym = cemit_lookup_decl(c, &f->name);
+    cemit_require(c, sym);
+
+    return sym;
+}
+
+void cemit_expr(CEmitter *c, Expr *e, bool parens);
+
+void cemit_binary(CEmitter *c, BinaryExpr *b_e, bool parens) {
+    Buf *out = &c->body;
+    const char *helper = NULL;
+    const char *op = NULL;
+
+    switch (b_e->ty) {
+        case BINARY_ADD: helper = "synthium_add("; break;
+        case BINARY_SUB: helper = "synthium_sub("; break;
+        case BINARY_MUL: helper = "synthium_mul("; break;
+        case BINARY_DIV: op = " / "; break;
+        case BINARY_MOD: op = " % "; break;
+        case BINARY_ST: op = " < "; break;
+        case BINARY_SE: op = " <= "; break;
+        case BINARY_GT: op = " > "; break;
+        case BINARY_GE: op = " >= "; break;
+        case BINARY_EQ: op = " == "; break;
+        case BINARY_NE: op = " != "; break;
+        case BINARY_LOG_AND: op = " && "; break;
+        case BINARY_LOG_OR: op = " || "; break;
+    }
+
+    // pointer arithmetic scales by the pointee like C's own
+    if (helper != NULL && ty_is_ptr(b_e->left->ty)) {
+        op = b_e->ty == BINARY_ADD ? " + " : " - ";
+        helper = NULL;
+    }
+
+    if (helper != NULL) {
+        buf_push_str(out, helper);
+        cemit_expr(c, b_e->left, false);
+        buf_push(out, ", ", 2);
+        cemit_expr(c, b_e->right, false);
+        buf_push_u8(out, ')');
+
+        return;
+    }
+
+    if (parens) {
+        buf_push_u8(out, '(');
+    }
+
+    cemit_expr(c, b_e->left, true);
+    buf_push_str(out, op);
+    cemit_expr(c, b_e->right, true);
+
+    if (parens) {
+        buf_push_u8(out, ')');
+    }
+}
+
+void cemit_unary(CEmitter *c, UnaryExpr *u_e, bool parens) {
+    Buf *out = &c->body;
+
+    if (u_e->ty == UNARY_NEG_NUM) {
+        buf_push_str(out, "synthium_neg(");
+        cemit_expr(c, u_e->right, false);
+        buf_push_u8(out, ')');
+
+        return;
+    }
+
+    if (parens) {
+        buf_push_u8(out, '(');
+    }
+
+    switch (u_e->ty) {
+        case UNARY_REF: buf_push_u8(out, '&'); break;
+        case UNARY_DEREF: buf_push_u8(out, '*'); break;
+        default: buf_push_u8(out, '!'); break;
+    }
+
+    cemit_expr(c, u_e->right, true);
+
+    if (parens) {
+        buf_push_u8(out, ')');
+    }
+}
+
+void cemit_call(CEmitter *c, CallExpr *c_e) {
+    Buf *out = &c->body;
+    int32_t num_args = ast_num_args(&c_e->args);
+    int32_t i = 0;
+
+    cemit_sym_name(c, out, cemit_func_sym(c, ty_as_func(c_e->ident->ty)));
+    buf_push_u8(out, '(');
+
+    while (i < num_args) {
+        if (i > 0) {
+            buf_push(out, ", ", 2);
+        }
+
+        cemit_expr(c, ast_get_arg_at(&c_e->args, i), false);
+        i++;
+    }
+
+    buf_push_u8(out, ')');
+}
+
+// fields without an initializer are zeroed by the compound literal. unlike the IR, C leaves the order in
+// which the initializers are evaluated unspecified
+void cemit_init(CEmitter *c, InitExpr *i_e) {
+    Buf *out = &c->body;
+    int32_t num_inits = ast_num_inits(&i_e->inits);
+    int32_t i = 0;
+
+    buf_push_u8(out, '(');
+    cemit_type(c, out, i_e->e.ty);
+    buf_push_str(out, ") { ");
+
+    while (i < num_inits) {
+        Init *init = (Init *) vec_get_ptr(&i_e->inits.inits, i);
+
+        if (i > 0) {
+            buf_push(out, ", ", 2);
+        }
+
+        buf_push_u8(out, '.');
+        cemit_field(c, out, &init->ident);
+        buf_push(out, " = ", 3);
+        cemit_expr(c, init->expr, false);
+
+        i++;
+    }
+
+    if (num_inits == 0) {
+        buf_push_u8(out, '0');
+    }
+
+    buf_push_str(out, " }");
+}
+
+// integers and pointers convert through intptr_t, like the IR's sign extension and truncation
+void cemit_cast(CEmitter *c, AsExpr *a_e, bool parens) {
+    Buf *out = &c->body;
+    Ty *from = a_e->expr->ty;
+    Ty *to = a_e->e.ty;
+
+    if (ty_is_i32(from) && ty_is_i32(to)) {
+        cemit_expr(c, a_e->expr, parens);
+        return;
+    }
+
+    if (parens) {
+        buf_push_u8(out, '(');
+    }
+
+    buf_push_u8(out, '(');
+    cemit_type(c, out, to);
+    buf_push_str(out, ty_is_i32(from) || ty_is_i32(to) ? ") (intptr_t) " : ") ");
+    cemit_expr(c, a_e->expr, true);
+
+    if (parens) {
+        buf_push_u8(out, ')');
+    }
+}
+
+// the value is built in a one element array literal, which also accepts a struct valued expression
+void cemit_new(CEmitter *c, NewExpr *n_e) {
+    Buf *out = &c->body;
+    Ty *ty = n_e->expr->ty;
+
+    c->uses_new = true;
+
+    buf_push_str(out, "((");
+    cemit_type(c, out, n_e->e.ty);
+    buf_push_str(out, ") synthium_new(sizeof(");
+    cemit_type(c, out, ty);
+    buf_push_str(out, "), (");
+    cemit_type(c, out, ty);
+    buf_push_str(out, "[]) { ");
+    cemit_expr(c, n_e->expr, false);
+    buf_push_str(out, " }))");
+}
+
+// function values only exist as addresses, calls always name the callee
+void cemit_func_addr(CEmitter *c, Func *f) {
+    buf_push_str(&c->body, "(void *) ");
+    cemit_sym_name(c, &c->body, cemit_func_sym(c, f));
+}
+
+// binary operators, assignments and casts are parenthesized when they are operands of another expression
+void cemit_expr(CEmitter *c, Expr *e, bool parens) {
+    Buf *out = &c->body;
+
+    switch (e->tag) {
+        case EXPR_INT:
+        case EXPR_CHAR: {
+            cemit_int(out, cemit_parse_int(e));
+            break;
+        }
+
+        case EXPR_STRING: {
+            cemit_string(c, out, ast_as_string_expr(e));
+            break;
+        }
+
+        case EXPR_IDENT: {
+            Ident *ident = &ast_as_ident_expr(e)->ident;
+            CEmitName *name = cemit_lookup_local(c, ident);
+
+            if (name != NULL) {
+                cemit_local(out, name);
+            } else if (ty_is_func(e->ty)) {
+                cemit_func_addr(c, ty_as_func(e->ty));
+            } else {
+                cemit_sym_name(c, out, cemit_lookup(c, c->mod->idx, ident));
+            }
+
+            break;
+        }
+
+        case EXPR_ACCESS: {
+            AccessExpr *a_e = ast_as_access_expr(e);
+            Ident *field = &ast_as_ident_expr(a_e->right)->ident;
+
+            if (ty_is_func(e->ty)) {
+                cemit_func_addr(c, ty_as_func(e->ty));
+            } else if (ty_is_mod(a_e->left->ty)) {
+                CEmitSym *sym = cemit_lookup(c, ty_as_mod(a_e->left->ty)->idx, field);
+
+                cemit_require(c, sym);
+                cemit_sym_name(c, out, sym);
+            } else {
+                cemit_expr(c, a_e->left, true);
+                buf_push_str(out, ty_is_ptr(a_e->left->ty) ? "->" : ".");
+                cemit_field(c, out, field);
+            }
+
+            break;
+        }
+
+        case EXPR_CALL: {
+            cemit_call(c, ast_as_call_expr(e));
+            break;
+        }
+
+        case EXPR_INIT: {
+            cemit_init(c, ast_as_init_expr(e));
+            break;
+        }
+
+        case EXPR_BINARY: {
+            cemit_binary(c, ast_as_binary_expr(e), parens);
+            break;
+        }
+
+        case EXPR_UNARY: {
+            cemit_unary(c, ast_as_unary_expr(e), parens);
+            break;
+        }
+
+        case EXPR_ASSIGN: {
+            AssignExpr *a_e = ast_as_assign_expr(e);
+
+            if (parens) {
+                buf_push_u8(out, '(');
+            }
+
+            cemit_expr(c, a_e->left, true);
+            buf_push(out, " = ", 3);
+            cemit_expr(c, a_e->right, false);
+
+            if (parens) {
+                buf_push_u8(out, ')');
+            }
+
+            break;
+        }
+
+        case EXPR_AS: {
+            cemit_cast(c, ast_as_as_expr(e), parens);
+            break;
+        }
+
+        case EXPR_NEW: {
+            cemit_new(c, ast_as_new_expr(e));
+            break;
+        }
+    }
+}
+
+void cemit_stmt(CEmitter *c, Stmt *s);
+
+// returns whether the block ends in a return, statements after a return are unreachable and are not emitted
+bool cemit_stmts(CEmitter *c, BlockStmt *b) {
+    int32_t i = 0;
+
+    while (i < b->stmts.len) {
+        Stmt *s = (Stmt *) ptrvec_get(&b->stmts, i);
+        cemit_stmt(c, s);
+
+        if (ast_is_return_stmt(s)) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+void cemit_block(CEmitter *c, BlockStmt *b) {
+    int64_t num_names = c->names.len;
+
+    buf_push_str(&c->body, "{\n");
+    c->depth++;
+    cemit_stmts(c, b);
+    c->depth--;
+    cemit_indent(c);
+    buf_push_u8(&c->body, '}');
+
+    c->names.len = num_names;
+}
+
+void cemit_if(CEmitter *c, IfStmt *i_s) {
+    buf_push_str(&c->body, "if (");
+    cemit_expr(c, i_s->condition, false);
+    buf_push_str(&c->body, ") ");
+    cemit_block(c, i_s->block);
+
+    if (i_s->else_stmt == NULL) {
+        return;
+    }
+
+    buf_push_str(&c->body, " else ");
+
+    if (ast_is_if_stmt(i_s->else_stmt)) {
+        cemit_if(c, ast_as_if_stmt(i_s->else_stmt));
+    } else {
+        cemit_block(c, ast_as_block_stmt(i_s->else_stmt));
+    }
+}
+
+void cemit_let(CEmitter *c, LetStmt *l_s) {
+    cemit_type(c, &c->body, l_s->value->ty);
+    cemit_space(&c->body);
+
+    CEmitName name = cemit_new_local(c, &c->body, &l_s->ident);
+    buf_push(&c->body, " = ", 3);
+    cemit_expr(c, l_s->value, false);
+    buf_push_u8(&c->body, ';');
+
+    vec_push(&c->names, (void *) &name);
+}
+
+// the arguments are all evaluated before the first parameter is assigned, since they may read the parameters
+void cemit_become_self(CEmitter *c, CallExpr *c_e) {
+    Buf *out = &c->body;
+    int32_t num_args = ast_num_args(&c_e->args);
+    int32_t i = 0;
+
+    buf_push_str(out, "{\n");
+    c->depth++;
+
+    while (i < num_args) {
+        cemit_indent(c);
+        cemit_type(c, out, ty_type_at(&c->func->params, i));
+        cemit_space(out);
+        buf_push_str(out, "synthium_arg");
+        buf_push_int(out, i);
+        buf_push(out, " = ", 3);
+        cemit_expr(c, ast_get_arg_at(&c_e->args, i), false);
+        buf_push_str(out, ";\n");
+
+        i++;
+    }
+
+    i = 0;
+    while (i < num_args) {
+        cemit_indent(c);
+        cemit_local(out, (CEmitName *) vec_get_ptr(&c->names, i));
+        buf_push_str(out, " = synthium_arg");
+        buf_push_int(out, i);
+        buf_push_str(out, ";\n");
+
+        i++;
+    }
+
+    cemit_indent(c);
+    buf_push_str(out, "goto synthium_top;\n");
+    c->depth--;
+    cemit_indent(c);
+    buf_push_u8(out, '}');
+}
+
+// a function calling itself jumps back to the top of its body, a call of any other function has to be a tail
+// call in C too. the type checker and the tail call pass have ruled out what would keep it from being one
+void cemit_become(CEmitter *c, CallExpr *c_e) {
+    if (ty_as_func(c_e->ident->ty) == c->func) {
+        cemit_become_self(c, c_e);
+        return;
+    }
+
+    c->uses_musttail = true;
+
+    buf_push_str(&c->body, "SYNTHIUM_MUSTTAIL return ");
+    cemit_call(c, c_e);
+    buf_push_u8(&c->body, ';');
+}
+
+// whether a `become` in the block calls the function being written
+bool cemit_becomes_self(CEmitter *c, BlockStmt *b) {
+    int32_t i = 0;
+
+    while (i < b->stmts.len) {
+        Stmt *s = (Stmt *) ptrvec_get(&b->stmts, i);
+        bool found = false;
+
+        if (ast_is_block_stmt(s)) {
+            found = cemit_becomes_self(c, ast_as_block_stmt(s));
+        } else if (ast_is_while_stmt(s)) {
+            found = cemit_becomes_self(c, ast_as_while_stmt(s)->block);
+        } else if (ast_is_if_stmt(s)) {
+            Stmt *else_stmt = ast_as_if_stmt(s)->else_stmt;
+
+            found = cemit_becomes_self(c, ast_as_if_stmt(s)->block);
+
+            while (!found && else_stmt != NULL && ast_is_if_stmt(else_stmt)) {
+                found = cemit_becomes_self(c, ast_as_if_stmt(else_stmt)->block);
+                else_stmt = ast_as_if_stmt(else_stmt)->else_stmt;
+            }
+
+            if (!found && else_stmt != NULL) {
+                found = cemit_becomes_self(c, ast_as_block_stmt(else_stmt));
+            }
+        } else if (ast_is_return_stmt(s) && ast_as_return_stmt(s)->become) {
+            found = ty_as_func(ast_as_call_expr(ast_as_return_stmt(s)->expr)->ident->ty) == c->func;
+        }
+
+        if (found) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+void cemit_stmt(CEmitter *c, Stmt *s) {
+    Buf *out = &c->body;
+
+    cemit_indent(c);
+
+    switch (s->tag) {
+        case STMT_EXPR: {
+            cemit_expr(c, ast_as_expr_stmt(s)->expr, false);
+            buf_push_u8(out, ';');
+            break;
+        }
+
+        case STMT_LET: {
+            cemit_let(c, ast_as_let_stmt(s));
+            break;
+        }
+
+        case STMT_BLOCK: {
+            cemit_block(c, ast_as_block_stmt(s));
+            break;
+        }
+
+        case STMT_IF: {
+            cemit_if(c, ast_as_if_stmt(s));
+            break;
+        }
+
+        case STMT_WHILE: {
+            WhileStmt *w_s = ast_as_while_stmt(s);
+
+            buf_push_str(out, "while (");
+            cemit_expr(c, w_s->cond, false);
+            buf_push_str(out, ") ");
+            cemit_block(c, w_s->block);
+
+            break;
+        }
+
+        case STMT_DELETE: {
+            c->uses_delete = true;
+
+            buf_push_str(out, "free((void *) ");
+            cemit_expr(c, ast_as_delete_stmt(s)->expr, true);
+            buf_push_str(out, ");");
+
+            break;
+        }
+
+        case STMT_RETURN: {
+            ReturnStmt *r_s = ast_as_return_stmt(s);
+
+            if (r_s->become) {
+                cemit_become(c, ast_as_call_expr(r_s->expr));
+            } else if (r_s->expr == NULL) {
+                buf_push_str(out, "return;");
+            } else {
+                buf_push_str(out, "return ");
+                cemit_expr(c, r_s->expr, false);
+                buf_push_u8(out, ';');
+            }
+
+            break;
+        }
+
+        default: {
+            buf_push_u8(out, ';');
+            break;
+        }
+    }
+
+    buf_push_u8(out, '\n');
+}
+
+// a function that falls off its end returns zero, like the lowered one
+void cemit_func(CEmitter *c, FuncDeclStmt *f_s, CEmitSym *sym) {
+    Buf *out = &c->body;
+    Ty *ret = ty_as_func(sym->ty)->ret;
+
+    c->names.len = 0;
+    c->num_locals = 0;
+    c->func = ty_as_func(sym->ty);
+
+    buf_push_u8(out, '\n');
+    cemit_signature(c, out, sym, &f_s->decl.params);
+    buf_push_str(out, " {\n");
+    c->depth = 1;
+
+    if (cemit_becomes_self(c, f_s->block)) {
+        buf_push_str(out, "synthium_top:;\n");
+    }
+
+    if (!cemit_stmts(c, f_s->block)) {
+        cemit_indent(c);
+
+        if (ty_is_struct(ret)) {
+            buf_push_str(out, "return (");
+            cemit_type(c, out, ret);
+            buf_push_str(out, ") { 0 };\n");
+        } else {
+            buf_push_str(out, "return 0;\n");
+        }
+    }
+
+    c->depth = 0;
+    buf_push_str(out, "}\n");
+}
+
+void cemit_global(CEmitter *c, LetStmt *l_s) {
+    CEmitSym *sym = cemit_lookup(c, c->mod->idx, &l_s->ident);
+    sym->stamp = c->stamp;
+
+    buf_push_str(&c->decls, sym->flags & CEMIT_STRING ? "char *" : "int32_t ");
+    cemit_sym_name(c, &c->decls, sym);
+    buf_push(&c->decls, " = ", 3);
+
+    if (sym->flags & CEMIT_STRING) {
+        cemit_string(c, &c->decls, ast_as_string_expr(l_s->value));
+    } else {
+        cemit_int(&c->decls, (int32_t) cemit_parse_int(l_s->value));
+    }
+
+    buf_push_str(&c->decls, ";\n");
+}
+
+// every unit declares all externs, its own structs, globals and function prototypes, then whatever it
+// uses from other modules as it goes
+void cemit_module(CEmitter *c, Module *mod, Buf *out) {
+    int32_t tt = TIMETRACE_BEGIN("emit c module", mod->path.len, mod->path.inner, 0, NULL);
+
+    c->mod = mod;
+    c->stamp++;
+    c->types.len = 0;
+    c->decls.len = 0;
+    c->body.len = 0;
+    c->uses_new = false;
+    c->uses_delete = false;
+    c->uses_musttail = false;
+
+    uint32_t i = 0;
+    while (i < c->externs.len) {
+        CEmitSym *sym = (CEmitSym *) vec_get_ptr(&c->syms, *(uint32_t *) vec_get_ptr(&c->externs, i));
+        sym->stamp = c->stamp;
+
+        cemit_signature(c, &c->decls, sym, NULL);
+        buf_push_str(&c->decls, ";\n");
+
+        i++;
+    }
+
+    int32_t j = 0;
+    while (j < mod_num_structs(mod)) {
+        CEmitSym *sym = cemit_lookup(c, mod->idx, &mod_get_struct_at(mod, j)->decl.name);
+
+        if (sym != NULL && (sym->flags & CEMIT_STRUCT)) {
+            cemit_require(c, sym);
+        }
+
+        j++;
+    }
+
+    j = 0;
+    while (j < mod_num_stmts(mod)) {
+        Stmt *s = mod_get_stmt_at(mod, j);
+
+        if (s != NULL && ast_is_let_stmt(s)) {
+            cemit_global(c, ast_as_let_stmt(s));
+        }
+
+        j++;
+    }
+
+    j = 0;
+    while (j < mod_num_functions(mod)) {
+        FuncDeclStmt *f_s = mod_get_function_at(mod, j);
+        CEmitSym *sym = cemit_lookup(c, mod->idx, &f_s->decl.name);
+
+        if (!f_s->decl.is_extern && f_s->block != NULL && sym != NULL && (sym->flags & CEMIT_FUNC)) {
+            cemit_require(c, sym);
+            cemit_func(c, f_s, sym);
+        }
+
+        j++;
+    }
+
+    if (c->uses_new && !c->has_malloc) {
+        buf_push_str(&c->decls, "void *malloc(size_t size);\n");
+    }
+
+    if (c->uses_delete && !c->has_free) {
+        buf_push_str(&c->decls, "void free(void *p);\n");
+    }
+
+    buf_push_str(out, "// generated by synthiumc from ");
+    buf_push(out, mod->path.inner, mod->path.len);
+    buf_push_str(out, "\n\n");
+    buf_push_str(out, cemit_prelude);
+
+    if (c->uses_musttail) {
+        buf_push_str(out, cemit_musttail_check);
+    }
+
+    if (c->uses_new) {
+        buf_push_str(out, "static void *synthium_new(size_t size, const void *value);\n");
+    }
+
+    buf_push_u8(out, '\n');
+    buf_push(out, c->types.data, c->types.len);
+    buf_push(out, c->decls.data, c->decls.len);
+    buf_push(out, c->body.data, c->body.len);
+
+    if (c->uses_new) {
+        buf_push_str(out, cemit_new_helper);
+    }
+
+    TIMETRACE_END(tt);
+}
+
+bool cemit_all(CEmitter *c, const char *dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+
+    Buf out = buf_create();
+    bool ok = true;
+    int32_t i = 0;
+
+    while (i < mod_num_mods(c->mods) && ok) {
+        out.len = 0;
+        cemit_module(c, mod_get_mod(c->mods, i), &out);
+
+        const char *path = fmt_str("%s/%s.c", dir, c->prefixes[i]);
+        FILE *f = fopen(path, "w");
+
+        ok = f != NULL && fwrite(out.data, 1, out.len, f) == out.len;
+
+        if (f != NULL) {
+            ok = fclose(f) == 0 && ok;
+        }
+
+        free((void *) path);
+
+        c->num_bytes += out.len;
+        c->num_files++;
+        i++;
+    }
+
+    buf_free(&out);
+
+    timer_stat_add("c files", c->num_files);
+    timer_stat_add("c bytes", c->num_bytes);
+
+    return ok;
+}
@@ -0,0 +1,2105 @@
+#include <string.h>
+
+#include "../include/timer.h"
+#include "../include/trace.h"
+#include "../include/codegen.h"
+#include "../include/timetrace.h"
+#include "../include/fastgen.h"
+
+Codegen codegen_create(IrModule *m, ElfWriter *elf, int32_t opt_level, Pool *pool) {
+    Codegen c;
+    memset((void *) &c, 0, sizeof(Codegen));
+
+    c.m = m;
+    c.elf = elf;
+    c.opt_level = opt_level;
+    c.pool = pool;
+    c.text = elf_section(elf, ELF_SEC_TEXT);
+    c.sec = ELF_SEC_TEXT;
+    c.hot_end = PLACE_NONE;
+    c.cold_start = PLACE_NONE;
+    c.ra = regalloc_create();
+    c.fixups = vec_create(sizeof(CgFixup));
+    c.moves = vec_create(sizeof(CgMove));
+    c.stubs = vec_create(sizeof(CgStub));
+    c.irc = irc_create();
+
+    return c;
+}
+
+void codegen_free(Codegen *c) {
+    regalloc_free(&c->ra);
+    vec_free(&c->fixups);
+    vec_free(&c->moves);
+    vec_free(&c->stubs);
+    irc_free(&c->irc);
+    place_free(&c->place);
+    free((void *) c->frame_offsets);
+    free((void *) c->block_offsets);
+    free((void *) c->block_secs);
+    free((void *) c->vec_regs);
+    free((void *) c->vec_last);
+    free((void *) c->vec_wide);
+    free((void *) c->vec_group);
+    free((void *) c->vec_group_regs);
+    free((void *) c->func_syms);
+    free((void *) c->global_syms);
+    free((void *) c->string_offsets);
+}
+
+int32_t codegen_reg_size(IrTypeId ty) {
+    return ty == IR_TYPE_PTR || ty == IR_TYPE_I64 ? 8 : 4;
+}
+
+int32_t codegen_mem_size(IrTypeId ty) {
+    switch (ty) {
+        case IR_TYPE_I1:
+        case IR_TYPE_I8:
+            return 1;
+        case IR_TYPE_I32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+bool codegen_is_imm(IrFunc *f, IrValue v) {
+    IrInst *inst = &f->insts[v];
+    return inst->op == IR_CONST && inst->imm >= INT32_MIN && inst->imm <= INT32_MAX;
+}
+
+// where v is at pos, split values move between registers and their stack slot
+CgOperand codegen_operand_at(Codegen *c, IrValue v, int32_t pos) {
+    Loc *loc = regalloc_loc_at(&c->ra, v, pos);
+    CgOperand op = { CG_VALUE, 0, 0, v };
+
+    if (loc->kind == LOC_REG) {
+        op.kind = CG_REG;
+        op.reg = loc->reg;
+    } else if (loc->kind == LOC_STACK) {
+        op.kind = CG_MEM;
+        op.offset = c->slot_base - 8 * loc->slot;
+    }
+
+    return op;
+}
+
+CgOperand codegen_operand(Codegen *c, IrValue v) {
+    return codegen_operand_at(c, v, c->pos);
+}
+
+int32_t codegen_frame_offset(Codegen *c, IrValue v) {
+    int32_t offset = 0;
+
+    while (c->f->insts[v].op == IR_OFFSET) {
+        offset += (int32_t) c->f->insts[v].imm;
+        v = c->f->insts[v].u.ops[0];
+    }
+
+    return offset + c->frame_offsets[v];
+}
+
+void codegen_reloc_rip(Codegen *c, uint32_t at, uint32_t type, uint32_t sym, int64_t addend) {
+    elf_add_reloc(c->elf, c->sec, at, type, sym, addend - 4);
+}
+
+void codegen_set_section(Codegen *c, ElfSectionId sec) {
+    c->sec = sec;
+    c->text = elf_section(c->elf, sec);
+}
+
+// computes a value that has no location of its own into dst
+void codegen_remat(Codegen *c, X64Reg dst, IrValue v) {
+    IrInst *inst = &c->f->insts[v];
+
+    switch (inst->op) {
+        case IR_CONST:
+            x64_mov_ri(c->text, codegen_reg_size(inst->ty), dst, inst->imm);
+            break;
+        case IR_STR:
+            codegen_reloc_rip(c, x64_lea_rip(c->text, dst), ELF_R_X86_64_PC32, elf_section_symbol(c->elf, ELF_SEC_RODATA), c->string_offsets[inst->imm]);
+            break;
+        case IR_GLOBAL:
+            codegen_reloc_rip(c, x64_lea_rip(c->text, dst), ELF_R_X86_64_PC32, c->global_syms[inst->imm], 0);
+            break;
+        case IR_FUNC_ADDR:
+            // functions from other objects may end up in a shared library, so their address comes from the GOT
+            if (ir_module_func(c->m, inst->imm)->flags & IR_FUNC_EXTERN) {
+                codegen_reloc_rip(c, x64_load_rip(c->text, dst), ELF_R_X86_64_GOTPCREL, c->func_syms[inst->imm], 0);
+            } else {
+                codegen_reloc_rip(c, x64_lea_rip(c->text, dst), ELF_R_X86_64_PC32, c->func_syms[inst->imm], 0);
+            }
+            break;
+        case IR_ALLOCA:
+        case IR_OFFSET:
+            x64_lea(c->text, dst, X64_RBP, codegen_frame_offset(c, v));
+            break;
+        default:
+            break;
+    }
+}
+
+// puts the value into dst, locations are copied and everything else is recomputed
+void codegen_load(Codegen *c, X64Reg dst, IrValue v) {
+    if (regalloc_is_remat(c->f, v)) {
+        codegen_remat(c, dst, v);
+        return;
+    }
+
+    CgOperand op = codegen_operand(c, v);
+
+    if (op.kind == CG_REG && op.reg != dst) {
+        x64_mov_rr(c->text, 8, dst, (X64Reg) op.reg);
+    } else if (op.kind == CG_MEM) {
+        x64_load(c->text, 8, dst, X64_RBP, op.offset);
+        c->num_reloads++;
+    }
+}
+
+void codegen_load_operand(Codegen *c, X64Reg dst, CgOperand *op) {
+    if (op->kind == CG_REG) {
+        if (op->reg != dst) {
+            x64_mov_rr(c->text, 8, dst, (X64Reg) op->reg);
+        }
+    } else if (op->kind == CG_MEM) {
+        x64_load(c->text, 8, dst, X64_RBP, op->offset);
+        c->num_reloads += op->value != IR_NO_VALUE;
+    } else {
+        codegen_load(c, dst, op->value);
+    }
+}
+
+// returns the register holding v, loading it into scratch when it does not live in one
+X64Reg codegen_use(Codegen *c, IrValue v, X64Reg scratch) {
+    Loc *loc = regalloc_loc_at(&c->ra, v, c->pos);
+
+    if (loc->kind == LOC_REG && !regalloc_is_remat(c->f, v)) {
+        return (X64Reg) loc->reg;
+    }
+
+    codegen_load(c, scratch, v);
+
+    return scratch;
+}
+
+// the register the result of v is computed in, spilled results go through rax
+X64Reg codegen_result_reg(Codegen *c, IrValue v) {
+    Loc *loc = regalloc_loc_at(&c->ra, v, c->pos);
+    return loc->kind == LOC_REG ? (X64Reg) loc->reg : X64_RAX;
+}
+
+bool codegen_in_reg(Codegen *c, IrValue v, X64Reg reg) {
+    Loc *loc = regalloc_loc_at(&c->ra, v, c->pos);
+    return loc->kind == LOC_REG && loc->reg == reg && !regalloc_is_remat(c->f, v);
+}
+
+// the stack slot of a value that is spilled for part of its life
+CgOperand codegen_slot(Codegen *c, IrValue v) {
+    CgOperand op = { CG_MEM, 0, c->slot_base - 8 * c->ra.spill_slot[v], v };
+    return op;
+}
+
+// a value that is split is stored to its slot right away, the value never changes so the slot stays valid
+// and moving it out of a register later costs nothing
+void codegen_def(Codegen *c, IrValue v, X64Reg reg) {
+    Loc *loc = regalloc_loc_at(&c->ra, v, c->pos);
+
+    if (loc->kind == LOC_REG && loc->reg != reg) {
+        x64_mov_rr(c->text, 8, (X64Reg) loc->reg, reg);
+    }
+
+    if (loc->kind == LOC_STACK || (loc->kind == LOC_REG && c->ra.spill_slot[v] >= 0)) {
+        x64_store(c->text, 8, X64_RBP, codegen_slot(c, v).offset, reg);
+        c->num_spills++;
+    }
+}
+
+// stack slots and fields of stack slots are addressed off rbp directly
+void codegen_addr(Codegen *c, IrValue ptr, X64Reg scratch, X64Reg *base, int32_t *disp) {
+    if (regalloc_is_frame_addr(c->f, ptr)) {
+        *base = X64_RBP;
+        *disp = codegen_frame_offset(c, ptr);
+    } else {
+        *base = codegen_use(c, ptr, scratch);
+        *disp = 0;
+    }
+}
+
+bool codegen_same(CgOperand *a, CgOperand *b) {
+    if (a->kind != b->kind || a->kind == CG_VALUE) {
+        return false;
+    }
+
+    return a->kind == CG_REG ? a->reg == b->reg : a->offset == b->offset;
+}
+
+void codegen_add_move(Codegen *c, CgOperand dst, CgOperand src) {
+    CgMove move = {
+        .dst = dst,
+        .src = src,
+        .done = codegen_same(&dst, &src)
+    };
+
+    vec_push(&c->moves, &move);
+}
+
+void codegen_move(Codegen *c, CgOperand *dst, CgOperand *src) {
+    if (dst->kind == CG_REG) {
+        codegen_load_operand(c, (X64Reg) dst->reg, src);
+        return;
+    }
+
+    c->num_spills += dst->value != IR_NO_VALUE;
+
+    if (src->kind == CG_REG) {
+        x64_store(c->text, 8, X64_RBP, dst->offset, (X64Reg) src->reg);
+    } else if (src->kind == CG_VALUE && codegen_is_imm(c->f, src->value)) {
+        x64_store_imm(c->text, 8, X64_RBP, dst->offset, (int32_t) c->f->insts[src->value].imm);
+    } else {
+        codegen_load_operand(c, X64_RAX, src);
+        x64_store(c->text, 8, X64_RBP, dst->offset, X64_RAX);
+    }
+}
+
+// sequentializes the pending moves, a move goes once nobody still reads its destination,
+// and a cycle is broken by parking one destination in r11
+void codegen_parallel_move(Codegen *c) {
+    CgMove *moves = (CgMove *) c->moves.elements;
+    int64_t n = c->moves.len;
+    int64_t remaining = 0;
+    int64_t i = 0;
+
+    while (i < n) {
+        remaining += moves[i].done ? 0 : 1;
+        i++;
+    }
+
+    while (remaining > 0) {
+        bool progress = false;
+        i = 0;
+
+        while (i < n) {
+            if (!moves[i].done) {
+                bool blocked = false;
+                int64_t j = 0;
+
+                while (j < n && !blocked) {
+                    blocked = j != i && !moves[j].done && codegen_same(&moves[j].src, &moves[i].dst);
+                    j++;
+                }
+
+                if (!blocked) {
+                    codegen_move(c, &moves[i].dst, &moves[i].src);
+                    moves[i].done = true;
+                    remaining--;
+                    progress = true;
+                }
+            }
+
+            i++;
+        }
+
+        if (!progress) {
+            i = 0;
+            while (moves[i].done) {
+                i++;
+            }
+
+            CgOperand parked = { CG_REG, X64_R11, 0, IR_NO_VALUE };
+            CgOperand dst = moves[i].dst;
+            codegen_load_operand(c, X64_R11, &dst);
+
+            int64_t j = 0;
+            while (j < n) {
+                if (!moves[j].done && codegen_same(&moves[j].src, &dst)) {
+                    moves[j].src = parked;
+                }
+
+                j++;
+            }
+        }
+    }
+
+    c->moves.len = 0;
+}
+
+void codegen_jump(Codegen *c, bool is_cond, X64Cond cc, IrBlockId target) {
+    CgFixup fixup = {
+        .at = is_cond ? x64_jcc(c->text, cc) : x64_jmp(c->text),
+        .target = target,
+        .sec = (uint8_t) c->sec
+    };
+
+    vec_push(&c->fixups, &fixup);
+}
+
+X64AluOp codegen_alu_op(IrOp op) {
+    switch (op) {
+        case IR_SUB: return X64_SUB;
+        case IR_AND: return X64_AND;
+        case IR_OR: return X64_OR;
+        case IR_XOR: return X64_XOR;
+        default: return X64_ADD;
+    }
+}
+
+// applies `dst = dst op rhs` with rhs as an immediate, register or stack slot when it can
+void codegen_alu_rhs(Codegen *c, IrOp op, int32_t size, X64Reg dst, IrValue rhs) {
+    IrFunc *f = c->f;
+    X64AluOp alu = ir_op_is_compare(op) ? X64_CMP : codegen_alu_op(op);
+
+    if (codegen_is_imm(f, rhs)) {
+        int32_t imm = (int32_t) f->insts[rhs].imm;
+
+        if (op == IR_MUL) {
+            x64_imul_rri(c->text, size, dst, dst, imm);
+        } else {
+            x64_alu_ri(c->text, alu, size, dst, imm);
+        }
+
+        return;
+    }
+
+    CgOperand operand = codegen_operand(c, rhs);
+
+    if (operand.kind == CG_MEM && op != IR_MUL && !regalloc_is_remat(f, rhs)) {
+        x64_alu_rm(c->text, alu, size, dst, X64_RBP, operand.offset);
+        c->num_reloads++;
+        return;
+    }
+
+    X64Reg r = codegen_use(c, rhs, X64_RCX);
+
+    if (op == IR_MUL) {
+        x64_imul_rr(c->text, size, dst, r);
+    } else {
+        x64_alu_rr(c->text, alu, size, dst, r);
+    }
+}
+
+void codegen_binary(Codegen *c, IrValue v, IrInst *inst) {
+    IrOp op = (IrOp) inst->op;
+    IrValue a = inst->u.ops[0];
+    IrValue b = inst->u.ops[1];
+    int32_t size = codegen_reg_size(inst->ty);
+    X64Reg d = codegen_result_reg(c, v);
+
+    if (op == IR_DIV || op == IR_MOD) {
+        codegen_load(c, X64_RAX, a);
+
+        X64Reg r = codegen_use(c, b, X64_RCX);
+        x64_sign_extend_ax(c->text, size);
+        x64_unary(c->text, X64_EXT_IDIV, size, r);
+        codegen_def(c, v, op == IR_DIV ? X64_RAX : X64_RDX);
+        return;
+    }
+
+    if (op == IR_SHL || op == IR_SHR) {
+        codegen_load(c, X64_RCX, b);
+        codegen_load(c, X64_RAX, a);
+        x64_shift_cl(c->text, op == IR_SHL ? X64_EXT_SHL : X64_EXT_SAR, size, X64_RAX);
+        codegen_def(c, v, X64_RAX);
+        return;
+    }
+
+    // the result register may hold the right operand, which must not be overwritten before it is read
+    if (a != b && codegen_in_reg(c, b, d)) {
+        if (op != IR_SUB) {
+            IrValue t = a;
+            a = b;
+            b = t;
+        } else {
+            d = X64_RAX;
+        }
+    }
+
+    codegen_load(c, d, a);
+    codegen_alu_rhs(c, op, size, d, b);
+    codegen_def(c, v, d);
+}
+
+X64Cond codegen_cond(IrOp op, bool is_unsigned) {
+    switch (op) {
+        case IR_EQ: return X64_CC_E;
+        case IR_NE: return X64_CC_NE;
+        case IR_LT: return is_unsigned ? X64_CC_B : X64_CC_L;
+        case IR_LE: return is_unsigned ? X64_CC_BE : X64_CC_LE;
+        case IR_GT: return is_unsigned ? X64_CC_A : X64_CC_G;
+        default: return is_unsigned ? X64_CC_AE : X64_CC_GE;
+    }
+}
+
+// pointers compare unsigned, integers signed
+X64Cond codegen_compare(Codegen *c, IrInst *inst) {
+    IrValue a = inst->u.ops[0];
+    IrTypeId ty = c->f->insts[a].ty;
+    X64Reg r = codegen_use(c, a, X64_RAX);
+
+    codegen_alu_rhs(c, (IrOp) inst->op, codegen_reg_size(ty), r, inst->u.ops[1]);
+
+    return codegen_cond((IrOp) inst->op, ty == IR_TYPE_PTR);
+}
+
+// converts s to the type of inst into d, narrow values are kept zero extended in their registers
+void codegen_convert(Codegen *c, IrInst *inst, IrTypeId from, X64Reg d, X64Reg s) {
+    switch (inst->op) {
+        case IR_SEXT:
+        case IR_INT_TO_PTR:
+            if (from == IR_TYPE_I32) {
+                x64_movsxd(c->text, d, s);
+            } else if (d != s) {
+                x64_mov_rr(c->text, 8, d, s);
+            }
+            break;
+        case IR_TRUNC:
+            x64_mov_rr(c->text, 4, d, s);
+
+            if (inst->ty == IR_TYPE_I1) {
+                x64_alu_ri(c->text, X64_AND, 4, d, 1);
+            } else if (inst->ty == IR_TYPE_I8) {
+                x64_movzx8(c->text, d, d);
+            }
+            break;
+        default:
+            // so widening them is a plain 32 bit move
+            if (codegen_reg_size(inst->ty) == 8 && codegen_reg_size(from) == 8) {
+                if (d != s) {
+                    x64_mov_rr(c->text, 8, d, s);
+                }
+            } else {
+                x64_mov_rr(c->text, 4, d, s);
+            }
+            break;
+    }
+}
+
+void codegen_cast(Codegen *c, IrValue v, IrInst *inst) {
+    IrTypeId from = c->f->insts[inst->u.ops[0]].ty;
+    X64Reg s = codegen_use(c, inst->u.ops[0], X64_RAX);
+    X64Reg d = codegen_result_reg(c, v);
+
+    codegen_convert(c, inst, from, d, s);
+    codegen_def(c, v, d);
+}
+
+void codegen_push_value(Codegen *c, IrValue v) {
+    CgOperand op = codegen_operand(c, v);
+
+    if (op.kind == CG_REG) {
+        x64_push(c->text, (X64Reg) op.reg);
+    } else if (op.kind == CG_MEM) {
+        x64_push_mem(c->text, X64_RBP, op.offset);
+        c->num_reloads++;
+    } else if (codegen_is_imm(c->f, v)) {
+        x64_push_imm(c->text, (int32_t) c->f->insts[v].imm);
+    } else {
+        codegen_load(c, X64_RAX, v);
+        x64_push(c->text, X64_RAX);
+    }
+}
+
+void codegen_call(Codegen *c, IrValue v, IrInst *inst) {
+    IrFunc *callee = ir_module_func(c->m, (uint32_t) inst->imm);
+    IrValue *ops = ir_inst_ops(c->f, inst);
+    uint32_t n = inst->num_ops;
+    int32_t stack_bytes = abi_stack_args_size(n);
+
+    if (stack_bytes > 0) {
+        if (((n - ABI_NUM_ARG_REGS) & 1) != 0) {
+            x64_alu_ri(c->text, X64_SUB, 8, X64_RSP, 8);
+        }
+
+        uint32_t i = n;
+        while (i > ABI_NUM_ARG_REGS) {
+            i--;
+            codegen_push_value(c, ops[i]);
+        }
+    }
+
+    uint32_t i = 0;
+    while (i < n && i < ABI_NUM_ARG_REGS) {
+        CgOperand dst = { CG_REG, abi_arg_regs[i], 0, IR_NO_VALUE };
+        codegen_add_move(c, dst, codegen_operand(c, ops[i]));
+        i++;
+    }
+
+    codegen_parallel_move(c);
+
+    // the tail call pass only marks calls whose arguments all go in registers
+    if ((inst->flags & IR_FLAG_TAIL) != 0) {
+        abi_emit_tail_call(c->text, c->elf, c->sec, &c->frame, c->func_syms[inst->imm]);
+        return;
+    }
+
+    abi_emit_call(c->text, c->elf, c->sec, c->func_syms[inst->imm], (callee->flags & IR_FUNC_VARARGS) != 0);
+    abi_emit_call_cleanup(c->text, stack_bytes);
+
+    if (inst->ty != IR_TYPE_VOID) {
+        codegen_def(c, v, X64_RAX);
+    }
+}
+
+// unrolled through rax, struct copies are small
+void codegen_copy_bytes(Codegen *c, X64Reg dst_base, int32_t dst_disp, X64Reg src_base, int32_t src_disp, int32_t size) {
+    int32_t off = 0;
+
+    while (off < size) {
+        int32_t chunk = size - off >= 8 ? 8 : (size - off >= 4 ? 4 : (size - off >= 2 ? 2 : 1));
+
+        x64_load(c->text, chunk, X64_RAX, src_base, src_disp + off);
+        x64_store(c->text, chunk, dst_base, dst_disp + off, X64_RAX);
+        off += chunk;
+    }
+}
+
+void codegen_memcpy(Codegen *c, IrInst *inst) {
+    X64Reg dst_base;
+    X64Reg src_base;
+    int32_t dst_disp = 0;
+    int32_t src_disp = 0;
+
+    codegen_addr(c, inst->u.ops[0], X64_RDX, &dst_base, &dst_disp);
+    codegen_addr(c, inst->u.ops[1], X64_RCX, &src_base, &src_disp);
+    codegen_copy_bytes(c, dst_base, dst_disp, src_base, src_disp, (int32_t) inst->imm);
+}
+
+// the moves on the edge from one block to another: the phi operands into the phis of the target, and the
+// values that are live into the target but were moved to another place on the way. moves into a stack slot
+// are left out, the slot was written when the value was defined. returns the number of moves that are needed
+int64_t codegen_edge_moves(Codegen *c, IrBlockId from, IrBlockId to) {
+    IrFunc *f = c->f;
+    RegAlloc *ra = &c->ra;
+    IrBlock *block = &f->blocks[to];
+    int32_t at = ra->block_end[from];
+    int32_t k = -1;
+    uint32_t i = 0;
+
+    while (i < block->num_insts && f->insts[block->insts[i]].op == IR_PHI) {
+        IrValue phi = block->insts[i];
+
+        if (ra->locs[phi].kind != LOC_NONE) {
+            k = k < 0 ? ir_pred_index(f, to, from) : k;
+
+            CgOperand src = codegen_operand_at(c, ir_inst_ops(f, &f->insts[phi])[k], at);
+            CgOperand dst = codegen_operand_at(c, phi, ra->block_start[to]);
+
+            codegen_add_move(c, dst, src);
+
+            if (dst.kind == CG_REG && ra->spill_slot[phi] >= 0) {
+                codegen_add_move(c, codegen_slot(c, phi), src);
+            }
+        }
+
+        i++;
+    }
+
+    uint64_t words = (ra->num_globals + 63) / 64;
+    uint64_t w = 0;
+
+    while (ra->num_splits > 0 && w < words) {
+        uint64_t in = ra->live_in[to * words + w];
+
+        while (in != 0) {
+            IrValue v = ra->global_vals[w * 64 + __builtin_ctzll(in)];
+
+            if (ra->first_seg[v] >= 0 && ra->segments[ra->first_seg[v]].next >= 0) {
+                CgOperand dst = codegen_operand_at(c, v, ra->block_start[to]);
+
+                if (dst.kind == CG_REG) {
+                    codegen_add_move(c, dst, codegen_operand_at(c, v, at));
+                }
+            }
+
+            in &= in - 1;
+        }
+
+        w++;
+    }
+
+    int64_t needed = 0;
+    int64_t m = 0;
+
+    while (m < c->moves.len) {
+        needed += ((CgMove *) vec_get_ptr(&c->moves, m))->done ? 0 : 1;
+        m++;
+    }
+
+    return needed;
+}
+
+// a conditional branch along an edge that needs moves goes to a stub after the function, which moves and
+// jumps on to the target
+void codegen_jump_edge(Codegen *c, X64Cond cc, IrBlockId from, IrBlockId to) {
+    if (codegen_edge_moves(c, from, to) == 0) {
+        c->moves.len = 0;
+        codegen_jump(c, true, cc, to);
+        return;
+    }
+
+    c->moves.len = 0;
+
+    CgStub stub = {
+        .from = from,
+        .to = to
+    };
+
+    vec_push(&c->stubs, &stub);
+    codegen_jump(c, true, cc, c->f->num_blocks + (IrBlockId) (c->stubs.len - 1));
+}
+
+// the values whose next segment starts in the gap before pos move there, the moves run in parallel
+void codegen_split_moves(Codegen *c, int32_t pos) {
+    RegAlloc *ra = &c->ra;
+
+    while (c->next_split < ra->num_splits && ra->splits[c->next_split].pos < pos) {
+        c->next_split++;
+    }
+
+    while (c->next_split < ra->num_splits && ra->splits[c->next_split].pos == pos) {
+        IrValue v = ra->splits[c->next_split].v;
+        CgOperand dst = codegen_operand_at(c, v, pos);
+
+        if (dst.kind == CG_REG) {
+            codegen_add_move(c, dst, codegen_operand_at(c, v, pos - 1));
+        }
+
+        c->next_split++;
+    }
+
+    codegen_parallel_move(c);
+}
+
+void codegen_branch(Codegen *c, IrBlockId b, IrInst *inst) {
+    IrFunc *f = c->f;
+    IrValue cond = inst->u.ops[0];
+    IrBlockId then_block = inst->u.ops[1];
+    IrBlockId else_block = inst->u.ops[2];
+    X64Cond cc = X64_CC_NE;
+
+    if (c->ra.fused[cond]) {
+        cc = codegen_compare(c, &f->insts[cond]);
+    } else {
+        X64Reg r = codegen_use(c, cond, X64_RAX);
+        x64_test_rr(c->text, 4, r, r);
+    }
+
+    // the edge that is not taken by the jcc moves its values right after it
+    if (then_block == c->next_block) {
+        codegen_jump_edge(c, x64_cond_negate(cc), b, else_block);
+        codegen_edge_moves(c, b, then_block);
+        codegen_parallel_move(c);
+    } else {
+        codegen_jump_edge(c, cc, b, then_block);
+        codegen_edge_moves(c, b, else_block);
+        codegen_parallel_move(c);
+
+        if (else_block != c->next_block) {
+            codegen_jump(c, false, cc, else_block);
+        }
+    }
+}
+
+int32_t codegen_vec_width(IrFunc *f, IrValue v) {
+    return f->insts[v].ty == IR_TYPE_V8I32 ? 32 : 16;
+}
+
+// the register of a phi can hold its operands too when nothing reads the phi after they are computed: every use
+// of the phi is in its own block, and before the operands computed there. an operand may also come through the
+// empty block splitting the edge it flows along
+bool codegen_vec_can_share(Codegen *c, IrValue phi) {
+    IrFunc *f = c->f;
+    IrInst *inst = &f->insts[phi];
+    IrValue *ops = ir_inst_ops(f, inst);
+    IrBlock *phi_block = &f->blocks[inst->block];
+    uint32_t k = 0;
+
+    while (k < inst->num_ops) {
+        IrInst *def = &f->insts[ops[k]];
+        IrBlock *pred = &f->blocks[phi_block->preds[k]];
+        bool from_pred = def->block == phi_block->preds[k] || (pred->num_insts == 1 && pred->num_preds == 1 && pred->preds[0] == def->block);
+
+        if (def->op == IR_PHI || !from_pred || c->vec_regs[ops[k]] != CG_NO_VEC_REG) {
+            return false;
+        }
+
+        k++;
+    }
+
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        bool after_op = false;
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *user = &f->insts[block->insts[i]];
+            IrValue *uops = ir_inst_ops(f, user);
+            uint32_t n = ir_inst_num_values(user);
+            uint32_t j = 0;
+
+            while (j < n && block->insts[i] != phi) {
+                if (uops[j] == phi && (b != inst->block || after_op || user->op == IR_PHI)) {
+                    return false;
+                }
+
+                j++;
+            }
+
+            k = 0;
+            while (k < inst->num_ops) {
+                after_op = after_op || ops[k] == block->insts[i];
+                k++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    return true;
+}
+
+uint32_t codegen_vec_group(Codegen *c, IrBlockId b) {
+    while (c->vec_group[b] != b) {
+        c->vec_group[b] = c->vec_group[c->vec_group[b]];
+        b = c->vec_group[b];
+    }
+
+    return b;
+}
+
+void codegen_vec_join(Codegen *c, IrBlockId a, IrBlockId b) {
+    c->vec_group[codegen_vec_group(c, a)] = codegen_vec_group(c, b);
+}
+
+// the next register held across blocks, counting down from the top so the ones handed out per block start at 0
+void codegen_vec_pin(Codegen *c, IrValue v) {
+    uint32_t g = codegen_vec_group(c, c->f->insts[v].block);
+    uint32_t r = CG_NUM_VEC_REGS - 1 - (uint32_t) __builtin_popcount(c->vec_group_regs[g]);
+
+    c->vec_regs[v] = (uint8_t) r;
+    c->vec_group_regs[g] |= 1u << r;
+}
+
+// vector values never meet the register allocator. the vectoriser makes them in a few blocks of straight code,
+// so they get xmm registers here: a vector phi and the vectors used outside of their own block keep one register
+// for as long as their group runs, and the rest are handed out block by block
+void codegen_vec_prepare(Codegen *c) {
+    IrFunc *f = c->f;
+
+    if (f->num_insts > c->cap_vec) {
+        c->cap_vec = f->num_insts * 2;
+        c->vec_regs = (uint8_t *) realloc((void *) c->vec_regs, c->cap_vec * sizeof(uint8_t));
+        c->vec_last = (int32_t *) realloc((void *) c->vec_last, c->cap_vec * sizeof(int32_t));
+    }
+
+    if (f->num_blocks > c->cap_vec_blocks) {
+        c->cap_vec_blocks = f->num_blocks * 2;
+        c->vec_wide = (uint8_t *) realloc((void *) c->vec_wide, c->cap_vec_blocks * sizeof(uint8_t));
+        c->vec_group = (uint32_t *) realloc((void *) c->vec_group, c->cap_vec_blocks * sizeof(uint32_t));
+        c->vec_group_regs = (uint32_t *) realloc((void *) c->vec_group_regs, c->cap_vec_blocks * sizeof(uint32_t));
+    }
+
+    c->has_vec = false;
+    memset((void *) c->vec_regs, CG_NO_VEC_REG, f->num_insts * sizeof(uint8_t));
+    memset((void *) c->vec_wide, 0, f->num_blocks * sizeof(uint8_t));
+    memset((void *) c->vec_group_regs, 0, f->num_blocks * sizeof(uint32_t));
+
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        c->vec_group[b] = b;
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t k = 0;
+
+            c->vec_wide[b] |= inst->ty == IR_TYPE_V8I32;
+            c->has_vec = c->has_vec || ir_type_is_vector(inst->ty);
+
+            while (k < n) {
+                if (ir_type_is_vector(f->insts[ops[k]].ty)) {
+                    c->vec_wide[b] |= f->insts[ops[k]].ty == IR_TYPE_V8I32;
+                    codegen_vec_join(c, b, f->insts[ops[k]].block);
+                }
+
+                k++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (c->has_vec && b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts && f->insts[block->insts[i]].op == IR_PHI) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t k = 0;
+
+            if (ir_type_is_vector(inst->ty)) {
+                bool share = codegen_vec_can_share(c, v);
+                codegen_vec_pin(c, v);
+
+                while (k < inst->num_ops) {
+                    if (share) {
+                        c->vec_regs[ops[k]] = c->vec_regs[v];
+                    } else if (c->vec_regs[ops[k]] == CG_NO_VEC_REG) {
+                        codegen_vec_pin(c, ops[k]);
+                    }
+
+                    k++;
+                }
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (c->has_vec && b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t k = 0;
+
+            while (inst->op != IR_PHI && k < n) {
+                IrValue o = ops[k];
+
+                if (ir_type_is_vector(f->insts[o].ty) && f->insts[o].block != b && c->vec_regs[o] == CG_NO_VEC_REG) {
+                    codegen_vec_pin(c, o);
+                }
+
+                k++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    // the empty blocks on split edges between two blocks with 32 byte vectors keep the upper halves too
+    b = 0;
+    while (c->has_vec && b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+
+        if (block->num_insts == 1 && block->num_succs == 1 && (c->vec_wide[block->succs[0]] & 1)) {
+            c->vec_wide[b] |= 2;
+        }
+
+        b++;
+    }
+}
+
+// the vectors of the block that do not keep a register of their own are freed at the position of their last use
+void codegen_vec_block(Codegen *c, IrBlockId b) {
+    IrFunc *f = c->f;
+    IrBlock *block = &f->blocks[b];
+    uint32_t i = 0;
+
+    c->vec_pinned = c->vec_group_regs[codegen_vec_group(c, b)];
+    c->vec_free = ((1u << CG_NUM_VEC_REGS) - 1) & ~c->vec_pinned;
+
+    while (i < block->num_insts) {
+        IrValue v = block->insts[i];
+        IrInst *inst = &f->insts[v];
+        IrValue *ops = ir_inst_ops(f, inst);
+        uint32_t n = ir_inst_num_values(inst);
+        uint32_t k = 0;
+
+        c->vec_last[v] = -1;
+
+        while (k < n) {
+            if (ir_type_is_vector(f->insts[ops[k]].ty)) {
+                c->vec_last[ops[k]] = c->ra.pos[v];
+            }
+
+            k++;
+        }
+
+        i++;
+    }
+}
+
+X64Reg codegen_vec_reg(Codegen *c, IrValue v) {
+    return (X64Reg) c->vec_regs[v];
+}
+
+// frees the operands that die here before the result takes a register, so the result may share one with them
+X64Reg codegen_vec_def(Codegen *c, IrValue v) {
+    IrFunc *f = c->f;
+    IrInst *inst = &f->insts[v];
+    IrValue *ops = ir_inst_ops(f, inst);
+    uint32_t n = ir_inst_num_values(inst);
+    uint32_t k = 0;
+
+    while (k < n) {
+        IrValue o = ops[k];
+
+        if (ir_type_is_vector(f->insts[o].ty) && c->vec_last[o] == c->pos && !(c->vec_pinned & (1u << c->vec_regs[o]))) {
+            c->vec_free |= 1u << c->vec_regs[o];
+        }
+
+        k++;
+    }
+
+    if (!ir_type_is_vector(inst->ty)) {
+        return X64_RAX;
+    }
+
+    if (c->vec_regs[v] == CG_NO_VEC_REG) {
+        uint32_t r = (uint32_t) __builtin_ctz(c->vec_free);
+
+        c->vec_regs[v] = (uint8_t) r;
+        c->vec_free &= ~(1u << r);
+    }
+
+    return codegen_vec_reg(c, v);
+}
+
+// a result nobody reads gives its register back right away
+void codegen_vec_done(Codegen *c, IrValue v) {
+    if (c->vec_last[v] < 0 && !(c->vec_pinned & (1u << c->vec_regs[v]))) {
+        c->vec_free |= 1u << c->vec_regs[v];
+    }
+}
+
+// `d = a op b` in the two operand SSE2 form, which overwrites its first operand
+void codegen_vec_sse(Codegen *c, X64VecOp op, bool commutative, X64Reg d, X64Reg a, X64Reg b) {
+    if (d == a) {
+        x64_vec_rr(c->text, op, 16, d, d, b);
+    } else if (d == b && commutative) {
+        x64_vec_rr(c->text, op, 16, d, d, a);
+    } else if (d == b) {
+        x64_vec_mov(c->text, 16, CG_VEC_SCRATCH1, b);
+        x64_vec_mov(c->text, 16, d, a);
+        x64_vec_rr(c->text, op, 16, d, d, CG_VEC_SCRATCH1);
+    } else {
+        x64_vec_mov(c->text, 16, d, a);
+        x64_vec_rr(c->text, op, 16, d, d, b);
+    }
+}
+
+void codegen_vec_op(Codegen *c, X64VecOp op, bool commutative, int32_t width, X64Reg d, X64Reg a, X64Reg b) {
+    if (width == 32) {
+        x64_vec_rr(c->text, op, 32, d, a, b);
+    } else {
+        codegen_vec_sse(c, op, commutative, d, a, b);
+    }
+}
+
+// SSE2 has no 32 bit multiply that keeps the low halves, so the even and the odd lanes are multiplied into 64
+// bit products separately and their low halves put back together
+void codegen_vec_mul_sse(Codegen *c, X64Reg d, X64Reg a, X64Reg b) {
+    x64_pshufd(c->text, false, CG_VEC_SCRATCH1, a, 0xf5);
+    x64_pshufd(c->text, false, CG_VEC_SCRATCH0, b, 0xf5);
+    x64_vec_rr(c->text, X64_PMULUDQ, 16, CG_VEC_SCRATCH1, CG_VEC_SCRATCH1, CG_VEC_SCRATCH0);
+    x64_vec_mov(c->text, 16, CG_VEC_SCRATCH0, a);
+    x64_vec_rr(c->text, X64_PMULUDQ, 16, CG_VEC_SCRATCH0, CG_VEC_SCRATCH0, b);
+    x64_pshufd(c->text, false, CG_VEC_SCRATCH0, CG_VEC_SCRATCH0, 0x08);
+    x64_pshufd(c->text, false, CG_VEC_SCRATCH1, CG_VEC_SCRATCH1, 0x08);
+    x64_vec_rr(c->text, X64_PUNPCKLDQ, 16, CG_VEC_SCRATCH0, CG_VEC_SCRATCH0, CG_VEC_SCRATCH1);
+    x64_vec_mov(c->text, 16, d, CG_VEC_SCRATCH0);
+}
+
+// there are only equal and greater than, the other comparisons swap their operands or invert one of those
+void codegen_vec_compare(Codegen *c, IrOp op, int32_t width, X64Reg d, X64Reg a, X64Reg b) {
+    if (op == IR_EQ || op == IR_NE) {
+        codegen_vec_op(c, X64_PCMPEQD, true, width, d, a, b);
+    } else if (op == IR_GT || op == IR_LE) {
+        codegen_vec_op(c, X64_PCMPGTD, false, width, d, a, b);
+    } else {
+        codegen_vec_op(c, X64_PCMPGTD, false, width, d, b, a);
+    }
+
+    if (op == IR_NE || op == IR_LE || op == IR_GE) {
+        x64_vec_rr(c->text, X64_PCMPEQD, width, CG_VEC_SCRATCH1, CG_VEC_SCRATCH1, CG_VEC_SCRATCH1);
+        x64_vec_rr(c->text, X64_PXOR, width, d, d, CG_VEC_SCRATCH1);
+    }
+}
+
+X64VecOp codegen_vec_alu_op(IrOp op) {
+    switch (op) {
+        case IR_SUB: return X64_PSUBD;
+        case IR_AND: return X64_PAND;
+        case IR_OR: return X64_POR;
+        case IR_XOR: return X64_PXOR;
+        default: return X64_PADDD;
+    }
+}
+
+void codegen_vec_inst(Codegen *c, IrValue v, IrInst *inst) {
+    IrFunc *f = c->f;
+    IrValue *ops = inst->u.ops;
+    IrOp op = (IrOp) inst->op;
+    int32_t width = codegen_vec_width(f, op == IR_STORE || op == IR_EXTRACT ? ops[op == IR_STORE] : v);
+    X64Reg d = codegen_vec_def(c, v);
+
+    switch (op) {
+        case IR_LOAD:
+        case IR_STORE: {
+            X64Reg base;
+            int32_t disp = 0;
+
+            codegen_addr(c, ops[0], X64_RAX, &base, &disp);
+
+            if (op == IR_LOAD) {
+                x64_vec_load(c->text, width, d, base, disp);
+            } else {
+                x64_vec_store(c->text, width, base, disp, codegen_vec_reg(c, ops[1]));
+            }
+            break;
+        }
+        case IR_SPLAT: {
+            X64Reg r = codegen_use(c, ops[0], X64_RAX);
+
+            x64_movd_to_vec(c->text, width == 32, d, r);
+
+            if (width == 32) {
+                x64_vpbroadcastd(c->text, d, d);
+            } else {
+                x64_pshufd(c->text, false, d, d, 0);
+            }
+            break;
+        }
+        case IR_EXTRACT: {
+            X64Reg src = codegen_vec_reg(c, ops[0]);
+            int64_t lane = inst->imm;
+
+            if (lane >= 4) {
+                x64_vextracti128(c->text, CG_VEC_SCRATCH1, src, 1);
+                src = CG_VEC_SCRATCH1;
+                lane -= 4;
+            }
+
+            if (lane != 0) {
+                x64_pshufd(c->text, width == 32, CG_VEC_SCRATCH1, src, (uint8_t) lane);
+                src = CG_VEC_SCRATCH1;
+            }
+
+            X64Reg r = codegen_result_reg(c, v);
+            x64_movd_from_vec(c->text, width == 32, r, src);
+            codegen_def(c, v, r);
+            break;
+        }
+        case IR_SELECT: {
+            X64Reg m = codegen_vec_reg(c, ops[0]);
+            X64Reg a = codegen_vec_reg(c, ops[1]);
+            X64Reg b = codegen_vec_reg(c, ops[2]);
+
+            if (width == 32) {
+                x64_vec_rr(c->text, X64_PAND, 32, CG_VEC_SCRATCH0, m, a);
+                x64_vec_rr(c->text, X64_PANDN, 32, CG_VEC_SCRATCH1, m, b);
+                x64_vec_rr(c->text, X64_POR, 32, d, CG_VEC_SCRATCH0, CG_VEC_SCRATCH1);
+            } else {
+                x64_vec_mov(c->text, 16, CG_VEC_SCRATCH0, m);
+                x64_vec_rr(c->text, X64_PAND, 16, CG_VEC_SCRATCH0, CG_VEC_SCRATCH0, a);
+                x64_vec_mov(c->text, 16, CG_VEC_SCRATCH1, m);
+                x64_vec_rr(c->text, X64_PANDN, 16, CG_VEC_SCRATCH1, CG_VEC_SCRATCH1, b);
+                x64_vec_rr(c->text, X64_POR, 16, CG_VEC_SCRATCH0, CG_VEC_SCRATCH0, CG_VEC_SCRATCH1);
+                x64_vec_mov(c->text, 16, d, CG_VEC_SCRATCH0);
+            }
+            break;
+        }
+        case IR_MUL:
+            if (width == 32) {
+                x64_vec_rr(c->text, X64_PMULLD, 32, d, codegen_vec_reg(c, ops[0]), codegen_vec_reg(c, ops[1]));
+            } else {
+                codegen_vec_mul_sse(c, d, codegen_vec_reg(c, ops[0]), codegen_vec_reg(c, ops[1]));
+            }
+            break;
+        default:
+            if (ir_op_is_compare(op)) {
+                codegen_vec_compare(c, op, width, d, codegen_vec_reg(c, ops[0]), codegen_vec_reg(c, ops[1]));
+            } else {
+                codegen_vec_op(c, codegen_vec_alu_op(op), op != IR_SUB, width, d, codegen_vec_reg(c, ops[0]), codegen_vec_reg(c, ops[1]));
+            }
+            break;
+    }
+
+    if (ir_type_is_vector(inst->ty)) {
+        codegen_vec_done(c, v);
+    }
+}
+
+// the operands of vector phis that do not share the phi's register are moved into it at the end of the
+// predecessor, which only has the one successor once critical edges are split
+void codegen_vec_phi_moves(Codegen *c, IrBlockId b) {
+    IrFunc *f = c->f;
+    IrBlock *block = &f->blocks[b];
+
+    if (block->num_succs != 1) {
+        return;
+    }
+
+    IrBlock *succ = &f->blocks[block->succs[0]];
+    int32_t k = ir_pred_index(f, block->succs[0], b);
+    uint32_t i = 0;
+
+    while (i < succ->num_insts && f->insts[succ->insts[i]].op == IR_PHI) {
+        IrValue phi = succ->insts[i];
+        IrValue o = ir_inst_ops(f, &f->insts[phi])[k];
+
+        if (ir_type_is_vector(f->insts[phi].ty) && c->vec_regs[o] != c->vec_regs[phi]) {
+            x64_vec_mov(c->text, codegen_vec_width(f, phi), codegen_vec_reg(c, phi), codegen_vec_reg(c, o));
+        }
+
+        i++;
+    }
+}
+
+// the upper halves of the ymm registers are cleared where the code leaves the blocks that use them, so later SSE
+// code in the C library does not pay for merging them. only blocks the AVX2 path reaches alone may do that
+bool codegen_vec_leaves_wide(Codegen *c, IrBlockId b) {
+    IrBlock *block = &c->f->blocks[b];
+    uint32_t i = 0;
+
+    if (c->vec_wide[b] == 0) {
+        return false;
+    }
+
+    while (i < block->num_succs) {
+        if (c->vec_wide[block->succs[i]] != 0) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return block->num_succs > 0;
+}
+
+bool codegen_vec_enters_narrow(Codegen *c, IrBlockId b) {
+    IrBlock *block = &c->f->blocks[b];
+    uint32_t i = 0;
+
+    if (c->vec_wide[b] != 0) {
+        return false;
+    }
+
+    while (i < block->num_preds) {
+        if (c->vec_wide[block->preds[i]] == 0) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return block->num_preds > 0;
+}
+
+// the features the CPU has are asked for once and kept in a word: bit 0 says it was filled in, bit IR_CPU_AVX2
+// whether AVX2 is there and enabled by the OS. the function filling it in keeps every register but rax
+void codegen_emit_cpu_init(Codegen *c) {
+    Buf *t = c->text;
+    uint32_t no[4];
+
+    buf_align(t, 16);
+    uint32_t start = t->len;
+
+    x64_push(t, X64_RBX);
+    x64_push(t, X64_RCX);
+    x64_push(t, X64_RDX);
+
+    x64_mov_ri(t, 4, X64_RAX, 0);
+    x64_cpuid(t);
+    x64_alu_ri(t, X64_CMP, 4, X64_RAX, 7);
+    no[0] = x64_jcc(t, X64_CC_B);
+
+    // AVX needs the OS to save the ymm registers, which it says through OSXSAVE and XCR0
+    x64_mov_ri(t, 4, X64_RAX, 1);
+    x64_cpuid(t);
+    x64_alu_ri(t, X64_AND, 4, X64_RCX, 0x18000000);
+    x64_alu_ri(t, X64_CMP, 4, X64_RCX, 0x18000000);
+    no[1] = x64_jcc(t, X64_CC_NE);
+
+    x64_mov_ri(t, 4, X64_RCX, 0);
+    x64_xgetbv(t);
+    x64_alu_ri(t, X64_AND, 4, X64_RAX, 6);
+    x64_alu_ri(t, X64_CMP, 4, X64_RAX, 6);
+    no[2] = x64_jcc(t, X64_CC_NE);
+
+    x64_mov_ri(t, 4, X64_RAX, 7);
+    x64_mov_ri(t, 4, X64_RCX, 0);
+    x64_cpuid(t);
+    x64_shift_ri(t, X64_EXT_SHR, 4, X64_RBX, 5);
+    x64_alu_ri(t, X64_AND, 4, X64_RBX, 1);
+    x64_shift_ri(t, X64_EXT_SHL, 4, X64_RBX, IR_CPU_AVX2);
+    x64_alu_ri(t, X64_OR, 4, X64_RBX, 1);
+    x64_mov_rr(t, 4, X64_RAX, X64_RBX);
+    no[3] = x64_jmp(t);
+
+    uint32_t none = t->len;
+    x64_mov_ri(t, 4, X64_RAX, 1);
+
+    uint32_t done = t->len;
+    codegen_reloc_rip(c, x64_lea_rip(t, X64_RCX), ELF_R_X86_64_PC32, c->cpu_features_sym, 0);
+    x64_store(t, 8, X64_RCX, 0, X64_RAX);
+    x64_pop(t, X64_RDX);
+    x64_pop(t, X64_RCX);
+    x64_pop(t, X64_RBX);
+    x64_ret(t);
+
+    x64_patch_rel32(t, no[0], none);
+    x64_patch_rel32(t, no[1], none);
+    x64_patch_rel32(t, no[2], none);
+    x64_patch_rel32(t, no[3], done);
+
+    elf_define_symbol(c->elf, c->cpu_init_sym, ELF_SEC_TEXT, start, t->len - start);
+}
+
+// whether any function asks what the CPU supports
+bool codegen_uses_cpu_features(IrModule *m) {
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t i = 0;
+
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+        IrBlockId b = 0;
+
+        while (b < f->num_blocks) {
+            IrBlock *block = &f->blocks[b];
+            uint32_t j = 0;
+
+            while (j < block->num_insts) {
+                if (f->insts[block->insts[j]].op == IR_CPU_FEATURE) {
+                    return true;
+                }
+
+                j++;
+            }
+
+            b++;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// whether any function has counts from a profile
+bool codegen_is_profiled(IrModule *m) {
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t i = 0;
+
+    while (i < num_funcs) {
+        if ((ir_module_func(m, i)->flags & IR_FUNC_PROFILED) != 0) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// the word and the function filling it in are declared before the functions are generated, which all share them
+void codegen_declare_cpu_features(Codegen *c) {
+    Buf *data = elf_section(c->elf, ELF_SEC_DATA);
+
+    buf_align(data, 8);
+    c->cpu_features_sym = elf_symbol(c->elf, "synthium_cpu_features", 21, ELF_STB_LOCAL, ELF_STT_OBJECT);
+    elf_define_symbol(c->elf, c->cpu_features_sym, ELF_SEC_DATA, data->len, 8);
+    buf_push_u64(data, 0);
+    c->cpu_init_sym = elf_symbol(c->elf, "synthium_cpu_init", 17, ELF_STB_LOCAL, ELF_STT_FUNC);
+    c->uses_cpu_features = true;
+}
+
+// a load of the cached word, and the call filling it in the first time
+void codegen_cpu_feature(Codegen *c, IrValue v, IrInst *inst) {
+    Buf *t = c->text;
+
+    codegen_reloc_rip(c, x64_load_rip(t, X64_RAX), ELF_R_X86_64_PC32, c->cpu_features_sym, 0);
+    x64_test_rr(t, 4, X64_RAX, X64_RAX);
+
+    uint32_t known = x64_jcc(t, X64_CC_NE);
+    elf_add_reloc(c->elf, c->sec, x64_call(t), ELF_R_X86_64_PLT32, c->cpu_init_sym, -4);
+    x64_patch_rel32(t, known, t->len);
+
+    x64_shift_ri(t, X64_EXT_SHR, 4, X64_RAX, (uint8_t) inst->imm);
+    x64_alu_ri(t, X64_AND, 4, X64_RAX, 1);
+    codegen_def(c, v, X64_RAX);
+}
+
+void codegen_inst(Codegen *c, IrBlockId b, IrValue v) {
+    IrFunc *f = c->f;
+    IrInst *inst = &f->insts[v];
+
+    c->num_insts++;
+
+    if (c->has_vec && inst->op != IR_PHI && inst->op != IR_CPU_FEATURE && !ir_op_is_terminator((IrOp) inst->op)) {
+        IrTypeId ty = inst->op == IR_STORE || inst->op == IR_EXTRACT ? f->insts[inst->u.ops[inst->op == IR_STORE]].ty : inst->ty;
+
+        if (ir_type_is_vector(ty)) {
+            codegen_vec_inst(c, v, inst);
+            return;
+        }
+    }
+
+    switch (inst->op) {
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_AND:
+        case IR_OR:
+        case IR_XOR:
+        case IR_SHL:
+        case IR_SHR:
+            codegen_binary(c, v, inst);
+            break;
+        case IR_NEG:
+        case IR_NOT: {
+            X64Reg d = codegen_result_reg(c, v);
+
+            codegen_load(c, d, inst->u.ops[0]);
+            x64_unary(c->text, inst->op == IR_NEG ? X64_EXT_NEG : X64_EXT_NOT, codegen_reg_size(inst->ty), d);
+            codegen_def(c, v, d);
+            break;
+        }
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE:
+            if (!c->ra.fused[v]) {
+                X64Cond cc = codegen_compare(c, inst);
+
+                x64_setcc(c->text, cc, X64_RAX);
+                x64_movzx8(c->text, X64_RAX, X64_RAX);
+                codegen_def(c, v, X64_RAX);
+            }
+            break;
+        case IR_SEXT:
+        case IR_ZEXT:
+        case IR_TRUNC:
+        case IR_PTR_TO_INT:
+        case IR_INT_TO_PTR:
+            codegen_cast(c, v, inst);
+            break;
+        case IR_SELECT: {
+            // mov does not touch the flags, so the chosen value can be loaded after the test
+            X64Reg cond = codegen_use(c, inst->u.ops[0], X64_RCX);
+            codegen_load(c, X64_RAX, inst->u.ops[2]);
+            x64_test_rr(c->text, 4, cond, cond);
+            x64_cmov(c->text, X64_CC_NE, 8, X64_RAX, codegen_use(c, inst->u.ops[1], X64_RDX));
+            codegen_def(c, v, X64_RAX);
+            break;
+        }
+        case IR_COPY: {
+            X64Reg d = codegen_result_reg(c, v);
+
+            codegen_load(c, d, inst->u.ops[0]);
+            codegen_def(c, v, d);
+            break;
+        }
+        case IR_LOAD: {
+            X64Reg base;
+            int32_t disp = 0;
+            X64Reg d = codegen_result_reg(c, v);
+
+            codegen_addr(c, inst->u.ops[0], X64_RAX, &base, &disp);
+            x64_load(c->text, codegen_mem_size(inst->ty), d, base, disp);
+            codegen_def(c, v, d);
+            break;
+        }
+        case IR_STORE: {
+            X64Reg base;
+            int32_t disp = 0;
+            IrValue value = inst->u.ops[1];
+            int32_t size = codegen_mem_size(f->insts[value].ty);
+
+            codegen_addr(c, inst->u.ops[0], X64_RAX, &base, &disp);
+
+            if (codegen_is_imm(f, value)) {
+                x64_store_imm(c->text, size, base, disp, (int32_t) f->insts[value].imm);
+            } else {
+                x64_store(c->text, size, base, disp, codegen_use(c, value, X64_RCX));
+            }
+            break;
+        }
+        case IR_OFFSET:
+            if (!regalloc_is_remat(f, v)) {
+                X64Reg d = codegen_result_reg(c, v);
+
+                x64_lea(c->text, d, codegen_use(c, inst->u.ops[0], X64_RAX), (int32_t) inst->imm);
+                codegen_def(c, v, d);
+            }
+            break;
+        case IR_MEMCPY:
+            codegen_memcpy(c, inst);
+            break;
+        case IR_NEW:
+            x64_mov_ri(c->text, 4, X64_RDI, inst->imm);
+            abi_emit_call(c->text, c->elf, c->sec, c->malloc_sym, false);
+            codegen_def(c, v, X64_RAX);
+            break;
+        case IR_DELETE:
+            codegen_load(c, X64_RDI, inst->u.ops[0]);
+            abi_emit_call(c->text, c->elf, c->sec, c->free_sym, false);
+            break;
+        case IR_CALL:
+            codegen_call(c, v, inst);
+            break;
+        case IR_CPU_FEATURE:
+            codegen_cpu_feature(c, v, inst);
+            break;
+        case IR_BR:
+            codegen_edge_moves(c, b, inst->u.ops[0]);
+            codegen_parallel_move(c);
+
+            if (inst->u.ops[0] != c->next_block) {
+                codegen_jump(c, false, X64_CC_O, inst->u.ops[0]);
+            }
+            break;
+        case IR_CBR:
+            codegen_branch(c, b, inst);
+            break;
+        case IR_RET:
+            if (inst->num_ops > 0) {
+                codegen_load(c, X64_RAX, inst->u.ops[0]);
+            }
+
+            abi_emit_epilogue(c->text, &c->frame);
+            break;
+        case IR_UNREACHABLE:
+            x64_ud2(c->text);
+            break;
+        default:
+            // constants, addresses, parameters and phis have no code of their own
+            c->num_insts--;
+            break;
+    }
+}
+
+void codegen_reserve(Codegen *c, IrFunc *f) {
+    if (f->num_insts > c->cap_insts) {
+        c->cap_insts = f->num_insts * 2;
+        c->frame_offsets = (int32_t *) realloc((void *) c->frame_offsets, c->cap_insts * sizeof(int32_t));
+    }
+
+    if (f->num_blocks > c->cap_blocks) {
+        c->cap_blocks = f->num_blocks * 2;
+        c->block_offsets = (uint32_t *) realloc((void *) c->block_offsets, c->cap_blocks * sizeof(uint32_t));
+        c->block_secs = (uint8_t *) realloc((void *) c->block_secs, c->cap_blocks * sizeof(uint8_t));
+    }
+}
+
+// stack slots of allocas come first, the spill slots follow them
+void codegen_layout_frame(Codegen *c, uint32_t *order, uint32_t num_order) {
+    IrFunc *f = c->f;
+    uint32_t i = 0;
+
+    c->frame = abi_frame_create(c->ra.used_regs);
+
+    while (i < num_order) {
+        IrBlock *block = &f->blocks[order[i]];
+        uint32_t j = 0;
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+            IrInst *inst = &f->insts[v];
+
+            if (inst->op == IR_ALLOCA) {
+                c->frame_offsets[v] = abi_frame_alloc(&c->frame, (uint32_t) inst->imm, (uint32_t) (inst->imm >> 32));
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    int32_t slot = 0;
+    while (slot < c->ra.num_slots) {
+        int32_t offset = abi_frame_alloc(&c->frame, 8, 8);
+        c->slot_base = slot == 0 ? offset : c->slot_base;
+        slot++;
+    }
+
+    abi_frame_finish(&c->frame);
+}
+
+void codegen_copy_params(Codegen *c) {
+    IrFunc *f = c->f;
+    IrBlock *entry = &f->blocks[0];
+    uint32_t i = 0;
+
+    while (i < entry->num_insts) {
+        IrValue v = entry->insts[i];
+        IrInst *inst = &f->insts[v];
+
+        if (inst->op == IR_PARAM && c->ra.num_uses[v] > 0 && c->ra.locs[v].kind != LOC_NONE) {
+            CgOperand src = { CG_REG, 0, 0, IR_NO_VALUE };
+
+            if (inst->imm < ABI_NUM_ARG_REGS) {
+                src.reg = abi_arg_regs[inst->imm];
+            } else {
+                src.kind = CG_MEM;
+                src.offset = abi_param_offset((uint32_t) inst->imm);
+            }
+
+            CgOperand dst = codegen_operand(c, v);
+            codegen_add_move(c, dst, src);
+
+            if (dst.kind == CG_REG && c->ra.spill_slot[v] >= 0) {
+                codegen_add_move(c, codegen_slot(c, v), src);
+            }
+        }
+
+        i++;
+    }
+
+    codegen_parallel_move(c);
+}
+
+// resolves the jumps to blocks and records where the function's code and relocations are, for codegen_copy_chunk
+void codegen_finish_func(Codegen *c, uint32_t start) {
+    int64_t k = 0;
+
+    while (k < c->fixups.len) {
+        CgFixup *fixup = (CgFixup *) vec_get_ptr(&c->fixups, k);
+        uint32_t target = 0;
+        uint8_t sec = 0;
+
+        // targets past the blocks are the edge stubs
+        if (fixup->target >= c->f->num_blocks) {
+            CgStub *stub = (CgStub *) vec_get_ptr(&c->stubs, fixup->target - c->f->num_blocks);
+            target = stub->offset;
+            sec = stub->sec;
+        } else {
+            target = c->block_offsets[fixup->target];
+            sec = c->block_secs[fixup->target];
+        }
+
+        if (sec == fixup->sec) {
+            x64_patch_rel32(elf_section(c->elf, (ElfSectionId) sec), fixup->at, target);
+        } else {
+            uint32_t sym = elf_section_symbol(c->elf, (ElfSectionId) sec);
+            elf_add_reloc(c->elf, (ElfSectionId) fixup->sec, fixup->at, ELF_R_X86_64_PC32, sym, (int64_t) target - 4);
+        }
+
+        k++;
+    }
+
+    c->fixups.len = 0;
+
+    CgChunk *chunk = c->chunk;
+    uint32_t s = 0;
+
+    chunk->split = c->cold_start != PLACE_NONE;
+    chunk->sec = (uint8_t) (chunk->split ? ELF_SEC_TEXT : c->sec);
+
+    while (s < CG_NUM_TEXT_SECS) {
+        ElfSectionId sec = (ElfSectionId) (ELF_SEC_TEXT + s);
+        Vec *relocs = elf_section_relocs(c->elf, sec);
+
+        chunk->end[s] = elf_section(c->elf, sec)->len;
+        chunk->start[s] = sec == chunk->sec ? start : chunk->end[s];
+        chunk->first_reloc[s] = c->num_relocs[s];
+        chunk->last_reloc[s] = (uint32_t) relocs->len;
+        c->num_relocs[s] = (uint32_t) relocs->len;
+        s++;
+    }
+
+    if (chunk->split) {
+        chunk->end[0] = c->hot_end;
+        chunk->start[1] = c->cold_start;
+        c->num_split_funcs++;
+    }
+
+    codegen_set_section(c, ELF_SEC_TEXT);
+    c->hot_end = PLACE_NONE;
+    c->cold_start = PLACE_NONE;
+    c->num_funcs++;
+}
+
+// the stubs of the edges that need moves follow the blocks of their section
+void codegen_emit_stubs(Codegen *c) {
+    int64_t i = c->next_stub;
+
+    while (i < c->stubs.len) {
+        CgStub *stub = (CgStub *) vec_get_ptr(&c->stubs, i);
+
+        stub->offset = c->text->len;
+        stub->sec = (uint8_t) c->sec;
+        codegen_edge_moves(c, stub->from, stub->to);
+        codegen_parallel_move(c);
+        codegen_jump(c, false, X64_CC_O, stub->to);
+
+        i++;
+    }
+
+    c->next_stub = (uint32_t) c->stubs.len;
+}
+
+// spills count the stores to stack slots and reloads the loads from them, both as emitted
+void codegen_report_func(Codegen *c, IrFunc *f) {
+    TRACE_INFO(TRACE_CAT_REGALLOC, "%s: %u intervals, %ld split, %ld spilled values, %ld spills, %ld reloads", f->name,
+        c->ra.num_intervals, (long) c->ra.num_split, (long) c->ra.num_spilled, (long) c->num_spills, (long) c->num_reloads);
+
+    c->total_spills += c->num_spills;
+    c->total_reloads += c->num_reloads;
+    c->total_split += c->ra.num_split;
+    c->total_spilled += c->ra.num_spilled;
+    c->num_spilling_funcs += c->num_spills > 0 || c->num_reloads > 0;
+    c->max_spills = c->num_spills + c->num_reloads > c->max_spills ? c->num_spills + c->num_reloads : c->max_spills;
+}
+
+void codegen_func(Codegen *c, IrFunc *f) {
+    int32_t tt = TIMETRACE_BEGIN("codegen function", 0, NULL, (int32_t) strlen(f->name), f->name);
+
+    c->f = f;
+    c->num_split_edges += ir_split_critical_edges(f);
+    codegen_reserve(c, f);
+
+    uint32_t num_order = 0;
+    uint32_t *order = ir_reverse_postorder(f, &num_order);
+    uint32_t num_hot = c->uses_place ? place_blocks(&c->place, f, order, num_order) : num_order;
+
+    c->ra.first_cold = num_hot;
+
+    // -O2 spends more time on allocation, the graph colouring allocator coalesces the copies into phis.
+    // functions too big for the graph go to linear scan
+    if (c->opt_level >= 2) {
+        regalloc_prepare(&c->ra, f, order, num_order);
+
+        if (!irc_run(&c->irc, &c->ra)) {
+            regalloc_allocate(&c->ra);
+            c->num_irc_fallbacks++;
+        }
+    } else {
+        regalloc_run(&c->ra, f, order, num_order);
+    }
+
+    codegen_layout_frame(c, order, num_order);
+    codegen_vec_prepare(c);
+
+    // a function that never ran goes to .text.unlikely whole
+    codegen_set_section(c, num_hot == 0 ? ELF_SEC_TEXT_UNLIKELY : ELF_SEC_TEXT);
+    buf_align(c->text, 16);
+    uint32_t start = c->text->len;
+
+    c->pos = 0;
+    c->next_split = 0;
+    c->next_stub = 0;
+    c->num_spills = 0;
+    c->num_reloads = 0;
+    c->stubs.len = 0;
+
+    abi_emit_prologue(c->text, &c->frame);
+    codegen_copy_params(c);
+
+    uint32_t i = 0;
+
+    while (i < num_order) {
+        IrBlockId b = order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t j = 0;
+
+        // the hot part ends with its stubs, the cold blocks are out of line in their own section
+        if (i == num_hot && i > 0) {
+            codegen_emit_stubs(c);
+            c->hot_end = c->text->len;
+            codegen_set_section(c, ELF_SEC_TEXT_UNLIKELY);
+            c->cold_start = c->text->len;
+        }
+
+        c->block_offsets[b] = c->text->len;
+        c->block_secs[b] = (uint8_t) c->sec;
+        c->next_block = i + 1 < num_order && i + 1 != num_hot ? order[i + 1] : IR_NO_BLOCK;
+
+        if (c->has_vec) {
+            codegen_vec_block(c, b);
+
+            if (codegen_vec_enters_narrow(c, b)) {
+                x64_vzeroupper(c->text);
+            }
+        }
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+            c->pos = c->ra.pos[v];
+
+            // at the start of a block the moves happen on the edges into it
+            if (j > 0 && c->ra.num_splits > 0) {
+                codegen_split_moves(c, c->pos - 1);
+            }
+
+            if (c->has_vec && j + 1 == block->num_insts) {
+                codegen_vec_phi_moves(c, b);
+
+                if (codegen_vec_leaves_wide(c, b)) {
+                    x64_vzeroupper(c->text);
+                }
+            }
+
+            codegen_inst(c, b, v);
+            j++;
+
+            // the return after a tail call is never reached
+            if (f->insts[v].op == IR_CALL && (f->insts[v].flags & IR_FLAG_TAIL) != 0) {
+                break;
+            }
+        }
+
+        i++;
+    }
+
+    codegen_emit_stubs(c);
+    codegen_finish_func(c, start);
+    codegen_report_func(c, f);
+
+    free((void *) order);
+
+    TIMETRACE_END(tt);
+}
+
+// strings go to .rodata, initialized globals to .data and the rest to .bss
+void codegen_emit_data(Codegen *c) {
+    IrModule *m = c->m;
+    Buf *rodata = elf_section(c->elf, ELF_SEC_RODATA);
+    Buf *data = elf_section(c->elf, ELF_SEC_DATA);
+    int64_t i = 0;
+
+    c->string_offsets = (uint32_t *) malloc((m->strings.len + 1) * sizeof(uint32_t));
+
+    while (i < m->strings.len) {
+        IrString *s = ir_module_string(m, i);
+
+        c->string_offsets[i] = rodata->len;
+        buf_push(rodata, s->data, s->len);
+        buf_push_u8(rodata, 0);
+
+        i++;
+    }
+
+    c->global_syms = (uint32_t *) malloc((m->globals.len + 1) * sizeof(uint32_t));
+    i = 0;
+
+    while (i < m->globals.len) {
+        IrGlobal *g = ir_module_global(m, i);
+        uint32_t size = ir_type_size(m, g->ty);
+        uint32_t sym = elf_symbol(c->elf, g->name, strlen(g->name), ELF_STB_LOCAL, ELF_STT_OBJECT);
+
+        if (g->init_kind == IR_INIT_NONE) {
+            elf_define_symbol(c->elf, sym, ELF_SEC_BSS, elf_reserve_bss(c->elf, size, size), size);
+        } else {
+            buf_align(data, size);
+            elf_define_symbol(c->elf, sym, ELF_SEC_DATA, data->len, size);
+
+            if (g->init_kind == IR_INIT_STRING) {
+                elf_add_reloc(c->elf, ELF_SEC_DATA, data->len, ELF_R_X86_64_64, elf_section_symbol(c->elf, ELF_SEC_RODATA), c->string_offsets[g->init]);
+                buf_push_u64(data, 0);
+            } else if (size == 8) {
+                buf_push_u64(data, (uint64_t) g->init);
+            } else {
+                buf_push_u32(data, (uint32_t) g->init);
+            }
+        }
+
+        c->global_syms[i] = sym;
+        i++;
+    }
+}
+
+// a worker shares the module's symbols and the functions' no return results, everything else it has of its own
+Codegen codegen_create_worker(Codegen *c) {
+    ElfWriter *elf = (ElfWriter *) malloc(sizeof(ElfWriter));
+    *elf = elf_create();
+
+    Codegen w = codegen_create(c->m, elf, c->opt_level, NULL);
+
+    w.func_syms = c->func_syms;
+    w.global_syms = c->global_syms;
+    w.string_offsets = c->string_offsets;
+    w.malloc_sym = c->malloc_sym;
+    w.free_sym = c->free_sym;
+    w.cpu_features_sym = c->cpu_features_sym;
+    w.cpu_init_sym = c->cpu_init_sym;
+    w.uses_cpu_features = c->uses_cpu_features;
+    w.uses_place = c->uses_place;
+
+    if (c->uses_place) {
+        w.place = place_fork(&c->place);
+    }
+
+    return w;
+}
+
+// adds up a worker's statistics into c and frees it
+void codegen_join_worker(Codegen *c, Codegen *w) {
+    c->num_funcs += w->num_funcs;
+    c->num_insts += w->num_insts;
+    c->num_split_edges += w->num_split_edges;
+    c->num_split_funcs += w->num_split_funcs;
+    c->total_spills += w->total_spills;
+    c->total_reloads += w->total_reloads;
+    c->total_split += w->total_split;
+    c->total_spilled += w->total_spilled;
+    c->num_spilling_funcs += w->num_spilling_funcs;
+    c->num_irc_fallbacks += w->num_irc_fallbacks;
+    c->max_spills = w->max_spills > c->max_spills ? w->max_spills : c->max_spills;
+    c->place.num_blocks += w->place.num_blocks;
+    c->place.num_cold_blocks += w->place.num_cold_blocks;
+    c->place.num_cold_funcs += w->place.num_cold_funcs;
+    c->place.num_chained += w->place.num_chained;
+
+    w->func_syms = NULL;
+    w->global_syms = NULL;
+    w->string_offsets = NULL;
+
+    elf_free(w->elf);
+    free((void *) w->elf);
+    codegen_free(w);
+}
+
+void codegen_func_task(void *ctx, uint32_t worker, uint32_t i) {
+    Codegen *c = (Codegen *) ctx;
+    Codegen *w = &c->workers[worker];
+    uint32_t idx = (uint32_t) c->tasks[i];
+    IrFunc *f = ir_module_func(c->m, c->func_order[idx]);
+
+    w->chunk = &c->chunks[idx];
+    w->chunk->worker = worker;
+
+    // -O0 trades the register allocator for a single pass that keeps every value in memory
+    if (c->opt_level == 0) {
+        fastgen_func(w, f);
+    } else {
+        codegen_func(w, f);
+    }
+}
+
+int32_t codegen_compare_tasks(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return x < y ? -1 : (x > y);
+}
+
+// copies a function's code from the worker that generated it into the object file and defines its symbols. its
+// relocations move with it, and so do the addends of the jumps between the hot and the cold part of a split
+// function, which are relocations against the section symbols. the cold part gets a local symbol of its own,
+// named like GCC names it
+void codegen_copy_chunk(Codegen *c, CgChunk *chunk, IrFunc *f) {
+    ElfWriter *from = c->workers[chunk->worker].elf;
+    int64_t delta[CG_NUM_TEXT_SECS];
+    uint32_t s = 0;
+
+    while (s < CG_NUM_TEXT_SECS) {
+        ElfSectionId sec = (ElfSectionId) (ELF_SEC_TEXT + s);
+        Buf *dst = elf_section(c->elf, sec);
+
+        if (sec == chunk->sec) {
+            buf_align(dst, 16);
+        }
+
+        delta[s] = (int64_t) dst->len - chunk->start[s];
+
+        if (chunk->end[s] > chunk->start[s]) {
+            buf_push(dst, elf_section(from, sec)->data + chunk->start[s], chunk->end[s] - chunk->start[s]);
+        }
+
+        s++;
+    }
+
+    s = 0;
+    while (s < CG_NUM_TEXT_SECS) {
+        ElfSectionId sec = (ElfSectionId) (ELF_SEC_TEXT + s);
+        Vec *relocs = elf_section_relocs(from, sec);
+        uint32_t i = chunk->first_reloc[s];
+
+        while (i < chunk->last_reloc[s]) {
+            ElfReloc *r = (ElfReloc *) vec_get_ptr(relocs, i);
+            int64_t addend = r->addend;
+
+            if (r->sym == elf_section_symbol(c->elf, ELF_SEC_TEXT)) {
+                addend += delta[0];
+            } else if (r->sym == elf_section_symbol(c->elf, ELF_SEC_TEXT_UNLIKELY)) {
+                addend += delta[1];
+            }
+
+            elf_add_reloc(c->elf, sec, (uint64_t) ((int64_t) r->offset + delta[s]), r->type, r->sym, addend);
+            i++;
+        }
+
+        s++;
+    }
+
+    s = chunk->sec - ELF_SEC_TEXT;
+    elf_define_symbol(c->elf, c->func_syms[f->idx], (ElfSectionId) chunk->sec, chunk->start[s] + delta[s], chunk->end[s] - chunk->start[s]);
+
+    if (chunk->split) {
+        size_t len = strlen(f->name);
+        char *name = (char *) malloc(len + 6);
+
+        memcpy(name, f->name, len);
+        memcpy(name + len, ".cold", 5);
+
+        uint32_t sym = elf_symbol(c->elf, name, (int32_t) len + 5, ELF_STB_LOCAL, ELF_STT_FUNC);
+        free((void *) name);
+
+        elf_define_symbol(c->elf, sym, ELF_SEC_TEXT_UNLIKELY, chunk->start[1] + delta[1], chunk->end[1] - chunk->start[1]);
+    }
+}
+
+void codegen_module(Codegen *c) {
+    IrModule *m = c->m;
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t *order = (uint32_t *) malloc((num_funcs + 1) * sizeof(uint32_t));
+    uint32_t num_order = 0;
+    uint32_t i = 0;
+
+    codegen_emit_data(c);
+
+    // every function gets its symbol up front, so calls can refer to functions that come later
+    c->func_syms = (uint32_t *) malloc((num_funcs + 1) * sizeof(uint32_t));
+
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if (f->flags & IR_FUNC_EXTERN) {
+            c->func_syms[i] = elf_symbol(c->elf, f->name, strlen(f->name), ELF_STB_GLOBAL, ELF_STT_NOTYPE);
+        } else {
+            uint8_t bind = f->flags & IR_FUNC_EXPORTED ? ELF_STB_GLOBAL : ELF_STB_LOCAL;
+            c->func_syms[i] = elf_symbol(c->elf, f->name, strlen(f->name), bind, ELF_STT_FUNC);
+        }
+
+        i++;
+    }
+
+    c->malloc_sym = elf_symbol(c->elf, "malloc", 6, ELF_STB_GLOBAL, ELF_STT_NOTYPE);
+    c->free_sym = elf_symbol(c->elf, "free", 4, ELF_STB_GLOBAL, ELF_STT_NOTYPE);
+
+    if (codegen_uses_cpu_features(m)) {
+        codegen_declare_cpu_features(c);
+    }
+
+    // -O0 and -O1 keep the functions in the order they were written, -O2 and a profile pack callers with their
+    // callees and leave the functions that never ran for last. without a profile, placement took a third of the
+    // time -O1 spends generating code for what it saves at run time
+    c->uses_place = c->opt_level >= 2 || (c->opt_level >= 1 && codegen_is_profiled(m));
+
+    if (c->uses_place) {
+        c->place = place_create(m);
+        num_order = place_funcs(&c->place, order);
+    } else {
+        i = 0;
+        while (i < num_funcs) {
+            if ((ir_module_func(m, i)->flags & IR_FUNC_EXTERN) == 0) {
+                order[num_order++] = i;
+            }
+
+            i++;
+        }
+    }
+
+    uint32_t num_workers = c->pool->num_workers;
+
+    c->func_order = order;
+    c->tasks = (uint64_t *) malloc((num_order + 1) * sizeof(uint64_t));
+    c->chunks = (CgChunk *) calloc(num_order + 1, sizeof(CgChunk));
+    c->workers = (Codegen *) malloc(num_workers * sizeof(Codegen));
+
+    i = 0;
+    while (i < num_workers) {
+        c->workers[i] = codegen_create_worker(c);
+        i++;
+    }
+
+    // the workers take the largest functions first so none is left with a big one at the end, the size goes in
+    // the upper half and the function's place in the layout in the lower
+    i = 0;
+    while (i < num_order) {
+        c->tasks[i] = ((uint64_t) (UINT32_MAX - ir_module_func(m, order[i])->num_insts) << 32) | i;
+        i++;
+    }
+
+    if (num_workers > 1) {
+        qsort((void *) c->tasks, num_order, sizeof(uint64_t), codegen_compare_tasks);
+    }
+
+    pool_run(c->pool, num_order, codegen_func_task, (void *) c);
+
+    int32_t tt = TIMETRACE_BEGIN("codegen copy", 0, NULL, 0, NULL);
+
+    i = 0;
+    while (i < num_order) {
+        codegen_copy_chunk(c, &c->chunks[i], ir_module_func(m, order[i]));
+        i++;
+    }
+
+    TIMETRACE_END(tt);
+
+    i = 0;
+    while (i < num_workers) {
+        codegen_join_worker(c, &c->workers[i]);
+        i++;
+    }
+
+    free((void *) c->workers);
+    free((void *) c->chunks);
+    free((void *) c->tasks);
+    c->workers = NULL;
+    c->chunks = NULL;
+    c->tasks = NULL;
+    c->func_order = NULL;
+
+    if (c->uses_cpu_features) {
+        codegen_emit_cpu_init(c);
+    }
+
+    timer_stat_add("codegen functions", c->num_funcs);
+    timer_stat_add("codegen ir instructions", c->num_insts);
+    timer_stat_add("codegen bytes", c->text->len);
+    timer_stat_add("codegen cold bytes", elf_section(c->elf, ELF_SEC_TEXT_UNLIKELY)->len);
+    timer_stat_add("codegen functions split hot and cold", c->num_split_funcs);
+    timer_stat_add("codegen spilled values", c->total_spilled);
+    timer_stat_add("regalloc split intervals", c->total_split);
+    timer_stat_add("regalloc spills", c->total_spills);
+    timer_stat_add("regalloc reloads", c->total_reloads);
+    timer_stat_add("regalloc functions with spills", c->num_spilling_funcs);
+    timer_stat_add("regalloc max function spill code", c->max_spills);
+
+    if (c->opt_level >= 2) {
+        timer_stat_add("regalloc functions too big to colour", c->num_irc_fallbacks);
+    }
+
+    timer_stat_add("codegen split edges", c->num_split_edges);
+
+    if (c->uses_place) {
+        timer_stat_add("place cold blocks", c->place.num_cold_blocks);
+        timer_stat_add("place cold functions", c->place.num_cold_funcs);
+        timer_stat_add("place chained edges", c->place.num_chained);
+        timer_stat_add("place clustered calls", c->place.num_clustered);
+    }
+
+    free((void *) order);
+}
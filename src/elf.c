@@ -0,0 +1,355 @@
+#include <string.h>
+
+#include "../include/elf.h"
+#include "../include/utils.h"
+
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA 4
+#define ELF_SHT_NOBITS 8
+
+#define ELF_SHF_WRITE 0x1
+#define ELF_SHF_ALLOC 0x2
+#define ELF_SHF_EXECINSTR 0x4
+#define ELF_SHF_INFO_LINK 0x40
+
+#define ELF_HEADER_SIZE 64
+#define ELF_SHDR_SIZE 64
+#define ELF_SYM_SIZE 24
+#define ELF_RELA_SIZE 24
+
+static char const *const elf_section_names[] = {
+    "",
+    ".text",
+    ".text.unlikely",
+    ".rodata",
+    ".data",
+    ".bss",
+    ".rela.text",
+    ".rela.text.unlikely",
+    ".rela.data",
+    ".symtab",
+    ".strtab",
+    ".shstrtab",
+    ".note.GNU-stack"
+};
+
+_Static_assert(sizeof(elf_section_names) / sizeof(char *) == ELF_NUM_SECTIONS, "every ELF section needs a name");
+
+uint32_t elf_add_symbol(ElfWriter *w, uint32_t name, uint8_t bind, uint8_t type, uint16_t section) {
+    ElfSymbol sym = {
+        .name = name,
+        .bind = bind,
+        .type = type,
+        .section = section,
+        .value = 0,
+        .size = 0
+    };
+
+    vec_push(&w->symbols, &sym);
+
+    return w->symbols.len - 1;
+}
+
+ElfWriter elf_create() {
+    ElfWriter w = {
+        .text = buf_create(),
+        .text_unlikely = buf_create(),
+        .rodata = buf_create(),
+        .data = buf_create(),
+        .bss_size = 0,
+        .strtab = buf_create(),
+        .symbols = vec_create(sizeof(ElfSymbol)),
+        .text_relocs = vec_create(sizeof(ElfReloc)),
+        .text_unlikely_relocs = vec_create(sizeof(ElfReloc)),
+        .data_relocs = vec_create(sizeof(ElfReloc)),
+        .by_name = map_create(),
+        .names = ptrvec_create()
+    };
+
+    // index 0 of both the string and the symbol table is the empty entry
+    buf_push_u8(&w.strtab, 0);
+    elf_add_symbol(&w, 0, ELF_STB_LOCAL, ELF_STT_NOTYPE, 0);
+
+    memset(w.section_syms, 0, sizeof(w.section_syms));
+    w.section_syms[ELF_SEC_TEXT] = elf_add_symbol(&w, 0, ELF_STB_LOCAL, ELF_STT_SECTION, ELF_SEC_TEXT);
+    w.section_syms[ELF_SEC_TEXT_UNLIKELY] = elf_add_symbol(&w, 0, ELF_STB_LOCAL, ELF_STT_SECTION, ELF_SEC_TEXT_UNLIKELY);
+    w.section_syms[ELF_SEC_RODATA] = elf_add_symbol(&w, 0, ELF_STB_LOCAL, ELF_STT_SECTION, ELF_SEC_RODATA);
+    w.section_syms[ELF_SEC_DATA] = elf_add_symbol(&w, 0, ELF_STB_LOCAL, ELF_STT_SECTION, ELF_SEC_DATA);
+    w.section_syms[ELF_SEC_BSS] = elf_add_symbol(&w, 0, ELF_STB_LOCAL, ELF_STT_SECTION, ELF_SEC_BSS);
+
+    return w;
+}
+
+void elf_free(ElfWriter *w) {
+    buf_free(&w->text);
+    buf_free(&w->text_unlikely);
+    buf_free(&w->rodata);
+    buf_free(&w->data);
+    buf_free(&w->strtab);
+    vec_free(&w->symbols);
+    vec_free(&w->text_relocs);
+    vec_free(&w->text_unlikely_relocs);
+    vec_free(&w->data_relocs);
+    map_free(&w->by_name);
+
+    int32_t i = 0;
+    while (i < w->names.len) {
+        free(ptrvec_get(&w->names, i));
+        i++;
+    }
+
+    ptrvec_free(&w->names);
+}
+
+Buf *elf_section(ElfWriter *w, ElfSectionId sec) {
+    switch (sec) {
+        case ELF_SEC_TEXT: return &w->text;
+        case ELF_SEC_TEXT_UNLIKELY: return &w->text_unlikely;
+        case ELF_SEC_RODATA: return &w->rodata;
+        case ELF_SEC_DATA: return &w->data;
+        default: return NULL;
+    }
+}
+
+Vec *elf_section_relocs(ElfWriter *w, ElfSectionId sec) {
+    switch (sec) {
+        case ELF_SEC_TEXT: return &w->text_relocs;
+        case ELF_SEC_TEXT_UNLIKELY: return &w->text_unlikely_relocs;
+        default: return &w->data_relocs;
+    }
+}
+
+uint32_t elf_section_symbol(ElfWriter *w, ElfSectionId sec) {
+    return w->section_syms[sec];
+}
+
+// global symbols are shared by name, so every extern is declared once, local symbols are always new
+uint32_t elf_symbol(ElfWriter *w, const char *name, int32_t len, uint8_t bind, uint8_t type) {
+    if (bind == ELF_STB_LOCAL) {
+        uint32_t str = w->strtab.len;
+        buf_push(&w->strtab, name, len);
+        buf_push_u8(&w->strtab, 0);
+
+        return elf_add_symbol(w, str, bind, type, 0);
+    }
+
+    void *existing = map_get(&w->by_name, map_create_key(len, name));
+    if (existing != NULL) {
+        return ptr2int(existing) - 1;
+    }
+
+    char *copy = (char *) malloc(len + 1);
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    ptrvec_push_ptr(&w->names, copy);
+
+    uint32_t str = w->strtab.len;
+    buf_push(&w->strtab, copy, len + 1);
+
+    uint32_t sym = elf_add_symbol(w, str, bind, type, 0);
+    map_insert(&w->by_name, map_create_key(len, copy), int2ptr(sym + 1));
+
+    return sym;
+}
+
+void elf_define_symbol(ElfWriter *w, uint32_t sym, ElfSectionId sec, uint64_t value, uint64_t size) {
+    ElfSymbol *s = (ElfSymbol *) vec_get_ptr(&w->symbols, sym);
+
+    s->section = sec;
+    s->value = value;
+    s->size = size;
+}
+
+uint64_t elf_reserve_bss(ElfWriter *w, uint64_t size, uint32_t align) {
+    w->bss_size = (w->bss_size + align - 1) / align * align;
+
+    uint64_t offset = w->bss_size;
+    w->bss_size += size;
+
+    return offset;
+}
+
+void elf_add_reloc(ElfWriter *w, ElfSectionId sec, uint64_t offset, uint32_t type, uint32_t sym, int64_t addend) {
+    ElfReloc r = {
+        .offset = offset,
+        .sym = sym,
+        .type = type,
+        .addend = addend
+    };
+
+    vec_push(elf_section_relocs(w, sec), &r);
+}
+
+void elf_write_shdr(Buf *out, uint32_t name, uint32_t type, uint64_t flags, uint64_t offset, uint64_t size, uint32_t link, uint32_t info, uint64_t align, uint64_t entsize) {
+    buf_push_u32(out, name);
+    buf_push_u32(out, type);
+    buf_push_u64(out, flags);
+    buf_push_u64(out, 0);
+    buf_push_u64(out, offset);
+    buf_push_u64(out, size);
+    buf_push_u32(out, link);
+    buf_push_u32(out, info);
+    buf_push_u64(out, align);
+    buf_push_u64(out, entsize);
+}
+
+void elf_write_relocs(Buf *out, Vec *relocs, uint32_t *sym_map) {
+    int64_t i = 0;
+
+    while (i < relocs->len) {
+        ElfReloc *r = (ElfReloc *) vec_get_ptr(relocs, i);
+
+        buf_push_u64(out, r->offset);
+        buf_push_u64(out, (uint64_t) sym_map[r->sym] << 32 | r->type);
+        buf_push_u64(out, (uint64_t) r->addend);
+
+        i++;
+    }
+}
+
+// the whole object is built in memory and written with a single fwrite
+bool elf_write(ElfWriter *w, const char *path) {
+    uint32_t num_syms = w->symbols.len;
+    uint32_t *sym_map = (uint32_t *) malloc(num_syms * sizeof(uint32_t));
+    uint32_t next = 0;
+    uint32_t i = 0;
+
+    // ELF wants every local symbol before the first global one
+    while (i < num_syms) {
+        ElfSymbol *s = (ElfSymbol *) vec_get_ptr(&w->symbols, i);
+        if (s->bind == ELF_STB_LOCAL) {
+            sym_map[i] = next++;
+        }
+
+        i++;
+    }
+
+    uint32_t first_global = next;
+    i = 0;
+
+    while (i < num_syms) {
+        ElfSymbol *s = (ElfSymbol *) vec_get_ptr(&w->symbols, i);
+        if (s->bind != ELF_STB_LOCAL) {
+            sym_map[i] = next++;
+        }
+
+        i++;
+    }
+
+    Buf symtab = buf_create();
+    buf_push_zeros(&symtab, num_syms * ELF_SYM_SIZE);
+    i = 0;
+
+    while (i < num_syms) {
+        ElfSymbol *s = (ElfSymbol *) vec_get_ptr(&w->symbols, i);
+        uint32_t at = sym_map[i] * ELF_SYM_SIZE;
+        uint32_t len = symtab.len;
+
+        symtab.len = at;
+        buf_push_u32(&symtab, s->name);
+        buf_push_u8(&symtab, (s->bind << 4) | s->type);
+        buf_push_u8(&symtab, 0);
+        buf_push_u16(&symtab, s->section);
+        buf_push_u64(&symtab, s->value);
+        buf_push_u64(&symtab, s->size);
+        symtab.len = len;
+
+        i++;
+    }
+
+    Buf rela_text = buf_create();
+    Buf rela_text_unlikely = buf_create();
+    Buf rela_data = buf_create();
+    elf_write_relocs(&rela_text, &w->text_relocs, sym_map);
+    elf_write_relocs(&rela_text_unlikely, &w->text_unlikely_relocs, sym_map);
+    elf_write_relocs(&rela_data, &w->data_relocs, sym_map);
+
+    Buf shstrtab = buf_create();
+    uint32_t name_offsets[ELF_NUM_SECTIONS];
+    i = 0;
+
+    while (i < ELF_NUM_SECTIONS) {
+        name_offsets[i] = shstrtab.len;
+        buf_push(&shstrtab, elf_section_names[i], strlen(elf_section_names[i]) + 1);
+        i++;
+    }
+
+    Buf *contents[ELF_NUM_SECTIONS] = {
+        NULL, &w->text, &w->text_unlikely, &w->rodata, &w->data, NULL, &rela_text, &rela_text_unlikely, &rela_data, &symtab,
+        &w->strtab, &shstrtab, NULL
+    };
+
+    Buf out = buf_create();
+    uint64_t offsets[ELF_NUM_SECTIONS];
+
+    buf_push_zeros(&out, ELF_HEADER_SIZE);
+    i = 1;
+
+    while (i < ELF_NUM_SECTIONS) {
+        buf_align(&out, 16);
+        offsets[i] = out.len;
+
+        if (contents[i] != NULL && contents[i]->len > 0) {
+            buf_push(&out, contents[i]->data, contents[i]->len);
+        }
+
+        i++;
+    }
+
+    buf_align(&out, 8);
+    uint64_t shoff = out.len;
+
+    elf_write_shdr(&out, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_TEXT], ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR, offsets[ELF_SEC_TEXT], w->text.len, 0, 0, 16, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_TEXT_UNLIKELY], ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR, offsets[ELF_SEC_TEXT_UNLIKELY], w->text_unlikely.len, 0, 0, 16, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_RODATA], ELF_SHT_PROGBITS, ELF_SHF_ALLOC, offsets[ELF_SEC_RODATA], w->rodata.len, 0, 0, 16, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_DATA], ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_WRITE, offsets[ELF_SEC_DATA], w->data.len, 0, 0, 16, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_BSS], ELF_SHT_NOBITS, ELF_SHF_ALLOC | ELF_SHF_WRITE, offsets[ELF_SEC_BSS], w->bss_size, 0, 0, 16, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_RELA_TEXT], ELF_SHT_RELA, ELF_SHF_INFO_LINK, offsets[ELF_SEC_RELA_TEXT], rela_text.len, ELF_SEC_SYMTAB, ELF_SEC_TEXT, 8, ELF_RELA_SIZE);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_RELA_TEXT_UNLIKELY], ELF_SHT_RELA, ELF_SHF_INFO_LINK, offsets[ELF_SEC_RELA_TEXT_UNLIKELY], rela_text_unlikely.len, ELF_SEC_SYMTAB, ELF_SEC_TEXT_UNLIKELY, 8, ELF_RELA_SIZE);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_RELA_DATA], ELF_SHT_RELA, ELF_SHF_INFO_LINK, offsets[ELF_SEC_RELA_DATA], rela_data.len, ELF_SEC_SYMTAB, ELF_SEC_DATA, 8, ELF_RELA_SIZE);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_SYMTAB], ELF_SHT_SYMTAB, 0, offsets[ELF_SEC_SYMTAB], symtab.len, ELF_SEC_STRTAB, first_global, 8, ELF_SYM_SIZE);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_STRTAB], ELF_SHT_STRTAB, 0, offsets[ELF_SEC_STRTAB], w->strtab.len, 0, 0, 1, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_SHSTRTAB], ELF_SHT_STRTAB, 0, offsets[ELF_SEC_SHSTRTAB], shstrtab.len, 0, 0, 1, 0);
+    elf_write_shdr(&out, name_offsets[ELF_SEC_NOTE_STACK], ELF_SHT_PROGBITS, 0, offsets[ELF_SEC_NOTE_STACK], 0, 0, 0, 1, 0);
+
+    // ELF64 header for a little endian x86-64 relocatable object
+    static const uint8_t ident[16] = { 0x7f, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    uint32_t len = out.len;
+
+    out.len = 0;
+    buf_push(&out, ident, 16);
+    buf_push_u16(&out, 1);
+    buf_push_u16(&out, 62);
+    buf_push_u32(&out, 1);
+    buf_push_u64(&out, 0);
+    buf_push_u64(&out, 0);
+    buf_push_u64(&out, shoff);
+    buf_push_u32(&out, 0);
+    buf_push_u16(&out, ELF_HEADER_SIZE);
+    buf_push_u16(&out, 0);
+    buf_push_u16(&out, 0);
+    buf_push_u16(&out, ELF_SHDR_SIZE);
+    buf_push_u16(&out, ELF_NUM_SECTIONS);
+    buf_push_u16(&out, ELF_SEC_SHSTRTAB);
+    out.len = len;
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(out.data, 1, out.len, file) == out.len;
+
+    if (file != NULL && fclose(file) != 0) {
+        ok = false;
+    }
+
+    buf_free(&out);
+    buf_free(&shstrtab);
+    buf_free(&rela_text);
+    buf_free(&rela_text_unlikely);
+    buf_free(&rela_data);
+    buf_free(&symtab);
+    free((void *) sym_map);
+
+    return ok;
+}
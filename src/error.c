@@ -12,7 +12,8 @@ const char *error_texts[] = {
     "unknown symbol '%.*s'",
     "character literal with invalid length of %1$d: '%.*s'",
     "could not parse statement\n%.*s",
-    "illegal type identifier '%.*s': '%s'"
+    "illegal type identifier '%.*s': '%s'",
+    "integer literal '%.*s' does not fit in 64 bits"
 };
 
 size_t const len_error_strings = sizeof(error_texts) / sizeof(char *);
@@ -0,0 +1,486 @@
+#include <string.h>
+
+#include "../include/escape.h"
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+
+Escape escape_create(IrModule *m) {
+    Escape e;
+    memset((void *) &e, 0, sizeof(Escape));
+
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    e.m = m;
+    e.param_off = (uint32_t *) malloc((num_funcs + 1) * sizeof(uint32_t));
+
+    while (i < num_funcs) {
+        e.param_off[i] = total;
+        total += ir_module_func(m, i)->num_params;
+        i++;
+    }
+
+    e.param_off[num_funcs] = total;
+    e.param_escapes = (bool *) calloc(total + 1, sizeof(bool));
+    e.work = vec_create(sizeof(IrValue));
+    e.deletes = vec_create(sizeof(IrValue));
+    e.funcs = vec_create(sizeof(uint32_t));
+
+    return e;
+}
+
+void escape_free(Escape *e) {
+    free((void *) e->param_off);
+    free((void *) e->param_escapes);
+    free((void *) e->use_off);
+    free((void *) e->users);
+    free((void *) e->caller_off);
+    free((void *) e->callers);
+    free((void *) e->queued);
+    vec_free(&e->work);
+    vec_free(&e->deletes);
+    vec_free(&e->funcs);
+}
+
+void escape_collect_users(Escape *e, IrFunc *f) {
+    uint32_t total = 0;
+    IrBlockId b = 0;
+
+    if (f->num_insts > e->cap_insts) {
+        e->cap_insts = f->num_insts * 2;
+        e->use_off = (uint32_t *) realloc((void *) e->use_off, (e->cap_insts + 1) * sizeof(uint32_t));
+    }
+
+    memset((void *) e->use_off, 0, (f->num_insts + 1) * sizeof(uint32_t));
+    e->f = f;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                e->use_off[ops[j]]++;
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    IrValue v = 0;
+    while (v < f->num_insts) {
+        total += e->use_off[v];
+        e->use_off[v] = total;
+        v++;
+    }
+
+    e->use_off[f->num_insts] = total;
+
+    if (total > e->cap_users) {
+        e->cap_users = total * 2;
+        e->users = (IrValue *) realloc((void *) e->users, e->cap_users * sizeof(IrValue));
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue u = block->insts[i];
+            IrInst *inst = &f->insts[u];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                e->users[--e->use_off[ops[j]]] = u;
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+}
+
+// whether a call passing x as any of its arguments lets it escape
+bool escape_call_escapes(Escape *e, IrInst *call, IrValue x) {
+    IrFunc *callee = ir_module_func(e->m, (uint32_t) call->imm);
+    IrValue *ops = ir_inst_ops(e->f, call);
+    uint32_t j = 0;
+
+    while (j < call->num_ops) {
+        bool is_arg = ops[j] == x;
+
+        if (is_arg && ((callee->flags & IR_FUNC_EXTERN) != 0 || j >= callee->num_params)) {
+            return true;
+        }
+
+        if (is_arg && e->param_escapes[e->param_off[callee->idx] + j]) {
+            return true;
+        }
+
+        j++;
+    }
+
+    return false;
+}
+
+IrValue escape_skip_copies(IrFunc *f, IrValue v) {
+    while (f->insts[v].op == IR_COPY) {
+        v = f->insts[v].u.ops[0];
+    }
+
+    return v;
+}
+
+// follows the pointer v through every offset taken from it. the deletes of v itself are allowed when it is the
+// allocation and collected in e->deletes, a parameter escapes once its function deletes it
+bool escape_pointer_escapes(Escape *e, IrValue v, bool is_alloc) {
+    IrFunc *f = e->f;
+
+    e->work.len = 0;
+    e->deletes.len = 0;
+    vec_push(&e->work, (void *) &v);
+
+    while (e->work.len > 0) {
+        IrValue x = ((IrValue *) e->work.elements)[--e->work.len];
+        uint32_t k = e->use_off[x];
+
+        while (k < e->use_off[x + 1]) {
+            IrValue u = e->users[k];
+            IrInst *inst = &f->insts[u];
+
+            switch (inst->op) {
+                case IR_LOAD:
+                case IR_MEMCPY: {
+                    break;
+                }
+
+                case IR_STORE: {
+                    if (inst->u.ops[1] == x) {
+                        return true;
+                    }
+
+                    break;
+                }
+
+                case IR_OFFSET:
+                case IR_COPY: {
+                    vec_push(&e->work, (void *) &u);
+                    break;
+                }
+
+                case IR_DELETE: {
+                    if (!is_alloc || escape_skip_copies(f, x) != v) {
+                        return true;
+                    }
+
+                    vec_push(&e->deletes, (void *) &u);
+                    break;
+                }
+
+                // the frame of the function is gone once its `become` call starts, what the caller handed in is not
+                case IR_CALL: {
+                    if ((is_alloc && (inst->flags & IR_FLAG_MUST_TAIL) != 0) || escape_call_escapes(e, inst, x)) {
+                        return true;
+                    }
+
+                    break;
+                }
+
+                default: {
+                    return true;
+                }
+            }
+
+            k++;
+        }
+    }
+
+    return false;
+}
+
+// counts the calls f makes in caller_off, or once the counts are summed up puts f into the range of every callee
+void escape_add_calls(Escape *e, IrFunc *f, bool fill) {
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            i++;
+
+            if (inst->op != IR_CALL) {
+                continue;
+            }
+
+            if (fill) {
+                e->callers[--e->caller_off[(uint32_t) inst->imm]] = f->idx;
+            } else {
+                e->caller_off[(uint32_t) inst->imm]++;
+            }
+        }
+
+        b++;
+    }
+}
+
+// the reverse call graph, a function calling another one twice is listed twice
+void escape_collect_callers(Escape *e) {
+    uint32_t num_funcs = ir_module_num_funcs(e->m);
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    e->caller_off = (uint32_t *) calloc(num_funcs + 1, sizeof(uint32_t));
+
+    while (i < num_funcs) {
+        escape_add_calls(e, ir_module_func(e->m, i), false);
+        i++;
+    }
+
+    i = 0;
+    while (i < num_funcs) {
+        total += e->caller_off[i];
+        e->caller_off[i] = total;
+        i++;
+    }
+
+    e->caller_off[num_funcs] = total;
+    e->callers = (uint32_t *) malloc((total + 1) * sizeof(uint32_t));
+
+    i = 0;
+    while (i < num_funcs) {
+        escape_add_calls(e, ir_module_func(e->m, i), true);
+        i++;
+    }
+}
+
+// whether a parameter of f starts to escape
+bool escape_summarize_func(Escape *e, IrFunc *f) {
+    uint32_t off = e->param_off[f->idx];
+    bool changed = false;
+    uint32_t j = 0;
+
+    if ((f->flags & IR_FUNC_EXTERN) != 0 || f->num_blocks == 0) {
+        return false;
+    }
+
+    while (j < f->num_params && e->param_escapes[off + j]) {
+        j++;
+    }
+
+    if (j == f->num_params) {
+        return false;
+    }
+
+    escape_collect_users(e, f);
+
+    IrBlock *entry = &f->blocks[0];
+    j = 0;
+
+    while (j < entry->num_insts) {
+        IrValue v = entry->insts[j];
+        IrInst *inst = &f->insts[v];
+        j++;
+
+        if (inst->op != IR_PARAM) {
+            continue;
+        }
+
+        bool *escapes = &e->param_escapes[off + (uint32_t) inst->imm];
+
+        if (!*escapes && escape_pointer_escapes(e, v, false)) {
+            *escapes = true;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// parameters only ever go from not escaping to escaping, and a function is only looked at again when a
+// parameter of a function it calls has, so the worklist runs empty
+void escape_summarize(Escape *e) {
+    uint32_t num_funcs = ir_module_num_funcs(e->m);
+    uint32_t i = num_funcs;
+
+    escape_collect_callers(e);
+    e->queued = (bool *) malloc((num_funcs + 1) * sizeof(bool));
+    e->funcs.len = 0;
+
+    // pushed back to front so the first function comes off first
+    while (i > 0) {
+        i--;
+        e->queued[i] = true;
+        vec_push(&e->funcs, (void *) &i);
+    }
+
+    while (e->funcs.len > 0) {
+        IrFunc *f = ir_module_func(e->m, ((uint32_t *) e->funcs.elements)[--e->funcs.len]);
+        e->queued[f->idx] = false;
+
+        if (!escape_summarize_func(e, f)) {
+            continue;
+        }
+
+        uint32_t k = e->caller_off[f->idx];
+
+        while (k < e->caller_off[f->idx + 1]) {
+            uint32_t caller = e->callers[k];
+
+            if (!e->queued[caller]) {
+                e->queued[caller] = true;
+                vec_push(&e->funcs, (void *) &caller);
+            }
+
+            k++;
+        }
+    }
+}
+
+// the slot replaces the allocation in its users only, which are already known. the copies the inliner leaves
+// for returned values go away too, so the slot is only ever used as an address
+void escape_promote(Escape *e, IrValue v) {
+    IrFunc *f = e->f;
+    uint32_t size = (uint32_t) f->insts[v].imm;
+    IrValue slot = ir_inst_create(f, IR_ALLOCA, IR_TYPE_PTR, 0);
+    uint32_t i = 0;
+
+    f->insts[slot].imm = ((int64_t) 8 << 32) | size;
+    ir_block_insert(f, 0, 0, slot);
+
+    while (i < e->deletes.len) {
+        ir_inst_remove(f, ((IrValue *) e->deletes.elements)[i]);
+        i++;
+    }
+
+    e->work.len = 0;
+    vec_push(&e->work, (void *) &v);
+
+    while (e->work.len > 0) {
+        IrValue x = ((IrValue *) e->work.elements)[--e->work.len];
+        uint32_t k = e->use_off[x];
+
+        while (k < e->use_off[x + 1]) {
+            IrValue u = e->users[k];
+            IrInst *user = &f->insts[u];
+            IrValue *ops = ir_inst_ops(f, user);
+            uint32_t n = ir_inst_num_values(user);
+            uint32_t j = 0;
+
+            if (user->op == IR_COPY) {
+                vec_push(&e->work, (void *) &u);
+            }
+
+            while (j < n) {
+                ops[j] = ops[j] == x ? slot : ops[j];
+                j++;
+            }
+
+            k++;
+        }
+
+        ir_inst_remove(f, x);
+    }
+
+    e->frame_size += size;
+    e->num_promoted++;
+    e->num_deletes += e->deletes.len;
+}
+
+void escape_func(Escape *e, IrFunc *f) {
+    bool promoted = false;
+    IrBlockId b = 0;
+
+    escape_collect_users(e, f);
+    e->frame_size = 0;
+
+    // a slot goes in front of the entry block and shifts it by one, so one instruction there is seen twice
+    while (b < f->num_blocks) {
+        uint32_t i = 0;
+
+        while (i < f->blocks[b].num_insts) {
+            IrValue v = f->blocks[b].insts[i];
+            IrInst *inst = &f->insts[v];
+            i++;
+
+            if (inst->op != IR_NEW) {
+                continue;
+            }
+
+            e->num_news++;
+
+            bool fits = inst->imm <= ESCAPE_MAX_SIZE && e->frame_size + inst->imm <= ESCAPE_MAX_FRAME;
+
+            if (fits && !escape_pointer_escapes(e, v, true)) {
+                escape_promote(e, v);
+                promoted = true;
+            }
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (promoted && b < f->num_blocks) {
+        ir_block_compact(f, b);
+        b++;
+    }
+}
+
+void escape_module(IrModule *m) {
+    int32_t tt = TIMETRACE_BEGIN("escape analysis", 0, NULL, 0, NULL);
+    Escape e = escape_create(m);
+    uint32_t i = 0;
+
+    escape_summarize(&e);
+
+    while (i < ir_module_num_funcs(m)) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if ((f->flags & IR_FUNC_EXTERN) == 0 && f->num_blocks > 0) {
+            escape_func(&e, f);
+        }
+
+        i++;
+    }
+
+    timer_stat_add("heap allocations", e.num_news);
+    timer_stat_add("heap allocations removed", e.num_promoted);
+    timer_stat_add("deletes removed", e.num_deletes);
+
+    escape_free(&e);
+    TIMETRACE_END(tt);
+}
+
+void escape_pass_module(IrModule *m, void *params) {
+    (void) params;
+
+    escape_module(m);
+}
+
+// promoted allocations and dropped deletes leave the CFG alone
+Pass escape_pass() {
+    Pass p = {
+        .name = "escape",
+        .kind = PASS_MODULE,
+        .preserves = IR_ANALYSIS_ALL,
+        .run_module = escape_pass_module
+    };
+
+    return p;
+}
@@ -0,0 +1,386 @@
+#include "../include/fastgen.h"
+
+bool fastgen_needs_slot(IrFunc *f, IrValue v) {
+    IrInst *inst = &f->insts[v];
+    return inst->ty != IR_TYPE_VOID && inst->op != IR_NOP && !regalloc_is_remat(f, v);
+}
+
+void fastgen_layout_frame(Codegen *c) {
+    IrFunc *f = c->f;
+    IrValue v = 1;
+
+    c->frame = abi_frame_create(0);
+
+    while (v < f->num_insts) {
+        IrInst *inst = &f->insts[v];
+
+        if (inst->op == IR_ALLOCA) {
+            c->frame_offsets[v] = abi_frame_alloc(&c->frame, (uint32_t) inst->imm, (uint32_t) (inst->imm >> 32));
+        } else if (inst->op == IR_PARAM && inst->imm >= ABI_NUM_ARG_REGS) {
+            // stack arguments already have a home in the caller's frame
+            c->frame_offsets[v] = abi_param_offset((uint32_t) inst->imm);
+        } else if (fastgen_needs_slot(f, v)) {
+            c->frame_offsets[v] = abi_frame_alloc(&c->frame, 8, 8);
+
+            // the incoming slot sits right below the phi's own slot
+            if (inst->op == IR_PHI) {
+                abi_frame_alloc(&c->frame, 8, 8);
+            }
+        }
+
+        v++;
+    }
+
+    abi_frame_finish(&c->frame);
+}
+
+void fastgen_load(Codegen *c, X64Reg dst, IrValue v) {
+    if (regalloc_is_remat(c->f, v)) {
+        codegen_remat(c, dst, v);
+    } else {
+        x64_load(c->text, 8, dst, X64_RBP, c->frame_offsets[v]);
+    }
+}
+
+void fastgen_store(Codegen *c, IrValue v, X64Reg src) {
+    x64_store(c->text, 8, X64_RBP, c->frame_offsets[v], src);
+}
+
+// stack slots and their fields are addressed off rbp, every other pointer is loaded into scratch
+void fastgen_addr(Codegen *c, IrValue ptr, X64Reg scratch, X64Reg *base, int32_t *disp) {
+    if (regalloc_is_frame_addr(c->f, ptr)) {
+        *base = X64_RBP;
+        *disp = codegen_frame_offset(c, ptr);
+    } else {
+        fastgen_load(c, scratch, ptr);
+        *base = scratch;
+        *disp = 0;
+    }
+}
+
+// applies `dst = dst op rhs`, reading rhs straight from its slot when it has one
+void fastgen_alu_rhs(Codegen *c, IrOp op, int32_t size, X64Reg dst, IrValue rhs) {
+    IrFunc *f = c->f;
+    X64AluOp alu = ir_op_is_compare(op) ? X64_CMP : codegen_alu_op(op);
+
+    if (codegen_is_imm(f, rhs)) {
+        int32_t imm = (int32_t) f->insts[rhs].imm;
+
+        if (op == IR_MUL) {
+            x64_imul_rri(c->text, size, dst, dst, imm);
+        } else {
+            x64_alu_ri(c->text, alu, size, dst, imm);
+        }
+    } else if (op == IR_MUL) {
+        fastgen_load(c, X64_RCX, rhs);
+        x64_imul_rr(c->text, size, dst, X64_RCX);
+    } else if (regalloc_is_remat(f, rhs)) {
+        codegen_remat(c, X64_RCX, rhs);
+        x64_alu_rr(c->text, alu, size, dst, X64_RCX);
+    } else {
+        x64_alu_rm(c->text, alu, size, dst, X64_RBP, c->frame_offsets[rhs]);
+    }
+}
+
+void fastgen_binary(Codegen *c, IrValue v, IrInst *inst) {
+    IrOp op = (IrOp) inst->op;
+    int32_t size = codegen_reg_size(inst->ty);
+
+    fastgen_load(c, X64_RAX, inst->u.ops[0]);
+
+    if (op == IR_DIV || op == IR_MOD) {
+        fastgen_load(c, X64_RCX, inst->u.ops[1]);
+        x64_sign_extend_ax(c->text, size);
+        x64_unary(c->text, X64_EXT_IDIV, size, X64_RCX);
+        fastgen_store(c, v, op == IR_DIV ? X64_RAX : X64_RDX);
+    } else if (op == IR_SHL || op == IR_SHR) {
+        fastgen_load(c, X64_RCX, inst->u.ops[1]);
+        x64_shift_cl(c->text, op == IR_SHL ? X64_EXT_SHL : X64_EXT_SAR, size, X64_RAX);
+        fastgen_store(c, v, X64_RAX);
+    } else {
+        fastgen_alu_rhs(c, op, size, X64_RAX, inst->u.ops[1]);
+        fastgen_store(c, v, X64_RAX);
+    }
+}
+
+void fastgen_call(Codegen *c, IrValue v, IrInst *inst) {
+    IrFunc *f = c->f;
+    IrFunc *callee = ir_module_func(c->m, (uint32_t) inst->imm);
+    IrValue *ops = ir_inst_ops(f, inst);
+    uint32_t n = inst->num_ops;
+    int32_t stack_bytes = abi_stack_args_size(n);
+
+    if (stack_bytes > 0 && ((n - ABI_NUM_ARG_REGS) & 1) != 0) {
+        x64_alu_ri(c->text, X64_SUB, 8, X64_RSP, 8);
+    }
+
+    uint32_t i = n;
+    while (i > ABI_NUM_ARG_REGS) {
+        i--;
+
+        if (codegen_is_imm(f, ops[i])) {
+            x64_push_imm(c->text, (int32_t) f->insts[ops[i]].imm);
+        } else if (regalloc_is_remat(f, ops[i])) {
+            codegen_remat(c, X64_RAX, ops[i]);
+            x64_push(c->text, X64_RAX);
+        } else {
+            x64_push_mem(c->text, X64_RBP, c->frame_offsets[ops[i]]);
+        }
+    }
+
+    // every argument comes from memory or is recomputed, so loading them in order can not clobber one
+    while (i > 0) {
+        i--;
+        fastgen_load(c, abi_arg_regs[i], ops[i]);
+    }
+
+    if ((inst->flags & IR_FLAG_TAIL) != 0) {
+        abi_emit_tail_call(c->text, c->elf, c->sec, &c->frame, c->func_syms[inst->imm]);
+        return;
+    }
+
+    abi_emit_call(c->text, c->elf, c->sec, c->func_syms[inst->imm], (callee->flags & IR_FUNC_VARARGS) != 0);
+    abi_emit_call_cleanup(c->text, stack_bytes);
+
+    if (inst->ty != IR_TYPE_VOID) {
+        fastgen_store(c, v, X64_RAX);
+    }
+}
+
+// writes the operands of the edge into the incoming slots of the target's phis
+void fastgen_edge(Codegen *c, IrBlockId from, IrBlockId to) {
+    IrFunc *f = c->f;
+    IrBlock *block = &f->blocks[to];
+    int32_t k = -1;
+    uint32_t i = 0;
+
+    while (i < block->num_insts && f->insts[block->insts[i]].op == IR_PHI) {
+        IrValue phi = block->insts[i];
+        int32_t incoming = c->frame_offsets[phi] - 8;
+
+        k = k < 0 ? ir_pred_index(f, to, from) : k;
+        IrValue value = ir_inst_ops(f, &f->insts[phi])[k];
+
+        if (codegen_is_imm(f, value)) {
+            x64_store_imm(c->text, 8, X64_RBP, incoming, (int32_t) f->insts[value].imm);
+        } else {
+            fastgen_load(c, X64_RAX, value);
+            x64_store(c->text, 8, X64_RBP, incoming, X64_RAX);
+        }
+
+        i++;
+    }
+}
+
+void fastgen_branch(Codegen *c, IrBlockId b, IrInst *inst) {
+    IrBlockId then_block = inst->u.ops[1];
+    IrBlockId else_block = inst->u.ops[2];
+
+    // the incoming slots are only read by the block they belong to, so both edges can be written up front
+    fastgen_edge(c, b, then_block);
+
+    if (else_block != then_block) {
+        fastgen_edge(c, b, else_block);
+    }
+
+    fastgen_load(c, X64_RAX, inst->u.ops[0]);
+    x64_test_rr(c->text, 4, X64_RAX, X64_RAX);
+
+    if (then_block == c->next_block) {
+        codegen_jump(c, true, X64_CC_E, else_block);
+    } else {
+        codegen_jump(c, true, X64_CC_NE, then_block);
+
+        if (else_block != c->next_block) {
+            codegen_jump(c, false, X64_CC_O, else_block);
+        }
+    }
+}
+
+void fastgen_inst(Codegen *c, IrBlockId b, IrValue v) {
+    IrFunc *f = c->f;
+    IrInst *inst = &f->insts[v];
+
+    c->num_insts++;
+
+    switch (inst->op) {
+        case IR_PARAM:
+            if (inst->imm < ABI_NUM_ARG_REGS) {
+                fastgen_store(c, v, abi_arg_regs[inst->imm]);
+            }
+            break;
+        case IR_PHI:
+            x64_load(c->text, 8, X64_RAX, X64_RBP, c->frame_offsets[v] - 8);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_AND:
+        case IR_OR:
+        case IR_XOR:
+        case IR_SHL:
+        case IR_SHR:
+            fastgen_binary(c, v, inst);
+            break;
+        case IR_NEG:
+        case IR_NOT:
+            fastgen_load(c, X64_RAX, inst->u.ops[0]);
+            x64_unary(c->text, inst->op == IR_NEG ? X64_EXT_NEG : X64_EXT_NOT, codegen_reg_size(inst->ty), X64_RAX);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE: {
+            IrTypeId ty = f->insts[inst->u.ops[0]].ty;
+
+            fastgen_load(c, X64_RAX, inst->u.ops[0]);
+            fastgen_alu_rhs(c, (IrOp) inst->op, codegen_reg_size(ty), X64_RAX, inst->u.ops[1]);
+            x64_setcc(c->text, codegen_cond((IrOp) inst->op, ty == IR_TYPE_PTR), X64_RAX);
+            x64_movzx8(c->text, X64_RAX, X64_RAX);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        }
+        case IR_SEXT:
+        case IR_ZEXT:
+        case IR_TRUNC:
+        case IR_PTR_TO_INT:
+        case IR_INT_TO_PTR:
+            fastgen_load(c, X64_RAX, inst->u.ops[0]);
+            codegen_convert(c, inst, f->insts[inst->u.ops[0]].ty, X64_RAX, X64_RAX);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        case IR_SELECT:
+            fastgen_load(c, X64_RCX, inst->u.ops[0]);
+            fastgen_load(c, X64_RAX, inst->u.ops[2]);
+            fastgen_load(c, X64_RDX, inst->u.ops[1]);
+            x64_test_rr(c->text, 4, X64_RCX, X64_RCX);
+            x64_cmov(c->text, X64_CC_NE, 8, X64_RAX, X64_RDX);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        case IR_COPY:
+            fastgen_load(c, X64_RAX, inst->u.ops[0]);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        case IR_LOAD: {
+            X64Reg base;
+            int32_t disp = 0;
+
+            fastgen_addr(c, inst->u.ops[0], X64_RAX, &base, &disp);
+            x64_load(c->text, codegen_mem_size(inst->ty), X64_RAX, base, disp);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        }
+        case IR_STORE: {
+            X64Reg base;
+            int32_t disp = 0;
+            IrValue value = inst->u.ops[1];
+            int32_t size = codegen_mem_size(f->insts[value].ty);
+
+            fastgen_addr(c, inst->u.ops[0], X64_RAX, &base, &disp);
+
+            if (codegen_is_imm(f, value)) {
+                x64_store_imm(c->text, size, base, disp, (int32_t) f->insts[value].imm);
+            } else {
+                fastgen_load(c, X64_RCX, value);
+                x64_store(c->text, size, base, disp, X64_RCX);
+            }
+            break;
+        }
+        case IR_OFFSET:
+            if (!regalloc_is_remat(f, v)) {
+                fastgen_load(c, X64_RAX, inst->u.ops[0]);
+                x64_lea(c->text, X64_RAX, X64_RAX, (int32_t) inst->imm);
+                fastgen_store(c, v, X64_RAX);
+            }
+            break;
+        case IR_MEMCPY: {
+            X64Reg dst_base;
+            X64Reg src_base;
+            int32_t dst_disp = 0;
+            int32_t src_disp = 0;
+
+            fastgen_addr(c, inst->u.ops[0], X64_RDX, &dst_base, &dst_disp);
+            fastgen_addr(c, inst->u.ops[1], X64_RCX, &src_base, &src_disp);
+            codegen_copy_bytes(c, dst_base, dst_disp, src_base, src_disp, (int32_t) inst->imm);
+            break;
+        }
+        case IR_NEW:
+            x64_mov_ri(c->text, 4, X64_RDI, inst->imm);
+            abi_emit_call(c->text, c->elf, c->sec, c->malloc_sym, false);
+            fastgen_store(c, v, X64_RAX);
+            break;
+        case IR_DELETE:
+            fastgen_load(c, X64_RDI, inst->u.ops[0]);
+            abi_emit_call(c->text, c->elf, c->sec, c->free_sym, false);
+            break;
+        case IR_CALL:
+            fastgen_call(c, v, inst);
+            break;
+        case IR_BR:
+            fastgen_edge(c, b, inst->u.ops[0]);
+
+            if (inst->u.ops[0] != c->next_block) {
+                codegen_jump(c, false, X64_CC_O, inst->u.ops[0]);
+            }
+            break;
+        case IR_CBR:
+            fastgen_branch(c, b, inst);
+            break;
+        case IR_RET:
+            if (inst->num_ops > 0) {
+                fastgen_load(c, X64_RAX, inst->u.ops[0]);
+            }
+
+            abi_emit_epilogue(c->text, &c->frame);
+            break;
+        case IR_UNREACHABLE:
+            x64_ud2(c->text);
+            break;
+        default:
+            // constants and addresses are recomputed where they are used
+            c->num_insts--;
+            break;
+    }
+}
+
+void fastgen_func(Codegen *c, IrFunc *f) {
+    c->f = f;
+    codegen_reserve(c, f);
+    fastgen_layout_frame(c);
+
+    buf_align(c->text, 16);
+    uint32_t start = c->text->len;
+
+    abi_emit_prologue(c->text, &c->frame);
+
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        c->block_offsets[b] = c->text->len;
+        c->block_secs[b] = (uint8_t) c->sec;
+        c->next_block = b + 1 < f->num_blocks ? b + 1 : IR_NO_BLOCK;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            fastgen_inst(c, b, v);
+            i++;
+
+            // the return after a tail call is never reached
+            if (f->insts[v].op == IR_CALL && (f->insts[v].flags & IR_FLAG_TAIL) != 0) {
+                break;
+            }
+        }
+
+        b++;
+    }
+
+    codegen_finish_func(c, start);
+}
@@ -19,6 +19,7 @@ void func_add_param(ParamList *pl, Param *p) {
 FuncDef func_create(Token ident, ParamList params, Type ret_ty, bool is_extern) {
     FuncDef func_def = {
         .is_extern = is_extern,
+        .inline_hint = FUNC_INLINE_AUTO,
         .name = ident_create(ident),
         .ret_ty = ret_ty,
         .params = params
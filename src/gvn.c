@@ -0,0 +1,415 @@
+#include <string.h>
+
+#include "../include/gvn.h"
+#include "../include/timer.h"
+
+// the class of all memory that is not a stack slot of its own
+#define GVN_ANY_MEMORY 0
+
+Gvn gvn_create() {
+    Gvn g;
+    memset((void *) &g, 0, sizeof(Gvn));
+
+    g.inserted = vec_create(sizeof(uint32_t));
+    g.undo = vec_create(sizeof(GvnUndo));
+    g.frames = vec_create(sizeof(GvnFrame));
+
+    return g;
+}
+
+void gvn_free(Gvn *g) {
+    free((void *) g->vn);
+    free((void *) g->gen);
+    free((void *) g->escaped);
+    free((void *) g->table);
+    vec_free(&g->inserted);
+    vec_free(&g->undo);
+    vec_free(&g->frames);
+}
+
+void gvn_reserve(Gvn *g, IrFunc *f) {
+    if (f->num_insts > g->cap_insts) {
+        g->cap_insts = f->num_insts * 2;
+        g->vn = (IrValue *) realloc((void *) g->vn, g->cap_insts * sizeof(IrValue));
+        g->gen = (uint32_t *) realloc((void *) g->gen, g->cap_insts * sizeof(uint32_t));
+        g->escaped = (bool *) realloc((void *) g->escaped, g->cap_insts * sizeof(bool));
+    }
+
+    // every value and store gets at most one entry, so the table stays at most half full
+    uint32_t cap = 64;
+    while (cap < f->num_insts * 2 + 2) {
+        cap *= 2;
+    }
+
+    if (cap > g->cap_table) {
+        g->cap_table = cap;
+        g->table = (GvnEntry *) realloc((void *) g->table, cap * sizeof(GvnEntry));
+    }
+
+    memset((void *) g->table, 0, g->cap_table * sizeof(GvnEntry));
+    memset((void *) g->gen, 0, f->num_insts * sizeof(uint32_t));
+    memset((void *) g->escaped, 0, f->num_insts * sizeof(bool));
+
+    IrValue v = 0;
+    while (v < f->num_insts) {
+        g->vn[v] = v;
+        v++;
+    }
+
+    g->f = f;
+    g->join_gen = 0;
+    g->next_gen = 0;
+    g->inserted.len = 0;
+    g->undo.len = 0;
+    g->frames.len = 0;
+}
+
+IrValue gvn_class(Gvn *g, IrValue ptr) {
+    IrValue base = ir_ptr_base(g->f, ptr);
+
+    return g->f->insts[base].op == IR_ALLOCA && !g->escaped[base] ? base : GVN_ANY_MEMORY;
+}
+
+void gvn_bump(Gvn *g, IrValue cls) {
+    GvnUndo undo = { cls, g->gen[cls] };
+
+    vec_push(&g->undo, (void *) &undo);
+    g->gen[cls] = ++g->next_gen;
+}
+
+uint64_t gvn_hash(GvnEntry *e) {
+    uint64_t h = (uint64_t) e->op * 0x9e3779b97f4a7c15ull;
+
+    h = (h ^ e->ty) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (uint64_t) e->imm) * 0x94d049bb133111ebull;
+    h = (h ^ e->ops[0]) * 0x9e3779b97f4a7c15ull;
+    h = (h ^ e->ops[1]) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ e->ops[2]) * 0x94d049bb133111ebull;
+
+    return h ^ (h >> 31);
+}
+
+bool gvn_same(GvnEntry *a, GvnEntry *b) {
+    return a->hash == b->hash && a->op == b->op && a->ty == b->ty && a->imm == b->imm && a->ops[0] == b->ops[0] &&
+        a->ops[1] == b->ops[1] && a->ops[2] == b->ops[2];
+}
+
+// the value of an equal expression in scope, or key's value after adding it
+IrValue gvn_lookup_or_insert(Gvn *g, GvnEntry *key) {
+    uint32_t mask = g->cap_table - 1;
+    uint32_t i = (uint32_t) (key->hash >> 32) & mask;
+
+    while (g->table[i].v != IR_NO_VALUE) {
+        if (gvn_same(&g->table[i], key)) {
+            return g->table[i].v;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    g->table[i] = *key;
+    vec_push(&g->inserted, (void *) &i);
+
+    return key->v;
+}
+
+bool gvn_is_commutative(IrOp op) {
+    return op == IR_ADD || op == IR_MUL || op == IR_AND || op == IR_OR || op == IR_XOR || op == IR_EQ || op == IR_NE;
+}
+
+bool gvn_is_pure(IrOp op) {
+    switch (op) {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_STR:
+        case IR_GLOBAL:
+        case IR_FUNC_ADDR:
+        case IR_SEXT:
+        case IR_ZEXT:
+        case IR_TRUNC:
+        case IR_PTR_TO_INT:
+        case IR_INT_TO_PTR:
+        case IR_SELECT:
+        case IR_OFFSET:
+        case IR_NEG:
+        case IR_NOT:
+            return true;
+        default:
+            return ir_op_is_binary(op) || ir_op_is_compare(op);
+    }
+}
+
+GvnEntry gvn_key(Gvn *g, IrValue v) {
+    IrInst *inst = &g->f->insts[v];
+    GvnEntry key;
+
+    memset((void *) &key, 0, sizeof(GvnEntry));
+    key.v = v;
+    key.op = inst->op;
+    key.ty = inst->ty;
+    key.imm = inst->imm;
+
+    uint32_t i = 0;
+    while (i < inst->num_ops) {
+        key.ops[i] = inst->u.ops[i];
+        i++;
+    }
+
+    if (gvn_is_commutative((IrOp) inst->op) && key.ops[1] < key.ops[0]) {
+        key.ops[0] = inst->u.ops[1];
+        key.ops[1] = inst->u.ops[0];
+    }
+
+    return key;
+}
+
+// what loading ty from ptr gives in the current generation of its memory
+GvnEntry gvn_load_key(Gvn *g, IrValue v, IrTypeId ty, IrValue ptr) {
+    GvnEntry key;
+
+    memset((void *) &key, 0, sizeof(GvnEntry));
+    key.v = v;
+    key.op = IR_LOAD;
+    key.ty = ty;
+    key.ops[0] = ptr;
+    key.ops[1] = g->gen[gvn_class(g, ptr)];
+    key.ops[2] = g->join_gen;
+    key.hash = gvn_hash(&key);
+
+    return key;
+}
+
+// a phi whose operands are all one value, or itself, is that value
+IrValue gvn_trivial_phi(Gvn *g, IrValue v) {
+    IrInst *inst = &g->f->insts[v];
+    IrValue *ops = ir_inst_ops(g->f, inst);
+    IrValue same = IR_NO_VALUE;
+    uint32_t i = 0;
+
+    while (i < inst->num_ops) {
+        if (ops[i] != v && ops[i] != same) {
+            if (same != IR_NO_VALUE) {
+                return v;
+            }
+
+            same = ops[i];
+        }
+
+        i++;
+    }
+
+    return same != IR_NO_VALUE ? same : v;
+}
+
+void gvn_number(Gvn *g, IrValue v) {
+    IrFunc *f = g->f;
+    IrInst *inst = &f->insts[v];
+    IrValue *ops = ir_inst_ops(f, inst);
+    uint32_t n = ir_inst_num_values(inst);
+    uint32_t i = 0;
+
+    while (i < n) {
+        ops[i] = g->vn[ops[i]];
+        i++;
+    }
+
+    switch (inst->op) {
+        case IR_PHI:
+            g->vn[v] = gvn_trivial_phi(g, v);
+            return;
+
+        case IR_COPY:
+            g->vn[v] = ops[0];
+            return;
+
+        case IR_LOAD: {
+            GvnEntry key = gvn_load_key(g, v, inst->ty, ops[0]);
+            g->vn[v] = gvn_lookup_or_insert(g, &key);
+            g->num_loads += g->vn[v] != v;
+            return;
+        }
+
+        case IR_STORE: {
+            IrValue value = ops[1];
+            IrTypeId ty = f->insts[value].ty;
+
+            gvn_bump(g, gvn_class(g, ops[0]));
+
+            // the next load of the same place reads the stored value back, narrow values are left to the
+            // load since loads and truncations do not widen them the same way
+            if (ty == IR_TYPE_I32 || ty == IR_TYPE_I64 || ty == IR_TYPE_PTR) {
+                GvnEntry key = gvn_load_key(g, value, ty, ops[0]);
+                gvn_lookup_or_insert(g, &key);
+            }
+
+            return;
+        }
+
+        case IR_MEMCPY:
+            gvn_bump(g, gvn_class(g, ops[0]));
+            return;
+
+        case IR_CALL:
+        case IR_NEW:
+        case IR_DELETE:
+            gvn_bump(g, GVN_ANY_MEMORY);
+            return;
+
+        default:
+            break;
+    }
+
+    if (!gvn_is_pure((IrOp) inst->op) || (inst->flags & IR_FLAG_EXTRA_OPS) != 0) {
+        return;
+    }
+
+    GvnEntry key = gvn_key(g, v);
+    key.hash = gvn_hash(&key);
+    g->vn[v] = gvn_lookup_or_insert(g, &key);
+}
+
+void gvn_enter(Gvn *g, IrBlockId b) {
+    IrFunc *f = g->f;
+    IrBlock *block = &f->blocks[b];
+    GvnFrame frame = { b, g->f->dom_child_off[b], (uint32_t) g->inserted.len, (uint32_t) g->undo.len, g->join_gen };
+    uint32_t i = 0;
+
+    vec_push(&g->frames, (void *) &frame);
+
+    // what other paths into the block stored is not known here
+    if (block->num_preds != 1) {
+        g->join_gen = ++g->next_gen;
+    }
+
+    while (i < block->num_insts) {
+        gvn_number(g, block->insts[i]);
+        i++;
+    }
+}
+
+// entries leave the table in the reverse order they came in, so the probe sequences of the rest stay whole
+void gvn_leave(Gvn *g, GvnFrame *frame) {
+    while (g->inserted.len > frame->num_inserted) {
+        uint32_t slot = ((uint32_t *) g->inserted.elements)[--g->inserted.len];
+        g->table[slot].v = IR_NO_VALUE;
+    }
+
+    while (g->undo.len > frame->num_undo) {
+        GvnUndo *undo = &((GvnUndo *) g->undo.elements)[--g->undo.len];
+        g->gen[undo->cls] = undo->old;
+    }
+
+    g->join_gen = frame->join_gen;
+}
+
+void gvn_walk(Gvn *g) {
+    gvn_enter(g, 0);
+
+    while (g->frames.len > 0) {
+        GvnFrame *frame = (GvnFrame *) vec_get_ptr(&g->frames, g->frames.len - 1);
+
+        if (frame->next_child < g->f->dom_child_off[frame->b + 1]) {
+            IrBlockId child = g->f->dom_children[frame->next_child++];
+            gvn_enter(g, child);
+            continue;
+        }
+
+        GvnFrame done = *frame;
+        g->frames.len--;
+        gvn_leave(g, &done);
+    }
+}
+
+// back edge operands of phis are only numbered once the walk is over
+void gvn_rewrite(Gvn *g) {
+    IrFunc *f = g->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        bool removed = false;
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                ops[j] = g->vn[ops[j]];
+                j++;
+            }
+
+            if (g->vn[v] != v) {
+                ir_inst_remove(f, v);
+                g->num_removed++;
+                removed = true;
+            }
+
+            i++;
+        }
+
+        if (removed) {
+            ir_block_compact(f, b);
+        }
+
+        b++;
+    }
+}
+
+void gvn_func(Gvn *g, IrFunc *f) {
+    if (f->num_blocks == 0) {
+        return;
+    }
+
+    gvn_reserve(g, f);
+    ir_func_dominators(f);
+    ir_find_escaping_slots(f, g->escaped);
+    gvn_walk(g);
+    gvn_rewrite(g);
+}
+
+void *gvn_pass_create(IrModule *m, void *params) {
+    (void) m;
+    (void) params;
+
+    Gvn *g = (Gvn *) malloc(sizeof(Gvn));
+    *g = gvn_create();
+
+    return (void *) g;
+}
+
+bool gvn_pass_func(void *state, IrFunc *f) {
+    Gvn *g = (Gvn *) state;
+    int64_t before = g->num_removed + g->num_loads;
+
+    gvn_func(g, f);
+
+    return g->num_removed + g->num_loads != before;
+}
+
+void gvn_pass_finish(void *state) {
+    Gvn *g = (Gvn *) state;
+
+    timer_stat_add("gvn removed instructions", g->num_removed);
+    timer_stat_add("gvn reused loads", g->num_loads);
+
+    gvn_free(g);
+    free((void *) g);
+}
+
+// only instructions go, the CFG stays as it is
+Pass gvn_pass() {
+    Pass p = {
+        .name = "gvn",
+        .kind = PASS_FUNC,
+        .preserves = IR_ANALYSIS_ALL,
+        .create = gvn_pass_create,
+        .run_func = gvn_pass_func,
+        .finish = gvn_pass_finish
+    };
+
+    return p;
+}
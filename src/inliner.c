@@ -0,0 +1,741 @@
+#include <string.h>
+
+#include "../include/inliner.h"
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+#include "../include/trace.h"
+
+#define INLINER_UNVISITED UINT32_MAX
+
+InlineParams inliner_params(int32_t opt_level, int32_t threshold) {
+    InlineParams p = {
+        .threshold = opt_level >= 2 ? 40 : 15,
+        .call_bonus = 5,
+        .const_arg_bonus = 5,
+        .loop_bonus = 10,
+        .max_size = opt_level >= 2 ? 20000 : 5000
+    };
+
+    if (threshold >= 0) {
+        p.threshold = threshold;
+    }
+
+    return p;
+}
+
+Inliner inliner_create(IrModule *m, InlineParams params) {
+    Inliner in;
+    memset((void *) &in, 0, sizeof(Inliner));
+
+    in.m = m;
+    in.params = params;
+    in.num_funcs = ir_module_num_funcs(m);
+
+    in.callee_off = (uint32_t *) calloc(in.num_funcs + 1, sizeof(uint32_t));
+    in.index = (uint32_t *) malloc((in.num_funcs + 1) * sizeof(uint32_t));
+    in.low = (uint32_t *) malloc((in.num_funcs + 1) * sizeof(uint32_t));
+    in.scc = (uint32_t *) malloc((in.num_funcs + 1) * sizeof(uint32_t));
+    in.on_stack = (bool *) calloc(in.num_funcs + 1, sizeof(bool));
+    in.inlinable = (bool *) calloc(in.num_funcs + 1, sizeof(bool));
+    in.size = (int32_t *) malloc((in.num_funcs + 1) * sizeof(int32_t));
+
+    in.stack = vec_create(sizeof(uint32_t));
+    in.frames = vec_create(sizeof(InlineFrame));
+    in.members = vec_create(sizeof(uint32_t));
+    in.sites = vec_create(sizeof(IrValue));
+    in.work = vec_create(sizeof(IrBlockId));
+    in.rets = vec_create(sizeof(InlineRet));
+
+    return in;
+}
+
+void inliner_free(Inliner *in) {
+    free((void *) in->callee_off);
+    free((void *) in->callees);
+    free((void *) in->index);
+    free((void *) in->low);
+    free((void *) in->scc);
+    free((void *) in->on_stack);
+    free((void *) in->inlinable);
+    free((void *) in->size);
+    free((void *) in->block_depth);
+    free((void *) in->loop_mark);
+    free((void *) in->value_map);
+    free((void *) in->block_map);
+    vec_free(&in->stack);
+    vec_free(&in->frames);
+    vec_free(&in->members);
+    vec_free(&in->sites);
+    vec_free(&in->work);
+    vec_free(&in->rets);
+}
+
+// the blocks of the caller keep their depth while calls split them, so the arrays keep their contents
+void inliner_reserve_blocks(Inliner *in, uint32_t num_blocks) {
+    if (num_blocks > in->cap_blocks) {
+        in->cap_blocks = num_blocks * 2;
+        in->block_depth = (int32_t *) realloc((void *) in->block_depth, in->cap_blocks * sizeof(int32_t));
+        in->loop_mark = (uint32_t *) realloc((void *) in->loop_mark, in->cap_blocks * sizeof(uint32_t));
+    }
+}
+
+void inliner_reserve_callee(Inliner *in, IrFunc *g) {
+    if (g->num_insts > in->cap_values) {
+        in->cap_values = g->num_insts * 2;
+        in->value_map = (IrValue *) realloc((void *) in->value_map, in->cap_values * sizeof(IrValue));
+    }
+
+    if (g->num_blocks > in->cap_callee_blocks) {
+        in->cap_callee_blocks = g->num_blocks * 2;
+        in->block_map = (IrBlockId *) realloc((void *) in->block_map, in->cap_callee_blocks * sizeof(IrBlockId));
+    }
+}
+
+IrFunc *inliner_callee(Inliner *in, IrInst *inst) {
+    if (inst->op != IR_CALL) {
+        return NULL;
+    }
+
+    IrFunc *g = ir_module_func(in->m, (uint32_t) inst->imm);
+    return (g->flags & IR_FUNC_EXTERN) == 0 ? g : NULL;
+}
+
+// constants, parameters and copies mostly end up as immediates or nothing at all, calls cost their arguments
+int32_t inliner_func_size(IrFunc *f) {
+    int32_t size = 0;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+
+            switch (inst->op) {
+                case IR_NOP:
+                case IR_CONST:
+                case IR_PARAM:
+                case IR_COPY:
+                    break;
+
+                case IR_CALL:
+                    size += 1 + inst->num_ops;
+                    break;
+
+                default:
+                    size++;
+                    break;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    return size;
+}
+
+// a body can only be copied if its entry block is not a loop header and it returns at all
+bool inliner_can_inline(IrFunc *f) {
+    if ((f->flags & IR_FUNC_EXTERN) || f->num_blocks == 0 || f->blocks[0].num_preds > 0) {
+        return false;
+    }
+
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrValue term = ir_block_terminator(f, b);
+
+        if (term != IR_NO_VALUE && f->insts[term].op == IR_RET) {
+            return true;
+        }
+
+        b++;
+    }
+
+    return false;
+}
+
+void inliner_build_graph(Inliner *in) {
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    while (i < in->num_funcs) {
+        IrFunc *f = ir_module_func(in->m, i);
+        IrBlockId b = 0;
+
+        in->callee_off[i] = total;
+
+        while (b < f->num_blocks) {
+            IrBlock *block = &f->blocks[b];
+            uint32_t j = 0;
+
+            while (j < block->num_insts) {
+                total += inliner_callee(in, &f->insts[block->insts[j]]) != NULL;
+                j++;
+            }
+
+            b++;
+        }
+
+        in->index[i] = INLINER_UNVISITED;
+        in->inlinable[i] = inliner_can_inline(f);
+        in->size[i] = inliner_func_size(f);
+        i++;
+    }
+
+    in->callee_off[in->num_funcs] = total;
+    in->callees = (uint32_t *) malloc((total + 1) * sizeof(uint32_t));
+
+    i = 0;
+    while (i < in->num_funcs) {
+        IrFunc *f = ir_module_func(in->m, i);
+        uint32_t k = in->callee_off[i];
+        IrBlockId b = 0;
+
+        while (b < f->num_blocks) {
+            IrBlock *block = &f->blocks[b];
+            uint32_t j = 0;
+
+            while (j < block->num_insts) {
+                IrFunc *g = inliner_callee(in, &f->insts[block->insts[j]]);
+
+                if (g != NULL) {
+                    in->callees[k++] = g->idx;
+                }
+
+                j++;
+            }
+
+            b++;
+        }
+
+        i++;
+    }
+}
+
+// the natural loop of every header is found walking backwards from the blocks that jump back to it
+void inliner_loop_depths(Inliner *in, IrFunc *f) {
+    IrBlockId h = 0;
+
+    ir_func_dominators(f);
+    inliner_reserve_blocks(in, f->num_blocks);
+    memset((void *) in->block_depth, 0, f->num_blocks * sizeof(int32_t));
+
+    while (h < f->num_blocks) {
+        in->loop_mark[h] = IR_NO_BLOCK;
+        h++;
+    }
+
+    h = 0;
+    while (h < f->num_blocks) {
+        IrBlock *header = &f->blocks[h];
+        uint32_t i = 0;
+
+        in->work.len = 0;
+
+        while (i < header->num_preds) {
+            IrBlockId p = header->preds[i];
+
+            if (header->idom != IR_NO_BLOCK && f->blocks[p].idom != IR_NO_BLOCK && ir_dominates(f, h, p)) {
+                vec_push(&in->work, (void *) &p);
+            }
+
+            i++;
+        }
+
+        if (in->work.len > 0) {
+            in->loop_mark[h] = h;
+            in->block_depth[h]++;
+        }
+
+        while (in->work.len > 0) {
+            IrBlockId x = *(IrBlockId *) vec_get_ptr(&in->work, in->work.len - 1);
+            in->work.len--;
+
+            if (in->loop_mark[x] == h) {
+                continue;
+            }
+
+            in->loop_mark[x] = h;
+            in->block_depth[x]++;
+            i = 0;
+
+            while (i < f->blocks[x].num_preds) {
+                IrBlockId q = f->blocks[x].preds[i];
+
+                if (f->blocks[q].idom != IR_NO_BLOCK && in->loop_mark[q] != h) {
+                    vec_push(&in->work, (void *) &q);
+                }
+
+                i++;
+            }
+        }
+
+        h++;
+    }
+}
+
+// with a profile every factor of ten the call site ran more often than its function was entered counts as a loop
+// around it, and a call site that never ran is -1
+int32_t inliner_site_depth(Inliner *in, IrFunc *f, IrBlockId b) {
+    if ((f->flags & IR_FUNC_PROFILED) == 0) {
+        return in->block_depth[b];
+    }
+
+    int64_t freq = f->blocks[b].freq;
+    int64_t scale = f->blocks[0].freq > 0 ? f->blocks[0].freq : 1;
+    int32_t depth = 0;
+
+    if (freq == 0) {
+        return -1;
+    }
+
+    while (depth < INLINER_MAX_LOOP_DEPTH && freq / 10 >= scale) {
+        freq /= 10;
+        depth++;
+    }
+
+    return depth;
+}
+
+bool inliner_should_inline(Inliner *in, IrFunc *f, IrValue v, IrFunc *g) {
+    InlineParams *p = &in->params;
+    IrInst *call = &f->insts[v];
+
+    if (g->flags & IR_FUNC_NOINLINE) {
+        TRACE_DEBUG(TRACE_CAT_INLINE, "%s -> %s: kept, noinline fn", f->name, g->name);
+        return false;
+    }
+
+    if (!in->inlinable[g->idx]) {
+        TRACE_DEBUG(TRACE_CAT_INLINE, "%s -> %s: kept, never returns", f->name, g->name);
+        return false;
+    }
+
+    if (in->scc[g->idx] == in->scc[f->idx]) {
+        TRACE_DEBUG(TRACE_CAT_INLINE, "%s -> %s: kept, recursive", f->name, g->name);
+        return false;
+    }
+
+    if (g->flags & IR_FUNC_INLINE) {
+        TRACE_DEBUG(TRACE_CAT_INLINE, "%s -> %s: inlined, inline fn", f->name, g->name);
+        return true;
+    }
+
+    int32_t depth = inliner_site_depth(in, f, call->block);
+
+    if (depth < 0) {
+        TRACE_DEBUG(TRACE_CAT_INLINE, "%s -> %s: kept, call site never ran", f->name, g->name);
+        return false;
+    }
+
+    IrValue *args = ir_inst_ops(f, call);
+    int32_t budget = p->threshold + p->call_bonus + call->num_ops;
+    uint32_t i = 0;
+
+    while (i < call->num_ops) {
+        budget += f->insts[args[i]].op == IR_CONST ? p->const_arg_bonus : 0;
+        i++;
+    }
+
+    budget += p->loop_bonus * (depth > INLINER_MAX_LOOP_DEPTH ? INLINER_MAX_LOOP_DEPTH : depth);
+
+    bool ok = in->size[g->idx] <= budget && in->size[f->idx] + in->size[g->idx] <= p->max_size;
+    TRACE_DEBUG(TRACE_CAT_INLINE, "%s -> %s: %s, size %d, budget %d, loop depth %d", f->name, g->name,
+        ok ? "inlined" : "kept", in->size[g->idx], budget, depth);
+
+    return ok;
+}
+
+// a profiled callee's counts are over all its calls, this call site gets its share of them
+int64_t inliner_scale_freq(int64_t site, IrFunc *g, IrBlockId cb) {
+    if ((g->flags & IR_FUNC_PROFILED) == 0 || g->blocks[0].freq <= 0) {
+        return site;
+    }
+
+    return (int64_t) ((double) g->blocks[cb].freq * (double) site / (double) g->blocks[0].freq);
+}
+
+// splits the call's block after the call, copies the callee's blocks in between and turns its returns into
+// jumps to the second half. the call itself becomes a copy of the returned value, so its uses stay as they are
+void inliner_inline_call(Inliner *in, IrFunc *f, IrValue call, IrFunc *g) {
+    IrBlockId b = f->insts[call].block;
+    IrValue *args = ir_inst_ops(f, &f->insts[call]);
+    uint32_t pos = 0;
+
+    while (f->blocks[b].insts[pos] != call) {
+        pos++;
+    }
+
+    // the call's block is split around the callee's blocks
+    ir_func_invalidate(f, IR_ANALYSIS_ALL);
+
+    // parameters become the arguments, read before new instructions can move the operand arrays
+    inliner_reserve_callee(in, g);
+    memset((void *) in->value_map, 0, g->num_insts * sizeof(IrValue));
+
+    IrValue v = 1;
+    while (v < g->num_insts) {
+        if (g->insts[v].op == IR_PARAM) {
+            in->value_map[v] = args[g->insts[v].imm];
+        }
+
+        v++;
+    }
+
+    IrBlockId cont = ir_block_create(f);
+    inliner_reserve_blocks(in, f->num_blocks + g->num_blocks);
+    in->block_depth[cont] = in->block_depth[b];
+    f->blocks[cont].freq = f->blocks[b].freq;
+
+    uint32_t i = pos + 1;
+    while (i < f->blocks[b].num_insts) {
+        ir_block_append(f, cont, f->blocks[b].insts[i]);
+        i++;
+    }
+
+    f->blocks[b].num_insts = pos;
+
+    // the terminator moved, and with it the edges out of the block
+    IrBlock *head = &f->blocks[b];
+    IrBlock *tail = &f->blocks[cont];
+
+    tail->succs = head->succs;
+    tail->num_succs = head->num_succs;
+    tail->cap_succs = head->cap_succs;
+    head->succs = NULL;
+    head->num_succs = 0;
+    head->cap_succs = 0;
+
+    i = 0;
+    while (i < tail->num_succs) {
+        IrBlock *succ = &f->blocks[tail->succs[i]];
+        uint32_t j = 0;
+
+        while (j < succ->num_preds) {
+            succ->preds[j] = succ->preds[j] == b ? cont : succ->preds[j];
+            j++;
+        }
+
+        i++;
+    }
+
+    IrBlockId cb = 0;
+    while (cb < g->num_blocks) {
+        IrBlockId nb = ir_block_create(f);
+
+        in->block_map[cb] = nb;
+        in->block_depth[nb] = in->block_depth[b];
+        f->blocks[nb].freq = inliner_scale_freq(f->blocks[b].freq, g, cb);
+
+        cb++;
+    }
+
+    // edges are copied in order, so the phis keep the operand order they had
+    cb = 0;
+    while (cb < g->num_blocks) {
+        IrBlock *src = &g->blocks[cb];
+        IrBlock *dst = &f->blocks[in->block_map[cb]];
+
+        if (src->num_preds > 0) {
+            dst->preds = (IrBlockId *) ir_arena_alloc(&f->arena, src->num_preds * sizeof(IrBlockId));
+            dst->num_preds = dst->cap_preds = src->num_preds;
+        }
+
+        if (src->num_succs > 0) {
+            dst->succs = (IrBlockId *) ir_arena_alloc(&f->arena, src->num_succs * sizeof(IrBlockId));
+            dst->num_succs = dst->cap_succs = src->num_succs;
+        }
+
+        i = 0;
+        while (i < src->num_preds) {
+            dst->preds[i] = in->block_map[src->preds[i]];
+            i++;
+        }
+
+        i = 0;
+        while (i < src->num_succs) {
+            dst->succs[i] = in->block_map[src->succs[i]];
+            i++;
+        }
+
+        cb++;
+    }
+
+    // instructions are created first and get their operands once every value has its copy
+    cb = 0;
+    while (cb < g->num_blocks) {
+        IrBlock *block = &g->blocks[cb];
+        i = 0;
+
+        while (i < block->num_insts) {
+            IrValue gv = block->insts[i];
+            IrInst *inst = &g->insts[gv];
+
+            if (inst->op != IR_PARAM && inst->op != IR_NOP) {
+                bool is_ret = inst->op == IR_RET;
+                IrValue nv = ir_inst_create(f, is_ret ? IR_BR : inst->op, is_ret ? IR_TYPE_VOID : inst->ty, is_ret ? 1 : inst->num_ops);
+
+                // a `become` in the callee ends the inlined body, not the caller
+                f->insts[nv].flags |= inst->flags & ~(IR_FLAG_EXTRA_OPS | IR_FLAG_TAIL | IR_FLAG_MUST_TAIL);
+                f->insts[nv].imm = is_ret ? 0 : inst->imm;
+                ir_block_append(f, in->block_map[cb], nv);
+                in->value_map[gv] = nv;
+            }
+
+            i++;
+        }
+
+        cb++;
+    }
+
+    in->rets.len = 0;
+    cb = 0;
+
+    while (cb < g->num_blocks) {
+        IrBlock *block = &g->blocks[cb];
+        i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &g->insts[block->insts[i]];
+
+            if (inst->op == IR_PARAM || inst->op == IR_NOP) {
+                i++;
+                continue;
+            }
+
+            IrValue *ops = ir_inst_ops(g, inst);
+            IrValue *new_ops = ir_inst_ops(f, &f->insts[in->value_map[block->insts[i]]]);
+
+            if (inst->op == IR_RET) {
+                InlineRet ret = {
+                    .block = in->block_map[cb],
+                    .value = inst->num_ops > 0 ? in->value_map[ops[0]] : IR_NO_VALUE
+                };
+
+                new_ops[0] = cont;
+                ir_add_edge(f, ret.block, cont);
+                vec_push(&in->rets, (void *) &ret);
+            } else {
+                uint32_t num_values = ir_inst_num_values(inst);
+                uint32_t j = 0;
+
+                while (j < inst->num_ops) {
+                    new_ops[j] = j < num_values ? in->value_map[ops[j]] : in->block_map[ops[j]];
+                    j++;
+                }
+            }
+
+            i++;
+        }
+
+        cb++;
+    }
+
+    IrBuilder builder = ir_builder_create(in->m, f);
+    ir_builder_set_block(&builder, b);
+    ir_build_br(&builder, in->block_map[0]);
+
+    if (f->insts[call].ty == IR_TYPE_VOID) {
+        ir_inst_remove(f, call);
+        return;
+    }
+
+    IrValue result = ((InlineRet *) vec_get_ptr(&in->rets, 0))->value;
+
+    if (in->rets.len > 1) {
+        result = ir_build_phi_in(f, cont, f->insts[call].ty, in->rets.len);
+        IrValue *ops = ir_inst_ops(f, &f->insts[result]);
+        i = 0;
+
+        while (i < in->rets.len) {
+            ops[i] = ((InlineRet *) vec_get_ptr(&in->rets, i))->value;
+            i++;
+        }
+    }
+
+    IrInst *inst = &f->insts[call];
+    ir_inst_set_num_ops(f, inst, 1);
+    inst->op = IR_COPY;
+    inst->imm = 0;
+    ir_inst_ops(f, inst)[0] = result;
+    ir_block_insert(f, cont, in->rets.len > 1, call);
+}
+
+void inliner_func(Inliner *in, IrFunc *f) {
+    if (f->num_blocks == 0) {
+        return;
+    }
+
+    in->sites.len = 0;
+
+    // the calls are collected first, the blocks they are in change as calls before them are inlined
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            if (inliner_callee(in, &f->insts[block->insts[i]]) != NULL) {
+                vec_push(&in->sites, (void *) &block->insts[i]);
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    // the loops only weigh the call sites, a function without any is left alone
+    if (in->sites.len == 0) {
+        return;
+    }
+
+    inliner_loop_depths(in, f);
+
+    uint32_t i = 0;
+    while (i < in->sites.len) {
+        IrValue v = *(IrValue *) vec_get_ptr(&in->sites, i);
+        IrFunc *g = ir_module_func(in->m, (uint32_t) f->insts[v].imm);
+
+        in->num_sites++;
+
+        if (inliner_should_inline(in, f, v, g)) {
+            inliner_inline_call(in, f, v, g);
+            in->size[f->idx] += in->size[g->idx];
+            in->num_inlined++;
+        }
+
+        i++;
+    }
+}
+
+// inlines into every function of a component, then measures them again for the components that call them
+void inliner_scc(Inliner *in) {
+    uint32_t i = 0;
+
+    while (i < in->members.len) {
+        IrFunc *f = ir_module_func(in->m, *(uint32_t *) vec_get_ptr(&in->members, i));
+
+        if ((f->flags & IR_FUNC_EXTERN) == 0) {
+            inliner_func(in, f);
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < in->members.len) {
+        uint32_t idx = *(uint32_t *) vec_get_ptr(&in->members, i);
+        in->size[idx] = inliner_func_size(ir_module_func(in->m, idx));
+
+        i++;
+    }
+}
+
+// Tarjan's algorithm with an explicit stack, a component is complete when the walk returns to its root
+void inliner_visit(Inliner *in, uint32_t root) {
+    InlineFrame frame = {
+        .func = root,
+        .next_edge = in->callee_off[root]
+    };
+
+    in->index[root] = in->low[root] = in->next_index++;
+    in->on_stack[root] = true;
+    vec_push(&in->stack, (void *) &root);
+    vec_push(&in->frames, (void *) &frame);
+
+    while (in->frames.len > 0) {
+        InlineFrame *top = (InlineFrame *) vec_get_ptr(&in->frames, in->frames.len - 1);
+        uint32_t v = top->func;
+
+        if (top->next_edge < in->callee_off[v + 1]) {
+            uint32_t w = in->callees[top->next_edge++];
+
+            if (in->index[w] == INLINER_UNVISITED) {
+                InlineFrame next = {
+                    .func = w,
+                    .next_edge = in->callee_off[w]
+                };
+
+                in->index[w] = in->low[w] = in->next_index++;
+                in->on_stack[w] = true;
+                vec_push(&in->stack, (void *) &w);
+                vec_push(&in->frames, (void *) &next);
+            } else if (in->on_stack[w] && in->index[w] < in->low[v]) {
+                in->low[v] = in->index[w];
+            }
+
+            continue;
+        }
+
+        in->frames.len--;
+
+        if (in->frames.len > 0) {
+            uint32_t parent = ((InlineFrame *) vec_get_ptr(&in->frames, in->frames.len - 1))->func;
+            in->low[parent] = in->low[v] < in->low[parent] ? in->low[v] : in->low[parent];
+        }
+
+        if (in->low[v] != in->index[v]) {
+            continue;
+        }
+
+        in->members.len = 0;
+
+        while (true) {
+            uint32_t w = *(uint32_t *) vec_get_ptr(&in->stack, in->stack.len - 1);
+            in->stack.len--;
+
+            in->on_stack[w] = false;
+            in->scc[w] = in->index[v];
+            vec_push(&in->members, (void *) &w);
+
+            if (w == v) {
+                break;
+            }
+        }
+
+        inliner_scc(in);
+    }
+}
+
+void inliner_module(IrModule *m, InlineParams params) {
+    int32_t tt = TIMETRACE_BEGIN("inline", 0, NULL, 0, NULL);
+    Inliner in = inliner_create(m, params);
+    uint32_t i = 0;
+
+    inliner_build_graph(&in);
+
+    while (i < in.num_funcs) {
+        if (in.index[i] == INLINER_UNVISITED) {
+            inliner_visit(&in, i);
+        }
+
+        i++;
+    }
+
+    timer_stat_add("inliner call sites", in.num_sites);
+    timer_stat_add("inliner inlined calls", in.num_inlined);
+
+    inliner_free(&in);
+    TIMETRACE_END(tt);
+}
+
+void inliner_pass_module(IrModule *m, void *params) {
+    inliner_module(m, *(InlineParams *) params);
+}
+
+Pass inliner_pass(InlineParams *params) {
+    Pass p = {
+        .name = "inline",
+        .kind = PASS_MODULE,
+        .preserves = 0,
+        .params = (void *) params,
+        .run_module = inliner_pass_module
+    };
+
+    return p;
+}
@@ -0,0 +1,1950 @@
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/utils.h"
+
+_Static_assert(sizeof(IrInst) == 32, "IrInst should stay 32 bytes");
+
+static char const *const ir_op_names[] = {
+    "nop",
+    "const",
+    "param",
+    "str",
+    "global",
+    "func_addr",
+    "add",
+    "sub",
+    "mul",
+    "div",
+    "mod",
+    "and",
+    "or",
+    "xor",
+    "shl",
+    "shr",
+    "neg",
+    "not",
+    "eq",
+    "ne",
+    "lt",
+    "le",
+    "gt",
+    "ge",
+    "sext",
+    "zext",
+    "trunc",
+    "ptr_to_int",
+    "int_to_ptr",
+    "select",
+    "copy",
+    "phi",
+    "alloca",
+    "load",
+    "store",
+    "offset",
+    "memcpy",
+    "new",
+    "delete",
+    "call",
+    "splat",
+    "extract",
+    "cpu_feature",
+    "br",
+    "cbr",
+    "ret",
+    "unreachable"
+};
+
+static char const *const ir_type_names[] = {
+    "void",
+    "i1",
+    "i8",
+    "i32",
+    "i64",
+    "ptr",
+    "v4i32",
+    "v8i32"
+};
+
+_Static_assert(sizeof(ir_op_names) / sizeof(char *) == IR_NUM_OPS, "every IrOp needs a name");
+
+void *ir_arena_alloc(IrArena *a, size_t size) {
+    size = (size + 7) & ~(size_t) 7;
+
+    if (a->head == NULL || a->head->used + size > a->head->cap) {
+        // chunks double up to IR_ARENA_CHUNK, so small functions do not pay for a full chunk each
+        size_t cap = a->total < IR_ARENA_MIN_CHUNK ? IR_ARENA_MIN_CHUNK : a->total;
+        cap = cap > IR_ARENA_CHUNK ? IR_ARENA_CHUNK : cap;
+        cap = size > cap ? size : cap;
+        IrArenaChunk *chunk = (IrArenaChunk *) malloc(sizeof(IrArenaChunk) + cap);
+
+        chunk->next = a->head;
+        chunk->used = 0;
+        chunk->cap = cap;
+
+        a->head = chunk;
+        a->total += cap;
+    }
+
+    void *ptr = a->head->data + a->head->used;
+    a->head->used += size;
+
+    return ptr;
+}
+
+void ir_arena_free(IrArena *a) {
+    IrArenaChunk *chunk = a->head;
+
+    while (chunk != NULL) {
+        IrArenaChunk *next = chunk->next;
+        free((void *) chunk);
+        chunk = next;
+    }
+
+    a->head = NULL;
+    a->total = 0;
+}
+
+// grows an arena backed array, the old storage stays in the arena until the function is freed
+void *ir_arena_grow(IrArena *a, void *old, uint32_t len, uint32_t *cap, size_t elem_size) {
+    uint32_t new_cap = *cap == 0 ? 4 : *cap * 2;
+    void *ptr = ir_arena_alloc(a, new_cap * elem_size);
+
+    if (old != NULL) {
+        memcpy(ptr, old, len * elem_size);
+    }
+
+    *cap = new_cap;
+
+    return ptr;
+}
+
+IrTypeTable ir_types_create() {
+    IrTypeTable t = {
+        .types = vec_create(sizeof(IrType)),
+        .fields = vec_create(sizeof(IrField)),
+        .by_name = map_create()
+    };
+
+    static const uint32_t sizes[] = { 0, 1, 1, 4, 8, 8, 16, 32 };
+    int32_t i = 0;
+
+    while (i < IR_NUM_PRIMITIVE_TYPES) {
+        IrType ty = {
+            .kind = (IrTypeKind) i,
+            .size = sizes[i],
+            .align = sizes[i] > 0 ? sizes[i] : 1,
+            .first_field = 0,
+            .num_fields = 0,
+            .name = ir_type_names[i]
+        };
+
+        vec_push(&t.types, (void *) &ty);
+        i++;
+    }
+
+    return t;
+}
+
+void ir_types_free(IrTypeTable *t) {
+    int32_t i = IR_NUM_PRIMITIVE_TYPES;
+    while (i < t->types.len) {
+        free((void *) ((IrType *) vec_get_ptr(&t->types, i))->name);
+        i++;
+    }
+
+    vec_free(&t->types);
+    vec_free(&t->fields);
+    map_free(&t->by_name);
+}
+
+IrType *ir_type_get(IrModule *m, IrTypeId id) {
+    return (IrType *) vec_get_ptr(&m->types.types, id);
+}
+
+// struct types are nominal, so they are interned by name and defined once their fields are known
+IrTypeId ir_type_struct_declare(IrModule *m, const char *name, int32_t name_len) {
+    IrTypeId existing = ir_type_struct_lookup(m, name, name_len);
+    if (existing != IR_TYPE_VOID) {
+        return existing;
+    }
+
+    IrType ty = {
+        .kind = IR_TY_STRUCT,
+        .size = 0,
+        .align = 1,
+        .first_field = 0,
+        .num_fields = 0,
+        .name = strndup(name, name_len)
+    };
+
+    IrTypeId id = m->types.types.len;
+    vec_push(&m->types.types, (void *) &ty);
+    map_insert(&m->types.by_name, map_create_key(name_len, ty.name), (void *) (uintptr_t) id);
+
+    return id;
+}
+
+// lays the fields out in declaration order with natural alignment, like a C compiler would
+void ir_type_struct_define(IrModule *m, IrTypeId id, IrTypeId *fields, uint32_t num_fields) {
+    uint32_t first = m->types.fields.len;
+    uint32_t offset = 0;
+    uint32_t align = 1;
+    uint32_t i = 0;
+
+    while (i < num_fields) {
+        uint32_t field_align = ir_type_align(m, fields[i]);
+        offset = (offset + field_align - 1) & ~(field_align - 1);
+
+        IrField field = {
+            .ty = fields[i],
+            .offset = offset
+        };
+
+        vec_push(&m->types.fields, (void *) &field);
+
+        offset += ir_type_size(m, fields[i]);
+        align = field_align > align ? field_align : align;
+
+        i++;
+    }
+
+    IrType *ty = ir_type_get(m, id);
+    ty->first_field = first;
+    ty->num_fields = num_fields;
+    ty->align = align;
+    ty->size = (offset + align - 1) & ~(align - 1);
+}
+
+IrTypeId ir_type_struct_lookup(IrModule *m, const char *name, int32_t name_len) {
+    return (IrTypeId) (uintptr_t) map_get(&m->types.by_name, map_create_key(name_len, name));
+}
+
+IrField *ir_type_field(IrModule *m, IrTypeId id, uint32_t idx) {
+    IrType *ty = ir_type_get(m, id);
+    if (ty == NULL || idx >= ty->num_fields) {
+        return NULL;
+    }
+
+    return (IrField *) vec_get_ptr(&m->types.fields, ty->first_field + idx);
+}
+
+uint32_t ir_type_size(IrModule *m, IrTypeId id) {
+    return ir_type_get(m, id)->size;
+}
+
+uint32_t ir_type_align(IrModule *m, IrTypeId id) {
+    return ir_type_get(m, id)->align;
+}
+
+bool ir_type_is_int(IrTypeId id) {
+    return id == IR_TYPE_I1 || id == IR_TYPE_I8 || id == IR_TYPE_I32 || id == IR_TYPE_I64;
+}
+
+bool ir_type_is_scalar(IrModule *m, IrTypeId id) {
+    IrType *ty = ir_type_get(m, id);
+    return ty != NULL && ty->kind != IR_TY_VOID && ty->kind != IR_TY_STRUCT;
+}
+
+bool ir_type_is_vector(IrTypeId id) {
+    return id == IR_TYPE_V4I32 || id == IR_TYPE_V8I32;
+}
+
+uint32_t ir_type_lanes(IrTypeId id) {
+    return id == IR_TYPE_V8I32 ? 8 : (id == IR_TYPE_V4I32 ? 4 : 1);
+}
+
+const char *ir_type_name(IrModule *m, IrTypeId id) {
+    IrType *ty = ir_type_get(m, id);
+    return ty != NULL ? ty->name : "?";
+}
+
+IrModule ir_module_create() {
+    IrModule m = {
+        .types = ir_types_create(),
+        .funcs = ptrvec_create(),
+        .globals = vec_create(sizeof(IrGlobal)),
+        .strings = vec_create(sizeof(IrString)),
+        .func_by_name = map_create()
+    };
+
+    return m;
+}
+
+void ir_module_free(IrModule *m) {
+    int32_t i = 0;
+    while (i < m->funcs.len) {
+        IrFunc *f = (IrFunc *) ptrvec_get(&m->funcs, i);
+        ir_func_free(f);
+        free((void *) f);
+        i++;
+    }
+
+    i = 0;
+    while (i < m->globals.len) {
+        free((void *) ((IrGlobal *) vec_get_ptr(&m->globals, i))->name);
+        i++;
+    }
+
+    i = 0;
+    while (i < m->strings.len) {
+        free((void *) ((IrString *) vec_get_ptr(&m->strings, i))->data);
+        i++;
+    }
+
+    ir_types_free(&m->types);
+    ptrvec_free(&m->funcs);
+    vec_free(&m->globals);
+    vec_free(&m->strings);
+    map_free(&m->func_by_name);
+}
+
+IrFunc *ir_func_create(IrModule *m, const char *name, int32_t name_len, IrTypeId ret, IrTypeId *params, uint32_t num_params, uint32_t flags) {
+    IrFunc *f = (IrFunc *) calloc(1, sizeof(IrFunc));
+
+    f->name = strndup(name, name_len);
+    f->idx = m->funcs.len;
+    f->flags = flags;
+    f->ret = ret;
+    f->num_params = num_params;
+    f->params = (IrTypeId *) ir_arena_alloc(&f->arena, (num_params + 1) * sizeof(IrTypeId));
+    memcpy(f->params, params, num_params * sizeof(IrTypeId));
+
+    // slot 0 is never used, so IR_NO_VALUE can not name a real instruction
+    ir_inst_create(f, IR_NOP, IR_TYPE_VOID, 0);
+
+    ptrvec_push_ptr(&m->funcs, (void *) f);
+    map_insert(&m->func_by_name, map_create_key(name_len, f->name), (void *) f);
+
+    return f;
+}
+
+IrFunc *ir_func_lookup(IrModule *m, const char *name, int32_t name_len) {
+    return (IrFunc *) map_get(&m->func_by_name, map_create_key(name_len, name));
+}
+
+IrFunc *ir_module_func(IrModule *m, uint32_t idx) {
+    return (IrFunc *) ptrvec_get(&m->funcs, idx);
+}
+
+uint32_t ir_module_num_funcs(IrModule *m) {
+    return m->funcs.len;
+}
+
+void ir_func_free(IrFunc *f) {
+    free((void *) f->name);
+    free((void *) f->insts);
+    free((void *) f->extra_ops);
+    free((void *) f->blocks);
+    free((void *) f->dom_child_off);
+    free((void *) f->dom_children);
+    free((void *) f->dom_pre);
+    free((void *) f->dom_last);
+    free((void *) f->becomes);
+    ir_arena_free(&f->arena);
+}
+
+void ir_func_add_become(IrFunc *f, IrValue call, Span span) {
+    if (f->num_becomes == f->cap_becomes) {
+        f->cap_becomes = f->cap_becomes == 0 ? 4 : f->cap_becomes * 2;
+        f->becomes = (IrBecome *) realloc((void *) f->becomes, f->cap_becomes * sizeof(IrBecome));
+    }
+
+    f->becomes[f->num_becomes].call = call;
+    f->becomes[f->num_becomes].span = span;
+    f->num_becomes++;
+}
+
+Span ir_func_become_span(IrFunc *f, IrValue call) {
+    uint32_t i = 0;
+
+    while (i < f->num_becomes) {
+        if (f->becomes[i].call == call) {
+            return f->becomes[i].span;
+        }
+
+        i++;
+    }
+
+    return span_empty();
+}
+
+uint32_t ir_module_add_string(IrModule *m, const char *data, int32_t len) {
+    IrString s = {
+        .data = strndup(data, len),
+        .len = len
+    };
+
+    vec_push(&m->strings, (void *) &s);
+
+    return m->strings.len - 1;
+}
+
+uint32_t ir_module_add_global(IrModule *m, const char *name, int32_t name_len, IrTypeId ty, IrInitKind init_kind, int64_t init) {
+    IrGlobal g = {
+        .name = strndup(name, name_len),
+        .ty = ty,
+        .init_kind = init_kind,
+        .init = init
+    };
+
+    vec_push(&m->globals, (void *) &g);
+
+    return m->globals.len - 1;
+}
+
+IrGlobal *ir_module_global(IrModule *m, uint32_t idx) {
+    return (IrGlobal *) vec_get_ptr(&m->globals, idx);
+}
+
+IrString *ir_module_string(IrModule *m, uint32_t idx) {
+    return (IrString *) vec_get_ptr(&m->strings, idx);
+}
+
+IrBlockId ir_block_create(IrFunc *f) {
+    if (f->num_blocks >= f->cap_blocks) {
+        f->cap_blocks = f->cap_blocks == 0 ? 8 : f->cap_blocks * 2;
+        f->blocks = (IrBlock *) realloc((void *) f->blocks, f->cap_blocks * sizeof(IrBlock));
+    }
+
+    IrBlock *b = &f->blocks[f->num_blocks];
+    memset((void *) b, 0, sizeof(IrBlock));
+    b->idom = IR_NO_BLOCK;
+
+    return f->num_blocks++;
+}
+
+IrBlock *ir_block(IrFunc *f, IrBlockId id) {
+    if (id >= f->num_blocks) {
+        return NULL;
+    }
+
+    return &f->blocks[id];
+}
+
+IrInst *ir_inst(IrFunc *f, IrValue v) {
+    if (v >= f->num_insts) {
+        return NULL;
+    }
+
+    return &f->insts[v];
+}
+
+// may move the instruction array, so IrInst pointers must be fetched again afterwards
+IrValue ir_inst_create(IrFunc *f, IrOp op, IrTypeId ty, uint32_t num_ops) {
+    if (f->num_insts >= f->cap_insts) {
+        f->cap_insts = f->cap_insts == 0 ? 64 : f->cap_insts * 2;
+        f->insts = (IrInst *) realloc((void *) f->insts, f->cap_insts * sizeof(IrInst));
+    }
+
+    IrValue v = f->num_insts++;
+    IrInst *inst = &f->insts[v];
+
+    memset((void *) inst, 0, sizeof(IrInst));
+    inst->op = op;
+    inst->ty = ty;
+    inst->block = IR_NO_BLOCK;
+
+    ir_inst_set_num_ops(f, inst, num_ops);
+
+    return v;
+}
+
+IrValue *ir_inst_ops(IrFunc *f, IrInst *inst) {
+    if (inst->flags & IR_FLAG_EXTRA_OPS) {
+        return f->extra_ops + inst->u.extra.start;
+    }
+
+    return inst->u.ops;
+}
+
+uint32_t ir_inst_num_values(IrInst *inst) {
+    switch (inst->op) {
+        case IR_BR: return 0;
+        case IR_CBR: return 1;
+        default: return inst->num_ops;
+    }
+}
+
+// operands that no longer fit get a fresh slice at the end of extra_ops, the old slice is abandoned
+void ir_inst_set_num_ops(IrFunc *f, IrInst *inst, uint32_t num_ops) {
+    bool is_extra = (inst->flags & IR_FLAG_EXTRA_OPS) != 0;
+    uint32_t cap = is_extra ? inst->u.extra.cap : IR_MAX_INLINE_OPS;
+
+    if (num_ops > cap) {
+        uint32_t new_cap = num_ops > cap * 2 ? num_ops : cap * 2;
+
+        if (f->num_extra_ops + new_cap > f->cap_extra_ops) {
+            while (f->num_extra_ops + new_cap > f->cap_extra_ops) {
+                f->cap_extra_ops = f->cap_extra_ops == 0 ? 64 : f->cap_extra_ops * 2;
+            }
+
+            f->extra_ops = (IrValue *) realloc((void *) f->extra_ops, f->cap_extra_ops * sizeof(IrValue));
+        }
+
+        IrValue *dest = f->extra_ops + f->num_extra_ops;
+        memset((void *) dest, 0, new_cap * sizeof(IrValue));
+        memcpy((void *) dest, (void *) ir_inst_ops(f, inst), inst->num_ops * sizeof(IrValue));
+
+        inst->u.extra.start = f->num_extra_ops;
+        inst->u.extra.cap = new_cap;
+        inst->flags |= IR_FLAG_EXTRA_OPS;
+
+        f->num_extra_ops += new_cap;
+    }
+
+    inst->num_ops = num_ops;
+}
+
+void ir_block_append(IrFunc *f, IrBlockId b, IrValue v) {
+    IrBlock *block = ir_block(f, b);
+
+    if (block->num_insts >= block->cap_insts) {
+        block->insts = (uint32_t *) ir_arena_grow(&f->arena, block->insts, block->num_insts, &block->cap_insts, sizeof(uint32_t));
+    }
+
+    block->insts[block->num_insts++] = v;
+    f->insts[v].block = b;
+}
+
+void ir_block_insert(IrFunc *f, IrBlockId b, uint32_t pos, IrValue v) {
+    IrBlock *block = ir_block(f, b);
+
+    if (block->num_insts >= block->cap_insts) {
+        block->insts = (uint32_t *) ir_arena_grow(&f->arena, block->insts, block->num_insts, &block->cap_insts, sizeof(uint32_t));
+    }
+
+    memmove(block->insts + pos + 1, block->insts + pos, (block->num_insts - pos) * sizeof(uint32_t));
+    block->insts[pos] = v;
+    block->num_insts++;
+
+    f->insts[v].block = b;
+}
+
+void ir_block_compact(IrFunc *f, IrBlockId b) {
+    IrBlock *block = ir_block(f, b);
+    uint32_t j = 0;
+    uint32_t i = 0;
+
+    while (i < block->num_insts) {
+        if (f->insts[block->insts[i]].op != IR_NOP) {
+            block->insts[j++] = block->insts[i];
+        }
+
+        i++;
+    }
+
+    block->num_insts = j;
+}
+
+IrValue ir_block_terminator(IrFunc *f, IrBlockId b) {
+    IrBlock *block = ir_block(f, b);
+    if (block == NULL || block->num_insts == 0) {
+        return IR_NO_VALUE;
+    }
+
+    IrValue last = block->insts[block->num_insts - 1];
+    return ir_op_is_terminator(f->insts[last].op) ? last : IR_NO_VALUE;
+}
+
+// the call right before the return ending b when the return hands back its result or nothing
+IrValue ir_block_tail_call(IrFunc *f, IrBlockId b) {
+    IrBlock *block = &f->blocks[b];
+
+    if (block->num_insts < 2) {
+        return IR_NO_VALUE;
+    }
+
+    IrValue v = block->insts[block->num_insts - 2];
+    IrInst *call = &f->insts[v];
+    IrInst *ret = &f->insts[block->insts[block->num_insts - 1]];
+
+    if (call->op != IR_CALL || ret->op != IR_RET) {
+        return IR_NO_VALUE;
+    }
+
+    if (ret->num_ops > 0 && ret->u.ops[0] != v) {
+        return IR_NO_VALUE;
+    }
+
+    return v;
+}
+
+void ir_add_edge(IrFunc *f, IrBlockId from, IrBlockId to) {
+    IrBlock *src = ir_block(f, from);
+    if (src->num_succs >= src->cap_succs) {
+        src->succs = (IrBlockId *) ir_arena_grow(&f->arena, src->succs, src->num_succs, &src->cap_succs, sizeof(IrBlockId));
+    }
+
+    src->succs[src->num_succs++] = to;
+
+    IrBlock *dst = ir_block(f, to);
+    if (dst->num_preds >= dst->cap_preds) {
+        dst->preds = (IrBlockId *) ir_arena_grow(&f->arena, dst->preds, dst->num_preds, &dst->cap_preds, sizeof(IrBlockId));
+    }
+
+    dst->preds[dst->num_preds++] = from;
+}
+
+// removes one edge, phi operands of `to` have to be updated by the caller
+void ir_remove_edge(IrFunc *f, IrBlockId from, IrBlockId to) {
+    IrBlock *src = ir_block(f, from);
+    uint32_t i = 0;
+
+    while (i < src->num_succs) {
+        if (src->succs[i] == to) {
+            memmove(src->succs + i, src->succs + i + 1, (src->num_succs - i - 1) * sizeof(IrBlockId));
+            src->num_succs--;
+            break;
+        }
+
+        i++;
+    }
+
+    IrBlock *dst = ir_block(f, to);
+    i = 0;
+
+    while (i < dst->num_preds) {
+        if (dst->preds[i] == from) {
+            memmove(dst->preds + i, dst->preds + i + 1, (dst->num_preds - i - 1) * sizeof(IrBlockId));
+            dst->num_preds--;
+            break;
+        }
+
+        i++;
+    }
+}
+
+// removes one edge together with the operands the phis of `to` have for it
+void ir_remove_incoming(IrFunc *f, IrBlockId from, IrBlockId to) {
+    IrBlock *block = &f->blocks[to];
+    int32_t k = ir_pred_index(f, to, from);
+    uint32_t i = 0;
+
+    while (k >= 0 && i < block->num_insts && f->insts[block->insts[i]].op == IR_PHI) {
+        IrInst *phi = &f->insts[block->insts[i]];
+        IrValue *ops = ir_inst_ops(f, phi);
+
+        memmove(ops + k, ops + k + 1, (phi->num_ops - k - 1) * sizeof(IrValue));
+        phi->num_ops--;
+        i++;
+    }
+
+    ir_remove_edge(f, from, to);
+}
+
+int32_t ir_pred_index(IrFunc *f, IrBlockId b, IrBlockId pred) {
+    IrBlock *block = ir_block(f, b);
+    uint32_t i = 0;
+
+    while (i < block->num_preds) {
+        if (block->preds[i] == pred) {
+            return i;
+        }
+
+        i++;
+    }
+
+    return -1;
+}
+
+void ir_inst_remove(IrFunc *f, IrValue v) {
+    IrInst *inst = ir_inst(f, v);
+
+    inst->op = IR_NOP;
+    inst->ty = IR_TYPE_VOID;
+    inst->num_ops = 0;
+}
+
+void ir_replace_all_uses(IrFunc *f, IrValue old, IrValue replacement) {
+    uint32_t i = 1;
+
+    while (i < f->num_insts) {
+        IrInst *inst = &f->insts[i];
+        IrValue *ops = ir_inst_ops(f, inst);
+        uint32_t n = ir_inst_num_values(inst);
+        uint32_t j = 0;
+
+        while (j < n) {
+            if (ops[j] == old) {
+                ops[j] = replacement;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+}
+
+// one pass for many replacements: every operand v below num_mapped with map[v] set becomes map[v]
+void ir_replace_uses(IrFunc *f, IrValue *map, uint32_t num_mapped) {
+    uint32_t i = 1;
+
+    while (i < f->num_insts) {
+        IrInst *inst = &f->insts[i];
+        IrValue *ops = ir_inst_ops(f, inst);
+        uint32_t n = ir_inst_num_values(inst);
+        uint32_t j = 0;
+
+        while (j < n) {
+            if (ops[j] < num_mapped && map[ops[j]] != IR_NO_VALUE) {
+                ops[j] = map[ops[j]];
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+}
+
+// the value a chain of offsets starts from, a stack slot or any other pointer
+IrValue ir_ptr_base(IrFunc *f, IrValue ptr) {
+    while (f->insts[ptr].op == IR_OFFSET) {
+        ptr = f->insts[ptr].u.ops[0];
+    }
+
+    return ptr;
+}
+
+// a stack slot escapes once its address is used for anything but loading, storing, copying and offsetting,
+// escaped needs a cleared flag for every value of the function
+void ir_find_escaping_slots(IrFunc *f, bool *escaped) {
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                IrValue base = ir_ptr_base(f, ops[j]);
+                bool is_addr = (j == 0 && (inst->op == IR_LOAD || inst->op == IR_STORE || inst->op == IR_OFFSET)) ||
+                    inst->op == IR_MEMCPY;
+
+                if (f->insts[base].op == IR_ALLOCA && !is_addr) {
+                    escaped[base] = true;
+                }
+
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+}
+
+bool ir_op_is_terminator(IrOp op) {
+    return op == IR_BR || op == IR_CBR || op == IR_RET || op == IR_UNREACHABLE;
+}
+
+bool ir_op_has_side_effects(IrOp op) {
+    switch (op) {
+        case IR_STORE:
+        case IR_MEMCPY:
+        case IR_NEW:
+        case IR_DELETE:
+        case IR_CALL:
+            return true;
+        default:
+            return ir_op_is_terminator(op);
+    }
+}
+
+bool ir_op_is_binary(IrOp op) {
+    return op >= IR_ADD && op <= IR_SHR;
+}
+
+bool ir_op_is_compare(IrOp op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+const char *ir_op2str(IrOp op) {
+    if (op >= IR_NUM_OPS) {
+        return "unknown";
+    }
+
+    return ir_op_names[op];
+}
+
+// iterative DFS from the entry block, unreachable blocks are left out
+uint32_t *ir_reverse_postorder(IrFunc *f, uint32_t *count) {
+    uint32_t *order = (uint32_t *) malloc((f->num_blocks + 1) * sizeof(uint32_t));
+    uint32_t *stack = (uint32_t *) malloc((f->num_blocks + 1) * sizeof(uint32_t));
+    uint32_t *next_succ = (uint32_t *) calloc(f->num_blocks + 1, sizeof(uint32_t));
+    bool *visited = (bool *) calloc(f->num_blocks + 1, sizeof(bool));
+    uint32_t num = 0;
+    uint32_t depth = 0;
+
+    if (f->num_blocks > 0) {
+        stack[depth++] = 0;
+        visited[0] = true;
+    }
+
+    while (depth > 0) {
+        IrBlockId b = stack[depth - 1];
+        IrBlock *block = &f->blocks[b];
+
+        if (next_succ[b] < block->num_succs) {
+            IrBlockId s = block->succs[next_succ[b]++];
+
+            if (!visited[s]) {
+                visited[s] = true;
+                stack[depth++] = s;
+            }
+
+            continue;
+        }
+
+        order[num++] = b;
+        depth--;
+    }
+
+    uint32_t i = 0;
+    while (i < num / 2) {
+        uint32_t t = order[i];
+        order[i] = order[num - 1 - i];
+        order[num - 1 - i] = t;
+        i++;
+    }
+
+    free((void *) stack);
+    free((void *) next_succ);
+    free((void *) visited);
+
+    *count = num;
+
+    return order;
+}
+
+// gives every edge from a block with several successors into a block with phis a block of its own,
+// so the phi copies of that edge have somewhere to go
+// puts a block that only jumps on into the edge to the i-th successor of b, the phis of the successor keep
+// their operand for it
+IrBlockId ir_split_edge(IrFunc *f, IrBlockId b, uint32_t i) {
+    IrBlockId s = f->blocks[b].succs[i];
+    IrBlockId mid = ir_block_create(f);
+    IrBlock *block = &f->blocks[b];
+    IrBlock *succ = &f->blocks[s];
+
+    // the first pred entry of b that still points at b belongs to this edge
+    uint32_t j = 0;
+    while (succ->preds[j] != b) {
+        j++;
+    }
+
+    succ->preds[j] = mid;
+    block->succs[i] = mid;
+
+    IrInst *term = &f->insts[ir_block_terminator(f, b)];
+    IrValue *ops = ir_inst_ops(f, term);
+    uint32_t k = term->op == IR_CBR ? 1 : 0;
+
+    while (k < term->num_ops && ops[k] != s) {
+        k++;
+    }
+
+    ops[k] = mid;
+
+    IrValue br = ir_inst_create(f, IR_BR, IR_TYPE_VOID, 1);
+    f->insts[br].u.ops[0] = s;
+    ir_block_append(f, mid, br);
+
+    IrBlock *m = &f->blocks[mid];
+    m->preds = (IrBlockId *) ir_arena_grow(&f->arena, m->preds, 0, &m->cap_preds, sizeof(IrBlockId));
+    m->succs = (IrBlockId *) ir_arena_grow(&f->arena, m->succs, 0, &m->cap_succs, sizeof(IrBlockId));
+    m->preds[m->num_preds++] = b;
+    m->succs[m->num_succs++] = s;
+    m->freq = block->freq < succ->freq ? block->freq : succ->freq;
+
+    return mid;
+}
+
+uint32_t ir_split_critical_edges(IrFunc *f) {
+    uint32_t num_blocks = f->num_blocks;
+    uint32_t num_split = 0;
+    IrBlockId b = 0;
+
+    while (b < num_blocks) {
+        uint32_t i = 0;
+
+        while (f->blocks[b].num_succs > 1 && i < f->blocks[b].num_succs) {
+            IrBlockId s = f->blocks[b].succs[i];
+            IrBlock *succ = &f->blocks[s];
+
+            if (succ->num_preds < 2 || succ->num_insts == 0 || f->insts[succ->insts[0]].op != IR_PHI) {
+                i++;
+                continue;
+            }
+
+            ir_split_edge(f, b, i);
+            num_split++;
+            i++;
+        }
+
+        b++;
+    }
+
+    if (num_split > 0) {
+        ir_func_invalidate(f, IR_ANALYSIS_ALL);
+    }
+
+    return num_split;
+}
+
+IrBlockId ir_dom_intersect(IrFunc *f, uint32_t *rpo_num, IrBlockId a, IrBlockId b) {
+    while (a != b) {
+        while (rpo_num[a] > rpo_num[b]) {
+            a = f->blocks[a].idom;
+        }
+
+        while (rpo_num[b] > rpo_num[a]) {
+            b = f->blocks[b].idom;
+        }
+    }
+
+    return a;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+void ir_compute_dominators(IrFunc *f) {
+    uint32_t count = 0;
+    uint32_t *rpo = ir_reverse_postorder(f, &count);
+    uint32_t *rpo_num = (uint32_t *) malloc((f->num_blocks + 1) * sizeof(uint32_t));
+    uint32_t i = 0;
+
+    while (i < f->num_blocks) {
+        f->blocks[i].idom = IR_NO_BLOCK;
+        rpo_num[i] = UINT32_MAX;
+        i++;
+    }
+
+    i = 0;
+    while (i < count) {
+        rpo_num[rpo[i]] = i;
+        i++;
+    }
+
+    if (count > 0) {
+        f->blocks[0].idom = 0;
+    }
+
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+        i = 1;
+
+        while (i < count) {
+            IrBlock *block = &f->blocks[rpo[i]];
+            IrBlockId new_idom = IR_NO_BLOCK;
+            uint32_t j = 0;
+
+            while (j < block->num_preds) {
+                IrBlockId p = block->preds[j];
+
+                if (rpo_num[p] != UINT32_MAX && f->blocks[p].idom != IR_NO_BLOCK) {
+                    new_idom = new_idom == IR_NO_BLOCK ? p : ir_dom_intersect(f, rpo_num, p, new_idom);
+                }
+
+                j++;
+            }
+
+            if (block->idom != new_idom) {
+                block->idom = new_idom;
+                changed = true;
+            }
+
+            i++;
+        }
+    }
+
+    free((void *) rpo);
+    free((void *) rpo_num);
+}
+
+bool ir_dominates(IrFunc *f, IrBlockId a, IrBlockId b) {
+    if (a == b) {
+        return true;
+    }
+
+    ir_func_dominators(f);
+
+    return f->dom_pre[a] <= f->dom_pre[b] && f->dom_pre[b] <= f->dom_last[a];
+}
+
+// the children of every block in the dominator tree, in block order, once idom is set. the counts are summed up
+// to the end of every block's range, filling it back to front leaves each entry at the start of its range.
+// child_off needs room for num_blocks + 1 entries and children for num_blocks
+void ir_dominator_tree(IrFunc *f, uint32_t *child_off, IrBlockId *children) {
+    uint32_t total = 0;
+    IrBlockId b = 0;
+
+    memset((void *) child_off, 0, (f->num_blocks + 1) * sizeof(uint32_t));
+
+    while (b < f->num_blocks) {
+        if (b != 0 && f->blocks[b].idom != IR_NO_BLOCK) {
+            child_off[f->blocks[b].idom]++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        total += child_off[b];
+        child_off[b] = total;
+        b++;
+    }
+
+    child_off[f->num_blocks] = total;
+
+    b = f->num_blocks;
+    while (b > 1) {
+        b--;
+
+        if (f->blocks[b].idom != IR_NO_BLOCK) {
+            children[--child_off[f->blocks[b].idom]] = b;
+        }
+    }
+}
+
+// numbers the dominator tree in preorder. the blocks a block dominates are numbered right after it, so the last of
+// them is found walking the preorder backwards and handing every block's last number up to its idom
+void ir_dominator_numbers(IrFunc *f) {
+    IrBlockId *order = (IrBlockId *) malloc((f->num_blocks + 1) * sizeof(IrBlockId));
+    IrBlockId *stack = (IrBlockId *) malloc((f->num_blocks + 1) * sizeof(IrBlockId));
+    uint32_t num_order = 0;
+    uint32_t sp = 0;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        f->dom_pre[b] = UINT32_MAX;
+        f->dom_last[b] = 0;
+        b++;
+    }
+
+    if (f->num_blocks > 0) {
+        stack[sp++] = 0;
+    }
+
+    while (sp > 0) {
+        b = stack[--sp];
+        f->dom_pre[b] = num_order;
+        order[num_order++] = b;
+
+        uint32_t i = f->dom_child_off[b];
+        while (i < f->dom_child_off[b + 1]) {
+            stack[sp++] = f->dom_children[i];
+            i++;
+        }
+    }
+
+    while (num_order > 0) {
+        b = order[--num_order];
+        f->dom_last[b] = f->dom_pre[b] > f->dom_last[b] ? f->dom_pre[b] : f->dom_last[b];
+
+        IrBlockId idom = f->blocks[b].idom;
+        if (b != 0 && f->dom_last[b] > f->dom_last[idom]) {
+            f->dom_last[idom] = f->dom_last[b];
+        }
+    }
+
+    free((void *) order);
+    free((void *) stack);
+}
+
+void ir_func_dominators(IrFunc *f) {
+    if ((f->analyses & IR_ANALYSIS_DOMINATORS) != 0) {
+        return;
+    }
+
+    if (f->num_blocks > f->cap_dom) {
+        f->cap_dom = f->num_blocks * 2;
+        f->dom_child_off = (uint32_t *) realloc((void *) f->dom_child_off, (f->cap_dom + 1) * sizeof(uint32_t));
+        f->dom_children = (IrBlockId *) realloc((void *) f->dom_children, f->cap_dom * sizeof(IrBlockId));
+        f->dom_pre = (uint32_t *) realloc((void *) f->dom_pre, f->cap_dom * sizeof(uint32_t));
+        f->dom_last = (uint32_t *) realloc((void *) f->dom_last, f->cap_dom * sizeof(uint32_t));
+    }
+
+    ir_compute_dominators(f);
+    ir_dominator_tree(f, f->dom_child_off, f->dom_children);
+    ir_dominator_numbers(f);
+    f->analyses |= IR_ANALYSIS_DOMINATORS;
+}
+
+void ir_func_invalidate(IrFunc *f, uint32_t analyses) {
+    f->analyses &= ~analyses;
+}
+
+IrBuilder ir_builder_create(IrModule *m, IrFunc *f) {
+    IrBuilder b = {
+        .mod = m,
+        .func = f,
+        .block = IR_NO_BLOCK
+    };
+
+    return b;
+}
+
+void ir_builder_set_block(IrBuilder *b, IrBlockId block) {
+    b->block = block;
+}
+
+bool ir_builder_is_terminated(IrBuilder *b) {
+    return ir_block_terminator(b->func, b->block) != IR_NO_VALUE;
+}
+
+IrValue ir_build_inst(IrBuilder *b, IrOp op, IrTypeId ty, uint32_t num_ops, IrValue a, IrValue c, IrValue d, int64_t imm) {
+    IrValue v = ir_inst_create(b->func, op, ty, num_ops);
+    IrInst *inst = &b->func->insts[v];
+
+    inst->u.ops[0] = a;
+    inst->u.ops[1] = c;
+    inst->u.ops[2] = d;
+    inst->imm = imm;
+
+    ir_block_append(b->func, b->block, v);
+
+    return v;
+}
+
+IrTypeId ir_value_type(IrBuilder *b, IrValue v) {
+    return b->func->insts[v].ty;
+}
+
+IrValue ir_build_const(IrBuilder *b, IrTypeId ty, int64_t value) {
+    return ir_build_inst(b, IR_CONST, ty, 0, 0, 0, 0, value);
+}
+
+IrValue ir_build_param(IrBuilder *b, uint32_t idx) {
+    return ir_build_inst(b, IR_PARAM, b->func->params[idx], 0, 0, 0, 0, idx);
+}
+
+IrValue ir_build_str(IrBuilder *b, uint32_t str_idx) {
+    return ir_build_inst(b, IR_STR, IR_TYPE_PTR, 0, 0, 0, 0, str_idx);
+}
+
+IrValue ir_build_global(IrBuilder *b, uint32_t global_idx) {
+    return ir_build_inst(b, IR_GLOBAL, IR_TYPE_PTR, 0, 0, 0, 0, global_idx);
+}
+
+IrValue ir_build_func_addr(IrBuilder *b, uint32_t func_idx) {
+    return ir_build_inst(b, IR_FUNC_ADDR, IR_TYPE_PTR, 0, 0, 0, 0, func_idx);
+}
+
+IrValue ir_build_binary(IrBuilder *b, IrOp op, IrValue lhs, IrValue rhs) {
+    return ir_build_inst(b, op, ir_value_type(b, lhs), 2, lhs, rhs, 0, 0);
+}
+
+IrValue ir_build_unary(IrBuilder *b, IrOp op, IrValue value) {
+    return ir_build_inst(b, op, ir_value_type(b, value), 1, value, 0, 0, 0);
+}
+
+// comparing vectors gives a mask of the same vector type
+IrValue ir_build_cmp(IrBuilder *b, IrOp op, IrValue lhs, IrValue rhs) {
+    IrTypeId ty = ir_value_type(b, lhs);
+    return ir_build_inst(b, op, ir_type_is_vector(ty) ? ty : IR_TYPE_I1, 2, lhs, rhs, 0, 0);
+}
+
+IrValue ir_build_cast(IrBuilder *b, IrOp op, IrTypeId ty, IrValue value) {
+    return ir_build_inst(b, op, ty, 1, value, 0, 0, 0);
+}
+
+IrValue ir_build_select(IrBuilder *b, IrValue cond, IrValue a, IrValue c) {
+    return ir_build_inst(b, IR_SELECT, ir_value_type(b, a), 3, cond, a, c, 0);
+}
+
+IrValue ir_build_copy(IrBuilder *b, IrValue value) {
+    return ir_build_inst(b, IR_COPY, ir_value_type(b, value), 1, value, 0, 0, 0);
+}
+
+IrValue ir_build_phi(IrBuilder *b, IrTypeId ty, uint32_t num_ops) {
+    return ir_build_phi_in(b->func, b->block, ty, num_ops);
+}
+
+// phis always go after the phis already at the start of the block
+IrValue ir_build_phi_in(IrFunc *f, IrBlockId block, IrTypeId ty, uint32_t num_ops) {
+    IrValue v = ir_inst_create(f, IR_PHI, ty, num_ops);
+    IrBlock *bb = ir_block(f, block);
+    uint32_t pos = 0;
+
+    while (pos < bb->num_insts && f->insts[bb->insts[pos]].op == IR_PHI) {
+        pos++;
+    }
+
+    ir_block_insert(f, block, pos, v);
+
+    return v;
+}
+
+IrValue ir_build_alloca(IrBuilder *b, uint32_t size, uint32_t align) {
+    return ir_build_inst(b, IR_ALLOCA, IR_TYPE_PTR, 0, 0, 0, 0, ((int64_t) align << 32) | size);
+}
+
+IrValue ir_build_load(IrBuilder *b, IrTypeId ty, IrValue ptr) {
+    return ir_build_inst(b, IR_LOAD, ty, 1, ptr, 0, 0, 0);
+}
+
+IrValue ir_build_store(IrBuilder *b, IrValue ptr, IrValue value) {
+    return ir_build_inst(b, IR_STORE, IR_TYPE_VOID, 2, ptr, value, 0, 0);
+}
+
+IrValue ir_build_offset(IrBuilder *b, IrValue ptr, int64_t offset) {
+    return ir_build_inst(b, IR_OFFSET, IR_TYPE_PTR, 1, ptr, 0, 0, offset);
+}
+
+// the struct copied goes above the size, so the copy can be split into its fields later
+IrValue ir_build_memcpy(IrBuilder *b, IrValue dst, IrValue src, IrTypeId ty) {
+    return ir_build_inst(b, IR_MEMCPY, IR_TYPE_VOID, 2, dst, src, 0, ((int64_t) ty << 32) | ir_type_size(b->mod, ty));
+}
+
+IrValue ir_build_new(IrBuilder *b, uint32_t size) {
+    return ir_build_inst(b, IR_NEW, IR_TYPE_PTR, 0, 0, 0, 0, size);
+}
+
+IrValue ir_build_delete(IrBuilder *b, IrValue ptr) {
+    return ir_build_inst(b, IR_DELETE, IR_TYPE_VOID, 1, ptr, 0, 0, 0);
+}
+
+IrValue ir_build_call(IrBuilder *b, uint32_t func_idx, IrValue *args, uint32_t num_args) {
+    IrFunc *callee = ir_module_func(b->mod, func_idx);
+    IrValue v = ir_inst_create(b->func, IR_CALL, callee->ret, num_args);
+    IrInst *inst = &b->func->insts[v];
+
+    memcpy((void *) ir_inst_ops(b->func, inst), (void *) args, num_args * sizeof(IrValue));
+    inst->imm = func_idx;
+
+    ir_block_append(b->func, b->block, v);
+
+    return v;
+}
+
+IrValue ir_build_br(IrBuilder *b, IrBlockId target) {
+    ir_add_edge(b->func, b->block, target);
+    return ir_build_inst(b, IR_BR, IR_TYPE_VOID, 1, target, 0, 0, 0);
+}
+
+IrValue ir_build_cbr(IrBuilder *b, IrValue cond, IrBlockId then_block, IrBlockId else_block) {
+    ir_add_edge(b->func, b->block, then_block);
+    ir_add_edge(b->func, b->block, else_block);
+    return ir_build_inst(b, IR_CBR, IR_TYPE_VOID, 3, cond, then_block, else_block, 0);
+}
+
+IrValue ir_build_splat(IrBuilder *b, IrTypeId ty, IrValue value) {
+    return ir_build_inst(b, IR_SPLAT, ty, 1, value, 0, 0, 0);
+}
+
+IrValue ir_build_extract(IrBuilder *b, IrValue vector, uint32_t lane) {
+    return ir_build_inst(b, IR_EXTRACT, IR_TYPE_I32, 1, vector, 0, 0, lane);
+}
+
+IrValue ir_build_cpu_feature(IrBuilder *b, int64_t feature) {
+    return ir_build_inst(b, IR_CPU_FEATURE, IR_TYPE_I1, 0, 0, 0, 0, feature);
+}
+
+IrValue ir_build_ret(IrBuilder *b, IrValue value) {
+    return ir_build_inst(b, IR_RET, IR_TYPE_VOID, value != IR_NO_VALUE ? 1 : 0, value, 0, 0, 0);
+}
+
+IrValue ir_build_unreachable(IrBuilder *b) {
+    return ir_build_inst(b, IR_UNREACHABLE, IR_TYPE_VOID, 0, 0, 0, 0, 0);
+}
+
+void ir_dump_string(FILE *out, IrString *s) {
+    int32_t len = s->len > 40 ? 40 : s->len;
+    int32_t i = 0;
+
+    fprintf(out, "\"");
+
+    while (i < len) {
+        char c = s->data[i];
+
+        switch (c) {
+            case '\n': fprintf(out, "\\n"); break;
+            case '\t': fprintf(out, "\\t"); break;
+            case '\r': fprintf(out, "\\r"); break;
+            case '\0': fprintf(out, "\\0"); break;
+            case '"': fprintf(out, "\\\""); break;
+            case '\\': fprintf(out, "\\\\"); break;
+            default: fputc(c, out); break;
+        }
+
+        i++;
+    }
+
+    fprintf(out, "%s\"", s->len > len ? "..." : "");
+}
+
+void ir_dump_inst(FILE *out, IrModule *m, IrFunc *f, IrValue v) {
+    IrInst *inst = &f->insts[v];
+    IrValue *ops = ir_inst_ops(f, inst);
+    IrOp op = (IrOp) inst->op;
+
+    fprintf(out, "    ");
+
+    if (inst->ty != IR_TYPE_VOID) {
+        fprintf(out, "%%%u:%s = ", v, ir_type_name(m, inst->ty));
+    }
+
+    fprintf(out, "%s", ir_op2str(op));
+
+    switch (op) {
+        case IR_CONST: {
+            fprintf(out, " %ld", (long) inst->imm);
+            break;
+        }
+
+        case IR_PARAM: {
+            fprintf(out, " %ld", (long) inst->imm);
+            break;
+        }
+
+        case IR_STR: {
+            fprintf(out, " @str%ld ", (long) inst->imm);
+            ir_dump_string(out, ir_module_string(m, inst->imm));
+            break;
+        }
+
+        case IR_GLOBAL: {
+            IrGlobal *g = ir_module_global(m, inst->imm);
+            fprintf(out, " @%s", g != NULL ? g->name : "?");
+            break;
+        }
+
+        case IR_FUNC_ADDR: {
+            IrFunc *callee = ir_module_func(m, inst->imm);
+            fprintf(out, " @%s", callee != NULL ? callee->name : "?");
+            break;
+        }
+
+        case IR_ALLOCA: {
+            fprintf(out, " %u, align %u", (uint32_t) (inst->imm & UINT32_MAX), (uint32_t) (inst->imm >> 32));
+            break;
+        }
+
+        case IR_OFFSET: {
+            fprintf(out, " %%%u, %ld", ops[0], (long) inst->imm);
+            break;
+        }
+
+        case IR_MEMCPY: {
+            fprintf(out, " %%%u, %%%u, %s", ops[0], ops[1], ir_type_name(m, (IrTypeId) (inst->imm >> 32)));
+            break;
+        }
+
+        case IR_NEW: {
+            fprintf(out, " %ld", (long) inst->imm);
+            break;
+        }
+
+        case IR_EXTRACT: {
+            fprintf(out, " %%%u, %ld", ops[0], (long) inst->imm);
+            break;
+        }
+
+        case IR_CPU_FEATURE: {
+            fprintf(out, " %s", inst->imm == IR_CPU_AVX2 ? "avx2" : "?");
+            break;
+        }
+
+        case IR_CALL: {
+            IrFunc *callee = ir_module_func(m, inst->imm);
+            const char *tail = inst->flags & IR_FLAG_TAIL ? " tail" : (inst->flags & IR_FLAG_MUST_TAIL ? " musttail" : "");
+            fprintf(out, "%s @%s(", tail, callee != NULL ? callee->name : "?");
+
+            uint32_t i = 0;
+            while (i < inst->num_ops) {
+                fprintf(out, "%s%%%u", i > 0 ? ", " : "", ops[i]);
+                i++;
+            }
+
+            fprintf(out, ")");
+            break;
+        }
+
+        case IR_PHI: {
+            IrBlock *block = ir_block(f, inst->block);
+            uint32_t i = 0;
+
+            while (i < inst->num_ops) {
+                if (block != NULL && i < block->num_preds) {
+                    fprintf(out, "%s [b%u: %%%u]", i > 0 ? "," : "", block->preds[i], ops[i]);
+                } else {
+                    fprintf(out, "%s [b?: %%%u]", i > 0 ? "," : "", ops[i]);
+                }
+
+                i++;
+            }
+
+            break;
+        }
+
+        case IR_BR: {
+            fprintf(out, " b%u", ops[0]);
+            break;
+        }
+
+        case IR_CBR: {
+            fprintf(out, " %%%u, b%u, b%u", ops[0], ops[1], ops[2]);
+            break;
+        }
+
+        default: {
+            uint32_t i = 0;
+            while (i < inst->num_ops) {
+                fprintf(out, "%s%%%u", i > 0 ? ", " : " ", ops[i]);
+                i++;
+            }
+
+            break;
+        }
+    }
+
+    fprintf(out, "\n");
+}
+
+void ir_dump_signature(FILE *out, IrModule *m, IrFunc *f) {
+    fprintf(out, "%sfn %s(", f->flags & IR_FUNC_EXTERN ? "extern " : "", f->name);
+
+    uint32_t i = 0;
+    while (i < f->num_params) {
+        fprintf(out, "%s%s", i > 0 ? ", " : "", ir_type_name(m, f->params[i]));
+        i++;
+    }
+
+    if (f->flags & IR_FUNC_VARARGS) {
+        fprintf(out, "%s...", f->num_params > 0 ? ", " : "");
+    }
+
+    fprintf(out, "): %s", ir_type_name(m, f->ret));
+}
+
+void ir_dump_func(FILE *out, IrModule *m, IrFunc *f) {
+    ir_dump_signature(out, m, f);
+
+    if (f->flags & IR_FUNC_EXTERN) {
+        fprintf(out, "\n");
+        return;
+    }
+
+    fprintf(out, " {\n");
+
+    uint32_t b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        fprintf(out, "b%u:", b);
+
+        if (block->num_preds > 0) {
+            fprintf(out, "    ; preds");
+
+            uint32_t i = 0;
+            while (i < block->num_preds) {
+                fprintf(out, "%s b%u", i > 0 ? "," : "", block->preds[i]);
+                i++;
+            }
+        }
+
+        fprintf(out, "\n");
+
+        uint32_t i = 0;
+        while (i < block->num_insts) {
+            if (f->insts[block->insts[i]].op != IR_NOP) {
+                ir_dump_inst(out, m, f, block->insts[i]);
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    fprintf(out, "}\n");
+}
+
+void ir_dump_module(FILE *out, IrModule *m) {
+    int32_t i = IR_NUM_PRIMITIVE_TYPES;
+
+    while (i < m->types.types.len) {
+        IrType *ty = ir_type_get(m, i);
+        fprintf(out, "type %s { ", ty->name);
+
+        uint32_t j = 0;
+        while (j < ty->num_fields) {
+            IrField *field = ir_type_field(m, i, j);
+            fprintf(out, "%s%s @%u", j > 0 ? ", " : "", ir_type_name(m, field->ty), field->offset);
+            j++;
+        }
+
+        fprintf(out, " } ; size %u, align %u\n", ty->size, ty->align);
+        i++;
+    }
+
+    i = 0;
+    while (i < m->strings.len) {
+        fprintf(out, "@str%d = ", i);
+        ir_dump_string(out, ir_module_string(m, i));
+        fprintf(out, "\n");
+        i++;
+    }
+
+    i = 0;
+    while (i < m->globals.len) {
+        IrGlobal *g = ir_module_global(m, i);
+        fprintf(out, "global @%s: %s", g->name, ir_type_name(m, g->ty));
+
+        if (g->init_kind == IR_INIT_INT) {
+            fprintf(out, " = %ld", (long) g->init);
+        } else if (g->init_kind == IR_INIT_STRING) {
+            fprintf(out, " = @str%ld", (long) g->init);
+        }
+
+        fprintf(out, "\n");
+        i++;
+    }
+
+    i = 0;
+    while (i < m->funcs.len) {
+        fprintf(out, "\n");
+        ir_dump_func(out, m, ir_module_func(m, i));
+        i++;
+    }
+}
+
+void ir_verify_error(Ptrvec *errors, int32_t *num_errs, IrFunc *f, const char *fmt, ...) {
+    char *msg = NULL;
+    va_list args;
+
+    va_start(args, fmt);
+    vfmt_str(&msg, fmt, args);
+    va_end(args);
+
+    if (errors != NULL && msg != NULL) {
+        ptrvec_push_ptr(errors, (void *) fmt_str("in '%s': %s", f->name, msg));
+    }
+
+    free((void *) msg);
+    (*num_errs)++;
+}
+
+// the result type of every op is checked against its operands, so later passes can trust inst->ty
+void ir_verify_types(IrModule *m, IrFunc *f, IrValue v, Ptrvec *errors, int32_t *num_errs) {
+    #define VERR(...) ir_verify_error(errors, num_errs, f, __VA_ARGS__)
+
+    IrInst *inst = &f->insts[v];
+    IrValue *ops = ir_inst_ops(f, inst);
+    IrOp op = (IrOp) inst->op;
+
+    if (ir_op_is_binary(op)) {
+        // division and shifts have no lane by lane form
+        bool lanes = ir_type_is_vector(inst->ty) && op != IR_DIV && op != IR_MOD && op != IR_SHL && op != IR_SHR;
+
+        if (inst->num_ops != 2 || !(ir_type_is_int(inst->ty) || lanes) || f->insts[ops[0]].ty != inst->ty || f->insts[ops[1]].ty != inst->ty) {
+            VERR("%%%u: '%s' needs two integer operands of its result type", v, ir_op2str(op));
+        }
+
+        return;
+    }
+
+    if (ir_op_is_compare(op)) {
+        IrTypeId ty = f->insts[ops[0]].ty;
+        IrTypeId expected = ir_type_is_vector(ty) ? ty : IR_TYPE_I1;
+
+        if (inst->num_ops != 2 || inst->ty != expected || f->insts[ops[1]].ty != ty) {
+            VERR("%%%u: '%s' needs two operands of the same type and produces an i1 or a vector mask", v, ir_op2str(op));
+        }
+
+        return;
+    }
+
+    switch (op) {
+        case IR_NEG:
+        case IR_NOT: {
+            if (inst->num_ops != 1 || !ir_type_is_int(inst->ty) || f->insts[ops[0]].ty != inst->ty) {
+                VERR("%%%u: '%s' needs one integer operand of its result type", v, ir_op2str(op));
+            }
+
+            break;
+        }
+
+        case IR_SEXT:
+        case IR_ZEXT:
+        case IR_TRUNC: {
+            IrTypeId from = f->insts[ops[0]].ty;
+            bool widen = op != IR_TRUNC;
+
+            if (!ir_type_is_int(from) || !ir_type_is_int(inst->ty) || (widen ? from > inst->ty : from < inst->ty)) {
+                VERR("%%%u: invalid '%s' from %s to %s", v, ir_op2str(op), ir_type_name(m, from), ir_type_name(m, inst->ty));
+            }
+
+            break;
+        }
+
+        case IR_PARAM: {
+            if (inst->imm < 0 || inst->imm >= f->num_params || f->params[inst->imm] != inst->ty) {
+                VERR("%%%u: parameter %ld does not exist or has a different type", v, (long) inst->imm);
+            }
+
+            break;
+        }
+
+        case IR_STR: {
+            if (inst->imm < 0 || inst->imm >= m->strings.len) {
+                VERR("%%%u: string %ld does not exist", v, (long) inst->imm);
+            }
+
+            break;
+        }
+
+        case IR_GLOBAL: {
+            if (inst->imm < 0 || inst->imm >= m->globals.len) {
+                VERR("%%%u: global %ld does not exist", v, (long) inst->imm);
+            }
+
+            break;
+        }
+
+        case IR_SELECT: {
+            IrTypeId cond = f->insts[ops[0]].ty;
+
+            if ((cond != IR_TYPE_I1 && cond != inst->ty) || f->insts[ops[1]].ty != inst->ty || f->insts[ops[2]].ty != inst->ty) {
+                VERR("%%%u: 'select' needs an i1 or mask condition and two operands of its result type", v);
+            }
+
+            break;
+        }
+
+        case IR_SPLAT: {
+            if (!ir_type_is_vector(inst->ty) || f->insts[ops[0]].ty != IR_TYPE_I32) {
+                VERR("%%%u: 'splat' needs an i32 operand and a vector result", v);
+            }
+
+            break;
+        }
+
+        case IR_EXTRACT: {
+            IrTypeId ty = f->insts[ops[0]].ty;
+
+            if (!ir_type_is_vector(ty) || inst->ty != IR_TYPE_I32 || inst->imm < 0 || inst->imm >= ir_type_lanes(ty)) {
+                VERR("%%%u: 'extract' needs a vector operand and a lane of it", v);
+            }
+
+            break;
+        }
+
+        case IR_CPU_FEATURE: {
+            if (inst->ty != IR_TYPE_I1 || inst->imm != IR_CPU_AVX2) {
+                VERR("%%%u: 'cpu_feature' asks for an unknown feature", v);
+            }
+
+            break;
+        }
+
+        case IR_PHI:
+        case IR_COPY: {
+            uint32_t i = 0;
+            while (i < inst->num_ops) {
+                if (f->insts[ops[i]].ty != inst->ty) {
+                    VERR("%%%u: operand %%%u of '%s' has type %s instead of %s", v, ops[i], ir_op2str(op), ir_type_name(m, f->insts[ops[i]].ty), ir_type_name(m, inst->ty));
+                }
+
+                i++;
+            }
+
+            break;
+        }
+
+        case IR_LOAD:
+        case IR_OFFSET:
+        case IR_DELETE: {
+            if (f->insts[ops[0]].ty != IR_TYPE_PTR) {
+                VERR("%%%u: '%s' needs a pointer operand", v, ir_op2str(op));
+            }
+
+            if (op == IR_LOAD && !ir_type_is_scalar(m, inst->ty)) {
+                VERR("%%%u: 'load' can only load scalars", v);
+            }
+
+            break;
+        }
+
+        case IR_STORE:
+        case IR_MEMCPY: {
+            if (f->insts[ops[0]].ty != IR_TYPE_PTR || (op == IR_MEMCPY && f->insts[ops[1]].ty != IR_TYPE_PTR)) {
+                VERR("%%%u: '%s' needs a pointer destination", v, ir_op2str(op));
+            }
+
+            break;
+        }
+
+        case IR_CALL: {
+            IrFunc *callee = ir_module_func(m, inst->imm);
+
+            if (callee == NULL) {
+                VERR("%%%u: call of unknown function %ld", v, (long) inst->imm);
+                break;
+            }
+
+            bool varargs = (callee->flags & IR_FUNC_VARARGS) != 0;
+
+            if (varargs ? inst->num_ops < callee->num_params : inst->num_ops != callee->num_params) {
+                VERR("%%%u: '%s' expects %u arguments, got %u", v, callee->name, callee->num_params, inst->num_ops);
+            }
+
+            if (inst->ty != callee->ret) {
+                VERR("%%%u: call result type does not match the return type of '%s'", v, callee->name);
+            }
+
+            uint32_t i = 0;
+            while (i < inst->num_ops && i < callee->num_params) {
+                if (f->insts[ops[i]].ty != callee->params[i]) {
+                    VERR("%%%u: argument %u of '%s' has type %s instead of %s", v, i, callee->name, ir_type_name(m, f->insts[ops[i]].ty), ir_type_name(m, callee->params[i]));
+                }
+
+                i++;
+            }
+
+            break;
+        }
+
+        case IR_CBR: {
+            if (f->insts[ops[0]].ty != IR_TYPE_I1) {
+                VERR("%%%u: 'cbr' needs an i1 condition", v);
+            }
+
+            break;
+        }
+
+        case IR_RET: {
+            IrTypeId ty = inst->num_ops > 0 ? f->insts[ops[0]].ty : IR_TYPE_VOID;
+
+            if (ty != f->ret) {
+                VERR("%%%u: returns %s from a function returning %s", v, ir_type_name(m, ty), ir_type_name(m, f->ret));
+            }
+
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+
+    #undef VERR
+}
+
+// checks the CFG shape, SSA dominance and operand types, returns the number of problems found
+int32_t ir_verify_func(IrModule *m, IrFunc *f, Ptrvec *errors) {
+    #define VERR(...) ir_verify_error(errors, &num_errs, f, __VA_ARGS__)
+
+    int32_t num_errs = 0;
+
+    if (f->flags & IR_FUNC_EXTERN) {
+        return 0;
+    }
+
+    if (f->num_blocks == 0) {
+        VERR("function has no blocks");
+        return num_errs;
+    }
+
+    if (f->blocks[0].num_preds > 0) {
+        VERR("entry block b0 has predecessors");
+    }
+
+    // a pass that changed the CFG without dropping the cached tree is not trusted
+    ir_func_invalidate(f, IR_ANALYSIS_ALL);
+    ir_func_dominators(f);
+
+    uint32_t *pos = (uint32_t *) calloc(f->num_insts, sizeof(uint32_t));
+    bool *placed = (bool *) calloc(f->num_insts, sizeof(bool));
+    uint32_t b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+
+            if (v == IR_NO_VALUE || v >= f->num_insts) {
+                VERR("b%u contains invalid instruction %%%u", b, v);
+            } else if (placed[v]) {
+                VERR("%%%u is placed in more than one block", v);
+            } else {
+                placed[v] = true;
+                pos[v] = i;
+
+                if (f->insts[v].block != b) {
+                    VERR("%%%u is in b%u but says it is in b%u", v, b, f->insts[v].block);
+                }
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        IrValue term = ir_block_terminator(f, b);
+        bool reachable = block->idom != IR_NO_BLOCK;
+        bool past_phis = false;
+
+        if (term == IR_NO_VALUE) {
+            VERR("b%u does not end with a terminator", b);
+        }
+
+        uint32_t i = 0;
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            if (v == IR_NO_VALUE || v >= f->num_insts) {
+                i++;
+                continue;
+            }
+
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+
+            if (inst->op == IR_NOP) {
+                i++;
+                continue;
+            }
+
+            if (ir_op_is_terminator(inst->op) && i + 1 != block->num_insts) {
+                VERR("%%%u: terminator in the middle of b%u", v, b);
+            }
+
+            if (inst->op == IR_CALL && (inst->flags & IR_FLAG_TAIL) != 0 && ir_block_tail_call(f, b) != v) {
+                VERR("%%%u: tail call is not followed by the return of its result", v);
+            }
+
+            if (inst->op == IR_PHI) {
+                if (past_phis) {
+                    VERR("%%%u: phi after a non-phi instruction in b%u", v, b);
+                }
+
+                if (inst->num_ops != block->num_preds) {
+                    VERR("%%%u: phi has %u operands but b%u has %u predecessors", v, inst->num_ops, b, block->num_preds);
+                }
+            } else {
+                past_phis = true;
+            }
+
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                IrValue op = ops[j];
+
+                if (op == IR_NO_VALUE || op >= f->num_insts || f->insts[op].op == IR_NOP || !placed[op]) {
+                    VERR("%%%u: operand %u (%%%u) is not a live instruction", v, j, op);
+                    j++;
+                    continue;
+                }
+
+                if (f->insts[op].ty == IR_TYPE_VOID) {
+                    VERR("%%%u: operand %%%u has no value", v, op);
+                }
+
+                IrBlockId def_block = f->insts[op].block;
+
+                if (reachable && inst->op == IR_PHI) {
+                    IrBlockId pred = j < block->num_preds ? block->preds[j] : IR_NO_BLOCK;
+
+                    if (pred != IR_NO_BLOCK && f->blocks[pred].idom != IR_NO_BLOCK && !ir_dominates(f, def_block, pred)) {
+                        VERR("%%%u: phi operand %%%u does not dominate the end of b%u", v, op, pred);
+                    }
+                } else if (reachable) {
+                    bool ok = def_block == b ? pos[op] < i : ir_dominates(f, def_block, b);
+
+                    if (!ok) {
+                        VERR("%%%u: operand %%%u does not dominate its use", v, op);
+                    }
+                }
+
+                j++;
+            }
+
+            ir_verify_types(m, f, v, errors, &num_errs);
+
+            i++;
+        }
+
+        if (term != IR_NO_VALUE) {
+            IrInst *t = &f->insts[term];
+            IrValue *ops = ir_inst_ops(f, t);
+            uint32_t expected = t->op == IR_BR ? 1 : t->op == IR_CBR ? 2 : 0;
+            uint32_t first = t->op == IR_CBR ? 1 : 0;
+
+            if (block->num_succs != expected) {
+                VERR("b%u has %u successors but its terminator names %u", b, block->num_succs, expected);
+            } else {
+                uint32_t j = 0;
+                while (j < expected) {
+                    if (ops[first + j] >= f->num_blocks || block->succs[j] != ops[first + j]) {
+                        VERR("successor %u of b%u does not match its terminator", j, b);
+                    }
+
+                    j++;
+                }
+            }
+        }
+
+        i = 0;
+        while (i < block->num_succs) {
+            IrBlockId s = block->succs[i];
+            uint32_t out = 0;
+            uint32_t in = 0;
+            uint32_t j = 0;
+
+            while (j < block->num_succs) {
+                out += block->succs[j] == s;
+                j++;
+            }
+
+            j = 0;
+            while (s < f->num_blocks && j < f->blocks[s].num_preds) {
+                in += f->blocks[s].preds[j] == b;
+                j++;
+            }
+
+            if (out != in) {
+                VERR("edge b%u -> b%u is missing from the predecessors of b%u", b, s, s);
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    free((void *) pos);
+    free((void *) placed);
+
+    return num_errs;
+
+    #undef VERR
+}
+
+int32_t ir_verify_module(IrModule *m, Ptrvec *errors) {
+    int32_t num_errs = 0;
+    uint32_t i = 0;
+
+    while (i < ir_module_num_funcs(m)) {
+        num_errs += ir_verify_func(m, ir_module_func(m, i), errors);
+        i++;
+    }
+
+    return num_errs;
+}
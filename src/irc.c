@@ -0,0 +1,936 @@
+#include <string.h>
+
+#include "../include/irc.h"
+
+Irc irc_create() {
+    Irc g;
+    memset((void *) &g, 0, sizeof(Irc));
+
+    g.simplify = vec_create(sizeof(uint32_t));
+    g.freeze = vec_create(sizeof(uint32_t));
+    g.spill = vec_create(sizeof(IrcSpill));
+    g.select = vec_create(sizeof(uint32_t));
+    g.work_moves = vec_create(sizeof(uint32_t));
+
+    return g;
+}
+
+void irc_free(Irc *g) {
+    free((void *) g->node_of);
+    free((void *) g->values);
+    free((void *) g->state);
+    free((void *) g->degree);
+    free((void *) g->colors);
+    free((void *) g->alias);
+    free((void *) g->members);
+    free((void *) g->last_member);
+    free((void *) g->adj);
+    free((void *) g->node_moves);
+    free((void *) g->cost);
+    free((void *) g->color);
+    free((void *) g->mark);
+    free((void *) g->live);
+    free((void *) g->live_at);
+    free((void *) g->links);
+    free((void *) g->edges);
+    free((void *) g->moves);
+    vec_free(&g->simplify);
+    vec_free(&g->freeze);
+    vec_free(&g->spill);
+    vec_free(&g->select);
+    vec_free(&g->work_moves);
+}
+
+void irc_reserve(Irc *g, RegAlloc *ra) {
+    uint32_t n = ra->num_intervals;
+
+    if (ra->f->num_insts > g->cap_values) {
+        g->cap_values = ra->f->num_insts * 2;
+        g->node_of = (uint32_t *) realloc((void *) g->node_of, g->cap_values * sizeof(uint32_t));
+    }
+
+    if (n > g->cap_nodes) {
+        uint32_t cap = n * 2;
+
+        g->values = (IrValue *) realloc((void *) g->values, cap * sizeof(IrValue));
+        g->state = (uint8_t *) realloc((void *) g->state, cap * sizeof(uint8_t));
+        g->degree = (uint32_t *) realloc((void *) g->degree, cap * sizeof(uint32_t));
+        g->colors = (uint32_t *) realloc((void *) g->colors, cap * sizeof(uint32_t));
+        g->alias = (uint32_t *) realloc((void *) g->alias, cap * sizeof(uint32_t));
+        g->members = (uint32_t *) realloc((void *) g->members, cap * sizeof(uint32_t));
+        g->last_member = (uint32_t *) realloc((void *) g->last_member, cap * sizeof(uint32_t));
+        g->adj = (int32_t *) realloc((void *) g->adj, cap * sizeof(int32_t));
+        g->node_moves = (int32_t *) realloc((void *) g->node_moves, cap * sizeof(int32_t));
+        g->cost = (int64_t *) realloc((void *) g->cost, cap * sizeof(int64_t));
+        g->color = (int32_t *) realloc((void *) g->color, cap * sizeof(int32_t));
+        g->mark = (uint32_t *) realloc((void *) g->mark, cap * sizeof(uint32_t));
+        g->live = (uint32_t *) realloc((void *) g->live, cap * sizeof(uint32_t));
+        g->live_at = (uint32_t *) realloc((void *) g->live_at, cap * sizeof(uint32_t));
+        memset((void *) g->mark, 0, cap * sizeof(uint32_t));
+        g->stamp = 0;
+        g->cap_nodes = cap;
+    }
+
+    g->num_nodes = n;
+    g->num_links = 0;
+    g->num_moves = 0;
+    g->num_edges = 0;
+    g->simplify.len = 0;
+    g->freeze.len = 0;
+    g->spill.len = 0;
+    g->select.len = 0;
+    g->work_moves.len = 0;
+
+    if (g->cap_edges < 64) {
+        g->cap_edges = 64;
+        g->edges = (uint64_t *) realloc((void *) g->edges, g->cap_edges * sizeof(uint64_t));
+    }
+
+    memset((void *) g->edges, 0, g->cap_edges * sizeof(uint64_t));
+}
+
+void irc_link(Irc *g, int32_t *head, uint32_t to) {
+    if (g->num_links == g->cap_links) {
+        g->cap_links = g->cap_links == 0 ? 256 : g->cap_links * 2;
+        g->links = (IrcLink *) realloc((void *) g->links, g->cap_links * sizeof(IrcLink));
+    }
+
+    g->links[g->num_links].to = to;
+    g->links[g->num_links].next = *head;
+    *head = (int32_t) g->num_links++;
+}
+
+uint64_t irc_edge_key(uint32_t u, uint32_t v) {
+    return u < v ? ((uint64_t) u << 32) | v : ((uint64_t) v << 32) | u;
+}
+
+// the slot of key, or the empty slot it goes in. a key is never zero since both ends of an edge differ
+uint32_t irc_find_edge(Irc *g, uint64_t key) {
+    uint32_t mask = g->cap_edges - 1;
+    uint32_t i = (uint32_t) ((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+
+    while (g->edges[i] != 0 && g->edges[i] != key) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+bool irc_interferes(Irc *g, uint32_t u, uint32_t v) {
+    uint64_t key = irc_edge_key(u, v);
+
+    return g->edges[irc_find_edge(g, key)] == key;
+}
+
+void irc_grow_edges(Irc *g) {
+    uint64_t *old = g->edges;
+    uint32_t old_cap = g->cap_edges;
+    uint32_t i = 0;
+
+    g->cap_edges *= 2;
+    g->edges = (uint64_t *) calloc(g->cap_edges, sizeof(uint64_t));
+
+    while (i < old_cap) {
+        if (old[i] != 0) {
+            g->edges[irc_find_edge(g, old[i])] = old[i];
+        }
+
+        i++;
+    }
+
+    free((void *) old);
+}
+
+// cost[a] / degree[a] < cost[b] / degree[b], ties go to the lower node so the choice does not depend on the heap
+bool irc_spill_before(IrcSpill *a, IrcSpill *b) {
+    int64_t x = a->cost * (int64_t) b->degree;
+    int64_t y = b->cost * (int64_t) a->degree;
+
+    return x != y ? x < y : a->n < b->n;
+}
+
+void irc_push_spill(Irc *g, uint32_t n) {
+    IrcSpill e = {
+        .n = n,
+        .degree = g->degree[n],
+        .cost = g->cost[n]
+    };
+
+    vec_push(&g->spill, (void *) &e);
+
+    IrcSpill *heap = (IrcSpill *) g->spill.elements;
+    int64_t i = g->spill.len - 1;
+
+    while (i > 0 && irc_spill_before(&e, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    heap[i] = e;
+}
+
+IrcSpill irc_pop_spill(Irc *g) {
+    IrcSpill *heap = (IrcSpill *) g->spill.elements;
+    IrcSpill top = heap[0];
+    IrcSpill last = heap[--g->spill.len];
+    int64_t i = 0;
+
+    while (true) {
+        int64_t child = 2 * i + 1;
+
+        if (child >= g->spill.len) {
+            break;
+        }
+
+        if (child + 1 < g->spill.len && irc_spill_before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+
+        if (!irc_spill_before(&heap[child], &last)) {
+            break;
+        }
+
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    if (g->spill.len > 0) {
+        heap[i] = last;
+    }
+
+    return top;
+}
+
+void irc_add_edge(Irc *g, uint32_t u, uint32_t v) {
+    if (u == v) {
+        return;
+    }
+
+    uint64_t key = irc_edge_key(u, v);
+    uint32_t slot = irc_find_edge(g, key);
+
+    if (g->edges[slot] == key) {
+        return;
+    }
+
+    g->edges[slot] = key;
+    g->num_edges++;
+
+    if (g->num_edges * 2 > g->cap_edges) {
+        irc_grow_edges(g);
+    }
+
+    irc_link(g, &g->adj[u], v);
+    irc_link(g, &g->adj[v], u);
+    g->degree[u]++;
+    g->degree[v]++;
+
+    // a node that gains a neighbour while it waits to be spilled gets cheaper per neighbour
+    if (g->state[u] == IRC_SPILL) {
+        irc_push_spill(g, u);
+    }
+
+    if (g->state[v] == IRC_SPILL) {
+        irc_push_spill(g, v);
+    }
+}
+
+void irc_add_move(Irc *g, IrValue a, IrValue b) {
+    uint32_t u = g->node_of[a];
+    uint32_t v = g->node_of[b];
+
+    if (u == UINT32_MAX || v == UINT32_MAX || u == v) {
+        return;
+    }
+
+    if (g->num_moves == g->cap_moves) {
+        g->cap_moves = g->cap_moves == 0 ? 64 : g->cap_moves * 2;
+        g->moves = (IrcMove *) realloc((void *) g->moves, g->cap_moves * sizeof(IrcMove));
+    }
+
+    uint32_t m = g->num_moves++;
+    g->moves[m].a = u;
+    g->moves[m].b = v;
+    g->moves[m].state = IRC_MOVE_WORKLIST;
+
+    irc_link(g, &g->node_moves[u], m);
+    irc_link(g, &g->node_moves[v], m);
+    vec_push(&g->work_moves, (void *) &m);
+}
+
+void irc_live_add(Irc *g, IrValue v) {
+    uint32_t n = g->node_of[v];
+
+    if (n == UINT32_MAX || (g->live_at[n] < g->num_live && g->live[g->live_at[n]] == n)) {
+        return;
+    }
+
+    g->live_at[n] = g->num_live;
+    g->live[g->num_live++] = n;
+}
+
+void irc_live_remove(Irc *g, uint32_t n) {
+    if (g->live_at[n] < g->num_live && g->live[g->live_at[n]] == n) {
+        uint32_t last = g->live[--g->num_live];
+
+        g->live[g->live_at[n]] = last;
+        g->live_at[last] = g->live_at[n];
+    }
+}
+
+void irc_interfere_live(Irc *g, uint32_t n) {
+    uint32_t k = 0;
+
+    while (k < g->num_live) {
+        irc_add_edge(g, n, g->live[k]);
+        k++;
+    }
+}
+
+// the values live at the end of a block: the ones live into a successor and the phi operands sent along its edges
+void irc_live_out(Irc *g, RegAlloc *ra, IrBlockId b) {
+    IrFunc *f = ra->f;
+    IrBlock *block = &f->blocks[b];
+    uint64_t words = (ra->num_globals + 63) / 64;
+    uint64_t w = 0;
+    uint32_t s = 0;
+
+    g->num_live = 0;
+
+    while (w < words) {
+        uint64_t out = ra->live_out[b * words + w];
+
+        while (out != 0) {
+            irc_live_add(g, ra->global_vals[w * 64 + __builtin_ctzll(out)]);
+            out &= out - 1;
+        }
+
+        w++;
+    }
+
+    while (s < block->num_succs) {
+        IrBlock *succ = &f->blocks[block->succs[s]];
+        int32_t k = -1;
+        uint32_t i = 0;
+
+        while (i < succ->num_insts && f->insts[succ->insts[i]].op == IR_PHI) {
+            k = k < 0 ? ir_pred_index(f, block->succs[s], b) : k;
+            irc_live_add(g, ir_inst_ops(f, &f->insts[succ->insts[i]])[k]);
+            i++;
+        }
+
+        s++;
+    }
+}
+
+// walks every block backwards from the values live out of it, each definition interferes with whatever is live
+// right after it and a call makes everything live across it take a callee saved register. the phis of a block
+// are written together on every edge into it and the parameters together on entry, so each group interferes
+// with itself as a whole. a fused compare is read by its branch, so its operands are used there
+bool irc_build_graph(Irc *g, RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint32_t i = 0;
+
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t num_phis = 0;
+        uint32_t j = block->num_insts;
+
+        irc_live_out(g, ra, b);
+
+        while (num_phis < block->num_insts && f->insts[block->insts[num_phis]].op == IR_PHI) {
+            num_phis++;
+        }
+
+        while (j > num_phis) {
+            j--;
+
+            IrValue v = block->insts[j];
+            IrInst *inst = &f->insts[v];
+            uint32_t n = g->node_of[v];
+
+            if (ra->fused[v] || inst->op == IR_PARAM) {
+                continue;
+            }
+
+            if (n != UINT32_MAX) {
+                irc_live_remove(g, n);
+                irc_interfere_live(g, n);
+            }
+
+            if (regalloc_is_call(inst->op)) {
+                uint32_t k = 0;
+
+                while (k < g->num_live) {
+                    g->colors[g->live[k]] = RA_NUM_REGS - RA_FIRST_CALLEE_SAVED;
+                    k++;
+                }
+            }
+
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t num_ops = ir_inst_num_values(inst);
+            uint32_t k = 0;
+
+            while (k < num_ops) {
+                irc_live_add(g, ops[k]);
+                k++;
+            }
+
+            if (inst->op == IR_CBR && ra->fused[ops[0]]) {
+                IrInst *cmp = &f->insts[ops[0]];
+
+                irc_live_add(g, cmp->u.ops[0]);
+                irc_live_add(g, cmp->u.ops[1]);
+            }
+
+            if (g->num_edges > IRC_MAX_EDGES) {
+                return false;
+            }
+        }
+
+        j = 0;
+        while (j < num_phis) {
+            uint32_t n = g->node_of[block->insts[j]];
+
+            if (n != UINT32_MAX) {
+                irc_live_remove(g, n);
+            }
+
+            j++;
+        }
+
+        j = 0;
+        while (j < num_phis) {
+            uint32_t n = g->node_of[block->insts[j]];
+
+            if (n != UINT32_MAX) {
+                irc_interfere_live(g, n);
+
+                uint32_t k = 0;
+                while (k < j) {
+                    if (g->node_of[block->insts[k]] != UINT32_MAX) {
+                        irc_add_edge(g, n, g->node_of[block->insts[k]]);
+                    }
+
+                    k++;
+                }
+            }
+
+            j++;
+        }
+
+        if (b == 0) {
+            j = 0;
+            while (j < block->num_insts) {
+                if (f->insts[block->insts[j]].op == IR_PARAM) {
+                    irc_live_add(g, block->insts[j]);
+                }
+
+                j++;
+            }
+
+            j = 0;
+            while (j < block->num_insts) {
+                uint32_t n = g->node_of[block->insts[j]];
+
+                if (f->insts[block->insts[j]].op == IR_PARAM && n != UINT32_MAX) {
+                    irc_interfere_live(g, n);
+                }
+
+                j++;
+            }
+        }
+
+        if (g->num_edges > IRC_MAX_EDGES) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+bool irc_build(Irc *g, RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint32_t i = 0;
+
+    memset((void *) g->node_of, 0xff, f->num_insts * sizeof(uint32_t));
+
+    while (i < g->num_nodes) {
+        RaInterval *it = &ra->intervals[i];
+        IrValue v = it->v;
+
+        g->node_of[v] = i;
+        g->values[i] = v;
+        g->state[i] = IRC_INITIAL;
+        g->degree[i] = 0;
+        g->colors[i] = RA_NUM_REGS;
+        g->alias[i] = i;
+        g->members[i] = UINT32_MAX;
+        g->last_member[i] = i;
+        g->adj[i] = -1;
+        g->node_moves[i] = -1;
+        g->color[i] = -1;
+        g->live_at[i] = UINT32_MAX;
+
+        // the definition is a store when the value is spilled, parameters and phis are written where they arrive
+        IrBlockId def_block = f->insts[v].op == IR_PARAM ? 0 : f->insts[v].block;
+        g->cost[i] = regalloc_use_cost(ra, v, it->start, it->end) + regalloc_block_weight(ra, def_block);
+
+        i++;
+    }
+
+    if (!irc_build_graph(g, ra)) {
+        return false;
+    }
+
+    i = 0;
+    while (i < g->num_nodes) {
+        IrValue v = g->values[i];
+        IrInst *inst = &f->insts[v];
+
+        if (inst->op == IR_PHI) {
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t k = 0;
+
+            while (k < inst->num_ops) {
+                irc_add_move(g, v, ops[k]);
+                k++;
+            }
+        } else if (inst->op == IR_COPY) {
+            irc_add_move(g, v, inst->u.ops[0]);
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+uint32_t irc_alias(Irc *g, uint32_t n) {
+    while (g->state[n] == IRC_COALESCED) {
+        n = g->alias[n];
+    }
+
+    return n;
+}
+
+bool irc_move_live(Irc *g, uint32_t m) {
+    return g->moves[m].state == IRC_MOVE_WORKLIST || g->moves[m].state == IRC_MOVE_ACTIVE;
+}
+
+// the moves of a node are the moves of every node coalesced into it
+bool irc_move_related(Irc *g, uint32_t n) {
+    uint32_t member = n;
+
+    while (member != UINT32_MAX) {
+        int32_t l = g->node_moves[member];
+
+        while (l >= 0) {
+            if (irc_move_live(g, g->links[l].to)) {
+                return true;
+            }
+
+            l = g->links[l].next;
+        }
+
+        member = g->members[member];
+    }
+
+    return false;
+}
+
+bool irc_removed(Irc *g, uint32_t n) {
+    return g->state[n] == IRC_SELECT || g->state[n] == IRC_COALESCED;
+}
+
+void irc_push(Irc *g, uint32_t n, uint8_t state) {
+    g->state[n] = state;
+
+    if (state == IRC_SIMPLIFY) {
+        vec_push(&g->simplify, (void *) &n);
+    } else if (state == IRC_FREEZE) {
+        vec_push(&g->freeze, (void *) &n);
+    } else if (state == IRC_SPILL) {
+        irc_push_spill(g, n);
+    }
+}
+
+void irc_make_worklists(Irc *g) {
+    uint32_t i = 0;
+
+    while (i < g->num_nodes) {
+        if (g->degree[i] >= g->colors[i]) {
+            irc_push(g, i, IRC_SPILL);
+        } else if (irc_move_related(g, i)) {
+            irc_push(g, i, IRC_FREEZE);
+        } else {
+            irc_push(g, i, IRC_SIMPLIFY);
+        }
+
+        i++;
+    }
+}
+
+void irc_enable_moves(Irc *g, uint32_t n) {
+    uint32_t member = n;
+
+    while (member != UINT32_MAX) {
+        int32_t l = g->node_moves[member];
+
+        while (l >= 0) {
+            uint32_t m = g->links[l].to;
+
+            if (g->moves[m].state == IRC_MOVE_ACTIVE) {
+                g->moves[m].state = IRC_MOVE_WORKLIST;
+                vec_push(&g->work_moves, (void *) &m);
+            }
+
+            l = g->links[l].next;
+        }
+
+        member = g->members[member];
+    }
+}
+
+void irc_decrement_degree(Irc *g, uint32_t n) {
+    uint32_t d = g->degree[n]--;
+
+    if (d != g->colors[n]) {
+        return;
+    }
+
+    irc_enable_moves(g, n);
+
+    int32_t l = g->adj[n];
+    while (l >= 0) {
+        if (!irc_removed(g, g->links[l].to)) {
+            irc_enable_moves(g, g->links[l].to);
+        }
+
+        l = g->links[l].next;
+    }
+
+    if (g->state[n] == IRC_SPILL) {
+        irc_push(g, n, irc_move_related(g, n) ? IRC_FREEZE : IRC_SIMPLIFY);
+    }
+}
+
+void irc_simplify(Irc *g, uint32_t n) {
+    g->state[n] = IRC_SELECT;
+    vec_push(&g->select, (void *) &n);
+
+    int32_t l = g->adj[n];
+    while (l >= 0) {
+        if (!irc_removed(g, g->links[l].to)) {
+            irc_decrement_degree(g, g->links[l].to);
+        }
+
+        l = g->links[l].next;
+    }
+}
+
+void irc_add_work_list(Irc *g, uint32_t n) {
+    if (g->state[n] == IRC_FREEZE && !irc_move_related(g, n) && g->degree[n] < g->colors[n]) {
+        irc_push(g, n, IRC_SIMPLIFY);
+    }
+}
+
+// briggs: the merged node has fewer neighbours of significant degree than colours, so it still simplifies
+bool irc_conservative(Irc *g, uint32_t u, uint32_t v) {
+    uint32_t k = g->colors[u] < g->colors[v] ? g->colors[u] : g->colors[v];
+    uint32_t num_significant = 0;
+    uint32_t ends[2] = { u, v };
+    int32_t e = 0;
+
+    g->stamp++;
+
+    while (e < 2) {
+        int32_t l = g->adj[ends[e]];
+
+        while (l >= 0) {
+            uint32_t t = g->links[l].to;
+
+            if (!irc_removed(g, t) && g->mark[t] != g->stamp) {
+                g->mark[t] = g->stamp;
+                num_significant += g->degree[t] >= g->colors[t];
+
+                if (num_significant >= k) {
+                    return false;
+                }
+            }
+
+            l = g->links[l].next;
+        }
+
+        e++;
+    }
+
+    return true;
+}
+
+void irc_combine(Irc *g, uint32_t u, uint32_t v) {
+    g->state[v] = IRC_COALESCED;
+    g->alias[v] = u;
+    g->members[g->last_member[u]] = v;
+    g->last_member[u] = g->last_member[v];
+    g->cost[u] += g->cost[v];
+    g->colors[u] = g->colors[v] < g->colors[u] ? g->colors[v] : g->colors[u];
+    g->num_coalesced++;
+
+    irc_enable_moves(g, v);
+
+    int32_t l = g->adj[v];
+    while (l >= 0) {
+        uint32_t t = g->links[l].to;
+
+        if (!irc_removed(g, t)) {
+            irc_add_edge(g, t, u);
+            irc_decrement_degree(g, t);
+        }
+
+        l = g->links[l].next;
+    }
+
+    if (g->degree[u] >= g->colors[u] && g->state[u] == IRC_FREEZE) {
+        irc_push(g, u, IRC_SPILL);
+    }
+}
+
+void irc_coalesce(Irc *g, uint32_t m) {
+    uint32_t u = irc_alias(g, g->moves[m].a);
+    uint32_t v = irc_alias(g, g->moves[m].b);
+
+    if (u == v) {
+        g->moves[m].state = IRC_MOVE_COALESCED;
+        irc_add_work_list(g, u);
+    } else if (irc_interferes(g, u, v)) {
+        g->moves[m].state = IRC_MOVE_CONSTRAINED;
+        irc_add_work_list(g, u);
+        irc_add_work_list(g, v);
+    } else if (irc_conservative(g, u, v)) {
+        g->moves[m].state = IRC_MOVE_COALESCED;
+        irc_combine(g, u, v);
+        irc_add_work_list(g, u);
+    } else {
+        g->moves[m].state = IRC_MOVE_ACTIVE;
+    }
+}
+
+void irc_freeze_moves(Irc *g, uint32_t u) {
+    uint32_t member = u;
+
+    while (member != UINT32_MAX) {
+        int32_t l = g->node_moves[member];
+
+        while (l >= 0) {
+            uint32_t m = g->links[l].to;
+
+            if (irc_move_live(g, m)) {
+                uint32_t x = irc_alias(g, g->moves[m].a);
+                uint32_t y = irc_alias(g, g->moves[m].b);
+                uint32_t other = y == irc_alias(g, u) ? x : y;
+
+                g->moves[m].state = IRC_MOVE_FROZEN;
+
+                if (g->state[other] == IRC_FREEZE && !irc_move_related(g, other) && g->degree[other] < g->colors[other]) {
+                    irc_push(g, other, IRC_SIMPLIFY);
+                }
+            }
+
+            l = g->links[l].next;
+        }
+
+        member = g->members[member];
+    }
+}
+
+// the cheapest node per neighbour, spilling it frees the most for the least reloads. an entry whose node lost
+// neighbours or was coalesced since it was pushed goes back in with the key it has now
+void irc_select_spill(Irc *g) {
+    while (true) {
+        IrcSpill e = irc_pop_spill(g);
+        uint32_t n = e.n;
+
+        if (g->state[n] != IRC_SPILL) {
+            continue;
+        }
+
+        if (e.degree != g->degree[n] || e.cost != g->cost[n]) {
+            irc_push_spill(g, n);
+            continue;
+        }
+
+        irc_push(g, n, IRC_SIMPLIFY);
+        irc_freeze_moves(g, n);
+        return;
+    }
+}
+
+// pops entries until one is still on its list
+bool irc_pop(Vec *stack, uint8_t *state, uint8_t want, uint32_t *out) {
+    while (stack->len > 0) {
+        uint32_t n = ((uint32_t *) stack->elements)[--stack->len];
+
+        if (state[n] == want) {
+            *out = n;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool irc_pop_move(Irc *g, uint32_t *out) {
+    while (g->work_moves.len > 0) {
+        uint32_t m = ((uint32_t *) g->work_moves.elements)[--g->work_moves.len];
+
+        if (g->moves[m].state == IRC_MOVE_WORKLIST) {
+            *out = m;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// drops the entries of nodes that have left the spill worklist from the top of the heap
+bool irc_has_spill(Irc *g) {
+    while (g->spill.len > 0 && g->state[((IrcSpill *) g->spill.elements)[0].n] != IRC_SPILL) {
+        irc_pop_spill(g);
+    }
+
+    return g->spill.len > 0;
+}
+
+// the colour of a coalesced partner if it is free, so the move between them goes away
+int32_t irc_partner_color(Irc *g, uint32_t n, uint32_t ok) {
+    uint32_t member = n;
+
+    while (member != UINT32_MAX) {
+        int32_t l = g->node_moves[member];
+
+        while (l >= 0) {
+            IrcMove *m = &g->moves[g->links[l].to];
+            uint32_t other = irc_alias(g, m->a) == n ? irc_alias(g, m->b) : irc_alias(g, m->a);
+
+            if (g->state[other] == IRC_COLORED && (ok & (1u << g->color[other])) != 0) {
+                return g->color[other];
+            }
+
+            l = g->links[l].next;
+        }
+
+        member = g->members[member];
+    }
+
+    return -1;
+}
+
+void irc_assign_colors(Irc *g, RegAlloc *ra) {
+    uint32_t n = 0;
+
+    while (g->select.len > 0) {
+        n = ((uint32_t *) g->select.elements)[--g->select.len];
+
+        uint32_t first = g->colors[n] < RA_NUM_REGS ? RA_FIRST_CALLEE_SAVED : 0;
+        uint32_t ok = ((1u << RA_NUM_REGS) - 1) & ~((1u << first) - 1);
+
+        int32_t l = g->adj[n];
+        while (l >= 0) {
+            uint32_t a = irc_alias(g, g->links[l].to);
+
+            if (g->state[a] == IRC_COLORED) {
+                ok &= ~(1u << g->color[a]);
+            }
+
+            l = g->links[l].next;
+        }
+
+        if (ok == 0) {
+            g->state[n] = IRC_SPILLED;
+            continue;
+        }
+
+        int32_t hint = -1;
+        uint32_t member = n;
+
+        while (member != UINT32_MAX && hint < 0) {
+            hint = regalloc_hint(ra, g->values[member]);
+            hint = hint >= 0 && (ok & (1u << hint)) != 0 ? hint : -1;
+            member = g->members[member];
+        }
+
+        hint = hint >= 0 ? hint : irc_partner_color(g, n, ok);
+        g->state[n] = IRC_COLORED;
+        g->color[n] = hint >= 0 ? hint : __builtin_ctz(ok);
+    }
+}
+
+// there is no rewrite round after spilling: the code generator reaches spilled values through its scratch
+// registers, so a value spilled here lives in its slot for its whole life. the values coalesced into one node
+// share its register or its slot
+void irc_write_locs(Irc *g, RegAlloc *ra) {
+    uint32_t i = 0;
+
+    while (i < g->num_nodes) {
+        uint32_t n = irc_alias(g, i);
+        IrValue v = g->values[i];
+
+        if (g->state[n] == IRC_SPILLED) {
+            IrValue rep = g->values[n];
+
+            regalloc_spill(ra, rep);
+            ra->spill_slot[v] = ra->spill_slot[rep];
+            ra->num_spilled += v != rep;
+            ra->locs[v].kind = LOC_STACK;
+            ra->locs[v].slot = ra->spill_slot[v];
+        } else {
+            ra->locs[v].kind = LOC_REG;
+            ra->locs[v].reg = regalloc_regs[g->color[n]];
+            ra->used_regs |= 1u << regalloc_regs[g->color[n]];
+        }
+
+        i++;
+    }
+}
+
+bool irc_run(Irc *g, RegAlloc *ra) {
+    uint32_t n = 0;
+    uint32_t m = 0;
+
+    if (ra->num_intervals > IRC_MAX_NODES) {
+        return false;
+    }
+
+    g->ra = ra;
+    irc_reserve(g, ra);
+
+    if (!irc_build(g, ra)) {
+        return false;
+    }
+
+    irc_make_worklists(g);
+
+    while (true) {
+        if (irc_pop(&g->simplify, g->state, IRC_SIMPLIFY, &n)) {
+            irc_simplify(g, n);
+        } else if (irc_pop_move(g, &m)) {
+            irc_coalesce(g, m);
+        } else if (irc_pop(&g->freeze, g->state, IRC_FREEZE, &n)) {
+            irc_push(g, n, IRC_SIMPLIFY);
+            irc_freeze_moves(g, n);
+        } else if (irc_has_spill(g)) {
+            irc_select_spill(g);
+        } else {
+            break;
+        }
+    }
+
+    irc_assign_colors(g, ra);
+    irc_write_locs(g, ra);
+
+    return true;
+}
@@ -0,0 +1,679 @@
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../include/jit.h"
+#include "../include/vm.h"
+#include "../include/x64.h"
+#include "../include/timer.h"
+
+// branches to the stubs emitted after the last instruction and calls to the function's own prologue
+#define JIT_TARGET_FAIL UINT32_MAX
+#define JIT_TARGET_DIV0 (UINT32_MAX - 1)
+#define JIT_TARGET_START (UINT32_MAX - 2)
+
+#define JIT_REG(r) ((int32_t) ((r) * sizeof(int64_t)))
+#define JIT_ADDR(p) ((int64_t) (intptr_t) (p))
+#define JIT_VM(field) ((int32_t) offsetof(Vm, field))
+
+static const X64Reg jit_arg_regs[] = { X64_RDI, X64_RSI, X64_RDX, X64_RCX, X64_R8, X64_R9 };
+#define JIT_NUM_ARG_REGS ((uint32_t) (sizeof(jit_arg_regs) / sizeof(jit_arg_regs[0])))
+
+Jit jit_create(BcModule *m) {
+    Jit jit;
+    memset((void *) &jit, 0, sizeof(Jit));
+
+    jit.m = m;
+    jit.code = buf_create();
+    jit.fixups = vec_create(sizeof(JitFixup));
+    jit.regions = vec_create(sizeof(JitRegion));
+
+    return jit;
+}
+
+// the bytecode outlives the jit, so its functions go back to being interpreted and counting from zero
+void jit_free(Jit *jit) {
+    uint32_t i = 0;
+    while (i < jit->m->num_funcs) {
+        BcFunc *f = &jit->m->funcs[i];
+
+        free((void *) f->native_offsets);
+        f->native = NULL;
+        f->native_offsets = NULL;
+        f->calls = 0;
+        f->loops = 0;
+
+        i++;
+    }
+
+    int64_t j = 0;
+    while (j < jit->regions.len) {
+        JitRegion *region = (JitRegion *) vec_get_ptr(&jit->regions, j);
+        munmap(region->ptr, region->size);
+        j++;
+    }
+
+    buf_free(&jit->code);
+    vec_free(&jit->fixups);
+    vec_free(&jit->regions);
+}
+
+void jit_branch(Jit *jit, uint32_t at, uint32_t target) {
+    JitFixup fixup = {
+        .at = at,
+        .target = target
+    };
+
+    vec_push(&jit->fixups, (void *) &fixup);
+}
+
+void jit_jmp(Jit *jit, uint32_t i, uint32_t target) {
+    if (target != i + 1) {
+        jit_branch(jit, x64_jmp(&jit->code), target);
+    }
+}
+
+// the true target is taken by jcc and the false one is either the next instruction or a jmp
+void jit_cond_branch(Jit *jit, X64Cond cc, uint32_t i, uint32_t then_target, uint32_t else_target) {
+    if (then_target == i + 1) {
+        jit_branch(jit, x64_jcc(&jit->code, x64_cond_negate(cc)), else_target);
+        return;
+    }
+
+    jit_branch(jit, x64_jcc(&jit->code, cc), then_target);
+    jit_jmp(jit, i, else_target);
+}
+
+bool jit_fits_i32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+void jit_call_abs(Buf *b, int64_t fn) {
+    x64_mov_ri(b, 8, X64_RAX, fn);
+    x64_call_r(b, X64_RAX);
+}
+
+void jit_epilogue(Buf *b) {
+    x64_pop(b, X64_R13);
+    x64_pop(b, X64_R12);
+    x64_pop(b, X64_RBX);
+    x64_ret(b);
+}
+
+// the right operand of a compare or a 64 bit op: a register, or an immediate that needs rcx when it is wide
+void jit_alu_rhs(Buf *b, X64AluOp op, int32_t size, bool imm, const BcInst *inst, uint32_t reg) {
+    if (!imm) {
+        x64_alu_rm(b, op, size, X64_RAX, X64_RBX, JIT_REG(reg));
+    } else if (size == 4 || jit_fits_i32(inst->imm)) {
+        x64_alu_ri(b, op, size, X64_RAX, (int32_t) inst->imm);
+    } else {
+        x64_mov_ri(b, 8, X64_RCX, inst->imm);
+        x64_alu_rr(b, op, size, X64_RAX, X64_RCX);
+    }
+}
+
+// narrow results are kept sign extended, like in the interpreter
+void jit_store_result(Buf *b, int32_t size, uint32_t reg) {
+    if (size == 4) {
+        x64_movsxd(b, X64_RAX, X64_RAX);
+    }
+
+    x64_store(b, 8, X64_RBX, JIT_REG(reg), X64_RAX);
+}
+
+void jit_arith(Buf *b, const BcInst *inst, X64AluOp op, int32_t size, bool imm) {
+    x64_load(b, size, X64_RAX, X64_RBX, JIT_REG(inst->b));
+    jit_alu_rhs(b, op, size, imm, inst, inst->c);
+    jit_store_result(b, size, inst->a);
+}
+
+void jit_mul(Buf *b, const BcInst *inst, int32_t size, bool imm) {
+    x64_load(b, size, X64_RAX, X64_RBX, JIT_REG(inst->b));
+
+    if (imm && (size == 4 || jit_fits_i32(inst->imm))) {
+        x64_imul_rri(b, size, X64_RAX, X64_RAX, (int32_t) inst->imm);
+    } else {
+        if (imm) {
+            x64_mov_ri(b, 8, X64_RCX, inst->imm);
+        } else {
+            x64_load(b, 8, X64_RCX, X64_RBX, JIT_REG(inst->c));
+        }
+
+        x64_imul_rr(b, size, X64_RAX, X64_RCX);
+    }
+
+    jit_store_result(b, size, inst->a);
+}
+
+void jit_shift(Buf *b, const BcInst *inst, int32_t ext, int32_t size, bool imm) {
+    x64_load(b, size, X64_RAX, X64_RBX, JIT_REG(inst->b));
+
+    if (imm) {
+        x64_shift_ri(b, ext, size, X64_RAX, (uint8_t) (inst->imm & (size * 8 - 1)));
+    } else {
+        x64_load(b, 8, X64_RCX, X64_RBX, JIT_REG(inst->c));
+        x64_shift_cl(b, ext, size, X64_RAX);
+    }
+
+    jit_store_result(b, size, inst->a);
+}
+
+// narrow operands are sign extended, so they are divided as 64 bit values like the interpreter does. the
+// one 64 bit quotient that traps, the smallest value by -1, is handled before idiv
+void jit_div(Jit *jit, const BcInst *inst, bool mod, bool wide) {
+    Buf *b = &jit->code;
+    uint32_t done = 0;
+
+    x64_load(b, 8, X64_RCX, X64_RBX, JIT_REG(inst->c));
+    x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->b));
+    x64_test_rr(b, 8, X64_RCX, X64_RCX);
+    jit_branch(jit, x64_jcc(b, X64_CC_E), JIT_TARGET_DIV0);
+
+    if (wide) {
+        x64_alu_ri(b, X64_CMP, 8, X64_RCX, -1);
+        uint32_t not_minus_one = x64_jcc(b, X64_CC_NE);
+
+        if (mod) {
+            x64_mov_ri(b, 4, X64_RAX, 0);
+        } else {
+            x64_unary(b, X64_EXT_NEG, 8, X64_RAX);
+        }
+
+        done = x64_jmp(b);
+        x64_patch_rel32(b, not_minus_one, b->len);
+    }
+
+    x64_sign_extend_ax(b, 8);
+    x64_unary(b, X64_EXT_IDIV, 8, X64_RCX);
+
+    if (mod) {
+        x64_mov_rr(b, 8, X64_RAX, X64_RDX);
+    }
+
+    if (wide) {
+        x64_patch_rel32(b, done, b->len);
+    }
+
+    jit_store_result(b, wide ? 8 : 4, inst->a);
+}
+
+void jit_unary(Buf *b, const BcInst *inst, int32_t ext, int32_t size) {
+    x64_load(b, size, X64_RAX, X64_RBX, JIT_REG(inst->b));
+    x64_unary(b, ext, size, X64_RAX);
+    jit_store_result(b, size, inst->a);
+}
+
+void jit_compare(Buf *b, const BcInst *inst, X64Cond cc, bool imm) {
+    x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->b));
+    jit_alu_rhs(b, X64_CMP, 8, imm, inst, inst->c);
+    x64_setcc(b, cc, X64_RAX);
+    x64_movzx8(b, X64_RAX, X64_RAX);
+    x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+}
+
+// fused compare and branch, the right operand is the register in imm or the immediate itself
+void jit_compare_branch(Jit *jit, const BcInst *inst, uint32_t i, X64Cond cc, bool imm) {
+    Buf *b = &jit->code;
+
+    x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->a));
+    jit_alu_rhs(b, X64_CMP, 8, imm, inst, (uint32_t) inst->imm);
+    jit_cond_branch(jit, cc, i, inst->b, inst->c);
+}
+
+void jit_load(Buf *b, const BcInst *inst, int32_t size) {
+    x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->b));
+    x64_load(b, size, X64_RAX, X64_RAX, (int32_t) inst->c);
+    jit_store_result(b, size, inst->a);
+}
+
+void jit_store(Buf *b, const BcInst *inst, int32_t size, bool imm) {
+    x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->a));
+
+    if (imm && (size < 8 || jit_fits_i32(inst->imm))) {
+        x64_store_imm(b, size, X64_RAX, (int32_t) inst->c, (int32_t) inst->imm);
+        return;
+    }
+
+    if (imm) {
+        x64_mov_ri(b, 8, X64_RCX, inst->imm);
+    } else {
+        x64_load(b, 8, X64_RCX, X64_RBX, JIT_REG(inst->b));
+    }
+
+    x64_store(b, size, X64_RAX, (int32_t) inst->c, X64_RCX);
+}
+
+// calls that return false have set the vm's error, the function then leaves through the fail stub
+void jit_check_call(Jit *jit) {
+    x64_movzx8(&jit->code, X64_RAX, X64_RAX);
+    x64_test_rr(&jit->code, 4, X64_RAX, X64_RAX);
+    jit_branch(jit, x64_jcc(&jit->code, X64_CC_E), JIT_TARGET_FAIL);
+}
+
+void jit_call(Jit *jit, uint32_t idx, const BcInst *inst) {
+    Buf *b = &jit->code;
+
+    x64_mov_rr(b, 8, X64_RDI, X64_R13);
+    x64_mov_ri(b, 4, X64_RSI, idx);
+    x64_mov_ri(b, 8, X64_RDX, JIT_ADDR(inst));
+    x64_mov_rr(b, 8, X64_RCX, X64_RBX);
+    x64_mov_rr(b, 8, X64_R8, X64_R12);
+    jit_call_abs(b, JIT_ADDR(vm_jit_call));
+    jit_check_call(jit);
+}
+
+// a callee that is already compiled, or the function calling itself, is entered directly after setting up its
+// window the way the interpreter does. when a stack would overflow or the c stack is deep the helper takes over
+void jit_call_direct(Jit *jit, uint32_t idx, BcFunc *f, const BcInst *inst) {
+    Buf *b = &jit->code;
+    BcFunc *callee = &jit->m->funcs[inst->c];
+    int32_t next = JIT_REG(f->num_regs);
+    int32_t next_mem = (int32_t) f->frame_size;
+    uint32_t slow[3];
+
+    x64_lea(b, X64_RAX, X64_RBX, next + JIT_REG(callee->num_regs));
+    x64_alu_rm(b, X64_CMP, 8, X64_RAX, X64_R13, JIT_VM(regs_end));
+    slow[0] = x64_jcc(b, X64_CC_A);
+    x64_lea(b, X64_RAX, X64_R12, next_mem + (int32_t) callee->frame_size);
+    x64_alu_rm(b, X64_CMP, 8, X64_RAX, X64_R13, JIT_VM(stack_end));
+    slow[1] = x64_jcc(b, X64_CC_A);
+    x64_load(b, 4, X64_RAX, X64_R13, JIT_VM(native_depth));
+    x64_alu_ri(b, X64_CMP, 4, X64_RAX, VM_MAX_NATIVE_DEPTH);
+    slow[2] = x64_jcc(b, X64_CC_AE);
+    x64_alu_ri(b, X64_ADD, 4, X64_RAX, 1);
+    x64_store(b, 4, X64_R13, JIT_VM(native_depth), X64_RAX);
+
+    uint32_t i = 0;
+    while (i < (uint32_t) inst->imm) {
+        x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(f->args[inst->b + i]));
+        x64_store(b, 8, X64_RBX, next + JIT_REG(i), X64_RAX);
+        i++;
+    }
+
+    i = 0;
+    while (i < callee->num_consts) {
+        int32_t disp = next + JIT_REG(callee->num_params + i);
+
+        if (jit_fits_i32(callee->consts[i])) {
+            x64_store_imm(b, 8, X64_RBX, disp, (int32_t) callee->consts[i]);
+        } else {
+            x64_mov_ri(b, 8, X64_RAX, callee->consts[i]);
+            x64_store(b, 8, X64_RBX, disp, X64_RAX);
+        }
+
+        i++;
+    }
+
+    x64_mov_rr(b, 8, X64_RDI, X64_R13);
+    x64_lea(b, X64_RSI, X64_RBX, next);
+    x64_lea(b, X64_RDX, X64_R12, next_mem);
+
+    if (callee == f) {
+        jit_branch(jit, x64_lea_rip(b, X64_RCX), 0);
+        jit_branch(jit, x64_call(b), JIT_TARGET_START);
+    } else {
+        x64_mov_ri(b, 8, X64_RCX, JIT_ADDR(callee->native + callee->native_offsets[0]));
+        jit_call_abs(b, JIT_ADDR(callee->native));
+    }
+
+    x64_load(b, 4, X64_RCX, X64_R13, JIT_VM(native_depth));
+    x64_alu_ri(b, X64_SUB, 4, X64_RCX, 1);
+    x64_store(b, 4, X64_R13, JIT_VM(native_depth), X64_RCX);
+    x64_load(b, 8, X64_RCX, X64_R13, JIT_VM(error_func));
+    x64_test_rr(b, 8, X64_RCX, X64_RCX);
+    jit_branch(jit, x64_jcc(b, X64_CC_NE), JIT_TARGET_FAIL);
+
+    if (callee->ret != IR_TYPE_VOID) {
+        x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+    }
+
+    uint32_t done = x64_jmp(b);
+
+    i = 0;
+    while (i < 3) {
+        x64_patch_rel32(b, slow[i], b->len);
+        i++;
+    }
+
+    jit_call(jit, idx, inst);
+    x64_patch_rel32(b, done, b->len);
+}
+
+// externs that take their arguments in registers are called directly, the rest through the vm's trampolines
+void jit_call_extern(Jit *jit, uint32_t idx, BcFunc *f, const BcInst *inst) {
+    Buf *b = &jit->code;
+    BcExtern *e = &jit->m->externs[inst->c];
+    uint32_t n = (uint32_t) inst->imm;
+
+    if (e->fn == NULL || n > JIT_NUM_ARG_REGS) {
+        x64_mov_rr(b, 8, X64_RDI, X64_R13);
+        x64_mov_ri(b, 4, X64_RSI, idx);
+        x64_mov_ri(b, 8, X64_RDX, JIT_ADDR(inst));
+        x64_mov_rr(b, 8, X64_RCX, X64_RBX);
+        jit_call_abs(b, JIT_ADDR(vm_jit_call_extern));
+        jit_check_call(jit);
+        return;
+    }
+
+    uint32_t i = 0;
+    while (i < n) {
+        x64_load(b, 8, jit_arg_regs[i], X64_RBX, JIT_REG(f->args[inst->b + i]));
+        i++;
+    }
+
+    if (e->is_varargs) {
+        x64_mov_ri(b, 4, X64_RAX, 0);
+    }
+
+    x64_mov_ri(b, 8, X64_R11, JIT_ADDR(e->fn));
+    x64_call_r(b, X64_R11);
+
+    // c functions only set the low bits of narrow return values
+    switch (e->ret) {
+        case IR_TYPE_VOID:
+            return;
+        case IR_TYPE_I1:
+            x64_alu_ri(b, X64_AND, 4, X64_RAX, 1);
+            break;
+        case IR_TYPE_I8:
+            x64_movzx8(b, X64_RAX, X64_RAX);
+            break;
+        case IR_TYPE_I32:
+            x64_movsxd(b, X64_RAX, X64_RAX);
+            break;
+        default:
+            break;
+    }
+
+    x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+}
+
+void jit_fail(Buf *b, uint32_t idx, const char *error) {
+    x64_mov_rr(b, 8, X64_RDI, X64_R13);
+    x64_mov_ri(b, 4, X64_RSI, idx);
+    x64_mov_ri(b, 8, X64_RDX, JIT_ADDR(error));
+    jit_call_abs(b, JIT_ADDR(vm_jit_fail));
+}
+
+// one template per op, every value is loaded from and stored back to its register in the window
+void jit_emit_inst(Jit *jit, uint32_t idx, BcFunc *f, uint32_t i) {
+    Buf *b = &jit->code;
+    const BcInst *inst = &f->code[i];
+
+    switch ((BcOp) inst->op) {
+        case BC_NOP:
+            break;
+        case BC_CONST:
+            if (jit_fits_i32(inst->imm)) {
+                x64_store_imm(b, 8, X64_RBX, JIT_REG(inst->a), (int32_t) inst->imm);
+            } else {
+                x64_mov_ri(b, 8, X64_RAX, inst->imm);
+                x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            }
+
+            break;
+        case BC_MOV:
+            x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->b));
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_ALLOCA:
+            x64_lea(b, X64_RAX, X64_R12, (int32_t) inst->imm);
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_ADD_32: jit_arith(b, inst, X64_ADD, 4, false); break;
+        case BC_SUB_32: jit_arith(b, inst, X64_SUB, 4, false); break;
+        case BC_AND_32: jit_arith(b, inst, X64_AND, 4, false); break;
+        case BC_OR_32: jit_arith(b, inst, X64_OR, 4, false); break;
+        case BC_XOR_32: jit_arith(b, inst, X64_XOR, 4, false); break;
+        case BC_ADD_64: jit_arith(b, inst, X64_ADD, 8, false); break;
+        case BC_SUB_64: jit_arith(b, inst, X64_SUB, 8, false); break;
+        case BC_AND_64: jit_arith(b, inst, X64_AND, 8, false); break;
+        case BC_OR_64: jit_arith(b, inst, X64_OR, 8, false); break;
+        case BC_XOR_64: jit_arith(b, inst, X64_XOR, 8, false); break;
+        case BC_ADD_32_I: jit_arith(b, inst, X64_ADD, 4, true); break;
+        case BC_SUB_32_I: jit_arith(b, inst, X64_SUB, 4, true); break;
+        case BC_AND_32_I: jit_arith(b, inst, X64_AND, 4, true); break;
+        case BC_OR_32_I: jit_arith(b, inst, X64_OR, 4, true); break;
+        case BC_XOR_32_I: jit_arith(b, inst, X64_XOR, 4, true); break;
+        case BC_ADD_64_I: jit_arith(b, inst, X64_ADD, 8, true); break;
+        case BC_SUB_64_I: jit_arith(b, inst, X64_SUB, 8, true); break;
+        case BC_AND_64_I: jit_arith(b, inst, X64_AND, 8, true); break;
+        case BC_OR_64_I: jit_arith(b, inst, X64_OR, 8, true); break;
+        case BC_XOR_64_I: jit_arith(b, inst, X64_XOR, 8, true); break;
+        case BC_MUL_32: jit_mul(b, inst, 4, false); break;
+        case BC_MUL_64: jit_mul(b, inst, 8, false); break;
+        case BC_MUL_32_I: jit_mul(b, inst, 4, true); break;
+        case BC_MUL_64_I: jit_mul(b, inst, 8, true); break;
+        case BC_SHL_32: jit_shift(b, inst, X64_EXT_SHL, 4, false); break;
+        case BC_SHR_32: jit_shift(b, inst, X64_EXT_SAR, 4, false); break;
+        case BC_SHL_64: jit_shift(b, inst, X64_EXT_SHL, 8, false); break;
+        case BC_SHR_64: jit_shift(b, inst, X64_EXT_SAR, 8, false); break;
+        case BC_SHL_32_I: jit_shift(b, inst, X64_EXT_SHL, 4, true); break;
+        case BC_SHR_32_I: jit_shift(b, inst, X64_EXT_SAR, 4, true); break;
+        case BC_SHL_64_I: jit_shift(b, inst, X64_EXT_SHL, 8, true); break;
+        case BC_SHR_64_I: jit_shift(b, inst, X64_EXT_SAR, 8, true); break;
+        case BC_DIV_32: jit_div(jit, inst, false, false); break;
+        case BC_MOD_32: jit_div(jit, inst, true, false); break;
+        case BC_DIV_64: jit_div(jit, inst, false, true); break;
+        case BC_MOD_64: jit_div(jit, inst, true, true); break;
+        case BC_NEG_32: jit_unary(b, inst, X64_EXT_NEG, 4); break;
+        case BC_NEG_64: jit_unary(b, inst, X64_EXT_NEG, 8); break;
+        case BC_NOT_32: jit_unary(b, inst, X64_EXT_NOT, 4); break;
+        case BC_NOT_64: jit_unary(b, inst, X64_EXT_NOT, 8); break;
+        case BC_EQ: jit_compare(b, inst, X64_CC_E, false); break;
+        case BC_NE: jit_compare(b, inst, X64_CC_NE, false); break;
+        case BC_LT: jit_compare(b, inst, X64_CC_L, false); break;
+        case BC_LE: jit_compare(b, inst, X64_CC_LE, false); break;
+        case BC_GT: jit_compare(b, inst, X64_CC_G, false); break;
+        case BC_GE: jit_compare(b, inst, X64_CC_GE, false); break;
+        case BC_LT_U: jit_compare(b, inst, X64_CC_B, false); break;
+        case BC_LE_U: jit_compare(b, inst, X64_CC_BE, false); break;
+        case BC_GT_U: jit_compare(b, inst, X64_CC_A, false); break;
+        case BC_GE_U: jit_compare(b, inst, X64_CC_AE, false); break;
+        case BC_EQ_I: jit_compare(b, inst, X64_CC_E, true); break;
+        case BC_NE_I: jit_compare(b, inst, X64_CC_NE, true); break;
+        case BC_LT_I: jit_compare(b, inst, X64_CC_L, true); break;
+        case BC_LE_I: jit_compare(b, inst, X64_CC_LE, true); break;
+        case BC_GT_I: jit_compare(b, inst, X64_CC_G, true); break;
+        case BC_GE_I: jit_compare(b, inst, X64_CC_GE, true); break;
+        case BC_SEXT_32:
+            x64_load(b, 4, X64_RAX, X64_RBX, JIT_REG(inst->b));
+            jit_store_result(b, 4, inst->a);
+            break;
+        case BC_ZEXT_32:
+            x64_load(b, 4, X64_RAX, X64_RBX, JIT_REG(inst->b));
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_TRUNC_8:
+            x64_load(b, 1, X64_RAX, X64_RBX, JIT_REG(inst->b));
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_TRUNC_1:
+            x64_load(b, 4, X64_RAX, X64_RBX, JIT_REG(inst->b));
+            x64_alu_ri(b, X64_AND, 4, X64_RAX, 1);
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_SELECT:
+            x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->imm));
+            x64_load(b, 8, X64_RCX, X64_RBX, JIT_REG(inst->c));
+            x64_load(b, 8, X64_RDX, X64_RBX, JIT_REG(inst->b));
+            x64_test_rr(b, 8, X64_RDX, X64_RDX);
+            x64_cmov(b, X64_CC_NE, 8, X64_RAX, X64_RCX);
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_LOAD_8: jit_load(b, inst, 1); break;
+        case BC_LOAD_32: jit_load(b, inst, 4); break;
+        case BC_LOAD_64: jit_load(b, inst, 8); break;
+        case BC_STORE_8: jit_store(b, inst, 1, false); break;
+        case BC_STORE_32: jit_store(b, inst, 4, false); break;
+        case BC_STORE_64: jit_store(b, inst, 8, false); break;
+        case BC_STORE_8_I: jit_store(b, inst, 1, true); break;
+        case BC_STORE_32_I: jit_store(b, inst, 4, true); break;
+        case BC_STORE_64_I: jit_store(b, inst, 8, true); break;
+        case BC_MEMCPY:
+            x64_load(b, 8, X64_RDI, X64_RBX, JIT_REG(inst->a));
+            x64_load(b, 8, X64_RSI, X64_RBX, JIT_REG(inst->b));
+            x64_mov_ri(b, 8, X64_RDX, inst->imm);
+            jit_call_abs(b, JIT_ADDR(memcpy));
+            break;
+        case BC_NEW:
+            x64_mov_ri(b, 8, X64_RDI, inst->imm);
+            jit_call_abs(b, JIT_ADDR(malloc));
+            x64_store(b, 8, X64_RBX, JIT_REG(inst->a), X64_RAX);
+            break;
+        case BC_DELETE:
+            x64_load(b, 8, X64_RDI, X64_RBX, JIT_REG(inst->b));
+            jit_call_abs(b, JIT_ADDR(free));
+            break;
+        // compiled code makes tail calls as ordinary calls, past VM_MAX_NATIVE_DEPTH the interpreter reuses frames
+        case BC_CALL:
+        case BC_TAIL_CALL:
+            if (inst->c == idx || jit->m->funcs[inst->c].native != NULL) {
+                jit_call_direct(jit, idx, f, inst);
+            } else {
+                jit_call(jit, idx, inst);
+            }
+
+            break;
+        case BC_CALL_EXTERN:
+            jit_call_extern(jit, idx, f, inst);
+            break;
+        case BC_JMP:
+        case BC_LOOP:
+            jit_jmp(jit, i, inst->b);
+            break;
+        case BC_BR:
+            x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->a));
+            x64_test_rr(b, 8, X64_RAX, X64_RAX);
+            jit_cond_branch(jit, X64_CC_NE, i, inst->b, inst->c);
+            break;
+        case BC_BR_EQ: jit_compare_branch(jit, inst, i, X64_CC_E, false); break;
+        case BC_BR_NE: jit_compare_branch(jit, inst, i, X64_CC_NE, false); break;
+        case BC_BR_LT: jit_compare_branch(jit, inst, i, X64_CC_L, false); break;
+        case BC_BR_LE: jit_compare_branch(jit, inst, i, X64_CC_LE, false); break;
+        case BC_BR_GT: jit_compare_branch(jit, inst, i, X64_CC_G, false); break;
+        case BC_BR_GE: jit_compare_branch(jit, inst, i, X64_CC_GE, false); break;
+        case BC_BR_LT_U: jit_compare_branch(jit, inst, i, X64_CC_B, false); break;
+        case BC_BR_LE_U: jit_compare_branch(jit, inst, i, X64_CC_BE, false); break;
+        case BC_BR_GT_U: jit_compare_branch(jit, inst, i, X64_CC_A, false); break;
+        case BC_BR_GE_U: jit_compare_branch(jit, inst, i, X64_CC_AE, false); break;
+        case BC_BR_EQ_I: jit_compare_branch(jit, inst, i, X64_CC_E, true); break;
+        case BC_BR_NE_I: jit_compare_branch(jit, inst, i, X64_CC_NE, true); break;
+        case BC_BR_LT_I: jit_compare_branch(jit, inst, i, X64_CC_L, true); break;
+        case BC_BR_LE_I: jit_compare_branch(jit, inst, i, X64_CC_LE, true); break;
+        case BC_BR_GT_I: jit_compare_branch(jit, inst, i, X64_CC_G, true); break;
+        case BC_BR_GE_I: jit_compare_branch(jit, inst, i, X64_CC_GE, true); break;
+        case BC_RET:
+            x64_load(b, 8, X64_RAX, X64_RBX, JIT_REG(inst->b));
+            jit_epilogue(b);
+            break;
+        case BC_RET_VOID:
+            x64_mov_ri(b, 4, X64_RAX, 0);
+            jit_epilogue(b);
+            break;
+        case BC_UNREACHABLE:
+            jit_fail(b, idx, "reached unreachable code");
+            jit_branch(jit, x64_jmp(b), JIT_TARGET_FAIL);
+            break;
+        default:
+            x64_ud2(b);
+            break;
+    }
+}
+
+// the prologue saves the registers the templates use and jumps to the requested start
+void jit_emit_func(Jit *jit, uint32_t idx, BcFunc *f, uint32_t *offsets) {
+    Buf *b = &jit->code;
+
+    x64_push(b, X64_RBX);
+    x64_push(b, X64_R12);
+    x64_push(b, X64_R13);
+    x64_mov_rr(b, 8, X64_R13, X64_RDI);
+    x64_mov_rr(b, 8, X64_RBX, X64_RSI);
+    x64_mov_rr(b, 8, X64_R12, X64_RDX);
+    x64_jmp_r(b, X64_RCX);
+
+    uint32_t i = 0;
+    while (i < f->num_code) {
+        offsets[i] = b->len;
+        jit_emit_inst(jit, idx, f, i);
+        i++;
+    }
+
+    uint32_t div0 = b->len;
+    jit_fail(b, idx, "division by zero");
+
+    uint32_t fail = b->len;
+    x64_mov_ri(b, 4, X64_RAX, 0);
+    jit_epilogue(b);
+
+    int64_t k = 0;
+    while (k < jit->fixups.len) {
+        JitFixup *fixup = (JitFixup *) vec_get_ptr(&jit->fixups, k);
+        uint32_t target = 0;
+
+        if (fixup->target == JIT_TARGET_FAIL) {
+            target = fail;
+        } else if (fixup->target == JIT_TARGET_DIV0) {
+            target = div0;
+        } else if (fixup->target != JIT_TARGET_START) {
+            target = offsets[fixup->target];
+        }
+
+        x64_patch_rel32(b, fixup->at, target);
+        k++;
+    }
+}
+
+bool jit_compile(Jit *jit, uint32_t idx) {
+    BcFunc *f = &jit->m->funcs[idx];
+
+    if (f->native != NULL) {
+        return true;
+    }
+
+    if (f->code == NULL) {
+        return false;
+    }
+
+    uint32_t *offsets = (uint32_t *) malloc((f->num_code + 1) * sizeof(uint32_t));
+
+    jit->code.len = 0;
+    jit->fixups.len = 0;
+    jit_emit_func(jit, idx, f, offsets);
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = (jit->code.len + page - 1) / page * page;
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ptr == MAP_FAILED) {
+        free((void *) offsets);
+        return false;
+    }
+
+    memcpy(ptr, (void *) jit->code.data, jit->code.len);
+
+    if (mprotect(ptr, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(ptr, size);
+        free((void *) offsets);
+        return false;
+    }
+
+    JitRegion region = {
+        .ptr = ptr,
+        .size = size
+    };
+
+    vec_push(&jit->regions, (void *) &region);
+
+    f->native = (const uint8_t *) ptr;
+    f->native_offsets = offsets;
+
+    jit->num_funcs++;
+    jit->num_bytes += jit->code.len;
+    timer_stat_add("jit functions", 1);
+    timer_stat_add("jit bytes", jit->code.len);
+
+    return true;
+}
@@ -14,10 +14,13 @@ static char const *const token_strings[] = {
     "new",
     "delete",
     "return",
+    "become",
     "type",
     "struct",
     "as",
     "extern",
+    "inline",
+    "noinline",
     ";",
     ",",
     ":",
@@ -150,6 +153,7 @@ Lexer lexer_create(SourceFile src, SpanInterner *si, int32_t ctx) {
         .has_peek = false,
         .ctx = ctx,
         .source_len = strlen(src.code),
+        .num_tokens = 0,
         .peek = init_peek,
         .source = src,
         .start = src.code,
@@ -189,6 +193,19 @@ Token lexer_next_token(Lexer *l) {
         return l->peek;
     }
 
+    l->num_tokens++;
+
+    if (__builtin_expect(timer_enabled, 0)) {
+        uint64_t start = timer_now_ns();
+
+        lexer_skip_ws(l);
+        Token t = lexer_get_next_token(l);
+
+        timer_lex_ns += timer_now_ns() - start;
+
+        return t;
+    }
+
     lexer_skip_ws(l);
     return lexer_get_next_token(l);
 }
@@ -235,6 +252,8 @@ TokenType lexer_ident_type(Lexer *l) {
             return lexer_check_keyword(l, 2, 0, "", TOKEN_IF);
         } else if (next == chr2int('m')) {
             return lexer_check_keyword(l, 2, 4, "port", TOKEN_IMPORT);
+        } else if (next == chr2int('n')) {
+            return lexer_check_keyword(l, 2, 4, "line", TOKEN_INLINE);
         }
     } else if (start == chr2int('d')) {
         return lexer_check_keyword(l, 1, 5, "elete", TOKEN_DELETE);
@@ -251,8 +270,15 @@ TokenType lexer_ident_type(Lexer *l) {
         }
     } else if (start == chr2int('w')) {
         return lexer_check_keyword(l, 1, 4, "hile", TOKEN_WHILE);
-    } else if (start == chr2int('n')) {
-        return lexer_check_keyword(l, 1, 2, "ew", TOKEN_NEW);
+    } else if (start == chr2int('n') && l->current - l->start > 1) {
+        int32_t next = 0;
+        read_char(l->start + len, l->source_len - bytes_until - len, &next);
+
+        if (next == chr2int('e')) {
+            return lexer_check_keyword(l, 2, 1, "w", TOKEN_NEW);
+        } else if (next == chr2int('o')) {
+            return lexer_check_keyword(l, 2, 6, "inline", TOKEN_NOINLINE);
+        }
     } else if (start == chr2int('s')) {
         return lexer_check_keyword(l, 1, 5, "truct", TOKEN_STRUCT);
     } else if (start == chr2int('t')) {
@@ -261,6 +287,8 @@ TokenType lexer_ident_type(Lexer *l) {
         return lexer_check_keyword(l, 1, 5, "eturn", TOKEN_RETURN);
     } else if (start == chr2int('a')) {
         return lexer_check_keyword(l, 1, 1, "s", TOKEN_AS);
+    } else if (start == chr2int('b')) {
+        return lexer_check_keyword(l, 1, 5, "ecome", TOKEN_BECOME);
     }
 
     return TOKEN_IDENT;
@@ -332,6 +360,8 @@ void lexer_skip_ws(Lexer *l) {
             lexer_advance(l);
             continue;
         }
+
+        break;
     }
 }
 
@@ -466,7 +496,9 @@ Token lexer_get_next_token(Lexer *l) {
     if (c == chr2int('/')) {
         if (lexer_current(l) == chr2int('/')) {
             lexer_skip_until(l, chr2int('\n'));
-            return lexer_next_token(l);
+            lexer_skip_ws(l);
+
+            return lexer_get_next_token(l);
         }
 
         return lexer_token_from_start(l, TOKEN_SLASH);
@@ -0,0 +1,1187 @@
+#include <string.h>
+
+#include "../include/loop.h"
+#include "../include/vectorize.h"
+#include "../include/timer.h"
+#include "../include/trace.h"
+
+LoopForest loop_forest_create() {
+    LoopForest lf;
+    memset((void *) &lf, 0, sizeof(LoopForest));
+
+    lf.loops = vec_create(sizeof(Loop));
+    lf.work = vec_create(sizeof(IrBlockId));
+
+    return lf;
+}
+
+void loop_forest_free(LoopForest *lf) {
+    vec_free(&lf->loops);
+    vec_free(&lf->work);
+    free((void *) lf->block_loop);
+    free((void *) lf->rpo);
+}
+
+Loop *loop_get(LoopForest *lf, uint32_t idx) {
+    return (Loop *) vec_get_ptr(&lf->loops, idx);
+}
+
+// blocks created after the forest was built belong to no loop
+bool loop_contains(LoopForest *lf, uint32_t idx, IrBlockId b) {
+    if (b >= lf->num_blocks) {
+        return false;
+    }
+
+    uint32_t l = lf->block_loop[b];
+    while (l != LOOP_NONE && l != idx) {
+        l = loop_get(lf, l)->parent;
+    }
+
+    return l == idx;
+}
+
+void loop_push_preds(LoopForest *lf, IrFunc *f, IrBlockId b) {
+    IrBlock *block = &f->blocks[b];
+    uint32_t i = 0;
+
+    while (i < block->num_preds) {
+        // unreachable blocks have no dominator and are never part of a loop
+        if (f->blocks[block->preds[i]].idom != IR_NO_BLOCK) {
+            vec_push(&lf->work, (void *) &block->preds[i]);
+        }
+
+        i++;
+    }
+}
+
+// walks backwards from the latches of h until it reaches h again. blocks already claimed by an inner loop are
+// skipped as a whole: the outermost loop around them becomes a child of this one and the walk goes on from the
+// predecessors of its header
+void loop_collect(LoopForest *lf, IrFunc *f, uint32_t idx, IrBlockId h) {
+    lf->block_loop[h] = idx;
+
+    while (lf->work.len > 0) {
+        IrBlockId b = *(IrBlockId *) vec_get_ptr(&lf->work, lf->work.len - 1);
+        lf->work.len--;
+
+        uint32_t l = lf->block_loop[b];
+        if (l == LOOP_NONE) {
+            lf->block_loop[b] = idx;
+            loop_push_preds(lf, f, b);
+            continue;
+        }
+
+        while (loop_get(lf, l)->parent != LOOP_NONE) {
+            l = loop_get(lf, l)->parent;
+        }
+
+        if (l != idx) {
+            loop_get(lf, l)->parent = idx;
+            loop_push_preds(lf, f, loop_get(lf, l)->header);
+        }
+    }
+}
+
+void loop_find_edges(LoopForest *lf, IrFunc *f, uint32_t idx) {
+    Loop *l = loop_get(lf, idx);
+    IrBlock *header = &f->blocks[l->header];
+    IrBlockId outside = IR_NO_BLOCK;
+    uint32_t num_outside = 0;
+    uint32_t num_latches = 0;
+    uint32_t i = 0;
+
+    while (i < header->num_preds) {
+        IrBlockId p = header->preds[i];
+
+        if (f->blocks[p].idom == IR_NO_BLOCK) {
+            i++;
+            continue;
+        }
+
+        if (loop_contains(lf, idx, p)) {
+            l->latch = p;
+            num_latches++;
+        } else {
+            outside = p;
+            num_outside++;
+        }
+
+        i++;
+    }
+
+    l->latch = num_latches == 1 ? l->latch : IR_NO_BLOCK;
+    l->preheader = num_outside == 1 && f->blocks[outside].num_succs == 1 ? outside : IR_NO_BLOCK;
+}
+
+void loop_forest_build(LoopForest *lf, IrFunc *f) {
+    ir_func_dominators(f);
+    free((void *) lf->rpo);
+    lf->rpo = ir_reverse_postorder(f, &lf->num_rpo);
+
+    if (f->num_blocks > lf->cap_blocks) {
+        lf->cap_blocks = f->num_blocks * 2;
+        lf->block_loop = (uint32_t *) realloc((void *) lf->block_loop, lf->cap_blocks * sizeof(uint32_t));
+    }
+
+    lf->num_blocks = f->num_blocks;
+    memset((void *) lf->block_loop, 0xff, f->num_blocks * sizeof(uint32_t));
+    lf->loops.len = 0;
+
+    // headers in reverse rpo, so an inner header is always reached before the header of a loop around it
+    uint32_t k = lf->num_rpo;
+    while (k > 0) {
+        IrBlockId h = lf->rpo[--k];
+        IrBlock *header = &f->blocks[h];
+        uint32_t i = 0;
+
+        lf->work.len = 0;
+        while (i < header->num_preds) {
+            IrBlockId p = header->preds[i];
+
+            if (f->blocks[p].idom != IR_NO_BLOCK && ir_dominates(f, h, p)) {
+                vec_push(&lf->work, (void *) &p);
+            }
+
+            i++;
+        }
+
+        if (lf->work.len == 0) {
+            continue;
+        }
+
+        Loop l;
+        memset((void *) &l, 0, sizeof(Loop));
+        l.header = h;
+        l.preheader = IR_NO_BLOCK;
+        l.latch = IR_NO_BLOCK;
+        l.parent = LOOP_NONE;
+        l.is_innermost = true;
+        l.iv = IR_NO_VALUE;
+        l.trip_count = -1;
+
+        vec_push(&lf->loops, (void *) &l);
+        loop_collect(lf, f, lf->loops.len - 1, h);
+    }
+
+    // parents come after their children
+    uint32_t i = lf->loops.len;
+    while (i > 0) {
+        Loop *l = loop_get(lf, --i);
+
+        l->depth = l->parent == LOOP_NONE ? 1 : loop_get(lf, l->parent)->depth + 1;
+        if (l->parent != LOOP_NONE) {
+            loop_get(lf, l->parent)->is_innermost = false;
+        }
+    }
+
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        uint32_t l = lf->block_loop[b];
+
+        while (l != LOOP_NONE) {
+            loop_get(lf, l)->num_blocks++;
+            l = loop_get(lf, l)->parent;
+        }
+
+        b++;
+    }
+
+    i = 0;
+    while (i < lf->loops.len) {
+        loop_find_edges(lf, f, i);
+        i++;
+    }
+
+    loop_find_ivs(lf, f);
+}
+
+bool loop_is_invariant(LoopForest *lf, IrFunc *f, uint32_t idx, IrValue v) {
+    IrInst *inst = &f->insts[v];
+    return inst->op == IR_CONST || !loop_contains(lf, idx, inst->block);
+}
+
+// `while i < n { ...; i = i + c }` with n invariant and c a positive constant
+void loop_find_iv(LoopForest *lf, IrFunc *f, uint32_t idx) {
+    Loop *l = loop_get(lf, idx);
+    l->iv = IR_NO_VALUE;
+    l->trip_count = -1;
+
+    // phis are indexed by predecessor, so preheader and latch have to be the only ones
+    if (l->preheader == IR_NO_BLOCK || l->latch == IR_NO_BLOCK || f->blocks[l->header].num_preds != 2) {
+        return;
+    }
+
+    IrValue term = ir_block_terminator(f, l->header);
+    if (term == IR_NO_VALUE || f->insts[term].op != IR_CBR) {
+        return;
+    }
+
+    IrValue *tops = ir_inst_ops(f, &f->insts[term]);
+    IrInst *cond = &f->insts[tops[0]];
+
+    if (!loop_contains(lf, idx, tops[1]) || loop_contains(lf, idx, tops[2])) {
+        return;
+    }
+
+    if (cond->op != IR_LT && cond->op != IR_LE && cond->op != IR_GT && cond->op != IR_GE) {
+        return;
+    }
+
+    IrValue iv = cond->u.ops[0];
+    IrValue bound = cond->u.ops[1];
+    uint8_t cmp = cond->op;
+
+    if (cmp == IR_GT || cmp == IR_GE) {
+        iv = cond->u.ops[1];
+        bound = cond->u.ops[0];
+        cmp = cmp == IR_GT ? IR_LT : IR_LE;
+    }
+
+    IrInst *phi = &f->insts[iv];
+    if (phi->op != IR_PHI || phi->block != l->header || phi->ty != IR_TYPE_I32 || !loop_is_invariant(lf, f, idx, bound)) {
+        return;
+    }
+
+    IrValue *pops = ir_inst_ops(f, phi);
+    IrValue init = pops[ir_pred_index(f, l->header, l->preheader)];
+    IrInst *next = &f->insts[pops[ir_pred_index(f, l->header, l->latch)]];
+
+    if (next->op != IR_ADD) {
+        return;
+    }
+
+    IrValue c = next->u.ops[0] == iv ? next->u.ops[1] : next->u.ops[1] == iv ? next->u.ops[0] : IR_NO_VALUE;
+    if (c == IR_NO_VALUE || f->insts[c].op != IR_CONST || f->insts[c].imm <= 0) {
+        return;
+    }
+
+    l->iv = iv;
+    l->init = init;
+    l->bound = bound;
+    l->step = f->insts[c].imm;
+    l->cmp = cmp;
+
+    if (f->insts[init].op == IR_CONST && f->insts[bound].op == IR_CONST) {
+        int64_t lo = (int32_t) f->insts[init].imm;
+        int64_t last = (int32_t) f->insts[bound].imm - (cmp == IR_LT ? 1 : 0);
+
+        // past INT32_MAX the counter wraps around and the loop does not stop where the formula says
+        if (last + l->step <= INT32_MAX) {
+            l->trip_count = last < lo ? 0 : (last - lo) / l->step + 1;
+        }
+    }
+}
+
+void loop_find_ivs(LoopForest *lf, IrFunc *f) {
+    uint32_t i = 0;
+
+    while (i < lf->loops.len) {
+        loop_find_iv(lf, f, i);
+        i++;
+    }
+}
+
+LoopOpt loop_opt_create(int32_t opt_level) {
+    LoopOpt lo;
+    memset((void *) &lo, 0, sizeof(LoopOpt));
+
+    lo.opt_level = opt_level;
+    lo.forest = loop_forest_create();
+    lo.blocks = vec_create(sizeof(IrBlockId));
+    lo.muls = vec_create(sizeof(IrValue));
+    lo.phis = vec_create(sizeof(IrValue));
+
+    return lo;
+}
+
+void loop_opt_free(LoopOpt *lo) {
+    loop_forest_free(&lo->forest);
+    free((void *) lo->escaped);
+    free((void *) lo->written);
+    free((void *) lo->value_map);
+    free((void *) lo->block_map);
+    vec_free(&lo->blocks);
+    vec_free(&lo->muls);
+    vec_free(&lo->phis);
+}
+
+void loop_reserve_values(LoopOpt *lo, uint32_t num_values) {
+    if (num_values > lo->cap_values) {
+        lo->cap_values = num_values * 2;
+        lo->value_map = (IrValue *) realloc((void *) lo->value_map, lo->cap_values * sizeof(IrValue));
+    }
+}
+
+void loop_reserve_blocks(LoopOpt *lo, uint32_t num_blocks) {
+    if (num_blocks > lo->cap_blocks) {
+        lo->cap_blocks = num_blocks * 2;
+        lo->block_map = (IrBlockId *) realloc((void *) lo->block_map, lo->cap_blocks * sizeof(IrBlockId));
+    }
+}
+
+// the blocks of a loop in reverse postorder, the header first
+void loop_collect_blocks(LoopOpt *lo, uint32_t idx) {
+    LoopForest *lf = &lo->forest;
+    uint32_t k = 0;
+
+    lo->blocks.len = 0;
+    while (k < lf->num_rpo) {
+        IrBlockId b = lf->rpo[k];
+
+        if (loop_contains(lf, idx, b)) {
+            vec_push(&lo->blocks, (void *) &b);
+        }
+
+        k++;
+    }
+}
+
+IrBlockId loop_block_at(LoopOpt *lo, uint32_t i) {
+    return *(IrBlockId *) vec_get_ptr(&lo->blocks, i);
+}
+
+// emits `a op c` before the terminator of b, folding it when both are constants
+IrValue loop_emit(LoopOpt *lo, IrBlockId b, IrOp op, IrTypeId ty, IrValue a, IrValue c) {
+    IrFunc *f = lo->f;
+
+    if (f->insts[a].op == IR_CONST && f->insts[c].op == IR_CONST) {
+        uint64_t x = (uint64_t) f->insts[a].imm;
+        uint64_t y = (uint64_t) f->insts[c].imm;
+        int64_t r = (int64_t) (op == IR_MUL ? x * y : x + y);
+
+        IrValue v = ir_inst_create(f, IR_CONST, ty, 0);
+        f->insts[v].imm = ty == IR_TYPE_I32 ? (int32_t) r : r;
+        ir_block_insert(f, b, f->blocks[b].num_insts - 1, v);
+
+        return v;
+    }
+
+    IrValue v = ir_inst_create(f, op, ty, 2);
+    f->insts[v].u.ops[0] = a;
+    f->insts[v].u.ops[1] = c;
+    ir_block_insert(f, b, f->blocks[b].num_insts - 1, v);
+
+    return v;
+}
+
+IrValue loop_emit_const(LoopOpt *lo, IrBlockId b, IrTypeId ty, int64_t imm) {
+    IrValue v = ir_inst_create(lo->f, IR_CONST, ty, 0);
+
+    lo->f->insts[v].imm = imm;
+    ir_block_insert(lo->f, b, lo->f->blocks[b].num_insts - 1, v);
+
+    return v;
+}
+
+bool loop_can_hoist(LoopOpt *lo, uint32_t idx, IrValue v) {
+    IrFunc *f = lo->f;
+    IrInst *inst = &f->insts[v];
+
+    switch (inst->op) {
+        case IR_CONST:
+        case IR_STR:
+        case IR_GLOBAL:
+        case IR_FUNC_ADDR:
+            return true;
+
+        case IR_DIV:
+        case IR_MOD: {
+            // division traps on zero and on INT_MIN / -1, so it only moves when it can do neither
+            IrInst *d = &f->insts[inst->u.ops[1]];
+            if (d->op != IR_CONST || d->imm == 0 || d->imm == -1) {
+                return false;
+            }
+
+            break;
+        }
+
+        case IR_LOAD: {
+            // a stack slot that is only ever read in the loop holds the same value all the way through
+            IrValue base = ir_ptr_base(f, inst->u.ops[0]);
+            if (f->insts[base].op != IR_ALLOCA || lo->escaped[base] || lo->written[base] == lo->stamp) {
+                return false;
+            }
+
+            break;
+        }
+
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_AND: case IR_OR: case IR_XOR: case IR_SHL: case IR_SHR:
+        case IR_NEG: case IR_NOT:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_LE: case IR_GT: case IR_GE:
+        case IR_SEXT: case IR_ZEXT: case IR_TRUNC: case IR_PTR_TO_INT: case IR_INT_TO_PTR:
+        case IR_SELECT: case IR_COPY: case IR_OFFSET:
+            break;
+
+        default:
+            return false;
+    }
+
+    uint32_t i = 0;
+    while (i < inst->num_ops) {
+        if (!loop_is_invariant(&lo->forest, f, idx, inst->u.ops[i])) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+// moves every instruction whose operands come from outside the loop into the preheader. blocks are visited in
+// reverse postorder, so an instruction that only depends on ones already moved goes along with them
+void loop_hoist(LoopOpt *lo, uint32_t idx) {
+    IrFunc *f = lo->f;
+    IrBlockId pre = loop_get(&lo->forest, idx)->preheader;
+
+    if (pre == IR_NO_BLOCK) {
+        return;
+    }
+
+    lo->stamp++;
+    loop_collect_blocks(lo, idx);
+
+    uint32_t k = 0;
+    while (k < lo->blocks.len) {
+        IrBlock *block = &f->blocks[loop_block_at(lo, k)];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+
+            if (inst->op == IR_STORE || inst->op == IR_MEMCPY) {
+                lo->written[ir_ptr_base(f, inst->u.ops[0])] = lo->stamp;
+            }
+
+            i++;
+        }
+
+        k++;
+    }
+
+    k = 0;
+    while (k < lo->blocks.len) {
+        IrBlock *block = &f->blocks[loop_block_at(lo, k)];
+        uint32_t j = 0;
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+
+            if (loop_can_hoist(lo, idx, v)) {
+                ir_block_insert(f, pre, f->blocks[pre].num_insts - 1, v);
+                lo->num_hoisted++;
+            } else {
+                block->insts[j++] = v;
+            }
+
+            i++;
+        }
+
+        block->num_insts = j;
+        k++;
+    }
+}
+
+// the phi that replaces a reduced multiplication, value_map is cleared up to num_mapped as the function grows
+void loop_map_reduced(LoopOpt *lo, IrValue mul, IrValue acc) {
+    uint32_t n = lo->f->num_insts;
+
+    if (n > lo->num_mapped) {
+        loop_reserve_values(lo, n);
+        memset((void *) (lo->value_map + lo->num_mapped), 0, (n - lo->num_mapped) * sizeof(IrValue));
+        lo->num_mapped = n;
+    }
+
+    lo->value_map[mul] = acc;
+}
+
+// for a basic induction variable i growing by c, every `i * k` with k invariant becomes a new phi that starts
+// at init * k and grows by c * k in the latch, so the multiplication turns into an addition. its uses are
+// rewritten by loop_opt_func once every loop is reduced
+void loop_reduce(LoopOpt *lo, uint32_t idx) {
+    IrFunc *f = lo->f;
+    Loop *l = loop_get(&lo->forest, idx);
+    IrBlockId h = l->header;
+    IrBlockId pre = l->preheader;
+    IrBlockId latch = l->latch;
+
+    if (pre == IR_NO_BLOCK || latch == IR_NO_BLOCK || f->blocks[h].num_preds != 2) {
+        return;
+    }
+
+    uint32_t pi = ir_pred_index(f, h, pre);
+    uint32_t li = ir_pred_index(f, h, latch);
+
+    lo->phis.len = 0;
+    uint32_t i = 0;
+
+    while (i < f->blocks[h].num_insts && f->insts[f->blocks[h].insts[i]].op == IR_PHI) {
+        vec_push(&lo->phis, (void *) &f->blocks[h].insts[i]);
+        i++;
+    }
+
+    loop_collect_blocks(lo, idx);
+
+
+    uint32_t p = 0;
+    while (p < lo->phis.len) {
+        IrValue phi = *(IrValue *) vec_get_ptr(&lo->phis, p++);
+        IrTypeId ty = f->insts[phi].ty;
+
+        if (ty != IR_TYPE_I32 && ty != IR_TYPE_I64) {
+            continue;
+        }
+
+        IrInst *next = &f->insts[ir_inst_ops(f, &f->insts[phi])[li]];
+        IrValue c = IR_NO_VALUE;
+
+        if (next->op == IR_ADD) {
+            c = next->u.ops[0] == phi ? next->u.ops[1] : next->u.ops[1] == phi ? next->u.ops[0] : IR_NO_VALUE;
+        } else if (next->op == IR_SUB && next->u.ops[0] == phi) {
+            c = next->u.ops[1];
+        }
+
+        if (c == IR_NO_VALUE || f->insts[c].op != IR_CONST) {
+            continue;
+        }
+
+        int64_t step = next->op == IR_SUB ? -f->insts[c].imm : f->insts[c].imm;
+
+        lo->muls.len = 0;
+        uint32_t k = 0;
+
+        while (k < lo->blocks.len) {
+            IrBlock *block = &f->blocks[loop_block_at(lo, k)];
+            i = 0;
+
+            while (i < block->num_insts) {
+                IrValue v = block->insts[i];
+                IrInst *inst = &f->insts[v];
+
+                if (inst->op == IR_MUL && inst->ty == ty) {
+                    IrValue other = inst->u.ops[0] == phi ? inst->u.ops[1] : inst->u.ops[1] == phi ? inst->u.ops[0] : IR_NO_VALUE;
+
+                    if (other != IR_NO_VALUE && other != phi && loop_is_invariant(&lo->forest, f, idx, other)) {
+                        vec_push(&lo->muls, (void *) &v);
+                    }
+                }
+
+                i++;
+            }
+
+            k++;
+        }
+
+        k = 0;
+        while (k < lo->muls.len) {
+            IrValue mul = *(IrValue *) vec_get_ptr(&lo->muls, k++);
+            IrValue factor = f->insts[mul].u.ops[0] == phi ? f->insts[mul].u.ops[1] : f->insts[mul].u.ops[0];
+            IrValue init = ir_inst_ops(f, &f->insts[phi])[pi];
+
+            IrValue start = loop_emit(lo, pre, IR_MUL, ty, init, factor);
+            IrValue inc = step == 1 ? factor : loop_emit(lo, pre, IR_MUL, ty, factor, loop_emit_const(lo, pre, ty, step));
+            IrValue acc = ir_build_phi_in(f, h, ty, 2);
+            IrValue acc_next = loop_emit(lo, latch, IR_ADD, ty, acc, inc);
+            IrValue *ops = ir_inst_ops(f, &f->insts[acc]);
+
+            ops[pi] = start;
+            ops[li] = acc_next;
+
+            loop_map_reduced(lo, mul, acc);
+            ir_inst_remove(f, mul);
+            lo->num_reduced++;
+        }
+    }
+
+    i = 0;
+    while (i < lo->blocks.len) {
+        ir_block_compact(f, loop_block_at(lo, i));
+        i++;
+    }
+}
+
+// innermost counting loops by one whose only exit is the header test, small enough to copy a few times
+bool loop_can_unroll(LoopOpt *lo, uint32_t idx) {
+    IrFunc *f = lo->f;
+    Loop *l = loop_get(&lo->forest, idx);
+
+    if (!l->is_innermost || l->iv == IR_NO_VALUE || l->step != 1 || l->latch == l->header) {
+        return false;
+    }
+
+    if (l->trip_count >= 0 && l->trip_count < 2 * LOOP_UNROLL_FACTOR) {
+        return false;
+    }
+
+    loop_collect_blocks(lo, idx);
+
+    uint32_t size = 0;
+    uint32_t k = 0;
+
+    while (k < lo->blocks.len) {
+        IrBlockId b = loop_block_at(lo, k);
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            // stack slots are per function, copies of one would need a slot each
+            if (f->insts[block->insts[i]].op == IR_ALLOCA) {
+                return false;
+            }
+
+            i++;
+        }
+
+        i = 0;
+        while (b != l->header && i < block->num_succs) {
+            if (!loop_contains(&lo->forest, idx, block->succs[i])) {
+                return false;
+            }
+
+            i++;
+        }
+
+        size += block->num_insts;
+        k++;
+    }
+
+    return size * LOOP_UNROLL_FACTOR <= LOOP_UNROLL_MAX_SIZE;
+}
+
+// the header's test is left out of the copies when nothing but its branch reads it
+bool loop_is_branch_only(IrFunc *f, IrValue cond, IrValue term) {
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t num_values = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (block->insts[i] != term && j < num_values) {
+                if (ops[j] == cond) {
+                    return false;
+                }
+
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    return true;
+}
+
+IrValue loop_map_value(LoopOpt *lo, uint32_t idx, IrValue v) {
+    IrInst *inst = &lo->f->insts[v];
+    return inst->op != IR_CONST && loop_contains(&lo->forest, idx, inst->block) ? lo->value_map[v] : v;
+}
+
+// joins b with its successor as long as that has no other predecessor, so the copies of a body without control
+// flow become one block. the block joined away is left with an unreachable, like a dead one
+void loop_merge_chain(IrFunc *f, IrBlockId b) {
+    while (true) {
+        IrBlock *block = &f->blocks[b];
+        IrValue br = block->insts[block->num_insts - 1];
+
+        if (f->insts[br].op != IR_BR) {
+            return;
+        }
+
+        IrBlockId s = f->insts[br].u.ops[0];
+        IrBlock *succ = &f->blocks[s];
+
+        if (s == b || succ->num_preds != 1 || f->insts[succ->insts[0]].op == IR_PHI) {
+            return;
+        }
+
+        block->num_insts--;
+
+        uint32_t i = 0;
+        while (i < succ->num_insts) {
+            ir_block_append(f, b, succ->insts[i]);
+            i++;
+        }
+
+        block->succs = succ->succs;
+        block->num_succs = succ->num_succs;
+        block->cap_succs = succ->cap_succs;
+
+        i = 0;
+        while (i < block->num_succs) {
+            IrBlock *next = &f->blocks[block->succs[i]];
+            uint32_t j = 0;
+
+            while (j < next->num_preds) {
+                next->preds[j] = next->preds[j] == s ? b : next->preds[j];
+                j++;
+            }
+
+            i++;
+        }
+
+        ir_inst_set_num_ops(f, &f->insts[br], 0);
+        f->insts[br].op = IR_UNREACHABLE;
+        f->insts[br].block = s;
+        succ->insts[0] = br;
+        succ->num_insts = 1;
+        succ->succs = NULL;
+        succ->num_succs = 0;
+        succ->cap_succs = 0;
+        succ->num_preds = 0;
+    }
+}
+
+// the loop runs on for the iterations left over, behind a new header that runs four at a time:
+//
+//     guard:  i' = phi [pre: init, last copy: i' + 4]
+//             cbr i' + 3 < n, copy 1, header
+//     copy k: the header without its phis and test, then the body, with the latch jumping to copy k + 1
+//
+// the test is done in i64, so it cannot wrap where the i32 counter would not
+void loop_unroll(LoopOpt *lo, uint32_t idx) {
+    IrFunc *f = lo->f;
+    Loop l = *loop_get(&lo->forest, idx);
+    IrBlockId h = l.header;
+    IrValue term = ir_block_terminator(f, h);
+    IrValue cond = ir_inst_ops(f, &f->insts[term])[0];
+    IrBlockId body = ir_inst_ops(f, &f->insts[term])[1];
+    IrValue skip = f->insts[cond].block == h && loop_is_branch_only(f, cond, term) ? cond : IR_NO_VALUE;
+    uint32_t pi = ir_pred_index(f, h, l.preheader);
+    uint32_t li = ir_pred_index(f, h, l.latch);
+    int64_t freq = f->blocks[h].freq;
+
+    loop_reserve_values(lo, f->num_insts);
+    loop_reserve_blocks(lo, f->num_blocks);
+
+    lo->phis.len = 0;
+    uint32_t i = 0;
+
+    while (f->insts[f->blocks[h].insts[i]].op == IR_PHI) {
+        vec_push(&lo->phis, (void *) &f->blocks[h].insts[i]);
+        i++;
+    }
+
+    uint32_t num_phis = lo->phis.len;
+    IrValue *carry = (IrValue *) malloc((num_phis + 1) * sizeof(IrValue));
+    IrValue *guard_phis = (IrValue *) malloc((num_phis + 1) * sizeof(IrValue));
+    IrBlockId guard = ir_block_create(f);
+    IrBlockId heads[LOOP_UNROLL_FACTOR];
+    uint32_t iv_idx = 0;
+
+    i = 0;
+    while (i < LOOP_UNROLL_FACTOR) {
+        heads[i] = ir_block_create(f);
+        i++;
+    }
+
+    i = 0;
+    while (i < num_phis) {
+        IrValue phi = *(IrValue *) vec_get_ptr(&lo->phis, i);
+        IrValue gp = ir_inst_create(f, IR_PHI, f->insts[phi].ty, 2);
+
+        ir_inst_ops(f, &f->insts[gp])[0] = ir_inst_ops(f, &f->insts[phi])[pi];
+        ir_block_append(f, guard, gp);
+        guard_phis[i] = gp;
+        carry[i] = gp;
+        iv_idx = phi == l.iv ? i : iv_idx;
+        i++;
+    }
+
+    IrValue sx = ir_inst_create(f, IR_SEXT, IR_TYPE_I64, 1);
+    f->insts[sx].u.ops[0] = guard_phis[iv_idx];
+    ir_block_append(f, guard, sx);
+
+    // the bound does not change, so it is widened once in the preheader
+    IrValue ahead = loop_emit_const(lo, l.preheader, IR_TYPE_I64, LOOP_UNROLL_FACTOR - 1);
+    IrValue bound = ir_inst_create(f, IR_SEXT, IR_TYPE_I64, 1);
+    f->insts[bound].u.ops[0] = l.bound;
+    ir_block_insert(f, l.preheader, f->blocks[l.preheader].num_insts - 1, bound);
+
+    IrValue last = ir_inst_create(f, IR_ADD, IR_TYPE_I64, 2);
+    f->insts[last].u.ops[0] = sx;
+    f->insts[last].u.ops[1] = ahead;
+    ir_block_append(f, guard, last);
+
+    IrValue test = ir_inst_create(f, l.cmp, IR_TYPE_I1, 2);
+    f->insts[test].u.ops[0] = last;
+    f->insts[test].u.ops[1] = bound;
+    ir_block_append(f, guard, test);
+
+    IrValue cbr = ir_inst_create(f, IR_CBR, IR_TYPE_VOID, 3);
+    f->insts[cbr].u.ops[0] = test;
+    f->insts[cbr].u.ops[1] = heads[0];
+    f->insts[cbr].u.ops[2] = h;
+    ir_block_append(f, guard, cbr);
+
+    IrBlockId prev_latch = guard;
+    uint32_t copy = 0;
+
+    while (copy < LOOP_UNROLL_FACTOR) {
+        IrBlockId head = heads[copy];
+        IrBlockId next_head = copy + 1 < LOOP_UNROLL_FACTOR ? heads[copy + 1] : guard;
+
+        i = 0;
+        while (i < num_phis) {
+            lo->value_map[*(IrValue *) vec_get_ptr(&lo->phis, i)] = carry[i];
+            i++;
+        }
+
+        uint32_t k = 1;
+        while (k < lo->blocks.len) {
+            lo->block_map[loop_block_at(lo, k)] = ir_block_create(f);
+            k++;
+        }
+
+        lo->block_map[h] = head;
+
+        // instructions first, operands once every value of this copy exists
+        k = 0;
+        while (k < lo->blocks.len) {
+            IrBlockId b = loop_block_at(lo, k);
+            i = 0;
+
+            while (i < f->blocks[b].num_insts) {
+                IrValue v = f->blocks[b].insts[i];
+                IrInst *inst = &f->insts[v];
+
+                if (b == h && (inst->op == IR_PHI || v == term || v == skip)) {
+                    i++;
+                    continue;
+                }
+
+                uint8_t op = inst->op;
+                IrValue nv = ir_inst_create(f, op, inst->ty, inst->num_ops);
+
+                f->insts[nv].flags |= f->insts[v].flags & ~(IR_FLAG_EXTRA_OPS | IR_FLAG_TAIL);
+                f->insts[nv].imm = f->insts[v].imm;
+                ir_block_append(f, lo->block_map[b], nv);
+                lo->value_map[v] = nv;
+                i++;
+            }
+
+            k++;
+        }
+
+        k = 0;
+        while (k < lo->blocks.len) {
+            IrBlockId b = loop_block_at(lo, k);
+            i = 0;
+
+            while (i < f->blocks[b].num_insts) {
+                IrValue v = f->blocks[b].insts[i];
+                IrInst *inst = &f->insts[v];
+
+                if (b == h && (inst->op == IR_PHI || v == term || v == skip)) {
+                    i++;
+                    continue;
+                }
+
+                IrValue *ops = ir_inst_ops(f, inst);
+                IrValue *new_ops = ir_inst_ops(f, &f->insts[lo->value_map[v]]);
+                uint32_t num_values = ir_inst_num_values(inst);
+                uint32_t j = 0;
+
+                while (j < inst->num_ops) {
+                    if (j < num_values) {
+                        new_ops[j] = loop_map_value(lo, idx, ops[j]);
+                    } else {
+                        new_ops[j] = ops[j] == h ? next_head : lo->block_map[ops[j]];
+                    }
+
+                    j++;
+                }
+
+                i++;
+            }
+
+            k++;
+        }
+
+        IrValue br = ir_inst_create(f, IR_BR, IR_TYPE_VOID, 1);
+        f->insts[br].u.ops[0] = lo->block_map[body];
+        ir_block_append(f, head, br);
+
+        // edges keep their order, so the phis of the body keep their operand order
+        k = 1;
+        while (k < lo->blocks.len) {
+            IrBlockId b = loop_block_at(lo, k);
+            IrBlock *src = &f->blocks[b];
+            IrBlock *dst = &f->blocks[lo->block_map[b]];
+
+            dst->preds = (IrBlockId *) ir_arena_alloc(&f->arena, src->num_preds * sizeof(IrBlockId));
+            dst->num_preds = dst->cap_preds = src->num_preds;
+            dst->succs = (IrBlockId *) ir_arena_alloc(&f->arena, src->num_succs * sizeof(IrBlockId));
+            dst->num_succs = dst->cap_succs = src->num_succs;
+            dst->freq = src->freq;
+
+            i = 0;
+            while (i < src->num_preds) {
+                dst->preds[i] = lo->block_map[src->preds[i]];
+                i++;
+            }
+
+            i = 0;
+            while (i < src->num_succs) {
+                dst->succs[i] = src->succs[i] == h ? next_head : lo->block_map[src->succs[i]];
+                i++;
+            }
+
+            k++;
+        }
+
+        IrBlock *hb = &f->blocks[head];
+        hb->preds = (IrBlockId *) ir_arena_alloc(&f->arena, sizeof(IrBlockId));
+        hb->preds[0] = prev_latch;
+        hb->num_preds = hb->cap_preds = 1;
+        hb->succs = (IrBlockId *) ir_arena_alloc(&f->arena, sizeof(IrBlockId));
+        hb->succs[0] = lo->block_map[body];
+        hb->num_succs = hb->cap_succs = 1;
+        hb->freq = freq;
+
+        i = 0;
+        while (i < num_phis) {
+            IrValue phi = *(IrValue *) vec_get_ptr(&lo->phis, i);
+            carry[i] = loop_map_value(lo, idx, ir_inst_ops(f, &f->insts[phi])[li]);
+            i++;
+        }
+
+        prev_latch = lo->block_map[l.latch];
+        copy++;
+    }
+
+    // the guard takes the place of the header for the preheader, and the header now starts where the guard
+    // gave up, its preheader operands become the guard's phis
+    IrBlock *pre = &f->blocks[l.preheader];
+    pre->succs[0] = guard;
+    ir_inst_ops(f, &f->insts[ir_block_terminator(f, l.preheader)])[0] = guard;
+
+    IrBlock *g = &f->blocks[guard];
+    g->preds = (IrBlockId *) ir_arena_alloc(&f->arena, 2 * sizeof(IrBlockId));
+    g->preds[0] = l.preheader;
+    g->preds[1] = prev_latch;
+    g->num_preds = g->cap_preds = 2;
+    g->succs = (IrBlockId *) ir_arena_alloc(&f->arena, 2 * sizeof(IrBlockId));
+    g->succs[0] = heads[0];
+    g->succs[1] = h;
+    g->num_succs = g->cap_succs = 2;
+    g->freq = freq;
+
+    f->blocks[h].preds[pi] = guard;
+
+    i = 0;
+    while (i < num_phis) {
+        IrValue phi = *(IrValue *) vec_get_ptr(&lo->phis, i);
+
+        ir_inst_ops(f, &f->insts[guard_phis[i]])[1] = carry[i];
+        ir_inst_ops(f, &f->insts[phi])[pi] = guard_phis[i];
+        i++;
+    }
+
+    // the copies are the blocks created after the guard
+    IrBlockId b = guard + 1;
+    while (b < f->num_blocks) {
+        loop_merge_chain(f, b);
+        b++;
+    }
+
+    free((void *) carry);
+    free((void *) guard_phis);
+    lo->num_unrolled++;
+}
+
+// splits the edge into a header from its only outside predecessor when that predecessor branches elsewhere too,
+// so every loop entered from one place gets a preheader to hoist into
+bool loop_make_preheaders(LoopOpt *lo) {
+    IrFunc *f = lo->f;
+    LoopForest *lf = &lo->forest;
+    bool changed = false;
+    uint32_t idx = 0;
+
+    while (idx < lf->loops.len) {
+        Loop *l = loop_get(lf, idx);
+        IrBlock *header = &f->blocks[l->header];
+        IrBlockId outside = IR_NO_BLOCK;
+        uint32_t num_outside = 0;
+        uint32_t i = 0;
+
+        while (i < header->num_preds) {
+            IrBlockId p = header->preds[i];
+
+            if (f->blocks[p].idom != IR_NO_BLOCK && !loop_contains(lf, idx, p)) {
+                outside = p;
+                num_outside++;
+            }
+
+            i++;
+        }
+
+        if (num_outside == 1 && f->blocks[outside].num_succs > 1) {
+            i = 0;
+            while (f->blocks[outside].succs[i] != l->header) {
+                i++;
+            }
+
+            IrBlockId mid = ir_split_edge(f, outside, i);
+            f->blocks[mid].freq = f->blocks[outside].freq;
+            lo->num_preheaders++;
+            changed = true;
+        }
+
+        idx++;
+    }
+
+    return changed;
+}
+
+void loop_opt_func(LoopOpt *lo, IrFunc *f) {
+    if (f->num_blocks == 0) {
+        return;
+    }
+
+    lo->f = f;
+    loop_forest_build(&lo->forest, f);
+
+    if (lo->forest.loops.len == 0) {
+        return;
+    }
+
+    if (loop_make_preheaders(lo)) {
+        ir_func_invalidate(f, IR_ANALYSIS_ALL);
+        loop_forest_build(&lo->forest, f);
+    }
+
+    if (f->num_insts > lo->cap_slots) {
+        lo->cap_slots = f->num_insts * 2;
+        lo->escaped = (bool *) realloc((void *) lo->escaped, lo->cap_slots * sizeof(bool));
+        lo->written = (uint32_t *) realloc((void *) lo->written, lo->cap_slots * sizeof(uint32_t));
+        lo->stamp = 0;
+    }
+
+    if (lo->stamp == 0) {
+        memset((void *) lo->written, 0, lo->cap_slots * sizeof(uint32_t));
+    }
+
+    memset((void *) lo->escaped, 0, f->num_insts * sizeof(bool));
+    ir_find_escaping_slots(f, lo->escaped);
+
+    LoopForest *lf = &lo->forest;
+    uint32_t idx = 0;
+
+    // inner loops come first, so an invariant can move out through several levels
+    while (idx < lf->loops.len) {
+        loop_hoist(lo, idx);
+        idx++;
+    }
+
+    // bounds and start values may only just have become invariant
+    loop_find_ivs(lf, f);
+
+    // the vector loops are new blocks in front of the loops they come from, which belong to no loop yet
+    if (lo->vectorizer != NULL && lo->opt_level >= 2 && vectorize_func(lo->vectorizer, lf, f)) {
+        ir_func_invalidate(f, IR_ANALYSIS_ALL);
+        loop_forest_build(lf, f);
+    }
+
+    // the uses of every reduced multiplication are rewritten in one pass over the function
+    lo->num_mapped = 0;
+    idx = 0;
+
+    while (idx < lf->loops.len) {
+        loop_reduce(lo, idx);
+        idx++;
+    }
+
+    if (lo->num_mapped > 0) {
+        ir_replace_uses(f, lo->value_map, lo->num_mapped);
+    }
+
+    idx = 0;
+    while (idx < lf->loops.len) {
+        Loop *l = loop_get(lf, idx);
+
+        lo->num_loops++;
+        lo->num_trip_counts += l->trip_count >= 0;
+
+        TRACE_DEBUG(TRACE_CAT_LOOP, "%s: loop at b%u, depth %u, %u blocks, %s, trip count %lld", f->name, l->header,
+                    l->depth, l->num_blocks, l->iv != IR_NO_VALUE ? "counted" : "uncounted", (long long) l->trip_count);
+
+        if (lo->opt_level >= 2 && loop_can_unroll(lo, idx)) {
+            TRACE_DEBUG(TRACE_CAT_LOOP, "%s: unrolled loop at b%u by %d", f->name, l->header, LOOP_UNROLL_FACTOR);
+            loop_unroll(lo, idx);
+            ir_func_invalidate(f, IR_ANALYSIS_ALL);
+        }
+
+        idx++;
+    }
+}
+
+void *loop_pass_create(IrModule *m, void *params) {
+    LoopParams *lp = (LoopParams *) params;
+    LoopOpt *lo = (LoopOpt *) malloc(sizeof(LoopOpt));
+    *lo = loop_opt_create(lp->opt_level);
+
+    if (lp->vectorize) {
+        lo->vectorizer = (Vectorizer *) malloc(sizeof(Vectorizer));
+        *lo->vectorizer = vectorize_create(m);
+    }
+
+    return (void *) lo;
+}
+
+int64_t loop_pass_changes(LoopOpt *lo) {
+    int64_t n = lo->num_preheaders + lo->num_hoisted + lo->num_reduced + lo->num_unrolled;
+
+    return n + (lo->vectorizer != NULL ? lo->vectorizer->num_vectorised : 0);
+}
+
+bool loop_pass_func(void *state, IrFunc *f) {
+    LoopOpt *lo = (LoopOpt *) state;
+    int64_t before = loop_pass_changes(lo);
+
+    loop_opt_func(lo, f);
+
+    return loop_pass_changes(lo) != before;
+}
+
+void loop_pass_finish(void *state) {
+    LoopOpt *lo = (LoopOpt *) state;
+
+    timer_stat_add("loops", lo->num_loops);
+    timer_stat_add("loops with a trip count", lo->num_trip_counts);
+    timer_stat_add("loop hoisted instructions", lo->num_hoisted);
+    timer_stat_add("loop reduced multiplications", lo->num_reduced);
+    timer_stat_add("loops unrolled", lo->num_unrolled);
+    timer_stat_add("loops vectorised", lo->vectorizer != NULL ? lo->vectorizer->num_vectorised : 0);
+
+    if (lo->vectorizer != NULL) {
+        vectorize_free(lo->vectorizer);
+        free((void *) lo->vectorizer);
+    }
+
+    loop_opt_free(lo);
+    free((void *) lo);
+}
+
+// preheaders, unrolled copies and vector loops are new blocks
+Pass loop_pass(LoopParams *params) {
+    Pass p = {
+        .name = "loop",
+        .kind = PASS_FUNC,
+        .preserves = 0,
+        .params = (void *) params,
+        .create = loop_pass_create,
+        .run_func = loop_pass_func,
+        .finish = loop_pass_finish
+    };
+
+    return p;
+}
@@ -0,0 +1,1721 @@
+#include <string.h>
+
+#include "../include/lower.h"
+#include "../include/profile.h"
+#include "../include/timer.h"
+#include "../include/utils.h"
+#include "../include/timetrace.h"
+#include "../include/typecheck.h"
+
+Lowerer lower_create(IrModule *ir, ModuleMap *mods, SpanInterner *si) {
+    int32_t num_mods = mod_num_mods(mods);
+
+    Lowerer l = {
+        .ir = ir,
+        .mods = mods,
+        .si = si,
+        .prefixes = lower_symbol_prefixes(mods),
+        .num_prefixes = num_mods,
+        .globals = (Map *) calloc(num_mods + 1, sizeof(Map)),
+        .strings = map_create(),
+        .mod = NULL,
+        .func = NULL,
+        .sret = IR_NO_VALUE,
+        .vars = vec_create(sizeof(LowerVar)),
+        .names = vec_create(sizeof(LowerName)),
+        .scope = { NULL, NULL, NULL, 0, 0 },
+        .address_taken = { NULL, NULL, NULL, 0, 0 },
+        .defs = { NULL, NULL, 0, 0 },
+        .sealed = NULL,
+        .pending_head = NULL,
+        .cap_blocks = 0,
+        .pending = vec_create(sizeof(LowerPhi)),
+        .forward = NULL,
+        .user_head = NULL,
+        .cap_insts = 0,
+        .users = vec_create(sizeof(LowerUser)),
+        .num_phis = 0
+    };
+
+    return l;
+}
+
+void lower_free(Lowerer *l) {
+    int32_t i = 0;
+    while (i < l->num_prefixes) {
+        free((void *) l->prefixes[i]);
+        i++;
+    }
+
+    i = 0;
+    while (i < mod_num_mods(l->mods)) {
+        map_free(&l->globals[i]);
+        i++;
+    }
+
+    free((void *) l->prefixes);
+    free((void *) l->globals);
+    map_free(&l->strings);
+    vec_free(&l->vars);
+    vec_free(&l->names);
+    lower_scope_free(&l->scope);
+    lower_scope_free(&l->address_taken);
+    free((void *) l->defs.keys);
+    free((void *) l->defs.values);
+    free((void *) l->sealed);
+    free((void *) l->pending_head);
+    vec_free(&l->pending);
+    free((void *) l->forward);
+    free((void *) l->user_head);
+    vec_free(&l->users);
+}
+
+// symbols are prefixed with the file stem, modules whose stems clash also get their index appended
+const char **lower_symbol_prefixes(ModuleMap *mods) {
+    const char **prefixes = (const char **) calloc(mod_num_mods(mods) + 1, sizeof(const char *));
+    Map stems = map_create();
+    int32_t i = 0;
+
+    while (i < mod_num_mods(mods)) {
+        Path *p = &mod_get_mod(mods, i)->path;
+        int32_t start = p->len;
+        int32_t len = p->len;
+
+        while (start > 0 && p->inner[start - 1] != SYSTEM_SEPARATOR) {
+            start--;
+        }
+
+        if (len - start > 4 && strncmp(p->inner + len - 4, SYNTHIUM_EXTENSION, 4) == 0) {
+            len -= 4;
+        }
+
+        Key key = map_create_key(len - start, p->inner + start);
+
+        if (map_get(&stems, key) != NULL) {
+            prefixes[i] = fmt_str("%.*s_%d", len - start, p->inner + start, i);
+        } else {
+            prefixes[i] = fmt_str("%.*s", len - start, p->inner + start);
+            map_insert(&stems, key, int2ptr(i + 1));
+        }
+
+        i++;
+    }
+
+    map_free(&stems);
+
+    return prefixes;
+}
+
+void lower_all(Lowerer *l) {
+    int32_t i = 0;
+    while (i < mod_num_mods(l->mods)) {
+        l->globals[i] = map_create();
+        i++;
+    }
+
+    i = 0;
+    while (i < mod_num_mods(l->mods)) {
+        Module *mod = mod_get_mod(l->mods, i);
+
+        lower_declare_structs(l, mod);
+        lower_declare_funcs(l, mod);
+        lower_declare_globals(l, mod);
+
+        i++;
+    }
+
+    int64_t num_funcs = 0;
+    i = 0;
+
+    while (i < mod_num_mods(l->mods)) {
+        num_funcs += lower_func_bodies(l, mod_get_mod(l->mods, i));
+        i++;
+    }
+
+    int64_t num_blocks = 0;
+    int64_t num_insts = 0;
+    uint32_t f = 0;
+
+    while (f < ir_module_num_funcs(l->ir)) {
+        IrFunc *func = ir_module_func(l->ir, f);
+        uint32_t b = 0;
+
+        while (b < func->num_blocks) {
+            num_insts += func->blocks[b].num_insts;
+            b++;
+        }
+
+        num_blocks += func->num_blocks;
+        f++;
+    }
+
+    timer_stat_add("ir functions", num_funcs);
+    timer_stat_add("ir blocks", num_blocks);
+    timer_stat_add("ir instructions", num_insts);
+    timer_stat_add("ir phis", l->num_phis);
+}
+
+int64_t lower_func_bodies(Lowerer *l, Module *mod) {
+    int64_t num_funcs = 0;
+    int32_t i = 0;
+
+    l->mod = mod;
+
+    while (i < mod_num_functions(mod)) {
+        FuncDeclStmt *f_s = mod_get_function_at(mod, i);
+
+        if (!f_s->decl.is_extern && f_s->block != NULL) {
+            lower_func(l, f_s);
+            num_funcs++;
+        }
+
+        i++;
+    }
+
+    return num_funcs;
+}
+
+// lowers a module that continues one lowered before, the repl's inputs. file_idx is the file it was parsed
+// from, whose structs are named like the ones of the module it continues
+void lower_continue_mod(Lowerer *l, Module *mod, int32_t file_idx) {
+    if (file_idx >= l->num_prefixes) {
+        l->prefixes = (const char **) realloc((void *) l->prefixes, (file_idx + 2) * sizeof(const char *));
+
+        while (l->num_prefixes <= file_idx) {
+            l->prefixes[l->num_prefixes++] = strdup(l->prefixes[mod->idx]);
+        }
+    }
+
+    lower_declare_structs(l, mod);
+    lower_declare_funcs(l, mod);
+    lower_declare_globals(l, mod);
+    lower_func_bodies(l, mod);
+}
+
+void lower_declare_structs(Lowerer *l, Module *mod) {
+    int32_t i = 0;
+
+    while (i < mod_num_structs(mod)) {
+        StructDecl *decl = &mod_get_struct_at(mod, i)->decl;
+        Ty *ty = mod_s_lookup(mod, ident_len(&decl->name, l->si), decl->name.ident);
+
+        if (ty != NULL && ty_is_struct(ty)) {
+            lower_struct_ty(l, ty_as_struct(ty));
+        }
+
+        i++;
+    }
+}
+
+// the module of a struct is found through the file its name was parsed from, modules and files share indices
+IrTypeId lower_struct_ty(Lowerer *l, Struct *s) {
+    if (s->ir_ty != IR_TYPE_VOID) {
+        return s->ir_ty;
+    }
+
+    int32_t mod_idx = span_get(l->si, s->name.ident_span).ctx;
+    const char *name = fmt_str("%s__%.*s", l->prefixes[mod_idx], ident_len(&s->name, l->si), s->name.ident);
+
+    s->ir_ty = ir_type_struct_declare(l->ir, name, strlen(name));
+    free((void *) name);
+
+    int32_t num_fields = ty_num_fields(s);
+    IrTypeId *fields = (IrTypeId *) malloc((num_fields + 1) * sizeof(IrTypeId));
+    int32_t i = 0;
+
+    // fields of struct type are defined first, pointers never recurse so there are no cycles
+    while (i < num_fields) {
+        fields[i] = lower_ty(l, ty_field_at(s, i)->ty);
+        i++;
+    }
+
+    ir_type_struct_define(l->ir, s->ir_ty, fields, num_fields);
+    free((void *) fields);
+
+    return s->ir_ty;
+}
+
+IrTypeId lower_ty(Lowerer *l, Ty *t) {
+    if (ty_is_i32(t)) {
+        return IR_TYPE_I32;
+    }
+
+    if (ty_is_struct(t)) {
+        return lower_struct_ty(l, ty_as_struct(t));
+    }
+
+    return IR_TYPE_PTR;
+}
+
+// structs are passed around by address
+IrTypeId lower_value_ty(Lowerer *l, Ty *t) {
+    if (ty_is_struct(t)) {
+        lower_struct_ty(l, ty_as_struct(t));
+        return IR_TYPE_PTR;
+    }
+
+    return lower_ty(l, t);
+}
+
+Func *lower_func_ty(Lowerer *l, Module *mod, FuncDef *def) {
+    Ty *ty = mod_s_lookup(mod, ident_len(&def->name, l->si), def->name.ident);
+
+    if (ty == NULL || !ty_is_func(ty) || ty_as_func(ty)->name.ident != def->name.ident) {
+        return NULL;
+    }
+
+    return ty_as_func(ty);
+}
+
+// externs keep their name and are shared between modules, struct results are written through a hidden first parameter
+void lower_declare_funcs(Lowerer *l, Module *mod) {
+    int32_t i = 0;
+
+    while (i < mod_num_functions(mod)) {
+        FuncDef *def = &mod_get_function_at(mod, i)->decl;
+        Func *f_ty = lower_func_ty(l, mod, def);
+        int32_t name_len = ident_len(&def->name, l->si);
+
+        if (f_ty == NULL) {
+            i++;
+            continue;
+        }
+
+        if (def->is_extern) {
+            IrFunc *existing = ir_func_lookup(l->ir, def->name.ident, name_len);
+
+            if (existing != NULL && (existing->flags & IR_FUNC_EXTERN)) {
+                f_ty->ir_idx = existing->idx;
+                i++;
+                continue;
+            }
+        }
+
+        bool sret = ty_is_struct(f_ty->ret);
+        int32_t num_params = f_ty->params.types.len + sret;
+        IrTypeId *params = (IrTypeId *) malloc((num_params + 1) * sizeof(IrTypeId));
+        int32_t j = 0;
+
+        if (sret) {
+            params[0] = IR_TYPE_PTR;
+        }
+
+        while (j < f_ty->params.types.len) {
+            params[j + sret] = lower_value_ty(l, ty_type_at(&f_ty->params, j));
+            j++;
+        }
+
+        IrTypeId ret = sret ? IR_TYPE_VOID : lower_ty(l, f_ty->ret);
+        bool is_main = name_len == 4 && strncmp(def->name.ident, "main", 4) == 0 && ir_func_lookup(l->ir, "main", 4) == NULL;
+        uint32_t flags = (def->is_extern ? IR_FUNC_EXTERN : 0) | (f_ty->is_varargs ? IR_FUNC_VARARGS : 0) | (is_main ? IR_FUNC_EXPORTED : 0);
+        flags |= def->inline_hint == FUNC_INLINE_ALWAYS ? IR_FUNC_INLINE : def->inline_hint == FUNC_INLINE_NEVER ? IR_FUNC_NOINLINE : 0;
+        IrFunc *f = NULL;
+
+        if (def->is_extern || is_main) {
+            f = ir_func_create(l->ir, def->name.ident, name_len, ret, params, num_params, flags);
+        } else {
+            const char *name = fmt_str("%s__%.*s", l->prefixes[mod->idx], name_len, def->name.ident);
+            f = ir_func_create(l->ir, name, strlen(name), ret, params, num_params, flags);
+            free((void *) name);
+        }
+
+        f->name_hash = profile_hash(profile_hash(PROFILE_HASH_SEED, mod->path.inner, mod->path.len), def->name.ident, name_len);
+        f_ty->ir_idx = f->idx;
+        free((void *) params);
+
+        i++;
+    }
+}
+
+int64_t lower_parse_int(Lowerer *l, Expr *e) {
+    if (ast_is_unary_expr(e)) {
+        return -lower_parse_int(l, ast_as_unary_expr(e)->right);
+    }
+
+    if (ast_is_char_expr(e)) {
+        return (unsigned char) ast_as_char_expr(e)->ptr[0];
+    }
+
+    // the literal of the smallest i32 wraps around, its negation brings it back
+    return (int32_t) ast_as_int_expr(e)->value;
+}
+
+// equal literals share one string, escapes are decoded here so later stages see the real bytes
+uint32_t lower_string(Lowerer *l, StringExpr *s_e) {
+    int32_t len = span_get(l->si, s_e->e.span).len;
+    Key key = map_create_key(len, s_e->ptr);
+    void *existing = map_get(&l->strings, key);
+
+    if (existing != NULL) {
+        return ptr2int(existing) - 1;
+    }
+
+    char *data = (char *) malloc(len + 1);
+    int32_t n = 0;
+    int32_t i = 0;
+
+    while (i < len) {
+        char c = s_e->ptr[i++];
+
+        if (c == '\\' && i < len) {
+            c = s_e->ptr[i++];
+
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                default: break;
+            }
+        }
+
+        data[n++] = c;
+    }
+
+    uint32_t idx = ir_module_add_string(l->ir, data, n);
+    free((void *) data);
+
+    map_insert(&l->strings, key, int2ptr(idx + 1));
+
+    return idx;
+}
+
+void lower_declare_globals(Lowerer *l, Module *mod) {
+    int32_t i = 0;
+
+    while (i < mod_num_stmts(mod)) {
+        Stmt *s = mod_get_stmt_at(mod, i);
+
+        if (s == NULL || !ast_is_let_stmt(s)) {
+            i++;
+            continue;
+        }
+
+        LetStmt *l_s = ast_as_let_stmt(s);
+        int32_t name_len = ident_len(&l_s->ident, l->si);
+        const char *name = fmt_str("%s__%.*s", l->prefixes[mod->idx], name_len, l_s->ident.ident);
+        uint32_t idx = 0;
+
+        if (ast_is_string_expr(l_s->value)) {
+            uint32_t str = lower_string(l, ast_as_string_expr(l_s->value));
+            idx = ir_module_add_global(l->ir, name, strlen(name), IR_TYPE_PTR, IR_INIT_STRING, str);
+        } else {
+            idx = ir_module_add_global(l->ir, name, strlen(name), IR_TYPE_I32, IR_INIT_INT, lower_parse_int(l, l_s->value));
+        }
+
+        map_insert(&l->globals[mod->idx], map_key_from_ident(l->si, &l_s->ident), int2ptr(idx + 1));
+        free((void *) name);
+
+        i++;
+    }
+}
+
+uint64_t lower_defs_key(IrBlockId block, uint32_t var) {
+    return ((uint64_t) (block + 1) << 32) | var;
+}
+
+uint32_t lower_defs_slot(LowerDefs *d, uint64_t key) {
+    uint32_t mask = d->cap - 1;
+    uint32_t i = (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+    while (d->keys[i] != 0 && d->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+void lower_defs_grow(LowerDefs *d) {
+    uint64_t *old_keys = d->keys;
+    IrValue *old_values = d->values;
+    uint32_t old_cap = d->cap;
+
+    d->cap = d->cap == 0 ? 256 : d->cap * 2;
+    d->keys = (uint64_t *) calloc(d->cap, sizeof(uint64_t));
+    d->values = (IrValue *) malloc(d->cap * sizeof(IrValue));
+
+    uint32_t i = 0;
+    while (i < old_cap) {
+        if (old_keys[i] != 0) {
+            uint32_t slot = lower_defs_slot(d, old_keys[i]);
+            d->keys[slot] = old_keys[i];
+            d->values[slot] = old_values[i];
+        }
+
+        i++;
+    }
+
+    free((void *) old_keys);
+    free((void *) old_values);
+}
+
+void lower_write_var(Lowerer *l, uint32_t var, IrBlockId block, IrValue v) {
+    LowerDefs *d = &l->defs;
+
+    if ((d->len + 1) * 4 > d->cap * 3) {
+        lower_defs_grow(d);
+    }
+
+    uint64_t key = lower_defs_key(block, var);
+    uint32_t slot = lower_defs_slot(d, key);
+
+    if (d->keys[slot] == 0) {
+        d->keys[slot] = key;
+        d->len++;
+    }
+
+    d->values[slot] = v;
+}
+
+IrBlockId lower_new_block(Lowerer *l) {
+    IrBlockId block = ir_block_create(l->func);
+
+    if (block >= l->cap_blocks) {
+        l->cap_blocks = l->cap_blocks == 0 ? 64 : l->cap_blocks * 2;
+        l->sealed = (bool *) realloc((void *) l->sealed, l->cap_blocks * sizeof(bool));
+        l->pending_head = (int32_t *) realloc((void *) l->pending_head, l->cap_blocks * sizeof(int32_t));
+    }
+
+    l->sealed[block] = false;
+    l->pending_head[block] = -1;
+
+    return block;
+}
+
+void lower_grow_insts(Lowerer *l) {
+    uint32_t old_cap = l->cap_insts;
+
+    if (l->func->num_insts <= old_cap) {
+        return;
+    }
+
+    while (l->cap_insts < l->func->num_insts) {
+        l->cap_insts = l->cap_insts == 0 ? 256 : l->cap_insts * 2;
+    }
+
+    l->forward = (IrValue *) realloc((void *) l->forward, l->cap_insts * sizeof(IrValue));
+    l->user_head = (int32_t *) realloc((void *) l->user_head, l->cap_insts * sizeof(int32_t));
+
+    memset((void *) (l->forward + old_cap), 0, (l->cap_insts - old_cap) * sizeof(IrValue));
+    memset((void *) (l->user_head + old_cap), 0xff, (l->cap_insts - old_cap) * sizeof(int32_t));
+}
+
+// removed phis forward to their replacement, operands are only rewritten once the function is done
+IrValue lower_find(Lowerer *l, IrValue v) {
+    IrValue root = v;
+
+    while (root < l->cap_insts && l->forward[root] != IR_NO_VALUE) {
+        root = l->forward[root];
+    }
+
+    while (v < l->cap_insts && l->forward[v] != IR_NO_VALUE) {
+        IrValue next = l->forward[v];
+        l->forward[v] = root;
+        v = next;
+    }
+
+    return root;
+}
+
+void lower_add_user(Lowerer *l, IrValue phi, IrValue user) {
+    lower_grow_insts(l);
+
+    LowerUser u = {
+        .user = user,
+        .next = l->user_head[phi]
+    };
+
+    vec_push(&l->users, (void *) &u);
+    l->user_head[phi] = l->users.len - 1;
+}
+
+IrValue lower_undef(Lowerer *l, IrTypeId ty) {
+    if (l->undef[ty] == IR_NO_VALUE) {
+        IrBuilder entry = l->b;
+        ir_builder_set_block(&entry, 0);
+        l->undef[ty] = ir_build_const(&entry, ty, 0);
+    }
+
+    return l->undef[ty];
+}
+
+IrValue lower_try_remove_trivial_phi(Lowerer *l, IrValue phi) {
+    IrFunc *f = l->func;
+
+    if (f->insts[phi].op != IR_PHI) {
+        return lower_find(l, phi);
+    }
+
+    IrValue same = IR_NO_VALUE;
+    uint32_t i = 0;
+
+    while (i < f->insts[phi].num_ops) {
+        IrValue op = lower_find(l, ir_inst_ops(f, &f->insts[phi])[i]);
+
+        if (op != same && op != phi) {
+            if (same != IR_NO_VALUE) {
+                return phi;
+            }
+
+            same = op;
+        }
+
+        i++;
+    }
+
+    if (same == IR_NO_VALUE) {
+        same = lower_undef(l, f->insts[phi].ty);
+    }
+
+    lower_grow_insts(l);
+    l->forward[phi] = same;
+    ir_inst_remove(f, phi);
+    l->num_phis--;
+
+    int32_t u = phi < l->cap_insts ? l->user_head[phi] : -1;
+
+    while (u >= 0) {
+        LowerUser *user = (LowerUser *) vec_get_ptr(&l->users, u);
+        IrValue v = user->user;
+        u = user->next;
+
+        if (v != phi) {
+            lower_try_remove_trivial_phi(l, v);
+        }
+    }
+
+    return lower_find(l, same);
+}
+
+IrValue lower_add_phi_operands(Lowerer *l, uint32_t var, IrValue phi) {
+    IrFunc *f = l->func;
+    IrBlockId block = f->insts[phi].block;
+    uint32_t num_preds = f->blocks[block].num_preds;
+    uint32_t i = 0;
+
+    ir_inst_set_num_ops(f, &f->insts[phi], num_preds);
+
+    while (i < num_preds) {
+        IrValue op = lower_read_var(l, var, f->blocks[block].preds[i]);
+
+        // reading may create instructions and move the instruction array
+        ir_inst_ops(f, &f->insts[phi])[i] = op;
+
+        if (op != phi && f->insts[op].op == IR_PHI) {
+            lower_add_user(l, op, phi);
+        }
+
+        i++;
+    }
+
+    return lower_try_remove_trivial_phi(l, phi);
+}
+
+IrValue lower_read_var_recursive(Lowerer *l, uint32_t var, IrBlockId block) {
+    IrFunc *f = l->func;
+    IrTypeId ty = ((LowerVar *) vec_get_ptr(&l->vars, var))->ty;
+    IrValue v = IR_NO_VALUE;
+
+    if (!l->sealed[block]) {
+        v = ir_build_phi_in(f, block, ty, 0);
+        l->num_phis++;
+
+        LowerPhi p = {
+            .var = var,
+            .phi = v,
+            .next = l->pending_head[block]
+        };
+
+        vec_push(&l->pending, (void *) &p);
+        l->pending_head[block] = l->pending.len - 1;
+    } else if (f->blocks[block].num_preds == 0) {
+        v = lower_undef(l, ty);
+    } else if (f->blocks[block].num_preds == 1) {
+        v = lower_read_var(l, var, f->blocks[block].preds[0]);
+    } else {
+        v = ir_build_phi_in(f, block, ty, 0);
+        l->num_phis++;
+
+        // the phi is the definition while its operands are read, which breaks cycles through loops
+        lower_write_var(l, var, block, v);
+        v = lower_add_phi_operands(l, var, v);
+    }
+
+    lower_write_var(l, var, block, v);
+
+    return v;
+}
+
+IrValue lower_read_var(Lowerer *l, uint32_t var, IrBlockId block) {
+    LowerDefs *d = &l->defs;
+
+    if (d->cap > 0) {
+        uint32_t slot = lower_defs_slot(d, lower_defs_key(block, var));
+
+        if (d->keys[slot] != 0) {
+            return lower_find(l, d->values[slot]);
+        }
+    }
+
+    return lower_read_var_recursive(l, var, block);
+}
+
+// a block is sealed once all of its predecessors are known
+void lower_seal(Lowerer *l, IrBlockId block) {
+    int32_t p = l->pending_head[block];
+
+    l->sealed[block] = true;
+    l->pending_head[block] = -1;
+
+    while (p >= 0) {
+        LowerPhi *phi = (LowerPhi *) vec_get_ptr(&l->pending, p);
+        int32_t next = phi->next;
+
+        lower_add_phi_operands(l, phi->var, phi->phi);
+        p = next;
+    }
+}
+
+void lower_collect_expr(Lowerer *l, Expr *e) {
+    switch (e->tag) {
+        case EXPR_BINARY: {
+            lower_collect_expr(l, ast_as_binary_expr(e)->left);
+            lower_collect_expr(l, ast_as_binary_expr(e)->right);
+            break;
+        }
+
+        case EXPR_UNARY: {
+            UnaryExpr *u_e = ast_as_unary_expr(e);
+
+            if (u_e->ty == UNARY_REF && ast_is_ident_expr(u_e->right)) {
+                Ident *ident = &ast_as_ident_expr(u_e->right)->ident;
+                lower_scope_set(&l->address_taken, ident->ident, ident_len(ident, l->si), 1);
+            }
+
+            lower_collect_expr(l, u_e->right);
+            break;
+        }
+
+        case EXPR_ASSIGN: {
+            lower_collect_expr(l, ast_as_assign_expr(e)->left);
+            lower_collect_expr(l, ast_as_assign_expr(e)->right);
+            break;
+        }
+
+        case EXPR_CALL: {
+            CallExpr *c_e = ast_as_call_expr(e);
+            int32_t i = 0;
+
+            while (i < ast_num_args(&c_e->args)) {
+                lower_collect_expr(l, ast_get_arg_at(&c_e->args, i));
+                i++;
+            }
+
+            break;
+        }
+
+        case EXPR_INIT: {
+            InitExpr *i_e = ast_as_init_expr(e);
+            int32_t i = 0;
+
+            while (i < ast_num_inits(&i_e->inits)) {
+                lower_collect_expr(l, ast_get_init_expr_at(&i_e->inits, i));
+                i++;
+            }
+
+            break;
+        }
+
+        case EXPR_ACCESS: {
+            lower_collect_expr(l, ast_as_access_expr(e)->left);
+            break;
+        }
+
+        case EXPR_AS: {
+            lower_collect_expr(l, ast_as_as_expr(e)->expr);
+            break;
+        }
+
+        case EXPR_NEW: {
+            lower_collect_expr(l, ast_as_new_expr(e)->expr);
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+// variables whose address is taken anywhere in the function live in memory, matched by name to stay conservative
+void lower_collect_stmt(Lowerer *l, Stmt *s) {
+    switch (s->tag) {
+        case STMT_EXPR: {
+            lower_collect_expr(l, ast_as_expr_stmt(s)->expr);
+            break;
+        }
+
+        case STMT_LET: {
+            lower_collect_expr(l, ast_as_let_stmt(s)->value);
+            break;
+        }
+
+        case STMT_BLOCK: {
+            BlockStmt *b = ast_as_block_stmt(s);
+            int32_t i = 0;
+
+            while (i < b->stmts.len) {
+                lower_collect_stmt(l, (Stmt *) ptrvec_get(&b->stmts, i));
+                i++;
+            }
+
+            break;
+        }
+
+        case STMT_IF: {
+            IfStmt *i_s = ast_as_if_stmt(s);
+
+            lower_collect_expr(l, i_s->condition);
+            lower_collect_stmt(l, (Stmt *) i_s->block);
+
+            if (i_s->else_stmt != NULL) {
+                lower_collect_stmt(l, i_s->else_stmt);
+            }
+
+            break;
+        }
+
+        case STMT_WHILE: {
+            lower_collect_expr(l, ast_as_while_stmt(s)->cond);
+            lower_collect_stmt(l, (Stmt *) ast_as_while_stmt(s)->block);
+            break;
+        }
+
+        case STMT_DELETE: {
+            lower_collect_expr(l, ast_as_delete_stmt(s)->expr);
+            break;
+        }
+
+        case STMT_RETURN: {
+            if (ast_as_return_stmt(s)->expr != NULL) {
+                lower_collect_expr(l, ast_as_return_stmt(s)->expr);
+            }
+
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+uint32_t lower_scope_slot(LowerScope *s, const char *key, int32_t len) {
+    uint32_t mask = s->cap - 1;
+    uint32_t i = ((uint32_t) map_hash(key, len) * 0x9E3779B9u) & mask;
+
+    while (s->keys[i] != NULL && (s->lens[i] != len || strncmp(s->keys[i], key, len) != 0)) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+void lower_scope_grow(LowerScope *s) {
+    const char **old_keys = s->keys;
+    int32_t *old_lens = s->lens;
+    int32_t *old_values = s->values;
+    uint32_t old_cap = s->cap;
+
+    s->cap = s->cap == 0 ? 64 : s->cap * 2;
+    s->keys = (const char **) calloc(s->cap, sizeof(const char *));
+    s->lens = (int32_t *) malloc(s->cap * sizeof(int32_t));
+    s->values = (int32_t *) malloc(s->cap * sizeof(int32_t));
+
+    uint32_t i = 0;
+    while (i < old_cap) {
+        if (old_keys[i] != NULL) {
+            uint32_t slot = lower_scope_slot(s, old_keys[i], old_lens[i]);
+            s->keys[slot] = old_keys[i];
+            s->lens[slot] = old_lens[i];
+            s->values[slot] = old_values[i];
+        }
+
+        i++;
+    }
+
+    free((void *) old_keys);
+    free((void *) old_lens);
+    free((void *) old_values);
+}
+
+int32_t lower_scope_get(LowerScope *s, const char *key, int32_t len) {
+    if (s->cap == 0) {
+        return -1;
+    }
+
+    uint32_t slot = lower_scope_slot(s, key, len);
+
+    return s->keys[slot] != NULL ? s->values[slot] : -1;
+}
+
+void lower_scope_set(LowerScope *s, const char *key, int32_t len, int32_t value) {
+    if ((s->len + 1) * 4 > s->cap * 3) {
+        lower_scope_grow(s);
+    }
+
+    uint32_t slot = lower_scope_slot(s, key, len);
+
+    if (s->keys[slot] == NULL) {
+        s->keys[slot] = key;
+        s->lens[slot] = len;
+        s->len++;
+    }
+
+    s->values[slot] = value;
+}
+
+void lower_scope_clear(LowerScope *s) {
+    if (s->len > 0) {
+        memset((void *) s->keys, 0, s->cap * sizeof(const char *));
+        s->len = 0;
+    }
+}
+
+void lower_scope_free(LowerScope *s) {
+    free((void *) s->keys);
+    free((void *) s->lens);
+    free((void *) s->values);
+}
+
+bool lower_is_address_taken(Lowerer *l, Ident *ident, int32_t len) {
+    return lower_scope_get(&l->address_taken, ident->ident, len) >= 0;
+}
+
+IrValue lower_entry_alloca(Lowerer *l, IrTypeId ty) {
+    IrBuilder entry = l->b;
+    ir_builder_set_block(&entry, 0);
+
+    return ir_build_alloca(&entry, ir_type_size(l->ir, ty), ir_type_align(l->ir, ty));
+}
+
+// struct variables get their slot from the caller, address taken scalars get a fresh one
+uint32_t lower_new_var(Lowerer *l, Ident *ident, Ty *ty, IrValue addr) {
+    int32_t len = ident_len(ident, l->si);
+
+    LowerVar var = {
+        .ty = lower_ty(l, ty),
+        .addr = addr
+    };
+
+    if (addr == IR_NO_VALUE && lower_is_address_taken(l, ident, len)) {
+        var.addr = lower_entry_alloca(l, var.ty);
+    }
+
+    LowerName name = {
+        .name = ident->ident,
+        .len = len,
+        .var = l->vars.len,
+        .prev = lower_scope_get(&l->scope, ident->ident, len)
+    };
+
+    lower_scope_set(&l->scope, ident->ident, len, (int32_t) l->names.len);
+    vec_push(&l->vars, (void *) &var);
+    vec_push(&l->names, (void *) &name);
+
+    return name.var;
+}
+
+uint32_t lower_lookup_var(Lowerer *l, Ident *ident) {
+    int32_t idx = lower_scope_get(&l->scope, ident->ident, ident_len(ident, l->si));
+
+    if (idx < 0) {
+        return LOWER_NO_VAR;
+    }
+
+    return ((LowerName *) vec_get_ptr(&l->names, idx))->var;
+}
+
+// drops the names declared since num_names and brings back the bindings they shadowed
+void lower_pop_names(Lowerer *l, int64_t num_names) {
+    while (l->names.len > num_names) {
+        LowerName *name = (LowerName *) vec_get_ptr(&l->names, l->names.len - 1);
+
+        lower_scope_set(&l->scope, name->name, name->len, name->prev);
+        l->names.len--;
+    }
+}
+
+void lower_reset(Lowerer *l, IrFunc *f) {
+    uint32_t used = l->func != NULL && l->func->num_insts < l->cap_insts ? l->func->num_insts : l->cap_insts;
+
+    if (l->forward != NULL) {
+        memset((void *) l->forward, 0, used * sizeof(IrValue));
+        memset((void *) l->user_head, 0xff, used * sizeof(int32_t));
+    }
+
+    if (l->defs.len > 0) {
+        memset((void *) l->defs.keys, 0, l->defs.cap * sizeof(uint64_t));
+        l->defs.len = 0;
+    }
+
+    memset((void *) l->undef, 0, sizeof(l->undef));
+
+    l->func = f;
+    l->b = ir_builder_create(l->ir, f);
+    l->sret = IR_NO_VALUE;
+    l->vars.len = 0;
+    l->names.len = 0;
+    lower_scope_clear(&l->scope);
+    lower_scope_clear(&l->address_taken);
+    l->pending.len = 0;
+    l->users.len = 0;
+}
+
+// rewrites every operand that still names a removed phi and drops the removed phis from their blocks
+void lower_finish(Lowerer *l) {
+    IrFunc *f = l->func;
+    IrValue v = 1;
+
+    while (v < f->num_insts) {
+        IrInst *inst = &f->insts[v];
+
+        if (inst->op != IR_NOP) {
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t i = 0;
+
+            while (i < n) {
+                ops[i] = lower_find(l, ops[i]);
+                i++;
+            }
+        }
+
+        v++;
+    }
+
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        ir_block_compact(f, b);
+        b++;
+    }
+}
+
+// b0 holds the parameters and stack slots and jumps to b1 once the body is done
+void lower_func(Lowerer *l, FuncDeclStmt *f_s) {
+    FuncDef *def = &f_s->decl;
+    Func *f_ty = lower_func_ty(l, l->mod, def);
+
+    if (f_ty == NULL) {
+        return;
+    }
+
+    int32_t tt = TIMETRACE_BEGIN("lower function", l->mod->path.len, l->mod->path.inner, ident_len(&def->name, l->si), def->name.ident);
+
+    IrFunc *f = ir_module_func(l->ir, f_ty->ir_idx);
+    lower_reset(l, f);
+    lower_collect_stmt(l, (Stmt *) f_s->block);
+
+    IrBlockId entry = lower_new_block(l);
+    IrBlockId body = lower_new_block(l);
+    l->sealed[entry] = true;
+    l->sealed[body] = true;
+
+    ir_builder_set_block(&l->b, entry);
+
+    uint32_t first = 0;
+    if (ty_is_struct(f_ty->ret)) {
+        l->sret = ir_build_param(&l->b, 0);
+        first = 1;
+    }
+
+    int32_t i = 0;
+    while (i < f_ty->params.types.len) {
+        Param *p = (Param *) vec_get_ptr(&def->params.params, i);
+        Ty *ty = ty_type_at(&f_ty->params, i);
+        IrValue v = ir_build_param(&l->b, first + i);
+
+        // struct arguments are copies made by the caller, so the callee can use them in place
+        if (ty_is_struct(ty)) {
+            lower_new_var(l, &p->name, ty, v);
+        } else {
+            uint32_t var = lower_new_var(l, &p->name, ty, IR_NO_VALUE);
+            LowerVar *lv = (LowerVar *) vec_get_ptr(&l->vars, var);
+
+            if (lv->addr != IR_NO_VALUE) {
+                ir_build_store(&l->b, lv->addr, v);
+            } else {
+                lower_write_var(l, var, body, v);
+            }
+        }
+
+        i++;
+    }
+
+    ir_builder_set_block(&l->b, body);
+    lower_block(l, f_s->block);
+
+    if (!ir_builder_is_terminated(&l->b)) {
+        if (f->ret == IR_TYPE_VOID) {
+            ir_build_ret(&l->b, IR_NO_VALUE);
+        } else {
+            ir_build_ret(&l->b, ir_build_const(&l->b, f->ret, 0));
+        }
+    }
+
+    ir_builder_set_block(&l->b, entry);
+    ir_build_br(&l->b, body);
+
+    lower_finish(l);
+
+    TIMETRACE_END(tt);
+}
+
+void lower_block(Lowerer *l, BlockStmt *b) {
+    int64_t num_names = l->names.len;
+    int32_t i = 0;
+
+    // statements after a return are unreachable and are not lowered
+    while (i < b->stmts.len && !ir_builder_is_terminated(&l->b)) {
+        lower_stmt(l, (Stmt *) ptrvec_get(&b->stmts, i));
+        i++;
+    }
+
+    lower_pop_names(l, num_names);
+}
+
+bool lower_is_fresh(Expr *e) {
+    return ast_is_init_expr(e) || ast_is_call_expr(e);
+}
+
+// struct literals and call results are already temporaries, every other struct value is copied
+IrValue lower_struct_copy(Lowerer *l, Expr *e) {
+    IrValue src = lower_expr(l, e);
+
+    if (lower_is_fresh(e)) {
+        return src;
+    }
+
+    IrTypeId ty = lower_ty(l, e->ty);
+    IrValue dst = lower_entry_alloca(l, ty);
+    ir_build_memcpy(&l->b, dst, src, ty);
+
+    return dst;
+}
+
+void lower_if(Lowerer *l, IfStmt *i_s) {
+    IrBlockId then_block = lower_new_block(l);
+    IrBlockId else_block = i_s->else_stmt != NULL ? lower_new_block(l) : IR_NO_BLOCK;
+    IrBlockId join = i_s->else_stmt == NULL ? lower_new_block(l) : IR_NO_BLOCK;
+
+    lower_cond(l, i_s->condition, then_block, else_block != IR_NO_BLOCK ? else_block : join);
+
+    lower_seal(l, then_block);
+    ir_builder_set_block(&l->b, then_block);
+    lower_block(l, i_s->block);
+
+    // the join block only exists when some branch falls through
+    if (!ir_builder_is_terminated(&l->b)) {
+        join = join == IR_NO_BLOCK ? lower_new_block(l) : join;
+        ir_build_br(&l->b, join);
+    }
+
+    if (else_block != IR_NO_BLOCK) {
+        lower_seal(l, else_block);
+        ir_builder_set_block(&l->b, else_block);
+        lower_stmt(l, i_s->else_stmt);
+
+        if (!ir_builder_is_terminated(&l->b)) {
+            join = join == IR_NO_BLOCK ? lower_new_block(l) : join;
+            ir_build_br(&l->b, join);
+        }
+    }
+
+    if (join != IR_NO_BLOCK) {
+        lower_seal(l, join);
+        ir_builder_set_block(&l->b, join);
+    }
+}
+
+void lower_while(Lowerer *l, WhileStmt *w_s) {
+    IrBlockId head = lower_new_block(l);
+    IrBlockId body = lower_new_block(l);
+    IrBlockId exit = lower_new_block(l);
+
+    ir_build_br(&l->b, head);
+    ir_builder_set_block(&l->b, head);
+    lower_cond(l, w_s->cond, body, exit);
+
+    lower_seal(l, body);
+    lower_seal(l, exit);
+
+    ir_builder_set_block(&l->b, body);
+    lower_block(l, w_s->block);
+
+    if (!ir_builder_is_terminated(&l->b)) {
+        ir_build_br(&l->b, head);
+    }
+
+    // the back edge is known now
+    lower_seal(l, head);
+    ir_builder_set_block(&l->b, exit);
+}
+
+// the call is marked for the tail call pass, a call returning a struct builds it in the caller's slot
+void lower_become(Lowerer *l, ReturnStmt *r_s) {
+    IrValue v = lower_call_into(l, ast_as_call_expr(r_s->expr), l->sret);
+    IrBlock *block = ir_block(l->func, l->b.block);
+    IrValue call = block->insts[block->num_insts - 1];
+
+    l->func->insts[call].flags |= IR_FLAG_MUST_TAIL;
+    ir_func_add_become(l->func, call, r_s->expr->span);
+    ir_build_ret(&l->b, l->func->insts[call].ty != IR_TYPE_VOID ? v : IR_NO_VALUE);
+}
+
+void lower_return(Lowerer *l, ReturnStmt *r_s) {
+    if (r_s->become) {
+        lower_become(l, r_s);
+        return;
+    }
+
+    if (r_s->expr == NULL) {
+        ir_build_ret(&l->b, IR_NO_VALUE);
+        return;
+    }
+
+    // struct literals and call results are built right in the caller's slot, nothing in the function can
+    // read it before the return
+    if (l->sret != IR_NO_VALUE) {
+        Expr *e = r_s->expr;
+
+        if (ast_is_init_expr(e)) {
+            lower_init_into(l, ast_as_init_expr(e), l->sret);
+        } else if (ast_is_call_expr(e)) {
+            lower_call_into(l, ast_as_call_expr(e), l->sret);
+        } else {
+            ir_build_memcpy(&l->b, l->sret, lower_expr(l, e), lower_ty(l, e->ty));
+        }
+
+        ir_build_ret(&l->b, IR_NO_VALUE);
+        return;
+    }
+
+    IrValue v = lower_expr(l, r_s->expr);
+
+    ir_build_ret(&l->b, v);
+}
+
+void lower_let(Lowerer *l, LetStmt *l_s) {
+    Ty *ty = l_s->value->ty;
+
+    if (ty_is_struct(ty)) {
+        lower_new_var(l, &l_s->ident, ty, lower_struct_copy(l, l_s->value));
+        return;
+    }
+
+    IrValue v = lower_expr(l, l_s->value);
+    uint32_t var = lower_new_var(l, &l_s->ident, ty, IR_NO_VALUE);
+    LowerVar *lv = (LowerVar *) vec_get_ptr(&l->vars, var);
+
+    if (lv->addr != IR_NO_VALUE) {
+        ir_build_store(&l->b, lv->addr, v);
+    } else {
+        lower_write_var(l, var, l->b.block, v);
+    }
+}
+
+void lower_stmt(Lowerer *l, Stmt *s) {
+    switch (s->tag) {
+        case STMT_EXPR: {
+            lower_expr(l, ast_as_expr_stmt(s)->expr);
+            break;
+        }
+
+        case STMT_LET: {
+            lower_let(l, ast_as_let_stmt(s));
+            break;
+        }
+
+        case STMT_BLOCK: {
+            lower_block(l, ast_as_block_stmt(s));
+            break;
+        }
+
+        case STMT_IF: {
+            lower_if(l, ast_as_if_stmt(s));
+            break;
+        }
+
+        case STMT_WHILE: {
+            lower_while(l, ast_as_while_stmt(s));
+            break;
+        }
+
+        case STMT_DELETE: {
+            ir_build_delete(&l->b, lower_expr(l, ast_as_delete_stmt(s)->expr));
+            break;
+        }
+
+        case STMT_RETURN: {
+            lower_return(l, ast_as_return_stmt(s));
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+IrOp lower_compare_op(BinaryType ty) {
+    switch (ty) {
+        case BINARY_ST: return IR_LT;
+        case BINARY_SE: return IR_LE;
+        case BINARY_GT: return IR_GT;
+        case BINARY_GE: return IR_GE;
+        case BINARY_EQ: return IR_EQ;
+        case BINARY_NE: return IR_NE;
+        default: return IR_NOP;
+    }
+}
+
+IrValue lower_is_zero(Lowerer *l, IrValue v, IrOp op) {
+    IrTypeId ty = l->func->insts[v].ty;
+    return ir_build_cmp(&l->b, op, v, ir_build_const(&l->b, ty, 0));
+}
+
+// && and || become branches, so the right operand is only evaluated when it decides the result
+void lower_cond(Lowerer *l, Expr *e, IrBlockId then_block, IrBlockId else_block) {
+    if (ast_is_binary_expr(e)) {
+        BinaryExpr *b_e = ast_as_binary_expr(e);
+
+        if (b_e->ty == BINARY_LOG_AND || b_e->ty == BINARY_LOG_OR) {
+            IrBlockId rhs = lower_new_block(l);
+
+            if (b_e->ty == BINARY_LOG_AND) {
+                lower_cond(l, b_e->left, rhs, else_block);
+            } else {
+                lower_cond(l, b_e->left, then_block, rhs);
+            }
+
+            lower_seal(l, rhs);
+            ir_builder_set_block(&l->b, rhs);
+            lower_cond(l, b_e->right, then_block, else_block);
+
+            return;
+        }
+
+        IrOp op = lower_compare_op(b_e->ty);
+
+        if (op != IR_NOP) {
+            IrValue left = lower_expr(l, b_e->left);
+            IrValue right = lower_expr(l, b_e->right);
+
+            ir_build_cbr(&l->b, ir_build_cmp(&l->b, op, left, right), then_block, else_block);
+            return;
+        }
+    }
+
+    if (ast_is_unary_expr(e) && ast_as_unary_expr(e)->ty == UNARY_NEG_BOOL) {
+        lower_cond(l, ast_as_unary_expr(e)->right, else_block, then_block);
+        return;
+    }
+
+    IrValue v = lower_expr(l, e);
+    ir_build_cbr(&l->b, lower_is_zero(l, v, IR_NE), then_block, else_block);
+}
+
+IrValue lower_bool_value(Lowerer *l, Expr *e) {
+    IrBlockId then_block = lower_new_block(l);
+    IrBlockId else_block = lower_new_block(l);
+    IrBlockId join = lower_new_block(l);
+
+    lower_cond(l, e, then_block, else_block);
+    lower_seal(l, then_block);
+    lower_seal(l, else_block);
+
+    ir_builder_set_block(&l->b, then_block);
+    IrValue one = ir_build_const(&l->b, IR_TYPE_I32, 1);
+    ir_build_br(&l->b, join);
+
+    ir_builder_set_block(&l->b, else_block);
+    IrValue zero = ir_build_const(&l->b, IR_TYPE_I32, 0);
+    ir_build_br(&l->b, join);
+
+    lower_seal(l, join);
+    ir_builder_set_block(&l->b, join);
+
+    IrValue phi = ir_build_phi(&l->b, IR_TYPE_I32, 2);
+    IrValue *ops = ir_inst_ops(l->func, &l->func->insts[phi]);
+    ops[0] = one;
+    ops[1] = zero;
+
+    l->num_phis++;
+
+    return phi;
+}
+
+// p + i moves p by i pointees, the index is widened first so negative indices and large offsets do not wrap
+IrValue lower_ptr_offset(Lowerer *l, BinaryExpr *b_e, IrValue ptr, IrValue index) {
+    Ptr *p_ty = ty_as_ptr(b_e->left->ty);
+    uint32_t size = p_ty->count == 1 ? ir_type_size(l->ir, lower_ty(l, p_ty->inner)) : 8;
+    IrValue wide = ir_build_cast(&l->b, IR_SEXT, IR_TYPE_I64, index);
+    IrValue scaled = ir_build_binary(&l->b, IR_MUL, wide, ir_build_const(&l->b, IR_TYPE_I64, size));
+    IrValue addr = ir_build_cast(&l->b, IR_PTR_TO_INT, IR_TYPE_I64, ptr);
+
+    addr = ir_build_binary(&l->b, b_e->ty == BINARY_ADD ? IR_ADD : IR_SUB, addr, scaled);
+
+    return ir_build_cast(&l->b, IR_INT_TO_PTR, IR_TYPE_PTR, addr);
+}
+
+IrValue lower_binary(Lowerer *l, BinaryExpr *b_e) {
+    if (b_e->ty == BINARY_LOG_AND || b_e->ty == BINARY_LOG_OR) {
+        return lower_bool_value(l, (Expr *) b_e);
+    }
+
+    IrValue left = lower_expr(l, b_e->left);
+    IrValue right = lower_expr(l, b_e->right);
+    IrOp op = lower_compare_op(b_e->ty);
+
+    if (op != IR_NOP) {
+        return ir_build_cast(&l->b, IR_ZEXT, IR_TYPE_I32, ir_build_cmp(&l->b, op, left, right));
+    }
+
+    if (ty_is_ptr(b_e->left->ty)) {
+        return lower_ptr_offset(l, b_e, left, right);
+    }
+
+    switch (b_e->ty) {
+        case BINARY_ADD: op = IR_ADD; break;
+        case BINARY_SUB: op = IR_SUB; break;
+        case BINARY_MUL: op = IR_MUL; break;
+        case BINARY_DIV: op = IR_DIV; break;
+        default: op = IR_MOD; break;
+    }
+
+    return ir_build_binary(&l->b, op, left, right);
+}
+
+IrValue lower_load(Lowerer *l, Ty *ty, IrValue addr) {
+    if (ty_is_struct(ty)) {
+        return addr;
+    }
+
+    return ir_build_load(&l->b, lower_ty(l, ty), addr);
+}
+
+IrValue lower_global_addr(Lowerer *l, int32_t mod_idx, Ident *ident) {
+    void *idx = map_get(&l->globals[mod_idx], map_key_from_ident(l->si, ident));
+    return ir_build_global(&l->b, ptr2int(idx) - 1);
+}
+
+IrValue lower_field_addr(Lowerer *l, AccessExpr *a_e) {
+    Struct *s = typecheck_accessed_struct(a_e->left->ty);
+    IrValue base = lower_expr(l, a_e->left);
+    int32_t idx = ty_field_index(s, l->si, &ast_as_ident_expr(a_e->right)->ident);
+    IrField *field = ir_type_field(l->ir, lower_struct_ty(l, s), idx);
+
+    if (field->offset == 0) {
+        return base;
+    }
+
+    return ir_build_offset(&l->b, base, field->offset);
+}
+
+IrValue lower_addr(Lowerer *l, Expr *e) {
+    if (ast_is_ident_expr(e)) {
+        Ident *ident = &ast_as_ident_expr(e)->ident;
+        uint32_t var = lower_lookup_var(l, ident);
+
+        if (var != LOWER_NO_VAR) {
+            return ((LowerVar *) vec_get_ptr(&l->vars, var))->addr;
+        }
+
+        return lower_global_addr(l, l->mod->idx, ident);
+    }
+
+    if (ast_is_access_expr(e)) {
+        AccessExpr *a_e = ast_as_access_expr(e);
+
+        if (ty_is_mod(a_e->left->ty)) {
+            return lower_global_addr(l, ty_as_mod(a_e->left->ty)->idx, &ast_as_ident_expr(a_e->right)->ident);
+        }
+
+        return lower_field_addr(l, a_e);
+    }
+
+    // dereferences and struct valued expressions already produce an address
+    if (ast_is_unary_expr(e) && ast_as_unary_expr(e)->ty == UNARY_DEREF) {
+        return lower_expr(l, ast_as_unary_expr(e)->right);
+    }
+
+    return lower_expr(l, e);
+}
+
+IrValue lower_assign(Lowerer *l, AssignExpr *a_e) {
+    Ty *ty = a_e->left->ty;
+
+    if (ast_is_ident_expr(a_e->left)) {
+        uint32_t var = lower_lookup_var(l, &ast_as_ident_expr(a_e->left)->ident);
+
+        if (var != LOWER_NO_VAR && ((LowerVar *) vec_get_ptr(&l->vars, var))->addr == IR_NO_VALUE) {
+            IrValue v = lower_expr(l, a_e->right);
+            lower_write_var(l, var, l->b.block, v);
+
+            return v;
+        }
+    }
+
+    IrValue v = lower_expr(l, a_e->right);
+    IrValue dst = lower_addr(l, a_e->left);
+
+    if (ty_is_struct(ty)) {
+        ir_build_memcpy(&l->b, dst, v, lower_ty(l, ty));
+        return dst;
+    }
+
+    ir_build_store(&l->b, dst, v);
+
+    return v;
+}
+
+void lower_zero_into(Lowerer *l, Struct *s, IrValue dst) {
+    IrTypeId id = lower_struct_ty(l, s);
+    int32_t i = 0;
+
+    while (i < ty_num_fields(s)) {
+        Ty *ty = ty_field_at(s, i)->ty;
+        IrField *field = ir_type_field(l->ir, id, i);
+        IrValue addr = field->offset == 0 ? dst : ir_build_offset(&l->b, dst, field->offset);
+
+        if (ty_is_struct(ty)) {
+            lower_zero_into(l, ty_as_struct(ty), addr);
+        } else {
+            ir_build_store(&l->b, addr, ir_build_const(&l->b, lower_ty(l, ty), 0));
+        }
+
+        i++;
+    }
+}
+
+// fields without an initializer are zeroed, the others are evaluated in source order
+void lower_init_into(Lowerer *l, InitExpr *i_e, IrValue dst) {
+    Struct *s = ty_as_struct(i_e->e.ty);
+    IrTypeId id = lower_struct_ty(l, s);
+    int32_t num_inits = ast_num_inits(&i_e->inits);
+    int32_t i = 0;
+
+    while (i < ty_num_fields(s)) {
+        StructField *f = ty_field_at(s, i);
+        int32_t len = ident_len(&f->name, l->si);
+        bool initialized = false;
+        int32_t j = 0;
+
+        while (j < num_inits && !initialized) {
+            Init *init = (Init *) vec_get_ptr(&i_e->inits.inits, j);
+            initialized = ident_len(&init->ident, l->si) == len && strncmp(init->ident.ident, f->name.ident, len) == 0;
+            j++;
+        }
+
+        if (!initialized) {
+            IrField *field = ir_type_field(l->ir, id, i);
+            IrValue addr = field->offset == 0 ? dst : ir_build_offset(&l->b, dst, field->offset);
+
+            if (ty_is_struct(f->ty)) {
+                lower_zero_into(l, ty_as_struct(f->ty), addr);
+            } else {
+                ir_build_store(&l->b, addr, ir_build_const(&l->b, lower_ty(l, f->ty), 0));
+            }
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < num_inits) {
+        Init *init = (Init *) vec_get_ptr(&i_e->inits.inits, i);
+        int32_t idx = ty_field_index(s, l->si, &init->ident);
+        IrField *field = ir_type_field(l->ir, id, idx);
+        Ty *ty = ty_field_at(s, idx)->ty;
+
+        if (ty_is_struct(ty) && ast_is_init_expr(init->expr)) {
+            IrValue addr = field->offset == 0 ? dst : ir_build_offset(&l->b, dst, field->offset);
+            lower_init_into(l, ast_as_init_expr(init->expr), addr);
+
+            i++;
+            continue;
+        }
+
+        IrValue v = lower_expr(l, init->expr);
+        IrValue addr = field->offset == 0 ? dst : ir_build_offset(&l->b, dst, field->offset);
+
+        if (ty_is_struct(ty)) {
+            ir_build_memcpy(&l->b, addr, v, field->ty);
+        } else {
+            ir_build_store(&l->b, addr, v);
+        }
+
+        i++;
+    }
+}
+
+IrValue lower_new(Lowerer *l, NewExpr *n_e) {
+    Expr *inner = n_e->expr;
+    IrTypeId ty = lower_ty(l, inner->ty);
+
+    if (ast_is_init_expr(inner)) {
+        IrValue p = ir_build_new(&l->b, ir_type_size(l->ir, ty));
+        lower_init_into(l, ast_as_init_expr(inner), p);
+
+        return p;
+    }
+
+    IrValue v = lower_expr(l, inner);
+    IrValue p = ir_build_new(&l->b, ir_type_size(l->ir, ty));
+
+    if (ty_is_struct(inner->ty)) {
+        ir_build_memcpy(&l->b, p, v, ty);
+    } else {
+        ir_build_store(&l->b, p, v);
+    }
+
+    return p;
+}
+
+// a struct result is written straight into dst when there is one, otherwise into a fresh slot
+IrValue lower_call_into(Lowerer *l, CallExpr *c_e, IrValue dst) {
+    Func *f_ty = ty_as_func(c_e->ident->ty);
+    bool sret = ty_is_struct(f_ty->ret);
+    int32_t num_args = ast_num_args(&c_e->args);
+    IrValue *args = (IrValue *) malloc((num_args + sret + 1) * sizeof(IrValue));
+    IrValue result = IR_NO_VALUE;
+    int32_t i = 0;
+
+    if (sret) {
+        result = dst != IR_NO_VALUE ? dst : lower_entry_alloca(l, lower_ty(l, f_ty->ret));
+        args[0] = result;
+    }
+
+    while (i < num_args) {
+        Expr *arg = ast_get_arg_at(&c_e->args, i);
+        args[i + sret] = ty_is_struct(arg->ty) ? lower_struct_copy(l, arg) : lower_expr(l, arg);
+        i++;
+    }
+
+    IrValue v = ir_build_call(&l->b, f_ty->ir_idx, args, num_args + sret);
+    free((void *) args);
+
+    return sret ? result : v;
+}
+
+IrValue lower_call(Lowerer *l, CallExpr *c_e) {
+    return lower_call_into(l, c_e, IR_NO_VALUE);
+}
+
+IrValue lower_cast(Lowerer *l, AsExpr *a_e) {
+    IrValue v = lower_expr(l, a_e->expr);
+    IrTypeId from = lower_ty(l, a_e->expr->ty);
+    IrTypeId to = lower_ty(l, a_e->e.ty);
+
+    if (from == to) {
+        return v;
+    }
+
+    return ir_build_cast(&l->b, to == IR_TYPE_PTR ? IR_INT_TO_PTR : IR_PTR_TO_INT, to, v);
+}
+
+IrValue lower_expr(Lowerer *l, Expr *e) {
+    switch (e->tag) {
+        case EXPR_INT:
+        case EXPR_CHAR: {
+            return ir_build_const(&l->b, IR_TYPE_I32, lower_parse_int(l, e));
+        }
+
+        case EXPR_STRING: {
+            return ir_build_str(&l->b, lower_string(l, ast_as_string_expr(e)));
+        }
+
+        case EXPR_IDENT: {
+            Ident *ident = &ast_as_ident_expr(e)->ident;
+            uint32_t var = lower_lookup_var(l, ident);
+
+            if (var != LOWER_NO_VAR) {
+                LowerVar *lv = (LowerVar *) vec_get_ptr(&l->vars, var);
+
+                if (lv->addr == IR_NO_VALUE) {
+                    return lower_read_var(l, var, l->b.block);
+                }
+
+                return lower_load(l, e->ty, lv->addr);
+            }
+
+            if (ty_is_func(e->ty)) {
+                return ir_build_func_addr(&l->b, ty_as_func(e->ty)->ir_idx);
+            }
+
+            return lower_load(l, e->ty, lower_global_addr(l, l->mod->idx, ident));
+        }
+
+        case EXPR_ACCESS: {
+            if (ty_is_func(e->ty)) {
+                return ir_build_func_addr(&l->b, ty_as_func(e->ty)->ir_idx);
+            }
+
+            return lower_load(l, e->ty, lower_addr(l, e));
+        }
+
+        case EXPR_CALL: {
+            return lower_call(l, ast_as_call_expr(e));
+        }
+
+        case EXPR_INIT: {
+            IrValue dst = lower_entry_alloca(l, lower_ty(l, e->ty));
+            lower_init_into(l, ast_as_init_expr(e), dst);
+
+            return dst;
+        }
+
+        case EXPR_BINARY: {
+            return lower_binary(l, ast_as_binary_expr(e));
+        }
+
+        case EXPR_UNARY: {
+            UnaryExpr *u_e = ast_as_unary_expr(e);
+
+            switch (u_e->ty) {
+                case UNARY_REF: {
+                    return lower_addr(l, u_e->right);
+                }
+
+                case UNARY_DEREF: {
+                    return lower_load(l, e->ty, lower_expr(l, u_e->right));
+                }
+
+                case UNARY_NEG_BOOL: {
+                    IrValue v = lower_expr(l, u_e->right);
+                    return ir_build_cast(&l->b, IR_ZEXT, IR_TYPE_I32, lower_is_zero(l, v, IR_EQ));
+                }
+
+                case UNARY_NEG_NUM: {
+                    return ir_build_unary(&l->b, IR_NEG, lower_expr(l, u_e->right));
+                }
+            }
+
+            return IR_NO_VALUE;
+        }
+
+        case EXPR_ASSIGN: {
+            return lower_assign(l, ast_as_assign_expr(e));
+        }
+
+        case EXPR_AS: {
+            return lower_cast(l, ast_as_as_expr(e));
+        }
+
+        case EXPR_NEW: {
+            return lower_new(l, ast_as_new_expr(e));
+        }
+    }
+
+    return IR_NO_VALUE;
+}
@@ -3,13 +3,13 @@
 #include "../include/ident.h"
 
 int32_t map_hash(const char *key, int32_t len) {
-    int32_t h = 0;
+    uint32_t h = 0;
 
     for (int32_t i = 0; i < len; i++) {
-        h = h * HASH_NUM + key[i];
+        h = h * HASH_NUM + (unsigned char) key[i];
     }
 
-    return h;
+    return (int32_t) (h & INT32_MAX);
 }
 
 int32_t map_get_idx(int32_t cap, const char *key, int32_t key_len) {
@@ -42,7 +42,7 @@ Map map_create() {
 }
 
 Map map_with_cap(int32_t cap) {
-    if ((cap % 2) != 0) cap = next_pow_of_2(cap);
+    if ((cap & (cap - 1)) != 0) cap = next_pow_of_2(cap);
 
     Map map = {
         .buckets = (Bucket *) calloc(cap, sizeof(Bucket)),
@@ -86,6 +86,7 @@ bool map_insert(Map *map, Key key, void *value) {
 
     if (map_bucket_is_empty(b)) {
         b->item = item;
+        map->len++;
         return false;
     }
 
@@ -97,6 +98,7 @@ bool map_insert(Map *map, Key key, void *value) {
             };
 
             b->item = itm;
+            map->len++;
             return false;
         }
 
@@ -111,6 +113,7 @@ bool map_insert(Map *map, Key key, void *value) {
             bucket->next = NULL;
 
             b->next = bucket;
+            map->len++;
             return false;
         }
 
@@ -146,13 +149,14 @@ void map_resize_if_needed(Map *map) {
     if (int2flt(map->len) > LOAD_FACTOR * int2flt(cap)) {
         cap *= 2;
 
-        Bucket *new_buckets = (Bucket *) calloc(map->cap, sizeof(Bucket));
+        Bucket *new_buckets = (Bucket *) calloc(cap, sizeof(Bucket));
         Map new_map = {
             .buckets = new_buckets,
-            .len = map->len,
+            .len = 0,
             .cap = cap
         };
         map_insert_all(map, &new_map);
+        map_free(map);
         *map = new_map;
     }
 }
@@ -172,7 +176,7 @@ void map_insert_all(Map *old_map, Map *new_map) {
         Bucket *b = old_map->buckets + i;
 
         while (b != NULL) {
-            if (map_bucket_is_empty(b)) {
+            if (!map_bucket_is_empty(b)) {
                 map_insert(new_map, b->item.key, b->item.value);
             }
 
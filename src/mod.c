@@ -203,7 +203,7 @@ Module *mod_try_get_mod_from_import(ModuleMap *mm, Module *m, SpanInterner *si,
 
     imported_mod = mod_get_mod_by_path(mm, &abs.inner);
 
-    if (imported_mod != NULL) {
+    if (imported_mod == NULL) {
         if (errdest != NULL) {
             const char *s = path_to_string(&abs.inner);
             *errdest = (char *) fmt_str("%s is not being compiled", s);
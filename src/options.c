@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include "../include/options.h"
+
+Options options_empty() {
+    Options opts = {
+        .time_report = REPORT_NONE,
+        .time_report_file = NULL,
+        .time_trace_file = NULL,
+        .emit = EMIT_NONE,
+        .output_file = NULL,
+        .opt_level = 1,
+        .inline_threshold = -1,
+        .jobs = 0,
+        .profile_generate = NULL,
+        .profile_use = NULL,
+        .verify_ir = false,
+        .run = false,
+        .jit = true,
+        .repl = false,
+        .num_files = 0,
+        .files = NULL,
+        .num_run_args = 0,
+        .run_args = NULL
+    };
+
+    return opts;
+}
+
+bool options_has_prefix(const char *arg, const char *prefix) {
+    return strncmp(arg, prefix, strlen(prefix)) == 0;
+}
+
+// everything that does not start with '-' is an input file. `run` as the first argument runs the program
+// instead of compiling it, the arguments after `--` are passed to its main. `repl` reads programs line by line
+bool options_parse(Options *opts, int32_t argc, const char **argv) {
+    opts->files = (const char **) malloc((argc + 1) * sizeof(const char *));
+    int32_t i = 0;
+
+    if (argc > 0 && strcmp(argv[0], "run") == 0) {
+        opts->run = true;
+        i++;
+    } else if (argc > 0 && strcmp(argv[0], "repl") == 0) {
+        opts->repl = true;
+        i++;
+    }
+
+    while (i < argc) {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--") == 0) {
+            opts->num_run_args = argc - i - 1;
+            opts->run_args = argv + i + 1;
+            break;
+        } else if (strcmp(arg, "--time-report") == 0 || strcmp(arg, "--time-report=table") == 0) {
+            opts->time_report = REPORT_TABLE;
+        } else if (strcmp(arg, "--time-report=json") == 0) {
+            opts->time_report = REPORT_JSON;
+        } else if (options_has_prefix(arg, "--time-report-file=")) {
+            opts->time_report_file = arg + strlen("--time-report-file=");
+
+            if (opts->time_report == REPORT_NONE) {
+                opts->time_report = REPORT_TABLE;
+            }
+        } else if (strcmp(arg, "--time-trace") == 0) {
+            opts->time_trace_file = "synthiumc-trace.json";
+        } else if (options_has_prefix(arg, "--time-trace=")) {
+            opts->time_trace_file = arg + strlen("--time-trace=");
+        } else if (strcmp(arg, "--emit=ir") == 0) {
+            opts->emit = EMIT_IR;
+        } else if (strcmp(arg, "--emit=obj") == 0) {
+            opts->emit = EMIT_OBJ;
+        } else if (strcmp(arg, "--emit=c") == 0) {
+            opts->emit = EMIT_C;
+        } else if (strcmp(arg, "--emit=bytecode") == 0) {
+            opts->emit = EMIT_BYTECODE;
+        } else if (strcmp(arg, "-o") == 0) {
+            if (i + 1 >= argc) {
+                printf("[error] missing file name after '-o'\n");
+                return false;
+            }
+
+            opts->output_file = argv[++i];
+        } else if (strcmp(arg, "-O0") == 0 || strcmp(arg, "-O1") == 0 || strcmp(arg, "-O2") == 0) {
+            opts->opt_level = arg[2] - '0';
+        } else if (options_has_prefix(arg, "--inline-threshold=")) {
+            opts->inline_threshold = atoi(arg + strlen("--inline-threshold="));
+        } else if (options_has_prefix(arg, "--jobs=")) {
+            opts->jobs = atoi(arg + strlen("--jobs="));
+        } else if (options_has_prefix(arg, "-j") && arg[2] >= '0' && arg[2] <= '9') {
+            opts->jobs = atoi(arg + 2);
+        } else if (strcmp(arg, "--profile-generate") == 0) {
+            opts->profile_generate = "synthium.profdata";
+        } else if (options_has_prefix(arg, "--profile-generate=")) {
+            opts->profile_generate = arg + strlen("--profile-generate=");
+        } else if (options_has_prefix(arg, "--profile-use=")) {
+            opts->profile_use = arg + strlen("--profile-use=");
+        } else if (strcmp(arg, "--verify-ir") == 0) {
+            opts->verify_ir = true;
+        } else if (strcmp(arg, "--no-jit") == 0) {
+            opts->jit = false;
+        } else if (options_has_prefix(arg, "-")) {
+            printf("[error] unknown option '%s'\n", arg);
+            return false;
+        } else {
+            opts->files[opts->num_files++] = arg;
+        }
+
+        i++;
+    }
+
+    // -o on its own asks for an object file
+    if (opts->output_file != NULL && opts->emit == EMIT_NONE) {
+        opts->emit = EMIT_OBJ;
+    }
+
+    if (opts->emit == EMIT_OBJ && opts->output_file == NULL) {
+        opts->output_file = "out.o";
+    }
+
+    // C is written as one file per module, -o names the directory
+    if (opts->emit == EMIT_C && opts->output_file == NULL) {
+        opts->output_file = ".";
+    }
+
+    return true;
+}
+
+void options_free(Options *opts) {
+    free((void *) opts->files);
+}
@@ -10,5 +10,5 @@ Param param_create(Ident name, Type ty) {
 }
 
 bool param_is_varargs(Param *p) {
-    return memcmp((void *) &p->name.ident, (void *) "...", 3) == 0;
+    return p->name.ident != NULL && memcmp((void *) p->name.ident, (void *) "...", 3) == 0;
 }
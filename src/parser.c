@@ -1,4 +1,5 @@
 #include "../include/parser.h"
+#include "../include/timetrace.h"
 
 ParseError parser_empty_err() {
     ParseError error = {
@@ -188,7 +189,8 @@ Token parser_peek(Parser *p) {
 Module *parser_parse(Parser *p) {
     Path path = p->lexer.source.file.path.inner;
     Module *mod = mod_create(path);
-    
+    int32_t tt = TIMETRACE_BEGIN("parse module", path.len, path.inner, 0, NULL);
+
     while (parser_peek(p).ty != TOKEN_EOF) {
         Stmt *s = parser_statement(p);
         if (s != NULL) {
@@ -196,6 +198,8 @@ Module *parser_parse(Parser *p) {
         }
     }
 
+    TIMETRACE_END(tt);
+
     return mod;
 }
 
@@ -237,6 +241,18 @@ bool parser_parse_statement(Parser *p, Stmt **dest) {
             return false;
         }
 
+        case TOKEN_INLINE:
+        case TOKEN_NOINLINE: {
+            parser_consume(p, peek.ty);
+            *dest = parser_parse_func_def(p, false);
+
+            if (*dest != NULL) {
+                ast_as_func_decl_stmt(*dest)->decl.inline_hint = peek.ty == TOKEN_INLINE ? FUNC_INLINE_ALWAYS : FUNC_INLINE_NEVER;
+            }
+
+            return false;
+        }
+
         case TOKEN_IF: {
             *dest = parser_parse_if_stmt(p);
             return false;
@@ -268,6 +284,11 @@ bool parser_parse_statement(Parser *p, Stmt **dest) {
             return true;
         }
 
+        case TOKEN_BECOME: {
+            *dest = parser_parse_become_stmt(p);
+            return true;
+        }
+
         case TOKEN_LET: {
             *dest = parser_parse_let_stmt(p);
             return true;
@@ -434,7 +455,7 @@ Stmt *parser_parse_delete_stmt(Parser *p) {
 }
 
 Stmt *parser_parse_return_stmt(Parser *p) {
-    CONSUME_OR_NULL(TOKEN_DELETE);
+    CONSUME_OR_NULL(TOKEN_RETURN);
     
     if (parser_peek(p).ty == TOKEN_SEMI) {
         return ast_new_return_stmt(NULL);
@@ -445,6 +466,13 @@ Stmt *parser_parse_return_stmt(Parser *p) {
     return ast_new_return_stmt(expr);
 }
 
+Stmt *parser_parse_become_stmt(Parser *p) {
+    CONSUME_OR_NULL(TOKEN_BECOME);
+    CHECK_EXPR_OR_NULL(expr, parser_expression(p, false));
+
+    return ast_new_become_stmt(expr);
+}
+
 Stmt *parser_parse_let_stmt(Parser *p) {
     CONSUME_OR_NULL(TOKEN_LET);
 
@@ -507,7 +535,7 @@ Stmt *parser_parse_block(Parser *p) {
 Vec parser_parse_field_list(Parser *p) {
     #define BAIL() vec_free(&fields); return vec_create(0)
 
-    Vec fields = vec_create(sizeof(Fields));
+    Vec fields = vec_create(sizeof(Field));
     Token peek = parser_peek(p);
 
     while (peek.ty != TOKEN_EOF && peek.ty != TOKEN_RBRACE) {
@@ -735,7 +763,7 @@ Expr *parser_prefix(Parser *p, bool no_struct) {
 
     switch (token.ty) {
         case TOKEN_INT: {
-            return ast_new_int_expr(token.span, token.lexeme);
+            return ast_new_int_expr(token.span, token.lexeme, parser_parse_int(p, &token));
         }
 
         case TOKEN_STRING: {
@@ -805,8 +833,14 @@ Expr *parser_infix(Parser *p, Token *token, Expr *left, bool no_struct) {
         return ast_new_binary_expr(span, typ, left, right)
 
     switch (token->ty) {
+        // the right side is a single field or member name, so 'a.b + c' is '(a.b) + c' and 'a.b.c' is '(a.b).c'
         case TOKEN_DOT: {
-            CHECK_EXPR_OR_NULL(right, parser_expression(p, no_struct));
+            Token member = lexer_empty_token();
+            if (!parser_consume_token(p, TOKEN_IDENT, &member)) {
+                return NULL;
+            }
+
+            Expr *right = ast_new_ident_expr(member);
             Span span = span_merge(p->lexer.span_interner, left->span, right->span);
 
             return ast_new_access_expr(span, left, right);
@@ -936,7 +970,7 @@ int32_t parser_inner_sync(Parser *p) {
             return pos;
         }
 
-        if (peek.ty == TOKEN_LET || peek.ty == TOKEN_FN) {
+        if (peek.ty == TOKEN_LET || peek.ty == TOKEN_FN || peek.ty == TOKEN_INLINE || peek.ty == TOKEN_NOINLINE) {
             return pos;
         }
 
@@ -977,6 +1011,24 @@ ParseError parser_create_statement_error(Parser *p, int32_t start, int32_t end)
     return parser_create_error(span, error_err2str(ERROR_COULD_NOT_PARSE_STMT, len, source_code(&p->lexer.source) + start));
 }
 
+// the lexer only accepts decimal digits
+int64_t parser_parse_int(Parser *p, Token *token) {
+    int32_t len = lexer_token_len(token, p->lexer.span_interner);
+    int64_t value = 0;
+    int32_t i = 0;
+
+    while (i < len) {
+        if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, token->lexeme[i] - '0', &value)) {
+            parser_push_err(p, parser_create_error(token->span, error_err2str(ERROR_INT_LIT_OVERFLOW, len, token->lexeme)));
+            return 0;
+        }
+
+        i++;
+    }
+
+    return value;
+}
+
 ParseError parser_create_lex_error(Parser *p, Token *next) {
     int32_t len = lexer_token_len(next, p->lexer.span_interner);
     ErrorCode err_ty = ERROR_UNKNOWN_SYMBOL;
@@ -0,0 +1,258 @@
+#include <string.h>
+
+#include "../include/pass.h"
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+
+#define PASS_HASH_PRIME 0x100000001b3ull
+
+PassManager pass_manager_create(IrModule *m, Pool *pool) {
+    PassManager pm = {
+        .m = m,
+        .pool = pool,
+        .passes = vec_create(sizeof(Pass)),
+        .workers = (PassWorker *) calloc(pool->num_workers, sizeof(PassWorker)),
+        .order = NULL,
+        .num_order = 0,
+        .pass = NULL
+    };
+
+    return pm;
+}
+
+void pass_manager_free(PassManager *pm) {
+    uint32_t i = 0;
+    while (i < pm->pool->num_workers) {
+        free((void *) pm->workers[i].before);
+        free((void *) pm->workers[i].after);
+        i++;
+    }
+
+    free((void *) pm->workers);
+    free((void *) pm->order);
+    vec_free(&pm->passes);
+}
+
+void pass_manager_add(PassManager *pm, Pass pass) {
+    vec_push(&pm->passes, (void *) &pass);
+}
+
+uint64_t pass_hash(uint64_t h, uint64_t x) {
+    return (h ^ x) * PASS_HASH_PRIME;
+}
+
+void pass_fingerprint(IrFunc *f, uint64_t *hashes) {
+    memset((void *) hashes, 0, f->num_insts * sizeof(uint64_t));
+
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint64_t h = pass_hash(PASS_HASH_PRIME, b);
+            uint32_t j = 0;
+
+            h = pass_hash(h, ((uint64_t) inst->op << 32) | ((uint64_t) inst->ty << 16) | inst->flags);
+            h = pass_hash(h, (uint64_t) inst->imm);
+
+            while (j < inst->num_ops) {
+                h = pass_hash(h, ops[j]);
+                j++;
+            }
+
+            // 0 is left for the values in no block
+            hashes[v] = h | 1;
+            i++;
+        }
+
+        b++;
+    }
+}
+
+int64_t pass_count_changed(uint64_t *before, uint32_t num_before, uint64_t *after, uint32_t num_after) {
+    uint32_t n = num_before > num_after ? num_before : num_after;
+    int64_t changed = 0;
+    uint32_t v = 0;
+
+    while (v < n) {
+        changed += (v < num_before ? before[v] : 0) != (v < num_after ? after[v] : 0);
+        v++;
+    }
+
+    return changed;
+}
+
+void pass_reserve(PassWorker *w, uint32_t num_insts) {
+    if (num_insts > w->cap_insts) {
+        w->cap_insts = num_insts * 2;
+        w->before = (uint64_t *) realloc((void *) w->before, w->cap_insts * sizeof(uint64_t));
+        w->after = (uint64_t *) realloc((void *) w->after, w->cap_insts * sizeof(uint64_t));
+    }
+}
+
+bool pass_is_defined(IrFunc *f) {
+    return (f->flags & IR_FUNC_EXTERN) == 0 && f->num_blocks > 0;
+}
+
+int32_t pass_compare_order(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return x < y ? -1 : (x > y);
+}
+
+void pass_func_task(void *ctx, uint32_t worker, uint32_t i) {
+    PassManager *pm = (PassManager *) ctx;
+    PassWorker *w = &pm->workers[worker];
+    const Pass *pass = pm->pass;
+    IrFunc *f = ir_module_func(pm->m, (uint32_t) pm->order[i]);
+    uint32_t num_before = f->num_insts;
+    int32_t tt = TIMETRACE_BEGIN(pass->name, 0, NULL, (int32_t) strlen(f->name), f->name);
+
+    if (timer_enabled) {
+        pass_reserve(w, num_before);
+        pass_fingerprint(f, w->before);
+    }
+
+    bool changed = pass->run_func(w->state, f);
+
+    if (timer_enabled) {
+        pass_reserve(w, f->num_insts);
+        pass_fingerprint(f, w->after);
+
+        int64_t num_changed = pass_count_changed(w->before, num_before, w->after, f->num_insts);
+        w->num_funcs += num_changed > 0;
+        w->num_insts += num_changed;
+        changed = changed || num_changed > 0;
+    }
+
+    if (changed) {
+        ir_func_invalidate(f, ~pass->preserves);
+    }
+
+    TIMETRACE_END(tt);
+}
+
+void pass_run_func(PassManager *pm, const Pass *pass) {
+    uint32_t n = ir_module_num_funcs(pm->m);
+    uint32_t i = 0;
+
+    pm->order = (uint64_t *) realloc((void *) pm->order, (n + 1) * sizeof(uint64_t));
+    pm->num_order = 0;
+
+    // the size goes in the upper half so sorting puts the largest first, the index breaks ties
+    while (i < n) {
+        IrFunc *f = ir_module_func(pm->m, i);
+
+        if (pass_is_defined(f)) {
+            pm->order[pm->num_order++] = ((uint64_t) (UINT32_MAX - f->num_insts) << 32) | i;
+        }
+
+        i++;
+    }
+
+    if (pm->pool->num_workers > 1) {
+        qsort((void *) pm->order, pm->num_order, sizeof(uint64_t), pass_compare_order);
+    }
+
+    i = 0;
+    while (i < pm->pool->num_workers) {
+        pm->workers[i].state = pass->create(pm->m, pass->params);
+        pm->workers[i].num_funcs = 0;
+        pm->workers[i].num_insts = 0;
+        i++;
+    }
+
+    pm->pass = pass;
+    pool_run(pm->pool, pm->num_order, pass_func_task, (void *) pm);
+
+    // the statistics add up the same in whatever order the workers took the functions
+    i = 0;
+    while (i < pm->pool->num_workers) {
+        pass->finish(pm->workers[i].state);
+        pm->workers[0].num_funcs += i > 0 ? pm->workers[i].num_funcs : 0;
+        pm->workers[0].num_insts += i > 0 ? pm->workers[i].num_insts : 0;
+        i++;
+    }
+}
+
+void pass_run_module(PassManager *pm, const Pass *pass) {
+    uint32_t n = ir_module_num_funcs(pm->m);
+    uint64_t **before = NULL;
+    uint32_t *num_before = NULL;
+    PassWorker *w = &pm->workers[0];
+    uint32_t i = 0;
+
+    w->num_funcs = 0;
+    w->num_insts = 0;
+
+    if (timer_enabled) {
+        before = (uint64_t **) calloc(n + 1, sizeof(uint64_t *));
+        num_before = (uint32_t *) calloc(n + 1, sizeof(uint32_t));
+
+        while (i < n) {
+            IrFunc *f = ir_module_func(pm->m, i);
+
+            num_before[i] = f->num_insts;
+            before[i] = (uint64_t *) malloc((f->num_insts + 1) * sizeof(uint64_t));
+            pass_fingerprint(f, before[i]);
+            i++;
+        }
+    }
+
+    pass->run_module(pm->m, pass->params);
+
+    // the functions the pass added have nothing cached yet
+    i = 0;
+    while (i < n) {
+        IrFunc *f = ir_module_func(pm->m, i);
+        bool changed = true;
+
+        if (timer_enabled) {
+            pass_reserve(w, f->num_insts);
+            pass_fingerprint(f, w->after);
+
+            int64_t num_changed = pass_count_changed(before[i], num_before[i], w->after, f->num_insts);
+            w->num_funcs += num_changed > 0;
+            w->num_insts += num_changed;
+            changed = num_changed > 0;
+            free((void *) before[i]);
+        }
+
+        if (changed) {
+            ir_func_invalidate(f, ~pass->preserves);
+        }
+
+        i++;
+    }
+
+    free((void *) before);
+    free((void *) num_before);
+}
+
+void pass_manager_run(PassManager *pm) {
+    uint32_t i = 0;
+
+    while (i < pm->passes.len) {
+        const Pass *pass = (const Pass *) vec_get_ptr(&pm->passes, i);
+        int32_t tt = TIMETRACE_BEGIN(pass->name, 0, NULL, 0, NULL);
+        uint64_t start = timer_enabled ? timer_now_ns() : 0;
+
+        if (pass->kind == PASS_MODULE) {
+            pass_run_module(pm, pass);
+        } else {
+            pass_run_func(pm, pass);
+        }
+
+        if (timer_enabled) {
+            timer_pass_add(pass->name, timer_now_ns() - start, pm->workers[0].num_funcs, pm->workers[0].num_insts);
+        }
+
+        TIMETRACE_END(tt);
+        i++;
+    }
+}
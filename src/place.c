@@ -0,0 +1,740 @@
+#include <string.h>
+
+#include "../include/place.h"
+#include "../include/trace.h"
+
+// the C library functions that never return, everything else that does not is found from its blocks
+static char const *const place_no_return_externs[] = {
+    "exit",
+    "_exit",
+    "_Exit",
+    "abort",
+    "quick_exit",
+    "__assert_fail"
+};
+
+bool place_is_no_return_extern(IrFunc *f) {
+    size_t i = 0;
+
+    while (i < sizeof(place_no_return_externs) / sizeof(char *)) {
+        if (strcmp(f->name, place_no_return_externs[i]) == 0) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+bool place_calls_no_return(Place *p, IrFunc *f, IrBlockId b) {
+    IrBlock *block = &f->blocks[b];
+    uint32_t i = 0;
+
+    if (p->num_no_return == 0) {
+        return false;
+    }
+
+    while (i < block->num_insts) {
+        IrInst *inst = &f->insts[block->insts[i]];
+
+        if (inst->op == IR_CALL && p->no_return[inst->imm]) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+bool place_has_return(IrFunc *f) {
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrValue term = ir_block_terminator(f, b);
+
+        if (term != IR_NO_VALUE && f->insts[term].op == IR_RET) {
+            return true;
+        }
+
+        b++;
+    }
+
+    return false;
+}
+
+// whether every block returning from f calls a function that does not return first
+bool place_never_returns(Place *p, IrFunc *f) {
+    IrBlockId b = 0;
+
+    if ((f->flags & IR_FUNC_EXTERN) != 0 || f->num_blocks == 0) {
+        return false;
+    }
+
+    while (b < f->num_blocks) {
+        IrValue term = ir_block_terminator(f, b);
+
+        if (term != IR_NO_VALUE && f->insts[term].op == IR_RET && !place_calls_no_return(p, f, b)) {
+            return false;
+        }
+
+        b++;
+    }
+
+    return true;
+}
+
+// an edge from every function called in a returning block of f back to f, the calls in other blocks do not
+// decide whether f returns
+void place_add_calls(Place *p, IrFunc *f) {
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        IrValue term = ir_block_terminator(f, b);
+        uint32_t i = 0;
+
+        while (term != IR_NO_VALUE && f->insts[term].op == IR_RET && i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            i++;
+
+            if (inst->op == IR_CALL) {
+                PlaceEdge e = { .from = (uint32_t) inst->imm, .to = f->idx, .weight = 0, .seq = 0 };
+                vec_push(&p->edges, (void *) &e);
+            }
+        }
+
+        b++;
+    }
+}
+
+// a function does not return when every block returning from it calls one that does not first. the functions
+// that do not return by themselves are the externs known not to and those without a return, and each function
+// found sends its callers to be looked at again. the callers are only collected when there is one at all
+void place_find_no_return(Place *p) {
+    IrModule *m = p->m;
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    Vec work = vec_create(sizeof(uint32_t));
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if (!p->no_return[i] && (f->flags & IR_FUNC_EXTERN) == 0 && f->num_blocks > 0 && !place_has_return(f)) {
+            p->no_return[i] = true;
+        }
+
+        if (p->no_return[i]) {
+            vec_push(&work, (void *) &i);
+        }
+
+        i++;
+    }
+
+    p->num_no_return = work.len;
+
+    if (work.len == 0) {
+        vec_free(&work);
+        return;
+    }
+
+    i = 0;
+    p->edges.len = 0;
+
+    while (i < num_funcs) {
+        place_add_calls(p, ir_module_func(m, i));
+        i++;
+    }
+
+    // the callers of every function in one array, counted first and then filled back to front
+    uint32_t *caller_off = (uint32_t *) calloc(num_funcs + 1, sizeof(uint32_t));
+    uint32_t *callers = (uint32_t *) malloc((p->edges.len + 1) * sizeof(uint32_t));
+    PlaceEdge *edges = (PlaceEdge *) p->edges.elements;
+
+    i = 0;
+    while (i < p->edges.len) {
+        caller_off[edges[i].from]++;
+        i++;
+    }
+
+    i = 0;
+    while (i < num_funcs) {
+        total += caller_off[i];
+        caller_off[i] = total;
+        i++;
+    }
+
+    caller_off[num_funcs] = total;
+    i = 0;
+
+    while (i < p->edges.len) {
+        callers[--caller_off[edges[i].from]] = edges[i].to;
+        i++;
+    }
+
+    while (work.len > 0) {
+        uint32_t callee = ((uint32_t *) work.elements)[--work.len];
+        uint32_t k = caller_off[callee];
+
+        while (k < caller_off[callee + 1]) {
+            uint32_t caller = callers[k++];
+
+            if (!p->no_return[caller] && place_never_returns(p, ir_module_func(m, caller))) {
+                p->no_return[caller] = true;
+                p->num_no_return++;
+                vec_push(&work, (void *) &caller);
+            }
+        }
+    }
+
+    free((void *) caller_off);
+    free((void *) callers);
+    vec_free(&work);
+}
+
+Place place_create(IrModule *m) {
+    Place p;
+    memset((void *) &p, 0, sizeof(Place));
+
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t i = 0;
+
+    p.m = m;
+    p.no_return = (bool *) calloc(num_funcs + 1, sizeof(bool));
+    p.cluster = (uint32_t *) malloc((num_funcs + 1) * sizeof(uint32_t));
+    p.func_next = (uint32_t *) malloc((num_funcs + 1) * sizeof(uint32_t));
+    p.func_tail = (uint32_t *) malloc((num_funcs + 1) * sizeof(uint32_t));
+    p.cluster_insts = (int64_t *) malloc((num_funcs + 1) * sizeof(int64_t));
+    p.cluster_hotness = (int64_t *) malloc((num_funcs + 1) * sizeof(int64_t));
+    p.edges = vec_create(sizeof(PlaceEdge));
+    p.heads = vec_create(sizeof(PlaceCluster));
+
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+        p.no_return[i] = (f->flags & IR_FUNC_EXTERN) != 0 && place_is_no_return_extern(f);
+        i++;
+    }
+
+    place_find_no_return(&p);
+
+    return p;
+}
+
+// block placement keeps its state per function, so another thread places blocks with a copy of the per function
+// results place_create found and arrays of its own
+Place place_fork(Place *p) {
+    Place q;
+    memset((void *) &q, 0, sizeof(Place));
+
+    uint32_t num_funcs = ir_module_num_funcs(p->m);
+
+    q.m = p->m;
+    q.no_return = (bool *) malloc((num_funcs + 1) * sizeof(bool));
+    memcpy((void *) q.no_return, (void *) p->no_return, num_funcs * sizeof(bool));
+    q.num_no_return = p->num_no_return;
+    q.edges = vec_create(sizeof(PlaceEdge));
+    q.heads = vec_create(sizeof(PlaceCluster));
+
+    return q;
+}
+
+void place_free(Place *p) {
+    free((void *) p->no_return);
+    free((void *) p->cluster);
+    free((void *) p->func_next);
+    free((void *) p->func_tail);
+    free((void *) p->cluster_insts);
+    free((void *) p->cluster_hotness);
+    free((void *) p->cold);
+    free((void *) p->rpo_idx);
+    free((void *) p->chain);
+    free((void *) p->next);
+    free((void *) p->tail);
+    vec_free(&p->edges);
+    vec_free(&p->heads);
+}
+
+void place_reserve(Place *p, IrFunc *f) {
+    if (f->num_blocks <= p->cap_blocks) {
+        return;
+    }
+
+    p->cap_blocks = f->num_blocks * 2;
+    p->cold = (bool *) realloc((void *) p->cold, p->cap_blocks * sizeof(bool));
+    p->rpo_idx = (int32_t *) realloc((void *) p->rpo_idx, p->cap_blocks * sizeof(int32_t));
+    p->chain = (IrBlockId *) realloc((void *) p->chain, p->cap_blocks * sizeof(IrBlockId));
+    p->next = (IrBlockId *) realloc((void *) p->next, p->cap_blocks * sizeof(IrBlockId));
+    p->tail = (IrBlockId *) realloc((void *) p->tail, p->cap_blocks * sizeof(IrBlockId));
+}
+
+bool place_func_is_cold(IrFunc *f) {
+    return (f->flags & IR_FUNC_PROFILED) != 0 && f->num_blocks > 0 && f->blocks[0].freq == 0;
+}
+
+bool place_is_negative_const(IrFunc *f, IrValue v) {
+    IrInst *inst = &f->insts[v];
+    return inst->op == IR_CONST && inst->ty != IR_TYPE_I1 && ir_type_is_int(inst->ty) && inst->imm < 0;
+}
+
+// an error return hands back a negative constant, either itself or through a phi of the block returning
+void place_seed_error_returns(Place *p, IrFunc *f, IrBlockId b) {
+    IrValue term = ir_block_terminator(f, b);
+    IrInst *ret = &f->insts[term];
+
+    if (ret->op != IR_RET || ret->num_ops == 0) {
+        return;
+    }
+
+    IrValue v = ret->u.ops[0];
+    IrInst *phi = &f->insts[v];
+
+    if (place_is_negative_const(f, v)) {
+        p->cold[b] = true;
+        return;
+    }
+
+    if (phi->op != IR_PHI || phi->block != b) {
+        return;
+    }
+
+    IrValue *ops = ir_inst_ops(f, phi);
+    uint32_t k = 0;
+
+    // the edges into a block are split when they are critical, so a pred ending in anything but a jump here
+    // has this block as its only successor already
+    while (k < f->blocks[b].num_preds) {
+        IrBlockId pred = f->blocks[b].preds[k];
+
+        if (place_is_negative_const(f, ops[k]) && f->blocks[pred].num_succs == 1 && pred != 0) {
+            p->cold[pred] = true;
+        }
+
+        k++;
+    }
+}
+
+bool place_all_cold(Place *p, IrBlockId *blocks, uint32_t n) {
+    uint32_t i = 0;
+
+    while (i < n) {
+        if (!p->cold[blocks[i]] && p->rpo_idx[blocks[i]] >= 0) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return n > 0;
+}
+
+// a block is cold when every block it leads to is, or every block leading to it is
+void place_static_cold(Place *p, IrFunc *f, uint32_t *order, uint32_t num_order) {
+    bool changed = true;
+    uint32_t i = 1;
+
+    while (i < num_order) {
+        IrBlockId b = order[i];
+        IrValue term = ir_block_terminator(f, b);
+
+        if (term != IR_NO_VALUE && f->insts[term].op == IR_UNREACHABLE) {
+            p->cold[b] = true;
+        } else if (place_calls_no_return(p, f, b)) {
+            p->cold[b] = true;
+        }
+
+        if (term != IR_NO_VALUE) {
+            place_seed_error_returns(p, f, b);
+        }
+
+        i++;
+    }
+
+    p->cold[0] = false;
+
+    while (changed) {
+        changed = false;
+        i = num_order;
+
+        while (i > 1) {
+            IrBlockId b = order[--i];
+
+            if (!p->cold[b] && place_all_cold(p, f->blocks[b].succs, f->blocks[b].num_succs)) {
+                p->cold[b] = true;
+                changed = true;
+            }
+        }
+
+        i = 1;
+        while (i < num_order) {
+            IrBlockId b = order[i++];
+
+            if (!p->cold[b] && place_all_cold(p, f->blocks[b].preds, f->blocks[b].num_preds)) {
+                p->cold[b] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+int32_t place_cmp_edges(const void *a, const void *b) {
+    const PlaceEdge *x = (const PlaceEdge *) a;
+    const PlaceEdge *y = (const PlaceEdge *) b;
+
+    if (x->weight != y->weight) {
+        return x->weight > y->weight ? -1 : 1;
+    }
+
+    return x->seq < y->seq ? -1 : (x->seq > y->seq ? 1 : 0);
+}
+
+void place_sort_edges(Place *p, int32_t (*cmp)(const void *, const void *)) {
+    if (p->edges.len > 1) {
+        qsort(p->edges.elements, p->edges.len, sizeof(PlaceEdge), cmp);
+    }
+}
+
+void place_add_edge(Place *p, uint32_t from, uint32_t to, int64_t weight) {
+    PlaceEdge e = {
+        .from = from,
+        .to = to,
+        .weight = weight,
+        .seq = (uint32_t) p->edges.len
+    };
+
+    vec_push(&p->edges, (void *) &e);
+}
+
+// after critical edges are split an edge either leaves a block with one successor or enters one with one pred,
+// so the count of that block is the count of the edge
+void place_chain_blocks(Place *p, IrFunc *f, uint32_t *order, uint32_t num_order) {
+    uint32_t i = 0;
+
+    p->edges.len = 0;
+
+    while (i < num_order) {
+        IrBlockId b = order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t s = 0;
+
+        p->chain[b] = b;
+        p->next[b] = IR_NO_BLOCK;
+        p->tail[b] = b;
+
+        while (!p->cold[b] && s < block->num_succs) {
+            IrBlockId to = block->succs[s];
+            int64_t weight = block->num_succs == 1 ? block->freq : f->blocks[to].freq;
+
+            if (!p->cold[to] && to != 0 && to != b) {
+                place_add_edge(p, b, to, weight);
+            }
+
+            s++;
+        }
+
+        i++;
+    }
+
+    place_sort_edges(p, place_cmp_edges);
+    i = 0;
+
+    // an edge joins two chains when it leaves the end of one and enters the start of the other
+    while (i < p->edges.len) {
+        PlaceEdge *e = (PlaceEdge *) vec_get_ptr(&p->edges, i);
+        IrBlockId a = p->chain[e->from];
+        IrBlockId c = p->chain[e->to];
+        i++;
+
+        if (a == c || p->tail[a] != e->from || c != e->to) {
+            continue;
+        }
+
+        IrBlockId x = c;
+        while (x != IR_NO_BLOCK) {
+            p->chain[x] = a;
+            x = p->next[x];
+        }
+
+        p->next[e->from] = c;
+        p->tail[a] = p->tail[c];
+        p->num_chained++;
+    }
+}
+
+uint32_t place_blocks(Place *p, IrFunc *f, uint32_t *order, uint32_t num_order) {
+    uint32_t *out = (uint32_t *) malloc((num_order + 1) * sizeof(uint32_t));
+    uint32_t num_hot = 0;
+    uint32_t n = 0;
+    uint32_t i = 0;
+
+    place_reserve(p, f);
+    p->num_blocks += num_order;
+
+    if (place_func_is_cold(f)) {
+        p->num_cold_blocks += num_order;
+        p->num_cold_funcs++;
+        free((void *) out);
+
+        return 0;
+    }
+
+    while (i < f->num_blocks) {
+        p->cold[i] = false;
+        p->rpo_idx[i] = -1;
+        i++;
+    }
+
+    i = 0;
+    while (i < num_order) {
+        p->rpo_idx[order[i]] = (int32_t) i;
+        i++;
+    }
+
+    bool is_profiled = (f->flags & IR_FUNC_PROFILED) != 0;
+
+    i = 1;
+    while (is_profiled && i < num_order) {
+        p->cold[order[i]] = f->blocks[order[i]].freq == 0;
+        i++;
+    }
+
+    if (!is_profiled) {
+        place_static_cold(p, f, order, num_order);
+    }
+
+    // the chains go in the order of their first blocks, so the entry's chain comes first. without a profile
+    // every block is its own chain
+    if (is_profiled) {
+        place_chain_blocks(p, f, order, num_order);
+    }
+
+    i = 0;
+    while (i < num_order) {
+        IrBlockId b = order[i++];
+
+        if (p->cold[b] || (is_profiled && p->chain[b] != b)) {
+            continue;
+        }
+
+        IrBlockId x = b;
+        while (x != IR_NO_BLOCK) {
+            out[n++] = x;
+            x = is_profiled ? p->next[x] : IR_NO_BLOCK;
+        }
+    }
+
+    num_hot = n;
+    i = 0;
+
+    while (i < num_order) {
+        if (p->cold[order[i]]) {
+            out[n++] = order[i];
+        }
+
+        i++;
+    }
+
+    memcpy((void *) order, (void *) out, num_order * sizeof(uint32_t));
+    free((void *) out);
+
+    p->num_cold_blocks += num_order - num_hot;
+
+    if (num_hot < num_order) {
+        TRACE_DEBUG(TRACE_CAT_PLACE, "%s: %u of %u blocks cold%s", f->name, num_order - num_hot, num_order,
+            is_profiled ? " under the profile" : "");
+    }
+
+    return num_hot;
+}
+
+int32_t place_cmp_calls(const void *a, const void *b) {
+    const PlaceEdge *x = (const PlaceEdge *) a;
+    const PlaceEdge *y = (const PlaceEdge *) b;
+
+    if (x->from != y->from) {
+        return x->from < y->from ? -1 : 1;
+    }
+
+    if (x->to != y->to) {
+        return x->to < y->to ? -1 : 1;
+    }
+
+    return x->seq < y->seq ? -1 : (x->seq > y->seq ? 1 : 0);
+}
+
+// one edge per caller and callee, weighing the times the calls ran under the profile or else the call sites
+void place_call_graph(Place *p) {
+    IrModule *m = p->m;
+    uint32_t i = 0;
+
+    p->edges.len = 0;
+
+    while (i < ir_module_num_funcs(m)) {
+        IrFunc *f = ir_module_func(m, i);
+        bool is_profiled = (f->flags & IR_FUNC_PROFILED) != 0;
+        IrBlockId b = 0;
+
+        while ((f->flags & IR_FUNC_EXTERN) == 0 && b < f->num_blocks) {
+            IrBlock *block = &f->blocks[b];
+            uint32_t j = 0;
+
+            while (j < block->num_insts) {
+                IrInst *inst = &f->insts[block->insts[j]];
+                IrFunc *callee = inst->op == IR_CALL ? ir_module_func(m, (uint32_t) inst->imm) : NULL;
+
+                if (callee != NULL && (callee->flags & IR_FUNC_EXTERN) == 0 && callee != f) {
+                    place_add_edge(p, i, (uint32_t) inst->imm, is_profiled ? block->freq : 1);
+                }
+
+                j++;
+            }
+
+            b++;
+        }
+
+        i++;
+    }
+
+    place_sort_edges(p, place_cmp_calls);
+
+    uint32_t n = 0;
+    i = 0;
+
+    while (i < p->edges.len) {
+        PlaceEdge *e = (PlaceEdge *) vec_get_ptr(&p->edges, i);
+        PlaceEdge *last = n > 0 ? (PlaceEdge *) vec_get_ptr(&p->edges, n - 1) : NULL;
+
+        if (last != NULL && last->from == e->from && last->to == e->to) {
+            last->weight += e->weight;
+        } else {
+            PlaceEdge copy = *e;
+            copy.seq = n;
+            *(PlaceEdge *) vec_get_ptr(&p->edges, n++) = copy;
+        }
+
+        i++;
+    }
+
+    p->edges.len = n;
+    place_sort_edges(p, place_cmp_edges);
+}
+
+int32_t place_func_insts(IrFunc *f) {
+    int32_t n = 0;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        n += (int32_t) f->blocks[b].num_insts;
+        b++;
+    }
+
+    return n;
+}
+
+// hotter clusters first, then the one holding the function declared first
+int32_t place_cmp_clusters(const void *a, const void *b) {
+    const PlaceCluster *x = (const PlaceCluster *) a;
+    const PlaceCluster *y = (const PlaceCluster *) b;
+
+    if (x->hotness != y->hotness) {
+        return x->hotness > y->hotness ? -1 : 1;
+    }
+
+    return x->head < y->head ? -1 : (x->head > y->head ? 1 : 0);
+}
+
+uint32_t place_funcs(Place *p, uint32_t *order) {
+    IrModule *m = p->m;
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t n = 0;
+    uint32_t i = 0;
+
+    // every function starts as its own cluster, named after its first function
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+
+        p->cluster[i] = i;
+        p->func_next[i] = PLACE_NONE;
+        p->func_tail[i] = i;
+        p->cluster_insts[i] = (f->flags & IR_FUNC_EXTERN) != 0 ? 0 : place_func_insts(f);
+        p->cluster_hotness[i] = (f->flags & IR_FUNC_PROFILED) != 0 && f->num_blocks > 0 ? f->blocks[0].freq : 0;
+        i++;
+    }
+
+    place_call_graph(p);
+    i = 0;
+
+    // the callee's cluster goes right after its caller's, heaviest edges first
+    while (i < p->edges.len) {
+        PlaceEdge *e = (PlaceEdge *) vec_get_ptr(&p->edges, i);
+        uint32_t a = p->cluster[e->from];
+        uint32_t c = p->cluster[e->to];
+        i++;
+
+        if (a == c || place_func_is_cold(ir_module_func(m, e->to)) || place_func_is_cold(ir_module_func(m, e->from))) {
+            continue;
+        }
+
+        if (p->cluster_insts[a] + p->cluster_insts[c] > PLACE_MAX_CLUSTER_INSTS) {
+            continue;
+        }
+
+        uint32_t x = c;
+        while (x != PLACE_NONE) {
+            p->cluster[x] = a;
+            x = p->func_next[x];
+        }
+
+        p->func_next[p->func_tail[a]] = c;
+        p->func_tail[a] = p->func_tail[c];
+        p->cluster_insts[a] += p->cluster_insts[c];
+        p->cluster_hotness[a] = p->cluster_hotness[c] > p->cluster_hotness[a] ? p->cluster_hotness[c] : p->cluster_hotness[a];
+        p->num_clustered++;
+    }
+
+    p->heads.len = 0;
+    i = 0;
+
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if (p->cluster[i] == i && (f->flags & IR_FUNC_EXTERN) == 0) {
+            PlaceCluster cl = { .hotness = p->cluster_hotness[i], .head = i };
+            vec_push(&p->heads, (void *) &cl);
+        }
+
+        i++;
+    }
+
+    if (p->heads.len > 1) {
+        qsort(p->heads.elements, p->heads.len, sizeof(PlaceCluster), place_cmp_clusters);
+    }
+
+    int32_t pass = 0;
+
+    // the functions that never ran go last, their code is cold anyway
+    while (pass < 2) {
+        i = 0;
+
+        while (i < p->heads.len) {
+            uint32_t x = ((PlaceCluster *) p->heads.elements)[i].head;
+
+            while (x != PLACE_NONE) {
+                IrFunc *f = ir_module_func(m, x);
+
+                if ((f->flags & IR_FUNC_EXTERN) == 0 && place_func_is_cold(f) == (pass == 1)) {
+                    order[n++] = x;
+                }
+
+                x = p->func_next[x];
+            }
+
+            i++;
+        }
+
+        pass++;
+    }
+
+    return n;
+}
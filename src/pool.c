@@ -0,0 +1,167 @@
+#include <unistd.h>
+
+#include "../include/pool.h"
+#include "../include/timetrace.h"
+
+uint32_t pool_num_cpus() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (uint32_t) n : 1;
+}
+
+// takes the first task left in the worker's range, or the last one for a thief. k is its position in the range
+bool pool_take(PoolWorker *w, bool front, uint32_t *k) {
+    uint64_t range = atomic_load_explicit(&w->range, memory_order_relaxed);
+
+    while (true) {
+        uint32_t lo = (uint32_t) range;
+        uint32_t hi = (uint32_t) (range >> 32);
+
+        if (lo >= hi) {
+            return false;
+        }
+
+        uint64_t rest = front ? POOL_RANGE(lo + 1, hi) : POOL_RANGE(lo, hi - 1);
+
+        if (atomic_compare_exchange_weak_explicit(&w->range, &range, rest, memory_order_relaxed, memory_order_relaxed)) {
+            *k = front ? lo : hi - 1;
+            return true;
+        }
+    }
+}
+
+// ranges only shrink during a batch, so once every other worker's is seen empty the batch is all taken
+void pool_drain(Pool *p, uint32_t worker) {
+    uint32_t n = p->num_workers;
+    uint32_t victim = worker;
+    uint32_t num_empty = 0;
+    uint32_t k = 0;
+
+    while (pool_take(&p->workers[worker], true, &k)) {
+        p->task(p->ctx, worker, worker + k * n);
+    }
+
+    while (num_empty + 1 < n) {
+        victim = victim + 1 < n ? victim + 1 : 0;
+
+        if (victim == worker) {
+            continue;
+        }
+
+        while (pool_take(&p->workers[victim], false, &k)) {
+            p->task(p->ctx, worker, victim + k * n);
+        }
+
+        num_empty++;
+    }
+}
+
+void *pool_worker_main(void *arg) {
+    PoolWorker *w = (PoolWorker *) arg;
+    Pool *p = w->pool;
+    uint64_t seen = 0;
+
+    timetrace_set_thread_name("worker");
+
+    while (true) {
+        pthread_mutex_lock(&p->lock);
+
+        while (!p->stop && p->batch == seen) {
+            pthread_cond_wait(&p->start, &p->lock);
+        }
+
+        if (p->stop) {
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+
+        seen = p->batch;
+        pthread_mutex_unlock(&p->lock);
+
+        pool_drain(p, w->idx);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->num_busy == 0) {
+            pthread_cond_signal(&p->done);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+Pool *pool_create(uint32_t num_workers) {
+    Pool *p = (Pool *) calloc(1, sizeof(Pool));
+
+    p->num_workers = num_workers > 0 ? num_workers : 1;
+    p->workers = (PoolWorker *) calloc(p->num_workers, sizeof(PoolWorker));
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    uint32_t i = 1;
+    while (i < p->num_workers) {
+        p->workers[i].pool = p;
+        p->workers[i].idx = i;
+
+        // a pool that could not start all of its threads makes do with the ones it has
+        if (pthread_create(&p->workers[i].thread, NULL, pool_worker_main, (void *) &p->workers[i]) != 0) {
+            p->num_workers = i;
+            break;
+        }
+
+        i++;
+    }
+
+    return p;
+}
+
+void pool_free(Pool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->stop = true;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    uint32_t i = 1;
+    while (i < p->num_workers) {
+        pthread_join(p->workers[i].thread, NULL);
+        i++;
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    free((void *) p->workers);
+    free((void *) p);
+}
+
+void pool_run(Pool *p, uint32_t num_tasks, PoolTask task, void *ctx) {
+    p->task = task;
+    p->ctx = ctx;
+    p->num_tasks = num_tasks;
+
+    uint32_t i = 0;
+    while (i < p->num_workers) {
+        uint32_t num_owned = i < num_tasks ? (num_tasks - i + p->num_workers - 1) / p->num_workers : 0;
+
+        atomic_store_explicit(&p->workers[i].range, POOL_RANGE(0, num_owned), memory_order_relaxed);
+        i++;
+    }
+
+    if (p->num_workers == 1 || num_tasks <= 1) {
+        pool_drain(p, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->num_busy = p->num_workers - 1;
+    p->batch++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    pool_drain(p, 0);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->num_busy > 0) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,422 @@
+#include <errno.h>
+#include <string.h>
+
+#include "../include/profile.h"
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+
+#define PROFILE_GLOBAL "__synthium_profile"
+#define PROFILE_WRITER "__synthium_profile_write"
+
+// 64 bit FNV-1a
+uint64_t profile_hash(uint64_t h, const void *data, size_t len) {
+    const uint8_t *bytes = (const uint8_t *) data;
+    size_t i = 0;
+
+    while (i < len) {
+        h ^= bytes[i];
+        h *= 0x100000001b3ull;
+        i++;
+    }
+
+    return h;
+}
+
+// the shape of a function is its number of blocks and the successors of each, a changed body that keeps it
+// keeps its profile too
+uint64_t profile_func_hash(IrFunc *f) {
+    uint64_t h = profile_hash(f->name_hash, (void *) &f->num_blocks, sizeof(uint32_t));
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+
+        h = profile_hash(h, (void *) &block->num_succs, sizeof(uint32_t));
+        h = profile_hash(h, (void *) block->succs, block->num_succs * sizeof(IrBlockId));
+        b++;
+    }
+
+    return h;
+}
+
+uint32_t profile_num_counters(IrFunc *f) {
+    uint32_t n = 1;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        n += f->blocks[b].num_succs;
+        b++;
+    }
+
+    return n;
+}
+
+bool profile_is_defined(IrFunc *f) {
+    return (f->flags & IR_FUNC_EXTERN) == 0 && f->num_blocks > 0;
+}
+
+uint32_t profile_first_non_phi(IrFunc *f, IrBlockId b) {
+    uint32_t i = 0;
+
+    while (i < f->blocks[b].num_insts && f->insts[f->blocks[b].insts[i]].op == IR_PHI) {
+        i++;
+    }
+
+    return i;
+}
+
+// the builder only appends, so what it appended to b since first is moved to pos afterwards
+void profile_move_to(IrFunc *f, IrBlockId b, uint32_t first, uint32_t pos) {
+    IrBlock *block = &f->blocks[b];
+    uint32_t moved[8];
+    uint32_t n = block->num_insts - first;
+
+    memcpy((void *) moved, (void *) (block->insts + first), n * sizeof(uint32_t));
+    memmove((void *) (block->insts + pos + n), (void *) (block->insts + pos), (first - pos) * sizeof(uint32_t));
+    memcpy((void *) (block->insts + pos), (void *) moved, n * sizeof(uint32_t));
+}
+
+void profile_increment(IrBuilder *bld, IrBlockId b, uint32_t pos, uint32_t global, uint32_t word) {
+    IrFunc *f = bld->func;
+    uint32_t first = f->blocks[b].num_insts;
+
+    ir_builder_set_block(bld, b);
+
+    IrValue at = ir_build_offset(bld, ir_build_global(bld, global), (int64_t) word * 8);
+    IrValue count = ir_build_load(bld, IR_TYPE_I64, at);
+    ir_build_store(bld, at, ir_build_binary(bld, IR_ADD, count, ir_build_const(bld, IR_TYPE_I64, 1)));
+
+    profile_move_to(f, b, first, pos);
+}
+
+// an edge out of a block with one successor is counted at the end of the block and an edge into a block with one
+// predecessor at its start, every other edge is split and counted in the new block
+void profile_instrument_func(IrModule *m, IrFunc *f, uint32_t global, uint32_t word) {
+    IrBuilder bld = ir_builder_create(m, f);
+    uint32_t num_blocks = f->num_blocks;
+    IrBlockId b = 0;
+
+    profile_increment(&bld, 0, f->blocks[0].num_insts - 1, global, word++);
+
+    while (b < num_blocks) {
+        uint32_t n = f->blocks[b].num_succs;
+        uint32_t i = 0;
+
+        while (i < n) {
+            IrBlockId s = f->blocks[b].succs[i];
+
+            if (n == 1) {
+                profile_increment(&bld, b, f->blocks[b].num_insts - 1, global, word);
+            } else if (f->blocks[s].num_preds == 1) {
+                profile_increment(&bld, s, profile_first_non_phi(f, s), global, word);
+            } else {
+                profile_increment(&bld, ir_split_edge(f, b, i), 0, global, word);
+            }
+
+            word++;
+            i++;
+        }
+
+        b++;
+    }
+}
+
+IrFunc *profile_extern(IrModule *m, const char *name, IrTypeId ret, IrTypeId *params, uint32_t num_params) {
+    IrFunc *f = ir_func_lookup(m, name, strlen(name));
+
+    if (f != NULL) {
+        return f;
+    }
+
+    return ir_func_create(m, name, strlen(name), ret, params, num_params, IR_FUNC_EXTERN);
+}
+
+// fills in the header words, which are known now, and writes the counters out in one piece. nothing is written
+// when the file can not be opened, the program's own exit code is left alone
+IrFunc *profile_build_writer(IrModule *m, uint32_t global, uint32_t *base, uint32_t *sizes, uint64_t *hashes, uint32_t num_words, const char *path) {
+    IrTypeId fopen_params[2] = { IR_TYPE_PTR, IR_TYPE_PTR };
+    IrTypeId fwrite_params[4] = { IR_TYPE_PTR, IR_TYPE_I64, IR_TYPE_I64, IR_TYPE_PTR };
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    IrFunc *fopen_f = profile_extern(m, "fopen", IR_TYPE_PTR, fopen_params, 2);
+    IrFunc *fwrite_f = profile_extern(m, "fwrite", IR_TYPE_I64, fwrite_params, 4);
+    IrFunc *fclose_f = profile_extern(m, "fclose", IR_TYPE_I32, fopen_params, 1);
+    IrFunc *f = ir_func_create(m, PROFILE_WRITER, strlen(PROFILE_WRITER), IR_TYPE_VOID, fopen_params, 0, IR_FUNC_NOINLINE);
+    IrBuilder bld = ir_builder_create(m, f);
+    IrBlockId entry = ir_block_create(f);
+    IrBlockId write = ir_block_create(f);
+    IrBlockId done = ir_block_create(f);
+    uint32_t num_profiled = 0;
+    uint32_t i = 0;
+
+    ir_builder_set_block(&bld, entry);
+
+    IrValue blob = ir_build_global(&bld, global);
+
+    while (i < num_funcs) {
+        if (base[i] != 0) {
+            IrValue at = ir_build_offset(&bld, blob, (int64_t) base[i] * 8);
+            IrValue n = ir_build_const(&bld, IR_TYPE_I64, sizes[i]);
+
+            ir_build_store(&bld, at, ir_build_const(&bld, IR_TYPE_I64, (int64_t) hashes[i]));
+            ir_build_store(&bld, ir_build_offset(&bld, at, 8), n);
+            num_profiled++;
+        }
+
+        i++;
+    }
+
+    ir_build_store(&bld, blob, ir_build_const(&bld, IR_TYPE_I64, (int64_t) PROFILE_MAGIC));
+    ir_build_store(&bld, ir_build_offset(&bld, blob, 8), ir_build_const(&bld, IR_TYPE_I64, num_profiled));
+
+    IrValue args[4];
+    args[0] = ir_build_str(&bld, ir_module_add_string(m, path, strlen(path)));
+    args[1] = ir_build_str(&bld, ir_module_add_string(m, "wb", 2));
+
+    IrValue file = ir_build_call(&bld, fopen_f->idx, args, 2);
+    IrValue addr = ir_build_cast(&bld, IR_PTR_TO_INT, IR_TYPE_I64, file);
+    ir_build_cbr(&bld, ir_build_cmp(&bld, IR_EQ, addr, ir_build_const(&bld, IR_TYPE_I64, 0)), done, write);
+
+    ir_builder_set_block(&bld, write);
+    args[0] = blob;
+    args[1] = ir_build_const(&bld, IR_TYPE_I64, 8);
+    args[2] = ir_build_const(&bld, IR_TYPE_I64, num_words);
+    args[3] = file;
+    ir_build_call(&bld, fwrite_f->idx, args, 4);
+    ir_build_call(&bld, fclose_f->idx, &file, 1);
+    ir_build_br(&bld, done);
+
+    ir_builder_set_block(&bld, done);
+    ir_build_ret(&bld, IR_NO_VALUE);
+
+    return f;
+}
+
+void profile_instrument_module(IrModule *m, const char *path) {
+    int32_t tt = TIMETRACE_BEGIN("profile instrumentation", 0, NULL, 0, NULL);
+    uint32_t num_funcs = ir_module_num_funcs(m);
+    uint32_t *base = (uint32_t *) calloc(num_funcs + 1, sizeof(uint32_t));
+    uint32_t *sizes = (uint32_t *) calloc(num_funcs + 1, sizeof(uint32_t));
+    uint64_t *hashes = (uint64_t *) calloc(num_funcs + 1, sizeof(uint64_t));
+    uint32_t num_words = 2;
+    uint32_t i = 0;
+
+    // the hashes and sizes are taken before any edge is split
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if (profile_is_defined(f)) {
+            base[i] = num_words;
+            sizes[i] = profile_num_counters(f);
+            hashes[i] = profile_func_hash(f);
+            num_words += 2 + sizes[i];
+        }
+
+        i++;
+    }
+
+    IrTypeId *fields = (IrTypeId *) malloc(num_words * sizeof(IrTypeId));
+    i = 0;
+
+    while (i < num_words) {
+        fields[i] = IR_TYPE_I64;
+        i++;
+    }
+
+    IrTypeId ty = ir_type_struct_declare(m, PROFILE_GLOBAL, strlen(PROFILE_GLOBAL));
+    ir_type_struct_define(m, ty, fields, num_words);
+    uint32_t global = ir_module_add_global(m, PROFILE_GLOBAL, strlen(PROFILE_GLOBAL), ty, IR_INIT_NONE, 0);
+    int64_t num_counters = 0;
+
+    i = 0;
+    while (i < num_funcs) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if (base[i] != 0) {
+            num_counters += sizes[i];
+            profile_instrument_func(m, f, global, base[i] + 2);
+        }
+
+        i++;
+    }
+
+    IrFunc *writer = profile_build_writer(m, global, base, sizes, hashes, num_words, path);
+    IrFunc *main_f = ir_func_lookup(m, "main", 4);
+    IrBlockId b = 0;
+
+    // main returning is the end of the program, there is nothing to hook a write into on exit() yet
+    while (main_f != NULL && profile_is_defined(main_f) && b < main_f->num_blocks) {
+        IrBuilder bld = ir_builder_create(m, main_f);
+        IrValue no_args[1] = { IR_NO_VALUE };
+        IrValue term = ir_block_terminator(main_f, b);
+        uint32_t first = main_f->blocks[b].num_insts;
+
+        if (term != IR_NO_VALUE && main_f->insts[term].op == IR_RET) {
+            IrValue tail = ir_block_tail_call(main_f, b);
+
+            // the profile is written once the call of a `become` in main returns, so it stays a call
+            if (tail != IR_NO_VALUE) {
+                main_f->insts[tail].flags &= ~IR_FLAG_MUST_TAIL;
+            }
+
+            ir_builder_set_block(&bld, b);
+            ir_build_call(&bld, writer->idx, no_args, 0);
+            profile_move_to(main_f, b, first, first - 1);
+        }
+
+        b++;
+    }
+
+    timer_stat_add("profile counters", num_counters);
+
+    free((void *) fields);
+    free((void *) hashes);
+    free((void *) sizes);
+    free((void *) base);
+    TIMETRACE_END(tt);
+}
+
+Profile profile_create() {
+    Profile p;
+    memset((void *) &p, 0, sizeof(Profile));
+
+    return p;
+}
+
+void profile_free(Profile *p) {
+    free((void *) p->words);
+    free((void *) p->funcs);
+}
+
+int profile_compare_funcs(const void *a, const void *b) {
+    uint64_t x = ((const ProfileFunc *) a)->hash;
+    uint64_t y = ((const ProfileFunc *) b)->hash;
+
+    return x < y ? -1 : x > y;
+}
+
+// the records are checked against the size of the file before any is used
+bool profile_parse(Profile *p) {
+    uint64_t at = 2;
+    uint32_t i = 0;
+
+    if (p->num_words < 2 || p->words[0] != PROFILE_MAGIC || p->words[1] > p->num_words / 2) {
+        return false;
+    }
+
+    p->num_funcs = (uint32_t) p->words[1];
+    p->funcs = (ProfileFunc *) malloc((p->num_funcs + 1) * sizeof(ProfileFunc));
+
+    while (i < p->num_funcs) {
+        if (at + 2 > p->num_words || p->words[at + 1] > p->num_words - at - 2) {
+            return false;
+        }
+
+        p->funcs[i].hash = p->words[at];
+        p->funcs[i].num_counts = (uint32_t) p->words[at + 1];
+        p->funcs[i].counts = p->words + at + 2;
+        at += 2 + p->words[at + 1];
+        i++;
+    }
+
+    if (p->num_funcs > 0) {
+        qsort((void *) p->funcs, p->num_funcs, sizeof(ProfileFunc), profile_compare_funcs);
+    }
+
+    return true;
+}
+
+bool profile_read(Profile *p, const char *path) {
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size < 0 || size % 8 != 0) {
+        fclose(file);
+        errno = EINVAL;
+        return false;
+    }
+
+    p->num_words = (uint64_t) size / 8;
+    p->words = (uint64_t *) malloc((p->num_words + 1) * sizeof(uint64_t));
+
+    bool ok = fread((void *) p->words, sizeof(uint64_t), p->num_words, file) == p->num_words;
+    fclose(file);
+
+    if (!ok || !profile_parse(p)) {
+        errno = ok ? EINVAL : EIO;
+        return false;
+    }
+
+    return true;
+}
+
+ProfileFunc *profile_find(Profile *p, uint64_t hash) {
+    ProfileFunc key = { .hash = hash };
+
+    if (p->num_funcs == 0) {
+        return NULL;
+    }
+
+    return (ProfileFunc *) bsearch((void *) &key, (void *) p->funcs, p->num_funcs, sizeof(ProfileFunc), profile_compare_funcs);
+}
+
+// a block ran as often as the edges into it were taken, the entry block also once per call
+void profile_apply_func(IrFunc *f, ProfileFunc *pf) {
+    uint32_t k = 1;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        f->blocks[b].freq = 0;
+        b++;
+    }
+
+    f->blocks[0].freq = (int64_t) pf->counts[0];
+    b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_succs) {
+            f->blocks[block->succs[i]].freq += (int64_t) pf->counts[k++];
+            i++;
+        }
+
+        b++;
+    }
+
+    f->flags |= IR_FUNC_PROFILED;
+}
+
+void profile_apply_module(IrModule *m, Profile *p) {
+    int32_t tt = TIMETRACE_BEGIN("profile use", 0, NULL, 0, NULL);
+    uint32_t i = 0;
+
+    while (i < ir_module_num_funcs(m)) {
+        IrFunc *f = ir_module_func(m, i);
+        i++;
+
+        if (!profile_is_defined(f)) {
+            continue;
+        }
+
+        ProfileFunc *pf = profile_find(p, profile_func_hash(f));
+
+        if (pf != NULL && pf->num_counts == profile_num_counters(f)) {
+            profile_apply_func(f, pf);
+            p->num_matched++;
+        } else {
+            p->num_stale++;
+        }
+    }
+
+    timer_stat_add("profiled functions", p->num_matched);
+    timer_stat_add("functions without profile", p->num_stale);
+    TIMETRACE_END(tt);
+}
@@ -80,8 +80,5 @@ void ptrvec_resize(Ptrvec *v) {
 }
 
 void ptrvec_free(Ptrvec *v) {
-    int64_t i = 0;
-    for (i = 0; i < v->len; i++) {
-        free((void *) v->elements[i]);
-    }
+    free((void *) v->elements);
 }
@@ -1,4 +1,5 @@
 #include "../include/reader.h"
+#include "../include/timetrace.h"
 
 FileMap reader_create() {
     FileMap filemap = {
@@ -106,7 +107,27 @@ FileAddResult reader_add_all(FileMap *fm, Path *bin_path, int32_t len, const cha
     return result;
 }
 
+// a file that only exists in memory, like the repl's inputs. the map takes the code, the index of the file is returned
+int32_t reader_add_source(FileMap *fm, const char *name, const char *code) {
+    SourceFile sf = {
+        .file = file_create(path_new_pathbuf(name)),
+        .code = code
+    };
+
+    vec_push(&fm->files, (void *) &sf);
+
+    return reader_num_files(fm) - 1;
+}
+
 int32_t reader_add_file(FileMap *fm, Path *bin_path, const char *name) {
+    int32_t tt = TIMETRACE_BEGIN("load file", (int32_t) strlen(name), name, 0, NULL);
+    int32_t res = reader_load_file(fm, bin_path, name);
+    TIMETRACE_END(tt);
+
+    return res;
+}
+
+int32_t reader_load_file(FileMap *fm, Path *bin_path, const char *name) {
     Path path = path_empty();
     int32_t res = 0;
 
@@ -54,7 +54,7 @@ bool record_fields_get_field_at(Fields *fs, int32_t i, Field *dest) {
 }
 
 const char *record_fields_to_string(Fields *fs, SpanInterner *si) {
-    char *fields = "";
+    char *fields = strdup("");
     int32_t i = 0;
 
     while (i < fs->fields.len) {
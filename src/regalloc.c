@@ -0,0 +1,968 @@
+#include <string.h>
+
+#include "../include/abi.h"
+#include "../include/regalloc.h"
+
+const X64Reg regalloc_regs[RA_NUM_REGS] = {
+    X64_RSI, X64_RDI, X64_R8, X64_R9, X64_R10,
+    X64_RBX, X64_R12, X64_R13, X64_R14, X64_R15
+};
+
+// what a use costs at every loop depth when its value is spilled
+static const int64_t ra_depth_weights[RA_MAX_LOOP_DEPTH + 1] = { 1, 10, 100, 1000, 10000 };
+
+RegAlloc regalloc_create() {
+    RegAlloc ra;
+    memset((void *) &ra, 0, sizeof(RegAlloc));
+
+    return ra;
+}
+
+void regalloc_free(RegAlloc *ra) {
+    free((void *) ra->pos);
+    free((void *) ra->start);
+    free((void *) ra->end);
+    free((void *) ra->num_uses);
+    free((void *) ra->global_idx);
+    free((void *) ra->global_vals);
+    free((void *) ra->fused);
+    free((void *) ra->locs);
+    free((void *) ra->use_off);
+    free((void *) ra->first_seg);
+    free((void *) ra->last_seg);
+    free((void *) ra->cur_seg);
+    free((void *) ra->spill_slot);
+    free((void *) ra->block_start);
+    free((void *) ra->block_end);
+    free((void *) ra->block_idx);
+    free((void *) ra->block_depth);
+    free((void *) ra->live_in);
+    free((void *) ra->live_out);
+    free((void *) ra->kill);
+    free((void *) ra->use_pos);
+    free((void *) ra->use_sum);
+    free((void *) ra->calls);
+    free((void *) ra->intervals);
+    free((void *) ra->unhandled);
+    free((void *) ra->segments);
+    free((void *) ra->splits);
+}
+
+bool regalloc_is_call(IrOp op) {
+    return op == IR_CALL || op == IR_NEW || op == IR_DELETE;
+}
+
+// a stack slot or a field of one, which is a constant offset from rbp
+bool regalloc_is_frame_addr(IrFunc *f, IrValue v) {
+    while (f->insts[v].op == IR_OFFSET) {
+        v = f->insts[v].u.ops[0];
+    }
+
+    return f->insts[v].op == IR_ALLOCA;
+}
+
+// cheaper to recompute at every use than to keep in a register
+bool regalloc_is_remat(IrFunc *f, IrValue v) {
+    IrInst *inst = &f->insts[v];
+
+    switch (inst->op) {
+        case IR_CONST:
+        case IR_STR:
+        case IR_GLOBAL:
+        case IR_FUNC_ADDR:
+        case IR_ALLOCA:
+            return true;
+        case IR_OFFSET:
+            return regalloc_is_frame_addr(f, v);
+        default:
+            return false;
+    }
+}
+
+bool regalloc_needs_loc(RegAlloc *ra, IrValue v) {
+    IrTypeId ty = ra->f->insts[v].ty;
+    return ra->pos[v] >= 0 && ty != IR_TYPE_VOID && !ir_type_is_vector(ty) && !ra->fused[v] && !regalloc_is_remat(ra->f, v);
+}
+
+// the buffers only grow, so allocating all functions of a module stays linear
+void regalloc_reserve(RegAlloc *ra, IrFunc *f) {
+    if (f->num_insts > ra->cap_insts) {
+        uint32_t cap = f->num_insts * 2;
+
+        ra->pos = (int32_t *) realloc((void *) ra->pos, cap * sizeof(int32_t));
+        ra->start = (int32_t *) realloc((void *) ra->start, cap * sizeof(int32_t));
+        ra->end = (int32_t *) realloc((void *) ra->end, cap * sizeof(int32_t));
+        ra->num_uses = (uint32_t *) realloc((void *) ra->num_uses, cap * sizeof(uint32_t));
+        ra->global_idx = (uint32_t *) realloc((void *) ra->global_idx, cap * sizeof(uint32_t));
+        ra->global_vals = (IrValue *) realloc((void *) ra->global_vals, cap * sizeof(IrValue));
+        ra->fused = (bool *) realloc((void *) ra->fused, cap * sizeof(bool));
+        ra->locs = (Loc *) realloc((void *) ra->locs, cap * sizeof(Loc));
+        ra->use_off = (uint32_t *) realloc((void *) ra->use_off, (cap + 1) * sizeof(uint32_t));
+        ra->first_seg = (int32_t *) realloc((void *) ra->first_seg, cap * sizeof(int32_t));
+        ra->last_seg = (int32_t *) realloc((void *) ra->last_seg, cap * sizeof(int32_t));
+        ra->cur_seg = (int32_t *) realloc((void *) ra->cur_seg, cap * sizeof(int32_t));
+        ra->spill_slot = (int32_t *) realloc((void *) ra->spill_slot, cap * sizeof(int32_t));
+        ra->cap_insts = cap;
+    }
+
+    if (f->num_blocks > ra->cap_blocks) {
+        uint32_t cap = f->num_blocks * 2;
+
+        ra->block_start = (int32_t *) realloc((void *) ra->block_start, cap * sizeof(int32_t));
+        ra->block_end = (int32_t *) realloc((void *) ra->block_end, cap * sizeof(int32_t));
+        ra->block_idx = (int32_t *) realloc((void *) ra->block_idx, cap * sizeof(int32_t));
+        ra->block_depth = (int32_t *) realloc((void *) ra->block_depth, (cap + 1) * sizeof(int32_t));
+        ra->cap_blocks = cap;
+    }
+
+    memset((void *) ra->fused, 0, f->num_insts * sizeof(bool));
+    memset((void *) ra->num_uses, 0, f->num_insts * sizeof(uint32_t));
+
+    uint32_t i = 0;
+    while (i < f->num_insts) {
+        ra->pos[i] = -1;
+        ra->end[i] = -1;
+        ra->global_idx[i] = UINT32_MAX;
+        ra->locs[i].kind = LOC_NONE;
+        ra->first_seg[i] = -1;
+        ra->last_seg[i] = -1;
+        ra->cur_seg[i] = -1;
+        ra->spill_slot[i] = -1;
+        i++;
+    }
+
+    ra->num_segments = 0;
+    ra->num_splits = 0;
+    ra->num_slots = 0;
+    ra->used_regs = 0;
+    ra->num_spilled = 0;
+    ra->num_split = 0;
+}
+
+void regalloc_number(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    int32_t p = 0;
+    uint32_t i = 0;
+
+    ra->num_calls = 0;
+
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t j = 0;
+
+        ra->block_start[b] = p;
+        ra->block_idx[b] = (int32_t) i;
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+            ra->pos[v] = p;
+
+            if (regalloc_is_call(f->insts[v].op)) {
+                if (ra->num_calls >= ra->cap_calls) {
+                    ra->cap_calls = ra->cap_calls == 0 ? 64 : ra->cap_calls * 2;
+                    ra->calls = (int32_t *) realloc((void *) ra->calls, ra->cap_calls * sizeof(int32_t));
+                }
+
+                ra->calls[ra->num_calls++] = p;
+            }
+
+            p += 2;
+            j++;
+        }
+
+        ra->block_end[b] = p - 2;
+        i++;
+    }
+}
+
+// a loop in layout order runs from its header to the block with the back edge, so the depth of a block is
+// the number of back edges whose span covers it. this is exact for the loops the lowerer builds and costs
+// a single pass. the cold blocks are laid out in order after the hot ones, so only edges within one part count
+void regalloc_loop_depths(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    int32_t *diff = ra->block_depth;
+    uint32_t i = 0;
+
+    memset((void *) diff, 0, (ra->num_order + 1) * sizeof(int32_t));
+
+    while (i < ra->num_order) {
+        IrBlock *block = &f->blocks[ra->order[i]];
+        uint32_t s = 0;
+
+        while (s < block->num_succs) {
+            int32_t header = ra->block_idx[block->succs[s]];
+
+            bool same_part = (header < (int32_t) ra->first_cold) == (i < ra->first_cold);
+
+            if (header <= (int32_t) i && same_part) {
+                diff[header]++;
+                diff[i + 1]--;
+            }
+
+            s++;
+        }
+
+        i++;
+    }
+
+    // the differences become depths in place, indexed by position in the order
+    int32_t depth = 0;
+    i = 0;
+
+    while (i < ra->num_order) {
+        depth += diff[i];
+        diff[i] = depth > RA_MAX_LOOP_DEPTH ? RA_MAX_LOOP_DEPTH : depth;
+        i++;
+    }
+}
+
+// a profiled block weighs its count relative to the entry's instead of its loop depth, one above the count so a
+// block that never ran still weighs something but less than the entry
+int64_t regalloc_block_weight(RegAlloc *ra, IrBlockId b) {
+    IrFunc *f = ra->f;
+
+    if ((f->flags & IR_FUNC_PROFILED) != 0 && f->blocks[0].freq > 0) {
+        double w = 1.0 + (double) f->blocks[b].freq * RA_PROFILE_ENTRY_WEIGHT / (double) f->blocks[0].freq;
+        return w > (double) RA_MAX_PROFILE_WEIGHT ? RA_MAX_PROFILE_WEIGHT : (int64_t) w;
+    }
+
+    return ra_depth_weights[ra->block_depth[ra->block_idx[b]]];
+}
+
+void regalloc_use(RegAlloc *ra, IrValue v, int32_t pos, IrBlockId block) {
+    ra->num_uses[v]++;
+
+    if (pos > ra->end[v]) {
+        ra->end[v] = pos;
+    }
+
+    if (ra->f->insts[v].block != block && ra->global_idx[v] == UINT32_MAX && !regalloc_is_remat(ra->f, v)) {
+        ra->global_idx[v] = ra->num_globals;
+        ra->global_vals[ra->num_globals++] = v;
+    }
+}
+
+// phi operands are used at the end of their predecessor, where the phi copies are placed
+void regalloc_count_uses(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint32_t i = 0;
+
+    ra->num_globals = 0;
+
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t j = 0;
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t k = 0;
+
+            while (k < n) {
+                if (inst->op == IR_PHI) {
+                    IrBlockId pred = block->preds[k];
+                    regalloc_use(ra, ops[k], ra->block_end[pred], pred);
+                } else {
+                    regalloc_use(ra, ops[k], ra->pos[v], b);
+                }
+
+                k++;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+}
+
+void regalloc_add_use_pos(RegAlloc *ra, IrValue v, int32_t pos, IrBlockId block) {
+    uint32_t at = ra->use_off[v + 1]++;
+
+    ra->use_pos[at] = pos;
+    ra->use_sum[at + 1] = regalloc_block_weight(ra, block);
+}
+
+// the positions of every value's uses in order, with a running sum of their weights, so the cost of
+// spilling any part of an interval is a difference of two sums
+void regalloc_collect_uses(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    ra->use_off[0] = 0;
+
+    while (i < f->num_insts) {
+        total += ra->num_uses[i];
+        ra->use_off[i + 1] = total - ra->num_uses[i];
+        i++;
+    }
+
+    if (total + 1 > ra->cap_uses) {
+        ra->cap_uses = (total + 1) * 2;
+        ra->use_pos = (int32_t *) realloc((void *) ra->use_pos, ra->cap_uses * sizeof(int32_t));
+        ra->use_sum = (int64_t *) realloc((void *) ra->use_sum, ra->cap_uses * sizeof(int64_t));
+    }
+
+    // use_off[v + 1] counts up from the start of v's list while it is filled, and ends at its end
+    i = 0;
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t j = 0;
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t k = 0;
+
+            while (k < n) {
+                if (inst->op == IR_PHI) {
+                    IrBlockId pred = block->preds[k];
+                    regalloc_add_use_pos(ra, ops[k], ra->block_end[pred], pred);
+                } else {
+                    regalloc_add_use_pos(ra, ops[k], ra->pos[v], b);
+                }
+
+                k++;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    // only the uses by phis of later blocks come out of order, so insertion sort is close to linear
+    i = 0;
+    while (i < f->num_insts) {
+        uint32_t j = ra->use_off[i] + 1;
+
+        while (j < ra->use_off[i + 1]) {
+            int32_t p = ra->use_pos[j];
+            int64_t w = ra->use_sum[j + 1];
+            uint32_t k = j;
+
+            while (k > ra->use_off[i] && ra->use_pos[k - 1] > p) {
+                ra->use_pos[k] = ra->use_pos[k - 1];
+                ra->use_sum[k + 1] = ra->use_sum[k];
+                k--;
+            }
+
+            ra->use_pos[k] = p;
+            ra->use_sum[k + 1] = w;
+            j++;
+        }
+
+        i++;
+    }
+
+    ra->use_sum[0] = 0;
+    i = 0;
+
+    while (i < total) {
+        ra->use_sum[i + 1] += ra->use_sum[i];
+        i++;
+    }
+}
+
+// the index of the first use of v at or after pos
+uint32_t regalloc_find_use(RegAlloc *ra, IrValue v, int32_t pos) {
+    uint32_t lo = ra->use_off[v];
+    uint32_t hi = ra->use_off[v + 1];
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (ra->use_pos[mid] < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+int64_t regalloc_use_cost(RegAlloc *ra, IrValue v, int32_t from, int32_t to) {
+    return ra->use_sum[regalloc_find_use(ra, v, to + 1)] - ra->use_sum[regalloc_find_use(ra, v, from)];
+}
+
+// a compare whose only user is the branch right after it becomes a cmp and jcc pair, its operands
+// are then read by the branch
+void regalloc_fuse_compares(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint32_t i = 0;
+
+    while (i < ra->num_order) {
+        IrBlock *block = &f->blocks[ra->order[i]];
+        uint32_t j = 0;
+
+        while (j + 1 < block->num_insts) {
+            IrValue v = block->insts[j];
+            IrInst *next = &f->insts[block->insts[j + 1]];
+
+            if (ir_op_is_compare(f->insts[v].op) && ra->num_uses[v] == 1 && next->op == IR_CBR && next->u.ops[0] == v) {
+                IrValue *ops = f->insts[v].u.ops;
+                int32_t at = ra->pos[block->insts[j + 1]];
+
+                ra->fused[v] = true;
+                ra->end[ops[0]] = ra->end[ops[0]] > at ? ra->end[ops[0]] : at;
+                ra->end[ops[1]] = ra->end[ops[1]] > at ? ra->end[ops[1]] : at;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+}
+
+void regalloc_set_bit(uint64_t *set, uint32_t bit) {
+    set[bit / 64] |= (uint64_t) 1 << (bit % 64);
+}
+
+// backwards dataflow over the values used outside of their own block, the rest never cross a block boundary
+void regalloc_liveness(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint64_t words = (ra->num_globals + 63) / 64;
+    uint64_t size = words * f->num_blocks;
+
+    if (size > ra->cap_words) {
+        ra->cap_words = size * 2;
+        ra->live_in = (uint64_t *) realloc((void *) ra->live_in, ra->cap_words * sizeof(uint64_t));
+        ra->live_out = (uint64_t *) realloc((void *) ra->live_out, ra->cap_words * sizeof(uint64_t));
+        ra->kill = (uint64_t *) realloc((void *) ra->kill, ra->cap_words * sizeof(uint64_t));
+    }
+
+    if (words == 0) {
+        return;
+    }
+
+    memset((void *) ra->live_in, 0, size * sizeof(uint64_t));
+    memset((void *) ra->live_out, 0, size * sizeof(uint64_t));
+    memset((void *) ra->kill, 0, size * sizeof(uint64_t));
+
+    uint32_t g = 0;
+    while (g < ra->num_globals) {
+        regalloc_set_bit(ra->kill + f->insts[ra->global_vals[g]].block * words, g);
+        g++;
+    }
+
+    // live_in starts out as the upward exposed uses and only grows from there
+    uint32_t i = 0;
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t j = 0;
+
+        while (j < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[j]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t k = 0;
+
+            while (k < n) {
+                IrBlockId use_block = inst->op == IR_PHI ? block->preds[k] : b;
+                uint32_t idx = ra->global_idx[ops[k]];
+
+                if (idx != UINT32_MAX && f->insts[ops[k]].block != use_block) {
+                    regalloc_set_bit(ra->live_in + use_block * words, idx);
+                }
+
+                k++;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+        i = ra->num_order;
+
+        while (i > 0) {
+            i--;
+
+            IrBlockId b = ra->order[i];
+            IrBlock *block = &f->blocks[b];
+            uint64_t *in = ra->live_in + b * words;
+            uint64_t *out = ra->live_out + b * words;
+            uint64_t *kill = ra->kill + b * words;
+            uint32_t s = 0;
+
+            while (s < block->num_succs) {
+                uint64_t *succ_in = ra->live_in + block->succs[s] * words;
+                uint64_t w = 0;
+
+                while (w < words) {
+                    out[w] |= succ_in[w];
+                    w++;
+                }
+
+                s++;
+            }
+
+            uint64_t w = 0;
+            while (w < words) {
+                uint64_t next = in[w] | (out[w] & ~kill[w]);
+
+                if (next != in[w]) {
+                    in[w] = next;
+                    changed = true;
+                }
+
+                w++;
+            }
+        }
+    }
+}
+
+int32_t regalloc_cmp_intervals(const void *a, const void *b) {
+    const RaInterval *x = (const RaInterval *) a;
+    const RaInterval *y = (const RaInterval *) b;
+
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+
+    return x->v < y->v ? -1 : (x->v > y->v ? 1 : 0);
+}
+
+bool regalloc_crosses_call(RegAlloc *ra, int32_t start, int32_t end) {
+    uint32_t lo = 0;
+    uint32_t hi = ra->num_calls;
+
+    // first call after start
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (ra->calls[mid] <= start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo < ra->num_calls && ra->calls[lo] < end;
+}
+
+void regalloc_reserve_intervals(RegAlloc *ra, uint32_t n) {
+    if (n > ra->cap_intervals) {
+        ra->cap_intervals = n * 2;
+        ra->intervals = (RaInterval *) realloc((void *) ra->intervals, ra->cap_intervals * sizeof(RaInterval));
+        ra->unhandled = (uint32_t *) realloc((void *) ra->unhandled, ra->cap_intervals * sizeof(uint32_t));
+    }
+}
+
+// every interval is the hull of the positions where its value is live, without holes
+void regalloc_build_intervals(RegAlloc *ra) {
+    IrFunc *f = ra->f;
+    uint64_t words = (ra->num_globals + 63) / 64;
+    uint32_t i = 0;
+
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        IrBlock *block = &f->blocks[b];
+        uint32_t j = 0;
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+
+            // all parameters are copied out of the argument registers at once on entry
+            ra->start[v] = f->insts[v].op == IR_PARAM ? 0 : ra->pos[v];
+            ra->end[v] = ra->end[v] > ra->pos[v] ? ra->end[v] : ra->pos[v];
+
+            // a phi is written by the copies at the end of every predecessor, so it holds its place from the gap
+            // before its block on even when every predecessor is laid out after it
+            if (f->insts[v].op == IR_PHI) {
+                uint32_t k = 0;
+
+                ra->start[v] = ra->block_start[b] - 1;
+
+                while (k < block->num_preds) {
+                    int32_t at = ra->block_end[block->preds[k]];
+
+                    ra->start[v] = at < ra->start[v] ? at : ra->start[v];
+                    ra->end[v] = at > ra->end[v] ? at : ra->end[v];
+                    k++;
+                }
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    // a block the value is live into can come before its definition in the layout, so the definitions are all
+    // in place before liveness widens the intervals. a value live into a block is there from the gap before it,
+    // so a call right at the start of the block is one it lives across
+    i = 0;
+
+    while (i < ra->num_order) {
+        IrBlockId b = ra->order[i];
+        uint64_t w = 0;
+
+        while (w < words) {
+            uint64_t in = ra->live_in[b * words + w];
+            uint64_t out = ra->live_out[b * words + w];
+
+            while (in != 0) {
+                IrValue v = ra->global_vals[w * 64 + __builtin_ctzll(in)];
+                ra->start[v] = ra->block_start[b] - 1 < ra->start[v] ? ra->block_start[b] - 1 : ra->start[v];
+                in &= in - 1;
+            }
+
+            while (out != 0) {
+                IrValue v = ra->global_vals[w * 64 + __builtin_ctzll(out)];
+                ra->end[v] = ra->block_end[b] + 1 > ra->end[v] ? ra->block_end[b] + 1 : ra->end[v];
+                out &= out - 1;
+            }
+
+            w++;
+        }
+
+        i++;
+    }
+
+    ra->num_intervals = 0;
+    regalloc_reserve_intervals(ra, f->num_insts);
+    i = 0;
+
+    while (i < ra->num_order) {
+        IrBlock *block = &f->blocks[ra->order[i]];
+        uint32_t j = 0;
+
+        while (j < block->num_insts) {
+            IrValue v = block->insts[j];
+
+            if (regalloc_needs_loc(ra, v)) {
+                RaInterval *it = &ra->intervals[ra->num_intervals++];
+
+                it->v = v;
+                it->start = ra->start[v];
+                it->end = ra->end[v];
+                it->crosses_call = regalloc_crosses_call(ra, it->start, it->end);
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    qsort((void *) ra->intervals, ra->num_intervals, sizeof(RaInterval), regalloc_cmp_intervals);
+}
+
+// every stack segment of a value uses the same slot, which is written where the value is defined
+void regalloc_spill(RegAlloc *ra, IrValue v) {
+    if (ra->spill_slot[v] < 0) {
+        ra->spill_slot[v] = ra->num_slots++;
+        ra->num_spilled++;
+    }
+}
+
+// parameters prefer the register they arrive in, which saves the copy on entry
+int32_t regalloc_hint(RegAlloc *ra, IrValue v) {
+    IrInst *inst = &ra->f->insts[v];
+
+    if (inst->op != IR_PARAM || inst->imm >= ABI_NUM_ARG_REGS) {
+        return -1;
+    }
+
+    int32_t r = 0;
+    while (r < RA_NUM_REGS && regalloc_regs[r] != abi_arg_regs[inst->imm]) {
+        r++;
+    }
+
+    return r < RA_NUM_REGS ? r : -1;
+}
+
+// the lookups of one value mostly come in layout order, so the last segment found is where the next one starts
+Loc *regalloc_loc_at(RegAlloc *ra, IrValue v, int32_t pos) {
+    int32_t seg = ra->cur_seg[v];
+
+    if (ra->first_seg[v] < 0) {
+        return &ra->locs[v];
+    }
+
+    if (seg < 0 || ra->segments[seg].start > pos) {
+        seg = ra->first_seg[v];
+    }
+
+    while (ra->segments[seg].next >= 0 && ra->segments[ra->segments[seg].next].start <= pos) {
+        seg = ra->segments[seg].next;
+    }
+
+    ra->cur_seg[v] = seg;
+
+    return &ra->segments[seg].loc;
+}
+
+// a segment that starts where the last one of the value does replaces its location
+void regalloc_add_segment(RegAlloc *ra, IrValue v, int32_t start, Loc loc) {
+    int32_t last = ra->last_seg[v];
+
+    if (last >= 0 && ra->segments[last].start >= start) {
+        ra->segments[last].loc = loc;
+        ra->locs[v] = ra->segments[ra->first_seg[v]].loc;
+        return;
+    }
+
+    if (ra->num_segments >= ra->cap_segments) {
+        ra->cap_segments = ra->cap_segments == 0 ? 256 : ra->cap_segments * 2;
+        ra->segments = (RaSegment *) realloc((void *) ra->segments, ra->cap_segments * sizeof(RaSegment));
+    }
+
+    RaSegment *seg = &ra->segments[ra->num_segments];
+    seg->start = start;
+    seg->next = -1;
+    seg->loc = loc;
+
+    if (last < 0) {
+        ra->first_seg[v] = (int32_t) ra->num_segments;
+        ra->locs[v] = loc;
+    } else {
+        ra->segments[last].next = (int32_t) ra->num_segments;
+
+        if (ra->num_splits >= ra->cap_splits) {
+            ra->cap_splits = ra->cap_splits == 0 ? 64 : ra->cap_splits * 2;
+            ra->splits = (RaSplit *) realloc((void *) ra->splits, ra->cap_splits * sizeof(RaSplit));
+        }
+
+        ra->splits[ra->num_splits].pos = start;
+        ra->splits[ra->num_splits].v = v;
+        ra->num_splits++;
+    }
+
+    ra->last_seg[v] = (int32_t) ra->num_segments++;
+}
+
+bool regalloc_before(RaInterval *a, RaInterval *b) {
+    return a->start < b->start || (a->start == b->start && a->v < b->v);
+}
+
+// the parts of intervals that are split off wait in a binary heap until the scan reaches their start
+void regalloc_push_unhandled(RegAlloc *ra, uint32_t idx) {
+    uint32_t i = ra->num_unhandled++;
+
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+
+        if (!regalloc_before(&ra->intervals[idx], &ra->intervals[ra->unhandled[parent]])) {
+            break;
+        }
+
+        ra->unhandled[i] = ra->unhandled[parent];
+        i = parent;
+    }
+
+    ra->unhandled[i] = idx;
+}
+
+uint32_t regalloc_pop_unhandled(RegAlloc *ra) {
+    uint32_t top = ra->unhandled[0];
+    uint32_t last = ra->unhandled[--ra->num_unhandled];
+    uint32_t i = 0;
+
+    while (2 * i + 1 < ra->num_unhandled) {
+        uint32_t child = 2 * i + 1;
+
+        if (child + 1 < ra->num_unhandled && regalloc_before(&ra->intervals[ra->unhandled[child + 1]], &ra->intervals[ra->unhandled[child]])) {
+            child++;
+        }
+
+        if (!regalloc_before(&ra->intervals[ra->unhandled[child]], &ra->intervals[last])) {
+            break;
+        }
+
+        ra->unhandled[i] = ra->unhandled[child];
+        i = child;
+    }
+
+    ra->unhandled[i] = last;
+
+    return top;
+}
+
+// the value is on the stack from at on, and gets another chance at a register just before its next use.
+// uses in between read the stack slot, so every use that is not given back a register costs a reload
+void regalloc_split_spill(RegAlloc *ra, IrValue v, int32_t at, int32_t end) {
+    Loc loc = { LOC_STACK, 0, 0 };
+
+    regalloc_spill(ra, v);
+    loc.slot = ra->spill_slot[v];
+    regalloc_add_segment(ra, v, at, loc);
+
+    uint32_t u = regalloc_find_use(ra, v, at + 2);
+
+    if (u < ra->use_off[v + 1] && ra->use_pos[u] <= end) {
+        regalloc_reserve_intervals(ra, ra->num_intervals + 1);
+
+        RaInterval *child = &ra->intervals[ra->num_intervals];
+        child->v = v;
+        child->start = ra->use_pos[u] - 1;
+        child->end = end;
+        child->crosses_call = regalloc_crosses_call(ra, child->start, child->end);
+
+        regalloc_push_unhandled(ra, ra->num_intervals++);
+        ra->num_split++;
+    }
+}
+
+// linear scan over the intervals in order of their start. when no register is left, the interval whose uses
+// from here on are cheapest to spill, weighted by loop depth, goes to the stack until just before its next use
+void regalloc_scan(RegAlloc *ra) {
+    uint32_t active[RA_NUM_REGS];
+    X64Reg active_regs[RA_NUM_REGS];
+    int32_t num_active = 0;
+    uint32_t free_regs = 0;
+    uint32_t num_sorted = ra->num_intervals;
+    uint32_t next_sorted = 0;
+    uint32_t i = 0;
+
+    while (i < RA_NUM_REGS) {
+        free_regs |= 1u << regalloc_regs[i];
+        i++;
+    }
+
+    ra->num_unhandled = 0;
+
+    while (next_sorted < num_sorted || ra->num_unhandled > 0) {
+        uint32_t cur = 0;
+
+        if (ra->num_unhandled == 0 || (next_sorted < num_sorted && regalloc_before(&ra->intervals[next_sorted], &ra->intervals[ra->unhandled[0]]))) {
+            cur = next_sorted++;
+        } else {
+            cur = regalloc_pop_unhandled(ra);
+        }
+
+        RaInterval it = ra->intervals[cur];
+        int32_t k = 0;
+
+        while (k < num_active) {
+            if (ra->intervals[active[k]].end <= it.start) {
+                free_regs |= 1u << active_regs[k];
+                num_active--;
+                active[k] = active[num_active];
+                active_regs[k] = active_regs[num_active];
+            } else {
+                k++;
+            }
+        }
+
+        int32_t first = it.crosses_call ? RA_FIRST_CALLEE_SAVED : 0;
+        int32_t hint = regalloc_hint(ra, it.v);
+        int32_t r = first;
+
+        if (hint >= first && (free_regs & (1u << regalloc_regs[hint])) != 0) {
+            r = hint;
+        }
+
+        while (r < RA_NUM_REGS && (free_regs & (1u << regalloc_regs[r])) == 0) {
+            r++;
+        }
+
+        Loc loc = { LOC_REG, 0, 0 };
+
+        if (r < RA_NUM_REGS) {
+            loc.reg = regalloc_regs[r];
+            regalloc_add_segment(ra, it.v, it.start, loc);
+            ra->used_regs |= 1u << regalloc_regs[r];
+            free_regs &= ~(1u << regalloc_regs[r]);
+            active[num_active] = cur;
+            active_regs[num_active++] = regalloc_regs[r];
+            continue;
+        }
+
+        int32_t victim = -1;
+        int64_t victim_cost = 0;
+        int32_t victim_next = 0;
+        k = 0;
+
+        while (k < num_active) {
+            RaInterval *a = &ra->intervals[active[k]];
+
+            if (!it.crosses_call || abi_is_callee_saved(active_regs[k])) {
+                int64_t cost = regalloc_use_cost(ra, a->v, it.start, a->end);
+                uint32_t u = regalloc_find_use(ra, a->v, it.start);
+                int32_t next = u < ra->use_off[a->v + 1] ? ra->use_pos[u] : INT32_MAX;
+
+                if (victim < 0 || cost < victim_cost || (cost == victim_cost && next > victim_next)) {
+                    victim = k;
+                    victim_cost = cost;
+                    victim_next = next;
+                }
+            }
+
+            k++;
+        }
+
+        if (victim >= 0 && victim_cost < regalloc_use_cost(ra, it.v, it.start, it.end)) {
+            RaInterval *a = &ra->intervals[active[victim]];
+            IrValue victim_v = a->v;
+            int32_t victim_end = a->end;
+
+            // the victim leaves the register at the gap before the current interval starts
+            loc.reg = active_regs[victim];
+            regalloc_split_spill(ra, victim_v, (it.start & 1) != 0 ? it.start : it.start - 1, victim_end);
+            regalloc_add_segment(ra, it.v, it.start, loc);
+            active[victim] = cur;
+        } else {
+            regalloc_split_spill(ra, it.v, it.start, it.end);
+        }
+    }
+}
+
+int32_t regalloc_cmp_splits(const void *a, const void *b) {
+    const RaSplit *x = (const RaSplit *) a;
+    const RaSplit *y = (const RaSplit *) b;
+
+    if (x->pos != y->pos) {
+        return x->pos < y->pos ? -1 : 1;
+    }
+
+    return x->v < y->v ? -1 : (x->v > y->v ? 1 : 0);
+}
+
+// everything up to the intervals, shared by the linear scan and the graph colouring allocator
+void regalloc_prepare(RegAlloc *ra, IrFunc *f, uint32_t *order, uint32_t num_order) {
+    ra->f = f;
+    ra->order = order;
+    ra->num_order = num_order;
+
+    regalloc_reserve(ra, f);
+    regalloc_number(ra);
+    regalloc_loop_depths(ra);
+    regalloc_count_uses(ra);
+    regalloc_collect_uses(ra);
+    regalloc_fuse_compares(ra);
+    regalloc_liveness(ra);
+    regalloc_build_intervals(ra);
+}
+
+// linear scan over the intervals regalloc_prepare built
+void regalloc_allocate(RegAlloc *ra) {
+    regalloc_scan(ra);
+
+    // the code generator walks the split points in layout order, there are none to sort in most functions
+    if (ra->num_splits > 0) {
+        qsort((void *) ra->splits, ra->num_splits, sizeof(RaSplit), regalloc_cmp_splits);
+    }
+}
+
+void regalloc_run(RegAlloc *ra, IrFunc *f, uint32_t *order, uint32_t num_order) {
+    regalloc_prepare(ra, f, order, num_order);
+    regalloc_allocate(ra);
+}
@@ -0,0 +1,451 @@
+#include "../include/repl.h"
+#include "../include/parser.h"
+#include "../include/source.h"
+
+static const char *const repl_decl_keywords[] = { "fn", "inline", "noinline", "extern", "type", "import", "let" };
+#define REPL_NUM_DECL_KEYWORDS ((int32_t) (sizeof(repl_decl_keywords) / sizeof(repl_decl_keywords[0])))
+
+void repl_print_error(Repl *r, const char *err_text, Span span) {
+    BigSpan big = span_get(&r->si, span);
+    SourceFile *file = reader_get_ptr_by_idx(&r->fm, big.ctx);
+    uint32_t last_nl = 0;
+    int32_t line = source_find_line(&big, file, &last_nl);
+
+    if (big.ctx < r->first_input) {
+        const char *name = source_file_name_dup(file);
+        printf("[error] %s\n--> %s:%d:%d\n", err_text, name + r->compiler_path->len + 1, line, big.start - last_nl);
+        free((void *) name);
+        return;
+    }
+
+    // expressions are wrapped in a function whose header takes the first line
+    if (strncmp(file->code, "fn repl_input_", 14) == 0) {
+        line--;
+    }
+
+    printf("[error] %s\n--> input %d:%d:%d\n", err_text, big.ctx - r->first_input + 1, line, big.start - last_nl);
+}
+
+int32_t repl_print_type_errors(Repl *r) {
+    int32_t num_errs = typecheck_num_errs(&r->tc);
+    int32_t i = 0;
+
+    while (i < num_errs) {
+        TypeError *err = typecheck_get_err(&r->tc, i);
+        repl_print_error(r, err->text, err->span);
+        typecheck_free_err(err);
+
+        i++;
+    }
+
+    r->tc.errors.len = 0;
+
+    return num_errs;
+}
+
+Module *repl_parse(Repl *r, int32_t file_idx, int32_t *num_errs) {
+    Parser p = parser_create(reader_get_by_idx(&r->fm, file_idx), &r->si, file_idx);
+    Module *mod = parser_parse(&p);
+    int32_t i = 0;
+
+    while (i < parser_num_errs(&p)) {
+        ParseError *err = parser_get_err(&p, i);
+        repl_print_error(r, err->text, err->span);
+        i++;
+    }
+
+    *num_errs += parser_num_errs(&p);
+    parser_free_p(&p);
+
+    return mod;
+}
+
+// the standard library and the files are compiled like a program, the repl's own module comes last and starts empty
+int32_t repl_load(Repl *r, int32_t num_files, const char **files) {
+    FileAddResult res = reader_add_std_lib(&r->fm, r->compiler_path);
+
+    if (res.err_code == 0) {
+        res = reader_add_all(&r->fm, r->compiler_path, num_files, files);
+    }
+
+    if (res.err_code != 0) {
+        const char *err_msg = error_err2str(res.err_code, res.file_name);
+        printf("[error] %s\n", err_msg);
+        free((void *) err_msg);
+
+        r->mm = mod_map_with_cap(1);
+        r->tc = typecheck_create(&r->si, &r->mm);
+        r->lowerer = lower_create(&r->ir, &r->mm, &r->si);
+        r->bc = bc_compile(&r->ir);
+        r->vm = vm_create(&r->bc, false);
+
+        return 1;
+    }
+
+    int32_t repl_idx = reader_add_source(&r->fm, r->path, strdup(""));
+    int32_t num_errs = 0;
+    int32_t i = 0;
+
+    r->first_input = repl_idx + 1;
+    r->mm = mod_map_with_cap(reader_num_files(&r->fm));
+
+    while (i < reader_num_files(&r->fm)) {
+        mod_add_mod(&r->mm, repl_parse(r, i, &num_errs));
+        i++;
+    }
+
+    r->mod = mod_get_mod(&r->mm, repl_idx);
+    r->tc = typecheck_create(&r->si, &r->mm);
+    typecheck_check(&r->tc);
+    num_errs += repl_print_type_errors(r);
+
+    // every input continues the repl's module, whichever module the checker finished with
+    typecheck_free_ctx(&r->tc.ctx);
+    r->tc.ctx = typecheck_create_ctx(r->mod, &r->si, &r->tc.globals);
+
+    r->lowerer = lower_create(&r->ir, &r->mm, &r->si);
+
+    if (num_errs == 0) {
+        lower_all(&r->lowerer);
+    }
+
+    r->bc = bc_compile(&r->ir);
+    r->vm = vm_create(&r->bc, r->jit);
+
+    return num_errs;
+}
+
+// the number of braces the input still has to close, those in strings and characters do not count
+int32_t repl_open_braces(const char *s) {
+    int32_t depth = 0;
+    char quote = '\0';
+
+    while (*s != '\0') {
+        if (quote != '\0') {
+            if (*s == '\\' && s[1] != '\0') {
+                s++;
+            } else if (*s == quote) {
+                quote = '\0';
+            }
+        } else if (*s == '"' || *s == '\'') {
+            quote = *s;
+        } else if (*s == '{') {
+            depth++;
+        } else if (*s == '}') {
+            depth--;
+        }
+
+        s++;
+    }
+
+    return depth;
+}
+
+// lines are read until every brace is closed, returns NULL at the end of the input
+char *repl_read_input(bool interactive) {
+    size_t cap = 256;
+    size_t len = 0;
+    char *input = (char *) malloc(cap);
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len = 0;
+
+    input[0] = '\0';
+
+    if (interactive) {
+        printf("> ");
+        fflush(stdout);
+    }
+
+    while ((line_len = getline(&line, &line_cap, stdin)) != -1) {
+        if (len + line_len + 1 > cap) {
+            cap = (len + line_len + 1) * 2;
+            input = (char *) realloc((void *) input, cap);
+        }
+
+        memcpy((void *) (input + len), (void *) line, line_len + 1);
+        len += line_len;
+
+        if (repl_open_braces(input) <= 0) {
+            free((void *) line);
+            return input;
+        }
+
+        if (interactive) {
+            printf("... ");
+            fflush(stdout);
+        }
+    }
+
+    free((void *) line);
+
+    if (len > 0) {
+        return input;
+    }
+
+    free((void *) input);
+
+    return NULL;
+}
+
+const char *repl_skip_space(const char *s) {
+    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') {
+        s++;
+    }
+
+    return s;
+}
+
+bool repl_is_decl(const char *input) {
+    int32_t i = 0;
+
+    while (i < REPL_NUM_DECL_KEYWORDS) {
+        size_t len = strlen(repl_decl_keywords[i]);
+
+        if (strncmp(input, repl_decl_keywords[i], len) == 0 && (input[len] == ' ' || input[len] == '\t' || input[len] == '\n')) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// the names an input declares are remembered with what they were bound to, so a failed input leaves no trace
+void repl_save_bindings(Repl *r, Module *line) {
+    int32_t i = 0;
+
+    r->bindings.len = 0;
+
+    while (i < mod_num_stmts(line)) {
+        Stmt *s = mod_get_stmt_at(line, i);
+        Ident *ident = NULL;
+
+        if (ast_is_func_decl_stmt(s)) {
+            ident = &ast_as_func_decl_stmt(s)->decl.name;
+        } else if (ast_is_struct_decl_stmt(s)) {
+            ident = &ast_as_struct_decl_stmt(s)->decl.name;
+        } else if (ast_is_let_stmt(s)) {
+            ident = &ast_as_let_stmt(s)->ident;
+        }
+
+        if (ident != NULL) {
+            ReplBinding binding = {
+                .ident = ident,
+                .ty = mod_s_lookup(r->mod, ident_len(ident, &r->si), ident->ident)
+            };
+
+            vec_push(&r->bindings, (void *) &binding);
+        }
+
+        i++;
+    }
+}
+
+void repl_restore_bindings(Repl *r) {
+    int32_t i = r->bindings.len - 1;
+
+    while (i >= 0) {
+        ReplBinding *binding = (ReplBinding *) vec_get_ptr(&r->bindings, i);
+        typecheck_bind_global(&r->tc, binding->ident, binding->ty);
+        i--;
+    }
+}
+
+bool repl_calls_extern(Repl *r, Expr *e) {
+    if (!ast_is_call_expr(e)) {
+        return false;
+    }
+
+    Ty *ty = ast_as_call_expr(e)->ident->ty;
+
+    if (ty == NULL || !ty_is_func(ty) || ty_as_func(ty)->ir_idx < 0) {
+        return false;
+    }
+
+    return (ir_module_func(&r->ir, ty_as_func(ty)->ir_idx)->flags & IR_FUNC_EXTERN) != 0;
+}
+
+// when the wrapped input ends in an i32 expression, the wrapper returns it instead of 0 so it can be printed.
+// assignments and calls to c functions, like printf, are run for their effect
+bool repl_return_value(Repl *r, FuncDeclStmt *f_s) {
+    Ptrvec *stmts = &f_s->block->stmts;
+
+    if (stmts->len < 2) {
+        return false;
+    }
+
+    Stmt *last = (Stmt *) ptrvec_get(stmts, stmts->len - 2);
+    Stmt *ret = (Stmt *) ptrvec_get(stmts, stmts->len - 1);
+
+    if (!ast_is_expr_stmt(last) || !ast_is_return_stmt(ret)) {
+        return false;
+    }
+
+    ExprStmt *e_s = ast_as_expr_stmt(last);
+    ReturnStmt *r_s = ast_as_return_stmt(ret);
+
+    if (e_s->expr->ty == NULL || !ty_is_i32(e_s->expr->ty) || ast_is_assign_expr(e_s->expr) || repl_calls_extern(r, e_s->expr)) {
+        return false;
+    }
+
+    Expr *value = e_s->expr;
+    e_s->expr = r_s->expr;
+    r_s->expr = value;
+
+    return true;
+}
+
+void repl_eval(Repl *r, const char *input) {
+    const char *start = repl_skip_space(input);
+    bool is_decl = repl_is_decl(start);
+    size_t len = strlen(input);
+    char name[32];
+
+    while (len > 0 && (input[len - 1] == ' ' || input[len - 1] == '\t' || input[len - 1] == '\n' || input[len - 1] == '\r')) {
+        len--;
+    }
+
+    r->num_inputs++;
+    snprintf(name, sizeof(name), "repl_input_%d", r->num_inputs);
+
+    const char *code = NULL;
+    bool has_semicolon = input[len - 1] == ';' || input[len - 1] == '}';
+
+    if (is_decl) {
+        code = strdup(input);
+    } else {
+        code = fmt_str("fn %s(): i32 {\n%.*s%s\nreturn 0;\n}\n", name, (int32_t) len, input, has_semicolon ? "" : ";");
+    }
+
+    int32_t file_idx = reader_add_source(&r->fm, r->path, code);
+    int32_t num_errs = 0;
+    Module *line = repl_parse(r, file_idx, &num_errs);
+
+    ptrvec_push_ptr(&r->lines, (void *) line);
+
+    if (num_errs > 0) {
+        return;
+    }
+
+    repl_save_bindings(r, line);
+    typecheck_continue_mod(&r->tc, line);
+    r->tc.ctx.mod = r->mod;
+
+    if (repl_print_type_errors(r) > 0) {
+        repl_restore_bindings(r);
+        return;
+    }
+
+    Ty *wrapper = is_decl ? NULL : mod_s_lookup(r->mod, (int32_t) strlen(name), name);
+    bool has_value = !is_decl && !has_semicolon && repl_return_value(r, mod_get_function_at(line, 0));
+    uint32_t first_func = r->bc.num_funcs;
+
+    lower_continue_mod(&r->lowerer, line, file_idx);
+    bc_extend(&r->bc);
+    vm_thread(&r->bc);
+
+    // the jit compiles every new function right away, an input only runs once so it would never get hot
+    uint32_t i = first_func;
+    while (r->vm.jit != NULL && i < r->bc.num_funcs) {
+        if (r->bc.funcs[i].code != NULL) {
+            jit_compile(r->vm.jit, i);
+        }
+
+        i++;
+    }
+
+    if (wrapper == NULL) {
+        return;
+    }
+
+    int64_t result = 0;
+
+    if (!vm_call(&r->vm, &r->bc.funcs[ty_as_func(wrapper)->ir_idx], NULL, 0, &result)) {
+        fflush(stdout);
+        printf("[error] runtime error in '%s': %s\n", r->vm.error_func, r->vm.error);
+    } else if (has_value) {
+        fflush(stdout);
+        printf("%d\n", (int32_t) result);
+    }
+
+    fflush(stdout);
+}
+
+void repl_free(Repl *r) {
+    vm_free(&r->vm);
+    bc_free(&r->bc);
+    lower_free(&r->lowerer);
+    ir_module_free(&r->ir);
+    typecheck_free_tc(&r->tc);
+
+    // the inputs share the repl module's type, which the module map frees
+    int32_t i = 0;
+    while (i < r->lines.len) {
+        Module *line = (Module *) ptrvec_get(&r->lines, i);
+        line->ty = NULL;
+        mod_free(line);
+
+        i++;
+    }
+
+    ptrvec_free(&r->lines);
+    vec_free(&r->bindings);
+    reader_free_fm(&r->fm);
+    mod_free_map(&r->mm);
+    span_free_interner(&r->si);
+    free((void *) r->path);
+}
+
+int32_t repl_run(Path *compiler_path, int32_t num_files, const char **files, bool jit) {
+    PathBuf cwd = path_get_cwd();
+    Repl r = {
+        .si = span_create_interner(),
+        .fm = reader_create(),
+        .ir = ir_module_create(),
+        .mod = NULL,
+        .lines = ptrvec_create(),
+        .bindings = vec_create(sizeof(ReplBinding)),
+        .compiler_path = compiler_path,
+        .path = fmt_str("%.*s/repl.syn", cwd.inner.len, cwd.inner.inner),
+        .first_input = 0,
+        .num_inputs = 0,
+        .jit = jit
+    };
+
+    path_free(&cwd);
+
+    int32_t num_errs = repl_load(&r, num_files, files);
+
+    if (num_errs > 0) {
+        repl_free(&r);
+        return num_errs;
+    }
+
+    bool interactive = isatty(STDIN_FILENO);
+    char *input = NULL;
+
+    while ((input = repl_read_input(interactive)) != NULL) {
+        const char *start = repl_skip_space(input);
+
+        if (strncmp(start, ":quit", 5) == 0 || strncmp(start, ":q", 2) == 0) {
+            free((void *) input);
+            break;
+        }
+
+        if (*start != '\0') {
+            repl_eval(&r, start);
+        }
+
+        free((void *) input);
+    }
+
+    if (interactive) {
+        printf("\n");
+    }
+
+    repl_free(&r);
+
+    return 0;
+}
@@ -0,0 +1,607 @@
+#include <string.h>
+
+#include "../include/sccp.h"
+#include "../include/timer.h"
+
+Sccp sccp_create() {
+    Sccp s;
+    memset((void *) &s, 0, sizeof(Sccp));
+
+    s.block_work = vec_create(sizeof(IrBlockId));
+    s.value_work = vec_create(sizeof(IrValue));
+    s.phis = vec_create(sizeof(IrValue));
+
+    return s;
+}
+
+void sccp_free(Sccp *s) {
+    free((void *) s->state);
+    free((void *) s->value);
+    free((void *) s->use_off);
+    free((void *) s->users);
+    free((void *) s->reachable);
+    free((void *) s->edge_off);
+    free((void *) s->edge_live);
+    vec_free(&s->block_work);
+    vec_free(&s->value_work);
+    vec_free(&s->phis);
+}
+
+void sccp_reserve(Sccp *s, IrFunc *f) {
+    if (f->num_insts > s->cap_insts) {
+        s->cap_insts = f->num_insts * 2;
+        s->state = (uint8_t *) realloc((void *) s->state, s->cap_insts * sizeof(uint8_t));
+        s->value = (int64_t *) realloc((void *) s->value, s->cap_insts * sizeof(int64_t));
+        s->use_off = (uint32_t *) realloc((void *) s->use_off, (s->cap_insts + 1) * sizeof(uint32_t));
+    }
+
+    if (f->num_blocks > s->cap_blocks) {
+        s->cap_blocks = f->num_blocks * 2;
+        s->reachable = (bool *) realloc((void *) s->reachable, s->cap_blocks * sizeof(bool));
+        s->edge_off = (uint32_t *) realloc((void *) s->edge_off, (s->cap_blocks + 1) * sizeof(uint32_t));
+    }
+
+    memset((void *) s->state, SCCP_TOP, f->num_insts * sizeof(uint8_t));
+    memset((void *) s->use_off, 0, (f->num_insts + 1) * sizeof(uint32_t));
+    memset((void *) s->reachable, 0, f->num_blocks * sizeof(bool));
+
+    s->f = f;
+    s->block_work.len = 0;
+    s->value_work.len = 0;
+}
+
+// the users of every value in one array, counted first and then filled back to front
+void sccp_collect_users(Sccp *s) {
+    IrFunc *f = s->f;
+    uint32_t num_edges = 0;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrInst *inst = &f->insts[block->insts[i]];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                s->use_off[ops[j]]++;
+                j++;
+            }
+
+            i++;
+        }
+
+        s->edge_off[b] = num_edges;
+        num_edges += block->num_succs;
+        b++;
+    }
+
+    s->edge_off[f->num_blocks] = num_edges;
+
+    if (num_edges > s->cap_edges) {
+        s->cap_edges = num_edges * 2;
+        s->edge_live = (bool *) realloc((void *) s->edge_live, s->cap_edges * sizeof(bool));
+    }
+
+    memset((void *) s->edge_live, 0, num_edges * sizeof(bool));
+
+    uint32_t total = 0;
+    IrValue v = 0;
+
+    while (v < f->num_insts) {
+        total += s->use_off[v];
+        s->use_off[v] = total;
+        v++;
+    }
+
+    s->use_off[f->num_insts] = total;
+
+    if (total > s->cap_users) {
+        s->cap_users = total * 2;
+        s->users = (IrValue *) realloc((void *) s->users, s->cap_users * sizeof(IrValue));
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue user = block->insts[i];
+            IrInst *inst = &f->insts[user];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                s->users[--s->use_off[ops[j]]] = user;
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+}
+
+// whether some executable edge runs from pred into b
+bool sccp_edge_live(Sccp *s, IrBlockId pred, IrBlockId b) {
+    IrBlock *block = &s->f->blocks[pred];
+    uint32_t i = 0;
+
+    while (i < block->num_succs) {
+        if (block->succs[i] == b && s->edge_live[s->edge_off[pred] + i]) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// narrow results wrap around like the backends' 32 bit instructions, booleans are 0 or 1
+int64_t sccp_normalize(IrTypeId ty, int64_t x) {
+    switch (ty) {
+        case IR_TYPE_I1: return x & 1;
+        case IR_TYPE_I32: return (int32_t) x;
+        default: return x;
+    }
+}
+
+// division by zero and by -1 are left to run, so they fail or wrap the same way they always did
+bool sccp_fold(IrInst *inst, IrTypeId from, int64_t a, int64_t b, int64_t *out) {
+    bool wide = inst->ty == IR_TYPE_I64;
+    uint64_t ua = (uint64_t) a;
+    uint64_t ub = (uint64_t) b;
+    int64_t r = 0;
+
+    switch (inst->op) {
+        case IR_ADD: r = (int64_t) (ua + ub); break;
+        case IR_SUB: r = (int64_t) (ua - ub); break;
+        case IR_MUL: r = (int64_t) (ua * ub); break;
+        case IR_AND: r = a & b; break;
+        case IR_OR: r = a | b; break;
+        case IR_XOR: r = a ^ b; break;
+        case IR_SHL: r = (int64_t) (ua << (b & (wide ? 63 : 31))); break;
+        case IR_SHR: r = a >> (b & (wide ? 63 : 31)); break;
+        case IR_NEG: r = (int64_t) (0 - ua); break;
+        case IR_NOT: r = ~a; break;
+        case IR_EQ: r = a == b; break;
+        case IR_NE: r = a != b; break;
+        case IR_LT: r = a < b; break;
+        case IR_LE: r = a <= b; break;
+        case IR_GT: r = a > b; break;
+        case IR_GE: r = a >= b; break;
+        case IR_TRUNC: r = a; break;
+
+        case IR_DIV:
+        case IR_MOD: {
+            if (b == 0 || b == -1) {
+                return false;
+            }
+
+            r = inst->op == IR_DIV ? a / b : a % b;
+            break;
+        }
+
+        case IR_SEXT:
+        case IR_ZEXT: {
+            if (from == IR_TYPE_I32) {
+                r = inst->op == IR_ZEXT ? (int64_t) (uint32_t) a : a;
+            } else if (from == IR_TYPE_I1 && inst->op == IR_ZEXT) {
+                r = a;
+            } else {
+                return false;
+            }
+
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    // booleans only come out of comparisons, truncations and the bitwise operators
+    if (inst->ty == IR_TYPE_I1 && !ir_op_is_compare((IrOp) inst->op) && inst->op != IR_TRUNC && inst->op != IR_AND &&
+        inst->op != IR_OR && inst->op != IR_XOR) {
+        return false;
+    }
+
+    *out = sccp_normalize(inst->ty, r);
+    return true;
+}
+
+SccpState sccp_meet(Sccp *s, SccpState st, int64_t *val, IrValue op) {
+    if (st == SCCP_BOTTOM || s->state[op] == SCCP_TOP) {
+        return st;
+    }
+
+    if (s->state[op] == SCCP_BOTTOM) {
+        return SCCP_BOTTOM;
+    }
+
+    if (st == SCCP_TOP) {
+        *val = s->value[op];
+        return SCCP_CONST;
+    }
+
+    return *val == s->value[op] ? SCCP_CONST : SCCP_BOTTOM;
+}
+
+SccpState sccp_eval(Sccp *s, IrValue v, int64_t *val) {
+    IrFunc *f = s->f;
+    IrInst *inst = &f->insts[v];
+    IrValue *ops = ir_inst_ops(f, inst);
+
+    // pointers, bytes and structs are never folded
+    if (inst->ty != IR_TYPE_I1 && inst->ty != IR_TYPE_I32 && inst->ty != IR_TYPE_I64) {
+        return SCCP_BOTTOM;
+    }
+
+    switch (inst->op) {
+        case IR_CONST:
+            *val = inst->imm;
+            return SCCP_CONST;
+
+        case IR_COPY:
+            return sccp_meet(s, SCCP_TOP, val, ops[0]);
+
+        case IR_PHI: {
+            IrBlock *block = &f->blocks[inst->block];
+            SccpState st = SCCP_TOP;
+            uint32_t k = 0;
+
+            while (k < inst->num_ops && st != SCCP_BOTTOM) {
+                if (sccp_edge_live(s, block->preds[k], inst->block)) {
+                    st = sccp_meet(s, st, val, ops[k]);
+                }
+
+                k++;
+            }
+
+            return st;
+        }
+
+        case IR_SELECT: {
+            if (s->state[ops[0]] != SCCP_BOTTOM) {
+                return s->state[ops[0]] == SCCP_TOP ? SCCP_TOP : sccp_meet(s, SCCP_TOP, val, s->value[ops[0]] != 0 ? ops[1] : ops[2]);
+            }
+
+            return sccp_meet(s, sccp_meet(s, SCCP_TOP, val, ops[1]), val, ops[2]);
+        }
+
+        default:
+            break;
+    }
+
+    bool unary = inst->op == IR_NEG || inst->op == IR_NOT || inst->op == IR_SEXT || inst->op == IR_ZEXT || inst->op == IR_TRUNC;
+
+    if (!unary && !ir_op_is_binary((IrOp) inst->op) && !ir_op_is_compare((IrOp) inst->op)) {
+        return SCCP_BOTTOM;
+    }
+
+    SccpState a = (SccpState) s->state[ops[0]];
+    SccpState b = unary ? SCCP_CONST : (SccpState) s->state[ops[1]];
+
+    // anything times or and zero is zero
+    if ((inst->op == IR_MUL || inst->op == IR_AND) &&
+        ((a == SCCP_CONST && s->value[ops[0]] == 0) || (b == SCCP_CONST && s->value[ops[1]] == 0))) {
+        *val = 0;
+        return SCCP_CONST;
+    }
+
+    if (a == SCCP_BOTTOM || b == SCCP_BOTTOM) {
+        return SCCP_BOTTOM;
+    }
+
+    if (a == SCCP_TOP || b == SCCP_TOP) {
+        return SCCP_TOP;
+    }
+
+    int64_t rhs = unary ? 0 : s->value[ops[1]];
+    return sccp_fold(inst, f->insts[ops[0]].ty, s->value[ops[0]], rhs, val) ? SCCP_CONST : SCCP_BOTTOM;
+}
+
+// values only ever move down the lattice, which bounds how often their users are visited again
+void sccp_set(Sccp *s, IrValue v, SccpState st, int64_t val) {
+    SccpState old = (SccpState) s->state[v];
+
+    if (old == SCCP_BOTTOM || st == SCCP_TOP || (old == SCCP_CONST && st == SCCP_CONST && s->value[v] == val)) {
+        return;
+    }
+
+    s->state[v] = old == SCCP_CONST && st == SCCP_CONST ? SCCP_BOTTOM : st;
+    s->value[v] = val;
+    vec_push(&s->value_work, (void *) &v);
+}
+
+void sccp_visit(Sccp *s, IrValue v);
+
+void sccp_mark_edge(Sccp *s, IrBlockId b, uint32_t i) {
+    uint32_t e = s->edge_off[b] + i;
+    IrBlockId to = s->f->blocks[b].succs[i];
+
+    if (s->edge_live[e]) {
+        return;
+    }
+
+    s->edge_live[e] = true;
+
+    if (!s->reachable[to]) {
+        s->reachable[to] = true;
+        vec_push(&s->block_work, (void *) &to);
+        return;
+    }
+
+    // the block was visited already, only its phis see the new edge
+    IrBlock *block = &s->f->blocks[to];
+    uint32_t j = 0;
+
+    while (j < block->num_insts && s->f->insts[block->insts[j]].op == IR_PHI) {
+        sccp_visit(s, block->insts[j]);
+        j++;
+    }
+}
+
+void sccp_visit(Sccp *s, IrValue v) {
+    IrFunc *f = s->f;
+    IrInst *inst = &f->insts[v];
+
+    if (inst->op == IR_BR) {
+        sccp_mark_edge(s, inst->block, 0);
+        return;
+    }
+
+    if (inst->op == IR_CBR) {
+        IrValue cond = inst->u.ops[0];
+
+        if (s->state[cond] == SCCP_CONST) {
+            sccp_mark_edge(s, inst->block, s->value[cond] != 0 ? 0 : 1);
+        } else if (s->state[cond] == SCCP_BOTTOM) {
+            sccp_mark_edge(s, inst->block, 0);
+            sccp_mark_edge(s, inst->block, 1);
+        }
+
+        return;
+    }
+
+    if (inst->ty == IR_TYPE_VOID) {
+        return;
+    }
+
+    int64_t val = 0;
+    SccpState st = sccp_eval(s, v, &val);
+    sccp_set(s, v, st, val);
+}
+
+void sccp_solve(Sccp *s) {
+    IrFunc *f = s->f;
+
+    while (s->block_work.len > 0 || s->value_work.len > 0) {
+        if (s->block_work.len > 0) {
+            IrBlockId b = ((IrBlockId *) s->block_work.elements)[--s->block_work.len];
+            IrBlock *block = &f->blocks[b];
+            uint32_t i = 0;
+
+            while (i < block->num_insts) {
+                sccp_visit(s, block->insts[i]);
+                i++;
+            }
+
+            continue;
+        }
+
+        IrValue v = ((IrValue *) s->value_work.elements)[--s->value_work.len];
+        uint32_t u = s->use_off[v];
+
+        while (u < s->use_off[v + 1]) {
+            if (s->reachable[f->insts[s->users[u]].block]) {
+                sccp_visit(s, s->users[u]);
+            }
+
+            u++;
+        }
+    }
+}
+
+// a branch on a value no executable definition reaches would make both sides dead, it is taken to go either way
+bool sccp_settle_branches(Sccp *s) {
+    IrFunc *f = s->f;
+    bool changed = false;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrValue term = ir_block_terminator(f, b);
+
+        if (s->reachable[b] && term != IR_NO_VALUE && f->insts[term].op == IR_CBR && s->state[f->insts[term].u.ops[0]] == SCCP_TOP) {
+            sccp_set(s, f->insts[term].u.ops[0], SCCP_BOTTOM, 0);
+            changed = true;
+        }
+
+        b++;
+    }
+
+    return changed;
+}
+
+// phis folded into constants move behind the phis that are left
+void sccp_fold_block(Sccp *s, IrBlockId b) {
+    IrFunc *f = s->f;
+    IrBlock *block = &f->blocks[b];
+    uint32_t num_phis = 0;
+    uint32_t i = 0;
+
+    s->phis.len = 0;
+
+    while (i < block->num_insts) {
+        IrValue v = block->insts[i];
+        IrInst *inst = &f->insts[v];
+        bool is_phi = inst->op == IR_PHI;
+
+        if (s->state[v] == SCCP_CONST && inst->op != IR_CONST) {
+            inst->op = IR_CONST;
+            inst->flags &= ~IR_FLAG_EXTRA_OPS;
+            inst->num_ops = 0;
+            memset((void *) inst->u.ops, 0, sizeof(inst->u.ops));
+            inst->imm = s->value[v];
+            s->num_folded++;
+
+            if (is_phi) {
+                vec_push(&s->phis, (void *) &v);
+            }
+        } else if (is_phi) {
+            block->insts[num_phis++] = v;
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < s->phis.len) {
+        block->insts[num_phis + i] = ((IrValue *) s->phis.elements)[i];
+        i++;
+    }
+}
+
+void sccp_rewrite(Sccp *s) {
+    IrFunc *f = s->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrValue term = ir_block_terminator(f, b);
+        IrInst *inst = &f->insts[term];
+
+        if (!s->reachable[b] || term == IR_NO_VALUE || inst->op != IR_CBR || s->state[inst->u.ops[0]] != SCCP_CONST) {
+            b++;
+            continue;
+        }
+
+        uint32_t taken = s->value[inst->u.ops[0]] != 0 ? 0 : 1;
+        IrBlockId target = inst->u.ops[1 + taken];
+
+        ir_remove_incoming(f, b, inst->u.ops[2 - taken]);
+
+        inst = &f->insts[term];
+        inst->op = IR_BR;
+        inst->num_ops = 1;
+        inst->u.ops[0] = target;
+        inst->u.ops[1] = 0;
+        inst->u.ops[2] = 0;
+        s->num_branches++;
+
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+
+        if (s->reachable[b]) {
+            sccp_fold_block(s, b);
+            b++;
+            continue;
+        }
+
+        while (block->num_succs > 0) {
+            ir_remove_incoming(f, b, block->succs[0]);
+        }
+
+        if (block->num_insts == 0) {
+            b++;
+            continue;
+        }
+
+        // the block keeps its terminator as an unreachable, so every block still ends in one
+        IrValue last = block->insts[block->num_insts - 1];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            ir_inst_remove(f, block->insts[i]);
+            i++;
+        }
+
+        f->insts[last].op = IR_UNREACHABLE;
+        f->insts[last].flags = 0;
+        block->insts[0] = last;
+        block->num_insts = 1;
+        s->num_dead_blocks++;
+
+        b++;
+    }
+
+    // the dead blocks only ever had each other as predecessors left
+    b = 0;
+    while (b < f->num_blocks) {
+        f->blocks[b].num_preds = s->reachable[b] ? f->blocks[b].num_preds : 0;
+        b++;
+    }
+}
+
+void sccp_func(Sccp *s, IrFunc *f) {
+    if (f->num_blocks == 0) {
+        return;
+    }
+
+    sccp_reserve(s, f);
+    sccp_collect_users(s);
+
+    s->reachable[0] = true;
+    IrBlockId entry = 0;
+    vec_push(&s->block_work, (void *) &entry);
+
+    sccp_solve(s);
+    while (sccp_settle_branches(s)) {
+        sccp_solve(s);
+    }
+
+    sccp_rewrite(s);
+}
+
+void *sccp_pass_create(IrModule *m, void *params) {
+    (void) m;
+    (void) params;
+
+    Sccp *s = (Sccp *) malloc(sizeof(Sccp));
+    *s = sccp_create();
+
+    return (void *) s;
+}
+
+bool sccp_pass_func(void *state, IrFunc *f) {
+    Sccp *s = (Sccp *) state;
+    int64_t before = s->num_folded + s->num_branches + s->num_dead_blocks;
+
+    sccp_func(s, f);
+
+    return s->num_folded + s->num_branches + s->num_dead_blocks != before;
+}
+
+void sccp_pass_finish(void *state) {
+    Sccp *s = (Sccp *) state;
+
+    timer_stat_add("sccp folded values", s->num_folded);
+    timer_stat_add("sccp folded branches", s->num_branches);
+    timer_stat_add("sccp dead blocks", s->num_dead_blocks);
+
+    sccp_free(s);
+    free((void *) s);
+}
+
+// folded branches take edges out of the CFG
+Pass sccp_pass() {
+    Pass p = {
+        .name = "sccp",
+        .kind = PASS_FUNC,
+        .preserves = 0,
+        .create = sccp_pass_create,
+        .run_func = sccp_pass_func,
+        .finish = sccp_pass_finish
+    };
+
+    return p;
+}
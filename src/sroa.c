@@ -0,0 +1,852 @@
+#include <string.h>
+
+#include "../include/sroa.h"
+#include "../include/timer.h"
+
+Sroa sroa_create(IrModule *m) {
+    Sroa s;
+    memset((void *) &s, 0, sizeof(Sroa));
+
+    s.m = m;
+    s.df_edges = vec_create(sizeof(IrBlockId) * 2);
+    s.leaves = vec_create(sizeof(IrField));
+    s.values = vec_create(sizeof(IrValue));
+    s.accesses = vec_create(sizeof(SroaAccess));
+    s.fields = vec_create(sizeof(SroaField));
+    s.phis = vec_create(sizeof(IrValue));
+    s.work = vec_create(sizeof(IrValue));
+    s.undo = vec_create(sizeof(SroaUndo));
+    s.frames = vec_create(sizeof(SroaFrame));
+
+    return s;
+}
+
+void sroa_free(Sroa *s) {
+    free((void *) s->escaped);
+    free((void *) s->replaced);
+    free((void *) s->field);
+    free((void *) s->repl);
+    free((void *) s->df_off);
+    free((void *) s->has_phi);
+    free((void *) s->queued);
+    free((void *) s->visited);
+    free((void *) s->df);
+    vec_free(&s->df_edges);
+    vec_free(&s->leaves);
+    vec_free(&s->values);
+    vec_free(&s->accesses);
+    vec_free(&s->fields);
+    vec_free(&s->phis);
+    vec_free(&s->work);
+    vec_free(&s->undo);
+    vec_free(&s->frames);
+}
+
+void sroa_grow_values(Sroa *s, uint32_t num_insts) {
+    if (num_insts <= s->cap_insts) {
+        return;
+    }
+
+    s->cap_insts = num_insts * 2;
+    s->escaped = (bool *) realloc((void *) s->escaped, s->cap_insts * sizeof(bool));
+    s->replaced = (bool *) realloc((void *) s->replaced, s->cap_insts * sizeof(bool));
+    s->field = (uint32_t *) realloc((void *) s->field, s->cap_insts * sizeof(uint32_t));
+    s->repl = (IrValue *) realloc((void *) s->repl, s->cap_insts * sizeof(IrValue));
+}
+
+// values made while the function is rewritten start out like the others
+void sroa_track(Sroa *s, IrValue v) {
+    sroa_grow_values(s, v + 1);
+
+    s->escaped[v] = false;
+    s->replaced[v] = false;
+    s->field[v] = SROA_NO_FIELD;
+    s->repl[v] = v;
+}
+
+void sroa_reserve(Sroa *s, IrFunc *f) {
+    sroa_grow_values(s, f->num_insts);
+
+    if (f->num_blocks > s->cap_blocks) {
+        s->cap_blocks = f->num_blocks * 2;
+        s->df_off = (uint32_t *) realloc((void *) s->df_off, (s->cap_blocks + 1) * sizeof(uint32_t));
+        s->has_phi = (uint32_t *) realloc((void *) s->has_phi, s->cap_blocks * sizeof(uint32_t));
+        s->queued = (uint32_t *) realloc((void *) s->queued, s->cap_blocks * sizeof(uint32_t));
+        s->visited = (bool *) realloc((void *) s->visited, s->cap_blocks * sizeof(bool));
+    }
+
+    IrValue v = 0;
+    while (v < f->num_insts) {
+        sroa_track(s, v);
+        v++;
+    }
+
+    memset((void *) s->has_phi, 0, f->num_blocks * sizeof(uint32_t));
+    memset((void *) s->queued, 0, f->num_blocks * sizeof(uint32_t));
+    memset((void *) s->visited, 0, f->num_blocks * sizeof(bool));
+
+    s->f = f;
+    s->stamp = 0;
+    s->df_edges.len = 0;
+    s->accesses.len = 0;
+    s->fields.len = 0;
+    s->phis.len = 0;
+    s->undo.len = 0;
+    s->frames.len = 0;
+}
+
+IrValue sroa_addr(IrFunc *f, IrValue ptr, int64_t *offset) {
+    *offset = 0;
+
+    while (f->insts[ptr].op == IR_OFFSET) {
+        *offset += f->insts[ptr].imm;
+        ptr = f->insts[ptr].u.ops[0];
+    }
+
+    return ptr;
+}
+
+int32_t sroa_cmp_accesses(const void *a, const void *b) {
+    const SroaAccess *x = (const SroaAccess *) a;
+    const SroaAccess *y = (const SroaAccess *) b;
+
+    if (x->slot != y->slot) {
+        return x->slot < y->slot ? -1 : 1;
+    }
+
+    if (x->offset != y->offset) {
+        return x->offset < y->offset ? -1 : 1;
+    }
+
+    if (x->ty != y->ty) {
+        return x->ty < y->ty ? -1 : 1;
+    }
+
+    return x->v < y->v ? -1 : (x->v > y->v ? 1 : 0);
+}
+
+// the number of fields accesses[first..end) of one slot split into, 0 when two of them overlap or one reads
+// past the end
+uint32_t sroa_count_fields(Sroa *s, uint32_t first, uint32_t end) {
+    SroaAccess *accesses = (SroaAccess *) s->accesses.elements;
+    uint32_t size = (uint32_t) s->f->insts[accesses[first].slot].imm;
+    uint32_t count = 0;
+    uint32_t covered = 0;
+    uint32_t i = first;
+
+    while (i < end) {
+        SroaAccess *a = &accesses[i];
+        bool is_same = i > first && a->offset == accesses[i - 1].offset && a->ty == accesses[i - 1].ty;
+        uint32_t a_end = a->offset + ir_type_size(s->m, a->ty);
+
+        if (!is_same && (a->offset < covered || a_end > size)) {
+            return 0;
+        }
+
+        count += is_same ? 0 : 1;
+        covered = a_end > covered ? a_end : covered;
+        i++;
+    }
+
+    return count;
+}
+
+void sroa_add_fields(Sroa *s, uint32_t first, uint32_t end) {
+    SroaAccess *accesses = (SroaAccess *) s->accesses.elements;
+    IrFunc *f = s->f;
+    uint32_t i = first;
+
+    s->replaced[accesses[first].slot] = true;
+    s->num_slots++;
+
+    while (i < end) {
+        SroaAccess *a = &accesses[i];
+
+        if (i == first || a->offset != accesses[i - 1].offset || a->ty != accesses[i - 1].ty) {
+            SroaField field = {
+                .slot = a->slot,
+                .offset = a->offset,
+                .ty = a->ty,
+                .first = i,
+                .end = i,
+                .is_loaded = false,
+                .cur = IR_NO_VALUE,
+                .undef = IR_NO_VALUE
+            };
+
+            vec_push(&s->fields, (void *) &field);
+            s->num_fields++;
+        }
+
+        SroaField *field = (SroaField *) vec_get_ptr(&s->fields, s->fields.len - 1);
+        field->end = i + 1;
+        field->is_loaded |= f->insts[a->v].op == IR_LOAD;
+
+        s->field[a->v] = s->fields.len - 1;
+        s->replaced[a->v] = true;
+        i++;
+    }
+}
+
+// the scalars of a struct at their offsets from its start, with nested structs flattened. false when there are
+// too many of them to be worth splitting a copy for
+bool sroa_leaves(Sroa *s, IrTypeId ty, uint32_t offset) {
+    IrType *type = ir_type_get(s->m, ty);
+    uint32_t i = 0;
+
+    if (type->kind != IR_TY_STRUCT) {
+        IrField leaf = { ty, offset };
+        vec_push(&s->leaves, (void *) &leaf);
+
+        return s->leaves.len <= SROA_MAX_FIELDS;
+    }
+
+    while (i < type->num_fields) {
+        IrField field = *ir_type_field(s->m, ty, i);
+
+        if (!sroa_leaves(s, field.ty, offset + field.offset)) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+IrValue sroa_insert(Sroa *s, IrBlockId b, uint32_t *pos, IrOp op, IrTypeId ty, IrValue a, IrValue c, int64_t imm) {
+    IrFunc *f = s->f;
+    IrValue v = ir_inst_create(f, op, ty, c != IR_NO_VALUE ? 2 : 1);
+
+    f->insts[v].u.ops[0] = a;
+    f->insts[v].u.ops[1] = c;
+    f->insts[v].imm = imm;
+    ir_block_insert(f, b, (*pos)++, v);
+    sroa_track(s, v);
+
+    return v;
+}
+
+IrValue sroa_field_addr(Sroa *s, IrBlockId b, uint32_t *pos, IrValue ptr, uint32_t offset) {
+    return offset == 0 ? ptr : sroa_insert(s, b, pos, IR_OFFSET, IR_TYPE_PTR, ptr, IR_NO_VALUE, offset);
+}
+
+bool sroa_is_candidate(Sroa *s, IrValue ptr) {
+    IrValue base = ir_ptr_base(s->f, ptr);
+
+    return s->f->insts[base].op == IR_ALLOCA && !s->escaped[base];
+}
+
+// all loads come before the stores, in case the two sides overlap
+void sroa_split_copy(Sroa *s, IrBlockId b, uint32_t *pos, IrValue dst, IrValue src) {
+    IrField *leaves = (IrField *) s->leaves.elements;
+    uint32_t i = 0;
+
+    s->values.len = 0;
+
+    while (i < s->leaves.len) {
+        IrValue addr = sroa_field_addr(s, b, pos, src, leaves[i].offset);
+        IrValue v = sroa_insert(s, b, pos, IR_LOAD, leaves[i].ty, addr, IR_NO_VALUE, 0);
+
+        vec_push(&s->values, (void *) &v);
+        i++;
+    }
+
+    i = 0;
+    while (i < s->leaves.len) {
+        IrValue addr = sroa_field_addr(s, b, pos, dst, leaves[i].offset);
+        sroa_insert(s, b, pos, IR_STORE, IR_TYPE_VOID, addr, ((IrValue *) s->values.elements)[i], 0);
+        i++;
+    }
+}
+
+void sroa_split_copies(Sroa *s) {
+    IrFunc *f = s->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        bool split = false;
+        uint32_t i = 0;
+
+        while (i < f->blocks[b].num_insts) {
+            IrValue v = f->blocks[b].insts[i];
+            IrInst inst = f->insts[v];
+            IrTypeId ty = (IrTypeId) (inst.imm >> 32);
+
+            s->leaves.len = 0;
+
+            if (inst.op != IR_MEMCPY || ty == IR_TYPE_VOID) {
+                i++;
+                continue;
+            }
+
+            if (!sroa_is_candidate(s, inst.u.ops[0]) && !sroa_is_candidate(s, inst.u.ops[1])) {
+                i++;
+                continue;
+            }
+
+            if (!sroa_leaves(s, ty, 0)) {
+                i++;
+                continue;
+            }
+
+            sroa_split_copy(s, b, &i, inst.u.ops[0], inst.u.ops[1]);
+            ir_inst_remove(f, v);
+            s->num_copies++;
+            split = true;
+            i++;
+        }
+
+        if (split) {
+            ir_block_compact(f, b);
+        }
+
+        b++;
+    }
+}
+
+// copies that are left read and write the whole slot at once, so their slots are left alone like the escaping
+// ones
+void sroa_collect(Sroa *s) {
+    IrFunc *f = s->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue v = block->insts[i];
+            IrInst *inst = &f->insts[v];
+            int64_t offset = 0;
+            i++;
+
+            if (inst->op == IR_MEMCPY) {
+                s->escaped[ir_ptr_base(f, inst->u.ops[0])] = true;
+                s->escaped[ir_ptr_base(f, inst->u.ops[1])] = true;
+                continue;
+            }
+
+            if (inst->op != IR_LOAD && inst->op != IR_STORE) {
+                continue;
+            }
+
+            IrValue slot = sroa_addr(f, inst->u.ops[0], &offset);
+            IrTypeId ty = inst->op == IR_LOAD ? inst->ty : f->insts[inst->u.ops[1]].ty;
+
+            if (f->insts[slot].op != IR_ALLOCA) {
+                continue;
+            }
+
+            if (offset < 0 || offset > UINT32_MAX) {
+                s->escaped[slot] = true;
+                continue;
+            }
+
+            SroaAccess access = {
+                .slot = slot,
+                .offset = (uint32_t) offset,
+                .ty = ty,
+                .v = v
+            };
+
+            vec_push(&s->accesses, (void *) &access);
+        }
+
+        b++;
+    }
+
+    if (s->accesses.len == 0) {
+        return;
+    }
+
+    qsort(s->accesses.elements, s->accesses.len, sizeof(SroaAccess), sroa_cmp_accesses);
+
+    uint32_t first = 0;
+    while (first < s->accesses.len) {
+        SroaAccess *accesses = (SroaAccess *) s->accesses.elements;
+        IrValue slot = accesses[first].slot;
+        uint32_t end = first;
+
+        while (end < s->accesses.len && accesses[end].slot == slot) {
+            end++;
+        }
+
+        uint32_t count = s->escaped[slot] ? 0 : sroa_count_fields(s, first, end);
+
+        if (count > 0 && count <= SROA_MAX_FIELDS) {
+            sroa_add_fields(s, first, end);
+        }
+
+        first = end;
+    }
+}
+
+// Cooper, Harvey and Kennedy: a join is in the frontier of every block from each of its predecessors up to,
+// but not including, its immediate dominator
+void sroa_frontiers(Sroa *s) {
+    IrFunc *f = s->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (block->num_preds >= 2 && block->idom != IR_NO_BLOCK && i < block->num_preds) {
+            IrBlockId runner = block->preds[i];
+
+            while (f->blocks[runner].idom != IR_NO_BLOCK && runner != block->idom) {
+                IrBlockId edge[2] = { runner, b };
+                vec_push(&s->df_edges, (void *) edge);
+                runner = f->blocks[runner].idom;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    if (s->df_edges.len > s->cap_df) {
+        s->cap_df = s->df_edges.len * 2;
+        s->df = (IrBlockId *) realloc((void *) s->df, s->cap_df * sizeof(IrBlockId));
+    }
+
+    IrBlockId *edges = (IrBlockId *) s->df_edges.elements;
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    memset((void *) s->df_off, 0, (f->num_blocks + 1) * sizeof(uint32_t));
+
+    while (i < s->df_edges.len) {
+        s->df_off[edges[i * 2]]++;
+        i++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        total += s->df_off[b];
+        s->df_off[b] = total;
+        b++;
+    }
+
+    s->df_off[f->num_blocks] = total;
+
+    while (i > 0) {
+        i--;
+        s->df[--s->df_off[edges[i * 2]]] = edges[i * 2 + 1];
+    }
+}
+
+void sroa_push_block(Sroa *s, IrBlockId b) {
+    if (s->queued[b] != s->stamp) {
+        s->queued[b] = s->stamp;
+        vec_push(&s->work, (void *) &b);
+    }
+}
+
+// fields nobody loads need no phis, their stores go away with the slot
+void sroa_place_phis(Sroa *s) {
+    IrFunc *f = s->f;
+    uint32_t k = 0;
+
+    while (k < s->fields.len) {
+        SroaField field = *(SroaField *) vec_get_ptr(&s->fields, k);
+        SroaAccess *accesses = (SroaAccess *) s->accesses.elements;
+        uint32_t i = field.first;
+
+        s->stamp++;
+        s->work.len = 0;
+
+        while (field.is_loaded && i < field.end) {
+            if (f->insts[accesses[i].v].op == IR_STORE) {
+                sroa_push_block(s, f->insts[accesses[i].v].block);
+            }
+
+            i++;
+        }
+
+        while (s->work.len > 0) {
+            IrBlockId b = ((IrBlockId *) s->work.elements)[--s->work.len];
+            uint32_t j = s->df_off[b];
+
+            while (j < s->df_off[b + 1]) {
+                IrBlockId d = s->df[j];
+                j++;
+
+                if (s->has_phi[d] == s->stamp) {
+                    continue;
+                }
+
+                IrValue phi = ir_build_phi_in(f, d, field.ty, f->blocks[d].num_preds);
+                sroa_track(s, phi);
+                s->field[phi] = k;
+                s->has_phi[d] = s->stamp;
+                vec_push(&s->phis, (void *) &phi);
+                sroa_push_block(s, d);
+            }
+        }
+
+        k++;
+    }
+}
+
+// reads before any store see a zero, made once per field at the start of the entry block
+IrValue sroa_undef(Sroa *s, uint32_t k) {
+    IrFunc *f = s->f;
+    SroaField *field = (SroaField *) vec_get_ptr(&s->fields, k);
+
+    if (field->undef == IR_NO_VALUE) {
+        IrValue v = ir_inst_create(f, IR_CONST, field->ty, 0);
+        ir_block_insert(f, 0, 0, v);
+        sroa_track(s, v);
+        field->undef = v;
+    }
+
+    return field->undef;
+}
+
+IrValue sroa_current(Sroa *s, uint32_t k) {
+    SroaField *field = (SroaField *) vec_get_ptr(&s->fields, k);
+
+    return field->cur != IR_NO_VALUE ? field->cur : sroa_undef(s, k);
+}
+
+IrValue sroa_find(Sroa *s, IrValue v) {
+    while (s->repl[v] != v) {
+        v = s->repl[v];
+    }
+
+    return v;
+}
+
+void sroa_set(Sroa *s, uint32_t k, IrValue v) {
+    SroaField *field = (SroaField *) vec_get_ptr(&s->fields, k);
+    SroaUndo undo = { k, field->cur };
+
+    vec_push(&s->undo, (void *) &undo);
+    field->cur = v;
+}
+
+void sroa_enter(Sroa *s, IrBlockId b) {
+    IrFunc *f = s->f;
+    uint32_t i = 0;
+
+    SroaFrame frame = {
+        .b = b,
+        .next_child = s->f->dom_child_off[b],
+        .num_undo = s->undo.len
+    };
+
+    vec_push(&s->frames, (void *) &frame);
+    s->visited[b] = true;
+
+    while (i < f->blocks[b].num_insts) {
+        IrValue v = f->blocks[b].insts[i];
+        uint32_t k = s->field[v];
+        uint32_t num_entry = f->blocks[0].num_insts;
+        i++;
+
+        if (k == SROA_NO_FIELD) {
+            continue;
+        }
+
+        switch (f->insts[v].op) {
+            case IR_PHI: {
+                sroa_set(s, k, v);
+                break;
+            }
+
+            case IR_LOAD: {
+                s->repl[v] = sroa_current(s, k);
+
+                // an undef made in front of this very block moves the rest of it back by one
+                i += b == 0 ? f->blocks[0].num_insts - num_entry : 0;
+                break;
+            }
+
+            case IR_STORE: {
+                sroa_set(s, k, sroa_find(s, f->insts[v].u.ops[1]));
+                break;
+            }
+
+            default: {
+                break;
+            }
+        }
+    }
+
+    i = 0;
+    while (i < f->blocks[b].num_succs) {
+        IrBlockId d = f->blocks[b].succs[i];
+        uint32_t p = 0;
+        i++;
+
+        while (p < f->blocks[d].num_preds) {
+            uint32_t j = 0;
+
+            while (f->blocks[d].preds[p] == b && j < f->blocks[d].num_insts && f->insts[f->blocks[d].insts[j]].op == IR_PHI) {
+                IrValue phi = f->blocks[d].insts[j];
+
+                if (s->field[phi] != SROA_NO_FIELD) {
+                    IrValue value = sroa_current(s, s->field[phi]);
+                    ir_inst_ops(f, &f->insts[phi])[p] = value;
+                }
+
+                j++;
+            }
+
+            p++;
+        }
+    }
+}
+
+void sroa_leave(Sroa *s, SroaFrame *frame) {
+    while (s->undo.len > frame->num_undo) {
+        SroaUndo *undo = &((SroaUndo *) s->undo.elements)[--s->undo.len];
+        ((SroaField *) vec_get_ptr(&s->fields, undo->field))->cur = undo->old;
+    }
+}
+
+void sroa_rename(Sroa *s) {
+    IrFunc *f = s->f;
+
+    sroa_enter(s, 0);
+
+    while (s->frames.len > 0) {
+        SroaFrame *frame = (SroaFrame *) vec_get_ptr(&s->frames, s->frames.len - 1);
+
+        if (frame->next_child < s->f->dom_child_off[frame->b + 1]) {
+            IrBlockId child = s->f->dom_children[frame->next_child++];
+            sroa_enter(s, child);
+            continue;
+        }
+
+        SroaFrame done = *frame;
+        s->frames.len--;
+        sroa_leave(s, &done);
+    }
+
+    // loads the walk never reached cannot run, and phi operands from such blocks are never taken
+    IrBlockId b = 0;
+    while (b < f->num_blocks) {
+        uint32_t i = 0;
+
+        while (!s->visited[b] && i < f->blocks[b].num_insts) {
+            IrValue v = f->blocks[b].insts[i];
+
+            if (s->field[v] != SROA_NO_FIELD && f->insts[v].op == IR_LOAD) {
+                s->repl[v] = sroa_undef(s, s->field[v]);
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    uint32_t i = 0;
+    while (i < s->phis.len) {
+        IrValue phi = ((IrValue *) s->phis.elements)[i];
+        uint32_t j = 0;
+
+        while (j < f->insts[phi].num_ops) {
+            if (ir_inst_ops(f, &f->insts[phi])[j] == IR_NO_VALUE) {
+                IrValue value = sroa_undef(s, s->field[phi]);
+                ir_inst_ops(f, &f->insts[phi])[j] = value;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+}
+
+bool sroa_is_phi(Sroa *s, IrValue v) {
+    return s->field[v] != SROA_NO_FIELD && s->f->insts[v].op == IR_PHI;
+}
+
+void sroa_mark_live(Sroa *s, IrValue v) {
+    if (sroa_is_phi(s, v) && !s->escaped[v]) {
+        s->escaped[v] = true;
+        vec_push(&s->work, (void *) &v);
+    }
+}
+
+// a phi stays when something other than the new phis reads it, escaped is reused as the mark
+void sroa_prune_phis(Sroa *s) {
+    IrFunc *f = s->f;
+    IrBlockId b = 0;
+
+    s->work.len = 0;
+
+    while (b < f->num_blocks) {
+        uint32_t i = 0;
+
+        while (i < f->blocks[b].num_insts) {
+            IrValue v = f->blocks[b].insts[i];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (!sroa_is_phi(s, v) && inst->op != IR_NOP && j < n) {
+                sroa_mark_live(s, ops[j]);
+                j++;
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    while (s->work.len > 0) {
+        IrValue phi = ((IrValue *) s->work.elements)[--s->work.len];
+        uint32_t j = 0;
+
+        while (j < f->insts[phi].num_ops) {
+            sroa_mark_live(s, ir_inst_ops(f, &f->insts[phi])[j]);
+            j++;
+        }
+    }
+
+    uint32_t i = 0;
+    while (i < s->phis.len) {
+        IrValue phi = ((IrValue *) s->phis.elements)[i];
+
+        if (s->escaped[phi]) {
+            s->num_phis++;
+        } else {
+            ir_inst_remove(f, phi);
+        }
+
+        i++;
+    }
+}
+
+// offsets into a replaced slot are marked before anything is removed, their chains still lead back to it. a
+// replaced load is marked too, but an offset into the pointer it loaded stays
+void sroa_rewrite(Sroa *s) {
+    IrFunc *f = s->f;
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        uint32_t i = 0;
+
+        while (i < f->blocks[b].num_insts) {
+            IrValue v = f->blocks[b].insts[i];
+
+            if (f->insts[v].op == IR_OFFSET) {
+                IrValue base = ir_ptr_base(f, v);
+                s->replaced[v] = f->insts[base].op == IR_ALLOCA && s->replaced[base];
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    b = 0;
+    while (b < f->num_blocks) {
+        uint32_t i = 0;
+
+        while (i < f->blocks[b].num_insts) {
+            IrValue v = f->blocks[b].insts[i];
+            IrInst *inst = &f->insts[v];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                ops[j] = sroa_find(s, ops[j]);
+                j++;
+            }
+
+            if (s->replaced[v]) {
+                ir_inst_remove(f, v);
+            }
+
+            i++;
+        }
+
+        b++;
+    }
+
+    sroa_prune_phis(s);
+
+    b = 0;
+    while (b < f->num_blocks) {
+        ir_block_compact(f, b);
+        b++;
+    }
+}
+
+void sroa_func(Sroa *s, IrFunc *f) {
+    if (f->num_blocks == 0) {
+        return;
+    }
+
+    sroa_reserve(s, f);
+    ir_find_escaping_slots(f, s->escaped);
+    sroa_split_copies(s);
+    sroa_collect(s);
+
+    if (s->fields.len == 0) {
+        return;
+    }
+
+    ir_func_dominators(f);
+    sroa_frontiers(s);
+
+    // escaped marks the live phis from here on
+    sroa_place_phis(s);
+    sroa_rename(s);
+    sroa_rewrite(s);
+}
+
+void *sroa_pass_create(IrModule *m, void *params) {
+    (void) params;
+
+    Sroa *s = (Sroa *) malloc(sizeof(Sroa));
+    *s = sroa_create(m);
+
+    return (void *) s;
+}
+
+bool sroa_pass_func(void *state, IrFunc *f) {
+    Sroa *s = (Sroa *) state;
+    int64_t before = s->num_copies + s->num_slots;
+
+    sroa_func(s, f);
+
+    return s->num_copies + s->num_slots != before;
+}
+
+void sroa_pass_finish(void *state) {
+    Sroa *s = (Sroa *) state;
+
+    timer_stat_add("sroa split copies", s->num_copies);
+    timer_stat_add("sroa replaced slots", s->num_slots);
+    timer_stat_add("sroa scalars", s->num_fields);
+    timer_stat_add("sroa phis", s->num_phis);
+
+    sroa_free(s);
+    free((void *) s);
+}
+
+// the phis go into the blocks that are there
+Pass sroa_pass() {
+    Pass p = {
+        .name = "sroa",
+        .kind = PASS_FUNC,
+        .preserves = IR_ANALYSIS_ALL,
+        .create = sroa_pass_create,
+        .run_func = sroa_pass_func,
+        .finish = sroa_pass_finish
+    };
+
+    return p;
+}
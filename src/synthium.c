@@ -1,28 +1,69 @@
+#include "../include/vm.h"
+#include "../include/repl.h"
 #include "../include/ty.h"
 #include "../include/ast.h"
 #include "../include/mod.h"
+#include "../include/cemit.h"
+#include "../include/escape.h"
+#include "../include/gvn.h"
+#include "../include/inliner.h"
+#include "../include/loop.h"
+#include "../include/sccp.h"
+#include "../include/sroa.h"
+#include "../include/tailcall.h"
+#include "../include/pass.h"
+#include "../include/pool.h"
+#include "../include/lower.h"
+#include "../include/codegen.h"
 #include "../include/span.h"
 #include "../include/path.h"
 #include "../include/tyid.h"
+#include "../include/timer.h"
+#include "../include/trace.h"
 #include "../include/reader.h"
 #include "../include/ptrvec.h"
 #include "../include/source.h"
 #include "../include/record.h"
 #include "../include/parser.h"
+#include "../include/profile.h"
+#include "../include/options.h"
+#include "../include/timetrace.h"
 #include "../include/typecheck.h"
 
 void synthium_print_debug_stmt_info(Stmt *s, SpanInterner *si);
 void synthium_print_debug_mod_info(Module *mod, SpanInterner *si);
 void synthium_print_parse_errors(Parser *p, SpanInterner *si, FileMap *fm, Path *abs_path);
 void synthium_print_type_errors(TypeChecker *tc, SpanInterner *si, FileMap *fm, Path *abs_path);
+void synthium_print_tailcall_errors(Vec *errors, SpanInterner *si, FileMap *fm, Path *abs_path);
 void synthium_print_error(const char *err_text, BigSpan *span, SourceFile *file, Path *abs_path);
+void synthium_count_input(FileMap *fm);
+void synthium_write_time_report(Options *opts);
+int32_t synthium_verify_ir(IrModule *ir);
+int32_t synthium_optimize(IrModule *ir, Options *opts, Pool *pool, Vec *errors);
+bool synthium_write_object(IrModule *ir, const char *path, int32_t opt_level, Pool *pool);
+int32_t synthium_run(IrModule *ir, Options *opts, int32_t *exit_code);
 
 int main(int argc, char **argv) {
-    if (argc <= 1) {
+    trace_init();
+
+    Options opts = options_empty();
+    if (!options_parse(&opts, argc - 1, (const char **) argv + 1)) {
+        options_free(&opts);
+        return -1;
+    }
+
+    if (opts.num_files <= 0 && !opts.repl) {
         printf("[error] no input files\n");
+        options_free(&opts);
         return -1;
     }
 
+    timer_init(opts.time_report != REPORT_NONE);
+    timetrace_init(opts.time_trace_file);
+    timetrace_set_thread_name("main");
+
+    int32_t tt = TIMETRACE_BEGIN("compile", 0, NULL, 0, NULL);
+
     Path rel_compiler_path = path_empty();
     path_from_str(*argv, &rel_compiler_path);
 
@@ -31,14 +72,31 @@ int main(int argc, char **argv) {
 
     if (error != 0) {
         printf("[error] %s\n", strerror(error));
+        options_free(&opts);
         return -1;
     }
 
     Path compiler_path = path_parent(&abs_compiler_path.inner);
+
+    if (opts.repl) {
+        int32_t repl_errs = repl_run(&compiler_path, opts.num_files, opts.files, opts.jit);
+
+        path_free(&abs_compiler_path);
+        timetrace_free();
+        timer_free();
+        options_free(&opts);
+
+        return repl_errs;
+    }
+
     int32_t num_total_errs = 0;
+    int32_t exit_code = 0;
     SpanInterner span_interner = span_create_interner();
     FileMap file_map = reader_create();
+
+    timer_phase_begin(PHASE_STDLIB_LOAD);
     FileAddResult res = reader_add_std_lib(&file_map, &compiler_path);
+    timer_phase_end(PHASE_STDLIB_LOAD);
 
     if (res.err_code != 0) {
         const char *err_msg = error_err2str(res.err_code, res.file_name);
@@ -47,11 +105,15 @@ int main(int argc, char **argv) {
 
         reader_free_fm(&file_map);
         path_free(&abs_compiler_path);
+        options_free(&opts);
 
         return -2;
     }
 
-    res = reader_add_all(&file_map, &compiler_path, argc - 1, (const char **) argv + 1);
+    timer_phase_begin(PHASE_FILE_LOAD);
+    res = reader_add_all(&file_map, &compiler_path, opts.num_files, opts.files);
+    timer_phase_end(PHASE_FILE_LOAD);
+
     if (res.err_code != 0) {
         const char *err_msg = error_err2str(res.err_code, res.file_name);
         printf("[error] %s\n", err_msg);
@@ -59,35 +121,50 @@ int main(int argc, char **argv) {
 
         reader_free_fm(&file_map);
         path_free(&abs_compiler_path);
+        options_free(&opts);
 
         return -2;
     }
 
+    if (timer_enabled) {
+        synthium_count_input(&file_map);
+    }
+
     ModuleMap mm = mod_map_with_cap(reader_num_files(&file_map));
     int32_t i = 0;
 
     while (i < reader_num_files(&file_map)) {
         SourceFile src = reader_get_by_idx(&file_map, i);
         Parser p = parser_create(src, &span_interner, i);
+
+        timer_lex_ns = 0;
+        timer_phase_begin(PHASE_PARSE);
         Module *mod = parser_parse(&p);
+        timer_phase_end(PHASE_PARSE);
+        timer_phase_add_nested(PHASE_LEX, PHASE_PARSE, timer_lex_ns);
+        timer_stat_add("tokens", p.lexer.num_tokens);
 
         int32_t num_errs = parser_num_errs(&p);
         num_total_errs += num_errs;
 
         if (num_errs > 0) {
+            timer_phase_begin(PHASE_DIAGNOSTICS);
             printf("%d parse errors found\n", num_errs);
             synthium_print_parse_errors(&p, &span_interner, &file_map, &compiler_path);
+            timer_phase_end(PHASE_DIAGNOSTICS);
         }
 
         mod_add_mod(&mm, mod);
 
-        synthium_print_debug_mod_info(mod, &span_interner);
+        if (TRACE_IS_ENABLED(TRACE_CAT_AST, TRACE_LEVEL_DEBUG)) {
+            synthium_print_debug_mod_info(mod, &span_interner);
+        }
 
         Stmt *s = mod_get_stmt_at(mod, 0);
-        if (s != NULL) {
-            synthium_print_debug_stmt_info(s, &span_interner);
-        } else {
+        if (s == NULL) {
             printf("[error] no valid statements in file\n");
+        } else if (TRACE_IS_ENABLED(TRACE_CAT_AST, TRACE_LEVEL_DEBUG)) {
+            synthium_print_debug_stmt_info(s, &span_interner);
         }
 
         parser_free_p(&p);
@@ -95,44 +172,336 @@ int main(int argc, char **argv) {
         i++;
     }
 
+    timer_phase_begin(PHASE_MOD_SORT);
     TypeChecker tc = typecheck_create(&span_interner, &mm);
+    timer_phase_end(PHASE_MOD_SORT);
+
+    timer_phase_begin(PHASE_TYPECHECK);
     typecheck_check(&tc);
+    timer_phase_end(PHASE_TYPECHECK);
 
     int32_t num_errs = typecheck_num_errs(&tc);
     num_total_errs += num_errs;
 
     if (num_errs > 0) {
+        timer_phase_begin(PHASE_DIAGNOSTICS);
         printf("%d type errors found\n", num_errs);
         synthium_print_type_errors(&tc, &span_interner, &file_map, &compiler_path);
+        timer_phase_end(PHASE_DIAGNOSTICS);
+    }
+
+    IrModule ir = ir_module_create();
+    Vec tailcall_errors = vec_create(sizeof(TailCallError));
+
+    // whether a `become` can be a tail call is only known on the IR, so a program using one is lowered for the
+    // tail call pass to check it before its C is written
+    if (num_total_errs == 0 && opts.emit == EMIT_C && tc.num_become > 0) {
+        timer_phase_begin(PHASE_LOWER);
+        Lowerer lowerer = lower_create(&ir, &mm, &span_interner);
+        lower_all(&lowerer);
+        lower_free(&lowerer);
+        timer_phase_end(PHASE_LOWER);
+
+        num_total_errs += tailcall_check_module(&ir, &tailcall_errors);
+        synthium_print_tailcall_errors(&tailcall_errors, &span_interner, &file_map, &compiler_path);
+    }
+
+    // the C emitter reads the typed AST directly, so it needs neither the IR nor the native backends
+    if (num_total_errs == 0 && opts.emit == EMIT_C) {
+        timer_phase_begin(PHASE_EMIT_C);
+        CEmitter emitter = cemit_create(&mm, &span_interner);
+        bool ok = cemit_all(&emitter, opts.output_file);
+        cemit_free(&emitter);
+        timer_phase_end(PHASE_EMIT_C);
+
+        if (!ok) {
+            printf("[error] could not write C files to '%s': %s\n", opts.output_file, strerror(errno));
+            num_total_errs++;
+        }
+    }
+
+    // lowering reads the types owned by the type checker, so it has to run before the checker is freed
+    if (num_total_errs == 0 && opts.emit != EMIT_C) {
+        timer_phase_begin(PHASE_LOWER);
+        Lowerer lowerer = lower_create(&ir, &mm, &span_interner);
+        lower_all(&lowerer);
+        lower_free(&lowerer);
+        timer_phase_end(PHASE_LOWER);
+
+        // both see the CFG exactly as lowering left it, which is what profiles are matched by
+        if (opts.profile_use != NULL) {
+            Profile profile = profile_create();
+
+            if (profile_read(&profile, opts.profile_use)) {
+                profile_apply_module(&ir, &profile);
+            } else {
+                printf("[error] could not read profile '%s': %s\n", opts.profile_use, strerror(errno));
+                num_total_errs++;
+            }
+
+            profile_free(&profile);
+        }
+
+        if (opts.profile_generate != NULL) {
+            profile_instrument_module(&ir, opts.profile_generate);
+        }
+
+        // the optimiser and the backend share the threads
+        Pool *pool = pool_create(opts.jobs > 0 ? (uint32_t) opts.jobs : pool_num_cpus());
+
+        num_total_errs += synthium_optimize(&ir, &opts, pool, &tailcall_errors);
+        synthium_print_tailcall_errors(&tailcall_errors, &span_interner, &file_map, &compiler_path);
+
+        if (opts.verify_ir) {
+            num_total_errs += synthium_verify_ir(&ir);
+        }
+
+        if (opts.emit == EMIT_IR) {
+            ir_dump_module(stdout, &ir);
+        }
+
+        if (num_total_errs == 0 && opts.emit == EMIT_OBJ && !synthium_write_object(&ir, opts.output_file, opts.opt_level, pool)) {
+            printf("[error] could not write '%s': %s\n", opts.output_file, strerror(errno));
+            num_total_errs++;
+        }
+
+        pool_free(pool);
+
+        if (num_total_errs == 0 && (opts.run || opts.emit == EMIT_BYTECODE)) {
+            num_total_errs += synthium_run(&ir, &opts, &exit_code);
+        }
     }
 
+    timer_phase_begin(PHASE_TEARDOWN);
+    vec_free(&tailcall_errors);
+    ir_module_free(&ir);
     typecheck_free_tc(&tc);
     reader_free_fm(&file_map);
     mod_free_map(&mm);
+    span_free_interner(&span_interner);
     path_free(&abs_compiler_path);
+    timer_phase_end(PHASE_TEARDOWN);
+
+    TIMETRACE_END(tt);
+
+    synthium_write_time_report(&opts);
+
+    if (!timetrace_write()) {
+        printf("[error] could not write time trace to '%s'\n", opts.time_trace_file);
+    }
+
+    timetrace_free();
+    timer_free();
+    options_free(&opts);
+
+    return num_total_errs > 0 ? num_total_errs : exit_code;
+}
+
+void synthium_count_input(FileMap *fm) {
+    int64_t lines = 0;
+    int64_t bytes = 0;
+    int32_t i = 0;
+
+    while (i < reader_num_files(fm)) {
+        SourceFile *src = reader_get_ptr_by_idx(fm, i);
+        const char *ptr = src->code;
+
+        while ((ptr = strchr(ptr, '\n')) != NULL) {
+            lines++;
+            ptr++;
+        }
+
+        bytes += strlen(src->code);
+        i++;
+    }
+
+    timer_stat_add("files", reader_num_files(fm));
+    timer_stat_add("lines", lines);
+    timer_stat_add("bytes", bytes);
+}
 
-    return num_total_errs;
+int32_t synthium_verify_ir(IrModule *ir) {
+    Ptrvec errors = ptrvec_create();
+    int32_t num_errs = ir_verify_module(ir, &errors);
+    int32_t i = 0;
+
+    while (i < errors.len) {
+        const char *err = (const char *) ptrvec_get(&errors, i);
+        printf("[error] invalid IR %s\n", err);
+        free((void *) err);
+
+        i++;
+    }
+
+    ptrvec_free(&errors);
+
+    return num_errs;
+}
+
+// the calls of a `become` are checked before any pass runs and are tail calls at every level, everything else only
+// runs when optimising. returns the number of `become` calls that could not be tail calls, errors gets one for each
+int32_t synthium_optimize(IrModule *ir, Options *opts, Pool *pool, Vec *errors) {
+    int32_t num_errs = errors->len;
+
+    if (tailcall_check_module(ir, errors) > 0) {
+        return errors->len - num_errs;
+    }
+
+    TailCallParams tail_params = {
+        .opt_level = opts->opt_level,
+        .errors = errors
+    };
+
+    if (opts->opt_level >= 1) {
+        InlineParams inline_params = inliner_params(opts->opt_level, opts->inline_threshold);
+        LoopParams loop_params = {
+            .opt_level = opts->opt_level,
+            .vectorize = !opts->run && (opts->emit == EMIT_OBJ || opts->emit == EMIT_IR)
+        };
+
+        timer_phase_begin(PHASE_OPTIMIZE);
+        PassManager pm = pass_manager_create(ir, pool);
+
+        pass_manager_add(&pm, inliner_pass(&inline_params));
+        pass_manager_add(&pm, escape_pass());
+        pass_manager_add(&pm, sroa_pass());
+        pass_manager_add(&pm, tailcall_pass(&tail_params));
+        pass_manager_add(&pm, sccp_pass());
+        pass_manager_add(&pm, gvn_pass());
+        pass_manager_add(&pm, loop_pass(&loop_params));
+
+        // the unrolled copies repeat the address and index arithmetic of each other
+        if (opts->opt_level >= 2) {
+            pass_manager_add(&pm, gvn_pass());
+        }
+
+        pass_manager_run(&pm);
+        pass_manager_free(&pm);
+        timer_phase_end(PHASE_OPTIMIZE);
+    } else {
+        tailcall_module(ir, opts->opt_level, errors);
+    }
+
+    return errors->len - num_errs;
+}
+
+bool synthium_write_object(IrModule *ir, const char *path, int32_t opt_level, Pool *pool) {
+    timer_phase_begin(PHASE_CODEGEN);
+    ElfWriter elf = elf_create();
+    Codegen codegen = codegen_create(ir, &elf, opt_level, pool);
+    codegen_module(&codegen);
+    codegen_free(&codegen);
+    timer_phase_end(PHASE_CODEGEN);
+
+    bool ok = elf_write(&elf, path);
+    elf_free(&elf);
+
+    return ok;
+}
+
+// main gets the first input file as argv[0], followed by the arguments after `--`. the exit code is what main returns
+int32_t synthium_run(IrModule *ir, Options *opts, int32_t *exit_code) {
+    timer_phase_begin(PHASE_BYTECODE);
+    BcModule bc = bc_compile(ir);
+    timer_phase_end(PHASE_BYTECODE);
+
+    timer_stat_add("bytecode insts", bc.num_insts);
+    timer_stat_add("fused insts", bc.num_fused);
+
+    if (opts->emit == EMIT_BYTECODE) {
+        bc_dump_module(stdout, &bc);
+    }
+
+    BcFunc *main_func = bc_lookup(&bc, "main");
+    int32_t num_errs = 0;
+
+    if (opts->run && main_func == NULL) {
+        printf("[error] there is no main function to run\n");
+        num_errs++;
+    } else if (opts->run) {
+        const char **argv = (const char **) malloc((opts->num_run_args + 2) * sizeof(const char *));
+        int32_t argc = 0;
+
+        argv[argc++] = opts->files[0];
+
+        while (argc <= opts->num_run_args) {
+            argv[argc] = opts->run_args[argc - 1];
+            argc++;
+        }
+
+        argv[argc] = NULL;
+
+        int64_t args[2] = { argc, (int64_t) (intptr_t) argv };
+        int64_t result = 0;
+
+        timer_phase_begin(PHASE_RUN);
+        Vm vm = vm_create(&bc, opts->jit);
+        bool ok = vm_call(&vm, main_func, args, 2, &result);
+        fflush(stdout);
+        timer_phase_end(PHASE_RUN);
+
+        if (ok) {
+            *exit_code = (int32_t) result;
+        } else {
+            printf("[error] runtime error in '%s': %s\n", vm.error_func, vm.error);
+            num_errs++;
+        }
+
+        vm_free(&vm);
+        free((void *) argv);
+    }
+
+    bc_free(&bc);
+
+    return num_errs;
+}
+
+void synthium_write_time_report(Options *opts) {
+    if (opts->time_report == REPORT_NONE) {
+        return;
+    }
+
+    FILE *out = stderr;
+
+    if (opts->time_report_file != NULL) {
+        out = fopen(opts->time_report_file, "w");
+
+        if (out == NULL) {
+            printf("[error] could not open '%s': %s\n", opts->time_report_file, strerror(errno));
+            return;
+        }
+    }
+
+    if (opts->time_report == REPORT_JSON) {
+        timer_print_json(out);
+    } else {
+        timer_print_table(out);
+    }
+
+    if (out != stderr) {
+        fclose(out);
+    }
 }
 
 void synthium_print_debug_stmt_info(Stmt *s, SpanInterner *si) {
     bool is_expr = ast_is_expr_stmt(s);
-    printf("is expr? %d\n", is_expr);
+    TRACE_DEBUG(TRACE_CAT_AST, "is expr? %d", is_expr);
 
     if (is_expr) {
         Expr *e = ast_as_expr_stmt(s)->expr;
         
         const char *s = ast_expr_to_string(e, si);
-        printf("%s\n", s);
+        TRACE_DEBUG(TRACE_CAT_AST, "%s", s);
         free((void *) s);
 
         if (ast_is_int_expr(e)) {
-            printf("[error] todo\n");
+            TRACE_DEBUG(TRACE_CAT_AST, "int expressions are not evaluated yet");
         }
     } else if (ast_is_struct_decl_stmt(s)) {
         StructDeclStmt *decl_s = ast_as_struct_decl_stmt(s);
         
         const char *s = record_to_string(&decl_s->decl, si);
-        printf("%s\n", s);
+        TRACE_DEBUG(TRACE_CAT_AST, "%s", s);
         free((void *) s);
     } else if (ast_is_let_stmt(s)) {
         LetStmt *ls = ast_as_let_stmt(s);
@@ -150,7 +519,7 @@ void synthium_print_debug_stmt_info(Stmt *s, SpanInterner *si) {
             free((void *) tys);
         }
 
-        printf("let %.*s%s = %s;\n", ident_len, ident, ty, value);
+        TRACE_DEBUG(TRACE_CAT_AST, "let %.*s%s = %s;", ident_len, ident, ty != NULL ? ty : "", value);
         free((void *) value);
         free((void *) ty);
     }
@@ -164,29 +533,29 @@ void synthium_print_debug_mod_info(Module *mod, SpanInterner *si) {
         ImportStmt *is = mod_get_import_at(mod, j);
         
         const char *s = ident_to_string(&is->mod, si);
-        printf("import '%s';\n", s);
+        TRACE_DEBUG(TRACE_CAT_AST, "import '%s';", s);
         free((void *) s);
 
         j++;
     }
 
-    printf("%d functions\n", mod_num_functions(mod));
+    TRACE_DEBUG(TRACE_CAT_AST, "%d functions", mod_num_functions(mod));
     if (mod_num_functions(mod) > 0) {
         FuncDeclStmt *first = mod_get_function_at(mod, 0);
 
         const char *s = type_to_string(&first->decl.ret_ty, si);
         const char *name = ident_to_string(&first->decl.name, si);
-        printf("fn %s: %s\n", name, s);
+        TRACE_DEBUG(TRACE_CAT_AST, "fn %s: %s", name, s);
         free((void *) s);
         free((void *) name);
     }
 
-    printf("%d structs\n", mod_num_structs(mod));
+    TRACE_DEBUG(TRACE_CAT_AST, "%d structs", mod_num_structs(mod));
     if (mod_num_structs(mod) > 0) {
         StructDeclStmt *first = mod_get_struct_at(mod, 0);
 
         const char *s = record_to_string(&first->decl, si);
-        printf("%s\n", s);
+        TRACE_DEBUG(TRACE_CAT_AST, "%s", s);
         free((void *) s);
     }
 }
@@ -217,6 +586,23 @@ void synthium_print_type_errors(TypeChecker *tc, SpanInterner *si, FileMap *fm,
     }
 }
 
+// frees the texts of the errors as it goes, the vec is left empty
+void synthium_print_tailcall_errors(Vec *errors, SpanInterner *si, FileMap *fm, Path *abs_path) {
+    uint32_t i = 0;
+    while (i < errors->len) {
+        TailCallError *err = (TailCallError *) vec_get_ptr(errors, i);
+        BigSpan span = span_get(si, err->span);
+        SourceFile src = reader_get_by_idx(fm, span.ctx);
+
+        synthium_print_error(err->text, &span, &src, abs_path);
+        free((void *) err->text);
+
+        i++;
+    }
+
+    errors->len = 0;
+}
+
 void synthium_print_error(const char *err_text, BigSpan *span, SourceFile *file, Path *abs_path) {
     uint32_t last_nl = 0;
     int32_t line = source_find_line(span, file, &last_nl);
@@ -0,0 +1,478 @@
+#include <string.h>
+
+#include "../include/tailcall.h"
+#include "../include/utils.h"
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+
+TailCall tailcall_create(IrModule *m, bool all, Vec *errors) {
+    TailCall t;
+    memset((void *) &t, 0, sizeof(TailCall));
+
+    t.m = m;
+    t.all = all;
+    t.errors = errors;
+    t.work = vec_create(sizeof(IrValue));
+    t.self = vec_create(sizeof(IrBlockId));
+
+    return t;
+}
+
+void tailcall_free(TailCall *t) {
+    free((void *) t->escaped);
+    free((void *) t->mark);
+    vec_free(&t->work);
+    vec_free(&t->self);
+}
+
+void tailcall_reserve(TailCall *t, IrFunc *f) {
+    if (f->num_insts > t->cap_insts) {
+        t->cap_insts = f->num_insts * 2;
+        t->escaped = (bool *) realloc((void *) t->escaped, t->cap_insts * sizeof(bool));
+        t->mark = (uint32_t *) realloc((void *) t->mark, t->cap_insts * sizeof(uint32_t));
+        memset((void *) t->mark, 0, t->cap_insts * sizeof(uint32_t));
+        t->query = 0;
+    }
+
+    memset((void *) t->escaped, 0, f->num_insts * sizeof(bool));
+}
+
+IrValue tailcall_find(TailCall *t, IrBlockId b) {
+    IrFunc *f = t->f;
+    IrBlock *block = &f->blocks[b];
+    IrValue call = ir_block_tail_call(f, b);
+
+    if (call != IR_NO_VALUE || block->num_insts < 2) {
+        return call;
+    }
+
+    IrInst *br = &f->insts[block->insts[block->num_insts - 1]];
+    call = block->insts[block->num_insts - 2];
+
+    if (br->op != IR_BR || f->insts[call].op != IR_CALL) {
+        return IR_NO_VALUE;
+    }
+
+    // the inliner leaves the returns of a function it inlined into as jumps to one block returning a phi
+    IrBlockId r = br->u.ops[0];
+    IrBlock *ret_block = &f->blocks[r];
+    IrValue ret = ir_block_terminator(f, r);
+
+    if (ret == IR_NO_VALUE || f->insts[ret].op != IR_RET) {
+        return IR_NO_VALUE;
+    }
+
+    if (ret_block->num_insts == 1) {
+        return f->insts[ret].num_ops == 0 ? call : IR_NO_VALUE;
+    }
+
+    IrValue phi = ret_block->insts[0];
+
+    if (ret_block->num_insts != 2 || f->insts[phi].op != IR_PHI || f->insts[ret].num_ops == 0 || f->insts[ret].u.ops[0] != phi) {
+        return IR_NO_VALUE;
+    }
+
+    return ir_inst_ops(f, &f->insts[phi])[ir_pred_index(f, r, b)] == call ? call : IR_NO_VALUE;
+}
+
+// follows v back through everything that passes an address on, to see whether it can be one of a stack slot
+bool tailcall_points_into_frame(TailCall *t, IrValue v) {
+    IrFunc *f = t->f;
+
+    t->query++;
+    t->work.len = 0;
+    vec_push(&t->work, (void *) &v);
+
+    while (t->work.len > 0) {
+        IrValue x = ((IrValue *) t->work.elements)[--t->work.len];
+        IrInst *inst = &f->insts[x];
+
+        if (t->mark[x] == t->query) {
+            continue;
+        }
+
+        t->mark[x] = t->query;
+
+        switch (inst->op) {
+            case IR_ALLOCA: {
+                return true;
+            }
+
+            case IR_OFFSET:
+            case IR_COPY:
+            case IR_PTR_TO_INT:
+            case IR_INT_TO_PTR:
+            case IR_ADD:
+            case IR_SUB:
+            case IR_SELECT:
+            case IR_PHI: {
+                IrValue *ops = ir_inst_ops(f, inst);
+                uint32_t n = ir_inst_num_values(inst);
+                uint32_t i = 0;
+
+                while (i < n) {
+                    vec_push(&t->work, (void *) &ops[i]);
+                    i++;
+                }
+
+                break;
+            }
+
+            default: {
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+// why the call can not be a tail call, NULL when it can
+const char *tailcall_check(TailCall *t, IrValue call, bool any_escaped) {
+    IrFunc *f = t->f;
+    IrInst *inst = &f->insts[call];
+    IrFunc *callee = ir_module_func(t->m, (uint32_t) inst->imm);
+    bool must = (inst->flags & IR_FLAG_MUST_TAIL) != 0;
+    IrValue *ops = ir_inst_ops(f, inst);
+    uint32_t i = 0;
+
+    if (callee != f && (callee->flags & IR_FUNC_VARARGS) != 0) {
+        return fmt_str("'%s' takes variable arguments", callee->name);
+    }
+
+    if (callee != f && inst->num_ops > TAILCALL_MAX_ARGS) {
+        return fmt_str("'%s' takes %u arguments, only %d fit in registers", callee->name, inst->num_ops, TAILCALL_MAX_ARGS);
+    }
+
+    if (!must && any_escaped) {
+        return strdup("a stack slot of the caller escapes");
+    }
+
+    while (i < inst->num_ops) {
+        if (tailcall_points_into_frame(t, ops[i])) {
+            return fmt_str("argument %u points into the frame of '%s'", i + 1, f->name);
+        }
+
+        i++;
+    }
+
+    return NULL;
+}
+
+// the block returns the call's result itself from now on, a block returning a phi that nothing jumps to anymore
+// is left with an unreachable like the dead blocks of sccp
+void tailcall_to_ret(TailCall *t, IrBlockId b, IrValue call) {
+    IrFunc *f = t->f;
+    IrValue term = ir_block_terminator(f, b);
+    IrInst *br = &f->insts[term];
+
+    if (br->op != IR_BR) {
+        return;
+    }
+
+    IrBlockId r = br->u.ops[0];
+    ir_remove_incoming(f, b, r);
+
+    br->op = IR_RET;
+    br->num_ops = f->insts[call].ty != IR_TYPE_VOID && f->ret != IR_TYPE_VOID ? 1 : 0;
+    br->u.ops[0] = call;
+
+    IrBlock *ret_block = &f->blocks[r];
+
+    if (ret_block->num_preds > 0) {
+        return;
+    }
+
+    IrValue last = ret_block->insts[ret_block->num_insts - 1];
+    uint32_t i = 0;
+
+    while (i < ret_block->num_insts) {
+        ir_inst_remove(f, ret_block->insts[i]);
+        i++;
+    }
+
+    f->insts[last].op = IR_UNREACHABLE;
+    ret_block->insts[0] = last;
+    ret_block->num_insts = 1;
+}
+
+// the entry keeps the parameters, the stack slots and the constants and jumps to a new header with the rest of
+// its code, which every call of the function itself jumps back to
+void tailcall_loop(TailCall *t) {
+    IrFunc *f = t->f;
+    IrBlockId head = ir_block_create(f);
+    IrBlock *entry = &f->blocks[0];
+    IrBlock *head_block = &f->blocks[head];
+    uint32_t j = 0;
+    uint32_t i = 0;
+
+    head_block->freq = entry->freq;
+
+    // the successors keep their order, so the phis in them stay as they are
+    head_block->succs = entry->succs;
+    head_block->num_succs = entry->num_succs;
+    head_block->cap_succs = entry->cap_succs;
+    entry->succs = NULL;
+    entry->num_succs = 0;
+    entry->cap_succs = 0;
+
+    while (i < head_block->num_succs) {
+        IrBlock *succ = &f->blocks[head_block->succs[i]];
+        uint32_t k = 0;
+
+        while (k < succ->num_preds) {
+            succ->preds[k] = succ->preds[k] == 0 ? head : succ->preds[k];
+            k++;
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < entry->num_insts) {
+        IrValue v = entry->insts[i];
+        uint8_t op = f->insts[v].op;
+
+        if (op == IR_PARAM || op == IR_ALLOCA || op == IR_CONST || op == IR_STR || op == IR_GLOBAL || op == IR_FUNC_ADDR) {
+            entry->insts[j++] = v;
+        } else if (op != IR_NOP) {
+            ir_block_append(f, head, v);
+        }
+
+        i++;
+    }
+
+    entry->num_insts = j;
+
+    IrBuilder bld = ir_builder_create(t->m, f);
+    ir_builder_set_block(&bld, 0);
+    ir_build_br(&bld, head);
+
+    IrBlockId *self = (IrBlockId *) t->self.elements;
+    i = 0;
+
+    while (i < t->self.len) {
+        self[i] = self[i] == 0 ? head : self[i];
+        ir_add_edge(f, self[i], head);
+        i++;
+    }
+
+    // the arguments of the calls still read the parameters until these are replaced by the phis
+    uint32_t num_preds = f->blocks[head].num_preds;
+    uint32_t num_entry = f->blocks[0].num_insts;
+    i = 0;
+
+    while (i < num_entry) {
+        IrValue param = f->blocks[0].insts[i];
+        i++;
+
+        if (f->insts[param].op != IR_PARAM) {
+            continue;
+        }
+
+        uint32_t idx = (uint32_t) f->insts[param].imm;
+        IrValue phi = ir_build_phi_in(f, head, f->insts[param].ty, num_preds);
+
+        ir_replace_all_uses(f, param, phi);
+        ir_inst_ops(f, &f->insts[phi])[ir_pred_index(f, head, 0)] = param;
+
+        uint32_t k = 0;
+        while (k < t->self.len) {
+            IrBlock *block = &f->blocks[self[k]];
+            IrValue call = block->insts[block->num_insts - 2];
+
+            ir_inst_ops(f, &f->insts[phi])[ir_pred_index(f, head, self[k])] = ir_inst_ops(f, &f->insts[call])[idx];
+            k++;
+        }
+    }
+
+    i = 0;
+    while (i < t->self.len) {
+        IrBlock *block = &f->blocks[self[i]];
+        IrValue call = block->insts[block->num_insts - 2];
+        IrInst *ret = &f->insts[block->insts[block->num_insts - 1]];
+
+        ir_inst_remove(f, call);
+        ret->op = IR_BR;
+        ret->num_ops = 1;
+        ret->u.ops[0] = head;
+        ir_block_compact(f, self[i]);
+
+        i++;
+    }
+}
+
+void tailcall_error(TailCall *t, IrValue call, const char *text) {
+    TailCallError err = {
+        .text = text,
+        .span = ir_func_become_span(t->f, call)
+    };
+
+    vec_push(t->errors, (void *) &err);
+}
+
+// lowering puts the return right after the call of a `become`, only instrumenting main puts anything between
+void tailcall_check_order(TailCall *t, IrBlockId b, IrValue call) {
+    IrFunc *f = t->f;
+    IrBlock *block = &f->blocks[b];
+    uint32_t i = 0;
+
+    while (i < block->num_insts) {
+        IrInst *inst = &f->insts[block->insts[i]];
+
+        if (inst->op == IR_CALL && (inst->flags & IR_FLAG_MUST_TAIL) != 0 && block->insts[i] != call) {
+            tailcall_error(t, block->insts[i], fmt_str("'become' in '%s' is not followed by its return", f->name));
+        }
+
+        i++;
+    }
+}
+
+void tailcall_check_func(TailCall *t, IrFunc *f) {
+    t->f = f;
+    tailcall_reserve(t, f);
+
+    IrBlockId b = 0;
+
+    while (b < f->num_blocks) {
+        IrValue call = tailcall_find(t, b);
+
+        tailcall_check_order(t, b, call);
+        b++;
+
+        if (call == IR_NO_VALUE || (f->insts[call].flags & IR_FLAG_MUST_TAIL) == 0) {
+            continue;
+        }
+
+        const char *why = tailcall_check(t, call, false);
+
+        if (why != NULL) {
+            tailcall_error(t, call, fmt_str("'become' in '%s' can not be a tail call: %s", f->name, why));
+            free((void *) why);
+        }
+    }
+}
+
+void tailcall_func(TailCall *t, IrFunc *f) {
+    t->f = f;
+    t->self.len = 0;
+    tailcall_reserve(t, f);
+    ir_find_escaping_slots(f, t->escaped);
+
+    bool any_escaped = false;
+    IrValue v = 1;
+
+    while (v < f->num_insts && !any_escaped) {
+        any_escaped = t->escaped[v];
+        v++;
+    }
+
+    uint32_t num_blocks = f->num_blocks;
+    IrBlockId b = 0;
+
+    while (b < num_blocks) {
+        IrValue call = tailcall_find(t, b);
+
+        tailcall_check_order(t, b, call);
+        b++;
+
+        if (call == IR_NO_VALUE || ((f->insts[call].flags & IR_FLAG_MUST_TAIL) == 0 && !t->all)) {
+            continue;
+        }
+
+        bool must = (f->insts[call].flags & IR_FLAG_MUST_TAIL) != 0;
+        const char *why = tailcall_check(t, call, any_escaped);
+
+        if (why != NULL) {
+            if (must) {
+                tailcall_error(t, call, fmt_str("'become' in '%s' can not be a tail call: %s", f->name, why));
+            }
+
+            free((void *) why);
+            continue;
+        }
+
+        t->num_become += must;
+        tailcall_to_ret(t, b - 1, call);
+
+        if (f->insts[call].imm == f->idx) {
+            IrBlockId self = b - 1;
+            vec_push(&t->self, (void *) &self);
+        } else {
+            f->insts[call].flags |= IR_FLAG_TAIL;
+            t->num_sibling++;
+        }
+    }
+
+    if (t->self.len > 0) {
+        t->num_self += t->self.len;
+        tailcall_loop(t);
+    }
+}
+
+int32_t tailcall_check_module(IrModule *m, Vec *errors) {
+    int32_t tt = TIMETRACE_BEGIN("tailcall check", 0, NULL, 0, NULL);
+    TailCall t = tailcall_create(m, false, errors);
+    int32_t num_errs = errors->len;
+    uint32_t i = 0;
+
+    while (i < ir_module_num_funcs(m)) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if ((f->flags & IR_FUNC_EXTERN) == 0 && f->num_blocks > 0) {
+            tailcall_check_func(&t, f);
+        }
+
+        i++;
+    }
+
+    tailcall_free(&t);
+    TIMETRACE_END(tt);
+
+    return errors->len - num_errs;
+}
+
+int32_t tailcall_module(IrModule *m, int32_t opt_level, Vec *errors) {
+    int32_t tt = TIMETRACE_BEGIN("tailcall", 0, NULL, 0, NULL);
+    TailCall t = tailcall_create(m, opt_level >= 1, errors);
+    int32_t num_errs = errors->len;
+    uint32_t i = 0;
+
+    while (i < ir_module_num_funcs(m)) {
+        IrFunc *f = ir_module_func(m, i);
+
+        if ((f->flags & IR_FUNC_EXTERN) == 0 && f->num_blocks > 0) {
+            tailcall_func(&t, f);
+        }
+
+        i++;
+    }
+
+    timer_stat_add("tailcall self calls", t.num_self);
+    timer_stat_add("tailcall sibling calls", t.num_sibling);
+    timer_stat_add("tailcall become calls", t.num_become);
+
+    tailcall_free(&t);
+    TIMETRACE_END(tt);
+
+    return errors->len - num_errs;
+}
+
+void tailcall_pass_module(IrModule *m, void *params) {
+    TailCallParams *tp = (TailCallParams *) params;
+
+    tailcall_module(m, tp->opt_level, tp->errors);
+}
+
+// the diagnostics come out in function order, so the pass runs over the module at once
+Pass tailcall_pass(TailCallParams *params) {
+    Pass p = {
+        .name = "tailcall",
+        .kind = PASS_MODULE,
+        .preserves = 0,
+        .params = (void *) params,
+        .run_module = tailcall_pass_module
+    };
+
+    return p;
+}
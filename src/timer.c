@@ -0,0 +1,487 @@
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+
+static char const *const phase_names[] = {
+    "stdlib load",
+    "user file load",
+    "lex",
+    "parse",
+    "module sort",
+    "type check",
+    "lower",
+    "optimize",
+    "codegen",
+    "emit c",
+    "bytecode",
+    "run",
+    "diagnostics",
+    "teardown"
+};
+
+static char const *const counter_names[] = {
+    "instructions",
+    "cycles",
+    "branch_misses",
+    "llc_misses"
+};
+
+bool timer_enabled = false;
+uint64_t timer_lex_ns = 0;
+
+static TimeReport timer_report;
+static const char *timer_counter_error = NULL;
+static int32_t timer_phase_events[PHASE_COUNT];
+
+void timer_init(bool enabled) {
+    memset(&timer_report, 0, sizeof(TimeReport));
+    timer_report.passes = vec_create(sizeof(PassTimes));
+    timer_report.stats = vec_create(sizeof(Stat));
+    timer_enabled = enabled;
+
+    int32_t i = 0;
+    while (i < TIMER_NUM_COUNTERS) {
+        timer_report.counter_fds[i] = -1;
+        i++;
+    }
+
+    if (!enabled) {
+        return;
+    }
+
+    timer_report.phases[PHASE_LEX].nested = true;
+    timer_open_counters(&timer_report);
+    alloc_set_counting(true);
+}
+
+#ifdef __linux__
+int32_t timer_perf_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int32_t) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+bool timer_open_counters(TimeReport *tr) {
+#ifdef __linux__
+    uint64_t llc_miss = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    tr->counter_fds[COUNTER_INSTRUCTIONS] = timer_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    tr->counter_fds[COUNTER_CYCLES] = timer_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    tr->counter_fds[COUNTER_BRANCH_MISSES] = timer_perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    tr->counter_fds[COUNTER_LLC_MISSES] = timer_perf_open(PERF_TYPE_HW_CACHE, llc_miss);
+
+    int32_t i = 0;
+    while (i < TIMER_NUM_COUNTERS) {
+        if (tr->counter_fds[i] < 0) {
+            timer_counter_error = strerror(errno);
+            timer_close_counters(tr);
+
+            return false;
+        }
+
+        i++;
+    }
+
+    tr->has_counters = true;
+
+    return true;
+#else
+    timer_counter_error = "not supported on this platform";
+    return false;
+#endif
+}
+
+void timer_close_counters(TimeReport *tr) {
+    int32_t i = 0;
+    while (i < TIMER_NUM_COUNTERS) {
+        if (tr->counter_fds[i] >= 0) {
+            close(tr->counter_fds[i]);
+        }
+
+        tr->counter_fds[i] = -1;
+        i++;
+    }
+
+    tr->has_counters = false;
+}
+
+uint64_t timer_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+uint64_t timer_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+int64_t timer_peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+
+const char *timer_phase2str(Phase phase) {
+    if (phase < 0 || phase >= PHASE_COUNT) {
+        return "unknown";
+    }
+
+    return phase_names[phase];
+}
+
+const char *timer_counter2str(Counter counter) {
+    return counter_names[counter];
+}
+
+PhaseSnapshot timer_snapshot(TimeReport *tr) {
+    PhaseSnapshot snap = {
+        .wall_ns = timer_now_ns(),
+        .cpu_ns = timer_cpu_ns(),
+        .allocs = alloc_stats()
+    };
+
+    if (tr->has_counters) {
+        int32_t i = 0;
+        while (i < TIMER_NUM_COUNTERS) {
+            uint64_t value = 0;
+            if (read(tr->counter_fds[i], &value, sizeof(value)) == sizeof(value)) {
+                snap.counters[i] = value;
+            }
+
+            i++;
+        }
+    }
+
+    return snap;
+}
+
+void timer_phase_begin(Phase phase) {
+    timer_phase_events[phase] = TIMETRACE_BEGIN(phase_names[phase], 0, NULL, 0, NULL);
+
+    if (!timer_enabled) {
+        return;
+    }
+
+    timer_report.phases[phase].start = timer_snapshot(&timer_report);
+}
+
+void timer_phase_end(Phase phase) {
+    TIMETRACE_END(timer_phase_events[phase]);
+
+    if (!timer_enabled) {
+        return;
+    }
+
+    PhaseSnapshot end = timer_snapshot(&timer_report);
+    PhaseTimes *p = &timer_report.phases[phase];
+    AllocStats allocs = alloc_stats_diff(end.allocs, p->start.allocs);
+
+    p->runs++;
+    p->wall_ns += end.wall_ns - p->start.wall_ns;
+    p->cpu_ns += end.cpu_ns - p->start.cpu_ns;
+    p->allocs += allocs.count;
+    p->alloc_bytes += allocs.bytes;
+    p->peak_rss_kb = timer_peak_rss_kb();
+
+    int32_t i = 0;
+    while (i < TIMER_NUM_COUNTERS) {
+        p->counters[i] += end.counters[i] - p->start.counters[i];
+        i++;
+    }
+}
+
+// moves time measured inside `parent` (e.g. lexing driven by the parser) into its own row
+void timer_phase_add_nested(Phase phase, Phase parent, uint64_t wall_ns) {
+    if (!timer_enabled) {
+        return;
+    }
+
+    PhaseTimes *p = &timer_report.phases[phase];
+    PhaseTimes *outer = &timer_report.phases[parent];
+
+    if (wall_ns > outer->wall_ns) {
+        wall_ns = outer->wall_ns;
+    }
+
+    p->runs++;
+    p->wall_ns += wall_ns;
+    p->cpu_ns += wall_ns;
+    p->peak_rss_kb = outer->peak_rss_kb;
+    outer->wall_ns -= wall_ns;
+    outer->cpu_ns -= wall_ns < outer->cpu_ns ? wall_ns : outer->cpu_ns;
+}
+
+void timer_pass_add(const char *name, uint64_t wall_ns, int64_t funcs, int64_t insts) {
+    if (!timer_enabled) {
+        return;
+    }
+
+    int32_t i = 0;
+    while (i < timer_report.passes.len) {
+        PassTimes *p = (PassTimes *) vec_get_ptr(&timer_report.passes, i);
+
+        if (strcmp(p->name, name) == 0) {
+            p->runs++;
+            p->wall_ns += wall_ns;
+            p->funcs += funcs;
+            p->insts += insts;
+            return;
+        }
+
+        i++;
+    }
+
+    PassTimes p = {
+        .name = name,
+        .runs = 1,
+        .wall_ns = wall_ns,
+        .funcs = funcs,
+        .insts = insts
+    };
+
+    vec_push(&timer_report.passes, (void *) &p);
+}
+
+Stat *timer_find_stat(const char *name) {
+    int32_t i = 0;
+    while (i < timer_report.stats.len) {
+        Stat *s = (Stat *) vec_get_ptr(&timer_report.stats, i);
+        if (strcmp(s->name, name) == 0) {
+            return s;
+        }
+
+        i++;
+    }
+
+    return NULL;
+}
+
+void timer_stat_add(const char *name, int64_t value) {
+    if (!timer_enabled) {
+        return;
+    }
+
+    Stat *s = timer_find_stat(name);
+    if (s != NULL) {
+        s->value += value;
+        return;
+    }
+
+    Stat stat = {
+        .name = name,
+        .value = value
+    };
+
+    vec_push(&timer_report.stats, (void *) &stat);
+}
+
+int64_t timer_stat_get(const char *name) {
+    Stat *s = timer_find_stat(name);
+    if (s == NULL) {
+        return 0;
+    }
+
+    return s->value;
+}
+
+PhaseTimes timer_total() {
+    PhaseTimes total;
+    memset(&total, 0, sizeof(PhaseTimes));
+
+    int32_t i = 0;
+    while (i < PHASE_COUNT) {
+        PhaseTimes *p = &timer_report.phases[i];
+
+        total.runs += p->runs;
+        total.wall_ns += p->wall_ns;
+        total.cpu_ns += p->cpu_ns;
+        total.allocs += p->allocs;
+        total.alloc_bytes += p->alloc_bytes;
+
+        if (p->peak_rss_kb > total.peak_rss_kb) {
+            total.peak_rss_kb = p->peak_rss_kb;
+        }
+
+        int32_t j = 0;
+        while (j < TIMER_NUM_COUNTERS) {
+            total.counters[j] += p->counters[j];
+            j++;
+        }
+
+        i++;
+    }
+
+    return total;
+}
+
+void timer_print_row(FILE *out, const char *name, PhaseTimes *p) {
+    fprintf(out, "%-16s %5d %11.3f %11.3f %9llu %12.1f %12lld",
+        name, p->runs, p->wall_ns / 1e6, p->cpu_ns / 1e6,
+        (unsigned long long) p->allocs, p->alloc_bytes / 1024.0, (long long) p->peak_rss_kb);
+
+    if (timer_report.has_counters) {
+        int32_t i = 0;
+        while (i < TIMER_NUM_COUNTERS) {
+            fprintf(out, " %14llu", (unsigned long long) p->counters[i]);
+            i++;
+        }
+    }
+
+    fprintf(out, "\n");
+}
+
+void timer_print_table(FILE *out) {
+    PhaseTimes total = timer_total();
+
+    fprintf(out, "===---------------------------------------------------------------------------===\n");
+    fprintf(out, "                           synthiumc time report\n");
+    fprintf(out, "===---------------------------------------------------------------------------===\n");
+    fprintf(out, "%-16s %5s %11s %11s %9s %12s %12s", "phase", "runs", "wall (ms)", "cpu (ms)", "allocs", "alloc (KiB)", "peak rss KiB");
+
+    if (timer_report.has_counters) {
+        int32_t i = 0;
+        while (i < TIMER_NUM_COUNTERS) {
+            fprintf(out, " %14s", counter_names[i]);
+            i++;
+        }
+    }
+
+    fprintf(out, "\n");
+
+    int32_t i = 0;
+    while (i < PHASE_COUNT) {
+        PhaseTimes *p = &timer_report.phases[i];
+        const char *name = phase_names[i];
+
+        if (p->nested) {
+            char nested_name[32];
+            snprintf(nested_name, sizeof(nested_name), "  (%s)", name);
+            timer_print_row(out, nested_name, p);
+        } else {
+            timer_print_row(out, name, p);
+        }
+
+        i++;
+    }
+
+    timer_print_row(out, "total", &total);
+
+    if (!timer_report.has_counters) {
+        fprintf(out, "hardware counters unavailable: %s\n", timer_counter_error != NULL ? timer_counter_error : "disabled");
+    }
+
+    if (!alloc_hooks_available()) {
+        fprintf(out, "allocation counts unavailable in this build\n");
+    }
+
+    if (timer_report.passes.len > 0) {
+        fprintf(out, "\n%-16s %5s %11s %13s %13s\n", "pass", "runs", "wall (ms)", "funcs changed", "insts changed");
+
+        i = 0;
+        while (i < timer_report.passes.len) {
+            PassTimes *p = (PassTimes *) vec_get_ptr(&timer_report.passes, i);
+            fprintf(out, "%-16s %5d %11.3f %13lld %13lld\n", p->name, p->runs, p->wall_ns / 1e6, (long long) p->funcs, (long long) p->insts);
+            i++;
+        }
+    }
+
+    if (timer_report.stats.len > 0) {
+        fprintf(out, "\nstatistics:\n");
+
+        i = 0;
+        while (i < timer_report.stats.len) {
+            Stat *s = (Stat *) vec_get_ptr(&timer_report.stats, i);
+            fprintf(out, "  %-32s %lld\n", s->name, (long long) s->value);
+            i++;
+        }
+    }
+}
+
+void timer_print_json_phase(FILE *out, const char *name, PhaseTimes *p) {
+    fprintf(out, "{\"name\": \"%s\", \"nested\": %s, \"runs\": %d, \"wall_ns\": %llu, \"cpu_ns\": %llu, \"allocs\": %llu, \"alloc_bytes\": %llu, \"peak_rss_kb\": %lld",
+        name, p->nested ? "true" : "false", p->runs, (unsigned long long) p->wall_ns, (unsigned long long) p->cpu_ns,
+        (unsigned long long) p->allocs, (unsigned long long) p->alloc_bytes, (long long) p->peak_rss_kb);
+
+    if (timer_report.has_counters) {
+        int32_t i = 0;
+        while (i < TIMER_NUM_COUNTERS) {
+            fprintf(out, ", \"%s\": %llu", counter_names[i], (unsigned long long) p->counters[i]);
+            i++;
+        }
+    }
+
+    fprintf(out, "}");
+}
+
+void timer_print_json(FILE *out) {
+    PhaseTimes total = timer_total();
+
+    fprintf(out, "{\n  \"counters_available\": %s,\n  \"allocs_available\": %s,\n  \"phases\": [\n",
+        timer_report.has_counters ? "true" : "false", alloc_hooks_available() ? "true" : "false");
+
+    int32_t i = 0;
+    while (i < PHASE_COUNT) {
+        fprintf(out, "    ");
+        timer_print_json_phase(out, phase_names[i], &timer_report.phases[i]);
+        fprintf(out, i + 1 < PHASE_COUNT ? ",\n" : "\n");
+        i++;
+    }
+
+    fprintf(out, "  ],\n  \"total\": ");
+    timer_print_json_phase(out, "total", &total);
+    fprintf(out, ",\n  \"passes\": [");
+
+    i = 0;
+    while (i < timer_report.passes.len) {
+        PassTimes *p = (PassTimes *) vec_get_ptr(&timer_report.passes, i);
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"runs\": %d, \"wall_ns\": %llu, \"funcs_changed\": %lld, \"insts_changed\": %lld}",
+            i > 0 ? "," : "", p->name, p->runs, (unsigned long long) p->wall_ns, (long long) p->funcs, (long long) p->insts);
+        i++;
+    }
+
+    fprintf(out, timer_report.passes.len > 0 ? "\n  ]" : "]");
+    fprintf(out, ",\n  \"stats\": {");
+
+    i = 0;
+    while (i < timer_report.stats.len) {
+        Stat *s = (Stat *) vec_get_ptr(&timer_report.stats, i);
+        fprintf(out, "%s\"%s\": %lld", i > 0 ? ", " : "", s->name, (long long) s->value);
+        i++;
+    }
+
+    fprintf(out, "}\n}\n");
+}
+
+void timer_free() {
+    alloc_set_counting(false);
+    timer_close_counters(&timer_report);
+    vec_free(&timer_report.passes);
+    vec_free(&timer_report.stats);
+    timer_enabled = false;
+}
@@ -0,0 +1,192 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "../include/timer.h"
+#include "../include/timetrace.h"
+
+bool timetrace_enabled = false;
+
+static const char *timetrace_path = NULL;
+static uint64_t timetrace_base_ns = 0;
+static int32_t timetrace_next_tid = 1;
+static TimeTraceThread *timetrace_threads = NULL;
+static pthread_mutex_t timetrace_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local TimeTraceThread *timetrace_local = NULL;
+
+void timetrace_init(const char *path) {
+    timetrace_path = path;
+    timetrace_base_ns = timer_now_ns();
+    timetrace_enabled = path != NULL;
+}
+
+// threads register once, so the lock is never taken on the event path
+TimeTraceThread *timetrace_get_thread() {
+    if (timetrace_local != NULL) {
+        return timetrace_local;
+    }
+
+    TimeTraceThread *t = (TimeTraceThread *) malloc(sizeof(TimeTraceThread));
+    t->events = vec_create(sizeof(TimeTraceEvent));
+    t->strings = vec_create(sizeof(char));
+    t->name = NULL;
+
+    pthread_mutex_lock(&timetrace_lock);
+    t->tid = timetrace_next_tid++;
+    t->next = timetrace_threads;
+    timetrace_threads = t;
+    pthread_mutex_unlock(&timetrace_lock);
+
+    timetrace_local = t;
+
+    return t;
+}
+
+int32_t timetrace_push_string(TimeTraceThread *t, int32_t len, const char *s) {
+    int32_t offset = t->strings.len;
+    int32_t i = 0;
+
+    while (i < len) {
+        vec_push(&t->strings, (void *) (s + i));
+        i++;
+    }
+
+    return offset;
+}
+
+int32_t timetrace_begin(const char *name, int32_t mod_len, const char *mod, int32_t sym_len, const char *sym) {
+    TimeTraceThread *t = timetrace_get_thread();
+    TimeTraceEvent event = {
+        .name = name,
+        .start_ns = timer_now_ns(),
+        .end_ns = 0,
+        .mod_offset = -1,
+        .mod_len = 0,
+        .sym_offset = -1,
+        .sym_len = 0
+    };
+
+    if (mod != NULL && mod_len > 0) {
+        event.mod_offset = timetrace_push_string(t, mod_len, mod);
+        event.mod_len = mod_len;
+    }
+
+    if (sym != NULL && sym_len > 0) {
+        event.sym_offset = timetrace_push_string(t, sym_len, sym);
+        event.sym_len = sym_len;
+    }
+
+    int32_t id = t->events.len;
+    vec_push(&t->events, (void *) &event);
+
+    return id;
+}
+
+void timetrace_end(int32_t id) {
+    TimeTraceEvent *event = (TimeTraceEvent *) vec_get_ptr(&timetrace_get_thread()->events, id);
+    if (event != NULL) {
+        event->end_ns = timer_now_ns();
+    }
+}
+
+void timetrace_set_thread_name(const char *name) {
+    if (timetrace_enabled) {
+        timetrace_get_thread()->name = name;
+    }
+}
+
+void timetrace_write_escaped(FILE *out, const char *s, int32_t len) {
+    int32_t i = 0;
+    while (i < len) {
+        char c = s[i];
+
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if ((unsigned char) c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+
+        i++;
+    }
+}
+
+void timetrace_write_event(FILE *out, TimeTraceThread *t, TimeTraceEvent *e) {
+    uint64_t end = e->end_ns != 0 ? e->end_ns : e->start_ns;
+
+    fprintf(out, ",\n{\"name\": \"%s\", \"cat\": \"synthiumc\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+        e->name, t->tid, (e->start_ns - timetrace_base_ns) / 1e3, (end - e->start_ns) / 1e3);
+
+    if (e->mod_offset >= 0 || e->sym_offset >= 0) {
+        const char *strings = (const char *) t->strings.elements;
+        fprintf(out, ", \"args\": {");
+
+        if (e->mod_offset >= 0) {
+            fprintf(out, "\"module\": \"");
+            timetrace_write_escaped(out, strings + e->mod_offset, e->mod_len);
+            fprintf(out, "\"%s", e->sym_offset >= 0 ? ", " : "");
+        }
+
+        if (e->sym_offset >= 0) {
+            fprintf(out, "\"symbol\": \"");
+            timetrace_write_escaped(out, strings + e->sym_offset, e->sym_len);
+            fprintf(out, "\"");
+        }
+
+        fprintf(out, "}");
+    }
+
+    fprintf(out, "}");
+}
+
+// must only be called once the other threads stopped recording events
+bool timetrace_write() {
+    if (!timetrace_enabled) {
+        return true;
+    }
+
+    FILE *out = fopen(timetrace_path, "w");
+    if (out == NULL) {
+        return false;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"synthiumc\"}}");
+
+    TimeTraceThread *t = timetrace_threads;
+    while (t != NULL) {
+        fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            t->tid, t->name != NULL ? t->name : "worker");
+
+        int32_t i = 0;
+        while (i < t->events.len) {
+            timetrace_write_event(out, t, (TimeTraceEvent *) vec_get_ptr(&t->events, i));
+            i++;
+        }
+
+        t = t->next;
+    }
+
+    fprintf(out, "\n]}\n");
+    fclose(out);
+
+    return true;
+}
+
+void timetrace_free() {
+    TimeTraceThread *t = timetrace_threads;
+
+    while (t != NULL) {
+        TimeTraceThread *next = t->next;
+
+        vec_free(&t->events);
+        vec_free(&t->strings);
+        free((void *) t);
+
+        t = next;
+    }
+
+    timetrace_threads = NULL;
+    timetrace_local = NULL;
+    timetrace_enabled = false;
+}
@@ -0,0 +1,286 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "../include/trace.h"
+
+uint32_t trace_level_masks[TRACE_LEVEL_DEBUG + 1] = { 0 };
+
+static char const *const trace_cat_names[] = {
+    "typecheck",
+    "layout",
+    "parse",
+    "mod",
+    "ast",
+    "regalloc",
+    "inline",
+    "loop",
+    "place"
+};
+
+static char const *const trace_level_names[] = {
+    "off",
+    "error",
+    "warn",
+    "info",
+    "debug"
+};
+
+size_t const len_trace_cat_names = sizeof(trace_cat_names) / sizeof(char *);
+size_t const len_trace_level_names = sizeof(trace_level_names) / sizeof(char *);
+
+static int32_t trace_fd = STDERR_FILENO;
+static bool trace_registered_exit = false;
+static _Thread_local TraceBuffer *trace_local = NULL;
+static TraceBuffer *_Atomic trace_buffers = NULL;
+
+void trace_init() {
+    const char *spec = getenv("SYNTHIUM_TRACE");
+    const char *out = getenv("SYNTHIUM_TRACE_FILE");
+
+    if (spec != NULL && !trace_parse_spec(spec)) {
+        fprintf(stderr, "[warning] invalid SYNTHIUM_TRACE value '%s'\n", spec);
+    }
+
+    if (out != NULL && !trace_set_output(out)) {
+        fprintf(stderr, "[warning] could not open trace file '%s'\n", out);
+    }
+
+    if (!trace_registered_exit) {
+        trace_registered_exit = true;
+        atexit(trace_shutdown);
+    }
+}
+
+int32_t trace_find_name(const char *name, int32_t len, const char *const *names, size_t num_names) {
+    int32_t i = 0;
+    while (i < (int32_t) num_names) {
+        if ((int32_t) strlen(names[i]) == len && strncmp(names[i], name, len) == 0) {
+            return i;
+        }
+
+        i++;
+    }
+
+    return -1;
+}
+
+// spec := entry (',' entry)*, entry := category [':' level], category := name | "all"
+bool trace_parse_spec(const char *spec) {
+    bool valid = true;
+    const char *ptr = spec;
+
+    while (*ptr != '\0') {
+        const char *end = strchr(ptr, ',');
+        if (end == NULL) {
+            end = ptr + strlen(ptr);
+        }
+
+        const char *colon = memchr(ptr, ':', end - ptr);
+        const char *name_end = colon != NULL ? colon : end;
+        int32_t level = TRACE_LEVEL_DEBUG;
+        uint32_t cats = 0;
+
+        if (colon != NULL) {
+            level = trace_find_name(colon + 1, end - colon - 1, trace_level_names, len_trace_level_names);
+        }
+
+        if (name_end - ptr == 3 && strncmp(ptr, "all", 3) == 0) {
+            cats = TRACE_CAT_ALL;
+        } else {
+            int32_t idx = trace_find_name(ptr, name_end - ptr, trace_cat_names, len_trace_cat_names);
+            if (idx >= 0) {
+                cats = 1u << idx;
+            }
+        }
+
+        if (cats == 0 || level < 0) {
+            valid = false;
+        } else {
+            trace_enable(cats, level);
+        }
+
+        ptr = *end == ',' ? end + 1 : end;
+    }
+
+    return valid;
+}
+
+void trace_enable(uint32_t categories, int32_t level) {
+    int32_t i = TRACE_LEVEL_ERROR;
+    while (i <= TRACE_LEVEL_DEBUG) {
+        if (i <= level) {
+            trace_level_masks[i] |= categories;
+        } else {
+            trace_level_masks[i] &= ~categories;
+        }
+
+        i++;
+    }
+}
+
+void trace_disable_all() {
+    memset(trace_level_masks, 0, sizeof(trace_level_masks));
+}
+
+bool trace_set_output(const char *path) {
+    int32_t fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    trace_flush();
+
+    if (trace_fd != STDERR_FILENO) {
+        close(trace_fd);
+    }
+
+    trace_fd = fd;
+
+    return true;
+}
+
+const char *trace_cat2str(uint32_t cat) {
+    int32_t i = 0;
+    while (i < (int32_t) len_trace_cat_names) {
+        if (cat & (1u << i)) {
+            return trace_cat_names[i];
+        }
+
+        i++;
+    }
+
+    return "unknown";
+}
+
+const char *trace_level2str(int32_t level) {
+    if (level < 0 || level >= (int32_t) len_trace_level_names) {
+        return trace_level_names[0];
+    }
+
+    return trace_level_names[level];
+}
+
+void trace_write_all(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(trace_fd, data, len);
+        if (written <= 0) {
+            return;
+        }
+
+        data += written;
+        len -= written;
+    }
+}
+
+// only the owning thread advances head, so draining from the owner (or after all producers stopped) needs no lock
+void trace_drain(TraceBuffer *b) {
+    uint32_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+
+    if (head == tail) {
+        return;
+    }
+
+    uint32_t start = tail % TRACE_BUFFER_SIZE;
+    uint32_t len = head - tail;
+
+    if (start + len > TRACE_BUFFER_SIZE) {
+        uint32_t first = TRACE_BUFFER_SIZE - start;
+        trace_write_all(b->data + start, first);
+        trace_write_all(b->data, len - first);
+    } else {
+        trace_write_all(b->data + start, len);
+    }
+
+    atomic_store_explicit(&b->tail, head, memory_order_release);
+}
+
+TraceBuffer *trace_get_local() {
+    if (trace_local != NULL) {
+        return trace_local;
+    }
+
+    TraceBuffer *b = (TraceBuffer *) calloc(1, sizeof(TraceBuffer));
+    if (b == NULL) {
+        return NULL;
+    }
+
+    TraceBuffer *first = atomic_load(&trace_buffers);
+    do {
+        b->next = first;
+    } while (!atomic_compare_exchange_weak(&trace_buffers, &first, b));
+
+    trace_local = b;
+
+    return b;
+}
+
+void trace_ring_write(TraceBuffer *b, const char *record, uint32_t len) {
+    uint32_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&b->tail, memory_order_acquire);
+
+    if (TRACE_BUFFER_SIZE - (head - tail) < len) {
+        trace_drain(b);
+    }
+
+    uint32_t start = head % TRACE_BUFFER_SIZE;
+
+    if (start + len > TRACE_BUFFER_SIZE) {
+        uint32_t first = TRACE_BUFFER_SIZE - start;
+        memcpy(b->data + start, record, first);
+        memcpy(b->data, record + first, len - first);
+    } else {
+        memcpy(b->data + start, record, len);
+    }
+
+    atomic_store_explicit(&b->head, head + len, memory_order_release);
+}
+
+void trace_emit(uint32_t cat, int32_t level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    trace_vemit(cat, level, fmt, args);
+    va_end(args);
+}
+
+void trace_vemit(uint32_t cat, int32_t level, const char *fmt, va_list args) {
+    TraceBuffer *b = trace_get_local();
+    if (b == NULL) {
+        return;
+    }
+
+    char record[TRACE_MAX_RECORD];
+    int32_t prefix = snprintf(record, sizeof(record), "[%s] %s: ", trace_level2str(level), trace_cat2str(cat));
+    int32_t body = vsnprintf(record + prefix, sizeof(record) - prefix - 1, fmt, args);
+
+    if (body < 0) {
+        return;
+    }
+
+    int32_t len = prefix + body;
+    if (len > TRACE_MAX_RECORD - 2) {
+        len = TRACE_MAX_RECORD - 2;
+    }
+
+    record[len++] = '\n';
+
+    trace_ring_write(b, record, len);
+}
+
+void trace_flush() {
+    if (trace_local != NULL) {
+        trace_drain(trace_local);
+    }
+}
+
+// must only be called once no other thread is emitting
+void trace_shutdown() {
+    TraceBuffer *b = atomic_load(&trace_buffers);
+
+    while (b != NULL) {
+        trace_drain(b);
+        b = b->next;
+    }
+}
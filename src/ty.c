@@ -64,6 +64,7 @@ Ty *ty_new_struct(Ident name, Vec fields) {
     struc->t = ty_create_type(TY_STRUCT);
     struc->name = name;
     struc->fields = fields;
+    struc->ir_ty = 0;
 
     Ty *t = (Ty *) struc;
 
@@ -78,6 +79,7 @@ void ty_init_struct(Ty *t, Ident name) {
     struc->t = *t;
     struc->name = name;
     struc->fields = vec_create(sizeof(StructField));
+    struc->ir_ty = 0;
 
     flag_set(&struc->t.flags, FLAG_SCOPED);
 
@@ -95,7 +97,8 @@ Struct *ty_as_struct(Ty *t) {
 void ty_push_field(Struct *t, Ident name, Ty *ty) {
     StructField field = {
         .name = name,
-        .ty = ty
+        .ty = ty,
+        .offset = 0
     };
     
     vec_push(&t->fields, (void *) &field);
@@ -109,6 +112,23 @@ int32_t ty_num_fields(Struct *t) {
     return t->fields.len;
 }
 
+int32_t ty_field_index(Struct *t, SpanInterner *si, Ident *name) {
+    int32_t len = ident_len(name, si);
+    int32_t i = 0;
+
+    while (i < t->fields.len) {
+        StructField *f = ty_field_at(t, i);
+
+        if (ident_len(&f->name, si) == len && strncmp(f->name.ident, name->ident, len) == 0) {
+            return i;
+        }
+
+        i++;
+    }
+
+    return -1;
+}
+
 Ty *ty_new_func(Ty *ret, Ptrvec params, Ident name) {
     TypeList parameters = ty_create_type_list(params);
     Func *func = (Func *) malloc(sizeof(Func));
@@ -116,6 +136,8 @@ Ty *ty_new_func(Ty *ret, Ptrvec params, Ident name) {
     func->ret = ret;
     func->params = parameters;
     func->name = name;
+    func->is_varargs = false;
+    func->ir_idx = -1;
 
     Ty *t = (Ty *) func;
 
@@ -136,6 +158,7 @@ Ty *ty_new_mod() {
     Mod *mod = (Mod *) malloc(sizeof(Mod));
     mod->t = ty_create_type(TY_MOD);
     mod->scope = scope_create();
+    mod->idx = -1;
 
     Ty *t = (Ty *) mod;
 
@@ -178,6 +201,30 @@ bool ty_is_initialized(Ty *t) {
     return (t->width != WIDTH_UNKNOWN) || (flag_get(&t->flags, FLAG_UNSIZED));
 }
 
+// structs are nominal and only ever have one instance, every other type is compared structurally
+bool ty_eq(Ty *a, Ty *b) {
+    if (a == NULL || b == NULL || a->kind != b->kind) {
+        return false;
+    }
+
+    if (ty_is_ptr(a)) {
+        Ptr *pa = ty_as_ptr(a);
+        Ptr *pb = ty_as_ptr(b);
+
+        return pa->count == pb->count && ty_eq(pa->inner, pb->inner);
+    }
+
+    if (ty_is_struct(a) || ty_is_func(a) || ty_is_mod(a)) {
+        return a == b;
+    }
+
+    return true;
+}
+
+bool ty_is_scalar(Ty *t) {
+    return t != NULL && (ty_is_i32(t) || ty_is_ptr(t) || ty_is_string(t));
+}
+
 bool ty_is_scoped(Ty *t) {
     if (t == NULL) {
         return false;
@@ -221,10 +268,10 @@ void ty_type_free(Ty *t) {
         return;
     }
 
+    // the parameter and return types are shared, only the list belongs to the function
     if (ty_is_func(t)) {
         Func *f_ty = ty_as_func(t);
-        ty_type_free(f_ty->ret);
-        ty_type_list_free(&f_ty->params);
+        ptrvec_free(&f_ty->params.types);
     }
 
     if (ty_is_struct(t)) {
@@ -261,10 +308,11 @@ bool ty_fill_width_align(Ty *t) {
         width = 8;
     } else if (ty_is_struct(t)) {
         Struct *s_ty = ty_as_struct(t);
-        int32_t max_align = align;
+        int32_t max_align = 1;
         int32_t width_sum = 0;
         int32_t i = 0;
 
+        // fields are laid out in declaration order with natural alignment, like a C compiler would
         while (i < s_ty->fields.len) {
             StructField *f = ty_field_at(s_ty, i);
             bool is_placeholder = flag_get(&f->ty->flags, FLAG_PLACEHOLDER);
@@ -274,19 +322,19 @@ bool ty_fill_width_align(Ty *t) {
             }
 
             if (f != NULL && !is_placeholder) {
-                int32_t a = f->ty->align;
+                int32_t a = f->ty->align > 0 ? f->ty->align : 1;
                 if (a > max_align) {
                     max_align = a;
                 }
 
-                int32_t w = f->ty->width;
-                width_sum += w;
+                f->offset = (width_sum + a - 1) / a * a;
+                width_sum = f->offset + f->ty->width;
             }
 
             i++;
         }
 
-        width = width_sum;
+        width = (width_sum + max_align - 1) / max_align * max_align;
         align = max_align;
     }
 
@@ -323,9 +371,26 @@ const char *ty_to_string(Ty *t, SpanInterner *si) {
         return strdup("string");
     }
 
+    if (ty_is_ptr(t)) {
+        Ptr *p_ty = ty_as_ptr(t);
+        const char *inner = ty_to_string(p_ty->inner, si);
+        const char *s = fmt_str("%.*s%s", p_ty->count, "****************", inner != NULL ? inner : "?");
+        free((void *) inner);
+
+        return s;
+    }
+
+    if (ty_is_struct(t)) {
+        Struct *s_ty = ty_as_struct(t);
+        return fmt_str("%.*s", ident_len(&s_ty->name, si), s_ty->name.ident);
+    }
+
     if (ty_is_func(t)) {
-        char *name = "name";
-        const char *s = fmt_str("fn %s(...): ...", name);
+        Func *f_ty = ty_as_func(t);
+        const char *ret = ty_to_string(f_ty->ret, si);
+        const char *s = fmt_str("fn %.*s(...): %s", ident_len(&f_ty->name, si), f_ty->name.ident, ret != NULL ? ret : "?");
+        free((void *) ret);
+
         return s;
     }
 
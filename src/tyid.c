@@ -4,10 +4,9 @@ Type type_empty() {
     return type_create(ident_empty());
 }
 
+// compared field by field, memcmp would also compare the padding after pointer_count
 bool type_is_empty(Type *t) {
-    Type empty = type_empty();
-    memset((void *) &empty, 0, sizeof(Ident));
-    return memcmp((void *) t, (void *) &empty, sizeof(Type)) == 0;
+    return t->pointer_count == 0 && t->ident.ident == NULL;
 }
 
 Type type_create(Ident ident) {
@@ -1,3 +1,5 @@
+#include "../include/trace.h"
+#include "../include/timetrace.h"
 #include "../include/typecheck.h"
 
 WaitingRequest typecheck_create_waiting_request(WaitingType kind, Ty *to_fill, Module *to_fill_mod, Ty *waiting_for_ty, Module *waiting_for_mod, int32_t field_idx) {
@@ -35,9 +37,7 @@ void typecheck_add_request(WaitingRequestMap *wrm, SpanInterner *si, WaitingRequ
     Vec *requests = NULL;
     Ident *ident = typecheck_req_waiting_for_ident(&request);
 
-    const char *s = ident_to_string(ident, si);
-    printf("debug: adding request for '%s'\n", s);
-    free((void *) s);
+    TRACE_DEBUG(TRACE_CAT_TYPECHECK, "adding request for '%.*s'", ident_len(ident, si), ident->ident);
 
     Key key = map_key_from_ident(si, ident);
     void *request_idx = map_get(&wrm->request_map, key);
@@ -101,6 +101,7 @@ void typecheck_free_err(TypeError *err) {
 Ctx typecheck_empty_ctx() {
     Ctx ctx = {
         .mod = NULL,
+        .func = NULL,
         .imports = map_create(),
         .scopes = scope_empty_stack()
     };
@@ -117,6 +118,7 @@ Ctx typecheck_create_ctx(Module *mod, SpanInterner *si, Scope *global) {
 
     Ctx ctx = {
         .mod = mod,
+        .func = NULL,
         .imports = map_create(),
         .scopes = scopes
     };
@@ -139,10 +141,13 @@ TypeChecker typecheck_create(SpanInterner *si, ModuleMap *mods) {
         .mods = mods,
         .sorted_mods = typecheck_sorted_mods(mods, si),
         .temp_types = ptrvec_with_cap(256),
+        .i32_ty = NULL,
+        .string_ty = NULL,
         .ctx = typecheck_empty_ctx(),
         .globals = scope_create(),
         .errors = vec_create(sizeof(TypeError)),
-        .requests = vec_with_cap(sizeof(WaitingRequestMap), mod_num_mods(mods))
+        .requests = vec_with_cap(sizeof(WaitingRequestMap), mod_num_mods(mods)),
+        .num_become = 0
     };
 
     vec_init_zero(&typechecker.requests);
@@ -168,7 +173,13 @@ WaitingRequestMap *typecheck_get_waiting_map(TypeChecker *tc, Module *mod) {
 
 Scope typecheck_create_global_scope(TypeChecker *tc) {
     Scope scope = scope_create();
-    scope_s_bind_in(&scope, 3, "i32", typecheck_push_tmp_ty(tc, ty_new_i32()));
+
+    // literals share the builtin types instead of allocating one per expression
+    tc->i32_ty = typecheck_push_tmp_ty(tc, ty_new_i32());
+    tc->string_ty = typecheck_push_tmp_ty(tc, ty_new_string());
+
+    scope_s_bind_in(&scope, 3, "i32", tc->i32_ty);
+    scope_s_bind_in(&scope, 6, "string", tc->string_ty);
 
     return scope;
 }
@@ -214,6 +225,15 @@ int32_t *typecheck_sorted_mods(ModuleMap *mods, SpanInterner *si) {
 
 Mod *typecheck_make_mod_type(TypeChecker *tc, Module *mod, SpanInterner *si) {
     Mod *mod_ty = (Mod *) ty_new_mod();
+    mod_ty->idx = mod->idx;
+
+    typecheck_declare_structs(tc, mod_ty, mod, si);
+
+    return mod_ty;
+}
+
+// every struct gets a placeholder before any statement is checked, so types can refer to the ones declared after them
+void typecheck_declare_structs(TypeChecker *tc, Mod *mod_ty, Module *mod, SpanInterner *si) {
     int32_t i = 0;
     int32_t num_structs = mod_num_structs(mod);
 
@@ -224,15 +244,11 @@ Mod *typecheck_make_mod_type(TypeChecker *tc, Module *mod, SpanInterner *si) {
         ty_init_struct(s_ty, s->name);
         typecheck_push_tmp_ty(tc, s_ty);
 
-        const char *name = ident_to_string(&s->name, si);
-        printf("debug: creating placeholder for '%s'\n", name);
-        free((void *) name);
+        TRACE_DEBUG(TRACE_CAT_TYPECHECK, "creating placeholder for '%.*s'", ident_len(&s->name, si), s->name.ident);
 
         scope_bind_in(&mod_ty->scope, si, &s->name, s_ty);
         i++;
     }
-
-    return mod_ty;
 }
 
 Ty *typecheck_lookup_ident(TypeChecker *tc, Ident *ident) {
@@ -249,7 +265,7 @@ Ty *typecheck_lookup_ident_mod(TypeChecker *tc, Ident *ident, Module **out_mod)
 
     Module *mod = typecheck_get_mod_by_alias(&tc->ctx, dot_idx, ident->ident);
     if (mod == NULL) {
-        printf("[error] debug: module '%.*s' not found\n", len, ident->ident);
+        TRACE_WARN(TRACE_CAT_TYPECHECK, "module '%.*s' not found", len, ident->ident);
         return NULL;
     }
 
@@ -259,7 +275,7 @@ Ty *typecheck_lookup_ident_mod(TypeChecker *tc, Ident *ident, Module **out_mod)
 
     Ty *ty = mod_s_lookup(mod, len - dot_idx - 1, ident->ident + dot_idx + 1);
     if (ty == NULL) {
-        printf("[error] debug: type '%.*s' not found\n", len, ident->ident);
+        TRACE_WARN(TRACE_CAT_TYPECHECK, "type '%.*s' not found", len, ident->ident);
         return NULL;
     }
 
@@ -283,13 +299,38 @@ Mod *typecheck_check_mod(TypeChecker *tc, Module *mod) {
         return mod->ty;
     }
 
+    int32_t tt = TIMETRACE_BEGIN("check module", mod->path.len, mod->path.inner, 0, NULL);
+
     mod->ty = typecheck_make_mod_type(tc, mod, tc->si);
 
     typecheck_free_ctx(&tc->ctx);
     tc->ctx = typecheck_create_ctx(mod, tc->si, &tc->globals);
 
-    printf("checking '%.*s'\n", mod->path.len, mod->path.inner);
+    TRACE_INFO(TRACE_CAT_MOD, "checking '%.*s'", mod->path.len, mod->path.inner);
+
+    typecheck_check_stmts(tc, mod);
+
+    TIMETRACE_END(tt);
+
+    return mod->ty;
+}
 
+// a module that continues the one in the context, the repl checks every input this way. it shares the
+// module's type, so the names it declares stay visible to the modules continuing it later
+void typecheck_continue_mod(TypeChecker *tc, Module *mod) {
+    Module *cur = tc->ctx.mod;
+
+    mod->ty = cur->ty;
+    mod->idx = cur->idx;
+    tc->ctx.mod = mod;
+
+    typecheck_declare_structs(tc, mod->ty, mod, tc->si);
+    *scope_at(&tc->ctx.scopes, 1) = mod->ty->scope;
+
+    typecheck_check_stmts(tc, mod);
+}
+
+void typecheck_check_stmts(TypeChecker *tc, Module *mod) {
     int32_t i = 0;
     while (i < mod_num_stmts(mod)) {
         Stmt *result = typecheck_check_stmt(tc, mod_get_stmt_at(mod, i));
@@ -300,7 +341,12 @@ Mod *typecheck_check_mod(TypeChecker *tc, Module *mod) {
         i++;
     }
 
-    return mod->ty;
+    // bodies are checked once every signature in the module is known, so functions can call the ones declared after them
+    i = 0;
+    while (i < mod_num_functions(mod)) {
+        typecheck_check_func_body(tc, mod_get_function_at(mod, i));
+        i++;
+    }
 }
 
 Ty *typecheck_push_tmp_ty(TypeChecker *tc, Ty *ty) {
@@ -312,14 +358,136 @@ void typecheck_bind(TypeChecker *tc, Ident *ident, Ty *ty) {
     scope_bind(&tc->ctx.scopes, ident, ty);
 }
 
+// module level names go into the module's own scope, so other modules can reach them through their import alias.
+// the scope stack holds a copy of that scope, which is written back because binding may have resized it
+void typecheck_bind_global(TypeChecker *tc, Ident *ident, Ty *ty) {
+    Scope *scope = scope_at(&tc->ctx.scopes, 1);
+
+    scope_bind_in(scope, tc->si, ident, ty);
+    tc->ctx.mod->ty->scope = *scope;
+}
+
+// type names and variables of that type are bound to the same Ty, so a struct is only named by its own name
+bool typecheck_names_type(TypeChecker *tc, Ident *ident, Ty *ty) {
+    int32_t len = ident_len(ident, tc->si);
+    int32_t dot_idx = ident_index_of(ident, len, '.');
+    const char *name = ident->ident + dot_idx + 1;
+
+    len -= dot_idx + 1;
+
+    if (ty == tc->i32_ty) {
+        return len == 3 && strncmp(name, "i32", 3) == 0;
+    }
+
+    if (ty == tc->string_ty) {
+        return len == 6 && strncmp(name, "string", 6) == 0;
+    }
+
+    if (ty_is_struct(ty)) {
+        Struct *s_ty = ty_as_struct(ty);
+        return ident_len(&s_ty->name, tc->si) == len && strncmp(s_ty->name.ident, name, len) == 0;
+    }
+
+    return false;
+}
+
+Ty *typecheck_resolve_type(TypeChecker *tc, Type *t) {
+    Ty *ty = typecheck_lookup_ident(tc, &t->ident);
+
+    if (ty == NULL || !typecheck_names_type(tc, &t->ident, ty)) {
+        const char *ty_s = type_to_string(t, tc->si);
+        typecheck_push_mk_error(tc, fmt_str("unknown type '%s'", ty_s), type_span(t));
+        free((void *) ty_s);
+
+        return NULL;
+    }
+
+    if (t->pointer_count > 0) {
+        ty = typecheck_push_tmp_ty(tc, ty_new_ptr(t->pointer_count, ty));
+    }
+
+    return ty;
+}
+
+Ty *typecheck_ref_ty(TypeChecker *tc, Ty *inner) {
+    if (ty_is_ptr(inner)) {
+        Ptr *p_ty = ty_as_ptr(inner);
+        return typecheck_push_tmp_ty(tc, ty_new_ptr(p_ty->count + 1, p_ty->inner));
+    }
+
+    return typecheck_push_tmp_ty(tc, ty_new_ptr(1, inner));
+}
+
+Ty *typecheck_deref_ty(TypeChecker *tc, Ty *ptr) {
+    Ptr *p_ty = ty_as_ptr(ptr);
+
+    if (p_ty->count == 1) {
+        return p_ty->inner;
+    }
+
+    return typecheck_push_tmp_ty(tc, ty_new_ptr(p_ty->count - 1, p_ty->inner));
+}
+
+// fields can be accessed on struct values and, through one implicit dereference, on pointers to structs
+Struct *typecheck_accessed_struct(Ty *ty) {
+    if (ty == NULL) {
+        return NULL;
+    }
+
+    if (ty_is_struct(ty)) {
+        return ty_as_struct(ty);
+    }
+
+    if (ty_is_ptr(ty) && ty_as_ptr(ty)->count == 1 && ty_is_struct(ty_as_ptr(ty)->inner)) {
+        return ty_as_struct(ty_as_ptr(ty)->inner);
+    }
+
+    return NULL;
+}
+
+bool typecheck_is_lvalue(Expr *e) {
+    if (ast_is_ident_expr(e)) {
+        return !ty_is_func(e->ty) && !ty_is_mod(e->ty);
+    }
+
+    if (ast_is_unary_expr(e)) {
+        return ast_as_unary_expr(e)->ty == UNARY_DEREF;
+    }
+
+    if (ast_is_access_expr(e)) {
+        Expr *left = ast_as_access_expr(e)->left;
+
+        if (ty_is_mod(left->ty)) {
+            return !ty_is_func(e->ty);
+        }
+
+        return ty_is_ptr(left->ty) || typecheck_is_lvalue(left);
+    }
+
+    return false;
+}
+
+// module level variables are initialized in the data section, so their values must be known at compile time
+bool typecheck_is_constant(Expr *e) {
+    if (ast_is_int_expr(e) || ast_is_string_expr(e) || ast_is_char_expr(e)) {
+        return true;
+    }
+
+    if (ast_is_unary_expr(e)) {
+        UnaryExpr *u_e = ast_as_unary_expr(e);
+        return u_e->ty == UNARY_NEG_NUM && ast_is_int_expr(u_e->right);
+    }
+
+    return false;
+}
+
 void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s_ty) {
     if (ty_is_initialized((Ty *) s_ty)) {
         return;
     }
 
-    const char *s = ident_to_string(&s_decl->name, tc->si);
-    printf("-----\ndebug: resolving '%s'\n", s);
-    free((void *) s);
+    int32_t name_len = ident_len(&s_decl->name, tc->si);
+    TRACE_DEBUG(TRACE_CAT_LAYOUT, "resolving '%.*s'", name_len, s_decl->name.ident);
 
     bool error = false;
     bool waiting = false;
@@ -330,13 +498,11 @@ void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s
         Field f = record_field_empty();
 
         if (!record_field_at(s_decl, i, &f)) {
-            printf("[error] debug: todo\n");
+            TRACE_ERROR(TRACE_CAT_LAYOUT, "could not read field %d of '%.*s'", i, name_len, s_decl->name.ident);
             return;
         }
 
-        const char *s = type_to_string(&f.ty, tc->si);
-        printf("debug: field type = '%s'\n", s);
-        free((void *) s);
+        TRACE_DEBUG(TRACE_CAT_LAYOUT, "field type = '%.*s%.*s'", f.ty.pointer_count, "****************", ident_len(&f.ty.ident, tc->si), f.ty.ident.ident);
 
         Module *mod = NULL;
         Ty *field_ty = typecheck_lookup_ident_mod(tc, &f.ty.ident, &mod);
@@ -350,7 +516,7 @@ void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s
                         mod = tc->ctx.mod;
                     }
 
-                    printf("debug: field type is a struct, creating a placeholder...\n");
+                    TRACE_DEBUG(TRACE_CAT_LAYOUT, "field type is a struct, creating a placeholder");
 
                     Ty *placeholder = ty_new_placeholder_type(TY_STRUCT, sizeof(Struct));
                     ty_init_struct(placeholder, f.ty.ident);
@@ -361,7 +527,7 @@ void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s
                     typecheck_wait_for(tc, request);
                     waiting = true;
                 } else {
-                    printf("\ndebug: unreachable\n\n");
+                    TRACE_ERROR(TRACE_CAT_LAYOUT, "unreachable: uninitialized non-struct field type");
                 }
             } else {
                 if (is_ptr) {
@@ -374,22 +540,17 @@ void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s
         } else {
             error = true;
 
-            const char *s = ident_to_string(&f.ty.ident, tc->si);
-            printf("[error] debug: '%s' is null\n", s);
-            free((void *) s);
+            TRACE_WARN(TRACE_CAT_LAYOUT, "'%.*s' is null", ident_len(&f.ty.ident, tc->si), f.ty.ident.ident);
         }
 
         i++;
     }
 
-    s = ident_to_string(&s_decl->name, tc->si);
-
     if (!error && !waiting) {
         Ty *ty = (Ty *) s_ty;
         ty_fill_width_align(ty);
 
-        printf("debug: '%s' has a width of '%d' and an alignment of '%d'\n", s, ty->width, ty->align);
-        free((void *) s);
+        TRACE_DEBUG(TRACE_CAT_LAYOUT, "'%.*s' has a width of '%d' and an alignment of '%d'", name_len, s_decl->name.ident, ty->width, ty->align);
 
         typecheck_update_waiting(tc, tc->ctx.mod, ty, &s_ty->name);
 
@@ -397,10 +558,8 @@ void typecheck_fill_struct_fields(TypeChecker *tc, StructDecl *s_decl, Struct *s
     }
 
     if (error) {
-        printf("[error] debug: error while filling '%s'\n", s);
+        TRACE_WARN(TRACE_CAT_LAYOUT, "error while filling '%.*s'", name_len, s_decl->name.ident);
     }
-
-    free((void *) s);
 }
 
 void typecheck_update_waiting(TypeChecker *tc, Module *mod, Ty *resolved_ty, Ident *ident) {
@@ -408,16 +567,11 @@ void typecheck_update_waiting(TypeChecker *tc, Module *mod, Ty *resolved_ty, Ide
     Vec *waiting = typecheck_get_waiting(waiting_map, tc->si, ident);
 
     if (waiting == NULL) {
-        const char *name = ident_to_string(ident, tc->si);
-        printf("debug: no other types are waiting for '%s' (with width of '%d' and an alignment of '%d')\n", name, resolved_ty->width, resolved_ty->align);
-        free((void *) name);
-
+        TRACE_DEBUG(TRACE_CAT_LAYOUT, "no other types are waiting for '%.*s' (with width of '%d' and an alignment of '%d')", ident_len(ident, tc->si), ident->ident, resolved_ty->width, resolved_ty->align);
         return;
     }
 
-    const char *name = ident_to_string(ident, tc->si);
-    printf("debug: there are '%ld' types waiitng for '%s'\n", waiting->len, name);
-    free((void *) name);
+    TRACE_DEBUG(TRACE_CAT_LAYOUT, "there are '%ld' types waiting for '%.*s'", (long) waiting->len, ident_len(ident, tc->si), ident->ident);
 
     int32_t i = 0;
     while (i < waiting->len) {
@@ -432,9 +586,7 @@ void typecheck_update_waiting(TypeChecker *tc, Module *mod, Ty *resolved_ty, Ide
 
         bool no_placeholders = ty_fill_width_align(waiting_ty);
         if (no_placeholders) {
-            const char *name = ident_to_string(waiting_ident, tc->si);
-            printf("debug: '%s' has no placeholder left\n", name);
-            free((void *) name);
+            TRACE_DEBUG(TRACE_CAT_LAYOUT, "'%.*s' has no placeholder left", ident_len(waiting_ident, tc->si), waiting_ident->ident);
 
             typecheck_update_waiting(tc, waiting_mod, waiting_ty, waiting_ident);
         }
@@ -442,9 +594,7 @@ void typecheck_update_waiting(TypeChecker *tc, Module *mod, Ty *resolved_ty, Ide
         i++;
     }
 
-    const char *s = ident_to_string(ident, tc->si);
-    printf("debug: ----- '%s' with width of '%d' and an alignment of '%d'\n", s, resolved_ty->width, resolved_ty->align);
-    free((void *) s);
+    TRACE_DEBUG(TRACE_CAT_LAYOUT, "'%.*s' resolved with width of '%d' and an alignment of '%d'", ident_len(ident, tc->si), ident->ident, resolved_ty->width, resolved_ty->align);
 }
 
 Ident *typecheck_get_import_alias(TypeChecker *tc, ImportStmt *imp) {
@@ -452,13 +602,24 @@ Ident *typecheck_get_import_alias(TypeChecker *tc, ImportStmt *imp) {
 }
 
 Stmt *typecheck_check_stmt(TypeChecker *tc, Stmt *s) {
+    bool top_level = tc->ctx.func == NULL;
+
     if (ast_is_import_stmt(s)) {
         ImportStmt *i_s = ast_as_import_stmt(s);
+
+        if (!top_level) {
+            typecheck_push_mk_error(tc, strdup("modules can only be imported at the top level"), i_s->mod.ident_span);
+            return NULL;
+        }
+
+        Path *cur_path = &tc->ctx.mod->path;
+        int32_t tt = TIMETRACE_BEGIN("check import", cur_path->len, cur_path->inner, ident_len(&i_s->mod, tc->si), i_s->mod.ident);
         char *error = NULL;
         Module *imported_mod = mod_try_get_mod_from_import(tc->mods, tc->ctx.mod, tc->si, i_s, &error);
 
         if (imported_mod == NULL) {
             typecheck_push_mk_error(tc, error, i_s->mod.ident_span);
+            TIMETRACE_END(tt);
             return NULL;
         }
 
@@ -478,26 +639,41 @@ Stmt *typecheck_check_stmt(TypeChecker *tc, Stmt *s) {
         }
 
         typecheck_bind(tc, &i_s->mod, (Ty *) mod_ty);
+        TIMETRACE_END(tt);
 
         return s;
     }
 
     if (ast_is_struct_decl_stmt(s)) {
         StructDecl *s_d = &ast_as_struct_decl_stmt(s)->decl;
+
+        if (!top_level) {
+            typecheck_push_mk_error(tc, strdup("types can only be declared at the top level"), s_d->name.ident_span);
+            return NULL;
+        }
+
         Ty *definition = typecheck_lookup_ident(tc, &s_d->name);
 
         if (definition == NULL) {
-            const char *name = ident_to_string(&s_d->name, tc->si);
-            printf("[debug] error: '%s' is not defined\n", name);
-            free((void *) name);
+            TRACE_ERROR(TRACE_CAT_TYPECHECK, "'%.*s' is not defined", ident_len(&s_d->name, tc->si), s_d->name.ident);
+            return NULL;
         }
 
+        Path *cur_path = &tc->ctx.mod->path;
+        int32_t tt = TIMETRACE_BEGIN("struct layout", cur_path->len, cur_path->inner, ident_len(&s_d->name, tc->si), s_d->name.ident);
+
         ty_init_struct(definition, s_d->name);
         typecheck_fill_struct_fields(tc, s_d, (Struct *) definition);
 
+        TIMETRACE_END(tt);
+
         return s;
     }
 
+    if (ast_is_func_decl_stmt(s)) {
+        return typecheck_check_func_decl(tc, ast_as_func_decl_stmt(s)) ? s : NULL;
+    }
+
     if (ast_is_let_stmt(s)) {
         LetStmt *l_s = ast_as_let_stmt(s);
         Expr *value = typecheck_check_expr(tc, l_s->value);
@@ -507,13 +683,57 @@ Stmt *typecheck_check_stmt(TypeChecker *tc, Stmt *s) {
         }
 
         l_s->value = value;
-        typecheck_bind(tc, &l_s->ident, l_s->value->ty);
+        Ty *ty = value->ty;
+
+        if (ast_has_type_decl(l_s)) {
+            ty = typecheck_resolve_type(tc, &l_s->ty);
+
+            if (ty == NULL) {
+                return NULL;
+            }
+
+            if (!ty_eq(ty, value->ty)) {
+                const char *expected = ty_to_string(ty, tc->si);
+                const char *got = ty_to_string(value->ty, tc->si);
+
+                typecheck_push_mk_error(tc, fmt_str("expected a value of type '%s', got '%s'", expected, got), value->span);
+                free((void *) expected);
+                free((void *) got);
+
+                return NULL;
+            }
+        }
+
+        if (!ty_is_scalar(ty) && !ty_is_struct(ty)) {
+            const char *ty_s = ty_to_string(ty, tc->si);
+            typecheck_push_mk_error(tc, fmt_str("a value of type '%s' cannot be stored in a variable", ty_s), value->span);
+            free((void *) ty_s);
+
+            return NULL;
+        }
+
+        if (top_level) {
+            if (!typecheck_is_constant(value)) {
+                typecheck_push_mk_error(tc, strdup("module level variables must be initialized with a literal"), value->span);
+                return NULL;
+            }
+
+            typecheck_bind_global(tc, &l_s->ident, ty);
+        } else {
+            typecheck_bind(tc, &l_s->ident, ty);
+        }
 
         return s;
     }
 
     if (ast_is_expr_stmt(s)) {
         ExprStmt *e_s = ast_as_expr_stmt(s);
+
+        if (top_level) {
+            typecheck_push_mk_error(tc, strdup("expressions are only allowed inside functions"), e_s->expr->span);
+            return NULL;
+        }
+
         Expr *expr = typecheck_check_expr(tc, e_s->expr);
         
         if (expr == NULL) {
@@ -525,58 +745,752 @@ Stmt *typecheck_check_stmt(TypeChecker *tc, Stmt *s) {
         return s;
     }
 
+    if (ast_is_block_stmt(s)) {
+        if (top_level) {
+            typecheck_push_mk_error(tc, strdup("blocks are only allowed inside functions"), span_empty());
+            return NULL;
+        }
+
+        return typecheck_check_block(tc, ast_as_block_stmt(s)) ? s : NULL;
+    }
+
+    if (ast_is_if_stmt(s)) {
+        IfStmt *i_s = ast_as_if_stmt(s);
+
+        if (top_level) {
+            typecheck_push_mk_error(tc, strdup("'if' is only allowed inside functions"), i_s->condition->span);
+            return NULL;
+        }
+
+        // every branch is checked even if the condition is invalid, to report as many errors as possible
+        bool ok = typecheck_check_cond(tc, i_s->condition);
+        ok = typecheck_check_block(tc, i_s->block) && ok;
+
+        if (i_s->else_stmt != NULL) {
+            ok = typecheck_check_stmt(tc, i_s->else_stmt) != NULL && ok;
+        }
+
+        return ok ? s : NULL;
+    }
+
+    if (ast_is_while_stmt(s)) {
+        WhileStmt *w_s = ast_as_while_stmt(s);
+
+        if (top_level) {
+            typecheck_push_mk_error(tc, strdup("'while' is only allowed inside functions"), w_s->cond->span);
+            return NULL;
+        }
+
+        bool ok = typecheck_check_cond(tc, w_s->cond);
+        ok = typecheck_check_block(tc, w_s->block) && ok;
+
+        return ok ? s : NULL;
+    }
+
+    if (ast_is_delete_stmt(s)) {
+        DeleteStmt *d_s = ast_as_delete_stmt(s);
+
+        if (top_level) {
+            typecheck_push_mk_error(tc, strdup("'delete' is only allowed inside functions"), d_s->expr->span);
+            return NULL;
+        }
+
+        Expr *expr = typecheck_check_expr(tc, d_s->expr);
+
+        if (expr == NULL) {
+            return NULL;
+        }
+
+        if (!ty_is_ptr(expr->ty)) {
+            const char *ty_s = ty_to_string(expr->ty, tc->si);
+            typecheck_push_mk_error(tc, fmt_str("only pointers can be deleted, got '%s'", ty_s), expr->span);
+            free((void *) ty_s);
+
+            return NULL;
+        }
+
+        return s;
+    }
+
+    if (ast_is_return_stmt(s)) {
+        ReturnStmt *r_s = ast_as_return_stmt(s);
+
+        if (top_level) {
+            typecheck_push_mk_error(tc, fmt_str("'%s' is only allowed inside functions", r_s->become ? "become" : "return"), r_s->expr != NULL ? r_s->expr->span : span_empty());
+            return NULL;
+        }
+
+        Func *f_ty = tc->ctx.func;
+
+        if (r_s->expr == NULL) {
+            const char *ret_s = ty_to_string(f_ty->ret, tc->si);
+            typecheck_push_mk_error(tc, fmt_str("missing return value of type '%s'", ret_s), f_ty->name.ident_span);
+            free((void *) ret_s);
+
+            return NULL;
+        }
+
+        Expr *expr = typecheck_check_expr(tc, r_s->expr);
+
+        if (expr == NULL) {
+            return NULL;
+        }
+
+        if (!ty_eq(expr->ty, f_ty->ret)) {
+            const char *expected = ty_to_string(f_ty->ret, tc->si);
+            const char *got = ty_to_string(expr->ty, tc->si);
+
+            typecheck_push_mk_error(tc, fmt_str("expected a return value of type '%s', got '%s'", expected, got), expr->span);
+            free((void *) expected);
+            free((void *) got);
+
+            return NULL;
+        }
+
+        if (r_s->become && !typecheck_check_become(tc, expr)) {
+            return NULL;
+        }
+
+        return s;
+    }
+
     return NULL;
 }
 
+// the frame of the function is gone once a tail call starts, so the copies of structs passed by value can not
+// live in it. what else keeps a call from being a tail call is only known once it is lowered
+bool typecheck_check_become(TypeChecker *tc, Expr *expr) {
+    tc->num_become++;
+
+    if (!ast_is_call_expr(expr)) {
+        typecheck_push_mk_error(tc, strdup("'become' needs a function call"), expr->span);
+        return false;
+    }
+
+    CallExpr *c_e = ast_as_call_expr(expr);
+    int32_t num_args = ast_num_args(&c_e->args);
+    bool ok = true;
+    int32_t i = 0;
+
+    while (i < num_args) {
+        Expr *arg = ast_get_arg_at(&c_e->args, i);
+
+        if (ty_is_struct(arg->ty)) {
+            typecheck_push_mk_error(tc, strdup("'become' can not pass structs by value, their copies would live in the caller's frame"), arg->span);
+            ok = false;
+        }
+
+        i++;
+    }
+
+    return ok;
+}
+
+bool typecheck_check_func_decl(TypeChecker *tc, FuncDeclStmt *f_s) {
+    FuncDef *def = &f_s->decl;
+
+    if (tc->ctx.func != NULL) {
+        typecheck_push_mk_error(tc, strdup("functions can only be declared at the top level"), def->name.ident_span);
+        return false;
+    }
+
+    int32_t name_len = ident_len(&def->name, tc->si);
+
+    if (mod_s_lookup(tc->ctx.mod, name_len, def->name.ident) != NULL) {
+        typecheck_push_mk_error(tc, fmt_str("'%.*s' is already defined", name_len, def->name.ident), def->name.ident_span);
+        return false;
+    }
+
+    bool ok = true;
+    bool is_varargs = false;
+    Ty *ret = typecheck_resolve_type(tc, &def->ret_ty);
+    Ptrvec params = ptrvec_with_cap(func_num_params(def) + 1);
+    int32_t i = 0;
+
+    while (i < func_num_params(def)) {
+        Param *p = (Param *) vec_get_ptr(&def->params.params, i);
+
+        if (param_is_varargs(p)) {
+            is_varargs = true;
+        } else {
+            Ty *ty = typecheck_resolve_type(tc, &p->ty);
+
+            if (ty == NULL) {
+                ok = false;
+            }
+
+            ptrvec_push_ptr(&params, (void *) ty);
+        }
+
+        i++;
+    }
+
+    if (ret == NULL || !ok) {
+        ptrvec_free(&params);
+        return false;
+    }
+
+    Func *f_ty = (Func *) typecheck_push_tmp_ty(tc, ty_new_func(ret, params, def->name));
+    f_ty->is_varargs = is_varargs;
+
+    typecheck_bind_global(tc, &def->name, (Ty *) f_ty);
+
+    return true;
+}
+
+void typecheck_check_func_body(TypeChecker *tc, FuncDeclStmt *f_s) {
+    FuncDef *def = &f_s->decl;
+
+    if (def->is_extern || f_s->block == NULL) {
+        return;
+    }
+
+    // a redefinition or an invalid signature was already reported
+    Ty *ty = mod_s_lookup(tc->ctx.mod, ident_len(&def->name, tc->si), def->name.ident);
+    if (ty == NULL || !ty_is_func(ty) || ty_as_func(ty)->name.ident != def->name.ident) {
+        return;
+    }
+
+    Func *f_ty = ty_as_func(ty);
+    Path *cur_path = &tc->ctx.mod->path;
+    int32_t tt = TIMETRACE_BEGIN("check function", cur_path->len, cur_path->inner, ident_len(&def->name, tc->si), def->name.ident);
+
+    tc->ctx.func = f_ty;
+    scope_open(&tc->ctx.scopes);
+
+    int32_t i = 0;
+    while (i < f_ty->params.types.len) {
+        Param *p = (Param *) vec_get_ptr(&def->params.params, i);
+        typecheck_bind(tc, &p->name, ty_type_at(&f_ty->params, i));
+
+        i++;
+    }
+
+    typecheck_check_block(tc, f_s->block);
+
+    scope_close(&tc->ctx.scopes);
+    tc->ctx.func = NULL;
+
+    TIMETRACE_END(tt);
+}
+
+bool typecheck_check_block(TypeChecker *tc, BlockStmt *b) {
+    bool ok = true;
+    int32_t i = 0;
+
+    scope_open(&tc->ctx.scopes);
+
+    while (i < b->stmts.len) {
+        if (typecheck_check_stmt(tc, (Stmt *) ptrvec_get(&b->stmts, i)) == NULL) {
+            ok = false;
+        }
+
+        i++;
+    }
+
+    scope_close(&tc->ctx.scopes);
+
+    return ok;
+}
+
+bool typecheck_check_cond(TypeChecker *tc, Expr *e) {
+    if (typecheck_check_expr(tc, e) == NULL) {
+        return false;
+    }
+
+    if (!ty_is_scalar(e->ty)) {
+        const char *ty_s = ty_to_string(e->ty, tc->si);
+        typecheck_push_mk_error(tc, fmt_str("a value of type '%s' cannot be used as a condition", ty_s), e->span);
+        free((void *) ty_s);
+
+        return false;
+    }
+
+    return true;
+}
+
 Expr *typecheck_check_expr(TypeChecker *tc, Expr *e) {
-    if (ast_is_int_expr(e)) {
-        e->ty = ty_new_i32();
-        typecheck_push_tmp_ty(tc, e->ty);
+    switch (e->tag) {
+        case EXPR_INT: {
+            return typecheck_check_int_lit(tc, e, false) ? e : NULL;
+        }
 
-        return e;
+        case EXPR_CHAR: {
+            e->ty = tc->i32_ty;
+            return e;
+        }
+
+        case EXPR_STRING: {
+            e->ty = tc->string_ty;
+            return e;
+        }
+
+        case EXPR_IDENT: {
+            Ident *ident = &ast_as_ident_expr(e)->ident;
+            e->ty = typecheck_lookup_ident(tc, ident);
+
+            if (e->ty == NULL) {
+                typecheck_push_mk_error(tc, fmt_str("'%.*s' is not defined", ident_len(ident, tc->si), ident->ident), e->span);
+                return NULL;
+            }
+
+            if (typecheck_names_type(tc, ident, e->ty)) {
+                typecheck_push_mk_error(tc, fmt_str("'%.*s' is a type, not a value", ident_len(ident, tc->si), ident->ident), e->span);
+                return NULL;
+            }
+
+            return e;
+        }
+
+        case EXPR_ACCESS: {
+            return typecheck_check_access_expr(tc, ast_as_access_expr(e));
+        }
+
+        case EXPR_CALL: {
+            return typecheck_check_call_expr(tc, ast_as_call_expr(e));
+        }
+
+        case EXPR_INIT: {
+            return typecheck_check_init_expr(tc, ast_as_init_expr(e));
+        }
+
+        case EXPR_BINARY: {
+            return typecheck_check_binary_expr(tc, ast_as_binary_expr(e));
+        }
+
+        case EXPR_UNARY: {
+            return typecheck_check_unary_expr(tc, ast_as_unary_expr(e));
+        }
+
+        case EXPR_ASSIGN: {
+            AssignExpr *a_e = ast_as_assign_expr(e);
+            Expr *left = typecheck_check_expr(tc, a_e->left);
+            Expr *right = typecheck_check_expr(tc, a_e->right);
+
+            if (left == NULL || right == NULL) {
+                return NULL;
+            }
+
+            if (!typecheck_is_lvalue(left)) {
+                typecheck_push_mk_error(tc, strdup("the left side of an assignment must be a variable, a field or a dereference"), left->span);
+                return NULL;
+            }
+
+            if (!ty_eq(left->ty, right->ty)) {
+                const char *expected = ty_to_string(left->ty, tc->si);
+                const char *got = ty_to_string(right->ty, tc->si);
+
+                typecheck_push_mk_error(tc, fmt_str("cannot assign a value of type '%s' to '%s'", got, expected), right->span);
+                free((void *) expected);
+                free((void *) got);
+
+                return NULL;
+            }
+
+            e->ty = left->ty;
+            return e;
+        }
+
+        case EXPR_AS: {
+            AsExpr *a_e = ast_as_as_expr(e);
+            Expr *inner = typecheck_check_expr(tc, a_e->expr);
+            Ty *target = typecheck_resolve_type(tc, &a_e->ty);
+
+            if (inner == NULL || target == NULL) {
+                return NULL;
+            }
+
+            if (!ty_is_scalar(inner->ty) || !ty_is_scalar(target)) {
+                const char *from = ty_to_string(inner->ty, tc->si);
+                const char *to = ty_to_string(target, tc->si);
+
+                typecheck_push_mk_error(tc, fmt_str("cannot cast '%s' to '%s'", from, to), e->span);
+                free((void *) from);
+                free((void *) to);
+
+                return NULL;
+            }
+
+            e->ty = target;
+            return e;
+        }
+
+        case EXPR_NEW: {
+            NewExpr *n_e = ast_as_new_expr(e);
+            Expr *inner = typecheck_check_expr(tc, n_e->expr);
+
+            if (inner == NULL) {
+                return NULL;
+            }
+
+            if (!ty_is_scalar(inner->ty) && !ty_is_struct(inner->ty)) {
+                const char *ty_s = ty_to_string(inner->ty, tc->si);
+                typecheck_push_mk_error(tc, fmt_str("a value of type '%s' cannot be allocated", ty_s), inner->span);
+                free((void *) ty_s);
+
+                return NULL;
+            }
+
+            e->ty = typecheck_ref_ty(tc, inner->ty);
+            return e;
+        }
     }
 
-    if (ast_is_string_expr(e)) {
-        e->ty = ty_new_string();
-        typecheck_push_tmp_ty(tc, e->ty);
+    return NULL;
+}
 
-        return e;
+Expr *typecheck_check_access_expr(TypeChecker *tc, AccessExpr *a_e) {
+    Expr *e = (Expr *) a_e;
+    Expr *left = typecheck_check_expr(tc, a_e->left);
+
+    if (left == NULL) {
+        return NULL;
     }
 
-    if (ast_is_ident_expr(e)) {
-        e->ty = typecheck_lookup_ident(tc, &ast_as_ident_expr(e)->ident);
+    a_e->left = left;
+
+    Ident *member = &ast_as_ident_expr(a_e->right)->ident;
+    int32_t member_len = ident_len(member, tc->si);
+
+    if (ty_is_mod(left->ty)) {
+        Module *mod = mod_get_mod(tc->mods, ty_as_mod(left->ty)->idx);
+        e->ty = mod_s_lookup(mod, member_len, member->ident);
 
         if (e->ty == NULL) {
+            typecheck_push_mk_error(tc, fmt_str("'%.*s' is not defined in '%.*s'", member_len, member->ident, mod->path.len, mod->path.inner), a_e->right->span);
             return NULL;
         }
 
+        a_e->right->ty = e->ty;
         return e;
     }
 
-    if (ast_is_access_expr(e)) {
-        AccessExpr *a_e = ast_as_access_expr(e);
-        Expr *left = typecheck_check_expr(tc, a_e->left);
+    Struct *s_ty = typecheck_accessed_struct(left->ty);
 
-        if (left == NULL) {
-            return NULL;
+    if (s_ty == NULL) {
+        const char *ty_s = ty_to_string(left->ty, tc->si);
+        const char *error = fmt_str("'%s' cannot be accessed with the dot operator", ty_s);
+        free((void *) ty_s);
+
+        typecheck_push_mk_error(tc, error, left->span);
+
+        return NULL;
+    }
+
+    int32_t idx = ty_field_index(s_ty, tc->si, member);
+
+    if (idx < 0) {
+        const char *ty_s = ty_to_string((Ty *) s_ty, tc->si);
+        typecheck_push_mk_error(tc, fmt_str("'%s' has no field named '%.*s'", ty_s, member_len, member->ident), a_e->right->span);
+        free((void *) ty_s);
+
+        return NULL;
+    }
+
+    e->ty = ty_field_at(s_ty, idx)->ty;
+    a_e->right->ty = e->ty;
+
+    return e;
+}
+
+Expr *typecheck_check_call_expr(TypeChecker *tc, CallExpr *c_e) {
+    Expr *e = (Expr *) c_e;
+    Expr *callee = typecheck_check_expr(tc, c_e->ident);
+
+    if (callee == NULL) {
+        return NULL;
+    }
+
+    if (!ty_is_func(callee->ty)) {
+        const char *ty_s = ty_to_string(callee->ty, tc->si);
+        typecheck_push_mk_error(tc, fmt_str("a value of type '%s' cannot be called", ty_s), callee->span);
+        free((void *) ty_s);
+
+        return NULL;
+    }
+
+    Func *f_ty = ty_as_func(callee->ty);
+    int32_t num_params = f_ty->params.types.len;
+    int32_t num_args = ast_num_args(&c_e->args);
+
+    if (num_args < num_params || (num_args > num_params && !f_ty->is_varargs)) {
+        int32_t name_len = ident_len(&f_ty->name, tc->si);
+        typecheck_push_mk_error(tc, fmt_str("'%.*s' expects %d arguments, got %d", name_len, f_ty->name.ident, num_params, num_args), e->span);
+
+        return NULL;
+    }
+
+    bool ok = true;
+    int32_t i = 0;
+
+    while (i < num_args) {
+        Expr *arg = typecheck_check_expr(tc, ast_get_arg_at(&c_e->args, i));
+
+        if (arg == NULL) {
+            ok = false;
+        } else if (i < num_params && !ty_eq(arg->ty, ty_type_at(&f_ty->params, i))) {
+            const char *expected = ty_to_string(ty_type_at(&f_ty->params, i), tc->si);
+            const char *got = ty_to_string(arg->ty, tc->si);
+
+            typecheck_push_mk_error(tc, fmt_str("expected an argument of type '%s', got '%s'", expected, got), arg->span);
+            free((void *) expected);
+            free((void *) got);
+
+            ok = false;
+        } else if (i >= num_params && !ty_is_scalar(arg->ty)) {
+            typecheck_push_mk_error(tc, strdup("only integers, strings and pointers can be passed as variadic arguments"), arg->span);
+            ok = false;
         }
 
-        a_e->left = left;
+        i++;
+    }
 
-        if (!ty_is_scoped(a_e->left->ty)) {
-            const char *ty_s = ty_to_string(a_e->left->ty, tc->si);
-            const char *error = fmt_str("'%s' cannot be accessed with the dot operator", ty_s);
+    if (!ok) {
+        return NULL;
+    }
+
+    e->ty = f_ty->ret;
+    return e;
+}
+
+Expr *typecheck_check_init_expr(TypeChecker *tc, InitExpr *i_e) {
+    Expr *e = (Expr *) i_e;
+    Expr *name = i_e->ident;
+    Ty *ty = NULL;
+
+    // the struct is named by 'Name' or 'module.Name', neither of which is a value
+    if (ast_is_ident_expr(name)) {
+        Ident *ident = &ast_as_ident_expr(name)->ident;
+        ty = typecheck_lookup_ident(tc, ident);
+
+        if (ty == NULL || !typecheck_names_type(tc, ident, ty)) {
+            ty = NULL;
+        }
+    } else if (ast_is_access_expr(name)) {
+        AccessExpr *a_e = ast_as_access_expr(name);
+
+        if (ast_is_ident_expr(a_e->left)) {
+            Ident *alias = &ast_as_ident_expr(a_e->left)->ident;
+            Ident *member = &ast_as_ident_expr(a_e->right)->ident;
+            Ty *mod_ty = typecheck_lookup_ident(tc, alias);
+
+            if (mod_ty != NULL && ty_is_mod(mod_ty)) {
+                Module *mod = mod_get_mod(tc->mods, ty_as_mod(mod_ty)->idx);
+                ty = mod_s_lookup(mod, ident_len(member, tc->si), member->ident);
+
+                if (ty == NULL || !typecheck_names_type(tc, member, ty)) {
+                    ty = NULL;
+                }
+            }
+        }
+    }
+
+    if (ty == NULL || !ty_is_struct(ty)) {
+        typecheck_push_mk_error(tc, strdup("expected the name of a struct before '{'"), name->span);
+        return NULL;
+    }
+
+    Struct *s_ty = ty_as_struct(ty);
+    name->ty = ty;
+
+    bool ok = true;
+    int32_t i = 0;
+
+    while (i < ast_num_inits(&i_e->inits)) {
+        Init *init = (Init *) vec_get_ptr(&i_e->inits.inits, i);
+        int32_t field_len = ident_len(&init->ident, tc->si);
+        int32_t idx = ty_field_index(s_ty, tc->si, &init->ident);
+        Expr *value = typecheck_check_expr(tc, init->expr);
+
+        if (idx < 0) {
+            const char *ty_s = ty_to_string(ty, tc->si);
+            typecheck_push_mk_error(tc, fmt_str("'%s' has no field named '%.*s'", ty_s, field_len, init->ident.ident), init->ident.ident_span);
             free((void *) ty_s);
 
-            typecheck_push_mk_error(tc, error, a_e->left->span);
+            ok = false;
+        } else if (value != NULL && !ty_eq(value->ty, ty_field_at(s_ty, idx)->ty)) {
+            const char *expected = ty_to_string(ty_field_at(s_ty, idx)->ty, tc->si);
+            const char *got = ty_to_string(value->ty, tc->si);
 
-            return NULL;
+            typecheck_push_mk_error(tc, fmt_str("field '%.*s' has type '%s', got '%s'", field_len, init->ident.ident, expected, got), value->span);
+            free((void *) expected);
+            free((void *) got);
+
+            ok = false;
+        }
+
+        if (value == NULL) {
+            ok = false;
+        }
+
+        int32_t j = 0;
+        while (j < i) {
+            Init *prev = (Init *) vec_get_ptr(&i_e->inits.inits, j);
+
+            if (ident_len(&prev->ident, tc->si) == field_len && strncmp(prev->ident.ident, init->ident.ident, field_len) == 0) {
+                typecheck_push_mk_error(tc, fmt_str("field '%.*s' is initialized twice", field_len, init->ident.ident), init->ident.ident_span);
+                ok = false;
+                break;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    if (!ok) {
+        return NULL;
+    }
+
+    e->ty = ty;
+    return e;
+}
+
+Expr *typecheck_check_binary_expr(TypeChecker *tc, BinaryExpr *b_e) {
+    Expr *e = (Expr *) b_e;
+    Expr *left = typecheck_check_expr(tc, b_e->left);
+    Expr *right = typecheck_check_expr(tc, b_e->right);
+
+    if (left == NULL || right == NULL) {
+        return NULL;
+    }
+
+    bool ok = false;
+
+    // an integer added to or subtracted from a pointer moves it by that many pointees, like in C
+    if ((b_e->ty == BINARY_ADD || b_e->ty == BINARY_SUB) && ty_is_ptr(left->ty) && ty_is_i32(right->ty)) {
+        e->ty = left->ty;
+        return e;
+    }
+
+    switch (b_e->ty) {
+        case BINARY_ADD:
+        case BINARY_SUB:
+        case BINARY_MUL:
+        case BINARY_DIV:
+        case BINARY_MOD: {
+            ok = ty_is_i32(left->ty) && ty_is_i32(right->ty);
+            break;
+        }
+
+        case BINARY_ST:
+        case BINARY_SE:
+        case BINARY_GT:
+        case BINARY_GE:
+        case BINARY_EQ:
+        case BINARY_NE: {
+            ok = ty_is_scalar(left->ty) && ty_eq(left->ty, right->ty);
+            break;
+        }
+
+        case BINARY_LOG_AND:
+        case BINARY_LOG_OR: {
+            ok = ty_is_scalar(left->ty) && ty_is_scalar(right->ty);
+            break;
         }
     }
 
+    if (!ok) {
+        const char *l = ty_to_string(left->ty, tc->si);
+        const char *r = ty_to_string(right->ty, tc->si);
+
+        typecheck_push_mk_error(tc, fmt_str("invalid operand types '%s' and '%s'", l, r), e->span);
+        free((void *) l);
+        free((void *) r);
+
+        return NULL;
+    }
+
+    // there is no boolean type, comparisons and logical operators produce 0 or 1
+    e->ty = tc->i32_ty;
     return e;
 }
 
+// the smallest i32 is only written as a negated literal, so its literal is one past the largest
+bool typecheck_check_int_lit(TypeChecker *tc, Expr *e, bool negated) {
+    IntExpr *i_e = ast_as_int_expr(e);
+    int64_t max = negated ? (int64_t) INT32_MAX + 1 : INT32_MAX;
+
+    if (i_e->value > max) {
+        int32_t len = span_get(tc->si, e->span).len;
+        typecheck_push_mk_error(tc, fmt_str("integer literal '%.*s' does not fit in i32", len, i_e->ptr), e->span);
+
+        return false;
+    }
+
+    e->ty = tc->i32_ty;
+    return true;
+}
+
+Expr *typecheck_check_unary_expr(TypeChecker *tc, UnaryExpr *u_e) {
+    Expr *e = (Expr *) u_e;
+
+    if (u_e->ty == UNARY_NEG_NUM && ast_is_int_expr(u_e->right)) {
+        if (!typecheck_check_int_lit(tc, u_e->right, true)) {
+            return NULL;
+        }
+
+        e->ty = tc->i32_ty;
+        return e;
+    }
+
+    Expr *right = typecheck_check_expr(tc, u_e->right);
+
+    if (right == NULL) {
+        return NULL;
+    }
+
+    switch (u_e->ty) {
+        case UNARY_REF: {
+            if (!typecheck_is_lvalue(right)) {
+                typecheck_push_mk_error(tc, strdup("only variables, fields and dereferences can have their address taken"), right->span);
+                return NULL;
+            }
+
+            e->ty = typecheck_ref_ty(tc, right->ty);
+            return e;
+        }
+
+        case UNARY_DEREF: {
+            if (!ty_is_ptr(right->ty)) {
+                const char *ty_s = ty_to_string(right->ty, tc->si);
+                typecheck_push_mk_error(tc, fmt_str("only pointers can be dereferenced, got '%s'", ty_s), right->span);
+                free((void *) ty_s);
+
+                return NULL;
+            }
+
+            e->ty = typecheck_deref_ty(tc, right->ty);
+            return e;
+        }
+
+        case UNARY_NEG_BOOL: {
+            if (!ty_is_scalar(right->ty)) {
+                break;
+            }
+
+            e->ty = tc->i32_ty;
+            return e;
+        }
+
+        case UNARY_NEG_NUM: {
+            if (!ty_is_i32(right->ty)) {
+                break;
+            }
+
+            e->ty = tc->i32_ty;
+            return e;
+        }
+    }
+
+    const char *ty_s = ty_to_string(right->ty, tc->si);
+    typecheck_push_mk_error(tc, fmt_str("invalid operand type '%s'", ty_s), e->span);
+    free((void *) ty_s);
+
+    return NULL;
+}
+
 void typecheck_free_tc(TypeChecker *tc) {
     typecheck_free_ctx(&tc->ctx);
 
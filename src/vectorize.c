@@ -0,0 +1,1067 @@
+#include <string.h>
+
+#include "../include/vectorize.h"
+#include "../include/trace.h"
+
+Vectorizer vectorize_create(IrModule *m) {
+    Vectorizer vz;
+    memset((void *) &vz, 0, sizeof(Vectorizer));
+
+    vz.m = m;
+    vz.body = vec_create(sizeof(IrValue));
+    vz.blocks = vec_create(sizeof(IrBlockId));
+    vz.streams = vec_create(sizeof(VecStream));
+    vz.reductions = vec_create(sizeof(VecReduction));
+    vz.selects = vec_create(sizeof(VecSelect));
+    vz.arm_loads = vec_create(sizeof(IrValue));
+
+    return vz;
+}
+
+void vectorize_free(Vectorizer *vz) {
+    free((void *) vz->role);
+    free((void *) vz->stream);
+    free((void *) vz->uses);
+    free((void *) vz->last_use);
+    free((void *) vz->vmap);
+    free((void *) vz->splat);
+    vec_free(&vz->body);
+    vec_free(&vz->blocks);
+    vec_free(&vz->streams);
+    vec_free(&vz->reductions);
+    vec_free(&vz->selects);
+    vec_free(&vz->arm_loads);
+}
+
+void vectorize_reserve(Vectorizer *vz, uint32_t num_values) {
+    if (num_values > vz->cap_values) {
+        vz->cap_values = num_values * 2;
+        vz->role = (uint8_t *) realloc((void *) vz->role, vz->cap_values * sizeof(uint8_t));
+        vz->stream = (uint32_t *) realloc((void *) vz->stream, vz->cap_values * sizeof(uint32_t));
+        vz->uses = (uint32_t *) realloc((void *) vz->uses, vz->cap_values * sizeof(uint32_t));
+        vz->last_use = (int32_t *) realloc((void *) vz->last_use, vz->cap_values * sizeof(int32_t));
+        vz->vmap = (IrValue *) realloc((void *) vz->vmap, vz->cap_values * sizeof(IrValue));
+        vz->splat = (IrValue *) realloc((void *) vz->splat, vz->cap_values * sizeof(IrValue));
+    }
+}
+
+IrValue vectorize_body_at(Vectorizer *vz, uint32_t i) {
+    return *(IrValue *) vec_get_ptr(&vz->body, i);
+}
+
+VecStream *vectorize_stream_at(Vectorizer *vz, uint32_t i) {
+    return (VecStream *) vec_get_ptr(&vz->streams, i);
+}
+
+VecReduction *vectorize_reduction_at(Vectorizer *vz, uint32_t i) {
+    return (VecReduction *) vec_get_ptr(&vz->reductions, i);
+}
+
+VecSelect *vectorize_find_select(Vectorizer *vz, IrValue phi) {
+    uint32_t i = 0;
+
+    while (i < vz->selects.len) {
+        VecSelect *s = (VecSelect *) vec_get_ptr(&vz->selects, i);
+
+        if (s->phi == phi) {
+            return s;
+        }
+
+        i++;
+    }
+
+    return NULL;
+}
+
+bool vectorize_reject(Vectorizer *vz, const char *reason) {
+    vz->reason = reason;
+    return false;
+}
+
+bool vectorize_is_invariant(Vectorizer *vz, IrValue v) {
+    return loop_is_invariant(vz->forest, vz->f, vz->loop, v);
+}
+
+// the value operands of an instruction as the vector loop sees them: a phi joining the arms of an if reads the
+// if's condition and the value of each arm
+uint32_t vectorize_operands(Vectorizer *vz, IrValue v, IrValue *out) {
+    IrFunc *f = vz->f;
+    IrInst *inst = &f->insts[v];
+
+    if (inst->op == IR_PHI && f->insts[v].block != loop_get(vz->forest, vz->loop)->header) {
+        VecSelect *s = vectorize_find_select(vz, v);
+
+        out[0] = s->cond;
+        out[1] = s->then_value;
+        out[2] = s->else_value;
+        return 3;
+    }
+
+    IrValue *ops = ir_inst_ops(f, inst);
+    uint32_t n = ir_inst_num_values(inst);
+    uint32_t i = 0;
+
+    while (i < n && i < 3) {
+        out[i] = ops[i];
+        i++;
+    }
+
+    return i;
+}
+
+// an arm of an if: entered only from the branch, it falls through to the join without branching itself
+bool vectorize_is_arm(Vectorizer *vz, IrBlockId arm, IrBlockId join) {
+    IrFunc *f = vz->f;
+    IrBlock *block = &f->blocks[arm];
+    IrValue term = ir_block_terminator(f, arm);
+
+    return arm != join && loop_contains(vz->forest, vz->loop, arm) && block->num_preds == 1 &&
+           f->insts[block->insts[0]].op != IR_PHI && f->insts[term].op == IR_BR && f->insts[term].u.ops[0] == join;
+}
+
+// an arm runs on some iterations only, and the vector loop runs it on all of them
+bool vectorize_push_block(Vectorizer *vz, IrBlockId b, bool is_arm) {
+    IrFunc *f = vz->f;
+    IrBlock *block = &f->blocks[b];
+    uint32_t i = 0;
+
+    vec_push(&vz->blocks, (void *) &b);
+
+    while (i + 1 < block->num_insts) {
+        IrValue v = block->insts[i];
+
+        if (f->insts[v].op != IR_PHI) {
+            if (is_arm && ir_op_has_side_effects((IrOp) f->insts[v].op)) {
+                return vectorize_reject(vz, "an if in the body has side effects");
+            }
+
+            if (is_arm && f->insts[v].op == IR_LOAD) {
+                vec_push(&vz->arm_loads, (void *) &v);
+            }
+
+            vec_push(&vz->body, (void *) &v);
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+// the body from the header's successor in the loop to the latch, where every branch is an if whose arms only
+// compute values. the phis joining the arms become selects on the branch's condition
+bool vectorize_walk(Vectorizer *vz, Loop *l, IrBlockId b) {
+    IrFunc *f = vz->f;
+
+    while (true) {
+        if (!loop_contains(vz->forest, vz->loop, b) || b == l->header) {
+            return vectorize_reject(vz, "the body has more than one path");
+        }
+
+        if (!vectorize_push_block(vz, b, false)) {
+            return false;
+        }
+
+        IrInst *term = &f->insts[ir_block_terminator(f, b)];
+
+        if (term->op == IR_BR && term->u.ops[0] == l->header) {
+            break;
+        }
+
+        if (term->op == IR_BR) {
+            b = term->u.ops[0];
+
+            if (f->blocks[b].num_preds != 1) {
+                return vectorize_reject(vz, "the body has more than one path");
+            }
+
+            continue;
+        }
+
+        if (term->op != IR_CBR) {
+            return vectorize_reject(vz, "the body leaves the loop");
+        }
+
+        IrValue cond = term->u.ops[0];
+        IrBlockId then_block = term->u.ops[1];
+        IrBlockId else_block = term->u.ops[2];
+        IrBlockId then_pred = b;
+        IrBlockId else_pred = b;
+        IrBlockId join = IR_NO_BLOCK;
+
+        if (vectorize_is_arm(vz, then_block, else_block)) {
+            join = else_block;
+            then_pred = then_block;
+        } else if (vectorize_is_arm(vz, else_block, then_block)) {
+            join = then_block;
+            else_pred = else_block;
+        } else if (f->insts[ir_block_terminator(f, then_block)].op == IR_BR) {
+            join = f->insts[ir_block_terminator(f, then_block)].u.ops[0];
+            then_pred = then_block;
+            else_pred = else_block;
+
+            if (!vectorize_is_arm(vz, then_block, join) || !vectorize_is_arm(vz, else_block, join)) {
+                return vectorize_reject(vz, "the body has a branch that is not an if");
+            }
+        } else {
+            return vectorize_reject(vz, "the body has a branch that is not an if");
+        }
+
+        if (f->blocks[join].num_preds != 2 || join == l->header) {
+            return vectorize_reject(vz, "the body has a branch that is not an if");
+        }
+
+        if (then_pred != b && !vectorize_push_block(vz, then_pred, true)) {
+            return false;
+        }
+
+        if (else_pred != b && !vectorize_push_block(vz, else_pred, true)) {
+            return false;
+        }
+
+        IrBlock *jb = &f->blocks[join];
+        uint32_t i = 0;
+
+        while (i < jb->num_insts && f->insts[jb->insts[i]].op == IR_PHI) {
+            IrValue phi = jb->insts[i];
+            IrValue *ops = ir_inst_ops(f, &f->insts[phi]);
+            VecSelect s = { phi, cond, ops[ir_pred_index(f, join, then_pred)], ops[ir_pred_index(f, join, else_pred)] };
+
+            vec_push(&vz->selects, (void *) &s);
+            vec_push(&vz->body, (void *) &phi);
+            i++;
+        }
+
+        b = join;
+    }
+
+    if (vz->blocks.len + 1 != l->num_blocks) {
+        return vectorize_reject(vz, "the body has more than one path");
+    }
+
+    return true;
+}
+
+// `int_to_ptr(base + sext(iv) * 4)` with base invariant, as `p + i` on an `*i32` is lowered
+bool vectorize_match_addr(Vectorizer *vz, Loop *l, IrValue v) {
+    IrFunc *f = vz->f;
+    IrInst *add = &f->insts[f->insts[v].u.ops[0]];
+
+    if (add->op != IR_ADD || add->ty != IR_TYPE_I64) {
+        return false;
+    }
+
+    uint32_t k = vectorize_is_invariant(vz, add->u.ops[0]) ? 0 : 1;
+    IrValue base = add->u.ops[k];
+    IrInst *mul = &f->insts[add->u.ops[1 - k]];
+
+    if (!vectorize_is_invariant(vz, base) || mul->op != IR_MUL) {
+        return false;
+    }
+
+    uint32_t j = f->insts[mul->u.ops[0]].op == IR_CONST ? 0 : 1;
+    IrInst *size = &f->insts[mul->u.ops[j]];
+    IrInst *index = &f->insts[mul->u.ops[1 - j]];
+
+    if (size->op != IR_CONST || size->imm != 4 || index->op != IR_SEXT || index->u.ops[0] != l->iv) {
+        return false;
+    }
+
+    uint32_t s = 0;
+    while (s < vz->streams.len && vectorize_stream_at(vz, s)->base != base) {
+        s++;
+    }
+
+    if (s == vz->streams.len) {
+        VecStream stream;
+        memset((void *) &stream, 0, sizeof(VecStream));
+        stream.base = base;
+        vec_push(&vz->streams, (void *) &stream);
+    }
+
+    vz->role[v] = VEC_ROLE_ADDR;
+    vz->role[f->insts[v].u.ops[0]] = VEC_ROLE_ADDR;
+    vz->role[add->u.ops[1 - k]] = VEC_ROLE_ADDR;
+    vz->role[mul->u.ops[1 - j]] = VEC_ROLE_ADDR;
+    vz->stream[v] = s;
+
+    return true;
+}
+
+bool vectorize_operand_ok(Vectorizer *vz, IrValue v) {
+    switch (vz->role[v]) {
+        case VEC_ROLE_LANE:
+            return true;
+        case VEC_ROLE_IV:
+            return vectorize_reject(vz, "the counter is used as a value");
+        case VEC_ROLE_ADDR:
+            return vectorize_reject(vz, "an address is used as a value");
+        default:
+            if (!vectorize_is_invariant(vz, v) || vz->f->insts[v].ty != IR_TYPE_I32) {
+                return vectorize_reject(vz, "a value that is not an i32 computed per element");
+            }
+
+            return true;
+    }
+}
+
+bool vectorize_classify(Vectorizer *vz, IrValue v) {
+    IrFunc *f = vz->f;
+    IrInst *inst = &f->insts[v];
+    IrValue ops[3];
+    uint32_t n = vectorize_operands(vz, v, ops);
+    uint32_t first = 0;
+
+    if (vz->role[v] != VEC_ROLE_NONE) {
+        return true;
+    }
+
+    switch (inst->op) {
+        case IR_LOAD:
+        case IR_STORE: {
+            IrValue ptr = inst->u.ops[0];
+
+            if (f->insts[ptr].op != IR_INT_TO_PTR || vz->role[ptr] != VEC_ROLE_ADDR) {
+                return vectorize_reject(vz, "an access that is not to p + i");
+            }
+
+            if (f->insts[inst->op == IR_LOAD ? v : inst->u.ops[1]].ty != IR_TYPE_I32) {
+                return vectorize_reject(vz, "an access that is not to an i32");
+            }
+
+            VecStream *s = vectorize_stream_at(vz, vz->stream[ptr]);
+            s->is_loaded = s->is_loaded || inst->op == IR_LOAD;
+            s->is_stored = s->is_stored || inst->op == IR_STORE;
+            first = 1;
+            break;
+        }
+
+        case IR_PHI:
+            first = 1;
+            if (vz->role[ops[0]] != VEC_ROLE_LANE || !ir_op_is_compare((IrOp) f->insts[ops[0]].op)) {
+                return vectorize_reject(vz, "an if on a condition that is not computed per element");
+            }
+            break;
+
+        case IR_SELECT:
+            if (vz->role[ops[0]] != VEC_ROLE_LANE || !ir_op_is_compare((IrOp) f->insts[ops[0]].op)) {
+                return vectorize_reject(vz, "a select on a condition that is not computed per element");
+            }
+            break;
+
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_AND: case IR_OR: case IR_XOR: case IR_COPY:
+            if (inst->ty != IR_TYPE_I32) {
+                return vectorize_reject(vz, "arithmetic on a type other than i32");
+            }
+            break;
+
+        case IR_EQ: case IR_NE: case IR_LT: case IR_LE: case IR_GT: case IR_GE:
+            if (f->insts[ops[0]].ty != IR_TYPE_I32) {
+                return vectorize_reject(vz, "a comparison of a type other than i32");
+            }
+            break;
+
+        case IR_CALL:
+            return vectorize_reject(vz, "a call");
+
+        case IR_DIV:
+        case IR_MOD:
+            return vectorize_reject(vz, "a division, which has no vector instruction");
+
+        default:
+            return vectorize_reject(vz, "an operation without a vector form");
+    }
+
+    while (first < n) {
+        if (!vectorize_operand_ok(vz, ops[first])) {
+            return false;
+        }
+
+        first++;
+    }
+
+    vz->role[v] = inst->op == IR_STORE ? VEC_ROLE_NONE : VEC_ROLE_LANE;
+    return true;
+}
+
+// index arithmetic may only feed addresses, the counter only the test, its increment and the index
+bool vectorize_check_uses(Vectorizer *vz, Loop *l, IrValue cond, IrValue next) {
+    IrFunc *f = vz->f;
+    uint32_t k = 0;
+
+    while (k <= vz->blocks.len) {
+        IrBlockId b = k == 0 ? l->header : *(IrBlockId *) vec_get_ptr(&vz->blocks, k - 1);
+        IrBlock *block = &f->blocks[b];
+        uint32_t i = 0;
+
+        while (i < block->num_insts) {
+            IrValue u = block->insts[i];
+            IrInst *inst = &f->insts[u];
+            IrValue *ops = ir_inst_ops(f, inst);
+            uint32_t n = ir_inst_num_values(inst);
+            uint32_t j = 0;
+
+            while (j < n) {
+                IrValue o = ops[j];
+                bool is_ptr = (inst->op == IR_LOAD || inst->op == IR_STORE) && j == 0;
+
+                if (vz->role[o] == VEC_ROLE_ADDR && vz->role[u] != VEC_ROLE_ADDR && !is_ptr) {
+                    return vectorize_reject(vz, "index arithmetic is used outside of an address");
+                }
+
+                if ((o == l->iv && u != cond && u != next && vz->role[u] != VEC_ROLE_ADDR) || (o == next && u != l->iv)) {
+                    return vectorize_reject(vz, "the counter is used as a value");
+                }
+
+                if (o == cond && inst->op != IR_CBR) {
+                    return vectorize_reject(vz, "the loop test is used as a value");
+                }
+
+                vz->uses[o]++;
+                j++;
+            }
+
+            i++;
+        }
+
+        k++;
+    }
+
+    return true;
+}
+
+IrValue vectorize_user(Vectorizer *vz, IrValue v) {
+    IrValue ops[3];
+    uint32_t i = 0;
+
+    while (i < vz->body.len) {
+        IrValue u = vectorize_body_at(vz, i);
+        uint32_t n = vectorize_operands(vz, u, ops);
+        uint32_t j = 0;
+
+        while (j < n) {
+            if (ops[j] == v) {
+                return u;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    return IR_NO_VALUE;
+}
+
+// sums may add and subtract elements in any order, wrapping arithmetic makes every order give the same result.
+// a phi picking itself or an element by comparing the two is a running minimum or maximum
+bool vectorize_find_reduction(Vectorizer *vz, Loop *l, IrValue phi, IrValue next) {
+    IrFunc *f = vz->f;
+    VecReduction red = { phi, next, VEC_RED_SUM };
+    IrValue ops[3];
+
+    if (f->insts[phi].ty != IR_TYPE_I32 || vz->uses[next] != 1) {
+        return vectorize_reject(vz, "a value is carried from one iteration to the next");
+    }
+
+    if ((f->insts[next].op == IR_SELECT || (f->insts[next].op == IR_PHI && f->insts[next].block != l->header)) && vz->role[next] == VEC_ROLE_LANE) {
+        vectorize_operands(vz, next, ops);
+
+        IrInst *cmp = &f->insts[ops[0]];
+        IrValue x = cmp->u.ops[0] == phi ? cmp->u.ops[1] : cmp->u.ops[0];
+        bool is_ordered = cmp->op == IR_LT || cmp->op == IR_LE || cmp->op == IR_GT || cmp->op == IR_GE;
+
+        if (is_ordered && x != phi && (cmp->u.ops[0] == phi || cmp->u.ops[1] == phi) && vz->uses[phi] == 2 && vz->uses[ops[0]] == 1 &&
+            ((ops[1] == phi && ops[2] == x) || (ops[1] == x && ops[2] == phi))) {
+            red.kind = VEC_RED_MINMAX;
+            vec_push(&vz->reductions, (void *) &red);
+            return true;
+        }
+
+        return vectorize_reject(vz, "a value is carried from one iteration to the next");
+    }
+
+    IrValue cur = phi;
+    uint32_t steps = 0;
+
+    while (cur != next && steps <= vz->body.len) {
+        IrValue u = vectorize_user(vz, cur);
+        IrInst *inst = &f->insts[u];
+
+        if (vz->uses[cur] != 1 || u == IR_NO_VALUE || !(inst->op == IR_ADD || (inst->op == IR_SUB && inst->u.ops[0] == cur))) {
+            return vectorize_reject(vz, "a value is carried from one iteration to the next");
+        }
+
+        cur = u;
+        steps++;
+    }
+
+    if (cur != next) {
+        return vectorize_reject(vz, "a value is carried from one iteration to the next");
+    }
+
+    vec_push(&vz->reductions, (void *) &red);
+    return true;
+}
+
+bool vectorize_is_pinned(Vectorizer *vz, IrValue v) {
+    uint32_t i = 0;
+
+    while (i < vz->reductions.len) {
+        VecReduction *r = vectorize_reduction_at(vz, i);
+
+        if (r->phi == v || r->next == v) {
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// codegen keeps the accumulators and the splatted invariants in registers for the whole loop and hands out the
+// rest per instruction, freeing each vector after its last use. the loop is only taken when all of them fit
+bool vectorize_check_registers(Vectorizer *vz) {
+    IrValue ops[3];
+    uint32_t pinned = 2 * vz->reductions.len;
+    uint32_t i = 0;
+
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+        uint32_t n = vectorize_operands(vz, v, ops);
+        uint32_t j = 0;
+
+        while (j < n) {
+            if (vz->role[ops[j]] == VEC_ROLE_LANE) {
+                vz->last_use[ops[j]] = (int32_t) i;
+            } else if (vz->role[ops[j]] == VEC_ROLE_NONE && vz->splat[ops[j]] == IR_NO_VALUE) {
+                vz->splat[ops[j]] = 1;
+                pinned++;
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    uint32_t live = 0;
+    uint32_t peak = 0;
+
+    i = 0;
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+        uint32_t n = vectorize_operands(vz, v, ops);
+        uint32_t dying = 0;
+        uint32_t j = 0;
+
+        while (j < n) {
+            IrValue o = ops[j];
+            bool seen = (j > 0 && ops[0] == o) || (j > 1 && ops[1] == o);
+
+            vz->splat[o] = IR_NO_VALUE;
+            dying += !seen && vz->role[o] == VEC_ROLE_LANE && !vectorize_is_pinned(vz, o) && vz->last_use[o] == (int32_t) i;
+            j++;
+        }
+
+        live -= dying;
+
+        if (vz->role[v] == VEC_ROLE_LANE && !vectorize_is_pinned(vz, v)) {
+            live++;
+            peak = live > peak ? live : peak;
+            live -= vz->last_use[v] < 0;
+        }
+
+        i++;
+    }
+
+    if (pinned + peak > VECTORIZE_MAX_VECTORS) {
+        return vectorize_reject(vz, "the body needs more vector registers than there are");
+    }
+
+    return true;
+}
+
+bool vectorize_check(Vectorizer *vz, uint32_t idx) {
+    IrFunc *f = vz->f;
+    Loop *l = loop_get(vz->forest, idx);
+
+    vz->loop = idx;
+    vz->body.len = 0;
+    vz->blocks.len = 0;
+    vz->streams.len = 0;
+    vz->reductions.len = 0;
+    vz->selects.len = 0;
+    vz->arm_loads.len = 0;
+
+    if (l->iv == IR_NO_VALUE || l->step != 1) {
+        return vectorize_reject(vz, "not a loop counting up by one");
+    }
+
+    if (l->trip_count >= 0 && l->trip_count < VECTORIZE_MIN_COUNT) {
+        return vectorize_reject(vz, "too few iterations");
+    }
+
+    IrBlock *header = &f->blocks[l->header];
+    IrValue term = ir_block_terminator(f, l->header);
+    IrValue cond = f->insts[term].u.ops[0];
+    IrValue next = ir_inst_ops(f, &f->insts[l->iv])[ir_pred_index(f, l->header, l->latch)];
+    uint32_t num_phis = 0;
+
+    while (f->insts[header->insts[num_phis]].op == IR_PHI) {
+        num_phis++;
+    }
+
+    if (f->insts[cond].block != l->header || header->num_insts != num_phis + 2) {
+        return vectorize_reject(vz, "the header does more than test the counter");
+    }
+
+    vectorize_reserve(vz, f->num_insts);
+    memset((void *) vz->role, VEC_ROLE_NONE, f->num_insts * sizeof(uint8_t));
+    memset((void *) vz->uses, 0, f->num_insts * sizeof(uint32_t));
+    memset((void *) vz->last_use, 0xff, f->num_insts * sizeof(int32_t));
+    memset((void *) vz->splat, 0, f->num_insts * sizeof(IrValue));
+
+    if (!vectorize_walk(vz, l, f->insts[term].u.ops[1])) {
+        return false;
+    }
+
+    vz->role[l->iv] = VEC_ROLE_IV;
+    vz->role[next] = VEC_ROLE_IV;
+    vz->role[cond] = VEC_ROLE_IV;
+
+    uint32_t i = 0;
+    while (i < num_phis) {
+        vz->role[header->insts[i]] = header->insts[i] == l->iv ? VEC_ROLE_IV : VEC_ROLE_LANE;
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+
+        if (f->insts[v].op == IR_INT_TO_PTR && !vectorize_match_addr(vz, l, v)) {
+            return vectorize_reject(vz, "an address that is not p + i");
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->body.len) {
+        if (!vectorize_classify(vz, vectorize_body_at(vz, i))) {
+            return false;
+        }
+
+        i++;
+    }
+
+    if (vz->streams.len == 0) {
+        return vectorize_reject(vz, "no memory is accessed");
+    }
+
+    if (!vectorize_check_uses(vz, l, cond, next)) {
+        return false;
+    }
+
+    i = 0;
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+        IrInst *inst = &f->insts[v];
+
+        if (inst->op == IR_LOAD || inst->op == IR_STORE) {
+            uint32_t j = 0;
+            bool is_arm = false;
+
+            while (j < vz->arm_loads.len) {
+                is_arm = is_arm || *(IrValue *) vec_get_ptr(&vz->arm_loads, j) == v;
+                j++;
+            }
+
+            vectorize_stream_at(vz, vz->stream[inst->u.ops[0]])->is_unconditional |= !is_arm;
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->streams.len) {
+        if (!vectorize_stream_at(vz, i)->is_unconditional) {
+            return vectorize_reject(vz, "a load only runs on some iterations");
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < num_phis) {
+        IrValue phi = header->insts[i];
+        IrValue phi_next = ir_inst_ops(f, &f->insts[phi])[ir_pred_index(f, l->header, l->latch)];
+
+        if (phi != l->iv && !vectorize_find_reduction(vz, l, phi, phi_next)) {
+            return false;
+        }
+
+        i++;
+    }
+
+    return vectorize_check_registers(vz);
+}
+
+IrValue vectorize_operand(Vectorizer *vz, IrValue v) {
+    return vz->role[v] == VEC_ROLE_LANE ? vz->vmap[v] : vz->splat[v];
+}
+
+// the scalar pattern of a minimum or maximum applied to two values, with the phi standing for acc
+IrValue vectorize_minmax(Vectorizer *vz, IrBuilder *b, VecReduction *r, IrValue acc, IrValue x) {
+    IrFunc *f = vz->f;
+    IrValue ops[3];
+    vectorize_operands(vz, r->next, ops);
+
+    IrInst *cmp = &f->insts[ops[0]];
+    IrValue lhs = cmp->u.ops[0] == r->phi ? acc : x;
+    IrValue rhs = cmp->u.ops[1] == r->phi ? acc : x;
+    IrValue c = ir_build_cmp(b, (IrOp) cmp->op, lhs, rhs);
+
+    return ir_build_select(b, c, ops[1] == r->phi ? acc : x, ops[2] == r->phi ? acc : x);
+}
+
+// the vector loop of one width: the invariants splatted and the pointers set up in init, the loop itself a
+// single block, and the lanes of the reductions combined in done
+IrBlockId vectorize_emit_width(Vectorizer *vz, Loop *l, IrBlockId from, IrBlockId exit, uint32_t lanes, IrValue init64,
+                               IrValue count, IrValue *iv_end, IrValue *results) {
+    IrFunc *f = vz->f;
+    IrBuilder b = ir_builder_create(vz->m, f);
+    IrTypeId vty = lanes == 8 ? IR_TYPE_V8I32 : IR_TYPE_V4I32;
+    IrBlockId vi = ir_block_create(f);
+    IrBlockId vl = ir_block_create(f);
+    IrBlockId vd = ir_block_create(f);
+    uint32_t pi = ir_pred_index(f, l->header, l->preheader);
+    IrValue ops[3];
+
+    f->blocks[vi].freq = f->blocks[from].freq;
+    f->blocks[vl].freq = f->blocks[l->header].freq / lanes + 1;
+    f->blocks[vd].freq = f->blocks[from].freq;
+
+    ir_builder_set_block(&b, vi);
+
+    uint32_t i = 0;
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+        uint32_t n = vectorize_operands(vz, v, ops);
+        uint32_t j = 0;
+
+        while (vz->role[v] != VEC_ROLE_ADDR && vz->role[v] != VEC_ROLE_IV && j < n) {
+            IrValue o = ops[j];
+
+            if (vz->role[o] == VEC_ROLE_NONE && !(f->insts[v].op == IR_STORE && j == 0) && vz->splat[o] == IR_NO_VALUE) {
+                vz->splat[o] = ir_build_splat(&b, vty, o);
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    IrValue *acc_init = (IrValue *) malloc((vz->reductions.len + 1) * sizeof(IrValue));
+    IrValue zero = ir_build_const(&b, IR_TYPE_I32, 0);
+
+    i = 0;
+    while (i < vz->reductions.len) {
+        VecReduction *r = vectorize_reduction_at(vz, i);
+        IrValue r0 = ir_inst_ops(f, &f->insts[r->phi])[pi];
+
+        acc_init[i] = ir_build_splat(&b, vty, r->kind == VEC_RED_SUM ? zero : r0);
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->streams.len) {
+        VecStream *s = vectorize_stream_at(vz, i);
+        s->ptr = ir_build_cast(&b, IR_INT_TO_PTR, IR_TYPE_PTR, s->start);
+        i++;
+    }
+
+    IrValue whole = ir_build_binary(&b, IR_AND, count, ir_build_const(&b, IR_TYPE_I64, -(int64_t) lanes));
+    *iv_end = ir_build_cast(&b, IR_TRUNC, IR_TYPE_I32, ir_build_binary(&b, IR_ADD, init64, whole));
+    ir_build_br(&b, vl);
+
+    // phis first, their operands from the loop once the body exists
+    ir_builder_set_block(&b, vl);
+
+    IrValue ivv = ir_build_phi(&b, IR_TYPE_I32, 2);
+    IrValue *ptr_phis = (IrValue *) malloc((vz->streams.len + 1) * sizeof(IrValue));
+
+    i = 0;
+    while (i < vz->streams.len) {
+        ptr_phis[i] = ir_build_phi(&b, IR_TYPE_PTR, 2);
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->reductions.len) {
+        VecReduction *r = vectorize_reduction_at(vz, i);
+        vz->vmap[r->phi] = ir_build_phi(&b, vty, 2);
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+        IrInst *inst = &f->insts[v];
+        IrOp op = (IrOp) inst->op;
+
+        if (vz->role[v] == VEC_ROLE_ADDR || vz->role[v] == VEC_ROLE_IV) {
+            i++;
+            continue;
+        }
+
+        vectorize_operands(vz, v, ops);
+
+        if (op == IR_LOAD) {
+            vz->vmap[v] = ir_build_load(&b, vty, ptr_phis[vz->stream[ops[0]]]);
+        } else if (op == IR_STORE) {
+            ir_build_store(&b, ptr_phis[vz->stream[ops[0]]], vectorize_operand(vz, ops[1]));
+        } else if (op == IR_COPY) {
+            vz->vmap[v] = vectorize_operand(vz, ops[0]);
+        } else if (op == IR_PHI || op == IR_SELECT) {
+            vz->vmap[v] = ir_build_select(&b, vectorize_operand(vz, ops[0]), vectorize_operand(vz, ops[1]), vectorize_operand(vz, ops[2]));
+        } else if (ir_op_is_compare(op)) {
+            vz->vmap[v] = ir_build_cmp(&b, op, vectorize_operand(vz, ops[0]), vectorize_operand(vz, ops[1]));
+        } else {
+            vz->vmap[v] = ir_build_binary(&b, op, vectorize_operand(vz, ops[0]), vectorize_operand(vz, ops[1]));
+        }
+
+        i++;
+    }
+
+    i = 0;
+    while (i < vz->streams.len) {
+        IrValue step = ir_build_offset(&b, ptr_phis[i], 4 * lanes);
+        IrValue *pops = ir_inst_ops(f, &f->insts[ptr_phis[i]]);
+
+        pops[0] = vectorize_stream_at(vz, i)->ptr;
+        pops[1] = step;
+        i++;
+    }
+
+    IrValue ivn = ir_build_binary(&b, IR_ADD, ivv, ir_build_const(&b, IR_TYPE_I32, lanes));
+    ir_build_cbr(&b, ir_build_cmp(&b, IR_NE, ivn, *iv_end), vl, vd);
+
+    // the loop's preds are init and then itself, as the edges were added
+    ir_inst_ops(f, &f->insts[ivv])[0] = l->init;
+    ir_inst_ops(f, &f->insts[ivv])[1] = ivn;
+
+    i = 0;
+    while (i < vz->reductions.len) {
+        VecReduction *r = vectorize_reduction_at(vz, i);
+        IrValue *aops = ir_inst_ops(f, &f->insts[vz->vmap[r->phi]]);
+
+        aops[0] = acc_init[i];
+        aops[1] = vz->vmap[r->next];
+        i++;
+    }
+
+    ir_builder_set_block(&b, vd);
+
+    i = 0;
+    while (i < vz->reductions.len) {
+        VecReduction *r = vectorize_reduction_at(vz, i);
+        IrValue acc = vz->vmap[r->next];
+        IrValue res = r->kind == VEC_RED_SUM ? ir_inst_ops(f, &f->insts[r->phi])[pi] : ir_build_extract(&b, acc, 0);
+        uint32_t lane = r->kind == VEC_RED_SUM ? 0 : 1;
+
+        while (lane < lanes) {
+            IrValue x = ir_build_extract(&b, acc, lane);
+            res = r->kind == VEC_RED_SUM ? ir_build_binary(&b, IR_ADD, res, x) : vectorize_minmax(vz, &b, r, res, x);
+            lane++;
+        }
+
+        results[i] = res;
+        i++;
+    }
+
+    ir_build_br(&b, exit);
+
+    // the splats belong to this width
+    i = 0;
+    while (i < vz->body.len) {
+        IrValue v = vectorize_body_at(vz, i);
+        uint32_t n = vectorize_operands(vz, v, ops);
+        uint32_t j = 0;
+
+        while (j < n) {
+            vz->splat[ops[j]] = vz->role[ops[j]] == VEC_ROLE_NONE ? IR_NO_VALUE : vz->splat[ops[j]];
+            j++;
+        }
+
+        i++;
+    }
+
+    free((void *) acc_init);
+    free((void *) ptr_phis);
+
+    return vi;
+}
+
+// the vector loops go between the preheader and the header:
+//
+//     check:  count = bound - init, cbr count >= 8 and no store overlaps another pointer's range, select, join
+//     select: cbr avx2, init 8, init 4
+//     join:   phis of the counter and the reductions, where the vector loop stopped or the preheader's values
+//
+// and the scalar loop runs the iterations left over from join on
+void vectorize_emit(Vectorizer *vz, Loop *l) {
+    IrFunc *f = vz->f;
+    IrBuilder b = ir_builder_create(vz->m, f);
+    IrBlockId pre = l->preheader;
+    IrBlockId h = l->header;
+    uint32_t pi = ir_pred_index(f, h, pre);
+    uint32_t num_red = vz->reductions.len;
+    IrBlockId check = ir_block_create(f);
+    IrBlockId select = ir_block_create(f);
+    IrBlockId join = ir_block_create(f);
+
+    f->blocks[check].freq = f->blocks[pre].freq;
+    f->blocks[select].freq = f->blocks[pre].freq;
+    f->blocks[join].freq = f->blocks[pre].freq;
+
+    // the preheader enters the check instead of the header
+    f->blocks[pre].num_succs = 0;
+    ir_add_edge(f, pre, check);
+    ir_inst_ops(f, &f->insts[ir_block_terminator(f, pre)])[0] = check;
+
+    ir_builder_set_block(&b, check);
+
+    IrValue init64 = ir_build_cast(&b, IR_SEXT, IR_TYPE_I64, l->init);
+    IrValue count = ir_build_binary(&b, IR_SUB, ir_build_cast(&b, IR_SEXT, IR_TYPE_I64, l->bound), init64);
+
+    if (l->cmp == IR_LE) {
+        count = ir_build_binary(&b, IR_ADD, count, ir_build_const(&b, IR_TYPE_I64, 1));
+    }
+
+    IrValue four = ir_build_const(&b, IR_TYPE_I64, 4);
+    IrValue bytes = IR_NO_VALUE;
+    IrValue offset = ir_build_binary(&b, IR_MUL, init64, four);
+    IrValue ok = ir_build_cmp(&b, IR_GE, count, ir_build_const(&b, IR_TYPE_I64, VECTORIZE_MIN_COUNT));
+    uint32_t i = 0;
+
+    while (i < vz->streams.len) {
+        VecStream *s = vectorize_stream_at(vz, i);
+        s->start = ir_build_binary(&b, IR_ADD, s->base, offset);
+        i++;
+    }
+
+    // accesses through the same pointer touch the same element in the same iteration, the ranges of different
+    // pointers have to be apart wherever one of them is stored to
+    i = 0;
+    while (i < vz->streams.len) {
+        VecStream *s = vectorize_stream_at(vz, i);
+        uint32_t j = 0;
+
+        while (s->is_stored && j < vz->streams.len) {
+            VecStream *o = vectorize_stream_at(vz, j);
+
+            if (j != i && (j > i || !o->is_stored)) {
+                bytes = bytes == IR_NO_VALUE ? ir_build_binary(&b, IR_MUL, count, four) : bytes;
+
+                IrValue s_end = ir_build_binary(&b, IR_ADD, s->start, bytes);
+                IrValue o_end = ir_build_binary(&b, IR_ADD, o->start, bytes);
+                IrValue before = ir_build_cmp(&b, IR_LE, s_end, o->start);
+                IrValue after = ir_build_cmp(&b, IR_LE, o_end, s->start);
+
+                ok = ir_build_binary(&b, IR_AND, ok, ir_build_binary(&b, IR_OR, before, after));
+            }
+
+            j++;
+        }
+
+        i++;
+    }
+
+    ir_build_cbr(&b, ok, select, join);
+
+    IrValue end4;
+    IrValue end8;
+    IrValue *results4 = (IrValue *) malloc((num_red + 1) * sizeof(IrValue));
+    IrValue *results8 = (IrValue *) malloc((num_red + 1) * sizeof(IrValue));
+
+    IrBlockId vi8 = vectorize_emit_width(vz, l, pre, join, 8, init64, count, &end8, results8);
+    IrBlockId vi4 = vectorize_emit_width(vz, l, pre, join, 4, init64, count, &end4, results4);
+
+    ir_builder_set_block(&b, select);
+    ir_build_cbr(&b, ir_build_cpu_feature(&b, IR_CPU_AVX2), vi8, vi4);
+
+    // join is entered from check, then from the end of the 8 lane loop and then of the 4 lane one
+    ir_builder_set_block(&b, join);
+
+    IrValue iv = ir_build_phi(&b, IR_TYPE_I32, 3);
+    IrValue *ivops = ir_inst_ops(f, &f->insts[iv]);
+
+    ivops[0] = l->init;
+    ivops[1] = end8;
+    ivops[2] = end4;
+
+    IrValue *phi_ops = ir_inst_ops(f, &f->insts[l->iv]);
+    phi_ops[pi] = iv;
+
+    i = 0;
+    while (i < num_red) {
+        VecReduction *r = vectorize_reduction_at(vz, i);
+        IrValue phi = ir_build_phi(&b, IR_TYPE_I32, 3);
+        IrValue *ops = ir_inst_ops(f, &f->insts[phi]);
+        IrValue *rops = ir_inst_ops(f, &f->insts[r->phi]);
+
+        ops[0] = rops[pi];
+        ops[1] = results8[i];
+        ops[2] = results4[i];
+        rops[pi] = phi;
+        i++;
+    }
+
+    // an edge taking the place of the preheader's, so the header's phis keep their order
+    IrValue br = ir_inst_create(f, IR_BR, IR_TYPE_VOID, 1);
+    f->insts[br].u.ops[0] = h;
+    ir_block_append(f, join, br);
+    ir_add_edge(f, join, h);
+    f->blocks[h].num_preds--;
+    f->blocks[h].preds[pi] = join;
+
+    free((void *) results4);
+    free((void *) results8);
+}
+
+bool vectorize_func(Vectorizer *vz, LoopForest *lf, IrFunc *f) {
+    bool changed = false;
+    uint32_t idx = 0;
+
+    vz->f = f;
+    vz->forest = lf;
+
+    while (idx < lf->loops.len) {
+        Loop *l = loop_get(lf, idx);
+
+        if (!l->is_innermost) {
+            idx++;
+            continue;
+        }
+
+        vz->num_loops++;
+
+        if (vectorize_check(vz, idx)) {
+            TRACE_INFO(TRACE_CAT_LOOP, "%s: vectorised loop at b%u, %u streams, %u reductions", f->name, l->header,
+                       (unsigned) vz->streams.len, (unsigned) vz->reductions.len);
+            vectorize_emit(vz, l);
+            vz->num_vectorised++;
+            changed = true;
+        } else {
+            TRACE_INFO(TRACE_CAT_LOOP, "%s: loop at b%u not vectorised: %s", f->name, l->header, vz->reason);
+        }
+
+        idx++;
+    }
+
+    return changed;
+}
@@ -0,0 +1,716 @@
+#include <string.h>
+
+#include "../include/vm.h"
+
+// dlsym hands out object pointers, they are reinterpreted through a pointer to the function type
+#define VM_FN(type, fn) (*(type *) &(fn))
+
+typedef int64_t (*VmVarFn)(int64_t, ...);
+
+#define VM_PARAMS_1 int64_t
+#define VM_PARAMS_2 VM_PARAMS_1, int64_t
+#define VM_PARAMS_3 VM_PARAMS_2, int64_t
+#define VM_PARAMS_4 VM_PARAMS_3, int64_t
+#define VM_PARAMS_5 VM_PARAMS_4, int64_t
+#define VM_PARAMS_6 VM_PARAMS_5, int64_t
+#define VM_PARAMS_7 VM_PARAMS_6, int64_t
+#define VM_PARAMS_8 VM_PARAMS_7, int64_t
+#define VM_PARAMS_9 VM_PARAMS_8, int64_t
+#define VM_PARAMS_10 VM_PARAMS_9, int64_t
+#define VM_PARAMS_11 VM_PARAMS_10, int64_t
+#define VM_PARAMS_12 VM_PARAMS_11, int64_t
+
+#define VM_ARGS_1 a[0]
+#define VM_ARGS_2 VM_ARGS_1, a[1]
+#define VM_ARGS_3 VM_ARGS_2, a[2]
+#define VM_ARGS_4 VM_ARGS_3, a[3]
+#define VM_ARGS_5 VM_ARGS_4, a[4]
+#define VM_ARGS_6 VM_ARGS_5, a[5]
+#define VM_ARGS_7 VM_ARGS_6, a[6]
+#define VM_ARGS_8 VM_ARGS_7, a[7]
+#define VM_ARGS_9 VM_ARGS_8, a[8]
+#define VM_ARGS_10 VM_ARGS_9, a[9]
+#define VM_ARGS_11 VM_ARGS_10, a[10]
+#define VM_ARGS_12 VM_ARGS_11, a[11]
+
+// calling through a variadic type makes the caller set al to the number of vector registers used, which is zero
+#define VM_TRAMPOLINES(n) \
+    int64_t vm_call_##n(void *fn, const int64_t *a) { \
+        typedef int64_t (*VmFn)(VM_PARAMS_##n); \
+        return VM_FN(VmFn, fn)(VM_ARGS_##n); \
+    } \
+    int64_t vm_call_varargs_##n(void *fn, const int64_t *a) { \
+        return VM_FN(VmVarFn, fn)(VM_ARGS_##n); \
+    }
+
+int64_t vm_call_0(void *fn, const int64_t *a) {
+    typedef int64_t (*VmFn)(void);
+
+    (void) a;
+    return VM_FN(VmFn, fn)();
+}
+
+VM_TRAMPOLINES(1)
+VM_TRAMPOLINES(2)
+VM_TRAMPOLINES(3)
+VM_TRAMPOLINES(4)
+VM_TRAMPOLINES(5)
+VM_TRAMPOLINES(6)
+VM_TRAMPOLINES(7)
+VM_TRAMPOLINES(8)
+VM_TRAMPOLINES(9)
+VM_TRAMPOLINES(10)
+VM_TRAMPOLINES(11)
+VM_TRAMPOLINES(12)
+
+static const VmTrampoline vm_trampolines[2][BC_MAX_EXTERN_ARGS + 1] = {
+    { vm_call_0, vm_call_1, vm_call_2, vm_call_3, vm_call_4, vm_call_5, vm_call_6, vm_call_7, vm_call_8, vm_call_9,
+        vm_call_10, vm_call_11, vm_call_12 },
+    { vm_call_0, vm_call_varargs_1, vm_call_varargs_2, vm_call_varargs_3, vm_call_varargs_4, vm_call_varargs_5,
+        vm_call_varargs_6, vm_call_varargs_7, vm_call_varargs_8, vm_call_varargs_9, vm_call_varargs_10,
+        vm_call_varargs_11, vm_call_varargs_12 }
+};
+
+static const void *const *vm_labels = NULL;
+
+VmTrampoline vm_trampoline(uint32_t num_args, bool is_varargs) {
+    if (num_args > BC_MAX_EXTERN_ARGS) {
+        return NULL;
+    }
+
+    return vm_trampolines[is_varargs][num_args];
+}
+
+// c functions only set the low bits of narrow return values
+bool vm_call_extern(BcExtern *e, const int64_t *args, uint32_t num_args, int64_t *result) {
+    VmTrampoline call = vm_trampoline(num_args, e->is_varargs);
+
+    if (e->fn == NULL || call == NULL) {
+        return false;
+    }
+
+    int64_t r = call(e->fn, args);
+
+    switch (e->ret) {
+        case IR_TYPE_I1:
+            *result = r & 1;
+            break;
+        case IR_TYPE_I8:
+            *result = (uint8_t) r;
+            break;
+        case IR_TYPE_I32:
+            *result = (int32_t) r;
+            break;
+        default:
+            *result = r;
+            break;
+    }
+
+    return true;
+}
+
+#define VM_LABEL(name) &&op_##name,
+#define VM_NEXT() goto *ip->handler
+#define VM_STEP() do { ip++; goto *ip->handler; } while (0)
+#define VM_ADDR(reg) ((uint8_t *) (intptr_t) regs[reg] + (int32_t) ip->c)
+
+#define VM_FAIL(...) \
+    do { \
+        snprintf(vm->error, sizeof(vm->error), __VA_ARGS__); \
+        vm->error_func = f->name; \
+        return false; \
+    } while (0)
+
+// T is the unsigned type the operation wraps in, S the signed type the result is kept in
+#define VM_ARITH(name, T, S, rhs, expr) \
+    op_##name: { \
+        T l = (T) regs[ip->b]; \
+        T r = (T) (rhs); \
+        regs[ip->a] = (int64_t) (S) (expr); \
+        VM_STEP(); \
+    }
+
+#define VM_ARITH_32(name, expr) \
+    VM_ARITH(name##_32, uint32_t, int32_t, regs[ip->c], expr) \
+    VM_ARITH(name##_32_I, uint32_t, int32_t, ip->imm, expr)
+
+#define VM_ARITH_64(name, expr) \
+    VM_ARITH(name##_64, uint64_t, int64_t, regs[ip->c], expr) \
+    VM_ARITH(name##_64_I, uint64_t, int64_t, ip->imm, expr)
+
+#define VM_COMPARE(name, T, rhs, cmp) \
+    op_##name: \
+        regs[ip->a] = (T) regs[ip->b] cmp (T) (rhs); \
+        VM_STEP();
+
+#define VM_BRANCH(name, T, rhs, cmp) \
+    op_##name: \
+        ip = f->code + ((T) regs[ip->a] cmp (T) (rhs) ? ip->b : ip->c); \
+        VM_NEXT();
+
+// pops a frame and writes value into the call's a, or finishes when the call the vm was entered with returns
+#define VM_RETURN(has_value) \
+    do { \
+        bool write = (has_value); \
+        if (depth == 0) { \
+            *result = value; \
+            return true; \
+        } \
+        VmFrame *frame = &frames[--depth]; \
+        f = frame->f; \
+        regs = frame->regs; \
+        mem = frame->mem; \
+        ip = frame->ret; \
+        if (write) { \
+            regs[ip->a] = value; \
+        } \
+        VM_STEP(); \
+    } while (0)
+
+// runs compiled code from at, the function's first instruction or a loop header. depth is the number of
+// frames the interpreter has in use, compiled code that calls back into it starts after them
+bool vm_native_enter(Vm *vm, BcFunc *f, const uint8_t *at, int64_t *regs, uint8_t *mem, uint32_t depth, int64_t *result) {
+    const uint8_t *native = f->native;
+
+    vm->depth += depth;
+    vm->native_depth++;
+    int64_t r = VM_FN(JitEntry, native)(vm, regs, mem, at);
+    vm->native_depth--;
+    vm->depth -= depth;
+
+    if (vm->error_func != NULL) {
+        return false;
+    }
+
+    *result = r;
+    return true;
+}
+
+// whether a call to the function with the given index runs compiled code, it is compiled when it just got hot
+bool vm_use_native(Vm *vm, uint32_t idx) {
+    BcFunc *f = &vm->m->funcs[idx];
+
+    if (vm->native_depth >= VM_MAX_NATIVE_DEPTH) {
+        return false;
+    }
+
+    if (f->native != NULL) {
+        return true;
+    }
+
+    return vm->jit != NULL && ++f->calls == JIT_HOT_CALLS && jit_compile(vm->jit, idx);
+}
+
+// labels as values are a gnu extension
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// every op ends by jumping straight to the handler of the next one, so each has its own indirect branch to
+// predict. called with a NULL vm it only publishes its label table
+bool vm_exec(Vm *vm, BcFunc *f, int64_t *regs, uint8_t *mem, int64_t *result) {
+    static const void *const labels[] = {
+        BC_OPS(VM_LABEL)
+    };
+
+    if (vm == NULL) {
+        vm_labels = labels;
+        return true;
+    }
+
+    BcModule *m = vm->m;
+    VmFrame *frames = vm->frames + vm->depth;
+    uint32_t max_depth = vm->max_frames - vm->depth;
+    uint32_t depth = 0;
+    int64_t value = 0;
+    const BcInst *ip = f->code;
+
+    VM_NEXT();
+
+    op_NOP:
+        VM_STEP();
+
+    op_CONST:
+        regs[ip->a] = ip->imm;
+        VM_STEP();
+
+    op_MOV:
+        regs[ip->a] = regs[ip->b];
+        VM_STEP();
+
+    op_ALLOCA:
+        regs[ip->a] = (int64_t) (intptr_t) (mem + ip->imm);
+        VM_STEP();
+
+    VM_ARITH_32(ADD, l + r)
+    VM_ARITH_32(SUB, l - r)
+    VM_ARITH_32(MUL, l * r)
+    VM_ARITH_32(AND, l & r)
+    VM_ARITH_32(OR, l | r)
+    VM_ARITH_32(XOR, l ^ r)
+    VM_ARITH_32(SHL, l << (r & 31))
+    VM_ARITH_32(SHR, (int32_t) l >> (r & 31))
+
+    VM_ARITH_64(ADD, l + r)
+    VM_ARITH_64(SUB, l - r)
+    VM_ARITH_64(MUL, l * r)
+    VM_ARITH_64(AND, l & r)
+    VM_ARITH_64(OR, l | r)
+    VM_ARITH_64(XOR, l ^ r)
+    VM_ARITH_64(SHL, l << (r & 63))
+    VM_ARITH_64(SHR, (int64_t) l >> (r & 63))
+
+    // narrow operands are sign extended, so dividing them as 64 bit values can not overflow
+    op_DIV_32:
+        if (regs[ip->c] == 0) {
+            VM_FAIL("division by zero");
+        }
+
+        regs[ip->a] = (int32_t) (regs[ip->b] / regs[ip->c]);
+        VM_STEP();
+
+    op_MOD_32:
+        if (regs[ip->c] == 0) {
+            VM_FAIL("division by zero");
+        }
+
+        regs[ip->a] = (int32_t) (regs[ip->b] % regs[ip->c]);
+        VM_STEP();
+
+    op_DIV_64:
+        if (regs[ip->c] == 0) {
+            VM_FAIL("division by zero");
+        }
+
+        regs[ip->a] = regs[ip->c] == -1 ? (int64_t) (0 - (uint64_t) regs[ip->b]) : regs[ip->b] / regs[ip->c];
+        VM_STEP();
+
+    op_MOD_64:
+        if (regs[ip->c] == 0) {
+            VM_FAIL("division by zero");
+        }
+
+        regs[ip->a] = regs[ip->c] == -1 ? 0 : regs[ip->b] % regs[ip->c];
+        VM_STEP();
+
+    op_NEG_32:
+        regs[ip->a] = (int32_t) (0 - (uint32_t) regs[ip->b]);
+        VM_STEP();
+
+    op_NEG_64:
+        regs[ip->a] = (int64_t) (0 - (uint64_t) regs[ip->b]);
+        VM_STEP();
+
+    op_NOT_32:
+        regs[ip->a] = (int32_t) ~(uint32_t) regs[ip->b];
+        VM_STEP();
+
+    op_NOT_64:
+        regs[ip->a] = ~regs[ip->b];
+        VM_STEP();
+
+    VM_COMPARE(EQ, int64_t, regs[ip->c], ==)
+    VM_COMPARE(NE, int64_t, regs[ip->c], !=)
+    VM_COMPARE(LT, int64_t, regs[ip->c], <)
+    VM_COMPARE(LE, int64_t, regs[ip->c], <=)
+    VM_COMPARE(GT, int64_t, regs[ip->c], >)
+    VM_COMPARE(GE, int64_t, regs[ip->c], >=)
+    VM_COMPARE(LT_U, uint64_t, regs[ip->c], <)
+    VM_COMPARE(LE_U, uint64_t, regs[ip->c], <=)
+    VM_COMPARE(GT_U, uint64_t, regs[ip->c], >)
+    VM_COMPARE(GE_U, uint64_t, regs[ip->c], >=)
+    VM_COMPARE(EQ_I, int64_t, ip->imm, ==)
+    VM_COMPARE(NE_I, int64_t, ip->imm, !=)
+    VM_COMPARE(LT_I, int64_t, ip->imm, <)
+    VM_COMPARE(LE_I, int64_t, ip->imm, <=)
+    VM_COMPARE(GT_I, int64_t, ip->imm, >)
+    VM_COMPARE(GE_I, int64_t, ip->imm, >=)
+
+    op_SEXT_32:
+        regs[ip->a] = (int32_t) regs[ip->b];
+        VM_STEP();
+
+    op_ZEXT_32:
+        regs[ip->a] = (uint32_t) regs[ip->b];
+        VM_STEP();
+
+    op_TRUNC_8:
+        regs[ip->a] = regs[ip->b] & 0xff;
+        VM_STEP();
+
+    op_TRUNC_1:
+        regs[ip->a] = regs[ip->b] & 1;
+        VM_STEP();
+
+    op_SELECT:
+        regs[ip->a] = regs[ip->b] != 0 ? regs[ip->c] : regs[ip->imm];
+        VM_STEP();
+
+    op_LOAD_8:
+        regs[ip->a] = *VM_ADDR(ip->b);
+        VM_STEP();
+
+    op_LOAD_32:
+        regs[ip->a] = *(int32_t *) VM_ADDR(ip->b);
+        VM_STEP();
+
+    op_LOAD_64:
+        regs[ip->a] = *(int64_t *) VM_ADDR(ip->b);
+        VM_STEP();
+
+    op_STORE_8:
+        *VM_ADDR(ip->a) = (uint8_t) regs[ip->b];
+        VM_STEP();
+
+    op_STORE_32:
+        *(int32_t *) VM_ADDR(ip->a) = (int32_t) regs[ip->b];
+        VM_STEP();
+
+    op_STORE_64:
+        *(int64_t *) VM_ADDR(ip->a) = regs[ip->b];
+        VM_STEP();
+
+    op_STORE_8_I:
+        *VM_ADDR(ip->a) = (uint8_t) ip->imm;
+        VM_STEP();
+
+    op_STORE_32_I:
+        *(int32_t *) VM_ADDR(ip->a) = (int32_t) ip->imm;
+        VM_STEP();
+
+    op_STORE_64_I:
+        *(int64_t *) VM_ADDR(ip->a) = ip->imm;
+        VM_STEP();
+
+    op_MEMCPY:
+        memcpy((void *) (intptr_t) regs[ip->a], (void *) (intptr_t) regs[ip->b], (size_t) ip->imm);
+        VM_STEP();
+
+    op_NEW:
+        regs[ip->a] = (int64_t) (intptr_t) malloc((size_t) ip->imm);
+        VM_STEP();
+
+    op_DELETE:
+        free((void *) (intptr_t) regs[ip->b]);
+        VM_STEP();
+
+    // the callee's registers start right after the caller's, the return writes into the call's a. callees
+    // that have been compiled run natively in the same window
+    op_CALL: {
+        BcFunc *callee = &m->funcs[ip->c];
+        int64_t *next = regs + f->num_regs;
+        uint8_t *next_mem = mem + f->frame_size;
+        const uint32_t *args = f->args + ip->b;
+        uint32_t n = (uint32_t) ip->imm;
+        uint32_t i = 0;
+
+        if (depth == max_depth || next + callee->num_regs > vm->regs_end || next_mem + callee->frame_size > vm->stack_end) {
+            VM_FAIL("stack overflow calling '%s'", callee->name);
+        }
+
+        while (i < n) {
+            next[i] = regs[args[i]];
+            i++;
+        }
+
+        memcpy((void *) (next + callee->num_params), (void *) callee->consts, callee->num_consts * sizeof(int64_t));
+
+        if (vm_use_native(vm, ip->c)) {
+            if (!vm_native_enter(vm, callee, callee->native + callee->native_offsets[0], next, next_mem, depth, &value)) {
+                return false;
+            }
+
+            if (callee->ret != IR_TYPE_VOID) {
+                regs[ip->a] = value;
+            }
+
+            VM_STEP();
+        }
+
+        VmFrame *frame = &frames[depth++];
+        frame->f = f;
+        frame->ret = ip;
+        frame->regs = regs;
+        frame->mem = mem;
+
+        f = callee;
+        regs = next;
+        mem = next_mem;
+        ip = callee->code;
+        VM_NEXT();
+    }
+
+    // a tail call hands the callee the caller's windows, so the callee returns straight to the caller's caller
+    op_TAIL_CALL: {
+        BcFunc *callee = &m->funcs[ip->c];
+        int64_t *next = regs + f->num_regs;
+        const uint32_t *args = f->args + ip->b;
+        uint32_t n = (uint32_t) ip->imm;
+        uint32_t i = 0;
+
+        if (next + n > vm->regs_end || regs + callee->num_regs > vm->regs_end || mem + callee->frame_size > vm->stack_end) {
+            VM_FAIL("stack overflow calling '%s'", callee->name);
+        }
+
+        // the arguments may be read from the registers they go to
+        while (i < n) {
+            next[i] = regs[args[i]];
+            i++;
+        }
+
+        memmove((void *) regs, (void *) next, n * sizeof(int64_t));
+        memcpy((void *) (regs + callee->num_params), (void *) callee->consts, callee->num_consts * sizeof(int64_t));
+
+        if (vm_use_native(vm, ip->c)) {
+            if (!vm_native_enter(vm, callee, callee->native + callee->native_offsets[0], regs, mem, depth, &value)) {
+                return false;
+            }
+
+            VM_RETURN(callee->ret != IR_TYPE_VOID);
+        }
+
+        f = callee;
+        ip = callee->code;
+        VM_NEXT();
+    }
+
+    op_CALL_EXTERN: {
+        BcExtern *e = &m->externs[ip->c];
+        const uint32_t *args = f->args + ip->b;
+        uint32_t n = (uint32_t) ip->imm;
+        int64_t values[BC_MAX_EXTERN_ARGS];
+        int64_t r = 0;
+        uint32_t i = 0;
+
+        if (n > BC_MAX_EXTERN_ARGS) {
+            VM_FAIL("'%s' is called with %u arguments, extern calls support at most %d", e->name, n, BC_MAX_EXTERN_ARGS);
+        }
+
+        while (i < n) {
+            values[i] = regs[args[i]];
+            i++;
+        }
+
+        if (!vm_call_extern(e, values, n, &r)) {
+            VM_FAIL("extern function '%s' was not found", e->name);
+        }
+
+        if (e->ret != IR_TYPE_VOID) {
+            regs[ip->a] = r;
+        }
+
+        VM_STEP();
+    }
+
+    op_JMP:
+        ip = f->code + ip->b;
+        VM_NEXT();
+
+    // a loop that gets hot compiles its function, which then finishes the call from the loop header
+    op_LOOP:
+        if (f->native == NULL && vm->jit != NULL && ++f->loops == JIT_HOT_LOOPS) {
+            jit_compile(vm->jit, (uint32_t) (f - m->funcs));
+        }
+
+        if (f->native != NULL && vm->native_depth < VM_MAX_NATIVE_DEPTH) {
+            if (!vm_native_enter(vm, f, f->native + f->native_offsets[ip->b], regs, mem, depth, &value)) {
+                return false;
+            }
+
+            VM_RETURN(f->ret != IR_TYPE_VOID);
+        }
+
+        ip = f->code + ip->b;
+        VM_NEXT();
+
+    op_BR:
+        ip = f->code + (regs[ip->a] != 0 ? ip->b : ip->c);
+        VM_NEXT();
+
+    VM_BRANCH(BR_EQ, int64_t, regs[ip->imm], ==)
+    VM_BRANCH(BR_NE, int64_t, regs[ip->imm], !=)
+    VM_BRANCH(BR_LT, int64_t, regs[ip->imm], <)
+    VM_BRANCH(BR_LE, int64_t, regs[ip->imm], <=)
+    VM_BRANCH(BR_GT, int64_t, regs[ip->imm], >)
+    VM_BRANCH(BR_GE, int64_t, regs[ip->imm], >=)
+    VM_BRANCH(BR_LT_U, uint64_t, regs[ip->imm], <)
+    VM_BRANCH(BR_LE_U, uint64_t, regs[ip->imm], <=)
+    VM_BRANCH(BR_GT_U, uint64_t, regs[ip->imm], >)
+    VM_BRANCH(BR_GE_U, uint64_t, regs[ip->imm], >=)
+    VM_BRANCH(BR_EQ_I, int64_t, ip->imm, ==)
+    VM_BRANCH(BR_NE_I, int64_t, ip->imm, !=)
+    VM_BRANCH(BR_LT_I, int64_t, ip->imm, <)
+    VM_BRANCH(BR_LE_I, int64_t, ip->imm, <=)
+    VM_BRANCH(BR_GT_I, int64_t, ip->imm, >)
+    VM_BRANCH(BR_GE_I, int64_t, ip->imm, >=)
+
+    op_RET:
+        value = regs[ip->b];
+        VM_RETURN(true);
+
+    op_RET_VOID:
+        value = 0;
+        VM_RETURN(false);
+
+    op_UNREACHABLE:
+        VM_FAIL("reached unreachable code");
+}
+
+#pragma GCC diagnostic pop
+
+// direct threading: every instruction gets the address of its op's handler
+void vm_thread(BcModule *m) {
+    uint32_t i = 0;
+
+    if (vm_labels == NULL) {
+        vm_exec(NULL, NULL, NULL, NULL, NULL);
+    }
+
+    while (i < m->num_funcs) {
+        BcFunc *f = &m->funcs[i];
+        uint32_t j = 0;
+
+        while (j < f->num_code) {
+            f->code[j].handler = vm_labels[f->code[j].op];
+            j++;
+        }
+
+        i++;
+    }
+}
+
+Vm vm_create(BcModule *m, bool jit) {
+    Vm vm;
+    memset((void *) &vm, 0, sizeof(Vm));
+
+    vm.m = m;
+    vm.regs = (int64_t *) malloc(VM_NUM_REGS * sizeof(int64_t));
+    vm.regs_end = vm.regs + VM_NUM_REGS;
+    vm.stack = (uint8_t *) malloc(VM_STACK_SIZE);
+    vm.stack_end = vm.stack + VM_STACK_SIZE;
+    vm.frames = (VmFrame *) malloc(VM_MAX_FRAMES * sizeof(VmFrame));
+    vm.max_frames = VM_MAX_FRAMES;
+
+    if (jit) {
+        vm.jit = (Jit *) malloc(sizeof(Jit));
+        *vm.jit = jit_create(m);
+    }
+
+    vm_thread(m);
+
+    return vm;
+}
+
+void vm_free(Vm *vm) {
+    free((void *) vm->regs);
+    free((void *) vm->stack);
+    free((void *) vm->frames);
+
+    if (vm->jit != NULL) {
+        jit_free(vm->jit);
+        free((void *) vm->jit);
+    }
+}
+
+bool vm_call(Vm *vm, BcFunc *f, const int64_t *args, uint32_t num_args, int64_t *result) {
+    uint32_t i = 0;
+
+    vm->error[0] = '\0';
+    vm->error_func = NULL;
+    vm->depth = 0;
+    vm->native_depth = 0;
+
+    if (f->num_regs > VM_NUM_REGS) {
+        snprintf(vm->error, sizeof(vm->error), "stack overflow calling '%s'", f->name);
+        vm->error_func = f->name;
+        return false;
+    }
+
+    while (i < num_args && i < f->num_params) {
+        vm->regs[i] = args[i];
+        i++;
+    }
+
+    memcpy((void *) (vm->regs + f->num_params), (void *) f->consts, f->num_consts * sizeof(int64_t));
+
+    if (f->native != NULL) {
+        return vm_native_enter(vm, f, f->native + f->native_offsets[0], vm->regs, vm->stack, 0, result);
+    }
+
+    return vm_exec(vm, f, vm->regs, vm->stack, result);
+}
+
+bool vm_jit_call(Vm *vm, uint32_t caller, const BcInst *ip, int64_t *regs, uint8_t *mem) {
+    BcModule *m = vm->m;
+    BcFunc *f = &m->funcs[caller];
+    BcFunc *callee = &m->funcs[ip->c];
+    int64_t *next = regs + f->num_regs;
+    uint8_t *next_mem = mem + f->frame_size;
+    const uint32_t *args = f->args + ip->b;
+    uint32_t n = (uint32_t) ip->imm;
+    int64_t value = 0;
+    uint32_t i = 0;
+    bool ok;
+
+    if (next + callee->num_regs > vm->regs_end || next_mem + callee->frame_size > vm->stack_end) {
+        snprintf(vm->error, sizeof(vm->error), "stack overflow calling '%s'", callee->name);
+        vm->error_func = f->name;
+        return false;
+    }
+
+    while (i < n) {
+        next[i] = regs[args[i]];
+        i++;
+    }
+
+    memcpy((void *) (next + callee->num_params), (void *) callee->consts, callee->num_consts * sizeof(int64_t));
+
+    if (vm_use_native(vm, ip->c)) {
+        ok = vm_native_enter(vm, callee, callee->native + callee->native_offsets[0], next, next_mem, 0, &value);
+    } else {
+        ok = vm_exec(vm, callee, next, next_mem, &value);
+    }
+
+    if (ok && callee->ret != IR_TYPE_VOID) {
+        regs[ip->a] = value;
+    }
+
+    return ok;
+}
+
+bool vm_jit_call_extern(Vm *vm, uint32_t caller, const BcInst *ip, int64_t *regs) {
+    BcFunc *f = &vm->m->funcs[caller];
+    BcExtern *e = &vm->m->externs[ip->c];
+    const uint32_t *args = f->args + ip->b;
+    uint32_t n = (uint32_t) ip->imm;
+    int64_t values[BC_MAX_EXTERN_ARGS];
+    int64_t r = 0;
+    uint32_t i = 0;
+
+    if (n > BC_MAX_EXTERN_ARGS) {
+        snprintf(vm->error, sizeof(vm->error), "'%s' is called with %u arguments, extern calls support at most %d", e->name, n, BC_MAX_EXTERN_ARGS);
+        vm->error_func = f->name;
+        return false;
+    }
+
+    while (i < n) {
+        values[i] = regs[args[i]];
+        i++;
+    }
+
+    if (!vm_call_extern(e, values, n, &r)) {
+        snprintf(vm->error, sizeof(vm->error), "extern function '%s' was not found", e->name);
+        vm->error_func = f->name;
+        return false;
+    }
+
+    if (e->ret != IR_TYPE_VOID) {
+        regs[ip->a] = r;
+    }
+
+    return true;
+}
+
+void vm_jit_fail(Vm *vm, uint32_t caller, const char *error) {
+    snprintf(vm->error, sizeof(vm->error), "%s", error);
+    vm->error_func = vm->m->funcs[caller].name;
+}
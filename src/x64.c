@@ -0,0 +1,533 @@
+#include "../include/x64.h"
+
+static char const *const x64_reg_names[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+
+_Static_assert(sizeof(x64_reg_names) / sizeof(char *) == X64_NUM_REGS, "every X64Reg needs a name");
+
+X64Cond x64_cond_negate(X64Cond cc) {
+    return (X64Cond) (cc ^ 1);
+}
+
+const char *x64_reg2str(X64Reg reg) {
+    return x64_reg_names[reg];
+}
+
+// every encoder reserves room for the longest instruction once and then writes through a cursor,
+// so emitting an instruction costs one capacity check instead of one per byte
+uint8_t *x64_begin(Buf *b) {
+    buf_reserve(b, X64_MAX_INST_LEN);
+    return b->data + b->len;
+}
+
+void x64_end(Buf *b, uint8_t *p) {
+    b->len = (uint32_t) (p - b->data);
+}
+
+uint8_t *x64_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+
+    return p + 4;
+}
+
+// byte operands on spl, bpl, sil and dil need an empty REX prefix, otherwise they mean ah, ch, dh and bh
+uint8_t *x64_rex(uint8_t *p, int32_t size, uint8_t reg, uint8_t base, bool byte_regs) {
+    uint8_t rex = 0x40 | (size == 8 ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((base >> 3) & 1);
+
+    if (rex != 0x40 || (byte_regs && ((reg & 0xc) == 4 || (base & 0xc) == 4))) {
+        *p++ = rex;
+    }
+
+    return p;
+}
+
+uint8_t *x64_prefix(uint8_t *p, int32_t size, uint8_t reg, uint8_t base) {
+    if (size == 2) {
+        *p++ = 0x66;
+    }
+
+    return x64_rex(p, size, reg, base, false);
+}
+
+uint8_t *x64_modrm_rr(uint8_t *p, uint8_t reg, uint8_t rm) {
+    *p++ = 0xc0 | (reg & 7) << 3 | (rm & 7);
+    return p;
+}
+
+// [base + disp], rsp and r12 need a SIB byte and rbp and r13 can not use the short form without displacement
+uint8_t *x64_modrm_mem(uint8_t *p, uint8_t reg, uint8_t base, int32_t disp) {
+    uint8_t mod = disp == 0 && (base & 7) != 5 ? 0 : (disp >= -128 && disp <= 127 ? 1 : 2);
+
+    *p++ = mod << 6 | (reg & 7) << 3 | (base & 7);
+
+    if ((base & 7) == 4) {
+        *p++ = 0x24;
+    }
+
+    if (mod == 1) {
+        *p++ = (uint8_t) disp;
+    } else if (mod == 2) {
+        p = x64_put_u32(p, (uint32_t) disp);
+    }
+
+    return p;
+}
+
+bool x64_fits_i8(int64_t v) {
+    return v >= -128 && v <= 127;
+}
+
+void x64_mov_rr(Buf *b, int32_t size, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, src, dst);
+    *p++ = 0x89;
+    x64_end(b, x64_modrm_rr(p, src, dst));
+}
+
+void x64_mov_ri(Buf *b, int32_t size, X64Reg dst, int64_t imm) {
+    uint8_t *p = x64_begin(b);
+
+    if (size != 8 || (imm >= 0 && imm <= UINT32_MAX)) {
+        p = x64_rex(p, 4, 0, dst, false);
+        *p++ = 0xb8 + (dst & 7);
+        p = x64_put_u32(p, (uint32_t) imm);
+    } else if (imm >= INT32_MIN && imm <= INT32_MAX) {
+        p = x64_rex(p, 8, 0, dst, false);
+        *p++ = 0xc7;
+        p = x64_modrm_rr(p, 0, dst);
+        p = x64_put_u32(p, (uint32_t) imm);
+    } else {
+        p = x64_rex(p, 8, 0, dst, false);
+        *p++ = 0xb8 + (dst & 7);
+        p = x64_put_u32(p, (uint32_t) imm);
+        p = x64_put_u32(p, (uint32_t) ((uint64_t) imm >> 32));
+    }
+
+    x64_end(b, p);
+}
+
+// loads narrower than 32 bits are zero extended
+void x64_load(Buf *b, int32_t size, X64Reg dst, X64Reg base, int32_t disp) {
+    uint8_t *p = x64_begin(b);
+
+    if (size < 4) {
+        p = x64_rex(p, 4, dst, base, false);
+        *p++ = 0x0f;
+        *p++ = size == 1 ? 0xb6 : 0xb7;
+    } else {
+        p = x64_rex(p, size, dst, base, false);
+        *p++ = 0x8b;
+    }
+
+    x64_end(b, x64_modrm_mem(p, dst, base, disp));
+}
+
+void x64_store(Buf *b, int32_t size, X64Reg base, int32_t disp, X64Reg src) {
+    uint8_t *p = x64_begin(b);
+
+    if (size == 2) {
+        *p++ = 0x66;
+    }
+
+    p = x64_rex(p, size, src, base, size == 1);
+    *p++ = size == 1 ? 0x88 : 0x89;
+    x64_end(b, x64_modrm_mem(p, src, base, disp));
+}
+
+void x64_store_imm(Buf *b, int32_t size, X64Reg base, int32_t disp, int32_t imm) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, 0, base);
+    *p++ = size == 1 ? 0xc6 : 0xc7;
+    p = x64_modrm_mem(p, 0, base, disp);
+
+    if (size == 1) {
+        *p++ = (uint8_t) imm;
+    } else if (size == 2) {
+        *p++ = imm & 0xff;
+        *p++ = (imm >> 8) & 0xff;
+    } else {
+        p = x64_put_u32(p, (uint32_t) imm);
+    }
+
+    x64_end(b, p);
+}
+
+void x64_lea(Buf *b, X64Reg dst, X64Reg base, int32_t disp) {
+    uint8_t *p = x64_rex(x64_begin(b), 8, dst, base, false);
+    *p++ = 0x8d;
+    x64_end(b, x64_modrm_mem(p, dst, base, disp));
+}
+
+uint32_t x64_rip_op(Buf *b, uint8_t opcode, X64Reg dst) {
+    uint8_t *p = x64_rex(x64_begin(b), 8, dst, 0, false);
+    *p++ = opcode;
+    *p++ = (dst & 7) << 3 | 5;
+    x64_end(b, x64_put_u32(p, 0));
+
+    return b->len - 4;
+}
+
+// returns the offset of the displacement, which the caller relocates
+uint32_t x64_lea_rip(Buf *b, X64Reg dst) {
+    return x64_rip_op(b, 0x8d, dst);
+}
+
+uint32_t x64_load_rip(Buf *b, X64Reg dst) {
+    return x64_rip_op(b, 0x8b, dst);
+}
+
+void x64_alu_rr(Buf *b, X64AluOp op, int32_t size, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, src, dst);
+    *p++ = op * 8 + 1;
+    x64_end(b, x64_modrm_rr(p, src, dst));
+}
+
+void x64_alu_ri(Buf *b, X64AluOp op, int32_t size, X64Reg dst, int32_t imm) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, 0, dst);
+
+    if (x64_fits_i8(imm)) {
+        *p++ = 0x83;
+        p = x64_modrm_rr(p, op, dst);
+        *p++ = (uint8_t) imm;
+    } else {
+        *p++ = 0x81;
+        p = x64_modrm_rr(p, op, dst);
+        p = x64_put_u32(p, (uint32_t) imm);
+    }
+
+    x64_end(b, p);
+}
+
+void x64_alu_rm(Buf *b, X64AluOp op, int32_t size, X64Reg dst, X64Reg base, int32_t disp) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, dst, base);
+    *p++ = op * 8 + 3;
+    x64_end(b, x64_modrm_mem(p, dst, base, disp));
+}
+
+void x64_imul_rr(Buf *b, int32_t size, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, dst, src);
+    *p++ = 0x0f;
+    *p++ = 0xaf;
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_imul_rri(Buf *b, int32_t size, X64Reg dst, X64Reg src, int32_t imm) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, dst, src);
+
+    if (x64_fits_i8(imm)) {
+        *p++ = 0x6b;
+        p = x64_modrm_rr(p, dst, src);
+        *p++ = (uint8_t) imm;
+    } else {
+        *p++ = 0x69;
+        p = x64_modrm_rr(p, dst, src);
+        p = x64_put_u32(p, (uint32_t) imm);
+    }
+
+    x64_end(b, p);
+}
+
+// cdq or cqo, sign extends eax or rax into edx or rdx before a division
+void x64_sign_extend_ax(Buf *b, int32_t size) {
+    uint8_t *p = x64_begin(b);
+
+    if (size == 8) {
+        *p++ = 0x48;
+    }
+
+    *p++ = 0x99;
+    x64_end(b, p);
+}
+
+// the 0xf7, 0xd3 and 0xc1 groups take a /digit in the reg field
+uint8_t *x64_group_rr(Buf *b, uint8_t opcode, int32_t ext, int32_t size, X64Reg reg) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, 0, reg);
+    *p++ = opcode;
+    return x64_modrm_rr(p, ext, reg);
+}
+
+void x64_unary(Buf *b, int32_t ext, int32_t size, X64Reg reg) {
+    x64_end(b, x64_group_rr(b, 0xf7, ext, size, reg));
+}
+
+void x64_shift_cl(Buf *b, int32_t ext, int32_t size, X64Reg reg) {
+    x64_end(b, x64_group_rr(b, 0xd3, ext, size, reg));
+}
+
+void x64_shift_ri(Buf *b, int32_t ext, int32_t size, X64Reg reg, uint8_t imm) {
+    uint8_t *p = x64_group_rr(b, 0xc1, ext, size, reg);
+    *p++ = imm;
+    x64_end(b, p);
+}
+
+void x64_setcc(Buf *b, X64Cond cc, X64Reg reg) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, 0, reg, true);
+    *p++ = 0x0f;
+    *p++ = 0x90 + cc;
+    x64_end(b, x64_modrm_rr(p, 0, reg));
+}
+
+void x64_movzx8(Buf *b, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, dst, src, true);
+    *p++ = 0x0f;
+    *p++ = 0xb6;
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_movsxd(Buf *b, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_rex(x64_begin(b), 8, dst, src, false);
+    *p++ = 0x63;
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_cmov(Buf *b, X64Cond cc, int32_t size, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, dst, src);
+    *p++ = 0x0f;
+    *p++ = 0x40 + cc;
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_test_rr(Buf *b, int32_t size, X64Reg a, X64Reg c) {
+    uint8_t *p = x64_prefix(x64_begin(b), size, c, a);
+    *p++ = 0x85;
+    x64_end(b, x64_modrm_rr(p, c, a));
+}
+
+void x64_push(Buf *b, X64Reg reg) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, 0, reg, false);
+    *p++ = 0x50 + (reg & 7);
+    x64_end(b, p);
+}
+
+void x64_pop(Buf *b, X64Reg reg) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, 0, reg, false);
+    *p++ = 0x58 + (reg & 7);
+    x64_end(b, p);
+}
+
+void x64_push_imm(Buf *b, int32_t imm) {
+    uint8_t *p = x64_begin(b);
+
+    if (x64_fits_i8(imm)) {
+        *p++ = 0x6a;
+        *p++ = (uint8_t) imm;
+    } else {
+        *p++ = 0x68;
+        p = x64_put_u32(p, (uint32_t) imm);
+    }
+
+    x64_end(b, p);
+}
+
+void x64_push_mem(Buf *b, X64Reg base, int32_t disp) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, 0, base, false);
+    *p++ = 0xff;
+    x64_end(b, x64_modrm_mem(p, 6, base, disp));
+}
+
+// jumps and calls return the offset of their rel32, which is patched or relocated later
+uint32_t x64_jmp(Buf *b) {
+    uint8_t *p = x64_begin(b);
+    *p++ = 0xe9;
+    x64_end(b, x64_put_u32(p, 0));
+
+    return b->len - 4;
+}
+
+uint32_t x64_jcc(Buf *b, X64Cond cc) {
+    uint8_t *p = x64_begin(b);
+    *p++ = 0x0f;
+    *p++ = 0x80 + cc;
+    x64_end(b, x64_put_u32(p, 0));
+
+    return b->len - 4;
+}
+
+uint32_t x64_call(Buf *b) {
+    uint8_t *p = x64_begin(b);
+    *p++ = 0xe8;
+    x64_end(b, x64_put_u32(p, 0));
+
+    return b->len - 4;
+}
+
+// indirect forms, for calls into the runtime and jumps to addresses known only when the code runs
+void x64_call_r(Buf *b, X64Reg reg) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, 0, reg, false);
+    *p++ = 0xff;
+    x64_end(b, x64_modrm_rr(p, 2, reg));
+}
+
+void x64_jmp_r(Buf *b, X64Reg reg) {
+    uint8_t *p = x64_rex(x64_begin(b), 4, 0, reg, false);
+    *p++ = 0xff;
+    x64_end(b, x64_modrm_rr(p, 4, reg));
+}
+
+void x64_ret(Buf *b) {
+    buf_push_u8(b, 0xc3);
+}
+
+void x64_ud2(Buf *b) {
+    buf_push_u16(b, 0x0b0f);
+}
+
+void x64_patch_rel32(Buf *b, uint32_t at, uint32_t target) {
+    buf_write_u32(b, at, target - (at + 4));
+}
+
+// 66 [rex] 0f [38] op, the legacy SSE encoding
+uint8_t *x64_sse_prefix(uint8_t *p, uint8_t prefix, uint32_t op, uint8_t reg, uint8_t rm) {
+    *p++ = prefix;
+    p = x64_rex(p, 4, reg, rm, false);
+    *p++ = 0x0f;
+
+    if (op >> 8 == 2) {
+        *p++ = 0x38;
+    }
+
+    *p++ = op & 0xff;
+    return p;
+}
+
+// the three byte VEX prefix, which carries the map, the mandatory prefix, the vector length and a second source
+uint8_t *x64_vex(uint8_t *p, uint8_t map, uint8_t pp, bool wide, uint8_t reg, uint8_t src, uint8_t rm) {
+    *p++ = 0xc4;
+    *p++ = (~reg & 8) << 4 | 0x40 | (~rm & 8) << 2 | map;
+    *p++ = (~src & 15) << 3 | (wide ? 4 : 0) | pp;
+
+    return p;
+}
+
+void x64_vec_rr(Buf *b, X64VecOp op, int32_t width, X64Reg dst, X64Reg a, X64Reg c) {
+    uint8_t *p = x64_begin(b);
+
+    if (width == 32) {
+        p = x64_vex(p, op >> 8 == 2 ? 2 : 1, 1, true, dst, a, c);
+        *p++ = op & 0xff;
+    } else {
+        p = x64_sse_prefix(p, 0x66, op, dst, c);
+    }
+
+    x64_end(b, x64_modrm_rr(p, dst, c));
+}
+
+// movdqa between registers, movdqu to and from memory, which needs no alignment
+void x64_vec_mov(Buf *b, int32_t width, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_begin(b);
+
+    if (width == 32) {
+        p = x64_vex(p, 1, 1, true, dst, 0, src);
+        *p++ = 0x6f;
+    } else {
+        p = x64_sse_prefix(p, 0x66, 0x6f, dst, src);
+    }
+
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_vec_load(Buf *b, int32_t width, X64Reg dst, X64Reg base, int32_t disp) {
+    uint8_t *p = x64_begin(b);
+
+    if (width == 32) {
+        p = x64_vex(p, 1, 2, true, dst, 0, base);
+        *p++ = 0x6f;
+    } else {
+        p = x64_sse_prefix(p, 0xf3, 0x6f, dst, base);
+    }
+
+    x64_end(b, x64_modrm_mem(p, dst, base, disp));
+}
+
+void x64_vec_store(Buf *b, int32_t width, X64Reg base, int32_t disp, X64Reg src) {
+    uint8_t *p = x64_begin(b);
+
+    if (width == 32) {
+        p = x64_vex(p, 1, 2, true, src, 0, base);
+        *p++ = 0x7f;
+    } else {
+        p = x64_sse_prefix(p, 0xf3, 0x7f, src, base);
+    }
+
+    x64_end(b, x64_modrm_mem(p, src, base, disp));
+}
+
+void x64_pshufd(Buf *b, bool vex, X64Reg dst, X64Reg src, uint8_t order) {
+    uint8_t *p = x64_begin(b);
+
+    if (vex) {
+        p = x64_vex(p, 1, 1, false, dst, 0, src);
+        *p++ = 0x70;
+    } else {
+        p = x64_sse_prefix(p, 0x66, 0x70, dst, src);
+    }
+
+    p = x64_modrm_rr(p, dst, src);
+    *p++ = order;
+    x64_end(b, p);
+}
+
+// 32 bit moves between a general purpose register and the lowest lane, the upper lanes are cleared
+void x64_movd_to_vec(Buf *b, bool vex, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_begin(b);
+
+    if (vex) {
+        p = x64_vex(p, 1, 1, false, dst, 0, src);
+        *p++ = 0x6e;
+    } else {
+        p = x64_sse_prefix(p, 0x66, 0x6e, dst, src);
+    }
+
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_movd_from_vec(Buf *b, bool vex, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_begin(b);
+
+    if (vex) {
+        p = x64_vex(p, 1, 1, false, src, 0, dst);
+        *p++ = 0x7e;
+    } else {
+        p = x64_sse_prefix(p, 0x66, 0x7e, src, dst);
+    }
+
+    x64_end(b, x64_modrm_rr(p, src, dst));
+}
+
+void x64_vpbroadcastd(Buf *b, X64Reg dst, X64Reg src) {
+    uint8_t *p = x64_vex(x64_begin(b), 2, 1, true, dst, 0, src);
+    *p++ = 0x58;
+    x64_end(b, x64_modrm_rr(p, dst, src));
+}
+
+void x64_vextracti128(Buf *b, X64Reg dst, X64Reg src, uint8_t half) {
+    uint8_t *p = x64_vex(x64_begin(b), 3, 1, true, src, 0, dst);
+    *p++ = 0x39;
+    p = x64_modrm_rr(p, src, dst);
+    *p++ = half;
+    x64_end(b, p);
+}
+
+// clears the upper halves of the ymm registers, so the SSE code that runs after 32 byte vectors does not stall
+void x64_vzeroupper(Buf *b) {
+    uint8_t *p = x64_begin(b);
+    *p++ = 0xc5;
+    *p++ = 0xf8;
+    *p++ = 0x77;
+    x64_end(b, p);
+}
+
+void x64_cpuid(Buf *b) {
+    buf_push_u16(b, 0xa20f);
+}
+
+void x64_xgetbv(Buf *b) {
+    uint8_t *p = x64_begin(b);
+    *p++ = 0x0f;
+    *p++ = 0x01;
+    *p++ = 0xd0;
+    x64_end(b, p);
+}
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/loop.h"
+#include "../include/regalloc.h"
+#include "../include/irc.h"
+#include "../include/vec.h"
+
+// unit tests of the IR and the passes that are hard to reach from a program, the cases build their functions
+// with the builder and check what a pass left behind. run by make test, a failing check prints its line
+
+static int32_t test_failures = 0;
+
+#define TEST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+typedef struct TestCase {
+    const char *name;
+    void (*run)(void);
+} TestCase;
+
+// a function of two i32 parameters returning an i32 with its entry block selected
+static IrFunc *test_func(IrModule *m, IrBuilder *b) {
+    IrTypeId params[2] = { IR_TYPE_I32, IR_TYPE_I32 };
+    IrFunc *f = ir_func_create(m, "f", 1, IR_TYPE_I32, params, 2, 0);
+
+    *b = ir_builder_create(m, f);
+    ir_builder_set_block(b, ir_block_create(f));
+
+    return f;
+}
+
+static int32_t test_verify(IrModule *m, IrFunc *f) {
+    Ptrvec errors = ptrvec_create();
+    int32_t num_errs = ir_verify_func(m, f, &errors);
+    int32_t i = 0;
+
+    while (i < errors.len) {
+        const char *err = (const char *) ptrvec_get(&errors, i);
+        printf("  invalid IR %s\n", err);
+        free((void *) err);
+
+        i++;
+    }
+
+    ptrvec_free(&errors);
+
+    return num_errs;
+}
+
+static void test_set_phi(IrFunc *f, IrValue phi, IrValue a, IrValue c) {
+    IrValue *ops = ir_inst_ops(f, &f->insts[phi]);
+
+    ops[0] = a;
+    ops[1] = c;
+}
+
+// whether a dominates b by walking b's idom chain, what ir_dominates answers from the tree numbering
+static bool test_dominates_naive(IrFunc *f, IrBlockId a, IrBlockId b) {
+    while (b != IR_NO_BLOCK) {
+        if (a == b) {
+            return true;
+        }
+
+        if (b == 0) {
+            return false;
+        }
+
+        b = f->blocks[b].idom;
+    }
+
+    return false;
+}
+
+// b0 -> b1 | b2, both -> b3 -> b4 <-> b5, b4 -> b6 and b7 unreachable
+static void test_dominates(void) {
+    IrModule m = ir_module_create();
+    IrBuilder b;
+    IrFunc *f = test_func(&m, &b);
+    IrBlockId blocks[8];
+    uint32_t i = 1;
+
+    blocks[0] = 0;
+
+    while (i < 8) {
+        blocks[i] = ir_block_create(f);
+        i++;
+    }
+
+    IrValue x = ir_build_param(&b, 0);
+    IrValue y = ir_build_param(&b, 1);
+    IrValue cond = ir_build_cmp(&b, IR_LT, x, y);
+    ir_build_cbr(&b, cond, blocks[1], blocks[2]);
+
+    ir_builder_set_block(&b, blocks[1]);
+    ir_build_br(&b, blocks[3]);
+    ir_builder_set_block(&b, blocks[2]);
+    ir_build_br(&b, blocks[3]);
+    ir_builder_set_block(&b, blocks[3]);
+    ir_build_br(&b, blocks[4]);
+    ir_builder_set_block(&b, blocks[4]);
+    ir_build_cbr(&b, cond, blocks[5], blocks[6]);
+    ir_builder_set_block(&b, blocks[5]);
+    ir_build_br(&b, blocks[4]);
+    ir_builder_set_block(&b, blocks[6]);
+    ir_build_ret(&b, x);
+    ir_builder_set_block(&b, blocks[7]);
+    ir_build_br(&b, blocks[6]);
+
+    ir_func_dominators(f);
+
+    TEST_CHECK(f->blocks[3].idom == 0);
+    TEST_CHECK(f->blocks[5].idom == 4);
+    TEST_CHECK(f->blocks[6].idom == 4);
+
+    IrBlockId a = 0;
+
+    while (a < 8) {
+        IrBlockId c = 0;
+
+        while (c < 8) {
+            TEST_CHECK(ir_dominates(f, a, c) == test_dominates_naive(f, a, c));
+            c++;
+        }
+
+        a++;
+    }
+
+    TEST_CHECK(!ir_dominates(f, 1, 3));
+    TEST_CHECK(ir_dominates(f, 3, 5));
+    TEST_CHECK(!ir_dominates(f, 5, 6));
+
+    ir_module_free(&m);
+}
+
+static void test_replace_uses(void) {
+    IrModule m = ir_module_create();
+    IrBuilder b;
+    IrFunc *f = test_func(&m, &b);
+
+    IrValue x = ir_build_param(&b, 0);
+    IrValue y = ir_build_param(&b, 1);
+    IrValue sum = ir_build_binary(&b, IR_ADD, x, y);
+    IrValue prod = ir_build_binary(&b, IR_MUL, sum, x);
+    IrValue ret = ir_build_ret(&b, prod);
+
+    IrValue *map = (IrValue *) calloc(f->num_insts, sizeof(IrValue));
+    map[x] = y;
+    map[sum] = x;
+
+    ir_replace_uses(f, map, f->num_insts);
+
+    TEST_CHECK(f->insts[sum].u.ops[0] == y && f->insts[sum].u.ops[1] == y);
+    TEST_CHECK(f->insts[prod].u.ops[0] == x && f->insts[prod].u.ops[1] == y);
+    TEST_CHECK(f->insts[ret].u.ops[0] == prod);
+
+    free((void *) map);
+    ir_module_free(&m);
+}
+
+// s = 0; i = 0; while (i < n) { s += i * 3; i++ } return s, the multiplication becomes an accumulator
+static void test_loop_reduce(void) {
+    IrModule m = ir_module_create();
+    IrBuilder b;
+    IrFunc *f = test_func(&m, &b);
+    IrBlockId header = ir_block_create(f);
+    IrBlockId body = ir_block_create(f);
+    IrBlockId exit = ir_block_create(f);
+
+    IrValue n = ir_build_param(&b, 0);
+    IrValue k = ir_build_const(&b, IR_TYPE_I32, 3);
+    IrValue zero = ir_build_const(&b, IR_TYPE_I32, 0);
+    IrValue one = ir_build_const(&b, IR_TYPE_I32, 1);
+    ir_build_br(&b, header);
+
+    ir_builder_set_block(&b, header);
+    IrValue i = ir_build_phi(&b, IR_TYPE_I32, 2);
+    IrValue s = ir_build_phi(&b, IR_TYPE_I32, 2);
+    IrValue cond = ir_build_cmp(&b, IR_LT, i, n);
+    ir_build_cbr(&b, cond, body, exit);
+
+    ir_builder_set_block(&b, body);
+    IrValue mul = ir_build_binary(&b, IR_MUL, i, k);
+    IrValue next_s = ir_build_binary(&b, IR_ADD, s, mul);
+    IrValue next_i = ir_build_binary(&b, IR_ADD, i, one);
+    ir_build_br(&b, header);
+
+    ir_builder_set_block(&b, exit);
+    ir_build_ret(&b, s);
+
+    test_set_phi(f, i, zero, next_i);
+    test_set_phi(f, s, zero, next_s);
+    TEST_CHECK(test_verify(&m, f) == 0);
+
+    LoopOpt lo = loop_opt_create(1);
+    loop_opt_func(&lo, f);
+
+    TEST_CHECK(lo.num_reduced == 1);
+    TEST_CHECK(f->insts[next_s].u.ops[1] != mul);
+
+    uint32_t v = 0;
+
+    while (v < f->num_insts) {
+        TEST_CHECK(f->insts[v].op != IR_MUL || f->insts[v].u.ops[0] != i);
+        v++;
+    }
+
+    TEST_CHECK(test_verify(&m, f) == 0);
+
+    loop_opt_free(&lo);
+    ir_module_free(&m);
+}
+
+static bool test_interfere(Irc *g, IrValue a, IrValue c) {
+    return g->node_of[a] != UINT32_MAX && g->node_of[c] != UINT32_MAX && irc_interferes(g, g->node_of[a], g->node_of[c]);
+}
+
+// a is only live on the then side, c only on the else side, so they may share a register. c is defined at the
+// last use of x and y and does not interfere with them
+static void test_irc_interference(void) {
+    IrModule m = ir_module_create();
+    IrBuilder b;
+    IrFunc *f = test_func(&m, &b);
+    IrBlockId then_block = ir_block_create(f);
+    IrBlockId else_block = ir_block_create(f);
+    IrBlockId join = ir_block_create(f);
+
+    IrValue x = ir_build_param(&b, 0);
+    IrValue y = ir_build_param(&b, 1);
+    IrValue a = ir_build_binary(&b, IR_MUL, x, y);
+    IrValue cond = ir_build_cmp(&b, IR_LT, x, y);
+    ir_build_cbr(&b, cond, then_block, else_block);
+
+    ir_builder_set_block(&b, then_block);
+    IrValue r = ir_build_binary(&b, IR_ADD, a, x);
+    ir_build_br(&b, join);
+
+    ir_builder_set_block(&b, else_block);
+    IrValue c = ir_build_binary(&b, IR_SUB, x, y);
+    IrValue d = ir_build_binary(&b, IR_ADD, c, c);
+    ir_build_br(&b, join);
+
+    ir_builder_set_block(&b, join);
+    IrValue p = ir_build_phi(&b, IR_TYPE_I32, 2);
+    ir_build_ret(&b, p);
+
+    test_set_phi(f, p, r, d);
+    TEST_CHECK(test_verify(&m, f) == 0);
+
+    RegAlloc ra = regalloc_create();
+    Irc g = irc_create();
+    uint32_t num_order = 0;
+    uint32_t *order = ir_reverse_postorder(f, &num_order);
+
+    ra.first_cold = num_order;
+    regalloc_prepare(&ra, f, order, num_order);
+
+    TEST_CHECK(irc_run(&g, &ra));
+    TEST_CHECK(!test_interfere(&g, a, c));
+    TEST_CHECK(!test_interfere(&g, a, d));
+    TEST_CHECK(test_interfere(&g, a, x));
+    TEST_CHECK(test_interfere(&g, a, y));
+    TEST_CHECK(test_interfere(&g, x, y));
+    TEST_CHECK(!test_interfere(&g, c, y));
+    TEST_CHECK(!test_interfere(&g, r, x));
+
+    free((void *) order);
+    irc_free(&g);
+    regalloc_free(&ra);
+    ir_module_free(&m);
+}
+
+static TestCase test_cases[] = {
+    { "ir_dominates", test_dominates },
+    { "ir_replace_uses", test_replace_uses },
+    { "loop strength reduction", test_loop_reduce },
+    { "irc interference", test_irc_interference }
+};
+
+int main(void) {
+    size_t num_cases = sizeof(test_cases) / sizeof(TestCase);
+    size_t num_failed = 0;
+    size_t i = 0;
+
+    while (i < num_cases) {
+        int32_t failures = test_failures;
+
+        test_cases[i].run();
+
+        if (test_failures != failures) {
+            printf("FAIL %s\n", test_cases[i].name);
+            num_failed++;
+        }
+
+        i++;
+    }
+
+    printf("%zu ir tests passed, %zu failed\n", num_cases - num_failed, num_failed);
+
+    return num_failed == 0 ? 0 : 1;
+}
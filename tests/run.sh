@@ -0,0 +1,199 @@
+#!/bin/sh
+# runs every program in tests/programs natively at -O0, -O1 and -O2, on the bytecode
+# interpreter with and without the jit and through --emit=c, and compares what it prints
+# with its expected.txt. a profile of it is written by the interpreter, the jit and a native
+# build, which have to agree, and used at -O1 and -O2. every file in tests/errors has to fail at -O0 and -O2 and under
+# --emit=c with the message named on its first line, `// error: <message>`. tests/repl/input.txt is fed to
+# the repl with and without the jit, after loading tests/repl/lib.syn, and the --time-trace output of a build is checked
+#
+# usage: tests/run.sh [synthiumc] [program...]
+
+SYNTHIUMC=${1:-./synthiumc}
+[ $# -gt 0 ] && shift
+CC=${CC:-cc}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+passed=0
+failed=0
+
+check() {
+    name=$1
+    mode=$2
+    status=$3
+
+    if [ "$status" -ne 0 ]; then
+        echo "FAIL $name $mode (exit $status)"
+        failed=$((failed + 1))
+    elif ! cmp -s "$TMP/out.txt" "$DIR/programs/$name/expected.txt"; then
+        echo "FAIL $name $mode (output differs)"
+        diff "$DIR/programs/$name/expected.txt" "$TMP/out.txt" | head -10
+        failed=$((failed + 1))
+    else
+        passed=$((passed + 1))
+    fi
+}
+
+# a `become` of another function needs musttail in C, without it the emitted C has to stop with its #error
+if printf '#if !defined(__has_attribute) || !__has_attribute(musttail)\n#error\n#endif\nint main(void) { return 0; }\n' |
+    $CC -x c -o "$TMP/probe" - > /dev/null 2>&1; then
+    musttail=yes
+else
+    musttail=no
+fi
+
+errors=
+all=no
+if [ $# -eq 0 ]; then
+    set -- $(ls "$DIR/programs")
+    errors=$(ls "$DIR"/errors/*.syn)
+    all=yes
+fi
+
+for name in "$@"; do
+    files=$(ls "$DIR"/programs/"$name"/*.syn)
+
+    for opt in -O0 -O1 -O2; do
+        rm -f "$TMP/out.o" "$TMP/prog"
+        "$SYNTHIUMC" --verify-ir $opt -o "$TMP/out.o" $files > "$TMP/out.txt" 2>&1 &&
+            $CC -no-pie -o "$TMP/prog" "$TMP/out.o" > "$TMP/out.txt" 2>&1 &&
+            "$TMP/prog" > "$TMP/out.txt" 2>&1
+        check "$name" "$opt" $?
+    done
+
+    "$SYNTHIUMC" run $files > "$TMP/out.txt" 2>&1
+    check "$name" run $?
+
+    "$SYNTHIUMC" run --no-jit $files > "$TMP/out.txt" 2>&1
+    check "$name" "run --no-jit" $?
+
+    rm -f "$TMP"/*.prof "$TMP/prog"
+    "$SYNTHIUMC" run --no-jit --profile-generate="$TMP/vm.prof" $files > "$TMP/out.txt" 2>&1
+    check "$name" "run --profile-generate" $?
+
+    "$SYNTHIUMC" run --profile-generate="$TMP/jit.prof" $files > /dev/null 2>&1
+    "$SYNTHIUMC" -O0 --profile-generate="$TMP/native.prof" -o "$TMP/out.o" $files > /dev/null 2>&1 &&
+        $CC -no-pie -o "$TMP/prog" "$TMP/out.o" > /dev/null 2>&1 &&
+        "$TMP/prog" > /dev/null 2>&1
+
+    if cmp -s "$TMP/vm.prof" "$TMP/jit.prof" && cmp -s "$TMP/vm.prof" "$TMP/native.prof"; then
+        passed=$((passed + 1))
+    else
+        echo "FAIL $name --profile-generate (the profiles differ)"
+        failed=$((failed + 1))
+    fi
+
+    # every function has to find its counts in the profile it was built from, and blocks are placed by them
+    # even at -O1, which places nothing without a profile
+    if "$SYNTHIUMC" -O1 --time-report -o "$TMP/out.o" $files 2>&1 | grep -q "^  place "; then
+        echo "FAIL $name -O1 (placed without a profile)"
+        failed=$((failed + 1))
+    else
+        passed=$((passed + 1))
+    fi
+
+    for opt in -O1 -O2; do
+        rm -f "$TMP/out.o" "$TMP/prog"
+        "$SYNTHIUMC" --verify-ir $opt --profile-use="$TMP/vm.prof" --time-report -o "$TMP/out.o" $files > "$TMP/out.txt" 2>&1 &&
+            grep -q "functions without profile  *0$" "$TMP/out.txt" &&
+            grep -q "^  place chained edges" "$TMP/out.txt" &&
+            $CC -no-pie -o "$TMP/prog" "$TMP/out.o" > "$TMP/out.txt" 2>&1 &&
+            "$TMP/prog" > "$TMP/out.txt" 2>&1
+        check "$name" "$opt --profile-use" $?
+    done
+
+    rm -rf "$TMP/c"
+    mkdir "$TMP/c"
+    "$SYNTHIUMC" --emit=c -o "$TMP/c" $files > "$TMP/out.txt" 2>&1
+    status=$?
+
+    if [ $status -eq 0 ] && [ $musttail = no ] && grep -qs SYNTHIUM_MUSTTAIL "$TMP"/c/*.c; then
+        if ! $CC -w -o "$TMP/c/prog" "$TMP"/c/*.c > "$TMP/out.txt" 2>&1 && grep -q "musttail" "$TMP/out.txt"; then
+            passed=$((passed + 1))
+        else
+            echo "FAIL $name --emit=c (built without musttail)"
+            failed=$((failed + 1))
+        fi
+
+        continue
+    fi
+
+    [ $status -eq 0 ] &&
+        $CC -w -o "$TMP/c/prog" "$TMP"/c/*.c > "$TMP/out.txt" 2>&1 &&
+        "$TMP/c/prog" > "$TMP/out.txt" 2>&1
+    check "$name" "--emit=c" $?
+done
+
+for file in $errors; do
+    name=$(basename "$file" .syn)
+    message=$(head -1 "$file" | sed 's,^// error: ,,')
+
+    for mode in -O0 -O2 --emit=c; do
+        rm -rf "$TMP/c"
+        "$SYNTHIUMC" $mode -o "$TMP/c" "$file" > "$TMP/out.txt" 2>&1
+
+        if [ $? -eq 0 ]; then
+            echo "FAIL error $name $mode (compiled)"
+            failed=$((failed + 1))
+        elif ! grep -qF "$message" "$TMP/out.txt"; then
+            echo "FAIL error $name $mode (message differs)"
+            head -5 "$TMP/out.txt"
+            failed=$((failed + 1))
+        else
+            passed=$((passed + 1))
+        fi
+    done
+done
+
+# the repl resolves imports from the working directory, so it runs in tests/repl with the paths made absolute
+if [ $all = yes ]; then
+    synthiumc=$(cd "$(dirname "$SYNTHIUMC")" && pwd)/$(basename "$SYNTHIUMC")
+    repl_dir=$(cd "$DIR/repl" && pwd)
+
+    for mode in repl "repl --no-jit"; do
+        (cd "$repl_dir" && "$synthiumc" $mode "$repl_dir/lib.syn" < input.txt > "$TMP/out.txt" 2>&1)
+        status=$?
+
+        if [ $status -ne 0 ]; then
+            echo "FAIL $mode (exit $status)"
+            failed=$((failed + 1))
+        elif ! cmp -s "$TMP/out.txt" "$repl_dir/expected.txt"; then
+            echo "FAIL $mode (output differs)"
+            diff "$repl_dir/expected.txt" "$TMP/out.txt" | head -10
+            failed=$((failed + 1))
+        else
+            passed=$((passed + 1))
+        fi
+    done
+fi
+
+# the trace has one event per line, comma separated, and a complete event for every phase of a build
+if [ $all = yes ]; then
+    "$SYNTHIUMC" -O2 --time-trace="$TMP/trace.json" -o "$TMP/out.o" $(ls "$DIR"/programs/calls/*.syn) > "$TMP/out.txt" 2>&1 &&
+        awk '
+            BEGIN { need["compile"]; need["parse"]; need["type check"]; need["lower"]; need["optimize"]; need["codegen"] }
+            NR == 1 { if ($0 != "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [") bad = 1; next }
+            prev != "" && $0 == "]}" && prev !~ /^\{"name": "[^"]*", .*\}$/ { bad = 1 }
+            prev != "" && $0 != "]}" && prev !~ /^\{"name": "[^"]*", .*\},$/ { bad = 1 }
+            { prev = $0 }
+            /"ph": "X"/ {
+                if ($0 !~ /"ts": [0-9.]+, "dur": [0-9.]+/) bad = 1
+                name = $0; sub(/^\{"name": "/, "", name); sub(/".*/, "", name); delete need[name]
+            }
+            END {
+                if (prev != "]}" || bad) exit 1
+                for (name in need) exit 1
+            }' "$TMP/trace.json"
+
+    if [ $? -eq 0 ]; then
+        passed=$((passed + 1))
+    else
+        echo "FAIL --time-trace"
+        head -5 "$TMP/trace.json"
+        failed=$((failed + 1))
+    fi
+fi
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]